@@ -0,0 +1,462 @@
+//! Benchmark suite with fixed workloads.
+//!
+//! Run with `cargo bench --bench suite` (or `just bench`). Each workload is
+//! prepared once (programs are compiled up front), run once to warm up and
+//! check its output, then timed over a fixed number of samples. Results are
+//! printed as a table and, with `--json PATH`, written as JSON. Given a
+//! `--baseline PATH` from an earlier run, the suite prints a comparison and
+//! exits with status 3 if any workload's median got slower by more than
+//! `--threshold` percent. Any other failure exits with a different status
+//! (2 for bad options, 101 for a panic).
+//!
+//! Options (after `--`):
+//!   --json PATH        write the results to PATH
+//!   --baseline PATH    compare against the results in PATH
+//!   --threshold PCT    regression threshold in percent (default 10)
+//!   --samples N        timed runs per workload (default 10)
+//!   NAME...            run only workloads whose name contains NAME
+
+use std::ffi::CString;
+use std::hint::black_box;
+use std::io::Write;
+use std::path::{Path, PathBuf};
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
+
+use serde::{Deserialize, Serialize};
+
+use moca::compiler::compile_path;
+use moca::config::RuntimeConfig;
+use moca::vm::scheduler::TaskStatus;
+use moca::vm::threads::ThreadSpawner;
+use moca::vm::{BytecodeSource, Chunk, VM, Value, bytecode};
+use moca::{
+    MocaFunctionRef, MocaResult, moca_call, moca_call_ref, moca_function_ref, moca_load_chunk,
+    moca_pop, moca_push_i64, moca_to_i64, moca_vm_free, moca_vm_new,
+};
+
+const DEFAULT_SAMPLES: usize = 10;
+const DEFAULT_THRESHOLD: f64 = 10.0;
+/// Exit status when a workload regressed against the baseline, distinct
+/// from option errors (2) and panics (101)
+const REGRESSION_EXIT: i32 = 3;
+/// Host-to-moca calls per sample of the FFI workloads
+const FFI_CALLS: i64 = 100_000;
+/// Loads per sample of the bytecode load workload
+const LOADS: usize = 20;
+/// Tasks per sample of the spawner workloads
+const SPAWNS: usize = 100_000;
+/// OS threads are spawned and joined in waves of this size to stay well
+/// below per-process thread limits
+const OS_WAVE: usize = 1_000;
+/// Version of the JSON results format
+const FORMAT_VERSION: u32 = 1;
+
+/// How a moca program is executed.
+#[derive(Clone, Copy)]
+enum Engine {
+    /// The stack interpreter over `Op`, no JIT
+    Interpreter,
+    /// The register-based MicroOp interpreter, no JIT
+    MicroOp,
+    /// MicroOp interpreter with the JIT compiling hot code
+    Jit,
+}
+
+/// A measured run: how long its timed part took, and the output to check.
+type Run = Box<dyn FnMut() -> (Duration, String)>;
+
+/// One timed workload. `prepare` does the untimed setup and returns the
+/// measured run.
+struct Workload {
+    name: &'static str,
+    prepare: Box<dyn Fn() -> Run>,
+    expected: &'static str,
+}
+
+#[derive(Serialize, Deserialize)]
+struct Results {
+    version: u32,
+    moca_version: String,
+    samples: usize,
+    benchmarks: Vec<BenchResult>,
+}
+
+#[derive(Serialize, Deserialize)]
+struct BenchResult {
+    name: String,
+    median_ns: u64,
+    min_ns: u64,
+    max_ns: u64,
+    mean_ns: u64,
+}
+
+/// Compile the program at `path`, relative to the crate root.
+fn compile(path: &str) -> Arc<Chunk> {
+    let path = Path::new(env!("CARGO_MANIFEST_DIR")).join(path);
+    let chunk = compile_path(&path, &RuntimeConfig::default())
+        .unwrap_or_else(|e| panic!("cannot compile {}: {}", path.display(), e));
+    Arc::new(chunk)
+}
+
+/// A `Write` appending to a shared buffer, so output can be read back after
+/// the VM is gone.
+struct SharedBuffer(Arc<Mutex<Vec<u8>>>);
+
+impl Write for SharedBuffer {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        self.0.lock().unwrap().extend_from_slice(buf);
+        Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        Ok(())
+    }
+}
+
+/// A workload running the program `file` on `engine`.
+fn program(
+    name: &'static str,
+    file: &'static str,
+    engine: Engine,
+    expected: &'static str,
+) -> Workload {
+    Workload {
+        name,
+        expected,
+        prepare: Box::new(move || {
+            let chunk = compile(&format!("benches/workloads/{}", file));
+            Box::new(move || {
+                let output = Arc::new(Mutex::new(Vec::new()));
+                let mut vm = VM::with_output(Box::new(SharedBuffer(output.clone())));
+                vm.set_use_microop(!matches!(engine, Engine::Interpreter));
+                vm.set_jit_config(
+                    matches!(engine, Engine::Jit),
+                    RuntimeConfig::default().jit_threshold,
+                    false,
+                );
+                vm.share_chunk(chunk.clone());
+
+                let start = Instant::now();
+                let result = vm.run(&chunk);
+                let elapsed = start.elapsed();
+                if let Err(e) = result {
+                    panic!("{}: {}", name, e);
+                }
+                drop(vm);
+                let output = String::from_utf8_lossy(&output.lock().unwrap()).into_owned();
+                (elapsed, output)
+            })
+        }),
+    }
+}
+
+/// A workload calling `add(a, b)` from the host through the C API, by name
+/// (`moca_call`) or through a resolved handle (`moca_call_ref`).
+fn ffi_calls(name: &'static str, by_ref: bool) -> Workload {
+    Workload {
+        name,
+        expected: "ok",
+        prepare: Box::new(move || {
+            let data = bytecode::serialize(&compile("benches/workloads/ffi_add.mc"));
+            Box::new(move || unsafe {
+                let vm = moca_vm_new();
+                assert_eq!(
+                    moca_load_chunk(vm, data.as_ptr(), data.len()),
+                    MocaResult::Ok
+                );
+                let func_name = CString::new("add").unwrap();
+                let mut func = MocaFunctionRef {
+                    func_index: 0,
+                    arity: 0,
+                };
+                assert_eq!(
+                    moca_function_ref(vm, func_name.as_ptr(), 2, &mut func),
+                    MocaResult::Ok
+                );
+
+                let start = Instant::now();
+                let mut sum = 0i64;
+                for i in 0..FFI_CALLS {
+                    moca_push_i64(vm, i);
+                    moca_push_i64(vm, 1);
+                    let result = if by_ref {
+                        moca_call_ref(vm, func, 2)
+                    } else {
+                        moca_call(vm, func_name.as_ptr(), 2)
+                    };
+                    debug_assert_eq!(result, MocaResult::Ok);
+                    sum += moca_to_i64(vm, -1);
+                    moca_pop(vm, 1);
+                }
+                let elapsed = start.elapsed();
+
+                moca_vm_free(vm);
+                let expected = FFI_CALLS * (FFI_CALLS + 1) / 2;
+                let output = if sum == expected { "ok" } else { "wrong sum" };
+                (elapsed, output.to_string())
+            })
+        }),
+    }
+}
+
+/// A workload spawning and joining short host tasks through
+/// `ThreadSpawner`, as OS threads or as green threads.
+fn spawner(name: &'static str, green: bool) -> Workload {
+    fn work(seed: usize) -> Value {
+        Value::I64((0..100).map(|i| black_box(seed as i64 + i)).sum())
+    }
+
+    Workload {
+        name,
+        expected: "ok",
+        prepare: Box::new(move || {
+            Box::new(move || {
+                let start = Instant::now();
+                let mut spawner = ThreadSpawner::new();
+                let mut sum = 0;
+                let wave = if green { SPAWNS } else { OS_WAVE };
+                for first in (0..SPAWNS).step_by(wave) {
+                    let ids: Vec<usize> = (first..first + wave)
+                        .map(|seed| {
+                            if green {
+                                spawner.spawn_green(Box::new(move || TaskStatus::Done(work(seed))))
+                            } else {
+                                spawner.spawn(move || work(seed))
+                            }
+                        })
+                        .collect();
+                    for id in ids {
+                        sum += spawner.join(id).unwrap().as_i64().unwrap();
+                    }
+                }
+                let elapsed = start.elapsed();
+
+                let expected: i64 = (0..SPAWNS).map(|seed| 100 * seed as i64 + 4950).sum();
+                let output = if sum == expected { "ok" } else { "wrong sum" };
+                (elapsed, output.to_string())
+            })
+        }),
+    }
+}
+
+/// A workload loading the bytecode of the largest example program.
+fn bytecode_load() -> Workload {
+    Workload {
+        name: "bytecode/load",
+        expected: "ok",
+        prepare: Box::new(|| {
+            let data = bytecode::serialize(&compile("examples/raymarching_torus.mc"));
+            Box::new(move || {
+                let sources: Vec<_> = (0..LOADS)
+                    .map(|_| Arc::new(BytecodeSource::from_vec(data.clone())))
+                    .collect();
+                let start = Instant::now();
+                for source in sources {
+                    black_box(bytecode::load(source).expect("invalid bytecode"));
+                }
+                (start.elapsed(), "ok".to_string())
+            })
+        }),
+    }
+}
+
+fn workloads() -> Vec<Workload> {
+    const COMPUTE: &str = "75025\n8.236083882273341\n";
+    vec![
+        program(
+            "interpreter/compute",
+            "compute.mc",
+            Engine::Interpreter,
+            COMPUTE,
+        ),
+        program("microop/compute", "compute.mc", Engine::MicroOp, COMPUTE),
+        program("jit/compute", "compute.mc", Engine::Jit, COMPUTE),
+        program("gc/alloc", "gc_alloc.mc", Engine::Jit, "300000\n"),
+        program("string/build", "string_build.mc", Engine::Jit, "2930157\n"),
+        program(
+            "channel/ping_pong",
+            "channel_pingpong.mc",
+            Engine::Jit,
+            "2000\n",
+        ),
+        program(
+            "thread/fan_out",
+            "thread_fanout.mc",
+            Engine::Jit,
+            "1279993600000\n",
+        ),
+        program(
+            "thread/spawn_join",
+            "thread_spawn.mc",
+            Engine::Jit,
+            "495000000\n",
+        ),
+        spawner("thread/spawn_os", false),
+        spawner("thread/spawn_green", true),
+        ffi_calls("ffi/call", false),
+        ffi_calls("ffi/call_ref", true),
+        bytecode_load(),
+    ]
+}
+
+fn measure(workload: &Workload, samples: usize) -> BenchResult {
+    let mut run = (workload.prepare)();
+    let (_, output) = run();
+    assert_eq!(
+        output, workload.expected,
+        "{}: unexpected output",
+        workload.name
+    );
+
+    let mut times: Vec<u64> = (0..samples).map(|_| run().0.as_nanos() as u64).collect();
+    times.sort_unstable();
+    BenchResult {
+        name: workload.name.to_string(),
+        median_ns: times[times.len() / 2],
+        min_ns: times[0],
+        max_ns: times[times.len() - 1],
+        mean_ns: times.iter().sum::<u64>() / times.len() as u64,
+    }
+}
+
+fn format_ns(ns: u64) -> String {
+    format!("{:.3} ms", ns as f64 / 1e6)
+}
+
+/// Print how `results` compare with `baseline`. Returns the names of the
+/// workloads that regressed by more than `threshold` percent.
+fn compare(results: &Results, baseline: &Results, threshold: f64) -> Vec<String> {
+    let mut regressions = Vec::new();
+    println!();
+    println!("| Benchmark | Base | Head | Change |");
+    println!("|-----------|------|------|--------|");
+    for result in &results.benchmarks {
+        let Some(base) = baseline.benchmarks.iter().find(|b| b.name == result.name) else {
+            println!(
+                "| {} | - | {} | new |",
+                result.name,
+                format_ns(result.median_ns)
+            );
+            continue;
+        };
+        let change = (result.median_ns as f64 / base.median_ns.max(1) as f64 - 1.0) * 100.0;
+        let flag = if change > threshold {
+            regressions.push(result.name.clone());
+            " 🔴"
+        } else if change < -threshold {
+            " 🟢"
+        } else {
+            ""
+        };
+        println!(
+            "| {} | {} | {} | {:+.1}%{} |",
+            result.name,
+            format_ns(base.median_ns),
+            format_ns(result.median_ns),
+            change,
+            flag
+        );
+    }
+    println!();
+    println!(
+        "_Median of each workload. 🔴 slower / 🟢 faster than base by more than {threshold}%_"
+    );
+    regressions
+}
+
+struct Options {
+    json: Option<PathBuf>,
+    baseline: Option<PathBuf>,
+    threshold: f64,
+    samples: usize,
+    filters: Vec<String>,
+}
+
+fn parse_options() -> Result<Options, String> {
+    let mut options = Options {
+        json: None,
+        baseline: None,
+        threshold: DEFAULT_THRESHOLD,
+        samples: DEFAULT_SAMPLES,
+        filters: Vec::new(),
+    };
+    let mut args = std::env::args().skip(1);
+    while let Some(arg) = args.next() {
+        let mut value = |flag: &str| args.next().ok_or(format!("{} needs a value", flag));
+        match arg.as_str() {
+            // Passed by `cargo bench`
+            "--bench" => {}
+            "--json" => options.json = Some(value("--json")?.into()),
+            "--baseline" => options.baseline = Some(value("--baseline")?.into()),
+            "--threshold" => {
+                options.threshold = value("--threshold")?
+                    .parse()
+                    .map_err(|_| "--threshold needs a number".to_string())?;
+            }
+            "--samples" => {
+                options.samples = value("--samples")?
+                    .parse()
+                    .ok()
+                    .filter(|&n| n > 0)
+                    .ok_or("--samples needs a positive integer")?;
+            }
+            flag if flag.starts_with("--") => return Err(format!("unknown option {}", flag)),
+            filter => options.filters.push(filter.to_string()),
+        }
+    }
+    Ok(options)
+}
+
+fn main() {
+    let options = parse_options().unwrap_or_else(|e| {
+        eprintln!("error: {}", e);
+        std::process::exit(2);
+    });
+    let baseline: Option<Results> = options.baseline.as_ref().map(|path| {
+        let data = std::fs::read_to_string(path)
+            .unwrap_or_else(|e| panic!("cannot read {}: {}", path.display(), e));
+        serde_json::from_str(&data)
+            .unwrap_or_else(|e| panic!("invalid baseline {}: {}", path.display(), e))
+    });
+
+    let mut results = Results {
+        version: FORMAT_VERSION,
+        moca_version: env!("CARGO_PKG_VERSION").to_string(),
+        samples: options.samples,
+        benchmarks: Vec::new(),
+    };
+    for workload in workloads() {
+        if !options.filters.is_empty() && !options.filters.iter().any(|f| workload.name.contains(f))
+        {
+            continue;
+        }
+        let result = measure(&workload, options.samples);
+        println!(
+            "{:<22} median {:>12}  min {:>12}  max {:>12}",
+            result.name,
+            format_ns(result.median_ns),
+            format_ns(result.min_ns),
+            format_ns(result.max_ns)
+        );
+        results.benchmarks.push(result);
+    }
+
+    if let Some(path) = &options.json {
+        let json = serde_json::to_string_pretty(&results).unwrap();
+        std::fs::write(path, json + "\n")
+            .unwrap_or_else(|e| panic!("cannot write {}: {}", path.display(), e));
+    }
+
+    if let Some(baseline) = &baseline {
+        let regressions = compare(&results, baseline, options.threshold);
+        if !regressions.is_empty() {
+            eprintln!(
+                "error: slower than the baseline by more than {}%: {}",
+                options.threshold,
+                regressions.join(", ")
+            );
+            std::process::exit(REGRESSION_EXIT);
+        }
+    }
+}
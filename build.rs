@@ -1,9 +1,16 @@
 use std::env;
-use std::path::PathBuf;
+use std::path::{Path, PathBuf};
 
 fn main() {
-    // Generate C header using cbindgen
+    // Identify this build of moca for the on-disk caches, which must not
+    // reuse output of a different compiler that reports the same version
     let crate_dir = env::var("CARGO_MANIFEST_DIR").unwrap();
+    println!(
+        "cargo:rustc-env=MOCA_BUILD_HASH={:016x}",
+        build_hash(Path::new(&crate_dir))
+    );
+
+    // Generate C header using cbindgen
     let output_path = PathBuf::from(&crate_dir).join("include").join("moca.h");
 
     // Create include directory if it doesn't exist
@@ -22,3 +29,36 @@ fn main() {
         eprintln!("Warning: Failed to generate C header: {}", e);
     }
 }
+
+/// FNV-1a hash of the manifest, the lockfile and every file under `src` and
+/// `std`, visited in sorted order.
+fn build_hash(crate_dir: &Path) -> u64 {
+    let mut files = vec![crate_dir.join("Cargo.toml"), crate_dir.join("Cargo.lock")];
+    collect_files(&crate_dir.join("src"), &mut files);
+    collect_files(&crate_dir.join("std"), &mut files);
+    let mut hash: u64 = 0xcbf29ce484222325;
+    for file in files {
+        let name = file.strip_prefix(crate_dir).unwrap_or(&file);
+        let contents = std::fs::read(&file).unwrap_or_default();
+        for &byte in name.to_string_lossy().as_bytes().iter().chain(&contents) {
+            hash ^= byte as u64;
+            hash = hash.wrapping_mul(0x100000001b3);
+        }
+    }
+    hash
+}
+
+fn collect_files(dir: &Path, files: &mut Vec<PathBuf>) {
+    let Ok(entries) = std::fs::read_dir(dir) else {
+        return;
+    };
+    let mut paths: Vec<PathBuf> = entries.filter_map(|e| e.ok().map(|e| e.path())).collect();
+    paths.sort();
+    for path in paths {
+        if path.is_dir() {
+            collect_files(&path, files);
+        } else {
+            files.push(path);
+        }
+    }
+}
@@ -143,6 +143,361 @@ typedef struct {
     uint8_t _private[0];
 } MocaVm;
 
+/**
+ * Opaque VM snapshot type.
+ *
+ * Created by `moca_vm_snapshot()` and used to start new VMs from an
+ * already initialized state with `moca_vm_new_from_snapshot()`.
+ */
+typedef struct {
+    uint8_t _private[0];
+} MocaSnapshot;
+
+/**
+ * Opaque pool of VM instances.
+ *
+ * Created by `moca_pool_new()` from an initialized VM; hands out instances
+ * with `moca_pool_checkout()` and takes them back with `moca_pool_checkin()`.
+ */
+typedef struct {
+    uint8_t _private[0];
+} MocaPool;
+
+/**
+ * Opaque handle to the pending result of an async host function.
+ *
+ * Created by `moca_async_begin()` inside a host function and completed,
+ * from any thread, with `moca_async_resolve()` or `moca_async_cancel()`.
+ */
+typedef struct {
+    uint8_t _private[0];
+} MocaAsync;
+
+/**
+ * Pre-resolved handle to a moca function.
+ *
+ * Obtained from `moca_function_ref()` and passed to `moca_call_ref()` to
+ * call a function without looking it up by name. A handle is only valid for
+ * the chunk that was loaded when it was resolved.
+ */
+typedef struct {
+    /**
+     * Function index in the loaded chunk (`UINT32_MAX` for main)
+     */
+    uint32_t func_index;
+    /**
+     * Number of arguments the handle was resolved against
+     */
+    uint32_t arity;
+} MocaFunctionRef;
+
+/**
+ * Type tag of a `MocaValue`.
+ */
+typedef enum {
+    MOCA_VALUE_TAG_NULL = 0,
+    MOCA_VALUE_TAG_BOOL = 1,
+    MOCA_VALUE_TAG_I64 = 2,
+    MOCA_VALUE_TAG_F64 = 3,
+    /**
+     * Heap reference; only valid until the next call into the VM
+     */
+    MOCA_VALUE_TAG_REF = 4,
+} MocaValueTag;
+
+/**
+ * Payload of a `MocaValue`, selected by its tag.
+ */
+typedef union {
+    bool b;
+    int64_t i;
+    double f;
+    /**
+     * Heap reference index (for `MOCA_VALUE_TAG_REF`)
+     */
+    uint64_t r;
+} MocaValueData;
+
+/**
+ * A moca value passed by value across the C API (used by batched calls).
+ */
+typedef struct {
+    MocaValueTag tag;
+    MocaValueData data;
+} MocaValue;
+
+/**
+ * Heap usage and GC counters of a VM, filled by `moca_get_heap_stats()`.
+ */
+typedef struct {
+    /**
+     * Bytes allocated, including garbage not yet collected
+     */
+    uintptr_t bytes_allocated;
+    /**
+     * Objects on the heap, including garbage not yet collected
+     */
+    uintptr_t object_count;
+    /**
+     * Allocated bytes that trigger the next collection
+     */
+    uintptr_t gc_threshold;
+    /**
+     * Hard memory limit (0 = none)
+     */
+    uintptr_t memory_limit;
+    /**
+     * Soft memory limit (0 = none)
+     */
+    uintptr_t soft_memory_limit;
+    /**
+     * Major GC cycles
+     */
+    uint64_t gc_cycles;
+    /**
+     * Minor (nursery-only) GC cycles
+     */
+    uint64_t gc_minor_cycles;
+    /**
+     * Total GC pause time (microseconds)
+     */
+    uint64_t gc_pause_us;
+    /**
+     * Longest GC pause (microseconds)
+     */
+    uint64_t gc_max_pause_us;
+} MocaHeapStats;
+
+/**
+ * Runtime counters of a VM, filled by `moca_get_metrics()`.
+ */
+typedef struct {
+    /**
+     * Major GC cycles
+     */
+    uint64_t gc_cycles;
+    /**
+     * Minor (nursery-only) GC cycles
+     */
+    uint64_t gc_minor_cycles;
+    /**
+     * GC pauses; with incremental GC every step is one
+     */
+    uint64_t gc_pauses;
+    /**
+     * Total GC pause time (microseconds)
+     */
+    uint64_t gc_pause_us;
+    /**
+     * Longest GC pause (microseconds)
+     */
+    uint64_t gc_max_pause_us;
+    /**
+     * Median GC pause, rounded up to a histogram bucket (microseconds)
+     */
+    uint64_t gc_pause_p50_us;
+    /**
+     * 99th percentile GC pause, rounded up to a histogram bucket (microseconds)
+     */
+    uint64_t gc_pause_p99_us;
+    /**
+     * Size of the heap's memory
+     */
+    uintptr_t heap_bytes;
+    /**
+     * Bytes of objects on the heap, including garbage not yet collected
+     */
+    uintptr_t heap_live_bytes;
+    /**
+     * Bytes allocated since the VM was created
+     */
+    uint64_t allocated_bytes;
+    /**
+     * Objects allocated since the VM was created
+     */
+    uint64_t allocated_objects;
+    /**
+     * Functions and loops compiled to native code
+     */
+    uint64_t jit_compiles;
+    /**
+     * JIT compilations that failed
+     */
+    uint64_t jit_failures;
+    /**
+     * Failed type guards on entry to speculative loop code
+     */
+    uint64_t jit_deopts;
+    /**
+     * Machine code bytes compiled
+     */
+    uint64_t jit_code_bytes;
+    /**
+     * Values sent over the VM's channels
+     */
+    uint64_t channel_sends;
+    /**
+     * Values received over the VM's channels
+     */
+    uint64_t channel_receives;
+} MocaMetrics;
+
+/**
+ * Kind of a `MocaEvent`.
+ */
+typedef enum {
+    /**
+     * A GC pause starts (`minor`)
+     */
+    MOCA_EVENT_KIND_GC_START = 0,
+    /**
+     * A GC pause ended (`minor`, `pause_ns`)
+     */
+    MOCA_EVENT_KIND_GC_END = 1,
+    /**
+     * A function or loop was compiled (`name`, `is_loop`, `code_size`)
+     */
+    MOCA_EVENT_KIND_JIT_COMPILE = 2,
+    /**
+     * A function or loop moved to another tier (`name`, `is_loop`, `tier`)
+     */
+    MOCA_EVENT_KIND_TIER_CHANGE = 3,
+    /**
+     * The heap's memory grew (`heap_bytes`)
+     */
+    MOCA_EVENT_KIND_HEAP_GROW = 4,
+} MocaEventKind;
+
+/**
+ * A runtime event, passed to the `MocaEventFn` installed with
+ * `moca_set_event_callback()`. Fields not used by `kind` are zero.
+ */
+typedef struct {
+    MocaEventKind kind;
+    /**
+     * Whether a GC pause is a minor collection
+     */
+    bool minor;
+    /**
+     * Length of the pause (nanoseconds)
+     */
+    uint64_t pause_ns;
+    /**
+     * NUL-terminated function name, valid during the callback (or NULL)
+     */
+    const char *name;
+    /**
+     * Whether the code is a loop in `name` rather than the whole function
+     */
+    bool is_loop;
+    /**
+     * Machine code bytes
+     */
+    uintptr_t code_size;
+    /**
+     * Tier entered: 0 = interpreter, 1 = baseline JIT, 2 = JIT specialized
+     * on type feedback
+     */
+    uint32_t tier;
+    /**
+     * Size of the heap's memory after growing
+     */
+    uintptr_t heap_bytes;
+} MocaEvent;
+
+/**
+ * Aggregate statistics of a `MocaPool`.
+ *
+ * GC counters cover instances that have been checked in at least once;
+ * work done by an instance is added when it is checked in.
+ */
+typedef struct {
+    /**
+     * Instances created by the pool that are still alive
+     */
+    uintptr_t instances;
+    /**
+     * Instances waiting in the pool
+     */
+    uintptr_t idle;
+    /**
+     * Instances currently checked out
+     */
+    uintptr_t checked_out;
+    /**
+     * Total number of checkouts
+     */
+    uint64_t checkouts;
+    /**
+     * Checkouts that found the pool empty and created a new instance
+     */
+    uint64_t misses;
+    /**
+     * Major GC cycles run by all instances
+     */
+    uint64_t gc_cycles;
+    /**
+     * Minor (nursery-only) GC cycles run by all instances
+     */
+    uint64_t gc_minor_cycles;
+    /**
+     * Total GC pause time of all instances (microseconds)
+     */
+    uint64_t gc_pause_us;
+    /**
+     * Heap bytes allocated by idle instances
+     */
+    uintptr_t idle_heap_bytes;
+} MocaPoolStats;
+
+/**
+ * Output buffering mode, for `moca_set_output_buffering()`.
+ */
+typedef enum {
+    /**
+     * Every write goes out right away
+     */
+    MOCA_BUFFER_MODE_UNBUFFERED = 0,
+    /**
+     * Flushed at each newline
+     */
+    MOCA_BUFFER_MODE_LINE = 1,
+    /**
+     * Flushed when the buffer fills up and when the VM returns to the host
+     */
+    MOCA_BUFFER_MODE_BLOCK = 2,
+} MocaBufferMode;
+
+/**
+ * A host-owned ring buffer that receives a VM's stdout, installed with
+ * `moca_set_output_ring()`.
+ *
+ * `head` and `tail` count bytes since the ring was installed; the byte at
+ * position `p` is stored at `data[p % capacity]`. The VM advances `head`
+ * and the host advances `tail` as it consumes bytes, both with atomic
+ * release stores, so the host may read from another thread. Output that
+ * does not fit is discarded and counted in `dropped`.
+ */
+typedef struct {
+    /**
+     * Storage of `capacity` bytes
+     */
+    uint8_t *data;
+    uintptr_t capacity;
+    /**
+     * Bytes written by the VM
+     */
+    uintptr_t head;
+    /**
+     * Bytes consumed by the host
+     */
+    uintptr_t tail;
+    /**
+     * Bytes discarded because the ring was full
+     */
+    uintptr_t dropped;
+} MocaOutputRing;
+
 /**
  * Host function type.
  *
@@ -163,6 +518,15 @@ typedef MocaResult (*MocaCFunc)(MocaVm *vm);
 typedef void (*MocaErrorFn)(const char *message,
                             void *userdata);
 
+/**
+ * Event callback function type.
+ *
+ * Called on the thread running the VM, in the middle of execution: it must
+ * not call back into the VM.
+ */
+typedef void (*MocaEventFn)(const MocaEvent *event,
+                            void *userdata);
+
 
 
 
@@ -232,8 +596,9 @@ uint32_t moca_version_patch(void)
 /**
  * Call a moca function by name.
  *
- * Arguments must be pushed onto the stack before calling.
- * The result will be on the stack after a successful call.
+ * Arguments must be pushed onto the stack before calling. They are consumed
+ * by the call, even if it fails at runtime, and the result is pushed in their place.
+ * Hot functions are JIT compiled just like calls made from moca code.
  *
  * # Arguments
  * - `vm`: Valid VM instance
@@ -243,6 +608,8 @@ uint32_t moca_version_patch(void)
  * # Returns
  * - `MOCA_OK` on success
  * - `MOCA_ERROR_NOT_FOUND` if function not found
+ * - `MOCA_ERROR_INVALID_ARG` if `nargs` does not match the function's arity
+ * - `MOCA_ERROR_VERIFY` if the function's body is corrupt
  * - `MOCA_ERROR_RUNTIME` on execution error
  */
 
@@ -263,6 +630,86 @@ MocaResult moca_pcall(MocaVm *vm,
                       int32_t nargs)
 ;
 
+/**
+ * Resolve a moca function by name into a handle for `moca_call_ref`.
+ *
+ * The name lookup and arity check happen once here, so repeated calls
+ * through the handle do no string work. Only functions from the loaded
+ * bytecode can be resolved, not registered host functions.
+ *
+ * # Arguments
+ * - `vm`: Valid VM instance with loaded bytecode
+ * - `func_name`: Name of the function (null-terminated)
+ * - `nargs`: Number of arguments the function will be called with
+ * - `out`: Receives the handle on success
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_NOT_FOUND` if no bytecode is loaded or function not found
+ * - `MOCA_ERROR_INVALID_ARG` if `nargs` does not match the function's arity
+ */
+
+MocaResult moca_function_ref(MocaVm *vm,
+                             const char *func_name,
+                             int32_t nargs,
+                             MocaFunctionRef *out)
+;
+
+/**
+ * Call a moca function through a handle from `moca_function_ref`.
+ *
+ * Behaves like `moca_call` (arguments are consumed and the result is pushed)
+ * but skips the name lookup and UTF-8 validation.
+ *
+ * # Arguments
+ * - `vm`: Valid VM instance
+ * - `func`: Handle resolved against the currently loaded bytecode
+ * - `nargs`: Number of arguments on the stack (must match the handle)
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if `nargs` does not match the handle's arity
+ * - `MOCA_ERROR_VERIFY` if the function's body is corrupt
+ * - `MOCA_ERROR_RUNTIME` on execution error (including stale handles)
+ */
+
+MocaResult moca_call_ref(MocaVm *vm,
+                         MocaFunctionRef func,
+                         int32_t nargs)
+;
+
+/**
+ * Call a moca function once per argument tuple in a single VM entry.
+ *
+ * `args` holds `count` consecutive tuples of `nargs` values each, and
+ * `results[i]` receives the return value for tuple `i`. The stack is not
+ * touched. Once the function is JIT compiled, the remaining tuples run in a
+ * native loop over the compiled code. Reference results are only valid until
+ * the next call into the VM.
+ *
+ * # Arguments
+ * - `vm`: Valid VM instance
+ * - `func`: Handle resolved against the currently loaded bytecode
+ * - `args`: `count * nargs` argument values (may be NULL if that is 0)
+ * - `nargs`: Arguments per call (must match the handle)
+ * - `count`: Number of calls
+ * - `results`: Output array of `count` values (may be NULL if `count` is 0)
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` on NULL arrays or an arity mismatch
+ * - `MOCA_ERROR_VERIFY` if the function's body is corrupt
+ * - `MOCA_ERROR_RUNTIME` if any call fails (`results` is left unspecified)
+ */
+
+MocaResult moca_call_batch(MocaVm *vm,
+                           MocaFunctionRef func,
+                           const MocaValue *args,
+                           uintptr_t nargs,
+                           uintptr_t count,
+                           MocaValue *results)
+;
+
 /**
  * Register a host function.
  *
@@ -281,10 +728,57 @@ MocaResult moca_register_function(MocaVm *vm,
                                   int32_t arity)
 ;
 
+/**
+ * Start an async result in a host function.
+ *
+ * Pushes the id of a pending result onto the stack, for the host function
+ * to return, and hands back a handle that completes it. Moca code waits
+ * for the result with `recv(id)`; on a spawned thread this suspends only
+ * that green thread, so the host can finish the work elsewhere without
+ * stalling the VM.
+ *
+ * The id is reused once `recv` has returned the result, so it must be
+ * received at most once.
+ *
+ * # Returns
+ * The handle, or NULL if `vm` is NULL. Each handle must be completed once
+ * with `moca_async_resolve()` or `moca_async_cancel()`.
+ */
+
+MocaAsync *moca_async_begin(MocaVm *vm)
+;
+
+/**
+ * Complete an async result with `value` and free the handle.
+ *
+ * May be called from any thread. Only null, bool, i64 and f64 values can
+ * be delivered: heap references belong to the VM that created them.
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` on a NULL handle or a reference value; the
+ *   handle is not freed
+ */
+
+MocaResult moca_async_resolve(MocaAsync *handle,
+                              MocaValue value)
+;
+
+/**
+ * Abandon an async result and free the handle. A waiting `recv` returns
+ * null.
+ *
+ * May be called from any thread. NULL is ignored.
+ */
+
+void moca_async_cancel(MocaAsync *handle)
+;
+
 /**
  * Set a global variable.
  *
- * Pops the top value from the stack and sets it as a global.
+ * Pops the top value from the stack and sets it as a global. The VM keeps
+ * the value alive as a GC root until the global is overwritten.
  *
  * # Arguments
  * - `vm`: Valid VM instance
@@ -370,7 +864,9 @@ MocaResult moca_load_chunk(MocaVm *vm,
 /**
  * Load bytecode from a file.
  *
- * This reads the file, parses the bytecode, and validates it.
+ * The file is memory-mapped. For version 3 files only the function headers
+ * are decoded here; each function body is decoded the first time it runs.
+ * The file must not be modified while the VM uses it.
  *
  * # Arguments
  * - `vm`: Valid VM instance
@@ -406,6 +902,146 @@ MocaResult moca_save_file(MocaVm *vm,
                           const char *path)
 ;
 
+/**
+ * Load a persistent JIT code cache and attach it to the VM.
+ *
+ * Functions and loops whose bytecode matches a cache entry run as native
+ * code from their first call instead of waiting for the JIT threshold.
+ * Entries apply to chunks loaded afterwards and to the current chunk. Code
+ * compiled while the cache is attached is added to it; write it back with
+ * `moca_save_jit_cache`. Entries are keyed by bytecode and CPU, so the cache
+ * can be shared by every process running the same moca build on the same
+ * kind of machine.
+ *
+ * A missing file, or a file written by another moca build or for another
+ * CPU, attaches an empty cache.
+ *
+ * # Arguments
+ * - `vm`: Valid VM instance
+ * - `path`: Path to the cache file (null-terminated)
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if path is NULL
+ * - `MOCA_ERROR_VERIFY` if the file is not a valid JIT cache
+ * - `MOCA_ERROR_RUNTIME` if the JIT is not available on this platform
+ */
+
+MocaResult moca_load_jit_cache(MocaVm *vm,
+                               const char *path)
+;
+
+/**
+ * Save the attached JIT code cache to a file.
+ *
+ * # Arguments
+ * - `vm`: Valid VM instance
+ * - `path`: Path to the cache file (null-terminated)
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if path is NULL or no cache is attached
+ * - `MOCA_ERROR_RUNTIME` if the file cannot be written
+ */
+
+MocaResult moca_save_jit_cache(MocaVm *vm,
+                               const char *path)
+;
+
+/**
+ * Create a pool of VM instances from an initialized VM.
+ *
+ * The template VM must have bytecode loaded. Its heap, globals and
+ * registered host functions are captured as with `moca_vm_snapshot()`;
+ * later changes to the template do not affect the pool. `size` instances
+ * are created up front, and at most `size` idle instances are kept (rounded
+ * up to a power of two).
+ *
+ * Returns NULL if `vm` is NULL or has no bytecode loaded. The pool must be
+ * freed with `moca_pool_free()`.
+ *
+ * # Example (C)
+ * ```c
+ * MocaPool *pool = moca_pool_new(vm, 64);
+ *
+ * // On each request thread
+ * MocaVm *worker = moca_pool_checkout(pool);
+ * moca_push_i64(worker, 42);
+ * moca_call(worker, "handle", 1);
+ * moca_pool_checkin(pool, worker);
+ * ```
+ */
+
+MocaPool *moca_pool_new(const MocaVm *vm,
+                        uintptr_t size)
+;
+
+/**
+ * Take a VM instance out of the pool.
+ *
+ * Reuses an idle instance if there is one and creates a new one from the
+ * template otherwise. The instance keeps the heap and globals left by its
+ * previous user; its stack and last error are empty. Until it is checked
+ * in, only the calling thread may use it.
+ *
+ * Returns NULL if `pool` is NULL.
+ *
+ * # Thread safety
+ *
+ * May be called from any number of threads at once.
+ */
+
+MocaVm *moca_pool_checkout(MocaPool *pool)
+;
+
+/**
+ * Return a VM instance to the pool.
+ *
+ * Clears the instance's stack, last error and error callback and adds the
+ * GC work it did to the pool statistics. If the pool already holds its
+ * maximum number of idle instances, the instance is freed. The `vm`
+ * pointer must not be used after this call.
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if an argument is NULL or `vm` is not checked
+ *   out of `pool` (the VM is left untouched)
+ *
+ * # Thread safety
+ *
+ * May be called from any number of threads at once.
+ */
+
+MocaResult moca_pool_checkin(MocaPool *pool,
+                             MocaVm *vm)
+;
+
+/**
+ * Read the aggregate statistics of a pool.
+ *
+ * The counters are read one by one while other threads may be checking
+ * instances in and out, so they are only consistent with each other when
+ * the pool is quiet.
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if an argument is NULL
+ */
+
+MocaResult moca_pool_stats(const MocaPool *pool,
+                           MocaPoolStats *out)
+;
+
+/**
+ * Free a pool and its idle instances.
+ *
+ * All checked-out instances must have been checked in first; an instance
+ * that is still out must not be checked in afterwards.
+ */
+
+void moca_pool_free(MocaPool *pool)
+;
+
 /**
  * Push a null value onto the stack.
  */
@@ -440,8 +1076,10 @@ void moca_push_f64(MocaVm *vm,
 /**
  * Push a string value onto the stack.
  *
- * The string is copied into the VM's heap. The caller retains ownership
- * of the original string.
+ * The bytes are copied into the VM's heap in one pass. The caller retains
+ * ownership of the original string. Invalid UTF-8 sequences are replaced
+ * with U+FFFD. If the string does not fit under the VM's memory limit, null
+ * is pushed instead and the error is set.
  *
  * # Arguments
  * - `vm`: Valid VM instance
@@ -537,6 +1175,8 @@ double moca_to_f64(MocaVm *vm,
  *
  * Returns NULL if the value is not a string or index is invalid.
  * The returned pointer is valid until the next GC or stack modification.
+ * It is not null-terminated. Strings backed by a byte array are returned
+ * without copying (see `moca_string_view`).
  *
  * # Arguments
  * - `vm`: Valid VM instance
@@ -549,6 +1189,28 @@ const char *moca_to_string(MocaVm *vm,
                            uintptr_t *len)
 ;
 
+/**
+ * Borrow the bytes of the string at the given index without copying.
+ *
+ * The returned pointer points straight into the VM heap and is valid until
+ * the next GC point: any call into the VM, any push of a string, or loading
+ * bytecode. It is not null-terminated.
+ *
+ * # Arguments
+ * - `vm`: Valid VM instance
+ * - `index`: Stack index
+ * - `len`: Output parameter for the length in bytes (can be NULL)
+ *
+ * # Returns
+ * Pointer to the string bytes, or NULL if the value is not a string backed
+ * by a byte array or the index is invalid.
+ */
+
+const uint8_t *moca_string_view(MocaVm *vm,
+                                int32_t index,
+                                uintptr_t *len)
+;
+
 /**
  * Pop values from the stack.
  *
@@ -617,17 +1279,271 @@ void moca_vm_free(MocaVm *vm)
 ;
 
 /**
- * Set the memory limit for the VM.
+ * Capture the state of an initialized VM.
  *
- * This must be called before loading bytecode.
+ * The snapshot holds a copy of the loaded bytecode, the heap, globals
+ * (including those set with `moca_set_global`) and registered host
+ * functions. The FFI stack, the error callback and JIT code are not
+ * captured. The source VM is not modified and can keep running.
+ *
+ * Returns NULL if `vm` is NULL or has no bytecode loaded. The snapshot must
+ * be freed with `moca_snapshot_free()`.
+ */
+
+MocaSnapshot *moca_vm_snapshot(const MocaVm *vm)
+;
+
+/**
+ * Create a new VM instance starting from a snapshot.
+ *
+ * The heap is copied from the snapshot in a single pass, so this is much
+ * cheaper than loading the bytecode and re-running initialization code.
+ * The snapshot stays valid and can start any number of VMs.
+ *
+ * Returns NULL if `snapshot` is NULL. The returned VM must be freed with
+ * `moca_vm_free()`.
+ */
+
+MocaVm *moca_vm_new_from_snapshot(const MocaSnapshot *snapshot)
+;
+
+/**
+ * Free a snapshot.
+ *
+ * VMs created from the snapshot are independent and stay valid.
+ */
+
+void moca_snapshot_free(MocaSnapshot *snapshot)
+;
+
+/**
+ * Create a new VM instance with a copy of an initialized VM's state.
+ *
+ * Equivalent to `moca_vm_snapshot()` followed by
+ * `moca_vm_new_from_snapshot()` and `moca_snapshot_free()`. Returns NULL if
+ * `vm` is NULL or has no bytecode loaded.
+ */
+
+MocaVm *moca_vm_clone(const MocaVm *vm)
+;
+
+/**
+ * Set the hard memory limit for the VM.
+ *
+ * An allocation that would take the heap past the limit fails with a
+ * runtime error. Unless a soft limit is set, collections start once the
+ * heap reaches 3/4 of the limit, so garbage is freed before allocations
+ * fail. VMs created from a snapshot or pool inherit the limits of the VM
+ * the snapshot was taken from.
  *
  * # Arguments
  * - `vm`: Valid VM instance
- * - `bytes`: Maximum memory in bytes (0 = no limit)
+ * - `bytes`: Maximum heap size in bytes (0 = no limit)
  */
 
 void moca_set_memory_limit(MocaVm *vm,
-                           uintptr_t _bytes)
+                           uintptr_t bytes)
+;
+
+/**
+ * Set the soft memory limit for the VM.
+ *
+ * Once the heap reaches the soft limit a collection starts at the next
+ * safepoint, even if the regular GC threshold is higher. The soft limit is
+ * capped at the hard limit.
+ *
+ * # Arguments
+ * - `vm`: Valid VM instance
+ * - `bytes`: Soft limit in bytes (0 = 3/4 of the hard limit)
+ */
+
+void moca_set_soft_memory_limit(MocaVm *vm,
+                                uintptr_t bytes)
+;
+
+/**
+ * Read heap usage and GC counters.
+ *
+ * Counting objects walks the heap, so this takes time proportional to the
+ * heap size.
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if an argument is NULL
+ */
+
+MocaResult moca_get_heap_stats(const MocaVm *vm,
+                               MocaHeapStats *out)
+;
+
+/**
+ * Read the VM's runtime counters.
+ *
+ * The counters are kept as the VM runs, so this is cheap enough to call on
+ * every scrape of a metrics endpoint.
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if an argument is NULL
+ */
+
+MocaResult moca_get_metrics(const MocaVm *vm,
+                            MocaMetrics *out)
+;
+
+/**
+ * Set the callback that receives runtime events.
+ *
+ * The VM reports GC pauses as they start and end, JIT compilations with
+ * the function name and code size, tier changes, and heap growth. The
+ * callback runs on the thread running the VM, in the middle of execution,
+ * and must not call back into the VM. Threads spawned by moca code do not
+ * report events.
+ *
+ * The callback and `userdata` move with the VM. If the host hands the VM
+ * to another thread, the callback runs on that thread, so `userdata` must
+ * be safe to use there.
+ *
+ * # Arguments
+ * - `vm`: Valid VM instance
+ * - `callback`: Event callback (or NULL to disable)
+ * - `userdata`: User data passed to the callback
+ */
+
+void moca_set_event_callback(MocaVm *vm,
+                             MocaEventFn callback,
+                             void *userdata)
+;
+
+/**
+ * Enable or disable incremental garbage collection.
+ *
+ * When enabled, collections mark and sweep in small steps between
+ * instructions instead of pausing the VM for a whole collection. Disabled by
+ * default.
+ *
+ * # Arguments
+ * - `vm`: Valid VM instance
+ * - `enabled`: Whether to collect incrementally
+ */
+
+void moca_set_incremental_gc(MocaVm *vm,
+                             bool enabled)
+;
+
+/**
+ * Set how the VM buffers stdout.
+ *
+ * A new VM is line buffered when stdout is a terminal and block buffered
+ * otherwise. Whatever the mode, buffered output is flushed before every
+ * call into the VM returns. `MOCA_BUFFER_MODE_UNBUFFERED` also sends each
+ * write to a file or socket right away instead of coalescing consecutive
+ * writes into one `writev`.
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if `vm` is NULL
+ * - `MOCA_ERROR_RUNTIME` if flushing the buffered output failed
+ */
+
+MocaResult moca_set_output_buffering(MocaVm *vm,
+                                     MocaBufferMode mode)
+;
+
+/**
+ * Write out everything the VM has buffered.
+ *
+ * Only needed for output written by a host function that is still running;
+ * the VM flushes before each call into it returns.
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if `vm` is NULL
+ * - `MOCA_ERROR_RUNTIME` if a write failed
+ */
+
+MocaResult moca_flush_output(MocaVm *vm)
+;
+
+/**
+ * Start sampling the VM's call stacks.
+ *
+ * A timer thread requests a sample every `interval_us` microseconds and
+ * the VM takes it at its next safepoint, recording the function of every
+ * frame. Samples from an earlier run of the profiler are dropped.
+ *
+ * # Arguments
+ * - `vm`: Valid VM instance
+ * - `interval_us`: Sampling interval (0 = 1000us)
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if `vm` is NULL
+ */
+
+MocaResult moca_profiler_start(MocaVm *vm,
+                               uint32_t interval_us)
+;
+
+/**
+ * Stop sampling. The samples taken stay available to
+ * `moca_profiler_dump()`.
+ */
+
+void moca_profiler_stop(MocaVm *vm)
+;
+
+/**
+ * Write the sampled call stacks to `path` in folded-stack format.
+ *
+ * Each line is `outer;inner;leaf count`, as read by flamegraph.pl and
+ * inferno. The profiler may still be running.
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if an argument is NULL or `path` is not UTF-8
+ * - `MOCA_ERROR_RUNTIME` if the file could not be written
+ */
+
+MocaResult moca_profiler_dump(MocaVm *vm,
+                              const char *path)
+;
+
+/**
+ * Start writing `/tmp/perf-<pid>.map`, so `perf` can name JIT code.
+ *
+ * Applies to the whole process: code compiled from then on by any VM gets
+ * a `start size name` line.
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_RUNTIME` if the map could not be opened
+ */
+
+MocaResult moca_enable_perf_map(void)
+;
+
+/**
+ * Send the VM's stdout into a host-owned ring buffer instead of the
+ * process stdout.
+ *
+ * Output buffered so far is flushed to the old destination first. The VM
+ * writes at `head` and never blocks on a full ring: bytes that do not fit
+ * are counted in `dropped`. The ring and its `data` must stay valid until
+ * another ring is installed or the VM is freed. Threads spawned by moca
+ * code still write to the process stdout.
+ *
+ * # Arguments
+ * - `vm`: Valid VM instance
+ * - `ring`: Ring with `data` and `capacity` set, or NULL to go back to stdout
+ *
+ * # Returns
+ * - `MOCA_OK` on success
+ * - `MOCA_ERROR_INVALID_ARG` if `vm` is NULL, or `ring` has no storage
+ */
+
+MocaResult moca_set_output_ring(MocaVm *vm,
+                                MocaOutputRing *ring)
 ;
 
 /**
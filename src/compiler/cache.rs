@@ -0,0 +1,233 @@
+//! On-disk cache of compiled programs.
+//!
+//! With `moca run --compile-cache`, the bytecode of a program is saved after
+//! the first compile and loaded by the next run instead of compiling again.
+//! The typechecker and monomorphiser see the whole program at once (imported
+//! modules are merged into the main file's items), so the unit of caching
+//! is a program, not a module.
+//!
+//! Each entry lists every source file that went into the program (the main
+//! file and all modules it reaches through imports) with a hash of its
+//! contents. A lookup hashes those files again and uses the bytecode only
+//! if all of them are unchanged, so an edit anywhere in the import graph
+//! invalidates the programs that depend on it. Entries are named by a hash
+//! of the main file's path, the optimization level, the stdlib prelude, the
+//! bytecode format version and the moca build (its version plus a hash of
+//! the sources it was built from, set by build.rs), so a rebuilt compiler
+//! never picks up bytecode an older one wrote under the same version.
+//!
+//! File layout (little-endian):
+//!   magic "MCCC", version: u32, count: u32,
+//!   then per source: path_len: u32, path: [u8; path_len], hash: u64,
+//!   then the bytecode (`vm::bytecode` format) up to the end of the file
+
+use super::STDLIB_PRELUDE;
+use crate::config::OptLevel;
+use crate::vm::fnv::Fnv;
+use crate::vm::{BytecodeSource, Chunk, bytecode};
+use std::path::{Path, PathBuf};
+use std::sync::Arc;
+
+const MAGIC: &[u8; 4] = b"MCCC";
+const VERSION: u32 = 2;
+
+/// Cache directory used when `--compile-cache` is given without one.
+pub const DEFAULT_DIR: &str = ".moca-cache";
+
+/// Hash of a source file's contents.
+pub fn content_hash(bytes: &[u8]) -> u64 {
+    let mut h = Fnv::new();
+    h.write(bytes);
+    h.finish()
+}
+
+/// Compiled programs in a cache directory.
+pub struct CompileCache {
+    dir: PathBuf,
+}
+
+impl CompileCache {
+    pub fn new(dir: impl Into<PathBuf>) -> Self {
+        Self { dir: dir.into() }
+    }
+
+    /// The entry file for the program whose main file is `main_path`.
+    fn entry_path(&self, main_path: &Path, opt_level: OptLevel) -> PathBuf {
+        let main_path = main_path
+            .canonicalize()
+            .unwrap_or_else(|_| main_path.to_path_buf());
+        let mut h = Fnv::new();
+        h.write(env!("CARGO_PKG_VERSION").as_bytes());
+        h.write(env!("MOCA_BUILD_HASH").as_bytes());
+        h.write(&bytecode::VERSION.to_le_bytes());
+        h.write(STDLIB_PRELUDE.as_bytes());
+        h.write(&[opt_level as u8]);
+        h.write(main_path.to_string_lossy().as_bytes());
+        self.dir.join(format!("{:016x}.mcc", h.finish()))
+    }
+
+    /// The cached bytecode of the program at `main_path`, if there is an
+    /// entry and none of its sources changed since. A stale, unreadable or
+    /// corrupt entry is a miss.
+    pub fn load(&self, main_path: &Path, opt_level: OptLevel) -> Option<Chunk> {
+        let mut data = std::fs::read(self.entry_path(main_path, opt_level)).ok()?;
+        let (sources, code_start) = parse_header(&data)?;
+        let fresh = sources.iter().all(|(path, hash)| {
+            std::fs::read(path).is_ok_and(|source| content_hash(&source) == *hash)
+        });
+        if !fresh {
+            return None;
+        }
+        let code = data.split_off(code_start);
+        let chunk = bytecode::load(Arc::new(BytecodeSource::from_vec(code))).ok()?;
+        // Bodies are decoded lazily; a corrupt one is a miss, not an error
+        // in the middle of the run
+        let intact = chunk
+            .functions
+            .iter()
+            .chain([&chunk.main])
+            .all(|func| func.code.decode().is_ok());
+        intact.then_some(chunk)
+    }
+
+    /// Save `chunk`, compiled from `sources` (paths with content hashes),
+    /// as the entry for the program at `main_path`.
+    pub fn store(
+        &self,
+        main_path: &Path,
+        opt_level: OptLevel,
+        sources: &[(PathBuf, u64)],
+        chunk: &Chunk,
+    ) -> Result<(), String> {
+        let mut out = Vec::new();
+        out.extend_from_slice(MAGIC);
+        out.extend_from_slice(&VERSION.to_le_bytes());
+        out.extend_from_slice(&(sources.len() as u32).to_le_bytes());
+        for (path, hash) in sources {
+            let path = path.to_string_lossy();
+            out.extend_from_slice(&(path.len() as u32).to_le_bytes());
+            out.extend_from_slice(path.as_bytes());
+            out.extend_from_slice(&hash.to_le_bytes());
+        }
+        out.extend_from_slice(&bytecode::serialize(chunk));
+
+        // Write to a temporary file and rename it into place, so a
+        // concurrent run never reads a partial entry
+        let entry = self.entry_path(main_path, opt_level);
+        let temp = entry.with_extension(format!("tmp{}", std::process::id()));
+        std::fs::create_dir_all(&self.dir)
+            .and_then(|()| std::fs::write(&temp, &out))
+            .and_then(|()| std::fs::rename(&temp, &entry))
+            .map_err(|e| format!("cannot write compile cache: {}", e))
+    }
+}
+
+/// The sources listed in an entry, and where its bytecode starts.
+fn parse_header(data: &[u8]) -> Option<(Vec<(PathBuf, u64)>, usize)> {
+    let mut pos = 0;
+    let mut take = |len: usize| {
+        let bytes = data.get(pos..pos + len)?;
+        pos += len;
+        Some(bytes)
+    };
+    let u32_at = |bytes: &[u8]| u32::from_le_bytes(bytes.try_into().unwrap());
+
+    if take(4)? != MAGIC || u32_at(take(4)?) != VERSION {
+        return None;
+    }
+    let count = u32_at(take(4)?) as usize;
+    let mut sources = Vec::with_capacity(count.min(1024));
+    for _ in 0..count {
+        let len = u32_at(take(4)?) as usize;
+        let path = std::str::from_utf8(take(len)?).ok()?;
+        let hash = u64::from_le_bytes(take(8)?.try_into().unwrap());
+        sources.push((PathBuf::from(path), hash));
+    }
+    Some((sources, pos))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::compiler::ModuleLoader;
+    use crate::vm::{Function, Op};
+    use std::fs;
+
+    fn chunk() -> Chunk {
+        Chunk {
+            functions: vec![],
+            main: Function {
+                name: "__main__".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: vec![Op::I64Const(42), Op::Drop].into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec!["hello".to_string()].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        }
+    }
+
+    #[test]
+    fn test_hit_until_a_module_changes() {
+        let temp = tempfile::tempdir().unwrap();
+        let root = temp.path();
+        fs::write(root.join("main.mc"), "import a;\nprint(fn_a());").unwrap();
+        fs::write(
+            root.join("a.mc"),
+            "import b;\nfun fn_a() { return fn_b(); }",
+        )
+        .unwrap();
+        fs::write(root.join("b.mc"), "fun fn_b() { return 1; }").unwrap();
+
+        let main = root.join("main.mc");
+        let mut loader = ModuleLoader::new(root.to_path_buf());
+        loader.load_with_imports(&main).unwrap();
+        assert_eq!(loader.sources().len(), 3);
+
+        let cache = CompileCache::new(root.join("cache"));
+        assert!(cache.load(&main, OptLevel::O0).is_none());
+        cache
+            .store(&main, OptLevel::O0, loader.sources(), &chunk())
+            .unwrap();
+
+        let cached = cache.load(&main, OptLevel::O0).expect("cache hit");
+        assert_eq!(cached.main.code, *chunk().main.code);
+        assert_eq!(cached.strings.get(0), Some("hello"));
+        assert!(cache.load(&main, OptLevel::O2).is_none());
+
+        // An edit to a transitive import invalidates the entry
+        fs::write(root.join("b.mc"), "fun fn_b() { return 2; }").unwrap();
+        assert!(cache.load(&main, OptLevel::O0).is_none());
+    }
+
+    #[test]
+    fn test_corrupt_entry_is_a_miss() {
+        let temp = tempfile::tempdir().unwrap();
+        let main = temp.path().join("main.mc");
+        fs::write(&main, "print(1);").unwrap();
+
+        let cache = CompileCache::new(temp.path());
+        fs::write(
+            cache.entry_path(&main, OptLevel::O0),
+            b"MCCC\x02\x00\x00\x00\xff",
+        )
+        .unwrap();
+        assert!(cache.load(&main, OptLevel::O0).is_none());
+
+        // A damaged function body is a miss too
+        let sources = [(main.clone(), content_hash(b"print(1);"))];
+        cache
+            .store(&main, OptLevel::O0, &sources, &chunk())
+            .unwrap();
+        assert!(cache.load(&main, OptLevel::O0).is_some());
+        let entry = cache.entry_path(&main, OptLevel::O0);
+        let mut data = fs::read(&entry).unwrap();
+        *data.last_mut().unwrap() = 0xff;
+        fs::write(&entry, data).unwrap();
+        assert!(cache.load(&main, OptLevel::O0).is_none());
+    }
+}
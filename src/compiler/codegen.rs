@@ -5,6 +5,7 @@ use crate::compiler::resolver::{
     ResolvedStatement, ResolvedStruct,
 };
 use crate::compiler::types::Type;
+use crate::vm::bulk::BulkOp;
 use crate::vm::{Chunk, DebugInfo, ElemKind, Function, FunctionDebugInfo, Op, ValueType};
 use std::collections::HashMap;
 
@@ -42,6 +43,14 @@ fn elem_kind_for_ptr(object_type: &Option<Type>, fallback: Option<ElemKind>) ->
 
 /// Determine ElemKind for a collection (Array/Vec) based on its element type.
 fn elem_kind_for_collection(object_type: &Option<Type>) -> ElemKind {
+    // Array data (other than string bytes) comes from array literals, which
+    // HeapAlloc allocates with tagged slots whatever the element type
+    if object_type
+        .as_ref()
+        .is_some_and(|t| t.is_array() && !t.is_string())
+    {
+        return ElemKind::Tagged;
+    }
     let elem_type = object_type
         .as_ref()
         .and_then(|t| t.collection_element_type());
@@ -243,11 +252,24 @@ impl Codegen {
             ResolvedExpr::AssociatedFunctionCall { .. } => ValueType::Ref,
             ResolvedExpr::SpawnFunc { .. } => ValueType::I64,
             ResolvedExpr::Builtin { name, .. } => match name.as_str() {
-                "len" | "argc" | "__umul128_hi" | "__typeof" | "__heap_size" => ValueType::I64,
+                "len" | "argc" | "__umul128_hi" | "__typeof" | "__heap_size" | "__heap_find" => {
+                    ValueType::I64
+                }
                 "channel" | "recv" | "argv" | "args" | "__alloc_heap" | "__alloc_string"
                 | "__null_ptr" | "__ptr_offset" => ValueType::Ref,
                 "__heap_load" => ValueType::I64, // Returns raw slot value; type unknown at compile time
-                "send" | "join" | "print" | "__heap_store" => ValueType::Ref, // returns null
+                "send"
+                | "join"
+                | "print"
+                | "__heap_store"
+                | "__channel_send_many"
+                | "__heap_fill"
+                | "__heap_copy"
+                | "__heap_add_f64"
+                | "__heap_mul_f64"
+                | "__heap_fma_f64" => {
+                    ValueType::Ref // returns null
+                }
                 _ => ValueType::I64,
             },
             ResolvedExpr::AsmBlock { .. } => ValueType::I64,
@@ -524,7 +546,7 @@ impl Codegen {
             name: "__main__".to_string(),
             arity: 0,
             locals_count: self.current_locals_count,
-            code: main_ops,
+            code: main_ops.into(),
             stackmap: None, // TODO: generate StackMap
             local_types: main_local_types,
         };
@@ -538,7 +560,7 @@ impl Codegen {
         Ok(Chunk {
             functions: self.functions.clone(),
             main: main_func,
-            strings: self.strings.clone(),
+            strings: self.strings.clone().into(),
             type_descriptors: self.type_descriptors.clone(),
             interface_descriptors: self.interface_descriptors.clone(),
             debug,
@@ -621,7 +643,7 @@ impl Codegen {
             name: func.name.clone(),
             arity: func.params.len(),
             locals_count: self.current_locals_count,
-            code: ops,
+            code: ops.into(),
             stackmap: None, // TODO: generate StackMap
             local_types,
         })
@@ -1473,12 +1495,16 @@ impl Codegen {
                         // spawn is handled specially in resolver as SpawnFunc
                         return Err("spawn should be resolved to SpawnFunc".to_string());
                     }
-                    "channel" => {
-                        if !args.is_empty() {
-                            return Err("channel takes no arguments".to_string());
+                    "channel" => match args.len() {
+                        0 => ops.push(Op::ChannelCreate),
+                        1 => {
+                            self.compile_expr(&args[0], ops)?;
+                            ops.push(Op::ChannelCreateBounded);
                         }
-                        ops.push(Op::ChannelCreate);
-                    }
+                        _ => {
+                            return Err("channel takes at most 1 argument (capacity)".to_string());
+                        }
+                    },
                     "send" => {
                         if args.len() != 2 {
                             return Err(
@@ -1498,6 +1524,27 @@ impl Codegen {
                         self.compile_expr(&args[0], ops)?;
                         ops.push(Op::ChannelRecv);
                     }
+                    "__channel_send_many" => {
+                        // __channel_send_many(ch, data, count): send data[0..count]
+                        if args.len() != 3 {
+                            return Err("__channel_send_many takes exactly 3 arguments (channel_id, data, count)".to_string());
+                        }
+                        for arg in args {
+                            self.compile_expr(arg, ops)?;
+                        }
+                        ops.push(Op::ChannelSendMany);
+                        ops.push(Op::RefNull);
+                    }
+                    "__channel_recv_many" => {
+                        // __channel_recv_many(ch, data, max) -> number received into data[0..]
+                        if args.len() != 3 {
+                            return Err("__channel_recv_many takes exactly 3 arguments (channel_id, data, max)".to_string());
+                        }
+                        for arg in args {
+                            self.compile_expr(arg, ops)?;
+                        }
+                        ops.push(Op::ChannelRecvMany);
+                    }
                     "join" => {
                         if args.len() != 1 {
                             return Err("join takes exactly 1 argument (handle)".to_string());
@@ -1531,6 +1578,22 @@ impl Codegen {
                         ops.push(Op::HeapStoreDyn(ElemKind::Tagged));
                         ops.push(Op::RefNull); // returns nil
                     }
+                    "__heap_fill" | "__heap_copy" | "__heap_equal" | "__heap_find"
+                    | "__heap_add_f64" | "__heap_mul_f64" | "__heap_fma_f64" => {
+                        // __heap_<op>(...): one HeapBulk op, operands as in BulkOp
+                        let op = BulkOp::from_name(&name["__heap_".len()..])
+                            .ok_or_else(|| format!("unknown bulk builtin {}", name))?;
+                        if args.len() != op.arity() {
+                            return Err(format!("{} takes exactly {} arguments", name, op.arity()));
+                        }
+                        for arg in args {
+                            self.compile_expr(arg, ops)?;
+                        }
+                        ops.push(Op::HeapBulk(op));
+                        if !op.has_result() {
+                            ops.push(Op::RefNull); // returns nil
+                        }
+                    }
                     "__alloc_heap" => {
                         // __alloc_heap(size) -> ref to newly allocated heap object with size slots
                         if args.len() != 1 {
@@ -2040,6 +2103,12 @@ impl Codegen {
             }
             "HeapLoadDyn" => Ok(Op::HeapLoadDyn(ElemKind::Tagged)),
             "HeapStoreDyn" => Ok(Op::HeapStoreDyn(ElemKind::Tagged)),
+            "HeapBulk" => {
+                let name = self.expect_string_arg(args, 0, "HeapBulk")?;
+                BulkOp::from_name(&name)
+                    .map(Op::HeapBulk)
+                    .ok_or_else(|| format!("unknown bulk op '{}'", name))
+            }
 
             // Type operations
             // Exception handling
@@ -2071,8 +2140,11 @@ impl Codegen {
                 Ok(Op::ThreadSpawn(func_index))
             }
             "ChannelCreate" => Ok(Op::ChannelCreate),
+            "ChannelCreateBounded" => Ok(Op::ChannelCreateBounded),
             "ChannelSend" => Ok(Op::ChannelSend),
             "ChannelRecv" => Ok(Op::ChannelRecv),
+            "ChannelSendMany" => Ok(Op::ChannelSendMany),
+            "ChannelRecvMany" => Ok(Op::ChannelRecvMany),
             "ThreadJoin" => Ok(Op::ThreadJoin),
 
             // Hostcall
@@ -2210,7 +2282,7 @@ mod tests {
     fn test_string_literal() {
         let chunk = compile("__typeof(\"hello\");").unwrap();
         assert!(chunk.main.code.contains(&Op::StringConst(0)));
-        assert_eq!(chunk.strings[0], "hello");
+        assert_eq!(&chunk.strings[0], "hello");
     }
 
     #[test]
@@ -2218,8 +2290,8 @@ mod tests {
         let chunk = compile("__typeof(\"foo\"); __typeof(\"bar\");").unwrap();
         assert!(chunk.main.code.contains(&Op::StringConst(0)));
         assert!(chunk.main.code.contains(&Op::StringConst(1)));
-        assert_eq!(chunk.strings[0], "foo");
-        assert_eq!(chunk.strings[1], "bar");
+        assert_eq!(&chunk.strings[0], "foo");
+        assert_eq!(&chunk.strings[1], "bar");
     }
 
     #[test]
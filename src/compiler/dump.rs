@@ -6,6 +6,7 @@ use crate::compiler::ast::{
     BinaryOp, Block, Expr, FnDef, ImplBlock, Import, Item, Param, Program, Statement, StructDef,
     UnaryOp,
 };
+use crate::compiler::optimize::OptReport;
 use crate::compiler::resolver::{
     ResolvedExpr, ResolvedFunction, ResolvedProgram, ResolvedStatement, ResolvedStruct,
 };
@@ -1733,12 +1734,7 @@ impl<'a> Disassembler<'a> {
             Op::F64Const(v) => self.output.push_str(&format!("F64Const {}", v)),
             Op::RefNull => self.output.push_str("RefNull"),
             Op::StringConst(idx) => {
-                let s = self
-                    .chunk
-                    .strings
-                    .get(*idx)
-                    .map(|s| s.as_str())
-                    .unwrap_or("<?>");
+                let s = self.chunk.strings.get(*idx).unwrap_or("<?>");
                 let escaped = s.replace('\n', "\\n").replace('\t', "\\t");
                 self.output
                     .push_str(&format!("StringConst {} ; \"{}\"", idx, escaped));
@@ -1873,6 +1869,7 @@ impl<'a> Disassembler<'a> {
             Op::HeapLoad2(_) => self.output.push_str("HeapLoad2"),
             Op::HeapStore2(_) => self.output.push_str("HeapStore2"),
             Op::HeapOffsetRef => self.output.push_str("HeapOffsetRef"),
+            Op::HeapBulk(op) => self.output.push_str(&format!("HeapBulk {}", op.name())),
             // System / Builtins
             Op::Hostcall(num, argc) => self.output.push_str(&format!("Hostcall {} {}", num, argc)),
             Op::GcHint(size) => self.output.push_str(&format!("GcHint {}", size)),
@@ -1901,8 +1898,11 @@ impl<'a> Disassembler<'a> {
                     .push_str(&format!("ThreadSpawn {} ; {}", func_idx, func_name));
             }
             Op::ChannelCreate => self.output.push_str("ChannelCreate"),
+            Op::ChannelCreateBounded => self.output.push_str("ChannelCreateBounded"),
             Op::ChannelSend => self.output.push_str("ChannelSend"),
             Op::ChannelRecv => self.output.push_str("ChannelRecv"),
+            Op::ChannelSendMany => self.output.push_str("ChannelSendMany"),
+            Op::ChannelRecvMany => self.output.push_str("ChannelRecvMany"),
             Op::ThreadJoin => self.output.push_str("ThreadJoin"),
 
             // Closures
@@ -1930,6 +1930,45 @@ pub fn format_bytecode(chunk: &Chunk) -> String {
     disassembler.disassemble().to_string()
 }
 
+/// Format what the bytecode optimizer did: op counts before and after, in
+/// total and for each function it changed.
+pub fn format_opt_report(report: &OptReport) -> String {
+    let change = |before: usize, after: usize| {
+        if before == 0 {
+            0.0
+        } else {
+            (after as f64 - before as f64) * 100.0 / before as f64
+        }
+    };
+    let (before, after) = (report.ops_before(), report.ops_after());
+    let mut output = format!("== Optimization (-{:?}) ==\n", report.level);
+    output.push_str(&format!(
+        "total: {} -> {} ops ({:+.1}%), {} calls inlined\n",
+        before,
+        after,
+        change(before, after),
+        report.inlined_calls()
+    ));
+    for func in &report.functions {
+        if func.ops_before == func.ops_after && func.inlined_calls == 0 {
+            continue;
+        }
+        output.push_str(&format!(
+            "  {}: {} -> {} ops ({:+.1}%)",
+            func.name,
+            func.ops_before,
+            func.ops_after,
+            change(func.ops_before, func.ops_after)
+        ));
+        if func.inlined_calls > 0 {
+            output.push_str(&format!(", {} calls inlined", func.inlined_calls));
+        }
+        output.push('\n');
+    }
+    output.push('\n');
+    output
+}
+
 /// Format a chunk as disassembled MicroOp (register-based IR) string.
 pub fn format_microops(chunk: &Chunk) -> String {
     let mut output = String::new();
@@ -2017,7 +2056,9 @@ fn format_single_microop(output: &mut String, mop: &MicroOp, chunk: &Chunk) {
             Some(s) => output.push_str(&format!("Ret {}", format_vreg(s))),
             None => output.push_str("Ret"),
         },
-        MicroOp::CallIndirect { callee, args, ret } => {
+        MicroOp::CallIndirect {
+            callee, args, ret, ..
+        } => {
             let args_str: Vec<String> = args.iter().map(format_vreg).collect();
             let ret_str = match ret {
                 Some(r) => format!(" → {}", format_vreg(r)),
@@ -2034,6 +2075,7 @@ fn format_single_microop(output: &mut String, mop: &MicroOp, chunk: &Chunk) {
             func_idx,
             args,
             ret,
+            ..
         } => {
             let args_str: Vec<String> = args.iter().map(format_vreg).collect();
             let ret_str = match ret {
@@ -2303,6 +2345,71 @@ fn format_single_microop(output: &mut String, mop: &MicroOp, chunk: &Chunk) {
             format_vreg(a),
             format_vreg(b)
         )),
+        // Superinstructions
+        MicroOp::CmpI64BrIfFalse {
+            dst,
+            a,
+            b,
+            cond,
+            target,
+        } => output.push_str(&format!(
+            "CmpI64BrIfFalse.{} {}, {}, {}, target={}",
+            format_cond(cond),
+            format_vreg(dst),
+            format_vreg(a),
+            format_vreg(b),
+            target
+        )),
+        MicroOp::CmpI64ImmBrIfFalse {
+            dst,
+            a,
+            imm,
+            cond,
+            target,
+        } => output.push_str(&format!(
+            "CmpI64ImmBrIfFalse.{} {}, {}, {}, target={}",
+            format_cond(cond),
+            format_vreg(dst),
+            format_vreg(a),
+            imm,
+            target
+        )),
+        MicroOp::CmpF64BrIfFalse {
+            dst,
+            a,
+            b,
+            cond,
+            target,
+        } => output.push_str(&format!(
+            "CmpF64BrIfFalse.{} {}, {}, {}, target={}",
+            format_cond(cond),
+            format_vreg(dst),
+            format_vreg(a),
+            format_vreg(b),
+            target
+        )),
+        MicroOp::MulF64AddF64 { tmp, a, b, c, dst } => output.push_str(&format!(
+            "MulF64AddF64 {}, {}, {}, {}, {}",
+            format_vreg(tmp),
+            format_vreg(a),
+            format_vreg(b),
+            format_vreg(c),
+            format_vreg(dst)
+        )),
+        MicroOp::ConstF64MulF64 { tmp, imm, dst, a } => output.push_str(&format!(
+            "ConstF64MulF64 {}, {}, {}, {}",
+            format_vreg(tmp),
+            imm,
+            format_vreg(dst),
+            format_vreg(a)
+        )),
+        MicroOp::ConstF64DivF64 { tmp, imm, dst, a } => output.push_str(&format!(
+            "ConstF64DivF64 {}, {}, {}, {}",
+            format_vreg(tmp),
+            imm,
+            format_vreg(dst),
+            format_vreg(a)
+        )),
 
         // Type conversions
         MicroOp::I32WrapI64 { dst, src }
@@ -2450,6 +2557,20 @@ fn format_single_microop(output: &mut String, mop: &MicroOp, chunk: &Chunk) {
             format_vreg(dst),
             format_vreg(size)
         )),
+        MicroOp::HeapBulk { dst, op, args } => {
+            let args_str: Vec<String> = args.iter().map(format_vreg).collect();
+            match dst {
+                Some(dst) => output.push_str(&format!(
+                    "HeapBulk {} {}, [{}]",
+                    op.name(),
+                    format_vreg(dst),
+                    args_str.join(", ")
+                )),
+                None => {
+                    output.push_str(&format!("HeapBulk {} [{}]", op.name(), args_str.join(", ")))
+                }
+            }
+        }
         MicroOp::GlobalGet { dst, idx } => {
             let td_count = chunk.type_descriptors.len();
             let comment = if *idx < td_count {
@@ -2476,6 +2597,7 @@ fn format_single_microop(output: &mut String, mop: &MicroOp, chunk: &Chunk) {
             dst,
             type_info,
             iface_desc,
+            ..
         } => {
             output.push_str(&format!(
                 "{} = VtableLookup {}, {}",
@@ -2662,6 +2784,27 @@ mod tests {
         assert!(output.contains("TypeOf"));
     }
 
+    #[test]
+    fn test_opt_report() {
+        use crate::compiler::optimize;
+        use crate::config::OptLevel;
+
+        let mut chunk =
+            compile("fun sq(x) { return x * x; } let k = 2 + 3; __typeof(sq(k) + sq(k));");
+        let report = optimize::optimize(&mut chunk, OptLevel::O2);
+        let output = format_opt_report(&report);
+        assert!(output.starts_with("== Optimization (-O2) ==\n"));
+        assert!(output.contains(&format!(
+            "total: {} -> {} ops",
+            report.ops_before(),
+            report.ops_after()
+        )));
+        assert!(output.contains("2 calls inlined"));
+        assert!(output.contains("  __main__: "));
+        assert!(report.ops_after() < report.ops_before());
+        assert!(!format_bytecode(&chunk).contains("Call 0, 1 ; sq"));
+    }
+
     #[test]
     fn test_bytecode_function() {
         let chunk = compile("fun add(a, b) { return a + b; } __typeof(add(1, 2));");
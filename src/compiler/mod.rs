@@ -2,6 +2,7 @@
 #![allow(dead_code)]
 
 pub mod ast;
+pub mod cache;
 mod codegen;
 pub mod desugar;
 pub mod dump;
@@ -9,6 +10,7 @@ pub mod lexer;
 pub mod linter;
 mod module;
 pub mod monomorphise;
+pub mod optimize;
 mod parser;
 pub mod resolver;
 pub mod typechecker;
@@ -25,10 +27,28 @@ pub use typechecker::TypeChecker;
 pub const STDLIB_PRELUDE: &str = include_str!("../../std/prelude.mc");
 
 use crate::compiler::ast::{Item, Program};
-use crate::config::{CompilerTimings, JitMode, RuntimeConfig, TimingsFormat};
+use crate::compiler::cache::CompileCache;
+use crate::config::{
+    CompilerTimings, GcMode, JitMode, OptLevel, OutputBuffering, RuntimeConfig, TimingsFormat,
+};
 use std::collections::HashSet;
 use std::time::Instant;
 
+/// The parsed stdlib prelude. It is parsed once per process; the language
+/// server and test runs prepend it to every program they check.
+fn stdlib_program() -> Result<&'static Program, String> {
+    static STDLIB: OnceLock<Result<Program, String>> = OnceLock::new();
+    STDLIB
+        .get_or_init(|| {
+            let mut lexer = Lexer::new("<stdlib>", STDLIB_PRELUDE);
+            let tokens = lexer.scan_tokens()?;
+            let mut parser = Parser::new("<stdlib>", tokens);
+            parser.parse()
+        })
+        .as_ref()
+        .map_err(Clone::clone)
+}
+
 /// Parse and prepend stdlib to a user program.
 /// The stdlib functions are added at the beginning so they are available globally.
 /// If a user function has the same name as a stdlib function, the stdlib function is skipped.
@@ -46,16 +66,10 @@ pub(crate) fn prepend_stdlib(mut user_program: Program) -> Result<Program, Strin
         })
         .collect();
 
-    // Parse the stdlib prelude
-    let mut lexer = Lexer::new("<stdlib>", STDLIB_PRELUDE);
-    let tokens = lexer.scan_tokens()?;
-    let mut parser = Parser::new("<stdlib>", tokens);
-    let stdlib_program = parser.parse()?;
-
     // Filter out stdlib functions that conflict with user functions
-    let filtered_stdlib_items: Vec<Item> = stdlib_program
+    let filtered_stdlib_items: Vec<Item> = stdlib_program()?
         .items
-        .into_iter()
+        .iter()
         .filter(|item| {
             if let Item::FnDef(fn_def) = item {
                 !user_fn_names.contains(&fn_def.name)
@@ -63,6 +77,7 @@ pub(crate) fn prepend_stdlib(mut user_program: Program) -> Result<Program, Strin
                 true
             }
         })
+        .cloned()
         .collect();
 
     // Prepend filtered stdlib items to user program
@@ -72,11 +87,14 @@ pub(crate) fn prepend_stdlib(mut user_program: Program) -> Result<Program, Strin
 
     Ok(user_program)
 }
-use crate::vm::VM;
+use crate::vm::output::BufferMode;
+use crate::vm::profiler::{self, SamplingProfiler};
+use crate::vm::tiering::TierPolicy;
+use crate::vm::{Chunk, OpcodeProfile, VM};
 use std::fs::File;
 use std::io::{Cursor, Write};
 use std::path::{Path, PathBuf};
-use std::sync::{Arc, Mutex};
+use std::sync::{Arc, Mutex, OnceLock};
 
 /// Options for dumping intermediate representations.
 ///
@@ -141,10 +159,11 @@ pub fn run(filename: &str, source: &str) -> Result<(), String> {
 
     // Code generation
     let mut codegen = Codegen::new();
-    let chunk = codegen.compile(resolved)?;
+    let chunk = Arc::new(codegen.compile(resolved)?);
 
     // Execution
     let mut vm = VM::new();
+    vm.share_chunk(chunk.clone());
     vm.run(&chunk)?;
 
     Ok(())
@@ -214,7 +233,9 @@ pub fn run_file_capturing_output(
 
         // Code generation
         let mut codegen = Codegen::new();
-        let chunk = codegen.compile(resolved)?;
+        let mut chunk = codegen.compile(resolved)?;
+        optimize::optimize(&mut chunk, config.opt_level);
+        let chunk = Arc::new(chunk);
 
         // Execution with output capture using wrappers that write to shared buffers
         let mut vm = VM::new_with_config(
@@ -223,13 +244,15 @@ pub fn run_file_capturing_output(
             Box::new(SharedWriter(stdout_clone)),
             Box::new(SharedWriter(stderr_clone)),
         );
-        vm.set_jit_config(
-            config.jit_mode != JitMode::Off,
-            config.jit_threshold,
-            config.trace_jit,
-        );
+        vm.set_incremental_gc(config.gc_mode == GcMode::Concurrent);
+        set_output_buffering(&mut vm, config.output_buffering);
+        set_jit_config(&mut vm, config);
 
-        vm.run(&chunk)?;
+        vm.share_chunk(chunk.clone());
+        start_profiling(&mut vm, config)?;
+        let result = vm.run(&chunk);
+        write_sample_profile(&mut vm, &chunk, config)?;
+        result?;
 
         Ok(vm.jit_compile_count())
     })();
@@ -266,42 +289,90 @@ impl Write for SharedWriter {
     }
 }
 
-/// Compile and run a file with import support and runtime configuration.
-pub fn run_file_with_config(path: &Path, config: &RuntimeConfig) -> Result<(), String> {
-    let root_dir = path.parent().unwrap_or(Path::new(".")).to_path_buf();
-    let mut loader = ModuleLoader::new(root_dir);
-
-    // Load main file with all imports
-    let user_program = loader.load_with_imports(path)?;
-
-    // Prepend standard library
-    let mut program = prepend_stdlib(user_program)?;
-
-    let filename = path.to_string_lossy().to_string();
+/// Apply `--output-buffering`. `Auto` keeps the VM's default: line
+/// buffered on a terminal, block buffered otherwise.
+fn set_output_buffering(vm: &mut VM, buffering: OutputBuffering) {
+    let mode = match buffering {
+        OutputBuffering::Auto => return,
+        OutputBuffering::Unbuffered => BufferMode::Unbuffered,
+        OutputBuffering::Line => BufferMode::Line,
+        OutputBuffering::Block => BufferMode::Block,
+    };
+    let _ = vm.set_output_buffering(mode);
+}
 
-    // Type checking (writes inferred types to AST)
-    let mut typechecker = TypeChecker::new(&filename);
-    typechecker
-        .check_program(&mut program)
-        .map_err(|errors| format_type_errors(&filename, &errors))?;
+/// Apply the JIT settings of `config`.
+fn set_jit_config(vm: &mut VM, config: &RuntimeConfig) {
+    vm.set_jit_config(
+        config.jit_mode != JitMode::Off,
+        config.jit_threshold,
+        config.trace_jit,
+    );
+    if let Some(osr_threshold) = config.jit_osr_threshold {
+        vm.set_tier_policy(TierPolicy {
+            call_threshold: config.jit_threshold,
+            osr_threshold,
+        });
+    }
+    vm.set_background_jit(config.jit_background);
+}
 
-    // Desugar (expand syntax sugar like new literals, index operations)
-    let program = desugar::desugar_program(program);
+/// Start the sampling profiler and the perf map if `config` asks for them.
+fn start_profiling(vm: &mut VM, config: &RuntimeConfig) -> Result<(), String> {
+    if config.perf_map {
+        profiler::enable_perf_map().map_err(|e| format!("failed to open perf map: {}", e))?;
+    }
+    if config.sample_profile.is_some() {
+        vm.start_sampling(SamplingProfiler::DEFAULT_INTERVAL);
+    }
+    Ok(())
+}
 
-    // Monomorphisation (specialize generic functions/structs)
-    let program = monomorphise::monomorphise_program(program);
+/// Opcode pairs listed by `--profile-opcodes`
+const PROFILED_PAIRS: usize = 20;
 
-    // Name resolution
-    let mut resolver = Resolver::new(&filename);
-    resolver.set_interface_info(
-        typechecker.interface_impls().clone(),
-        typechecker.interface_method_names(),
+/// Print the opcode counts and the most frequent opcode pairs to stderr.
+fn print_opcode_profile(profile: &OpcodeProfile) {
+    eprintln!("\n== Opcode Profile ==");
+    eprintln!(
+        "Total instructions executed: {}",
+        profile.total_instructions()
     );
-    let resolved = resolver.resolve(program)?;
+    eprintln!("\nExecution counts by opcode:");
+    eprintln!("{:<20} {:>15} {:>10}", "Opcode", "Count", "Percent");
+    eprintln!("{:-<47}", "");
+    let total = profile.total_instructions() as f64;
+    for (name, count) in profile.sorted_by_count() {
+        let percent = (count as f64 / total) * 100.0;
+        eprintln!("{:<20} {:>15} {:>9.2}%", name, count, percent);
+    }
+    eprintln!("\nMost frequent opcode pairs:");
+    eprintln!("{:<40} {:>15} {:>10}", "Pair", "Count", "Percent");
+    eprintln!("{:-<67}", "");
+    for ((first, second), count) in profile
+        .sorted_pairs_by_count()
+        .into_iter()
+        .take(PROFILED_PAIRS)
+    {
+        let percent = (count as f64 / total) * 100.0;
+        let pair = format!("{} -> {}", first, second);
+        eprintln!("{:<40} {:>15} {:>9.2}%", pair, count, percent);
+    }
+}
 
-    // Code generation
-    let mut codegen = Codegen::new();
-    let chunk = codegen.compile(resolved)?;
+/// Write the call stacks sampled by `vm` to `config.sample_profile`.
+fn write_sample_profile(vm: &mut VM, chunk: &Chunk, config: &RuntimeConfig) -> Result<(), String> {
+    let Some(path) = &config.sample_profile else {
+        return Ok(());
+    };
+    vm.stop_sampling();
+    std::fs::write(path, vm.folded_stacks(chunk))
+        .map_err(|e| format!("failed to write profile to {}: {}", path.display(), e))
+}
+
+/// Compile and run a file with import support and runtime configuration.
+pub fn run_file_with_config(path: &Path, config: &RuntimeConfig) -> Result<(), String> {
+    let chunk = Arc::new(compile_path(path, config)?);
 
     // Log JIT settings if tracing is enabled
     if config.trace_jit {
@@ -313,36 +384,85 @@ pub fn run_file_with_config(path: &Path, config: &RuntimeConfig) -> Result<(), S
 
     // Execution with runtime configuration
     let mut vm = VM::new_with_heap_config(config.heap_limit, config.gc_enabled);
-    vm.set_jit_config(
-        config.jit_mode != JitMode::Off,
-        config.jit_threshold,
-        config.trace_jit,
-    );
+    vm.set_incremental_gc(config.gc_mode == GcMode::Concurrent);
+    set_output_buffering(&mut vm, config.output_buffering);
+    set_jit_config(&mut vm, config);
 
-    vm.run(&chunk)?;
+    vm.share_chunk(chunk.clone());
+    start_profiling(&mut vm, config)?;
+    let result = vm.run(&chunk);
+    write_sample_profile(&mut vm, &chunk, config)?;
+    result?;
 
     // Print GC stats if requested
     if config.gc_stats {
         let stats = vm.gc_stats();
         eprintln!(
-            "[GC] Collections: {}, Total pause: {}us, Max pause: {}us",
-            stats.cycles, stats.total_pause_us, stats.max_pause_us
+            "[GC] Collections: {}, Minor: {}, Total pause: {}us, Max pause: {}us",
+            stats.cycles, stats.minor_cycles, stats.total_pause_us, stats.max_pause_us
+        );
+        eprintln!(
+            "[GC] Pauses: {}, p50: <{}us, p99: <{}us",
+            stats.pauses.count(),
+            stats.pauses.percentile_us(0.50),
+            stats.pauses.percentile_us(0.99)
         );
     }
 
     Ok(())
 }
 
-/// Compile and run a file with dump options.
-pub fn run_file_with_dump(
+/// Compile the program at `path` and its imports to bytecode without
+/// running it.
+pub fn compile_path(path: &Path, config: &RuntimeConfig) -> Result<Chunk, String> {
+    compile_file(
+        path,
+        config,
+        &DumpOptions::default(),
+        &mut CompilerTimings::default(),
+    )
+}
+
+/// Compile the program at `path`, or take it from the compile cache when
+/// `config` enables one, nothing is to be dumped and the entry is up to date.
+fn compile_file(
     path: &Path,
     config: &RuntimeConfig,
     dump_opts: &DumpOptions,
-    cli_args: Vec<String>,
-    timings_format: Option<TimingsFormat>,
-) -> Result<(), String> {
-    let mut timings = CompilerTimings::default();
+    timings: &mut CompilerTimings,
+) -> Result<Chunk, String> {
+    let cache = config.compile_cache.as_ref().map(CompileCache::new);
+    if let Some(cache) = &cache
+        && !dump_opts.any_enabled()
+    {
+        let start = Instant::now();
+        let cached = cache.load(path, config.opt_level);
+        timings.cache += start.elapsed();
+        if let Some(chunk) = cached {
+            return Ok(chunk);
+        }
+    }
+
+    let (chunk, sources) = compile_file_uncached(path, config, dump_opts, timings)?;
+    if let Some(cache) = &cache {
+        let start = Instant::now();
+        if let Err(e) = cache.store(path, config.opt_level, &sources, &chunk) {
+            eprintln!("warning: {}", e);
+        }
+        timings.cache += start.elapsed();
+    }
+    Ok(chunk)
+}
 
+/// Compile the program at `path` with its imports and the stdlib, writing
+/// the requested dumps. Also returns the source files read, with their
+/// content hashes.
+fn compile_file_uncached(
+    path: &Path,
+    config: &RuntimeConfig,
+    dump_opts: &DumpOptions,
+    timings: &mut CompilerTimings,
+) -> Result<(Chunk, Vec<(PathBuf, u64)>), String> {
     let root_dir = path.parent().unwrap_or(Path::new(".")).to_path_buf();
     let mut loader = ModuleLoader::new(root_dir);
 
@@ -411,12 +531,20 @@ pub fn run_file_with_dump(
     // Code generation
     let start = Instant::now();
     let mut codegen = Codegen::new();
-    let chunk = codegen.compile(resolved)?;
+    let mut chunk = codegen.compile(resolved)?;
     timings.codegen = start.elapsed();
 
+    // Bytecode optimization
+    let start = Instant::now();
+    let report = optimize::optimize(&mut chunk, config.opt_level);
+    timings.optimize = start.elapsed();
+
     // Dump bytecode if requested
     if let Some(ref output_path) = dump_opts.dump_bytecode {
-        let bytecode_str = dump::format_bytecode(&chunk);
+        let mut bytecode_str = dump::format_bytecode(&chunk);
+        if report.level > OptLevel::O0 {
+            bytecode_str.insert_str(0, &dump::format_opt_report(&report));
+        }
         write_dump(&bytecode_str, output_path.as_ref(), "Bytecode")?;
     }
 
@@ -426,6 +554,20 @@ pub fn run_file_with_dump(
         write_dump(&microops_str, output_path.as_ref(), "MicroOps")?;
     }
 
+    Ok((chunk, loader.sources().to_vec()))
+}
+
+/// Compile and run a file with dump options.
+pub fn run_file_with_dump(
+    path: &Path,
+    config: &RuntimeConfig,
+    dump_opts: &DumpOptions,
+    cli_args: Vec<String>,
+    timings_format: Option<TimingsFormat>,
+) -> Result<(), String> {
+    let mut timings = CompilerTimings::default();
+    let chunk = Arc::new(compile_file(path, config, dump_opts, &mut timings)?);
+
     // Log JIT settings if tracing is enabled
     if config.trace_jit {
         eprintln!(
@@ -436,43 +578,38 @@ pub fn run_file_with_dump(
 
     // Execution with runtime configuration
     let mut vm = VM::new_with_heap_config(config.heap_limit, config.gc_enabled);
-    vm.set_jit_config(
-        config.jit_mode != JitMode::Off,
-        config.jit_threshold,
-        config.trace_jit,
-    );
+    vm.set_incremental_gc(config.gc_mode == GcMode::Concurrent);
+    set_output_buffering(&mut vm, config.output_buffering);
+    set_jit_config(&mut vm, config);
     vm.set_profile_opcodes(config.profile_opcodes);
     vm.set_cli_args(cli_args);
 
+    vm.share_chunk(chunk.clone());
+    start_profiling(&mut vm, config)?;
     let start = Instant::now();
-    vm.run(&chunk)?;
+    let result = vm.run(&chunk);
     timings.execution = start.elapsed();
+    write_sample_profile(&mut vm, &chunk, config)?;
+    result?;
 
     // Print GC stats if requested
     if config.gc_stats {
         let stats = vm.gc_stats();
         eprintln!(
-            "[GC] Collections: {}, Total pause: {}us, Max pause: {}us",
-            stats.cycles, stats.total_pause_us, stats.max_pause_us
+            "[GC] Collections: {}, Minor: {}, Total pause: {}us, Max pause: {}us",
+            stats.cycles, stats.minor_cycles, stats.total_pause_us, stats.max_pause_us
+        );
+        eprintln!(
+            "[GC] Pauses: {}, p50: <{}us, p99: <{}us",
+            stats.pauses.count(),
+            stats.pauses.percentile_us(0.50),
+            stats.pauses.percentile_us(0.99)
         );
     }
 
     // Print opcode profile if requested
     if config.profile_opcodes {
-        let profile = vm.opcode_profile();
-        eprintln!("\n== Opcode Profile ==");
-        eprintln!(
-            "Total instructions executed: {}",
-            profile.total_instructions()
-        );
-        eprintln!("\nExecution counts by opcode:");
-        eprintln!("{:<20} {:>15} {:>10}", "Opcode", "Count", "Percent");
-        eprintln!("{:-<47}", "");
-        let total = profile.total_instructions() as f64;
-        for (name, count) in profile.sorted_by_count() {
-            let percent = (count as f64 / total) * 100.0;
-            eprintln!("{:<20} {:>15} {:>9.2}%", name, count, percent);
-        }
+        print_opcode_profile(vm.opcode_profile());
     }
 
     // Print timings if requested
@@ -557,12 +694,21 @@ pub fn run_source(
     // Code generation
     let start = Instant::now();
     let mut codegen = Codegen::new();
-    let chunk = codegen.compile(resolved)?;
+    let mut chunk = codegen.compile(resolved)?;
     timings.codegen = start.elapsed();
 
+    // Bytecode optimization
+    let start = Instant::now();
+    let report = optimize::optimize(&mut chunk, config.opt_level);
+    timings.optimize = start.elapsed();
+    let chunk = Arc::new(chunk);
+
     // Dump bytecode if requested
     if let Some(ref output_path) = dump_opts.dump_bytecode {
-        let bytecode_str = dump::format_bytecode(&chunk);
+        let mut bytecode_str = dump::format_bytecode(&chunk);
+        if report.level > OptLevel::O0 {
+            bytecode_str.insert_str(0, &dump::format_opt_report(&report));
+        }
         write_dump(&bytecode_str, output_path.as_ref(), "Bytecode")?;
     }
 
@@ -582,43 +728,38 @@ pub fn run_source(
 
     // Execution with runtime configuration
     let mut vm = VM::new_with_heap_config(config.heap_limit, config.gc_enabled);
-    vm.set_jit_config(
-        config.jit_mode != JitMode::Off,
-        config.jit_threshold,
-        config.trace_jit,
-    );
+    vm.set_incremental_gc(config.gc_mode == GcMode::Concurrent);
+    set_output_buffering(&mut vm, config.output_buffering);
+    set_jit_config(&mut vm, config);
     vm.set_profile_opcodes(config.profile_opcodes);
     vm.set_cli_args(cli_args);
 
+    vm.share_chunk(chunk.clone());
+    start_profiling(&mut vm, config)?;
     let start = Instant::now();
-    vm.run(&chunk)?;
+    let result = vm.run(&chunk);
     timings.execution = start.elapsed();
+    write_sample_profile(&mut vm, &chunk, config)?;
+    result?;
 
     // Print GC stats if requested
     if config.gc_stats {
         let stats = vm.gc_stats();
         eprintln!(
-            "[GC] Collections: {}, Total pause: {}us, Max pause: {}us",
-            stats.cycles, stats.total_pause_us, stats.max_pause_us
+            "[GC] Collections: {}, Minor: {}, Total pause: {}us, Max pause: {}us",
+            stats.cycles, stats.minor_cycles, stats.total_pause_us, stats.max_pause_us
+        );
+        eprintln!(
+            "[GC] Pauses: {}, p50: <{}us, p99: <{}us",
+            stats.pauses.count(),
+            stats.pauses.percentile_us(0.50),
+            stats.pauses.percentile_us(0.99)
         );
     }
 
     // Print opcode profile if requested
     if config.profile_opcodes {
-        let profile = vm.opcode_profile();
-        eprintln!("\n== Opcode Profile ==");
-        eprintln!(
-            "Total instructions executed: {}",
-            profile.total_instructions()
-        );
-        eprintln!("\nExecution counts by opcode:");
-        eprintln!("{:<20} {:>15} {:>10}", "Opcode", "Count", "Percent");
-        eprintln!("{:-<47}", "");
-        let total = profile.total_instructions() as f64;
-        for (name, count) in profile.sorted_by_count() {
-            let percent = (count as f64 / total) * 100.0;
-            eprintln!("{:<20} {:>15} {:>9.2}%", name, count, percent);
-        }
+        print_opcode_profile(vm.opcode_profile());
     }
 
     // Print timings if requested
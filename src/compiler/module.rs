@@ -1,8 +1,10 @@
 use crate::compiler::ast::{Import, Item, Program};
+use crate::compiler::cache::content_hash;
 use crate::compiler::lexer::Lexer;
 use crate::compiler::parser::Parser;
 use std::collections::{HashMap, HashSet};
 use std::path::{Path, PathBuf};
+use std::thread;
 use std::time::{Duration, Instant};
 
 /// Timing information from loading modules
@@ -12,6 +14,40 @@ pub struct LoadTimings {
     pub parser: Duration,
 }
 
+/// A parsed source file.
+struct ParsedFile {
+    program: Program,
+    /// Content hash of the source
+    hash: u64,
+    lexer: Duration,
+    parser: Duration,
+}
+
+/// Read, lex and parse the file at `path`.
+fn parse_file(path: &Path) -> Result<ParsedFile, String> {
+    let source = std::fs::read_to_string(path)
+        .map_err(|e| format!("failed to read module '{}': {}", path.display(), e))?;
+
+    let filename = path.to_string_lossy().to_string();
+
+    let start = Instant::now();
+    let mut lexer = Lexer::new(&filename, &source);
+    let tokens = lexer.scan_tokens()?;
+    let lexer_time = start.elapsed();
+
+    let start = Instant::now();
+    let mut parser = Parser::new(&filename, tokens);
+    let program = parser.parse()?;
+    let parser_time = start.elapsed();
+
+    Ok(ParsedFile {
+        program,
+        hash: content_hash(source.as_bytes()),
+        lexer: lexer_time,
+        parser: parser_time,
+    })
+}
+
 /// A module loader that resolves import paths and loads module files.
 pub struct ModuleLoader {
     /// Root directory for the project
@@ -20,6 +56,8 @@ pub struct ModuleLoader {
     cache: HashMap<PathBuf, Program>,
     /// Search paths for modules
     search_paths: Vec<PathBuf>,
+    /// Every file read so far with the hash of its contents, in load order
+    sources: Vec<(PathBuf, u64)>,
 }
 
 impl ModuleLoader {
@@ -39,9 +77,16 @@ impl ModuleLoader {
             root_dir,
             cache: HashMap::new(),
             search_paths,
+            sources: Vec::new(),
         }
     }
 
+    /// The files read so far (the main file and the modules it reached)
+    /// with the content hash of each, in load order.
+    pub fn sources(&self) -> &[(PathBuf, u64)] {
+        &self.sources
+    }
+
     /// Resolve an import to a file path.
     pub fn resolve_import(&self, import: &Import, from_file: &Path) -> Result<PathBuf, String> {
         if import.relative {
@@ -110,28 +155,79 @@ impl ModuleLoader {
             return Ok(self.cache.get(&canonical).unwrap());
         }
 
-        // Read and parse the file
-        let source = std::fs::read_to_string(path)
-            .map_err(|e| format!("failed to read module '{}': {}", path.display(), e))?;
-
-        let filename = path.to_string_lossy().to_string();
-
-        let start = Instant::now();
-        let mut lexer = Lexer::new(&filename, &source);
-        let tokens = lexer.scan_tokens()?;
+        let parsed = parse_file(path)?;
         if let Some(ref mut t) = timings {
-            t.lexer += start.elapsed();
+            t.lexer += parsed.lexer;
+            t.parser += parsed.parser;
         }
+        self.sources.push((canonical.clone(), parsed.hash));
 
-        let start = Instant::now();
-        let mut parser = Parser::new(&filename, tokens);
-        let program = parser.parse()?;
-        if let Some(t) = timings {
-            t.parser += start.elapsed();
+        self.cache.insert(canonical.clone(), parsed.program);
+        Ok(self.cache.get(&canonical).unwrap())
+    }
+
+    /// Parse the modules `program` (the file at `from_file`) imports, and
+    /// theirs, ahead of `collect_module_items`. Each level of the import
+    /// graph is parsed in parallel. Imports that fail to resolve or parse
+    /// are skipped here; loading them again reports the error.
+    fn prefetch_imports(
+        &mut self,
+        program: &Program,
+        from_file: &Path,
+        load_timings: &mut LoadTimings,
+    ) {
+        let mut seen = HashSet::new();
+        let mut pending = self.resolved_imports(program, from_file, &mut seen);
+        while !pending.is_empty() {
+            let workers = thread::available_parallelism().map_or(1, |n| n.get());
+            let batch = pending.len().div_ceil(workers);
+            let parsed: Vec<(PathBuf, ParsedFile)> = thread::scope(|scope| {
+                let handles: Vec<_> = pending
+                    .chunks(batch)
+                    .map(|paths| {
+                        scope.spawn(move || {
+                            paths
+                                .iter()
+                                .filter_map(|path| Some((path.clone(), parse_file(path).ok()?)))
+                                .collect::<Vec<_>>()
+                        })
+                    })
+                    .collect();
+                handles
+                    .into_iter()
+                    .flat_map(|handle| handle.join().unwrap_or_default())
+                    .collect()
+            });
+
+            pending = Vec::new();
+            for (path, file) in parsed {
+                load_timings.lexer += file.lexer;
+                load_timings.parser += file.parser;
+                pending.extend(self.resolved_imports(&file.program, &path, &mut seen));
+                self.sources.push((path.clone(), file.hash));
+                self.cache.insert(path, file.program);
+            }
         }
+    }
 
-        self.cache.insert(canonical.clone(), program);
-        Ok(self.cache.get(&canonical).unwrap())
+    /// Canonical paths of the imports of `program` that are neither loaded
+    /// nor in `seen`, which they are added to.
+    fn resolved_imports(
+        &self,
+        program: &Program,
+        from_file: &Path,
+        seen: &mut HashSet<PathBuf>,
+    ) -> Vec<PathBuf> {
+        program
+            .items
+            .iter()
+            .filter_map(|item| match item {
+                Item::Import(import) => self.resolve_import(import, from_file).ok(),
+                _ => None,
+            })
+            .map(|path| path.canonicalize().unwrap_or(path))
+            .filter(|path| !self.cache.contains_key(path) && seen.insert(path.clone()))
+            .collect()
     }
 
     /// Load all imports for a program and return a combined program.
@@ -164,9 +260,17 @@ impl ModuleLoader {
             let program = parser.parse()?;
             load_timings.parser += start.elapsed();
 
+            let canonical = main_path
+                .canonicalize()
+                .unwrap_or_else(|_| main_path.to_path_buf());
+            self.sources
+                .push((canonical, content_hash(source.as_bytes())));
+
             program
         };
 
+        self.prefetch_imports(&main_program, main_path, &mut load_timings);
+
         // Collect imports
         let imports: Vec<_> = main_program
             .items
@@ -486,6 +590,61 @@ mod tests {
         fs::remove_dir_all(&temp).ok();
     }
 
+    #[test]
+    fn test_sources_of_parallel_loads() {
+        let temp = temp_dir().join("moca_module_test_sources");
+        if temp.exists() {
+            fs::remove_dir_all(&temp).unwrap();
+        }
+        fs::create_dir_all(&temp.join("src")).unwrap();
+
+        // Four modules on one level of the import graph, sharing a fifth
+        let names = ["a", "b", "c", "d"];
+        let imports: String = names.iter().map(|n| format!("import {};\n", n)).collect();
+        fs::write(temp.join("src/main.mc"), format!("{}print(1);", imports)).unwrap();
+        for name in names {
+            fs::write(
+                temp.join(format!("src/{}.mc", name)),
+                format!(
+                    "import shared;\nfun fn_{}() {{ return shared_fn(); }}",
+                    name
+                ),
+            )
+            .unwrap();
+        }
+        fs::write(temp.join("src/shared.mc"), "fun shared_fn() { return 1; }").unwrap();
+
+        let mut loader = ModuleLoader::new(temp.clone());
+        let program = loader.load_with_imports(&temp.join("src/main.mc")).unwrap();
+
+        // Items keep import order however the modules were parsed
+        let fn_names: Vec<&str> = program
+            .items
+            .iter()
+            .filter_map(|i| {
+                if let Item::FnDef(f) = i {
+                    Some(f.name.as_str())
+                } else {
+                    None
+                }
+            })
+            .collect();
+        assert_eq!(fn_names, vec!["shared_fn", "fn_a", "fn_b", "fn_c", "fn_d"]);
+
+        let mut files: Vec<String> = loader
+            .sources()
+            .iter()
+            .map(|(path, _)| path.file_name().unwrap().to_string_lossy().to_string())
+            .collect();
+        files.sort();
+        assert_eq!(
+            files,
+            vec!["a.mc", "b.mc", "c.mc", "d.mc", "main.mc", "shared.mc"]
+        );
+
+        fs::remove_dir_all(&temp).ok();
+    }
+
     #[test]
     fn test_circular_import_detection() {
         let temp = temp_dir().join("moca_module_test_circular");
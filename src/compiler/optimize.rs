@@ -0,0 +1,897 @@
+//! Bytecode optimizer.
+//!
+//! Rewrites the `Op` sequences codegen emits, one function at a time:
+//!
+//! - constant folding of arithmetic, comparisons and conversions on
+//!   constants, and of branches on constant conditions
+//! - constant propagation of locals set to a constant, within a basic block
+//! - dead-code elimination: unreachable blocks, stores to locals that are
+//!   never read, values pushed only to be dropped, jumps to the next op
+//! - `LocalSet n; LocalGet n` on a local read nowhere else, which leaves the
+//!   value on the stack instead
+//! - at `-O2`, inlining of small, non-recursive functions at their call sites
+//!
+//! The passes run in rounds until none of them changes anything. They never
+//! merge ops across a jump target and never turn a forward jump into a
+//! backward one, since the VM finds loops by their backward jumps. Functions
+//! using `Pick`/`PickDyn` (inline asm) may reach into their frame through the
+//! operand stack and are left alone.
+
+use crate::config::OptLevel;
+use crate::vm::verifier::Verifier;
+use crate::vm::{Chunk, Function, Op, ValueType};
+use std::collections::HashMap;
+
+/// Largest function body inlined at `-O2`
+const MAX_INLINE_OPS: usize = 16;
+
+/// Callers stop growing by inlining at this many ops
+const MAX_INLINED_CALLER_OPS: usize = 4096;
+
+/// Upper bound on rounds of the passes over one function
+const MAX_ROUNDS: usize = 32;
+
+/// Op counts of one function before and after optimization.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct FunctionReport {
+    pub name: String,
+    pub ops_before: usize,
+    pub ops_after: usize,
+    /// Call sites replaced by the callee's body
+    pub inlined_calls: usize,
+}
+
+/// What `optimize` did to a chunk; main comes last.
+#[derive(Debug, Clone, Default)]
+pub struct OptReport {
+    pub level: OptLevel,
+    pub functions: Vec<FunctionReport>,
+}
+
+impl OptReport {
+    pub fn ops_before(&self) -> usize {
+        self.functions.iter().map(|f| f.ops_before).sum()
+    }
+
+    pub fn ops_after(&self) -> usize {
+        self.functions.iter().map(|f| f.ops_after).sum()
+    }
+
+    pub fn inlined_calls(&self) -> usize {
+        self.functions.iter().map(|f| f.inlined_calls).sum()
+    }
+}
+
+/// Optimize every function of `chunk` at `level`.
+pub fn optimize(chunk: &mut Chunk, level: OptLevel) -> OptReport {
+    let mut report = OptReport {
+        level,
+        functions: Vec::new(),
+    };
+    if level == OptLevel::O0 {
+        return report;
+    }
+
+    let Chunk {
+        functions, main, ..
+    } = chunk;
+    for func in functions.iter_mut().chain(std::iter::once(&mut *main)) {
+        report.functions.push(FunctionReport {
+            name: func.name.clone(),
+            ops_before: func.code.len(),
+            ops_after: 0,
+            inlined_calls: 0,
+        });
+        simplify(func);
+    }
+
+    if level >= OptLevel::O2 {
+        let inlinees: Vec<Option<Inlinee>> = functions
+            .iter()
+            .enumerate()
+            .map(|(index, func)| Inlinee::new(index, func))
+            .collect();
+        for (func, entry) in functions
+            .iter_mut()
+            .chain(std::iter::once(&mut *main))
+            .zip(&mut report.functions)
+        {
+            entry.inlined_calls = inline_calls(func, &inlinees);
+            if entry.inlined_calls > 0 {
+                simplify(func);
+            }
+        }
+    }
+
+    for (func, entry) in functions
+        .iter()
+        .chain(std::iter::once(&*main))
+        .zip(&mut report.functions)
+    {
+        entry.ops_after = func.code.len();
+    }
+    report
+}
+
+/// Run the -O1 passes over `func` until they stop finding work.
+fn simplify(func: &mut Function) {
+    if !rewritable(func) {
+        return;
+    }
+    let code: &mut Vec<Op> = &mut func.code;
+    for _ in 0..MAX_ROUNDS {
+        let mut changed = fold(code);
+        changed |= propagate_constants(code);
+        changed |= remove_dead_locals(code);
+        changed |= remove_unreachable(code);
+        if !changed {
+            break;
+        }
+    }
+}
+
+/// Whether the passes may rewrite `func`: inline asm can address the frame
+/// through the operand stack, and a stack map is indexed by pc.
+fn rewritable(func: &Function) -> bool {
+    func.stackmap.is_none()
+        && !func
+            .code
+            .iter()
+            .any(|op| matches!(op, Op::Pick(_) | Op::PickDyn))
+}
+
+// ============================================================================
+// Control flow helpers
+// ============================================================================
+
+fn jump_target(op: &Op) -> Option<usize> {
+    match *op {
+        Op::Jmp(t) | Op::BrIf(t) | Op::BrIfFalse(t) | Op::TryBegin(t) => Some(t),
+        _ => None,
+    }
+}
+
+fn jump_target_mut(op: &mut Op) -> Option<&mut usize> {
+    match op {
+        Op::Jmp(t) | Op::BrIf(t) | Op::BrIfFalse(t) | Op::TryBegin(t) => Some(t),
+        _ => None,
+    }
+}
+
+/// Ops that some jump (or exception handler) lands on.
+fn jump_targets(code: &[Op]) -> Vec<bool> {
+    let mut targets = vec![false; code.len() + 1];
+    for op in code {
+        if let Some(t) = jump_target(op) {
+            targets[t.min(code.len())] = true;
+        }
+    }
+    targets
+}
+
+/// Where control can go after the op at `pc`.
+fn successors(code: &[Op], pc: usize) -> impl Iterator<Item = usize> {
+    let (next, target) = match code[pc] {
+        Op::Jmp(t) => (None, Some(t)),
+        Op::BrIf(t) | Op::BrIfFalse(t) | Op::TryBegin(t) => (Some(pc + 1), Some(t)),
+        Op::Ret | Op::Throw => (None, None),
+        _ => (Some(pc + 1), None),
+    };
+    let len = code.len();
+    next.into_iter()
+        .chain(target)
+        .filter(move |&succ| succ < len)
+}
+
+/// Replace `code` with the ops left in `edited` (None = removed). A jump to
+/// a removed op goes to the next op that is kept; passes only remove ops
+/// for which that is the same thing.
+fn compact(code: &mut Vec<Op>, edited: Vec<Option<Op>>) {
+    let mut new_pc = vec![0; edited.len() + 1];
+    let mut kept = edited.iter().filter(|op| op.is_some()).count();
+    new_pc[edited.len()] = kept;
+    for pc in (0..edited.len()).rev() {
+        if edited[pc].is_some() {
+            kept -= 1;
+            new_pc[pc] = kept;
+        } else {
+            new_pc[pc] = new_pc[pc + 1];
+        }
+    }
+    *code = edited
+        .into_iter()
+        .flatten()
+        .map(|mut op| {
+            if let Some(t) = jump_target_mut(&mut op) {
+                *t = new_pc[(*t).min(new_pc.len() - 1)];
+            }
+            op
+        })
+        .collect();
+}
+
+// ============================================================================
+// Folding and peepholes
+// ============================================================================
+
+fn is_constant(op: &Op) -> bool {
+    matches!(
+        op,
+        Op::I32Const(_) | Op::I64Const(_) | Op::F32Const(_) | Op::F64Const(_) | Op::RefNull
+    )
+}
+
+/// Ops that only push a value.
+fn is_pure_push(op: &Op) -> bool {
+    is_constant(op)
+        || matches!(
+            op,
+            Op::LocalGet(_) | Op::StringConst(_) | Op::GlobalGet(_) | Op::Dup
+        )
+}
+
+fn bool_const(b: bool) -> Op {
+    Op::I32Const(b as i32)
+}
+
+/// `a op b` on constants, unless it would fail or differ from the VM.
+fn fold_binary(op: &Op, a: &Op, b: &Op) -> Option<Op> {
+    if let (Op::I64Const(x), Op::I64Const(y)) = (a, b) {
+        let (x, y) = (*x, *y);
+        let overflows = y == 0 || (x == i64::MIN && y == -1);
+        return Some(match op {
+            Op::I64Add => Op::I64Const(x.wrapping_add(y)),
+            Op::I64Sub => Op::I64Const(x.wrapping_sub(y)),
+            Op::I64Mul => Op::I64Const(x.wrapping_mul(y)),
+            Op::I64DivS if !overflows => Op::I64Const(x / y),
+            Op::I64RemS if !overflows => Op::I64Const(x % y),
+            Op::I64And => Op::I64Const(x & y),
+            Op::I64Or => Op::I64Const(x | y),
+            Op::I64Xor => Op::I64Const(x ^ y),
+            Op::I64Shl => Op::I64Const(x.wrapping_shl(y as u32 & 63)),
+            Op::I64ShrS => Op::I64Const(x >> (y as u32 & 63)),
+            Op::I64ShrU => Op::I64Const(((x as u64) >> (y as u32 & 63)) as i64),
+            Op::I64Eq => bool_const(x == y),
+            Op::I64Ne => bool_const(x != y),
+            Op::I64LtS => bool_const(x < y),
+            Op::I64LeS => bool_const(x <= y),
+            Op::I64GtS => bool_const(x > y),
+            Op::I64GeS => bool_const(x >= y),
+            _ => return None,
+        });
+    }
+    if let (Op::F64Const(x), Op::F64Const(y)) = (a, b) {
+        let (x, y) = (*x, *y);
+        return Some(match op {
+            Op::F64Add => Op::F64Const(x + y),
+            Op::F64Sub => Op::F64Const(x - y),
+            Op::F64Mul => Op::F64Const(x * y),
+            Op::F64Div if y != 0.0 => Op::F64Const(x / y),
+            Op::F64Eq => bool_const(x == y),
+            Op::F64Ne => bool_const(x != y),
+            Op::F64Lt => bool_const(x < y),
+            Op::F64Le => bool_const(x <= y),
+            Op::F64Gt => bool_const(x > y),
+            Op::F64Ge => bool_const(x >= y),
+            _ => return None,
+        });
+    }
+    None
+}
+
+/// `op a` on a constant, unless it would fail or differ from the VM.
+fn fold_unary(op: &Op, a: &Op) -> Option<Op> {
+    Some(match (op, a) {
+        (Op::I64Neg, Op::I64Const(x)) if *x != i64::MIN => Op::I64Const(-x),
+        (Op::F64Neg, Op::F64Const(x)) => Op::F64Const(-x),
+        // I32Const 0 and 1 are the booleans
+        (Op::I32Eqz, Op::I32Const(x @ (0 | 1))) => bool_const(*x == 0),
+        (Op::I32WrapI64, Op::I64Const(x)) => Op::I64Const(*x as i32 as i64),
+        (Op::I64ExtendI32S, Op::I64Const(x)) => Op::I64Const(*x as i32 as i64),
+        (Op::F64ConvertI64S, Op::I64Const(x)) => Op::F64Const(*x as f64),
+        (Op::I64TruncF64S, Op::F64Const(x)) => Op::I64Const(*x as i64),
+        _ => return None,
+    })
+}
+
+/// Fold constant expressions and branches, drop pushes that are dropped
+/// right away, and tidy up jumps. Returns whether anything changed.
+fn fold(code: &mut Vec<Op>) -> bool {
+    let targets = jump_targets(code);
+    // A window of ops can be rewritten if nothing jumps into its middle
+    let plain =
+        |from: usize, to: usize| to <= code.len() && !targets[from + 1..to].iter().any(|&t| t);
+    let mut edited: Vec<Option<Op>> = code.iter().cloned().map(Some).collect();
+    let mut changed = false;
+    let mut pc = 0;
+    while pc < code.len() {
+        let at = |i: usize| code.get(pc + i);
+        let (replacement, width) = match (at(0), at(1), at(2)) {
+            (Some(a), Some(b), Some(op))
+                if is_constant(a) && is_constant(b) && plain(pc, pc + 3) =>
+            {
+                match fold_binary(op, a, b) {
+                    Some(folded) => (Some(folded), 3),
+                    None => (None, 0),
+                }
+            }
+            _ => (None, 0),
+        };
+        let (replacement, width) = if width > 0 {
+            (replacement, width)
+        } else {
+            match (&code[pc], at(1)) {
+                (a, Some(op)) if is_constant(a) && plain(pc, pc + 2) => match fold_unary(op, a) {
+                    Some(folded) => (Some(folded), 2),
+                    None => match (a, op) {
+                        // Branch on a constant condition
+                        (Op::I32Const(c @ (0 | 1)), Op::BrIf(t)) => {
+                            ((*c == 1).then_some(Op::Jmp(*t)), 2)
+                        }
+                        (Op::I32Const(c @ (0 | 1)), Op::BrIfFalse(t)) => {
+                            ((*c == 0).then_some(Op::Jmp(*t)), 2)
+                        }
+                        (a, Op::Drop) if is_pure_push(a) => (None, 2),
+                        _ => (None, 0),
+                    },
+                },
+                (a, Some(Op::Drop)) if is_pure_push(a) && plain(pc, pc + 2) => (None, 2),
+                (Op::LocalGet(a), Some(Op::LocalSet(b))) if a == b && plain(pc, pc + 2) => {
+                    (None, 2)
+                }
+                (Op::Jmp(t), _) if *t == pc + 1 => (None, 1),
+                (Op::BrIf(t) | Op::BrIfFalse(t), _) if *t == pc + 1 => (Some(Op::Drop), 1),
+                (op @ (Op::Jmp(t) | Op::BrIf(t) | Op::BrIfFalse(t)), _) => {
+                    // Jump straight to where a chain of jumps ends, if that
+                    // stays a forward jump
+                    let mut end = *t;
+                    for _ in 0..8 {
+                        match code.get(end) {
+                            Some(Op::Jmp(next)) if *next > pc && *next != end => end = *next,
+                            _ => break,
+                        }
+                    }
+                    if end != *t {
+                        let mut threaded = op.clone();
+                        *jump_target_mut(&mut threaded).expect("op is a jump") = end;
+                        (Some(threaded), 1)
+                    } else {
+                        (None, 0)
+                    }
+                }
+                _ => (None, 0),
+            }
+        };
+        if width == 0 {
+            pc += 1;
+            continue;
+        }
+        edited[pc] = replacement;
+        for slot in &mut edited[pc + 1..pc + width] {
+            *slot = None;
+        }
+        changed = true;
+        pc += width;
+    }
+    if changed {
+        compact(code, edited);
+    }
+    changed
+}
+
+// ============================================================================
+// Locals
+// ============================================================================
+
+/// Replace reads of a local with the constant it was set to earlier in the
+/// same basic block.
+fn propagate_constants(code: &mut [Op]) -> bool {
+    let targets = jump_targets(code);
+    let mut known: HashMap<usize, Op> = HashMap::new();
+    let mut changed = false;
+    for pc in 0..code.len() {
+        if targets[pc] {
+            known.clear();
+        }
+        match code[pc] {
+            Op::LocalSet(slot) => {
+                if pc > 0 && !targets[pc] && is_constant(&code[pc - 1]) {
+                    known.insert(slot, code[pc - 1].clone());
+                } else {
+                    known.remove(&slot);
+                }
+            }
+            Op::LocalGet(slot) => {
+                if let Some(value) = known.get(&slot) {
+                    code[pc] = value.clone();
+                    changed = true;
+                }
+            }
+            _ => {}
+        }
+    }
+    changed
+}
+
+/// Turn stores to locals that are never read into drops, and keep a value
+/// on the stack instead of storing it to a local read only right after.
+fn remove_dead_locals(code: &mut Vec<Op>) -> bool {
+    let targets = jump_targets(code);
+    let mut reads: HashMap<usize, usize> = HashMap::new();
+    for op in code.iter() {
+        if let Op::LocalGet(slot) = op {
+            *reads.entry(*slot).or_default() += 1;
+        }
+    }
+
+    let mut edited: Vec<Option<Op>> = code.iter().cloned().map(Some).collect();
+    let mut changed = false;
+    for pc in 0..code.len().saturating_sub(1) {
+        if let (Op::LocalSet(a), Op::LocalGet(b)) = (&code[pc], &code[pc + 1])
+            && a == b
+            && !targets[pc + 1]
+            && reads.get(a) == Some(&1)
+            && edited[pc].is_some()
+        {
+            edited[pc] = None;
+            edited[pc + 1] = None;
+            reads.insert(*a, 0);
+            changed = true;
+        }
+    }
+    for slot in edited.iter_mut() {
+        if let Some(Op::LocalSet(n)) = slot
+            && reads.get(n).copied().unwrap_or(0) == 0
+        {
+            *slot = Some(Op::Drop);
+            changed = true;
+        }
+    }
+    if changed {
+        compact(code, edited);
+    }
+    changed
+}
+
+// ============================================================================
+// Unreachable code
+// ============================================================================
+
+/// Remove ops that no path from the entry reaches.
+fn remove_unreachable(code: &mut Vec<Op>) -> bool {
+    if code.is_empty() {
+        return false;
+    }
+    let mut reachable = vec![false; code.len()];
+    let mut worklist = vec![0];
+    reachable[0] = true;
+    while let Some(pc) = worklist.pop() {
+        for succ in successors(code, pc) {
+            if !reachable[succ] {
+                reachable[succ] = true;
+                worklist.push(succ);
+            }
+        }
+    }
+    if reachable.iter().all(|&r| r) {
+        return false;
+    }
+    let edited = code
+        .iter()
+        .zip(&reachable)
+        .map(|(op, &r)| r.then(|| op.clone()))
+        .collect();
+    compact(code, edited);
+    true
+}
+
+// ============================================================================
+// Inlining
+// ============================================================================
+
+/// A function small enough to inline, with what its call sites need.
+struct Inlinee {
+    code: Vec<Op>,
+    arity: usize,
+    locals_count: usize,
+    local_types: Vec<ValueType>,
+    /// Locals a path may read before writing; reset to null on entry, like
+    /// the fresh frame of a call
+    reset: Vec<usize>,
+}
+
+impl Inlinee {
+    fn new(index: usize, func: &Function) -> Option<Self> {
+        let code: &[Op] = &func.code;
+        if code.len() > MAX_INLINE_OPS {
+            return None;
+        }
+        let unsupported = code.iter().any(|op| match op {
+            Op::Call(callee, _) => *callee == index,
+            // Try frames remember the stack depth; the verifier's height for
+            // HeapAllocDyn is only an estimate
+            Op::Pick(_) | Op::PickDyn | Op::TryBegin(_) | Op::TryEnd | Op::HeapAllocDyn => true,
+            Op::LocalGet(slot) | Op::LocalSet(slot) => *slot >= func.locals_count,
+            _ => false,
+        });
+        if unsupported {
+            return None;
+        }
+        // Each return must leave just its value, which then stays on the
+        // caller's stack
+        let heights = Verifier::new().stack_heights(func).ok()?;
+        if code
+            .iter()
+            .zip(&heights)
+            .any(|(op, height)| matches!(op, Op::Ret) && *height != Some(1))
+        {
+            return None;
+        }
+        Some(Self {
+            code: code.to_vec(),
+            arity: func.arity,
+            locals_count: func.locals_count,
+            local_types: func.local_types.clone(),
+            reset: unset_reads(code, func.arity, func.locals_count),
+        })
+    }
+}
+
+/// Locals past the arguments that some path reads before writing.
+fn unset_reads(code: &[Op], arity: usize, locals_count: usize) -> Vec<usize> {
+    // set[pc]: locals written on every path to pc (None = not reached yet)
+    let mut set: Vec<Option<Vec<bool>>> = vec![None; code.len()];
+    set[0] = Some((0..locals_count).map(|slot| slot < arity).collect());
+    let mut worklist = vec![0];
+    while let Some(pc) = worklist.pop() {
+        let mut state = set[pc].clone().expect("queued ops have a state");
+        if let Op::LocalSet(slot) = code[pc] {
+            state[slot] = true;
+        }
+        for succ in successors(code, pc) {
+            match &mut set[succ] {
+                Some(existing) => {
+                    let mut narrowed = false;
+                    for (e, s) in existing.iter_mut().zip(&state) {
+                        if *e && !*s {
+                            *e = false;
+                            narrowed = true;
+                        }
+                    }
+                    if narrowed {
+                        worklist.push(succ);
+                    }
+                }
+                slot @ None => {
+                    *slot = Some(state.clone());
+                    worklist.push(succ);
+                }
+            }
+        }
+    }
+    let mut reset: Vec<usize> = code
+        .iter()
+        .zip(&set)
+        .filter_map(|(op, state)| match (op, state) {
+            (Op::LocalGet(slot), Some(state)) if !state[*slot] => Some(*slot),
+            _ => None,
+        })
+        .collect();
+    reset.sort_unstable();
+    reset.dedup();
+    reset
+}
+
+/// Replace calls in `func` to functions in `inlinees` by their bodies, in
+/// fresh locals past the caller's. Returns how many calls were inlined.
+fn inline_calls(func: &mut Function, inlinees: &[Option<Inlinee>]) -> usize {
+    if !rewritable(func) {
+        return 0;
+    }
+    let code: Vec<Op> = func.code.to_vec();
+    let mut out: Vec<Op> = Vec::with_capacity(code.len());
+    // new_pc[pc]: where the caller's op at pc ends up
+    let mut new_pc = Vec::with_capacity(code.len() + 1);
+    // Caller jumps, whose targets are renumbered once the layout is known
+    let mut caller_jumps = Vec::new();
+    let mut inlined = 0;
+
+    for op in &code {
+        new_pc.push(out.len());
+        let callee = match *op {
+            Op::Call(index, argc) => inlinees
+                .get(index)
+                .and_then(Option::as_ref)
+                .filter(|callee| callee.arity == argc),
+            _ => None,
+        };
+        let Some(callee) =
+            callee.filter(|callee| out.len() + callee.code.len() < MAX_INLINED_CALLER_OPS)
+        else {
+            if jump_target(op).is_some() {
+                caller_jumps.push(out.len());
+            }
+            out.push(op.clone());
+            continue;
+        };
+
+        let base = func.locals_count;
+        func.locals_count += callee.locals_count;
+        func.local_types.resize(base, ValueType::I64);
+        func.local_types.extend(
+            callee
+                .local_types
+                .iter()
+                .copied()
+                .chain(std::iter::repeat(ValueType::I64))
+                .take(callee.locals_count),
+        );
+
+        // The arguments are on the stack, the last one on top
+        for slot in (0..callee.arity).rev() {
+            out.push(Op::LocalSet(base + slot));
+        }
+        for &slot in &callee.reset {
+            out.push(Op::RefNull);
+            out.push(Op::LocalSet(base + slot));
+        }
+        let start = out.len();
+        let end = start + callee.code.len();
+        for op in &callee.code {
+            out.push(match *op {
+                Op::LocalGet(slot) => Op::LocalGet(base + slot),
+                Op::LocalSet(slot) => Op::LocalSet(base + slot),
+                Op::Ret => Op::Jmp(end),
+                ref op => {
+                    let mut op = op.clone();
+                    if let Some(t) = jump_target_mut(&mut op) {
+                        *t += start;
+                    }
+                    op
+                }
+            });
+        }
+        inlined += 1;
+    }
+
+    if inlined == 0 {
+        return 0;
+    }
+    new_pc.push(out.len());
+    for pc in caller_jumps {
+        if let Some(t) = jump_target_mut(&mut out[pc]) {
+            *t = new_pc[(*t).min(code.len())];
+        }
+    }
+    *func.code = out;
+    inlined
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn function(name: &str, arity: usize, locals_count: usize, code: Vec<Op>) -> Function {
+        Function {
+            name: name.to_string(),
+            arity,
+            locals_count,
+            code: code.into(),
+            stackmap: None,
+            local_types: vec![],
+        }
+    }
+
+    fn chunk(functions: Vec<Function>, main: Vec<Op>, locals_count: usize) -> Chunk {
+        Chunk {
+            functions,
+            main: function("__main__", 0, locals_count, main),
+            strings: vec![].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        }
+    }
+
+    fn simplified(code: Vec<Op>, arity: usize, locals_count: usize) -> Vec<Op> {
+        let mut func = function("f", arity, locals_count, code);
+        simplify(&mut func);
+        func.code.to_vec()
+    }
+
+    #[test]
+    fn test_constant_folding() {
+        // let k = 2 * 3 + 4; return k < 11
+        let code = vec![
+            Op::I64Const(2),
+            Op::I64Const(3),
+            Op::I64Mul,
+            Op::I64Const(4),
+            Op::I64Add,
+            Op::LocalSet(0),
+            Op::LocalGet(0),
+            Op::I64Const(11),
+            Op::I64LtS,
+            Op::Ret,
+        ];
+        assert_eq!(simplified(code, 0, 1), [Op::I32Const(1), Op::Ret]);
+
+        // Division by zero is left for the VM to report
+        let code = vec![Op::I64Const(1), Op::I64Const(0), Op::I64DivS, Op::Ret];
+        assert_eq!(simplified(code.clone(), 0, 0), code);
+    }
+
+    #[test]
+    fn test_constant_branch_and_unreachable_code() {
+        // if 1 < 2 { return x } else { return 0 }
+        let code = vec![
+            Op::I64Const(1),
+            Op::I64Const(2),
+            Op::I64LtS,
+            Op::BrIfFalse(6),
+            Op::LocalGet(0),
+            Op::Ret,
+            Op::I64Const(0),
+            Op::Ret,
+        ];
+        assert_eq!(simplified(code, 1, 1), [Op::LocalGet(0), Op::Ret]);
+    }
+
+    #[test]
+    fn test_no_folding_across_jump_targets() {
+        // The I64Const 3 at 5 is also reached from the jump at 3
+        let code = vec![
+            Op::LocalGet(0),
+            Op::BrIfFalse(4),
+            Op::I64Const(1),
+            Op::Jmp(5),
+            Op::I64Const(2),
+            Op::I64Const(3),
+            Op::I64Add,
+            Op::Ret,
+        ];
+        assert_eq!(simplified(code.clone(), 1, 1), code);
+    }
+
+    #[test]
+    fn test_local_peepholes() {
+        // let t = a + b; let unused = 7; return t
+        let code = vec![
+            Op::LocalGet(0),
+            Op::LocalGet(1),
+            Op::I64Add,
+            Op::LocalSet(2),
+            Op::I64Const(7),
+            Op::LocalSet(3),
+            Op::LocalGet(2),
+            Op::Ret,
+        ];
+        assert_eq!(
+            simplified(code, 2, 4),
+            [Op::LocalGet(0), Op::LocalGet(1), Op::I64Add, Op::Ret]
+        );
+    }
+
+    #[test]
+    fn test_loops_keep_their_back_edge() {
+        // i = 0; while i < n { i = i + 1 }; return i
+        let code = vec![
+            Op::I64Const(0),
+            Op::LocalSet(1),
+            Op::LocalGet(1),
+            Op::LocalGet(0),
+            Op::I64LtS,
+            Op::BrIfFalse(11),
+            Op::LocalGet(1),
+            Op::I64Const(1),
+            Op::I64Add,
+            Op::LocalSet(1),
+            Op::Jmp(2),
+            Op::LocalGet(1),
+            Op::Ret,
+        ];
+        // The 0 stored before the loop must not replace the read at its head
+        assert_eq!(simplified(code.clone(), 1, 2), code);
+    }
+
+    #[test]
+    fn test_inline_small_functions() {
+        // sq(x) = x * x; add(a, b) = { let t = a + b; return t }
+        let sq = function(
+            "sq",
+            1,
+            1,
+            vec![Op::LocalGet(0), Op::LocalGet(0), Op::I64Mul, Op::Ret],
+        );
+        let add = function(
+            "add",
+            2,
+            3,
+            vec![
+                Op::LocalGet(0),
+                Op::LocalGet(1),
+                Op::I64Add,
+                Op::LocalSet(2),
+                Op::LocalGet(2),
+                Op::Ret,
+            ],
+        );
+        // fact(n) calls itself and stays a call
+        let fact = function(
+            "fact",
+            1,
+            1,
+            vec![
+                Op::LocalGet(0),
+                Op::LocalGet(0),
+                Op::I64Const(1),
+                Op::I64Sub,
+                Op::Call(2, 1),
+                Op::I64Mul,
+                Op::Ret,
+            ],
+        );
+        let main = vec![
+            Op::LocalGet(0),
+            Op::Call(0, 1),
+            Op::I64Const(3),
+            Op::Call(1, 2),
+            Op::LocalGet(0),
+            Op::Call(2, 1),
+            Op::I64Add,
+            Op::Ret,
+        ];
+        let mut chunk = chunk(vec![sq, add, fact], main, 1);
+        let report = optimize(&mut chunk, OptLevel::O2);
+
+        assert_eq!(report.inlined_calls(), 2);
+        // What is left of add's locals after folding is its result on the stack
+        assert_eq!(
+            *chunk.main.code,
+            [
+                Op::LocalGet(0),
+                Op::LocalSet(1),
+                Op::LocalGet(1),
+                Op::LocalGet(1),
+                Op::I64Mul,
+                Op::I64Const(3),
+                Op::I64Add,
+                Op::LocalGet(0),
+                Op::Call(2, 1),
+                Op::I64Add,
+                Op::Ret,
+            ]
+        );
+        // The callees' locals were appended to main's
+        assert_eq!(chunk.main.locals_count, 5);
+        assert_eq!(chunk.main.local_types.len(), 5);
+
+        let main = report.functions.last().unwrap();
+        assert_eq!((main.ops_before, main.ops_after), (8, 11));
+        // -O1 leaves calls alone
+        let mut again = chunk.clone();
+        *again.main.code = vec![Op::LocalGet(0), Op::Call(0, 1), Op::Ret];
+        assert_eq!(optimize(&mut again, OptLevel::O1).inlined_calls(), 0);
+        assert!(optimize(&mut again, OptLevel::O0).functions.is_empty());
+    }
+
+    #[test]
+    fn test_inlined_locals_start_null() {
+        // f() = { if c { x = 1 }; return x } reads x unset on one path
+        let f = function(
+            "f",
+            0,
+            2,
+            vec![
+                Op::LocalGet(0),
+                Op::BrIfFalse(4),
+                Op::I64Const(1),
+                Op::LocalSet(1),
+                Op::LocalGet(1),
+                Op::Ret,
+            ],
+        );
+        let inlinee = Inlinee::new(0, &f).unwrap();
+        assert_eq!(inlinee.reset, [0, 1]);
+    }
+}
@@ -1,5 +1,6 @@
 use crate::compiler::ast::*;
 use crate::compiler::lexer::Span;
+use crate::compiler::monomorphise::Instantiation;
 use crate::compiler::types::{Type, TypeAnnotation};
 use std::collections::{HashMap, HashSet};
 
@@ -381,6 +382,8 @@ impl<'a> Resolver<'a> {
                 "send".to_string(),
                 "recv".to_string(),
                 "join".to_string(),
+                "__channel_send_many".to_string(),
+                "__channel_recv_many".to_string(),
                 // Hostcall operations (generic hostcall builtin)
                 "__hostcall".to_string(),
                 // Low-level heap intrinsics (for stdlib implementation)
@@ -390,6 +393,14 @@ impl<'a> Resolver<'a> {
                 "__alloc_string".to_string(),
                 "__null_ptr".to_string(),
                 "__ptr_offset".to_string(),
+                // Bulk typed-array operations
+                "__heap_fill".to_string(),
+                "__heap_copy".to_string(),
+                "__heap_equal".to_string(),
+                "__heap_find".to_string(),
+                "__heap_add_f64".to_string(),
+                "__heap_mul_f64".to_string(),
+                "__heap_fma_f64".to_string(),
                 // 128-bit multiply high
                 "__umul128_hi".to_string(),
                 // Dynamic call by function index
@@ -948,6 +959,17 @@ impl<'a> Resolver<'a> {
             Some(TypeAnnotation::Array(_)) => Some(Type::array(Type::Any)),
             Some(TypeAnnotation::Vec(_)) => Some(Type::vector(Type::Any)),
             Some(TypeAnnotation::Map(_, _)) => Some(Type::map(Type::Any, Type::Any)),
+            // Only the ValueType matters here; element types stay unknown so
+            // they do not steer the element kind of `__alloc_heap`
+            Some(TypeAnnotation::Generic { name, .. }) if name == "ptr" => {
+                Some(Type::Ptr(Box::new(Type::Any)))
+            }
+            Some(TypeAnnotation::Generic { name, .. }) if self.structs.contains_key(name) => {
+                Some(Type::Struct {
+                    name: name.clone(),
+                    fields: Vec::new(),
+                })
+            }
             Some(TypeAnnotation::Nullable(inner)) => {
                 let inner_ty = self
                     .type_from_annotation(&Some(*inner.clone()))
@@ -1001,9 +1023,30 @@ impl<'a> Resolver<'a> {
         }
     }
 
-    /// Extract struct name from a Type (set by typechecker's inferred_type)
-    fn struct_name_from_type(ty: &Type) -> Option<String> {
+    /// Extract struct name from a Type (set by typechecker's inferred_type).
+    /// A concrete instantiation like `Vec<int>` names its monomorphised
+    /// struct (`Vec__int`) when one exists, so its methods are the
+    /// specialised ones.
+    fn struct_name_from_type(&self, ty: &Type) -> Option<String> {
         match ty {
+            Type::GenericStruct {
+                name, type_args, ..
+            } if !type_args.is_empty()
+                && !type_args
+                    .iter()
+                    .any(|t| matches!(t, Type::Param { .. } | Type::Var(_) | Type::Any)) =>
+            {
+                let mangled = Instantiation {
+                    name: name.clone(),
+                    type_args: type_args.clone(),
+                }
+                .mangled_name();
+                if self.structs.contains_key(&mangled) {
+                    Some(mangled)
+                } else {
+                    Some(name.clone())
+                }
+            }
             Type::Struct { name, .. } | Type::GenericStruct { name, .. } => Some(name.clone()),
             _ => None,
         }
@@ -1368,8 +1411,11 @@ impl<'a> Resolver<'a> {
                 span: _,
             } => {
                 let init = self.resolve_expr(init, scope)?;
-                let inferred_fallback =
-                    || inferred_type.as_ref().and_then(Self::struct_name_from_type);
+                let inferred_fallback = || {
+                    inferred_type
+                        .as_ref()
+                        .and_then(|ty| self.struct_name_from_type(ty))
+                };
                 // First try to get struct name from type annotation
                 let struct_name = match type_annotation {
                     Some(crate::compiler::types::TypeAnnotation::Named(type_name)) => {
@@ -2064,7 +2110,11 @@ impl<'a> Resolver<'a> {
                 let struct_name = struct_name
                     .or_else(|| self.get_struct_name(&resolved_object))
                     // Fallback: use the typechecker's inferred_type on the object expression
-                    .or_else(|| object_type.as_ref().and_then(Self::struct_name_from_type));
+                    .or_else(|| {
+                        object_type
+                            .as_ref()
+                            .and_then(|ty| self.struct_name_from_type(ty))
+                    });
 
                 // Resolve method to function index (static dispatch)
                 let (func_index, return_struct_name) = if let Some(sn) = &struct_name {
@@ -3615,13 +3615,45 @@ impl TypeChecker {
                 }
                 Some(Type::string())
             }
+            "channel" => {
+                // channel() or channel(capacity)
+                if args.len() > 1 {
+                    self.errors.push(TypeError::new(
+                        "channel expects at most 1 argument (capacity)",
+                        span,
+                    ));
+                }
+                for arg in args {
+                    let arg_type = self.infer_expr(arg, env);
+                    if let Err(e) = self.unify(&arg_type, &Type::Int, span) {
+                        self.errors.push(e);
+                    }
+                }
+                Some(self.fresh_var())
+            }
             // Thread operations - for now just return appropriate types
-            "spawn" | "channel" | "send" | "recv" | "join" => {
+            "spawn" | "send" | "recv" | "join" => {
                 for arg in args {
                     self.infer_expr(arg, env);
                 }
                 Some(self.fresh_var())
             }
+            "__channel_send_many" | "__channel_recv_many" => {
+                if args.len() != 3 {
+                    self.errors.push(TypeError::new(
+                        format!("{} expects 3 arguments (channel, data, count)", name),
+                        span,
+                    ));
+                }
+                for arg in args {
+                    self.infer_expr(arg, env);
+                }
+                if name == "__channel_send_many" {
+                    Some(Type::Nil)
+                } else {
+                    Some(Type::Int)
+                }
+            }
             // Low-level heap intrinsics (for stdlib implementation)
             "__heap_load" => {
                 if args.len() != 2 {
@@ -3664,6 +3696,28 @@ impl TypeChecker {
                 }
                 Some(Type::Nil)
             }
+            "__heap_fill" | "__heap_copy" | "__heap_equal" | "__heap_find" | "__heap_add_f64"
+            | "__heap_mul_f64" | "__heap_fma_f64" => {
+                // Operands: refs, int indices/counts and (fill/find) an element value
+                let arity = match name {
+                    "__heap_fill" | "__heap_find" | "__heap_add_f64" | "__heap_mul_f64" => 4,
+                    _ => 5,
+                };
+                if args.len() != arity {
+                    self.errors.push(TypeError::new(
+                        format!("{} expects {} arguments", name, arity),
+                        span,
+                    ));
+                }
+                for arg in args {
+                    self.infer_expr(arg, env);
+                }
+                match name {
+                    "__heap_equal" => Some(Type::Bool),
+                    "__heap_find" => Some(Type::Int),
+                    _ => Some(Type::Nil),
+                }
+            }
             "__alloc_heap" => {
                 if args.len() != 1 {
                     self.errors.push(TypeError::new(
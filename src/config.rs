@@ -1,5 +1,6 @@
 //! Runtime configuration types.
 
+use std::path::PathBuf;
 use std::time::Duration;
 
 /// Format for timing output
@@ -15,6 +16,8 @@ pub enum TimingsFormat {
 /// Compiler pipeline timings
 #[derive(Debug, Clone, Default)]
 pub struct CompilerTimings {
+    /// Looking up and storing compile cache entries
+    pub cache: Duration,
     pub lexer: Duration,
     pub parser: Duration,
     pub typecheck: Duration,
@@ -22,19 +25,22 @@ pub struct CompilerTimings {
     pub monomorphise: Duration,
     pub resolve: Duration,
     pub codegen: Duration,
+    pub optimize: Duration,
     pub execution: Duration,
 }
 
 impl CompilerTimings {
     /// Calculate total time across all phases
     pub fn total(&self) -> Duration {
-        self.lexer
+        self.cache
+            + self.lexer
             + self.parser
             + self.typecheck
             + self.desugar
             + self.monomorphise
             + self.resolve
             + self.codegen
+            + self.optimize
             + self.execution
     }
 
@@ -51,6 +57,7 @@ impl CompilerTimings {
     /// Output timings in human-readable table format to stderr
     pub fn print_human(&self) {
         eprintln!("=== Compiler Timings ===");
+        eprintln!("cache:         {:>10}", Self::format_duration(self.cache));
         eprintln!("lexer:         {:>10}", Self::format_duration(self.lexer));
         eprintln!("parser:        {:>10}", Self::format_duration(self.parser));
         eprintln!(
@@ -64,6 +71,10 @@ impl CompilerTimings {
         );
         eprintln!("resolve:       {:>10}", Self::format_duration(self.resolve));
         eprintln!("codegen:       {:>10}", Self::format_duration(self.codegen));
+        eprintln!(
+            "optimize:      {:>10}",
+            Self::format_duration(self.optimize)
+        );
         eprintln!(
             "execution:     {:>10}",
             Self::format_duration(self.execution)
@@ -75,7 +86,8 @@ impl CompilerTimings {
     /// Output timings in JSON format to stderr
     pub fn print_json(&self) {
         let json = format!(
-            r#"{{"lexer_ms":{:.2},"parser_ms":{:.2},"typecheck_ms":{:.2},"desugar_ms":{:.2},"monomorphise_ms":{:.2},"resolve_ms":{:.2},"codegen_ms":{:.2},"execution_ms":{:.2},"total_ms":{:.2}}}"#,
+            r#"{{"cache_ms":{:.2},"lexer_ms":{:.2},"parser_ms":{:.2},"typecheck_ms":{:.2},"desugar_ms":{:.2},"monomorphise_ms":{:.2},"resolve_ms":{:.2},"codegen_ms":{:.2},"optimize_ms":{:.2},"execution_ms":{:.2},"total_ms":{:.2}}}"#,
+            self.cache.as_secs_f64() * 1000.0,
             self.lexer.as_secs_f64() * 1000.0,
             self.parser.as_secs_f64() * 1000.0,
             self.typecheck.as_secs_f64() * 1000.0,
@@ -83,6 +95,7 @@ impl CompilerTimings {
             self.monomorphise.as_secs_f64() * 1000.0,
             self.resolve.as_secs_f64() * 1000.0,
             self.codegen.as_secs_f64() * 1000.0,
+            self.optimize.as_secs_f64() * 1000.0,
             self.execution.as_secs_f64() * 1000.0,
             self.total().as_secs_f64() * 1000.0,
         );
@@ -116,17 +129,48 @@ pub enum GcMode {
     /// Stop-the-world GC
     #[default]
     Stw,
-    /// Concurrent GC (reduced pause times)
+    /// Incremental GC: marking and sweeping are interleaved with execution
+    /// in bounded steps (reduced pause times)
     Concurrent,
 }
 
+/// How the output of `print` and `write` is buffered
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub enum OutputBuffering {
+    /// Line buffered on a terminal, block buffered otherwise
+    #[default]
+    Auto,
+    /// Every write goes out right away
+    Unbuffered,
+    /// Flushed at each newline
+    Line,
+    /// Flushed when the buffer fills up, on exit and before blocking
+    Block,
+}
+
+/// How much the bytecode is optimized before it runs
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq, PartialOrd, Ord)]
+pub enum OptLevel {
+    /// Run the bytecode as codegen emits it
+    #[default]
+    O0,
+    /// Constant folding and propagation, dead-code elimination and peepholes
+    O1,
+    /// O1 plus inlining of small functions
+    O2,
+}
+
 /// Runtime configuration for the VM
 #[derive(Debug, Clone)]
 pub struct RuntimeConfig {
     pub jit_mode: JitMode,
     pub jit_threshold: u32,
+    /// Loop iterations before a loop is compiled (None = jit_threshold / 10)
+    pub jit_osr_threshold: Option<u32>,
+    /// Compile hot functions on a background thread, with at most this many
+    /// waiting (None = compile on the calling thread)
+    pub jit_background: Option<usize>,
     pub trace_jit: bool,
-    #[allow(dead_code)] // Reserved for future GC configuration
     pub gc_mode: GcMode,
     pub gc_stats: bool,
     /// Whether GC is enabled (default: true)
@@ -135,6 +179,16 @@ pub struct RuntimeConfig {
     pub heap_limit: Option<usize>,
     /// Whether to profile opcode execution counts
     pub profile_opcodes: bool,
+    /// Buffering of stdout and of writes to files and sockets
+    pub output_buffering: OutputBuffering,
+    /// Sample call stacks and write them here in folded-stack format
+    pub sample_profile: Option<PathBuf>,
+    /// Write `/tmp/perf-<pid>.map` entries for JIT code
+    pub perf_map: bool,
+    /// Bytecode optimization level
+    pub opt_level: OptLevel,
+    /// Directory of the compile cache (None = always compile)
+    pub compile_cache: Option<PathBuf>,
 }
 
 impl Default for RuntimeConfig {
@@ -142,12 +196,19 @@ impl Default for RuntimeConfig {
         Self {
             jit_mode: JitMode::Auto,
             jit_threshold: 1000,
+            jit_osr_threshold: None,
+            jit_background: None,
             trace_jit: false,
             gc_mode: GcMode::Stw,
             gc_stats: false,
             gc_enabled: true,
             heap_limit: None,
             profile_opcodes: false,
+            output_buffering: OutputBuffering::Auto,
+            sample_profile: None,
+            perf_map: false,
+            opt_level: OptLevel::O0,
+            compile_cache: None,
         }
     }
 }
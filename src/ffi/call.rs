@@ -3,14 +3,19 @@
 #![allow(unsafe_op_in_unsafe_fn)]
 #![allow(clippy::missing_safety_doc)]
 
-use super::types::{HostFunction, MocaCFunc, MocaResult, MocaVm};
+use super::types::{
+    AsyncWrapper, HostFunction, MocaAsync, MocaCFunc, MocaFunctionRef, MocaResult, MocaValue,
+    MocaValueTag, MocaVm, VmWrapper,
+};
 use super::vm_ffi::get_wrapper_mut;
+use crate::vm::Chunk;
 use std::ffi::{CStr, c_char};
 
 /// Call a moca function by name.
 ///
-/// Arguments must be pushed onto the stack before calling.
-/// The result will be on the stack after a successful call.
+/// Arguments must be pushed onto the stack before calling. They are consumed
+/// by the call, even if it fails at runtime, and the result is pushed in their place.
+/// Hot functions are JIT compiled just like calls made from moca code.
 ///
 /// # Arguments
 /// - `vm`: Valid VM instance
@@ -20,6 +25,8 @@ use std::ffi::{CStr, c_char};
 /// # Returns
 /// - `MOCA_OK` on success
 /// - `MOCA_ERROR_NOT_FOUND` if function not found
+/// - `MOCA_ERROR_INVALID_ARG` if `nargs` does not match the function's arity
+/// - `MOCA_ERROR_VERIFY` if the function's body is corrupt
 /// - `MOCA_ERROR_RUNTIME` on execution error
 #[unsafe(no_mangle)]
 pub unsafe extern "C" fn moca_call(
@@ -65,8 +72,39 @@ pub unsafe extern "C" fn moca_call(
         return MocaResult::ErrorNotFound;
     };
 
-    // Find function by name
-    let func_idx = chunk
+    let Some(func_idx) = find_function(chunk, name) else {
+        wrapper.set_error(format!("Function '{}' not found", name));
+        return MocaResult::ErrorNotFound;
+    };
+
+    if nargs < 0 || nargs as usize > wrapper.ffi_stack.len() {
+        wrapper.set_error(format!(
+            "Invalid argument count {} (stack has {} values)",
+            nargs,
+            wrapper.ffi_stack.len()
+        ));
+        return MocaResult::ErrorInvalidArg;
+    }
+
+    let arity = if func_idx == usize::MAX {
+        chunk.main.arity
+    } else {
+        chunk.functions[func_idx].arity
+    };
+    if nargs as usize != arity {
+        wrapper.set_error(format!(
+            "Function '{}' expects {} arguments, got {}",
+            name, arity, nargs
+        ));
+        return MocaResult::ErrorInvalidArg;
+    }
+
+    call_loaded(wrapper, func_idx, nargs as usize)
+}
+
+/// Find a function in the chunk by name (`usize::MAX` for main).
+fn find_function(chunk: &Chunk, name: &str) -> Option<usize> {
+    chunk
         .functions
         .iter()
         .position(|f| f.name == name)
@@ -76,18 +114,277 @@ pub unsafe extern "C" fn moca_call(
             } else {
                 None
             }
-        });
+        })
+}
 
-    let Some(_func_idx) = func_idx else {
+/// Resolve a moca function by name into a handle for `moca_call_ref`.
+///
+/// The name lookup and arity check happen once here, so repeated calls
+/// through the handle do no string work. Only functions from the loaded
+/// bytecode can be resolved, not registered host functions.
+///
+/// # Arguments
+/// - `vm`: Valid VM instance with loaded bytecode
+/// - `func_name`: Name of the function (null-terminated)
+/// - `nargs`: Number of arguments the function will be called with
+/// - `out`: Receives the handle on success
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_NOT_FOUND` if no bytecode is loaded or function not found
+/// - `MOCA_ERROR_INVALID_ARG` if `nargs` does not match the function's arity
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_function_ref(
+    vm: *mut MocaVm,
+    func_name: *const c_char,
+    nargs: i32,
+    out: *mut MocaFunctionRef,
+) -> MocaResult {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+
+    if func_name.is_null() || out.is_null() {
+        wrapper.set_error("Function name or output handle is null");
+        return MocaResult::ErrorInvalidArg;
+    }
+
+    let name = match CStr::from_ptr(func_name).to_str() {
+        Ok(s) => s,
+        Err(_) => {
+            wrapper.set_error("Invalid UTF-8 in function name");
+            return MocaResult::ErrorInvalidArg;
+        }
+    };
+
+    let Some(chunk) = &wrapper.chunk else {
+        wrapper.set_error("No bytecode loaded");
+        return MocaResult::ErrorNotFound;
+    };
+
+    let Some(func_idx) = find_function(chunk, name) else {
         wrapper.set_error(format!("Function '{}' not found", name));
         return MocaResult::ErrorNotFound;
     };
 
-    // TODO: Implement actual function call
-    // This requires transferring values from ffi_stack to VM stack,
-    // executing the function, and transferring result back
-    wrapper.set_error("Function calls not yet implemented");
-    MocaResult::ErrorRuntime
+    let arity = if func_idx == usize::MAX {
+        chunk.main.arity
+    } else {
+        chunk.functions[func_idx].arity
+    };
+    if nargs < 0 || nargs as usize != arity {
+        wrapper.set_error(format!(
+            "Function '{}' expects {} arguments, got {}",
+            name, arity, nargs
+        ));
+        return MocaResult::ErrorInvalidArg;
+    }
+
+    *out = MocaFunctionRef {
+        func_index: if func_idx == usize::MAX {
+            MocaFunctionRef::MAIN_INDEX
+        } else {
+            func_idx as u32
+        },
+        arity: arity as u32,
+    };
+    wrapper.clear_error();
+    MocaResult::Ok
+}
+
+/// Call a moca function through a handle from `moca_function_ref`.
+///
+/// Behaves like `moca_call` (arguments are consumed and the result is pushed)
+/// but skips the name lookup and UTF-8 validation.
+///
+/// # Arguments
+/// - `vm`: Valid VM instance
+/// - `func`: Handle resolved against the currently loaded bytecode
+/// - `nargs`: Number of arguments on the stack (must match the handle)
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if `nargs` does not match the handle's arity
+/// - `MOCA_ERROR_VERIFY` if the function's body is corrupt
+/// - `MOCA_ERROR_RUNTIME` on execution error (including stale handles)
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_call_ref(
+    vm: *mut MocaVm,
+    func: MocaFunctionRef,
+    nargs: i32,
+) -> MocaResult {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+
+    if nargs < 0 || nargs as u32 != func.arity || nargs as usize > wrapper.ffi_stack.len() {
+        wrapper.set_error(format!(
+            "Function handle expects {} arguments, got {} (stack has {} values)",
+            func.arity,
+            nargs,
+            wrapper.ffi_stack.len()
+        ));
+        return MocaResult::ErrorInvalidArg;
+    }
+
+    call_loaded(wrapper, func.vm_index(), nargs as usize)
+}
+
+/// Call a moca function once per argument tuple in a single VM entry.
+///
+/// `args` holds `count` consecutive tuples of `nargs` values each, and
+/// `results[i]` receives the return value for tuple `i`. The stack is not
+/// touched. Once the function is JIT compiled, the remaining tuples run in a
+/// native loop over the compiled code. Reference results are only valid until
+/// the next call into the VM.
+///
+/// # Arguments
+/// - `vm`: Valid VM instance
+/// - `func`: Handle resolved against the currently loaded bytecode
+/// - `args`: `count * nargs` argument values (may be NULL if that is 0)
+/// - `nargs`: Arguments per call (must match the handle)
+/// - `count`: Number of calls
+/// - `results`: Output array of `count` values (may be NULL if `count` is 0)
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` on NULL arrays or an arity mismatch
+/// - `MOCA_ERROR_VERIFY` if the function's body is corrupt
+/// - `MOCA_ERROR_RUNTIME` if any call fails (`results` is left unspecified)
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_call_batch(
+    vm: *mut MocaVm,
+    func: MocaFunctionRef,
+    args: *const MocaValue,
+    nargs: usize,
+    count: usize,
+    results: *mut MocaValue,
+) -> MocaResult {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+
+    if nargs != func.arity as usize {
+        wrapper.set_error(format!(
+            "Function handle expects {} arguments, got {}",
+            func.arity, nargs
+        ));
+        return MocaResult::ErrorInvalidArg;
+    }
+    let Some(total_args) = nargs.checked_mul(count) else {
+        wrapper.set_error("Batch argument count overflows");
+        return MocaResult::ErrorInvalidArg;
+    };
+    if (total_args > 0 && args.is_null()) || (count > 0 && results.is_null()) {
+        wrapper.set_error("Batch argument or result array is null");
+        return MocaResult::ErrorInvalidArg;
+    }
+    if count == 0 {
+        wrapper.clear_error();
+        return MocaResult::Ok;
+    }
+
+    let Some(chunk) = &wrapper.chunk else {
+        wrapper.set_error("No bytecode loaded");
+        return MocaResult::ErrorNotFound;
+    };
+    if let Some(message) = corrupt_body(chunk, func.vm_index()) {
+        wrapper.set_error(message);
+        return MocaResult::ErrorVerify;
+    }
+
+    // Layout: [args (count * nargs)] [results (count)]
+    let buffer = &mut wrapper.batch_buffer;
+    buffer.clear();
+    buffer.extend(
+        std::slice::from_raw_parts(args, total_args)
+            .iter()
+            .map(|v| v.to_value()),
+    );
+    buffer.resize(total_args + count, crate::vm::Value::Null);
+    let (arg_values, result_values) = buffer.split_at_mut(total_args);
+
+    match wrapper
+        .vm
+        .call_function_batch(chunk, func.vm_index(), arg_values, result_values)
+    {
+        Ok(()) => {
+            let out = std::slice::from_raw_parts_mut(results, count);
+            for (dst, src) in out.iter_mut().zip(result_values.iter()) {
+                *dst = MocaValue::from_value(*src);
+            }
+            wrapper.clear_error();
+            MocaResult::Ok
+        }
+        Err(e) => {
+            wrapper.set_error(e);
+            MocaResult::ErrorRuntime
+        }
+    }
+}
+
+/// Call a function of the loaded chunk with the top `argc` stack values as
+/// arguments, replacing them with the return value.
+///
+/// The FFI stack is handed to the VM for the duration of the call, so the
+/// arguments become the callee's locals without being copied and any other
+/// values the host has pushed stay visible to the GC. The arguments are
+/// consumed even if the call fails.
+pub(crate) fn call_loaded(wrapper: &mut VmWrapper, func_idx: usize, argc: usize) -> MocaResult {
+    let Some(chunk) = &wrapper.chunk else {
+        wrapper.set_error("No bytecode loaded");
+        return MocaResult::ErrorNotFound;
+    };
+    if let Some(message) = corrupt_body(chunk, func_idx) {
+        let keep = wrapper.ffi_stack.len().saturating_sub(argc);
+        wrapper.ffi_stack.truncate(keep);
+        wrapper.set_error(message);
+        return MocaResult::ErrorVerify;
+    }
+
+    // Between calls the VM stack is empty, so this is normally a buffer swap
+    let vm_stack = wrapper.vm.stack_mut();
+    let base = vm_stack.len();
+    if base == 0 {
+        std::mem::swap(vm_stack, &mut wrapper.ffi_stack);
+    } else {
+        vm_stack.append(&mut wrapper.ffi_stack);
+    }
+
+    let result = wrapper.vm.call_function(chunk, func_idx, argc);
+
+    let vm_stack = wrapper.vm.stack_mut();
+    if base == 0 {
+        std::mem::swap(vm_stack, &mut wrapper.ffi_stack);
+    } else {
+        wrapper.ffi_stack.extend(vm_stack.drain(base..));
+    }
+
+    match result {
+        Ok(value) => {
+            wrapper.ffi_stack.push(value);
+            wrapper.clear_error();
+            MocaResult::Ok
+        }
+        Err(e) => {
+            wrapper.set_error(e);
+            MocaResult::ErrorRuntime
+        }
+    }
+}
+
+/// Describe the entry function's body if it fails to decode.
+///
+/// Bodies are decoded on first use, so this is where a corrupt one loaded by
+/// `moca_load_file` shows up. Corrupt callees are runtime errors of the call.
+fn corrupt_body(chunk: &Chunk, func_idx: usize) -> Option<String> {
+    let func = if func_idx == usize::MAX {
+        &chunk.main
+    } else {
+        chunk.functions.get(func_idx)?
+    };
+    let e = func.code.decode().err()?;
+    Some(format!("Corrupt body of function '{}': {}", func.name, e))
 }
 
 /// Protected call - catches errors instead of aborting.
@@ -148,9 +445,70 @@ pub unsafe extern "C" fn moca_register_function(
     MocaResult::Ok
 }
 
+/// Start an async result in a host function.
+///
+/// Pushes the id of a pending result onto the stack, for the host function
+/// to return, and hands back a handle that completes it. Moca code waits
+/// for the result with `recv(id)`; on a spawned thread this suspends only
+/// that green thread, so the host can finish the work elsewhere without
+/// stalling the VM.
+///
+/// The id is reused once `recv` has returned the result, so it must be
+/// received at most once.
+///
+/// # Returns
+/// The handle, or NULL if `vm` is NULL. Each handle must be completed once
+/// with `moca_async_resolve()` or `moca_async_cancel()`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_async_begin(vm: *mut MocaVm) -> *mut MocaAsync {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return std::ptr::null_mut();
+    };
+    let (id, channel) = wrapper.vm.create_async_channel();
+    wrapper.ffi_stack.push(crate::vm::Value::I64(id));
+    Box::into_raw(Box::new(AsyncWrapper { channel })) as *mut MocaAsync
+}
+
+/// Complete an async result with `value` and free the handle.
+///
+/// May be called from any thread. Only null, bool, i64 and f64 values can
+/// be delivered: heap references belong to the VM that created them.
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` on a NULL handle or a reference value; the
+///   handle is not freed
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_async_resolve(
+    handle: *mut MocaAsync,
+    value: MocaValue,
+) -> MocaResult {
+    if handle.is_null() || value.tag == MocaValueTag::Ref {
+        return MocaResult::ErrorInvalidArg;
+    }
+    let wrapper = Box::from_raw(handle as *mut AsyncWrapper);
+    // The channel has room for exactly this one value
+    let _ = wrapper.channel.try_send(value.to_value());
+    MocaResult::Ok
+}
+
+/// Abandon an async result and free the handle. A waiting `recv` returns
+/// null.
+///
+/// May be called from any thread. NULL is ignored.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_async_cancel(handle: *mut MocaAsync) {
+    if handle.is_null() {
+        return;
+    }
+    let wrapper = Box::from_raw(handle as *mut AsyncWrapper);
+    wrapper.channel.close();
+}
+
 /// Set a global variable.
 ///
-/// Pops the top value from the stack and sets it as a global.
+/// Pops the top value from the stack and sets it as a global. The VM keeps
+/// the value alive as a GC root until the global is overwritten.
 ///
 /// # Arguments
 /// - `vm`: Valid VM instance
@@ -181,8 +539,8 @@ pub unsafe extern "C" fn moca_set_global(vm: *mut MocaVm, name: *const c_char) -
         }
     };
 
-    // Store the global
-    wrapper.globals.insert(name_str, value);
+    // Store the global; the VM keeps it alive as a GC root
+    wrapper.vm.set_host_global(name_str, value);
     wrapper.clear_error();
     MocaResult::Ok
 }
@@ -215,7 +573,7 @@ pub unsafe extern "C" fn moca_get_global(vm: *mut MocaVm, name: *const c_char) -
     };
 
     // Look up the global
-    let Some(value) = wrapper.globals.get(name_str).cloned() else {
+    let Some(value) = wrapper.vm.host_global(name_str) else {
         wrapper.set_error(format!("Global '{}' not found", name_str));
         return MocaResult::ErrorNotFound;
     };
@@ -231,6 +589,7 @@ mod tests {
     use super::*;
     use crate::ffi::stack::*;
     use crate::ffi::vm_ffi::{moca_vm_free, moca_vm_new};
+    use crate::vm::Value;
     use std::ffi::CString;
 
     #[test]
@@ -266,6 +625,477 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_async_host_function() {
+        use crate::vm::{Chunk, Function, Op, ValueType, bytecode};
+
+        // Completes its result from another thread
+        unsafe extern "C" fn fetch(vm: *mut MocaVm) -> MocaResult {
+            let handle = unsafe { moca_async_begin(vm) } as usize;
+            std::thread::spawn(move || {
+                std::thread::sleep(std::time::Duration::from_millis(10));
+                let value = MocaValue::from_value(Value::I64(42));
+                unsafe { moca_async_resolve(handle as *mut MocaAsync, value) };
+            });
+            MocaResult::Ok
+        }
+
+        // fun wait(id: int) -> int { return recv(id); }
+        let chunk = Chunk {
+            functions: vec![Function {
+                name: "wait".to_string(),
+                arity: 1,
+                locals_count: 1,
+                code: vec![Op::LocalGet(0), Op::ChannelRecv, Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![ValueType::I64],
+            }],
+            main: Function {
+                name: "main".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: vec![Op::I64Const(0), Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec![].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        };
+        let data = bytecode::serialize(&chunk);
+
+        unsafe {
+            let vm = moca_vm_new();
+            assert_eq!(
+                crate::ffi::load::moca_load_chunk(vm, data.as_ptr(), data.len()),
+                MocaResult::Ok
+            );
+            let fetch_name = CString::new("fetch").unwrap();
+            let wait_name = CString::new("wait").unwrap();
+            moca_register_function(vm, fetch_name.as_ptr(), fetch, 0);
+
+            // The host function returns at once with the pending id
+            assert_eq!(moca_call(vm, fetch_name.as_ptr(), 0), MocaResult::Ok);
+            assert_eq!(moca_get_top(vm), 1);
+            assert_eq!(moca_call(vm, wait_name.as_ptr(), 1), MocaResult::Ok);
+            assert_eq!(moca_to_i64(vm, -1), 42);
+            moca_pop(vm, 1);
+
+            // A cancelled result reads as null; references are rejected
+            let handle = moca_async_begin(vm);
+            let reference = MocaValue {
+                tag: MocaValueTag::Ref,
+                data: MocaValue::from_value(Value::I64(0)).data,
+            };
+            assert_eq!(
+                moca_async_resolve(handle, reference),
+                MocaResult::ErrorInvalidArg
+            );
+            moca_async_cancel(handle);
+            assert_eq!(moca_call(vm, wait_name.as_ptr(), 1), MocaResult::Ok);
+            assert!(moca_is_null(vm, -1));
+
+            moca_vm_free(vm);
+        }
+    }
+
+    #[test]
+    fn test_async_ids_are_reused() {
+        use crate::vm::{Chunk, Function, Op, ValueType, bytecode};
+
+        unsafe extern "C" fn fetch(vm: *mut MocaVm) -> MocaResult {
+            let handle = unsafe { moca_async_begin(vm) };
+            let value = MocaValue::from_value(Value::I64(7));
+            unsafe { moca_async_resolve(handle, value) }
+        }
+
+        unsafe extern "C" fn drop_result(vm: *mut MocaVm) -> MocaResult {
+            unsafe { moca_async_cancel(moca_async_begin(vm)) };
+            MocaResult::Ok
+        }
+
+        let chunk = Chunk {
+            functions: vec![Function {
+                name: "wait".to_string(),
+                arity: 1,
+                locals_count: 1,
+                code: vec![Op::LocalGet(0), Op::ChannelRecv, Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![ValueType::I64],
+            }],
+            main: Function {
+                name: "main".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: vec![Op::I64Const(0), Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec![].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        };
+        let data = bytecode::serialize(&chunk);
+
+        unsafe {
+            let vm = moca_vm_new();
+            assert_eq!(
+                crate::ffi::load::moca_load_chunk(vm, data.as_ptr(), data.len()),
+                MocaResult::Ok
+            );
+            let fetch_name = CString::new("fetch").unwrap();
+            let drop_name = CString::new("drop_result").unwrap();
+            let wait_name = CString::new("wait").unwrap();
+            moca_register_function(vm, fetch_name.as_ptr(), fetch, 0);
+            moca_register_function(vm, drop_name.as_ptr(), drop_result, 0);
+
+            for i in 0..10_000 {
+                let name = if i % 2 == 0 { &fetch_name } else { &drop_name };
+                assert_eq!(moca_call(vm, name.as_ptr(), 0), MocaResult::Ok);
+                assert_eq!(moca_call(vm, wait_name.as_ptr(), 1), MocaResult::Ok);
+                moca_pop(vm, 1);
+            }
+            let wrapper = crate::ffi::vm_ffi::get_wrapper(vm).unwrap();
+            assert_eq!(wrapper.vm.channel_count(), 1);
+
+            moca_vm_free(vm);
+        }
+    }
+
+    fn add_chunk_bytes() -> Vec<u8> {
+        use crate::vm::{Chunk, Function, Op, ValueType, bytecode};
+
+        let chunk = Chunk {
+            functions: vec![Function {
+                name: "add".to_string(),
+                arity: 2,
+                locals_count: 2,
+                code: vec![Op::LocalGet(0), Op::LocalGet(1), Op::I64Add, Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![ValueType::I64, ValueType::I64],
+            }],
+            main: Function {
+                name: "main".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: vec![Op::I64Const(7), Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec![].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        };
+        bytecode::serialize(&chunk)
+    }
+
+    #[test]
+    fn test_call_moca_function() {
+        let data = add_chunk_bytes();
+        unsafe {
+            let vm = moca_vm_new();
+            assert_eq!(
+                crate::ffi::load::moca_load_chunk(vm, data.as_ptr(), data.len()),
+                MocaResult::Ok
+            );
+            let name = CString::new("add").unwrap();
+
+            // Values below the arguments are left untouched
+            moca_push_i64(vm, 99);
+            moca_push_i64(vm, 10);
+            moca_push_i64(vm, 32);
+            assert_eq!(moca_call(vm, name.as_ptr(), 2), MocaResult::Ok);
+            assert_eq!(moca_get_top(vm), 2);
+            assert_eq!(moca_to_i64(vm, -1), 42);
+            assert_eq!(moca_to_i64(vm, 0), 99);
+
+            let main = CString::new("main").unwrap();
+            assert_eq!(moca_call(vm, main.as_ptr(), 0), MocaResult::Ok);
+            assert_eq!(moca_to_i64(vm, -1), 7);
+
+            moca_vm_free(vm);
+        }
+    }
+
+    #[test]
+    fn test_call_corrupt_body() {
+        // Bodies come last and main's is the final one
+        let mut data = add_chunk_bytes();
+        *data.last_mut().unwrap() = 0xff;
+        unsafe {
+            let vm = moca_vm_new();
+            assert_eq!(
+                crate::ffi::load::moca_load_chunk(vm, data.as_ptr(), data.len()),
+                MocaResult::Ok
+            );
+
+            let main = CString::new("main").unwrap();
+            assert_eq!(moca_call(vm, main.as_ptr(), 0), MocaResult::ErrorVerify);
+            assert_eq!(moca_get_top(vm), 0);
+
+            // Intact bodies still run
+            let add = CString::new("add").unwrap();
+            moca_push_i64(vm, 1);
+            moca_push_i64(vm, 2);
+            assert_eq!(moca_call(vm, add.as_ptr(), 2), MocaResult::Ok);
+            assert_eq!(moca_to_i64(vm, -1), 3);
+
+            moca_vm_free(vm);
+        }
+    }
+
+    #[test]
+    fn test_call_hot_function_repeatedly() {
+        let data = add_chunk_bytes();
+        unsafe {
+            let vm = moca_vm_new();
+            crate::ffi::load::moca_load_chunk(vm, data.as_ptr(), data.len());
+            let name = CString::new("add").unwrap();
+
+            // Cross the JIT threshold so later calls take the compiled tier
+            for i in 0..2000 {
+                moca_push_i64(vm, i);
+                moca_push_i64(vm, 1);
+                assert_eq!(moca_call(vm, name.as_ptr(), 2), MocaResult::Ok);
+                assert_eq!(moca_to_i64(vm, -1), i + 1);
+                moca_pop(vm, 1);
+            }
+            assert_eq!(moca_get_top(vm), 0);
+
+            #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+            assert!(get_wrapper_mut(vm).unwrap().vm.jit_compile_count() > 0);
+
+            moca_vm_free(vm);
+        }
+    }
+
+    #[test]
+    fn test_call_function_ref() {
+        let data = add_chunk_bytes();
+        unsafe {
+            let vm = moca_vm_new();
+            crate::ffi::load::moca_load_chunk(vm, data.as_ptr(), data.len());
+            let name = CString::new("add").unwrap();
+
+            let mut add = MocaFunctionRef {
+                func_index: 0,
+                arity: 0,
+            };
+            assert_eq!(
+                moca_function_ref(vm, name.as_ptr(), 2, &mut add),
+                MocaResult::Ok
+            );
+            assert_eq!(add.func_index, 0);
+            assert_eq!(add.arity, 2);
+
+            for i in 0..2000 {
+                moca_push_i64(vm, i);
+                moca_push_i64(vm, i);
+                assert_eq!(moca_call_ref(vm, add, 2), MocaResult::Ok);
+                assert_eq!(moca_to_i64(vm, -1), 2 * i);
+                moca_pop(vm, 1);
+            }
+
+            // Arity is checked against the handle, not looked up again
+            moca_push_i64(vm, 1);
+            assert_eq!(moca_call_ref(vm, add, 1), MocaResult::ErrorInvalidArg);
+
+            let main = CString::new("main").unwrap();
+            let mut main_ref = add;
+            assert_eq!(
+                moca_function_ref(vm, main.as_ptr(), 0, &mut main_ref),
+                MocaResult::Ok
+            );
+            assert_eq!(main_ref.func_index, MocaFunctionRef::MAIN_INDEX);
+            assert_eq!(moca_call_ref(vm, main_ref, 0), MocaResult::Ok);
+            assert_eq!(moca_to_i64(vm, -1), 7);
+
+            moca_vm_free(vm);
+        }
+    }
+
+    #[test]
+    fn test_function_ref_errors() {
+        let data = add_chunk_bytes();
+        unsafe {
+            let vm = moca_vm_new();
+            let name = CString::new("add").unwrap();
+            let mut handle = MocaFunctionRef {
+                func_index: 0,
+                arity: 0,
+            };
+
+            // No bytecode loaded yet
+            assert_eq!(
+                moca_function_ref(vm, name.as_ptr(), 2, &mut handle),
+                MocaResult::ErrorNotFound
+            );
+
+            crate::ffi::load::moca_load_chunk(vm, data.as_ptr(), data.len());
+            assert_eq!(
+                moca_function_ref(vm, name.as_ptr(), 3, &mut handle),
+                MocaResult::ErrorInvalidArg
+            );
+            let missing = CString::new("missing").unwrap();
+            assert_eq!(
+                moca_function_ref(vm, missing.as_ptr(), 0, &mut handle),
+                MocaResult::ErrorNotFound
+            );
+
+            // A handle that does not belong to this chunk fails at call time
+            let stale = MocaFunctionRef {
+                func_index: 5,
+                arity: 0,
+            };
+            assert_eq!(moca_call_ref(vm, stale, 0), MocaResult::ErrorRuntime);
+
+            moca_vm_free(vm);
+        }
+    }
+
+    #[test]
+    fn test_call_batch() {
+        let data = add_chunk_bytes();
+        unsafe {
+            let vm = moca_vm_new();
+            crate::ffi::load::moca_load_chunk(vm, data.as_ptr(), data.len());
+            let name = CString::new("add").unwrap();
+            let mut add = MocaFunctionRef {
+                func_index: 0,
+                arity: 0,
+            };
+            moca_function_ref(vm, name.as_ptr(), 2, &mut add);
+
+            // Large enough to cross the JIT threshold part-way through
+            let count = 3000;
+            let args: Vec<MocaValue> = (0..count as i64)
+                .flat_map(|i| [Value::I64(i), Value::I64(100)])
+                .map(MocaValue::from_value)
+                .collect();
+            let mut results = vec![MocaValue::from_value(Value::Null); count];
+
+            let res = moca_call_batch(vm, add, args.as_ptr(), 2, count, results.as_mut_ptr());
+            assert_eq!(res, MocaResult::Ok);
+            for (i, r) in results.iter().enumerate() {
+                assert_eq!(r.to_value(), Value::I64(i as i64 + 100));
+            }
+            assert_eq!(moca_get_top(vm), 0);
+
+            #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+            assert!(get_wrapper_mut(vm).unwrap().vm.jit_compile_count() > 0);
+
+            // Arity mismatch and empty batches
+            let res = moca_call_batch(vm, add, args.as_ptr(), 1, 1, results.as_mut_ptr());
+            assert_eq!(res, MocaResult::ErrorInvalidArg);
+            let res = moca_call_batch(vm, add, std::ptr::null(), 2, 0, std::ptr::null_mut());
+            assert_eq!(res, MocaResult::Ok);
+
+            moca_vm_free(vm);
+        }
+    }
+
+    #[test]
+    fn test_call_wrong_arity() {
+        let data = add_chunk_bytes();
+        unsafe {
+            let vm = moca_vm_new();
+            crate::ffi::load::moca_load_chunk(vm, data.as_ptr(), data.len());
+            let name = CString::new("add").unwrap();
+
+            moca_push_i64(vm, 1);
+            assert_eq!(moca_call(vm, name.as_ptr(), 1), MocaResult::ErrorInvalidArg);
+            assert_eq!(moca_call(vm, name.as_ptr(), 5), MocaResult::ErrorInvalidArg);
+
+            moca_vm_free(vm);
+        }
+    }
+
+    #[test]
+    fn test_global_survives_gc_in_call() {
+        use crate::vm::{Chunk, Function, Op, ValueType, bytecode};
+
+        // churn(n): allocate n two-slot objects and drop them
+        let churn = Function {
+            name: "churn".to_string(),
+            arity: 1,
+            locals_count: 2,
+            code: vec![
+                Op::I64Const(0),
+                Op::LocalSet(1),
+                Op::LocalGet(1),
+                Op::LocalGet(0),
+                Op::I64LtS,
+                Op::BrIfFalse(15),
+                Op::LocalGet(1),
+                Op::LocalGet(1),
+                Op::HeapAlloc(2),
+                Op::Drop,
+                Op::LocalGet(1),
+                Op::I64Const(1),
+                Op::I64Add,
+                Op::LocalSet(1),
+                Op::Jmp(2),
+                Op::LocalGet(1),
+                Op::Ret,
+            ]
+            .into(),
+            stackmap: None,
+            local_types: vec![ValueType::I64, ValueType::I64],
+        };
+        let chunk = Chunk {
+            functions: vec![churn],
+            main: Function {
+                name: "main".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: vec![Op::I64Const(0), Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec![].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        };
+        let data = bytecode::serialize(&chunk);
+
+        unsafe {
+            let vm = moca_vm_new();
+            assert_eq!(
+                crate::ffi::load::moca_load_chunk(vm, data.as_ptr(), data.len()),
+                MocaResult::Ok
+            );
+            let payload = "held only by a host global";
+            crate::ffi::stack::moca_push_string(
+                vm,
+                payload.as_ptr() as *const c_char,
+                payload.len(),
+            );
+            assert_eq!(moca_set_global(vm, c"kept".as_ptr()), MocaResult::Ok);
+
+            moca_push_i64(vm, 200_000);
+            assert_eq!(moca_call(vm, c"churn".as_ptr(), 1), MocaResult::Ok);
+            assert_eq!(moca_to_i64(vm, -1), 200_000);
+            moca_pop(vm, 1);
+            let stats = get_wrapper_mut(vm).unwrap().vm.gc_stats();
+            assert!(stats.cycles + stats.minor_cycles > 0);
+
+            assert_eq!(moca_get_global(vm, c"kept".as_ptr()), MocaResult::Ok);
+            let mut len = 0;
+            let ptr = crate::ffi::stack::moca_to_string(vm, -1, &mut len);
+            assert!(!ptr.is_null());
+            assert_eq!(
+                std::slice::from_raw_parts(ptr as *const u8, len),
+                payload.as_bytes()
+            );
+
+            moca_vm_free(vm);
+        }
+    }
+
     #[test]
     fn test_call_not_found() {
         unsafe {
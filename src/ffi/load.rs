@@ -6,8 +6,11 @@
 
 use super::types::{MocaResult, MocaVm};
 use super::vm_ffi::get_wrapper_mut;
-use crate::vm::bytecode;
+#[cfg(all(target_arch = "x86_64", feature = "jit"))]
+use crate::jit::cache::JitCache;
+use crate::vm::{BytecodeSource, bytecode};
 use std::ffi::c_char;
+use std::sync::Arc;
 
 /// Load bytecode from memory.
 ///
@@ -52,6 +55,14 @@ pub unsafe extern "C" fn moca_load_chunk(
     // Optionally verify the bytecode
     // For now, we trust the bytecode is valid (verification can be added later)
 
+    // Set up globals, string cache and JIT tables so functions can be called
+    let chunk = Arc::new(chunk);
+    wrapper.vm.share_chunk(chunk.clone());
+    if let Err(e) = wrapper.vm.prepare(&chunk) {
+        wrapper.set_error(format!("failed to initialize chunk: {}", e));
+        return MocaResult::ErrorMemory;
+    }
+
     // Store the chunk
     wrapper.chunk = Some(chunk);
     wrapper.clear_error();
@@ -61,7 +72,9 @@ pub unsafe extern "C" fn moca_load_chunk(
 
 /// Load bytecode from a file.
 ///
-/// This reads the file, parses the bytecode, and validates it.
+/// The file is memory-mapped. For version 3 files only the function headers
+/// are decoded here; each function body is decoded the first time it runs.
+/// The file must not be modified while the VM uses it.
 ///
 /// # Arguments
 /// - `vm`: Valid VM instance
@@ -93,17 +106,17 @@ pub unsafe extern "C" fn moca_load_file(vm: *mut MocaVm, path: *const c_char) ->
         }
     };
 
-    // Read the file
-    let data = match std::fs::read(path_str) {
-        Ok(d) => d,
+    // Map the file
+    let source = match BytecodeSource::map_file(std::path::Path::new(path_str)) {
+        Ok(source) => source,
         Err(e) => {
             wrapper.set_error(format!("cannot read file: {}", e));
             return MocaResult::ErrorNotFound;
         }
     };
 
-    // Deserialize the chunk
-    let chunk = match bytecode::deserialize(&data) {
+    // Deserialize the chunk (function bodies stay in the mapping)
+    let chunk = match bytecode::load(Arc::new(source)) {
         Ok(c) => c,
         Err(e) => {
             wrapper.set_error(format!("bytecode error: {}", e));
@@ -111,6 +124,14 @@ pub unsafe extern "C" fn moca_load_file(vm: *mut MocaVm, path: *const c_char) ->
         }
     };
 
+    // Set up globals, string cache and JIT tables so functions can be called
+    let chunk = Arc::new(chunk);
+    wrapper.vm.share_chunk(chunk.clone());
+    if let Err(e) = wrapper.vm.prepare(&chunk) {
+        wrapper.set_error(format!("failed to initialize chunk: {}", e));
+        return MocaResult::ErrorMemory;
+    }
+
     // Store the chunk
     wrapper.chunk = Some(chunk);
     wrapper.clear_error();
@@ -172,6 +193,121 @@ pub unsafe extern "C" fn moca_save_file(vm: *mut MocaVm, path: *const c_char) ->
     }
 }
 
+/// Load a persistent JIT code cache and attach it to the VM.
+///
+/// Functions and loops whose bytecode matches a cache entry run as native
+/// code from their first call instead of waiting for the JIT threshold.
+/// Entries apply to chunks loaded afterwards and to the current chunk. Code
+/// compiled while the cache is attached is added to it; write it back with
+/// `moca_save_jit_cache`. Entries are keyed by bytecode and CPU, so the cache
+/// can be shared by every process running the same moca build on the same
+/// kind of machine.
+///
+/// A missing file, or a file written by another moca build or for another
+/// CPU, attaches an empty cache.
+///
+/// # Arguments
+/// - `vm`: Valid VM instance
+/// - `path`: Path to the cache file (null-terminated)
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if path is NULL
+/// - `MOCA_ERROR_VERIFY` if the file is not a valid JIT cache
+/// - `MOCA_ERROR_RUNTIME` if the JIT is not available on this platform
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_load_jit_cache(vm: *mut MocaVm, path: *const c_char) -> MocaResult {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+
+    if path.is_null() {
+        wrapper.set_error("path is NULL");
+        return MocaResult::ErrorInvalidArg;
+    }
+
+    let c_str = std::ffi::CStr::from_ptr(path);
+    let Ok(path_str) = c_str.to_str() else {
+        wrapper.set_error("invalid UTF-8 in path");
+        return MocaResult::ErrorInvalidArg;
+    };
+
+    #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+    {
+        let cache = match JitCache::load(std::path::Path::new(path_str)) {
+            Ok(cache) => cache,
+            Err(e) => {
+                wrapper.set_error(e);
+                return MocaResult::ErrorVerify;
+            }
+        };
+        wrapper.vm.set_jit_cache(cache);
+        if let Some(ref chunk) = wrapper.chunk {
+            wrapper.vm.install_cached_jit_code(chunk);
+        }
+        wrapper.clear_error();
+        MocaResult::Ok
+    }
+    #[cfg(not(all(target_arch = "x86_64", feature = "jit")))]
+    {
+        let _ = path_str;
+        wrapper.set_error("JIT cache is not supported on this platform");
+        MocaResult::ErrorRuntime
+    }
+}
+
+/// Save the attached JIT code cache to a file.
+///
+/// # Arguments
+/// - `vm`: Valid VM instance
+/// - `path`: Path to the cache file (null-terminated)
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if path is NULL or no cache is attached
+/// - `MOCA_ERROR_RUNTIME` if the file cannot be written
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_save_jit_cache(vm: *mut MocaVm, path: *const c_char) -> MocaResult {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+
+    if path.is_null() {
+        wrapper.set_error("path is NULL");
+        return MocaResult::ErrorInvalidArg;
+    }
+
+    let c_str = std::ffi::CStr::from_ptr(path);
+    let Ok(path_str) = c_str.to_str() else {
+        wrapper.set_error("invalid UTF-8 in path");
+        return MocaResult::ErrorInvalidArg;
+    };
+
+    #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+    {
+        let Some(cache) = wrapper.vm.jit_cache() else {
+            wrapper.set_error("no JIT cache attached (call moca_load_jit_cache first)");
+            return MocaResult::ErrorInvalidArg;
+        };
+        match cache.save(std::path::Path::new(path_str)) {
+            Ok(()) => {
+                wrapper.clear_error();
+                MocaResult::Ok
+            }
+            Err(e) => {
+                wrapper.set_error(e);
+                MocaResult::ErrorRuntime
+            }
+        }
+    }
+    #[cfg(not(all(target_arch = "x86_64", feature = "jit")))]
+    {
+        let _ = path_str;
+        wrapper.set_error("no JIT cache attached (call moca_load_jit_cache first)");
+        MocaResult::ErrorInvalidArg
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -188,11 +324,11 @@ mod tests {
                 name: "main".to_string(),
                 arity: 0,
                 locals_count: 0,
-                code: vec![Op::I64Const(42), Op::TypeOf, Op::Ret],
+                code: vec![Op::I64Const(42), Op::TypeOf, Op::Ret].into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec![],
+            strings: vec![].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -264,11 +400,11 @@ mod tests {
                 name: "main".to_string(),
                 arity: 0,
                 locals_count: 0,
-                code: vec![Op::I64Const(123), Op::Ret],
+                code: vec![Op::I64Const(123), Op::Ret].into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec!["test".to_string()],
+            strings: vec!["test".to_string()].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -307,7 +443,7 @@ mod tests {
             let loaded_chunk = wrapper.chunk.as_ref().unwrap();
             assert_eq!(loaded_chunk.main.name, "main");
             assert_eq!(loaded_chunk.strings.len(), 1);
-            assert_eq!(loaded_chunk.strings[0], "test");
+            assert_eq!(&loaded_chunk.strings[0], "test");
 
             moca_vm_free(vm);
         }
@@ -315,4 +451,84 @@ mod tests {
         // Clean up
         std::fs::remove_file(&temp_path).ok();
     }
+
+    #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+    #[test]
+    fn test_jit_cache_skips_warmup() {
+        use crate::ffi::call::moca_call;
+        use crate::ffi::stack::{moca_pop, moca_push_i64, moca_to_i64};
+
+        let add = Function {
+            name: "add".to_string(),
+            arity: 2,
+            locals_count: 2,
+            code: vec![Op::LocalGet(0), Op::LocalGet(1), Op::I64Add, Op::Ret].into(),
+            stackmap: None,
+            local_types: vec![],
+        };
+        let chunk = Chunk {
+            functions: vec![add],
+            main: Function {
+                name: "main".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: vec![Op::I64Const(0), Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec![].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        };
+        let data = bytecode::serialize(&chunk);
+        let cache_path = std::env::temp_dir().join("test_moca_jit_cache.bin");
+        std::fs::remove_file(&cache_path).ok();
+        let path_cstr = CString::new(cache_path.to_str().unwrap()).unwrap();
+        let name = CString::new("add").unwrap();
+
+        unsafe {
+            // Warm up with an empty cache, then persist it
+            let vm = moca_vm_new();
+            assert_eq!(moca_load_jit_cache(vm, path_cstr.as_ptr()), MocaResult::Ok);
+            moca_load_chunk(vm, data.as_ptr(), data.len());
+            for i in 0..1500 {
+                moca_push_i64(vm, i);
+                moca_push_i64(vm, 1);
+                assert_eq!(moca_call(vm, name.as_ptr(), 2), MocaResult::Ok);
+                moca_pop(vm, 1);
+            }
+            assert!(get_wrapper_mut(vm).unwrap().vm.jit_compile_count() > 0);
+            assert_eq!(moca_save_jit_cache(vm, path_cstr.as_ptr()), MocaResult::Ok);
+            moca_vm_free(vm);
+
+            // A fresh VM runs the cached code without compiling
+            let vm = moca_vm_new();
+            moca_load_chunk(vm, data.as_ptr(), data.len());
+            assert_eq!(moca_load_jit_cache(vm, path_cstr.as_ptr()), MocaResult::Ok);
+            moca_push_i64(vm, 40);
+            moca_push_i64(vm, 2);
+            assert_eq!(moca_call(vm, name.as_ptr(), 2), MocaResult::Ok);
+            assert_eq!(moca_to_i64(vm, -1), 42);
+            let wrapper = get_wrapper_mut(vm).unwrap();
+            assert_eq!(wrapper.vm.jit_compile_count(), 0);
+            assert_eq!(wrapper.vm.jit_cache().map(|c| c.len()), Some(1));
+            moca_vm_free(vm);
+        }
+
+        std::fs::remove_file(&cache_path).ok();
+    }
+
+    #[test]
+    fn test_save_jit_cache_without_cache() {
+        unsafe {
+            let vm = moca_vm_new();
+            let path = CString::new("/tmp/unused_moca_jit_cache.bin").unwrap();
+            assert_eq!(
+                moca_save_jit_cache(vm, path.as_ptr()),
+                MocaResult::ErrorInvalidArg
+            );
+            moca_vm_free(vm);
+        }
+    }
 }
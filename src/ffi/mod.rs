@@ -13,6 +13,7 @@
 mod call;
 mod error;
 mod load;
+mod pool;
 mod stack;
 mod types;
 mod vm_ffi;
@@ -25,6 +26,8 @@ pub use error::*;
 #[allow(unused_imports)]
 pub use load::*;
 #[allow(unused_imports)]
+pub use pool::*;
+#[allow(unused_imports)]
 pub use stack::*;
 #[allow(unused_imports)]
 pub use types::*;
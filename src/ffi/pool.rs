@@ -0,0 +1,421 @@
+//! VM pool FFI functions.
+//!
+//! A pool is built from an initialized VM and hands out independent VM
+//! instances to host threads. All instances share the template's chunk and
+//! start from a snapshot of its heap and globals, so the bytecode is loaded
+//! and initialized once. Idle instances sit in a lock-free ring
+//! (`vm::threads::Channel`), and the pool's counters are atomics: checkout
+//! and checkin never take a lock.
+
+#![allow(unsafe_op_in_unsafe_fn)]
+#![allow(clippy::missing_safety_doc)]
+
+use super::types::{
+    MocaPool, MocaPoolStats, MocaResult, MocaVm, PoolLease, SnapshotWrapper, VmWrapper,
+};
+use super::vm_ffi::{get_wrapper, get_wrapper_mut};
+use crate::vm::threads::Channel;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+
+/// An instance waiting in the pool.
+struct IdleVm(Box<VmWrapper>);
+
+// SAFETY: an instance is only used by the thread that checked it out; the
+// pool just moves it between threads while nobody uses it.
+unsafe impl Send for IdleVm {}
+
+/// Internal pool state behind a `MocaPool` pointer.
+pub(crate) struct PoolWrapper {
+    template: SnapshotWrapper,
+    idle: Arc<Channel<IdleVm>>,
+    created: AtomicU64,
+    freed: AtomicU64,
+    checkouts: AtomicU64,
+    checkins: AtomicU64,
+    misses: AtomicU64,
+    gc_cycles: AtomicU64,
+    gc_minor_cycles: AtomicU64,
+    gc_pause_us: AtomicU64,
+    idle_heap_bytes: AtomicUsize,
+}
+
+impl PoolWrapper {
+    fn id(&self) -> usize {
+        self as *const PoolWrapper as usize
+    }
+
+    fn new_instance(&self) -> Box<VmWrapper> {
+        self.created.fetch_add(1, Ordering::Relaxed);
+        Box::new(self.template.instantiate())
+    }
+
+    /// Put an instance back, or free it if the pool is full.
+    fn park(&self, wrapper: Box<VmWrapper>) {
+        let heap_bytes = wrapper.vm.heap().bytes_allocated();
+        // Count the bytes first so a concurrent checkout never sees them negative
+        self.idle_heap_bytes
+            .fetch_add(heap_bytes, Ordering::Relaxed);
+        if self.idle.try_send(IdleVm(wrapper)).is_err() {
+            self.idle_heap_bytes
+                .fetch_sub(heap_bytes, Ordering::Relaxed);
+            self.freed.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+}
+
+/// Create a pool of VM instances from an initialized VM.
+///
+/// The template VM must have bytecode loaded. Its heap, globals and
+/// registered host functions are captured as with `moca_vm_snapshot()`;
+/// later changes to the template do not affect the pool. `size` instances
+/// are created up front, and at most `size` idle instances are kept (rounded
+/// up to a power of two).
+///
+/// Returns NULL if `vm` is NULL or has no bytecode loaded. The pool must be
+/// freed with `moca_pool_free()`.
+///
+/// # Example (C)
+/// ```c
+/// MocaPool *pool = moca_pool_new(vm, 64);
+///
+/// // On each request thread
+/// MocaVm *worker = moca_pool_checkout(pool);
+/// moca_push_i64(worker, 42);
+/// moca_call(worker, "handle", 1);
+/// moca_pool_checkin(pool, worker);
+/// ```
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_pool_new(vm: *const MocaVm, size: usize) -> *mut MocaPool {
+    let Some(template) = get_wrapper(vm).and_then(SnapshotWrapper::capture) else {
+        return std::ptr::null_mut();
+    };
+
+    let pool = Box::new(PoolWrapper {
+        template,
+        idle: Channel::bounded(size),
+        created: AtomicU64::new(0),
+        freed: AtomicU64::new(0),
+        checkouts: AtomicU64::new(0),
+        checkins: AtomicU64::new(0),
+        misses: AtomicU64::new(0),
+        gc_cycles: AtomicU64::new(0),
+        gc_minor_cycles: AtomicU64::new(0),
+        gc_pause_us: AtomicU64::new(0),
+        idle_heap_bytes: AtomicUsize::new(0),
+    });
+    for _ in 0..size {
+        pool.park(pool.new_instance());
+    }
+    Box::into_raw(pool) as *mut MocaPool
+}
+
+/// Take a VM instance out of the pool.
+///
+/// Reuses an idle instance if there is one and creates a new one from the
+/// template otherwise. The instance keeps the heap and globals left by its
+/// previous user; its stack and last error are empty. Until it is checked
+/// in, only the calling thread may use it.
+///
+/// Returns NULL if `pool` is NULL.
+///
+/// # Thread safety
+///
+/// May be called from any number of threads at once.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_pool_checkout(pool: *mut MocaPool) -> *mut MocaVm {
+    let Some(pool) = get_pool(pool) else {
+        return std::ptr::null_mut();
+    };
+
+    pool.checkouts.fetch_add(1, Ordering::Relaxed);
+    let mut wrapper = match pool.idle.try_recv() {
+        Some(IdleVm(wrapper)) => {
+            let heap_bytes = wrapper.vm.heap().bytes_allocated();
+            pool.idle_heap_bytes
+                .fetch_sub(heap_bytes, Ordering::Relaxed);
+            wrapper
+        }
+        None => {
+            pool.misses.fetch_add(1, Ordering::Relaxed);
+            pool.new_instance()
+        }
+    };
+
+    let gc = wrapper.vm.gc_stats();
+    wrapper.pool_lease = Some(PoolLease {
+        pool: pool.id(),
+        gc_cycles: gc.cycles,
+        gc_minor_cycles: gc.minor_cycles,
+        gc_pause_us: gc.total_pause_us,
+    });
+    Box::into_raw(wrapper) as *mut MocaVm
+}
+
+/// Return a VM instance to the pool.
+///
+/// Clears the instance's stack, last error and error callback and adds the
+/// GC work it did to the pool statistics. If the pool already holds its
+/// maximum number of idle instances, the instance is freed. The `vm`
+/// pointer must not be used after this call.
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if an argument is NULL or `vm` is not checked
+///   out of `pool` (the VM is left untouched)
+///
+/// # Thread safety
+///
+/// May be called from any number of threads at once.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_pool_checkin(pool: *mut MocaPool, vm: *mut MocaVm) -> MocaResult {
+    let (Some(pool), Some(wrapper)) = (get_pool(pool), get_wrapper_mut(vm)) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+    let lease = match wrapper.pool_lease {
+        Some(lease) if lease.pool == pool.id() => lease,
+        _ => {
+            wrapper.set_error("VM is not checked out of this pool");
+            return MocaResult::ErrorInvalidArg;
+        }
+    };
+
+    let gc = wrapper.vm.gc_stats();
+    let gc_cycles = (gc.cycles - lease.gc_cycles) as u64;
+    let gc_minor_cycles = (gc.minor_cycles - lease.gc_minor_cycles) as u64;
+    let gc_pause_us = gc.total_pause_us - lease.gc_pause_us;
+    pool.gc_cycles.fetch_add(gc_cycles, Ordering::Relaxed);
+    pool.gc_minor_cycles
+        .fetch_add(gc_minor_cycles, Ordering::Relaxed);
+    pool.gc_pause_us.fetch_add(gc_pause_us, Ordering::Relaxed);
+
+    wrapper.pool_lease = None;
+    wrapper.ffi_stack.clear();
+    wrapper.batch_buffer.clear();
+    wrapper.error_callback = None;
+    wrapper.error_userdata = std::ptr::null_mut();
+    wrapper.clear_error();
+
+    pool.checkins.fetch_add(1, Ordering::Relaxed);
+    pool.park(Box::from_raw(vm as *mut VmWrapper));
+    MocaResult::Ok
+}
+
+/// Read the aggregate statistics of a pool.
+///
+/// The counters are read one by one while other threads may be checking
+/// instances in and out, so they are only consistent with each other when
+/// the pool is quiet.
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if an argument is NULL
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_pool_stats(
+    pool: *const MocaPool,
+    out: *mut MocaPoolStats,
+) -> MocaResult {
+    let Some(pool) = get_pool(pool as *mut MocaPool) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+    if out.is_null() {
+        return MocaResult::ErrorInvalidArg;
+    }
+
+    let created = pool.created.load(Ordering::Relaxed);
+    let freed = pool.freed.load(Ordering::Relaxed);
+    let checkouts = pool.checkouts.load(Ordering::Relaxed);
+    let checkins = pool.checkins.load(Ordering::Relaxed);
+    *out = MocaPoolStats {
+        instances: created.saturating_sub(freed) as usize,
+        idle: pool.idle.len(),
+        checked_out: checkouts.saturating_sub(checkins) as usize,
+        checkouts,
+        misses: pool.misses.load(Ordering::Relaxed),
+        gc_cycles: pool.gc_cycles.load(Ordering::Relaxed),
+        gc_minor_cycles: pool.gc_minor_cycles.load(Ordering::Relaxed),
+        gc_pause_us: pool.gc_pause_us.load(Ordering::Relaxed),
+        idle_heap_bytes: pool.idle_heap_bytes.load(Ordering::Relaxed),
+    };
+    MocaResult::Ok
+}
+
+/// Free a pool and its idle instances.
+///
+/// All checked-out instances must have been checked in first; an instance
+/// that is still out must not be checked in afterwards.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_pool_free(pool: *mut MocaPool) {
+    if pool.is_null() {
+        return;
+    }
+    let _ = Box::from_raw(pool as *mut PoolWrapper);
+}
+
+unsafe fn get_pool(pool: *mut MocaPool) -> Option<&'static PoolWrapper> {
+    if pool.is_null() {
+        None
+    } else {
+        Some(&*(pool as *const PoolWrapper))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::call::{moca_call, moca_get_global, moca_set_global};
+    use crate::ffi::load::moca_load_chunk;
+    use crate::ffi::stack::{moca_get_top, moca_pop, moca_push_i64, moca_push_string, moca_to_i64};
+    use crate::ffi::vm_ffi::{moca_vm_free, moca_vm_new};
+    use crate::vm::{Chunk, Function, Op, ValueType, bytecode};
+
+    /// A VM with `add(a, b)` loaded, a global `base` set to 100 and a string
+    /// global `name` on its heap.
+    unsafe fn template() -> *mut MocaVm {
+        let chunk = Chunk {
+            functions: vec![Function {
+                name: "add".to_string(),
+                arity: 2,
+                locals_count: 2,
+                code: vec![Op::LocalGet(0), Op::LocalGet(1), Op::I64Add, Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![ValueType::I64, ValueType::I64],
+            }],
+            main: Function {
+                name: "main".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: vec![Op::I64Const(0), Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec![].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        };
+        let data = bytecode::serialize(&chunk);
+        let vm = moca_vm_new();
+        assert_eq!(
+            moca_load_chunk(vm, data.as_ptr(), data.len()),
+            MocaResult::Ok
+        );
+        moca_push_i64(vm, 100);
+        assert_eq!(moca_set_global(vm, c"base".as_ptr()), MocaResult::Ok);
+        moca_push_string(vm, c"pool".as_ptr(), 4);
+        assert_eq!(moca_set_global(vm, c"name".as_ptr()), MocaResult::Ok);
+        vm
+    }
+
+    unsafe fn stats(pool: *mut MocaPool) -> MocaPoolStats {
+        let mut stats = MocaPoolStats::default();
+        assert_eq!(moca_pool_stats(pool, &mut stats), MocaResult::Ok);
+        stats
+    }
+
+    #[test]
+    fn test_pool_checkout_checkin() {
+        unsafe {
+            assert!(moca_pool_new(std::ptr::null(), 2).is_null());
+            let empty = moca_vm_new();
+            assert!(moca_pool_new(empty, 2).is_null());
+            moca_vm_free(empty);
+
+            let vm = template();
+            let pool = moca_pool_new(vm, 2);
+            moca_vm_free(vm);
+            assert!(!pool.is_null());
+            assert_eq!(stats(pool).instances, 2);
+            assert_eq!(stats(pool).idle, 2);
+
+            // Three checkouts from a pool of two create one more instance
+            let workers: Vec<_> = (0..3).map(|_| moca_pool_checkout(pool)).collect();
+            let s = stats(pool);
+            assert_eq!((s.instances, s.idle, s.checked_out), (3, 0, 3));
+            assert_eq!((s.checkouts, s.misses), (3, 1));
+
+            for &worker in &workers {
+                assert_eq!(moca_get_global(worker, c"base".as_ptr()), MocaResult::Ok);
+                moca_push_i64(worker, 1);
+                assert_eq!(moca_call(worker, c"add".as_ptr(), 2), MocaResult::Ok);
+                assert_eq!(moca_to_i64(worker, -1), 101);
+            }
+
+            // The third checkin finds the pool full and frees the instance
+            for &worker in &workers {
+                assert_eq!(moca_pool_checkin(pool, worker), MocaResult::Ok);
+            }
+            let s = stats(pool);
+            assert_eq!((s.instances, s.idle, s.checked_out), (2, 2, 0));
+            assert!(s.idle_heap_bytes > 0);
+
+            // Reused instances come back with an empty stack
+            let worker = moca_pool_checkout(pool);
+            assert_eq!(moca_get_top(worker), 0);
+            assert_eq!(stats(pool).misses, 1);
+            moca_pool_checkin(pool, worker);
+
+            moca_pool_free(pool);
+        }
+    }
+
+    #[test]
+    fn test_pool_rejects_foreign_vm() {
+        unsafe {
+            let vm = template();
+            let a = moca_pool_new(vm, 1);
+            let b = moca_pool_new(vm, 1);
+
+            assert_eq!(moca_pool_checkin(a, vm), MocaResult::ErrorInvalidArg);
+            let worker = moca_pool_checkout(a);
+            assert_eq!(moca_pool_checkin(b, worker), MocaResult::ErrorInvalidArg);
+            assert_eq!(moca_pool_checkin(a, worker), MocaResult::Ok);
+            assert_eq!(stats(b).checked_out, 0);
+
+            moca_pool_free(a);
+            moca_pool_free(b);
+            moca_vm_free(vm);
+        }
+    }
+
+    #[test]
+    fn test_pool_concurrent_threads() {
+        const THREADS: usize = 8;
+        const ROUNDS: i64 = 200;
+        unsafe {
+            let vm = template();
+            let pool = moca_pool_new(vm, 4) as usize;
+            moca_vm_free(vm);
+
+            let threads: Vec<_> = (0..THREADS)
+                .map(|_| {
+                    std::thread::spawn(move || {
+                        let pool = pool as *mut MocaPool;
+                        let mut sum = 0;
+                        for i in 0..ROUNDS {
+                            let worker = moca_pool_checkout(pool);
+                            moca_push_i64(worker, i);
+                            moca_push_i64(worker, 1);
+                            assert_eq!(moca_call(worker, c"add".as_ptr(), 2), MocaResult::Ok);
+                            sum += moca_to_i64(worker, -1);
+                            moca_pop(worker, 1);
+                            assert_eq!(moca_pool_checkin(pool, worker), MocaResult::Ok);
+                        }
+                        sum
+                    })
+                })
+                .collect();
+            for t in threads {
+                assert_eq!(t.join().unwrap(), (1..=ROUNDS).sum::<i64>());
+            }
+
+            let pool = pool as *mut MocaPool;
+            let s = stats(pool);
+            assert_eq!(s.checkouts, (THREADS as i64 * ROUNDS) as u64);
+            assert_eq!(s.checked_out, 0);
+            assert_eq!(s.idle, s.instances);
+            assert!(s.instances <= 4);
+            moca_pool_free(pool);
+        }
+    }
+}
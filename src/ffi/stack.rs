@@ -56,8 +56,10 @@ pub unsafe extern "C" fn moca_push_f64(vm: *mut MocaVm, value: f64) {
 
 /// Push a string value onto the stack.
 ///
-/// The string is copied into the VM's heap. The caller retains ownership
-/// of the original string.
+/// The bytes are copied into the VM's heap in one pass. The caller retains
+/// ownership of the original string. Invalid UTF-8 sequences are replaced
+/// with U+FFFD. If the string does not fit under the VM's memory limit, null
+/// is pushed instead and the error is set.
 ///
 /// # Arguments
 /// - `vm`: Valid VM instance
@@ -71,17 +73,21 @@ pub unsafe extern "C" fn moca_push_string(vm: *mut MocaVm, str: *const c_char, l
             return;
         }
 
-        // Convert to Rust string
         let slice = std::slice::from_raw_parts(str as *const u8, len);
-        let string = String::from_utf8_lossy(slice).into_owned();
 
         // Allocate on heap and push reference
-        let gc_ref = wrapper
-            .vm
-            .heap_mut()
-            .alloc_string(string)
-            .expect("heap allocation failed");
-        wrapper.ffi_stack.push(Value::Ref(gc_ref));
+        let heap = wrapper.vm.heap_mut();
+        let result = match std::str::from_utf8(slice) {
+            Ok(_) => heap.alloc_string_bytes(slice),
+            Err(_) => heap.alloc_string(String::from_utf8_lossy(slice).into_owned()),
+        };
+        match result {
+            Ok(gc_ref) => wrapper.ffi_stack.push(Value::Ref(gc_ref)),
+            Err(e) => {
+                wrapper.set_error(e);
+                wrapper.ffi_stack.push(Value::Null);
+            }
+        }
     }
 }
 
@@ -223,6 +229,8 @@ pub unsafe extern "C" fn moca_to_f64(vm: *mut MocaVm, index: i32) -> f64 {
 ///
 /// Returns NULL if the value is not a string or index is invalid.
 /// The returned pointer is valid until the next GC or stack modification.
+/// It is not null-terminated. Strings backed by a byte array are returned
+/// without copying (see `moca_string_view`).
 ///
 /// # Arguments
 /// - `vm`: Valid VM instance
@@ -237,6 +245,12 @@ pub unsafe extern "C" fn moca_to_string(
     if let Some(wrapper) = get_wrapper_mut(vm) {
         if let Some(idx) = resolve_index(wrapper.ffi_stack.len(), index) {
             if let Value::Ref(r) = wrapper.ffi_stack[idx] {
+                if let Some(bytes) = wrapper.vm.heap().string_bytes(r) {
+                    if !len.is_null() {
+                        *len = bytes.len();
+                    }
+                    return bytes.as_ptr() as *const c_char;
+                }
                 if let Some(obj) = wrapper.vm.heap().get(r) {
                     // String struct: [ptr, len], follow ptr to data array
                     let str_value = if let Some(data_ref) = obj.slots[0].as_ref() {
@@ -266,6 +280,44 @@ pub unsafe extern "C" fn moca_to_string(
     std::ptr::null()
 }
 
+/// Borrow the bytes of the string at the given index without copying.
+///
+/// The returned pointer points straight into the VM heap and is valid until
+/// the next GC point: any call into the VM, any push of a string, or loading
+/// bytecode. It is not null-terminated.
+///
+/// # Arguments
+/// - `vm`: Valid VM instance
+/// - `index`: Stack index
+/// - `len`: Output parameter for the length in bytes (can be NULL)
+///
+/// # Returns
+/// Pointer to the string bytes, or NULL if the value is not a string backed
+/// by a byte array or the index is invalid.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_string_view(
+    vm: *mut MocaVm,
+    index: i32,
+    len: *mut usize,
+) -> *const u8 {
+    if let Some(wrapper) = get_wrapper_mut(vm) {
+        if let Some(idx) = resolve_index(wrapper.ffi_stack.len(), index) {
+            if let Value::Ref(r) = wrapper.ffi_stack[idx] {
+                if let Some(bytes) = wrapper.vm.heap().string_bytes(r) {
+                    if !len.is_null() {
+                        *len = bytes.len();
+                    }
+                    return bytes.as_ptr();
+                }
+            }
+        }
+    }
+    if !len.is_null() {
+        *len = 0;
+    }
+    std::ptr::null()
+}
+
 // =============================================================================
 // Stack Manipulation
 // =============================================================================
@@ -379,4 +431,37 @@ mod tests {
             moca_vm_free(vm);
         }
     }
+
+    #[test]
+    fn test_string_view() {
+        unsafe {
+            let vm = moca_vm_new();
+
+            let payload = "{\"id\": 1}".repeat(500);
+            moca_push_string(vm, payload.as_ptr() as *const c_char, payload.len());
+            moca_push_i64(vm, 7);
+
+            let mut len = 0;
+            let view = moca_string_view(vm, -2, &mut len);
+            assert!(!view.is_null());
+            assert_eq!(std::slice::from_raw_parts(view, len), payload.as_bytes());
+
+            // moca_to_string returns the same heap bytes, not a copy
+            let s = moca_to_string(vm, -2, &mut len);
+            assert_eq!(s as *const u8, view);
+
+            assert!(moca_string_view(vm, -1, &mut len).is_null());
+            assert_eq!(len, 0);
+
+            // Invalid UTF-8 is replaced like before
+            moca_push_string(vm, b"a\xffb".as_ptr() as *const c_char, 3);
+            let view = moca_string_view(vm, -1, &mut len);
+            assert_eq!(
+                std::slice::from_raw_parts(view, len),
+                "a\u{fffd}b".as_bytes()
+            );
+
+            moca_vm_free(vm);
+        }
+    }
 }
@@ -71,12 +71,268 @@ pub struct MocaVm {
     _private: [u8; 0],
 }
 
+/// Opaque VM snapshot type.
+///
+/// Created by `moca_vm_snapshot()` and used to start new VMs from an
+/// already initialized state with `moca_vm_new_from_snapshot()`.
+#[repr(C)]
+pub struct MocaSnapshot {
+    _private: [u8; 0],
+}
+
+/// Opaque pool of VM instances.
+///
+/// Created by `moca_pool_new()` from an initialized VM; hands out instances
+/// with `moca_pool_checkout()` and takes them back with `moca_pool_checkin()`.
+#[repr(C)]
+pub struct MocaPool {
+    _private: [u8; 0],
+}
+
+/// Opaque handle to the pending result of an async host function.
+///
+/// Created by `moca_async_begin()` inside a host function and completed,
+/// from any thread, with `moca_async_resolve()` or `moca_async_cancel()`.
+#[repr(C)]
+pub struct MocaAsync {
+    _private: [u8; 0],
+}
+
+/// Pre-resolved handle to a moca function.
+///
+/// Obtained from `moca_function_ref()` and passed to `moca_call_ref()` to
+/// call a function without looking it up by name. A handle is only valid for
+/// the chunk that was loaded when it was resolved.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct MocaFunctionRef {
+    /// Function index in the loaded chunk (`UINT32_MAX` for main)
+    pub func_index: u32,
+    /// Number of arguments the handle was resolved against
+    pub arity: u32,
+}
+
+impl MocaFunctionRef {
+    /// Marker index for the chunk's main function.
+    pub const MAIN_INDEX: u32 = u32::MAX;
+
+    /// Function index as used by the VM (`usize::MAX` for main).
+    pub fn vm_index(self) -> usize {
+        if self.func_index == Self::MAIN_INDEX {
+            usize::MAX
+        } else {
+            self.func_index as usize
+        }
+    }
+}
+
+/// Type tag of a `MocaValue`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum MocaValueTag {
+    Null = 0,
+    Bool = 1,
+    I64 = 2,
+    F64 = 3,
+    /// Heap reference; only valid until the next call into the VM
+    Ref = 4,
+}
+
+/// Payload of a `MocaValue`, selected by its tag.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub union MocaValueData {
+    pub b: bool,
+    pub i: i64,
+    pub f: f64,
+    /// Heap reference index (for `MOCA_VALUE_TAG_REF`)
+    pub r: u64,
+}
+
+/// A moca value passed by value across the C API (used by batched calls).
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct MocaValue {
+    pub tag: MocaValueTag,
+    pub data: MocaValueData,
+}
+
+impl MocaValue {
+    pub(crate) fn from_value(value: crate::vm::Value) -> Self {
+        use crate::vm::Value;
+        let (tag, data) = match value {
+            Value::Null => (MocaValueTag::Null, MocaValueData { i: 0 }),
+            Value::Bool(b) => (MocaValueTag::Bool, MocaValueData { b }),
+            Value::I64(i) => (MocaValueTag::I64, MocaValueData { i }),
+            Value::F64(f) => (MocaValueTag::F64, MocaValueData { f }),
+            Value::Ref(r) => (MocaValueTag::Ref, MocaValueData { r: r.index as u64 }),
+        };
+        Self { tag, data }
+    }
+
+    pub(crate) fn to_value(self) -> crate::vm::Value {
+        use crate::vm::{GcRef, Value};
+        // SAFETY: the tag selects which union field was written
+        unsafe {
+            match self.tag {
+                MocaValueTag::Null => Value::Null,
+                MocaValueTag::Bool => Value::Bool(self.data.b),
+                MocaValueTag::I64 => Value::I64(self.data.i),
+                MocaValueTag::F64 => Value::F64(self.data.f),
+                MocaValueTag::Ref => Value::Ref(GcRef {
+                    index: self.data.r as usize,
+                }),
+            }
+        }
+    }
+}
+
+/// Heap usage and GC counters of a VM, filled by `moca_get_heap_stats()`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct MocaHeapStats {
+    /// Bytes allocated, including garbage not yet collected
+    pub bytes_allocated: usize,
+    /// Objects on the heap, including garbage not yet collected
+    pub object_count: usize,
+    /// Allocated bytes that trigger the next collection
+    pub gc_threshold: usize,
+    /// Hard memory limit (0 = none)
+    pub memory_limit: usize,
+    /// Soft memory limit (0 = none)
+    pub soft_memory_limit: usize,
+    /// Major GC cycles
+    pub gc_cycles: u64,
+    /// Minor (nursery-only) GC cycles
+    pub gc_minor_cycles: u64,
+    /// Total GC pause time (microseconds)
+    pub gc_pause_us: u64,
+    /// Longest GC pause (microseconds)
+    pub gc_max_pause_us: u64,
+}
+
+/// Runtime counters of a VM, filled by `moca_get_metrics()`.
+///
+/// The VM keeps these counters as it runs; taking a snapshot does not walk
+/// the heap.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct MocaMetrics {
+    /// Major GC cycles
+    pub gc_cycles: u64,
+    /// Minor (nursery-only) GC cycles
+    pub gc_minor_cycles: u64,
+    /// GC pauses; with incremental GC every step is one
+    pub gc_pauses: u64,
+    /// Total GC pause time (microseconds)
+    pub gc_pause_us: u64,
+    /// Longest GC pause (microseconds)
+    pub gc_max_pause_us: u64,
+    /// Median GC pause, rounded up to a histogram bucket (microseconds)
+    pub gc_pause_p50_us: u64,
+    /// 99th percentile GC pause, rounded up to a histogram bucket (microseconds)
+    pub gc_pause_p99_us: u64,
+    /// Size of the heap's memory
+    pub heap_bytes: usize,
+    /// Bytes of objects on the heap, including garbage not yet collected
+    pub heap_live_bytes: usize,
+    /// Bytes allocated since the VM was created
+    pub allocated_bytes: u64,
+    /// Objects allocated since the VM was created
+    pub allocated_objects: u64,
+    /// Functions and loops compiled to native code
+    pub jit_compiles: u64,
+    /// JIT compilations that failed
+    pub jit_failures: u64,
+    /// Failed type guards on entry to speculative loop code
+    pub jit_deopts: u64,
+    /// Machine code bytes compiled
+    pub jit_code_bytes: u64,
+    /// Values sent over the VM's channels
+    pub channel_sends: u64,
+    /// Values received over the VM's channels
+    pub channel_receives: u64,
+}
+
+/// Kind of a `MocaEvent`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum MocaEventKind {
+    /// A GC pause starts (`minor`)
+    GcStart = 0,
+    /// A GC pause ended (`minor`, `pause_ns`)
+    GcEnd = 1,
+    /// A function or loop was compiled (`name`, `is_loop`, `code_size`)
+    JitCompile = 2,
+    /// A function or loop moved to another tier (`name`, `is_loop`, `tier`)
+    TierChange = 3,
+    /// The heap's memory grew (`heap_bytes`)
+    HeapGrow = 4,
+}
+
+/// A runtime event, passed to the `MocaEventFn` installed with
+/// `moca_set_event_callback()`. Fields not used by `kind` are zero.
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct MocaEvent {
+    pub kind: MocaEventKind,
+    /// Whether a GC pause is a minor collection
+    pub minor: bool,
+    /// Length of the pause (nanoseconds)
+    pub pause_ns: u64,
+    /// NUL-terminated function name, valid during the callback (or NULL)
+    pub name: *const c_char,
+    /// Whether the code is a loop in `name` rather than the whole function
+    pub is_loop: bool,
+    /// Machine code bytes
+    pub code_size: usize,
+    /// Tier entered: 0 = interpreter, 1 = baseline JIT, 2 = JIT specialized
+    /// on type feedback
+    pub tier: u32,
+    /// Size of the heap's memory after growing
+    pub heap_bytes: usize,
+}
+
+/// Event callback function type.
+///
+/// Called on the thread running the VM, in the middle of execution: it must
+/// not call back into the VM.
+pub type MocaEventFn =
+    Option<unsafe extern "C" fn(event: *const MocaEvent, userdata: *mut std::ffi::c_void)>;
+
+/// Aggregate statistics of a `MocaPool`.
+///
+/// GC counters cover instances that have been checked in at least once;
+/// work done by an instance is added when it is checked in.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct MocaPoolStats {
+    /// Instances created by the pool that are still alive
+    pub instances: usize,
+    /// Instances waiting in the pool
+    pub idle: usize,
+    /// Instances currently checked out
+    pub checked_out: usize,
+    /// Total number of checkouts
+    pub checkouts: u64,
+    /// Checkouts that found the pool empty and created a new instance
+    pub misses: u64,
+    /// Major GC cycles run by all instances
+    pub gc_cycles: u64,
+    /// Minor (nursery-only) GC cycles run by all instances
+    pub gc_minor_cycles: u64,
+    /// Total GC pause time of all instances (microseconds)
+    pub gc_pause_us: u64,
+    /// Heap bytes allocated by idle instances
+    pub idle_heap_bytes: usize,
+}
+
 /// Internal VM wrapper that holds the actual Rust VM and FFI state.
 pub(crate) struct VmWrapper {
     /// The actual moca VM
     pub vm: crate::vm::VM,
     /// Loaded chunk (if any)
-    pub chunk: Option<crate::vm::Chunk>,
+    pub chunk: Option<std::sync::Arc<crate::vm::Chunk>>,
     /// Last error message (as CString for FFI compatibility)
     pub last_error: Option<std::ffi::CString>,
     /// Error callback
@@ -87,11 +343,39 @@ pub(crate) struct VmWrapper {
     pub host_functions: std::collections::HashMap<String, HostFunction>,
     /// FFI stack for passing values between host and VM
     pub ffi_stack: Vec<crate::vm::Value>,
-    /// Global variables accessible via FFI
-    pub globals: std::collections::HashMap<String, crate::vm::Value>,
+    /// Reused argument/result buffer for `moca_call_batch`
+    pub batch_buffer: Vec<crate::vm::Value>,
+    /// Set while the VM is checked out of a `MocaPool`
+    pub pool_lease: Option<PoolLease>,
+}
+
+/// Pool membership of a checked-out VM, with its GC counters at checkout so
+/// checkin can add what ran in between.
+#[derive(Debug, Clone, Copy)]
+pub(crate) struct PoolLease {
+    /// Address of the pool the VM belongs to
+    pub pool: usize,
+    pub gc_cycles: usize,
+    pub gc_minor_cycles: usize,
+    pub gc_pause_us: u64,
+}
+
+/// Internal snapshot wrapper: VM state plus the FFI state needed to
+/// reproduce a `VmWrapper`.
+pub(crate) struct SnapshotWrapper {
+    pub vm: crate::vm::VmSnapshot,
+    pub chunk: std::sync::Arc<crate::vm::Chunk>,
+    pub host_functions: std::collections::HashMap<String, HostFunction>,
+}
+
+/// Internal state behind a `MocaAsync` handle: the channel moca code
+/// receives the result from.
+pub(crate) struct AsyncWrapper {
+    pub channel: std::sync::Arc<crate::vm::threads::Channel<crate::vm::Value>>,
 }
 
 /// A registered host function.
+#[derive(Clone, Copy)]
 pub(crate) struct HostFunction {
     pub func: MocaCFunc,
     pub arity: usize,
@@ -107,7 +391,8 @@ impl VmWrapper {
             error_userdata: std::ptr::null_mut(),
             host_functions: std::collections::HashMap::new(),
             ffi_stack: Vec::with_capacity(64),
-            globals: std::collections::HashMap::new(),
+            batch_buffer: Vec::new(),
+            pool_lease: None,
         }
     }
 
@@ -132,6 +417,28 @@ impl VmWrapper {
     }
 }
 
+impl SnapshotWrapper {
+    /// Capture a VM with loaded bytecode; `None` if nothing is loaded.
+    pub fn capture(wrapper: &VmWrapper) -> Option<Self> {
+        let chunk = wrapper.chunk.as_ref()?;
+        Some(Self {
+            vm: wrapper.vm.snapshot(),
+            chunk: chunk.clone(),
+            host_functions: wrapper.host_functions.clone(),
+        })
+    }
+
+    /// Start a new VM from the snapshot.
+    pub fn instantiate(&self) -> VmWrapper {
+        let mut wrapper = VmWrapper::new();
+        wrapper.vm.share_chunk(self.chunk.clone());
+        wrapper.vm.restore(&self.chunk, &self.vm);
+        wrapper.chunk = Some(self.chunk.clone());
+        wrapper.host_functions = self.host_functions.clone();
+        wrapper
+    }
+}
+
 impl Default for VmWrapper {
     fn default() -> Self {
         Self::new()
@@ -171,3 +478,80 @@ mod tests {
         assert!(wrapper.last_error.is_none());
     }
 }
+
+/// Output buffering mode, for `moca_set_output_buffering()`.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum MocaBufferMode {
+    /// Every write goes out right away
+    Unbuffered = 0,
+    /// Flushed at each newline
+    Line = 1,
+    /// Flushed when the buffer fills up and when the VM returns to the host
+    Block = 2,
+}
+
+/// A host-owned ring buffer that receives a VM's stdout, installed with
+/// `moca_set_output_ring()`.
+///
+/// `head` and `tail` count bytes since the ring was installed; the byte at
+/// position `p` is stored at `data[p % capacity]`. The VM advances `head`
+/// and the host advances `tail` as it consumes bytes, both with atomic
+/// release stores, so the host may read from another thread. Output that
+/// does not fit is discarded and counted in `dropped`.
+#[repr(C)]
+#[derive(Debug)]
+pub struct MocaOutputRing {
+    /// Storage of `capacity` bytes
+    pub data: *mut u8,
+    pub capacity: usize,
+    /// Bytes written by the VM
+    pub head: usize,
+    /// Bytes consumed by the host
+    pub tail: usize,
+    /// Bytes discarded because the ring was full
+    pub dropped: usize,
+}
+
+/// Writes into a `MocaOutputRing`. Never blocks and never fails.
+pub(crate) struct RingWriter {
+    pub(crate) ring: *mut MocaOutputRing,
+}
+
+// SAFETY: the ring is host memory that `moca_set_output_ring` requires to
+// stay valid, and the VM only writes `head` and `dropped` atomically, so the
+// writer may move with its VM to another thread.
+unsafe impl Send for RingWriter {}
+
+impl std::io::Write for RingWriter {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        use std::sync::atomic::{AtomicUsize, Ordering};
+        // SAFETY: `moca_set_output_ring` requires the ring to stay valid and
+        // leaves `head` and `dropped` to the VM; `tail` is only read
+        unsafe {
+            let ring = self.ring;
+            let capacity = (*ring).capacity;
+            let head = AtomicUsize::from_ptr(&raw mut (*ring).head);
+            let tail = AtomicUsize::from_ptr(&raw mut (*ring).tail);
+            let start = head.load(Ordering::Relaxed);
+            let free = capacity - start.wrapping_sub(tail.load(Ordering::Acquire));
+            let n = buf.len().min(free);
+            // The free space may wrap around the end of `data`
+            let offset = start % capacity;
+            let first = n.min(capacity - offset);
+            let data = (*ring).data;
+            std::ptr::copy_nonoverlapping(buf.as_ptr(), data.add(offset), first);
+            std::ptr::copy_nonoverlapping(buf.as_ptr().add(first), data, n - first);
+            head.store(start.wrapping_add(n), Ordering::Release);
+            if n < buf.len() {
+                AtomicUsize::from_ptr(&raw mut (*ring).dropped)
+                    .fetch_add(buf.len() - n, Ordering::Relaxed);
+            }
+        }
+        Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        Ok(())
+    }
+}
@@ -4,7 +4,15 @@
 #![allow(clippy::needless_return)]
 #![allow(clippy::missing_safety_doc)]
 
-use super::types::{MocaVm, VmWrapper};
+use super::types::{
+    MocaBufferMode, MocaEvent, MocaEventFn, MocaEventKind, MocaHeapStats, MocaMetrics,
+    MocaOutputRing, MocaResult, MocaSnapshot, MocaVm, RingWriter, SnapshotWrapper, VmWrapper,
+};
+use crate::vm::metrics::{EventHandler, VmEvent};
+use crate::vm::output::BufferMode;
+use crate::vm::profiler::{self, SamplingProfiler};
+use std::ffi::{CStr, CString, c_char};
+use std::time::Duration;
 
 /// Create a new VM instance.
 ///
@@ -44,20 +52,467 @@ pub unsafe extern "C" fn moca_vm_free(vm: *mut MocaVm) {
     let _ = Box::from_raw(vm as *mut VmWrapper);
 }
 
-/// Set the memory limit for the VM.
+/// Capture the state of an initialized VM.
 ///
-/// This must be called before loading bytecode.
+/// The snapshot holds a copy of the loaded bytecode, the heap, globals
+/// (including those set with `moca_set_global`) and registered host
+/// functions. The FFI stack, the error callback and JIT code are not
+/// captured. The source VM is not modified and can keep running.
+///
+/// Returns NULL if `vm` is NULL or has no bytecode loaded. The snapshot must
+/// be freed with `moca_snapshot_free()`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_vm_snapshot(vm: *const MocaVm) -> *mut MocaSnapshot {
+    match get_wrapper(vm).and_then(SnapshotWrapper::capture) {
+        Some(snapshot) => Box::into_raw(Box::new(snapshot)) as *mut MocaSnapshot,
+        None => std::ptr::null_mut(),
+    }
+}
+
+/// Create a new VM instance starting from a snapshot.
+///
+/// The heap is copied from the snapshot in a single pass, so this is much
+/// cheaper than loading the bytecode and re-running initialization code.
+/// The snapshot stays valid and can start any number of VMs.
+///
+/// Returns NULL if `snapshot` is NULL. The returned VM must be freed with
+/// `moca_vm_free()`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_vm_new_from_snapshot(snapshot: *const MocaSnapshot) -> *mut MocaVm {
+    if snapshot.is_null() {
+        return std::ptr::null_mut();
+    }
+    let snapshot = &*(snapshot as *const SnapshotWrapper);
+    Box::into_raw(Box::new(snapshot.instantiate())) as *mut MocaVm
+}
+
+/// Free a snapshot.
+///
+/// VMs created from the snapshot are independent and stay valid.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_snapshot_free(snapshot: *mut MocaSnapshot) {
+    if snapshot.is_null() {
+        return;
+    }
+    let _ = Box::from_raw(snapshot as *mut SnapshotWrapper);
+}
+
+/// Create a new VM instance with a copy of an initialized VM's state.
+///
+/// Equivalent to `moca_vm_snapshot()` followed by
+/// `moca_vm_new_from_snapshot()` and `moca_snapshot_free()`. Returns NULL if
+/// `vm` is NULL or has no bytecode loaded.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_vm_clone(vm: *const MocaVm) -> *mut MocaVm {
+    let snapshot = moca_vm_snapshot(vm);
+    if snapshot.is_null() {
+        return std::ptr::null_mut();
+    }
+    let clone = moca_vm_new_from_snapshot(snapshot);
+    moca_snapshot_free(snapshot);
+    clone
+}
+
+/// Set the hard memory limit for the VM.
+///
+/// An allocation that would take the heap past the limit fails with a
+/// runtime error. Unless a soft limit is set, collections start once the
+/// heap reaches 3/4 of the limit, so garbage is freed before allocations
+/// fail. VMs created from a snapshot or pool inherit the limits of the VM
+/// the snapshot was taken from.
 ///
 /// # Arguments
 /// - `vm`: Valid VM instance
-/// - `bytes`: Maximum memory in bytes (0 = no limit)
+/// - `bytes`: Maximum heap size in bytes (0 = no limit)
 #[unsafe(no_mangle)]
-pub unsafe extern "C" fn moca_set_memory_limit(vm: *mut MocaVm, _bytes: usize) {
-    if vm.is_null() {
+pub unsafe extern "C" fn moca_set_memory_limit(vm: *mut MocaVm, bytes: usize) {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return;
+    };
+    wrapper
+        .vm
+        .heap_mut()
+        .set_heap_limit((bytes > 0).then_some(bytes));
+}
+
+/// Set the soft memory limit for the VM.
+///
+/// Once the heap reaches the soft limit a collection starts at the next
+/// safepoint, even if the regular GC threshold is higher. The soft limit is
+/// capped at the hard limit.
+///
+/// # Arguments
+/// - `vm`: Valid VM instance
+/// - `bytes`: Soft limit in bytes (0 = 3/4 of the hard limit)
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_set_soft_memory_limit(vm: *mut MocaVm, bytes: usize) {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return;
+    };
+    wrapper
+        .vm
+        .heap_mut()
+        .set_soft_limit((bytes > 0).then_some(bytes));
+}
+
+/// Read heap usage and GC counters.
+///
+/// Counting objects walks the heap, so this takes time proportional to the
+/// heap size.
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if an argument is NULL
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_get_heap_stats(
+    vm: *const MocaVm,
+    out: *mut MocaHeapStats,
+) -> MocaResult {
+    let Some(wrapper) = get_wrapper(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+    if out.is_null() {
+        return MocaResult::ErrorInvalidArg;
+    }
+
+    let heap = wrapper.vm.heap();
+    let gc = wrapper.vm.gc_stats();
+    *out = MocaHeapStats {
+        bytes_allocated: heap.bytes_allocated(),
+        object_count: heap.object_count(),
+        gc_threshold: heap.gc_threshold(),
+        memory_limit: heap.heap_limit().unwrap_or(0),
+        soft_memory_limit: heap.soft_limit().unwrap_or(0),
+        gc_cycles: gc.cycles as u64,
+        gc_minor_cycles: gc.minor_cycles as u64,
+        gc_pause_us: gc.total_pause_us,
+        gc_max_pause_us: gc.max_pause_us,
+    };
+    MocaResult::Ok
+}
+
+/// Read the VM's runtime counters.
+///
+/// The counters are kept as the VM runs, so this is cheap enough to call on
+/// every scrape of a metrics endpoint.
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if an argument is NULL
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_get_metrics(vm: *const MocaVm, out: *mut MocaMetrics) -> MocaResult {
+    let Some(wrapper) = get_wrapper(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+    if out.is_null() {
+        return MocaResult::ErrorInvalidArg;
+    }
+
+    let m = wrapper.vm.metrics();
+    *out = MocaMetrics {
+        gc_cycles: m.gc_cycles,
+        gc_minor_cycles: m.gc_minor_cycles,
+        gc_pauses: m.gc_pauses,
+        gc_pause_us: m.gc_pause_us,
+        gc_max_pause_us: m.gc_max_pause_us,
+        gc_pause_p50_us: m.gc_pause_p50_us,
+        gc_pause_p99_us: m.gc_pause_p99_us,
+        heap_bytes: m.heap_bytes,
+        heap_live_bytes: m.heap_live_bytes,
+        allocated_bytes: m.allocated_bytes,
+        allocated_objects: m.allocated_objects,
+        jit_compiles: m.jit_compiles,
+        jit_failures: m.jit_failures,
+        jit_deopts: m.jit_deopts,
+        jit_code_bytes: m.jit_code_bytes,
+        channel_sends: m.channel_sends,
+        channel_receives: m.channel_receives,
+    };
+    MocaResult::Ok
+}
+
+/// C event callback and its userdata, moved with the VM between threads.
+struct EventCallback {
+    callback: unsafe extern "C" fn(*const MocaEvent, *mut std::ffi::c_void),
+    userdata: *mut std::ffi::c_void,
+}
+
+// SAFETY: the callback only runs on the thread currently running the VM, and
+// `moca_set_event_callback` requires `userdata` to be safe to use from any
+// thread the host moves the VM to.
+unsafe impl Send for EventCallback {}
+
+impl EventCallback {
+    fn call(&self, event: &VmEvent) {
+        let mut out = MocaEvent {
+            kind: MocaEventKind::GcStart,
+            minor: false,
+            pause_ns: 0,
+            name: std::ptr::null(),
+            is_loop: false,
+            code_size: 0,
+            tier: 0,
+            heap_bytes: 0,
+        };
+        let mut name = None;
+        match *event {
+            VmEvent::GcStart { minor } => out.minor = minor,
+            VmEvent::GcEnd { minor, pause_ns } => {
+                out.kind = MocaEventKind::GcEnd;
+                out.minor = minor;
+                out.pause_ns = pause_ns;
+            }
+            VmEvent::JitCompile {
+                name: func,
+                is_loop,
+                code_size,
+            } => {
+                out.kind = MocaEventKind::JitCompile;
+                name = CString::new(func).ok();
+                out.is_loop = is_loop;
+                out.code_size = code_size;
+            }
+            VmEvent::TierChange {
+                name: func,
+                is_loop,
+                tier,
+            } => {
+                out.kind = MocaEventKind::TierChange;
+                name = CString::new(func).ok();
+                out.is_loop = is_loop;
+                out.tier = tier as u32;
+            }
+            VmEvent::HeapGrow { heap_bytes } => {
+                out.kind = MocaEventKind::HeapGrow;
+                out.heap_bytes = heap_bytes;
+            }
+        }
+        if let Some(name) = &name {
+            out.name = name.as_ptr();
+        }
+        unsafe { (self.callback)(&out, self.userdata) };
+    }
+}
+
+/// Set the callback that receives runtime events.
+///
+/// The VM reports GC pauses as they start and end, JIT compilations with
+/// the function name and code size, tier changes, and heap growth. The
+/// callback runs on the thread running the VM, in the middle of execution,
+/// and must not call back into the VM. Threads spawned by moca code do not
+/// report events.
+///
+/// The callback and `userdata` move with the VM. If the host hands the VM
+/// to another thread, the callback runs on that thread, so `userdata` must
+/// be safe to use there.
+///
+/// # Arguments
+/// - `vm`: Valid VM instance
+/// - `callback`: Event callback (or NULL to disable)
+/// - `userdata`: User data passed to the callback
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_set_event_callback(
+    vm: *mut MocaVm,
+    callback: MocaEventFn,
+    userdata: *mut std::ffi::c_void,
+) {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return;
+    };
+    let handler = callback.map(|callback| {
+        let callback = EventCallback { callback, userdata };
+        Box::new(move |event: &VmEvent| callback.call(event)) as EventHandler
+    });
+    wrapper.vm.set_event_handler(handler);
+}
+
+/// Enable or disable incremental garbage collection.
+///
+/// When enabled, collections mark and sweep in small steps between
+/// instructions instead of pausing the VM for a whole collection. Disabled by
+/// default.
+///
+/// # Arguments
+/// - `vm`: Valid VM instance
+/// - `enabled`: Whether to collect incrementally
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_set_incremental_gc(vm: *mut MocaVm, enabled: bool) {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return;
+    };
+    wrapper.vm.set_incremental_gc(enabled);
+}
+
+/// Set how the VM buffers stdout.
+///
+/// A new VM is line buffered when stdout is a terminal and block buffered
+/// otherwise. Whatever the mode, buffered output is flushed before every
+/// call into the VM returns. `MOCA_BUFFER_MODE_UNBUFFERED` also sends each
+/// write to a file or socket right away instead of coalescing consecutive
+/// writes into one `writev`.
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if `vm` is NULL
+/// - `MOCA_ERROR_RUNTIME` if flushing the buffered output failed
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_set_output_buffering(
+    vm: *mut MocaVm,
+    mode: MocaBufferMode,
+) -> MocaResult {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+    let mode = match mode {
+        MocaBufferMode::Unbuffered => BufferMode::Unbuffered,
+        MocaBufferMode::Line => BufferMode::Line,
+        MocaBufferMode::Block => BufferMode::Block,
+    };
+    match wrapper.vm.set_output_buffering(mode) {
+        Ok(()) => MocaResult::Ok,
+        Err(_) => MocaResult::ErrorRuntime,
+    }
+}
+
+/// Write out everything the VM has buffered.
+///
+/// Only needed for output written by a host function that is still running;
+/// the VM flushes before each call into it returns.
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if `vm` is NULL
+/// - `MOCA_ERROR_RUNTIME` if a write failed
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_flush_output(vm: *mut MocaVm) -> MocaResult {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+    match wrapper.vm.flush_output() {
+        Ok(()) => MocaResult::Ok,
+        Err(_) => MocaResult::ErrorRuntime,
+    }
+}
+
+/// Start sampling the VM's call stacks.
+///
+/// A timer thread requests a sample every `interval_us` microseconds and
+/// the VM takes it at its next safepoint, recording the function of every
+/// frame. Samples from an earlier run of the profiler are dropped.
+///
+/// # Arguments
+/// - `vm`: Valid VM instance
+/// - `interval_us`: Sampling interval (0 = 1000us)
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if `vm` is NULL
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_profiler_start(vm: *mut MocaVm, interval_us: u32) -> MocaResult {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+    let interval = match interval_us {
+        0 => SamplingProfiler::DEFAULT_INTERVAL,
+        us => Duration::from_micros(us as u64),
+    };
+    wrapper.vm.start_sampling(interval);
+    MocaResult::Ok
+}
+
+/// Stop sampling. The samples taken stay available to
+/// `moca_profiler_dump()`.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_profiler_stop(vm: *mut MocaVm) {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
         return;
+    };
+    wrapper.vm.stop_sampling();
+}
+
+/// Write the sampled call stacks to `path` in folded-stack format.
+///
+/// Each line is `outer;inner;leaf count`, as read by flamegraph.pl and
+/// inferno. The profiler may still be running.
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if an argument is NULL or `path` is not UTF-8
+/// - `MOCA_ERROR_RUNTIME` if the file could not be written
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_profiler_dump(vm: *mut MocaVm, path: *const c_char) -> MocaResult {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+    if path.is_null() {
+        return MocaResult::ErrorInvalidArg;
+    }
+    let Ok(path) = CStr::from_ptr(path).to_str() else {
+        return MocaResult::ErrorInvalidArg;
+    };
+    let folded = match &wrapper.chunk {
+        Some(chunk) => wrapper.vm.folded_stacks(chunk),
+        None => String::new(),
+    };
+    match std::fs::write(path, folded) {
+        Ok(()) => MocaResult::Ok,
+        Err(e) => {
+            wrapper.set_error(format!("failed to write profile to {}: {}", path, e));
+            MocaResult::ErrorRuntime
+        }
+    }
+}
+
+/// Start writing `/tmp/perf-<pid>.map`, so `perf` can name JIT code.
+///
+/// Applies to the whole process: code compiled from then on by any VM gets
+/// a `start size name` line.
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_RUNTIME` if the map could not be opened
+#[unsafe(no_mangle)]
+pub extern "C" fn moca_enable_perf_map() -> MocaResult {
+    match profiler::enable_perf_map() {
+        Ok(()) => MocaResult::Ok,
+        Err(_) => MocaResult::ErrorRuntime,
     }
-    // TODO: Implement memory limiting in the VM
-    // For now, this is a no-op placeholder
+}
+
+/// Send the VM's stdout into a host-owned ring buffer instead of the
+/// process stdout.
+///
+/// Output buffered so far is flushed to the old destination first. The VM
+/// writes at `head` and never blocks on a full ring: bytes that do not fit
+/// are counted in `dropped`. The ring and its `data` must stay valid until
+/// another ring is installed or the VM is freed. Threads spawned by moca
+/// code still write to the process stdout.
+///
+/// # Arguments
+/// - `vm`: Valid VM instance
+/// - `ring`: Ring with `data` and `capacity` set, or NULL to go back to stdout
+///
+/// # Returns
+/// - `MOCA_OK` on success
+/// - `MOCA_ERROR_INVALID_ARG` if `vm` is NULL, or `ring` has no storage
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn moca_set_output_ring(
+    vm: *mut MocaVm,
+    ring: *mut MocaOutputRing,
+) -> MocaResult {
+    let Some(wrapper) = get_wrapper_mut(vm) else {
+        return MocaResult::ErrorInvalidArg;
+    };
+    let output: Box<dyn std::io::Write + Send> = if ring.is_null() {
+        Box::new(std::io::stdout())
+    } else if (*ring).data.is_null() || (*ring).capacity == 0 {
+        return MocaResult::ErrorInvalidArg;
+    } else {
+        Box::new(RingWriter { ring })
+    };
+    // A failed flush of the old destination doesn't stop the switch
+    let _ = wrapper.vm.set_output(output);
+    MocaResult::Ok
 }
 
 /// Set the error callback function.
@@ -137,6 +592,101 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_memory_limits_and_heap_stats() {
+        use crate::ffi::stack::moca_push_string;
+
+        let vm = moca_vm_new();
+        unsafe {
+            let mut stats = MocaHeapStats::default();
+            assert_eq!(
+                moca_get_heap_stats(std::ptr::null(), &mut stats),
+                MocaResult::ErrorInvalidArg
+            );
+            assert_eq!(
+                moca_get_heap_stats(vm, std::ptr::null_mut()),
+                MocaResult::ErrorInvalidArg
+            );
+
+            moca_set_memory_limit(vm, 4096);
+            moca_get_heap_stats(vm, &mut stats);
+            assert_eq!(stats.memory_limit, 4096);
+            assert_eq!(stats.soft_memory_limit, 3072);
+            assert_eq!(stats.gc_threshold, 3072);
+
+            moca_set_soft_memory_limit(vm, 1024);
+            let objects = stats.object_count;
+            moca_push_string(vm, c"tenant".as_ptr(), 6);
+            moca_get_heap_stats(vm, &mut stats);
+            assert_eq!(stats.soft_memory_limit, 1024);
+            assert!(stats.object_count > objects);
+            assert!(stats.bytes_allocated > 0);
+
+            // Past the hard limit pushes fail instead of growing the heap
+            let big = vec![b'x'; 8192];
+            moca_push_string(vm, big.as_ptr() as *const std::ffi::c_char, big.len());
+            assert!(get_wrapper(vm).unwrap().last_error.is_some());
+
+            // 0 removes the limits
+            moca_set_memory_limit(vm, 0);
+            moca_set_soft_memory_limit(vm, 0);
+            moca_get_heap_stats(vm, &mut stats);
+            assert_eq!((stats.memory_limit, stats.soft_memory_limit), (0, 0));
+            moca_vm_free(vm);
+        }
+    }
+
+    #[test]
+    fn test_metrics_and_event_callback() {
+        use crate::ffi::stack::moca_push_string;
+        use std::sync::atomic::{AtomicUsize, Ordering};
+
+        unsafe extern "C" fn count(event: *const MocaEvent, userdata: *mut std::ffi::c_void) {
+            unsafe {
+                if (*event).kind == MocaEventKind::GcEnd {
+                    (*(userdata as *const AtomicUsize)).fetch_add(1, Ordering::SeqCst);
+                }
+            }
+        }
+
+        let vm = moca_vm_new();
+        let ends = AtomicUsize::new(0);
+        unsafe {
+            let mut metrics = std::mem::zeroed::<MocaMetrics>();
+            assert_eq!(
+                moca_get_metrics(std::ptr::null(), &mut metrics),
+                MocaResult::ErrorInvalidArg
+            );
+            assert_eq!(
+                moca_get_metrics(vm, std::ptr::null_mut()),
+                MocaResult::ErrorInvalidArg
+            );
+
+            moca_set_event_callback(vm, Some(count), &ends as *const _ as *mut _);
+            moca_push_string(vm, c"tenant".as_ptr(), 6);
+            assert_eq!(moca_get_metrics(vm, &mut metrics), MocaResult::Ok);
+            assert!(metrics.allocated_objects > 0);
+            assert!(metrics.allocated_bytes > 0);
+            assert!(metrics.heap_bytes >= metrics.heap_live_bytes);
+
+            let wrapper = get_wrapper_mut(vm).unwrap();
+            wrapper.vm.emit(VmEvent::GcEnd {
+                minor: true,
+                pause_ns: 5,
+            });
+            assert_eq!(ends.load(Ordering::SeqCst), 1);
+
+            // NULL removes the callback
+            moca_set_event_callback(vm, None, std::ptr::null_mut());
+            wrapper.vm.emit(VmEvent::GcEnd {
+                minor: true,
+                pause_ns: 5,
+            });
+            assert_eq!(ends.load(Ordering::SeqCst), 1);
+            moca_vm_free(vm);
+        }
+    }
+
     #[test]
     fn test_has_chunk() {
         let vm = moca_vm_new();
@@ -146,6 +696,73 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_snapshot_and_clone() {
+        use crate::ffi::call::{moca_call, moca_get_global, moca_set_global};
+        use crate::ffi::load::moca_load_chunk;
+        use crate::ffi::stack::{moca_pop, moca_push_string, moca_string_view};
+        use crate::vm::{Chunk, Function, Op, bytecode};
+        use std::ffi::CString;
+
+        // main returns a string constant, which lands in the heap and the
+        // string cache when it runs
+        let chunk = Chunk {
+            functions: vec![],
+            main: Function {
+                name: "main".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: vec![Op::StringConst(0), Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec!["warm".to_string()].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        };
+        let data = bytecode::serialize(&chunk);
+        let main = CString::new("main").unwrap();
+        let table = CString::new("table").unwrap();
+
+        unsafe {
+            assert!(moca_vm_snapshot(std::ptr::null()).is_null());
+            let vm = moca_vm_new();
+            assert!(moca_vm_snapshot(vm).is_null());
+
+            moca_load_chunk(vm, data.as_ptr(), data.len());
+            assert_eq!(moca_call(vm, main.as_ptr(), 0), MocaResult::Ok);
+            assert_eq!(moca_set_global(vm, table.as_ptr()), MocaResult::Ok);
+
+            let snapshot = moca_vm_snapshot(vm);
+            assert!(!snapshot.is_null());
+            let a = moca_vm_new_from_snapshot(snapshot);
+            let b = moca_vm_clone(vm);
+            moca_snapshot_free(snapshot);
+
+            for clone in [a, b] {
+                assert!(moca_has_chunk(clone));
+                assert_eq!(moca_get_global(clone, table.as_ptr()), MocaResult::Ok);
+                let mut len = 0;
+                let view = moca_string_view(clone, -1, &mut len);
+                assert_eq!(std::slice::from_raw_parts(view, len), b"warm");
+                moca_pop(clone, 1);
+
+                // Clones keep running and allocating on their own heap
+                moca_push_string(clone, c"x".as_ptr(), 1);
+                assert_eq!(moca_call(clone, main.as_ptr(), 0), MocaResult::Ok);
+            }
+            assert_eq!(
+                get_wrapper(a).unwrap().vm.heap().object_count(),
+                get_wrapper(vm).unwrap().vm.heap().object_count() + 2
+            );
+
+            moca_vm_free(a);
+            moca_vm_free(b);
+            moca_vm_free(vm);
+        }
+    }
+
     #[test]
     fn test_error_callback() {
         use std::sync::atomic::{AtomicBool, Ordering};
@@ -171,4 +788,85 @@ mod tests {
             moca_vm_free(vm);
         }
     }
+
+    #[test]
+    fn test_output_ring() {
+        use crate::ffi::call::moca_call;
+        use crate::ffi::load::moca_load_chunk;
+        use crate::vm::{Chunk, Function, Op, bytecode};
+
+        // main writes "hello\n" to stdout
+        let chunk = Chunk {
+            functions: vec![],
+            main: Function {
+                name: "main".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: vec![
+                    Op::I64Const(1),
+                    Op::StringConst(0),
+                    Op::HeapLoad(0),
+                    Op::I64Const(6),
+                    Op::Hostcall(1, 3),
+                    Op::Ret,
+                ]
+                .into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec!["hello\n".to_string()].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        };
+        let data = bytecode::serialize(&chunk);
+
+        unsafe {
+            let vm = moca_vm_new();
+            moca_load_chunk(vm, data.as_ptr(), data.len());
+            let mut storage = [0u8; 8];
+            let mut ring = MocaOutputRing {
+                data: storage.as_mut_ptr(),
+                capacity: storage.len(),
+                head: 0,
+                tail: 0,
+                dropped: 0,
+            };
+            let mut empty = MocaOutputRing {
+                capacity: 0,
+                ..ring
+            };
+            assert_eq!(
+                moca_set_output_ring(vm, &mut empty),
+                MocaResult::ErrorInvalidArg
+            );
+            assert_eq!(moca_set_output_ring(vm, &mut ring), MocaResult::Ok);
+            assert_eq!(
+                moca_set_output_buffering(vm, MocaBufferMode::Block),
+                MocaResult::Ok
+            );
+
+            assert_eq!(moca_call(vm, c"main".as_ptr(), 0), MocaResult::Ok);
+            assert_eq!((ring.head, ring.dropped), (6, 0));
+            assert_eq!(&storage[..6], b"hello\n");
+
+            // Once the host has consumed it, the next write wraps around
+            ring.tail = 6;
+            assert_eq!(moca_call(vm, c"main".as_ptr(), 0), MocaResult::Ok);
+            assert_eq!((ring.head, ring.dropped), (12, 0));
+            assert_eq!(&storage, b"llo\no\nhe");
+
+            // With 2 bytes free the rest is dropped
+            assert_eq!(moca_call(vm, c"main".as_ptr(), 0), MocaResult::Ok);
+            assert_eq!((ring.head, ring.dropped), (14, 4));
+            assert_eq!(&storage, b"llo\nhehe");
+
+            assert_eq!(moca_flush_output(vm), MocaResult::Ok);
+            assert_eq!(
+                moca_set_output_ring(vm, std::ptr::null_mut()),
+                MocaResult::Ok
+            );
+            moca_vm_free(vm);
+        }
+    }
 }
@@ -496,6 +496,32 @@ impl<'a> AArch64Assembler<'a> {
         self.emit_raw(inst);
     }
 
+    /// STP D1, D2, [SP, #imm]! (store FP register pair with pre-index)
+    pub fn stp_d_pre(&mut self, dt1: u8, dt2: u8, imm: i16) {
+        // STP (SIMD&FP) pre-index: opc=01, V=1, bits[25:23]=011, L=0
+        // Encoding: 01 101 1 01 1 0 imm7 Rt2 Rn Rt1 = 0x6D800000
+        let scaled = ((imm / 8) as u32) & 0x7F;
+        let inst = 0x6D800000
+            | (scaled << 15)
+            | ((dt2 as u32) << 10)
+            | ((Reg::Sp.code() as u32) << 5)
+            | (dt1 as u32);
+        self.emit_raw(inst);
+    }
+
+    /// LDP D1, D2, [SP], #imm (load FP register pair with post-index)
+    pub fn ldp_d_post(&mut self, dt1: u8, dt2: u8, imm: i16) {
+        // LDP (SIMD&FP) post-index: opc=01, V=1, bits[25:23]=001, L=1
+        // Encoding: 01 101 1 00 1 1 imm7 Rt2 Rn Rt1 = 0x6CC00000
+        let scaled = ((imm / 8) as u32) & 0x7F;
+        let inst = 0x6CC00000
+            | (scaled << 15)
+            | ((dt2 as u32) << 10)
+            | ((Reg::Sp.code() as u32) << 5)
+            | (dt1 as u32);
+        self.emit_raw(inst);
+    }
+
     // ==================== Floating-Point Operations ====================
 
     /// FMOV Dd, Xn (move from GP register to FP register, 64-bit)
@@ -512,6 +538,13 @@ impl<'a> AArch64Assembler<'a> {
         self.emit_raw(inst);
     }
 
+    /// FMOV Dd, Dn (move between FP registers, 64-bit)
+    pub fn fmov_d_d(&mut self, fd: u8, fn_: u8) {
+        // 0001 1110 0110 0000 0100 00nn nnnd dddd
+        let inst = 0x1E604000 | ((fn_ as u32) << 5) | (fd as u32);
+        self.emit_raw(inst);
+    }
+
     /// FADD Dd, Dn, Dm (double-precision floating-point add)
     pub fn fadd_d(&mut self, fd: u8, fn_: u8, fm: u8) {
         // 0001 1110 011m mmmm 0010 10nn nnnd dddd
@@ -606,4 +639,21 @@ mod tests {
         // RET should be 0xD65F03C0
         assert_eq!(buf.code(), &[0xC0, 0x03, 0x5F, 0xD6]);
     }
+
+    #[test]
+    fn test_fp_register_pairs() {
+        let mut buf = CodeBuffer::new();
+        let mut asm = AArch64Assembler::new(&mut buf);
+        asm.stp_d_pre(8, 9, -16);
+        asm.ldp_d_post(8, 9, 16);
+        asm.fmov_d_d(8, 0);
+
+        // STP D8, D9, [SP, #-16]!; LDP D8, D9, [SP], #16; FMOV D8, D0
+        let words: Vec<u32> = buf
+            .code()
+            .chunks(4)
+            .map(|w| u32::from_le_bytes([w[0], w[1], w[2], w[3]]))
+            .collect();
+        assert_eq!(words, [0x6DBF27E8, 0x6CC127E8, 0x1E604008]);
+    }
 }
@@ -0,0 +1,319 @@
+//! Persistent cache of JIT-compiled machine code.
+//!
+//! Compiled functions and loops are keyed by a hash of their bytecode (plus
+//! the bodies of direct callees, which the compiler may inline) and of the
+//! host CPU, so a new process can install code generated by an earlier run
+//! instead of warming up again.
+//!
+//! Generated code is position-independent: it reaches the heap base, the
+//! string cache, the JIT function table and the runtime helpers only through
+//! the `JitCallContext` pointer it is called with, and self-recursive calls
+//! are PC-relative. Entries are therefore copied into executable memory
+//! unchanged; the only relocation data is the entry offset and frame size
+//! that get registered in `JitFunctionTable`.
+//!
+//! File layout (little-endian):
+//!   magic "MJIT", version: u32, cpu_signature: u64, count: u32,
+//!   then per entry: key: u64, entry_offset: u32, total_regs: u32,
+//!   code_len: u32, code: [u8; code_len]
+
+use super::memory::ExecutableMemory;
+use crate::vm::fnv::Fnv;
+use crate::vm::{Function, Op, bytecode};
+use std::collections::HashMap;
+use std::path::Path;
+
+const MAGIC: &[u8; 4] = b"MJIT";
+const VERSION: u32 = 3;
+
+/// Machine code of one compiled function or loop.
+pub struct CachedCode {
+    pub code: Vec<u8>,
+    /// Entry point offset within `code`
+    pub entry_offset: usize,
+    /// Number of VRegs (locals + temps) for frame allocation
+    pub total_regs: usize,
+}
+
+impl CachedCode {
+    /// Copy the code into a fresh block of executable memory.
+    pub fn to_memory(&self) -> Result<ExecutableMemory, String> {
+        let mut memory = ExecutableMemory::new(self.code.len())
+            .map_err(|e| format!("Failed to allocate executable memory: {}", e))?;
+        memory
+            .write(0, &self.code)
+            .map_err(|e| format!("Failed to write code: {}", e))?;
+        memory
+            .make_executable()
+            .map_err(|e| format!("Failed to make memory executable: {}", e))?;
+        Ok(memory)
+    }
+}
+
+/// Compiled code keyed by function/loop hash, loadable from and savable to disk.
+#[derive(Default)]
+pub struct JitCache {
+    entries: HashMap<u64, CachedCode>,
+}
+
+impl JitCache {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+
+    pub fn get(&self, key: u64) -> Option<&CachedCode> {
+        self.entries.get(&key)
+    }
+
+    /// Record compiled code under `key`, replacing any previous entry.
+    pub fn insert(&mut self, key: u64, code: &[u8], entry_offset: usize, total_regs: usize) {
+        self.entries.insert(
+            key,
+            CachedCode {
+                code: code.to_vec(),
+                entry_offset,
+                total_regs,
+            },
+        );
+    }
+
+    /// Key of a compiled function.
+    ///
+    /// `func_index` is `usize::MAX` for main.
+    pub fn function_key(functions: &[Function], func: &Function, func_index: usize) -> u64 {
+        let mut h = Fnv::new();
+        h.write(b"fn");
+        hash_function(&mut h, functions, func, func_index);
+        h.finish()
+    }
+
+    /// Key of a compiled loop spanning Op PCs `loop_start_pc..=loop_end_pc`.
+    pub fn loop_key(
+        functions: &[Function],
+        func: &Function,
+        func_index: usize,
+        loop_start_pc: usize,
+        loop_end_pc: usize,
+    ) -> u64 {
+        let mut h = Fnv::new();
+        h.write(b"loop");
+        hash_function(&mut h, functions, func, func_index);
+        h.write_u64(loop_start_pc as u64);
+        h.write_u64(loop_end_pc as u64);
+        h.finish()
+    }
+
+    /// Read a cache file.
+    ///
+    /// A missing file, or one written by another moca build or for another
+    /// CPU, yields an empty cache. A file that is not a cache or is truncated
+    /// is an error.
+    pub fn load(path: &Path) -> Result<Self, String> {
+        match std::fs::read(path) {
+            Ok(data) => Self::deserialize(&data),
+            Err(e) if e.kind() == std::io::ErrorKind::NotFound => Ok(Self::new()),
+            Err(e) => Err(format!("cannot read JIT cache: {}", e)),
+        }
+    }
+
+    /// Write all entries to a cache file.
+    pub fn save(&self, path: &Path) -> Result<(), String> {
+        std::fs::write(path, self.serialize()).map_err(|e| format!("cannot write JIT cache: {}", e))
+    }
+
+    pub fn serialize(&self) -> Vec<u8> {
+        let mut out = Vec::new();
+        out.extend_from_slice(MAGIC);
+        out.extend_from_slice(&VERSION.to_le_bytes());
+        out.extend_from_slice(&cpu_signature().to_le_bytes());
+        out.extend_from_slice(&(self.entries.len() as u32).to_le_bytes());
+        // Sort by key so identical caches produce identical files
+        let mut keys: Vec<_> = self.entries.keys().copied().collect();
+        keys.sort_unstable();
+        for key in keys {
+            let entry = &self.entries[&key];
+            out.extend_from_slice(&key.to_le_bytes());
+            out.extend_from_slice(&(entry.entry_offset as u32).to_le_bytes());
+            out.extend_from_slice(&(entry.total_regs as u32).to_le_bytes());
+            out.extend_from_slice(&(entry.code.len() as u32).to_le_bytes());
+            out.extend_from_slice(&entry.code);
+        }
+        out
+    }
+
+    pub fn deserialize(data: &[u8]) -> Result<Self, String> {
+        let mut r = Reader { data, pos: 0 };
+        if r.bytes(4)? != MAGIC {
+            return Err("not a JIT cache file".to_string());
+        }
+        if r.u32()? != VERSION || r.u64()? != cpu_signature() {
+            // Stale cache: start over rather than fail
+            return Ok(Self::new());
+        }
+
+        let count = r.u32()? as usize;
+        let mut cache = Self::new();
+        for _ in 0..count {
+            let key = r.u64()?;
+            let entry_offset = r.u32()? as usize;
+            let total_regs = r.u32()? as usize;
+            let code_len = r.u32()? as usize;
+            let code = r.bytes(code_len)?;
+            if entry_offset >= code.len() {
+                return Err("corrupt JIT cache entry".to_string());
+            }
+            cache.insert(key, code, entry_offset, total_regs);
+        }
+        Ok(cache)
+    }
+}
+
+/// Hash of the host that generated code depends on: target, moca build and
+/// CPU features.
+pub fn cpu_signature() -> u64 {
+    let mut h = Fnv::new();
+    h.write(std::env::consts::ARCH.as_bytes());
+    h.write(env!("CARGO_PKG_VERSION").as_bytes());
+    h.write(env!("MOCA_BUILD_HASH").as_bytes());
+    #[cfg(target_arch = "x86_64")]
+    {
+        let features = [
+            std::arch::is_x86_feature_detected!("sse4.1"),
+            std::arch::is_x86_feature_detected!("sse4.2"),
+            std::arch::is_x86_feature_detected!("popcnt"),
+            std::arch::is_x86_feature_detected!("avx"),
+            std::arch::is_x86_feature_detected!("avx2"),
+            std::arch::is_x86_feature_detected!("bmi1"),
+            std::arch::is_x86_feature_detected!("bmi2"),
+            std::arch::is_x86_feature_detected!("lzcnt"),
+        ];
+        for f in features {
+            h.write(&[f as u8]);
+        }
+    }
+    h.finish()
+}
+
+/// Feed a function's identity into `h`: its index (self-calls are compiled
+/// differently), its shape and body, and those of its direct callees.
+fn hash_function(h: &mut Fnv, functions: &[Function], func: &Function, func_index: usize) {
+    h.write_u64(func_index as u64);
+    hash_body(h, func);
+    for op in func.code.iter() {
+        if let Op::Call(callee, _) = op
+            && let Some(callee) = functions.get(*callee)
+        {
+            hash_body(h, callee);
+        }
+    }
+}
+
+/// Everything the MicroOp conversion of `func` depends on.
+fn hash_body(h: &mut Fnv, func: &Function) {
+    h.write_u64(func.arity as u64);
+    h.write_u64(func.locals_count as u64);
+    let local_types: Vec<u8> = func.local_types.iter().map(|&t| t as u8).collect();
+    h.write(&local_types);
+    h.write(&bytecode::encode_ops(&func.code));
+}
+
+struct Reader<'a> {
+    data: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> Reader<'a> {
+    fn bytes(&mut self, n: usize) -> Result<&'a [u8], String> {
+        let end = self
+            .pos
+            .checked_add(n)
+            .filter(|&end| end <= self.data.len())
+            .ok_or_else(|| "truncated JIT cache".to_string())?;
+        let s = &self.data[self.pos..end];
+        self.pos = end;
+        Ok(s)
+    }
+
+    fn u32(&mut self) -> Result<u32, String> {
+        Ok(u32::from_le_bytes(self.bytes(4)?.try_into().unwrap()))
+    }
+
+    fn u64(&mut self) -> Result<u64, String> {
+        Ok(u64::from_le_bytes(self.bytes(8)?.try_into().unwrap()))
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn func(name: &str, code: Vec<Op>) -> Function {
+        Function {
+            name: name.to_string(),
+            arity: 0,
+            locals_count: 0,
+            code: code.into(),
+            stackmap: None,
+            local_types: vec![],
+        }
+    }
+
+    #[test]
+    fn test_roundtrip() {
+        let mut cache = JitCache::new();
+        cache.insert(1, &[0x90, 0xc3], 0, 4);
+        cache.insert(2, &[0x90, 0x90, 0xc3], 1, 8);
+
+        let loaded = JitCache::deserialize(&cache.serialize()).unwrap();
+        assert_eq!(loaded.len(), 2);
+        let entry = loaded.get(2).unwrap();
+        assert_eq!(entry.code, [0x90, 0x90, 0xc3]);
+        assert_eq!(entry.entry_offset, 1);
+        assert_eq!(entry.total_regs, 8);
+        assert!(entry.to_memory().is_ok());
+    }
+
+    #[test]
+    fn test_stale_and_corrupt_files() {
+        let mut cache = JitCache::new();
+        cache.insert(1, &[0xc3], 0, 0);
+        let mut data = cache.serialize();
+
+        // Truncated entry
+        assert!(JitCache::deserialize(&data[..data.len() - 1]).is_err());
+        assert!(JitCache::deserialize(b"nope").is_err());
+
+        // Different CPU signature is ignored, not rejected
+        data[8] ^= 0xff;
+        assert!(JitCache::deserialize(&data).unwrap().is_empty());
+
+        let missing = std::env::temp_dir().join("moca_missing_jit_cache.bin");
+        assert!(JitCache::load(&missing).unwrap().is_empty());
+    }
+
+    #[test]
+    fn test_keys_follow_bytecode() {
+        let callee = func("f", vec![Op::I64Const(1), Op::Ret]);
+        let caller = func("main", vec![Op::Call(0, 0), Op::Ret]);
+        let functions = vec![callee];
+        let key = JitCache::function_key(&functions, &caller, usize::MAX);
+        assert_eq!(key, JitCache::function_key(&functions, &caller, usize::MAX));
+
+        // Editing an inlinable callee invalidates the caller
+        let edited = vec![func("f", vec![Op::I64Const(2), Op::Ret])];
+        assert_ne!(key, JitCache::function_key(&edited, &caller, usize::MAX));
+
+        assert_ne!(
+            JitCache::loop_key(&functions, &caller, usize::MAX, 0, 1),
+            JitCache::loop_key(&functions, &caller, usize::MAX, 0, 2)
+        );
+    }
+}
@@ -0,0 +1,273 @@
+//! Background compilation queue.
+//!
+//! Compiling a hot function takes a millisecond or more, long enough to
+//! stall the request that made it hot. With a `CompileQueue` the VM hands
+//! the job to a compile thread and keeps interpreting the function. Each job
+//! compiles from an immutable snapshot of the bytecode (the chunk behind an
+//! `Arc`). Results wait until the VM collects them at its next call and
+//! publishes the entry points in its function table. Calls after that run
+//! the native code.
+//!
+//! Jobs are taken hottest first. When more than `depth` jobs are waiting,
+//! the coldest one is dropped and handed back to the VM, which can make
+//! the function earn its place again.
+
+use std::io;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread::{self, JoinHandle};
+
+/// Jobs kept waiting by default.
+pub const DEFAULT_DEPTH: usize = 64;
+
+/// A compilation waiting in the queue.
+struct Job<T> {
+    key: usize,
+    hotness: u64,
+    compile: Box<dyn FnOnce() -> T + Send>,
+}
+
+struct State<T> {
+    jobs: Vec<Job<T>>,
+    /// Results of finished jobs, in completion order
+    finished: Vec<(usize, T)>,
+    /// Bumped by `clear`; a job running across it is discarded
+    generation: u64,
+    /// Key of the job the compile thread is running
+    running: Option<usize>,
+    stop: bool,
+}
+
+struct Shared<T> {
+    state: Mutex<State<T>>,
+    /// Signals new jobs to the compile thread and idleness to `wait_idle`
+    changed: Condvar,
+    /// Set when `finished` is non-empty, so polling needs no lock
+    has_finished: AtomicBool,
+}
+
+/// Jobs of one VM and the thread that compiles them.
+pub struct CompileQueue<T: Send + 'static> {
+    shared: Arc<Shared<T>>,
+    depth: usize,
+    worker: Option<JoinHandle<()>>,
+}
+
+impl<T: Send + 'static> CompileQueue<T> {
+    /// Start a compile thread that keeps at most `depth` jobs waiting.
+    pub fn new(depth: usize) -> io::Result<Self> {
+        let shared = Arc::new(Shared {
+            state: Mutex::new(State {
+                jobs: Vec::new(),
+                finished: Vec::new(),
+                generation: 0,
+                running: None,
+                stop: false,
+            }),
+            changed: Condvar::new(),
+            has_finished: AtomicBool::new(false),
+        });
+        let worker = {
+            let shared = shared.clone();
+            thread::Builder::new()
+                .name("moca-jit".to_string())
+                .spawn(move || Self::work(&shared))?
+        };
+        Ok(Self {
+            shared,
+            depth: depth.max(1),
+            worker: Some(worker),
+        })
+    }
+
+    fn work(shared: &Shared<T>) {
+        let mut state = shared.state.lock().unwrap_or_else(|e| e.into_inner());
+        loop {
+            if state.stop {
+                return;
+            }
+            let Some(hottest) = (0..state.jobs.len()).max_by_key(|&i| state.jobs[i].hotness) else {
+                state = shared
+                    .changed
+                    .wait(state)
+                    .unwrap_or_else(|e| e.into_inner());
+                continue;
+            };
+            let job = state.jobs.swap_remove(hottest);
+            let generation = state.generation;
+            state.running = Some(job.key);
+            drop(state);
+
+            let result = (job.compile)();
+
+            state = shared.state.lock().unwrap_or_else(|e| e.into_inner());
+            state.running = None;
+            if state.generation == generation {
+                state.finished.push((job.key, result));
+                shared.has_finished.store(true, Ordering::Release);
+            }
+            shared.changed.notify_all();
+        }
+    }
+
+    fn state(&self) -> std::sync::MutexGuard<'_, State<T>> {
+        self.shared.state.lock().unwrap_or_else(|e| e.into_inner())
+    }
+
+    /// Queue `compile` for `key` at `hotness`. If that overfills the queue,
+    /// the coldest job (possibly this one) is dropped and its key returned.
+    pub fn submit(
+        &self,
+        key: usize,
+        hotness: u64,
+        compile: impl FnOnce() -> T + Send + 'static,
+    ) -> Option<usize> {
+        let mut state = self.state();
+        state.jobs.push(Job {
+            key,
+            hotness,
+            compile: Box::new(compile),
+        });
+        let dropped = if state.jobs.len() > self.depth {
+            let coldest = (0..state.jobs.len())
+                .min_by_key(|&i| state.jobs[i].hotness)
+                .expect("queue is not empty");
+            Some(state.jobs.swap_remove(coldest).key)
+        } else {
+            None
+        };
+        self.shared.changed.notify_all();
+        dropped
+    }
+
+    /// Raise the hotness of the waiting job for `key`, if any.
+    pub fn bump(&self, key: usize, hotness: u64) {
+        let mut state = self.state();
+        if let Some(job) = state.jobs.iter_mut().find(|job| job.key == key) {
+            job.hotness = job.hotness.max(hotness);
+        }
+    }
+
+    /// Whether results are waiting for `take_finished`. Lock-free.
+    #[inline]
+    pub fn has_finished(&self) -> bool {
+        self.shared.has_finished.load(Ordering::Acquire)
+    }
+
+    /// The results of the jobs finished since the last call.
+    pub fn take_finished(&self) -> Vec<(usize, T)> {
+        let mut state = self.state();
+        self.shared.has_finished.store(false, Ordering::Release);
+        std::mem::take(&mut state.finished)
+    }
+
+    /// Jobs waiting or running.
+    pub fn pending(&self) -> usize {
+        let state = self.state();
+        state.jobs.len() + usize::from(state.running.is_some())
+    }
+
+    /// Block until every job has finished.
+    pub fn wait_idle(&self) {
+        let mut state = self.state();
+        while self.worker.is_some() && (!state.jobs.is_empty() || state.running.is_some()) {
+            state = self
+                .shared
+                .changed
+                .wait(state)
+                .unwrap_or_else(|e| e.into_inner());
+        }
+    }
+
+    /// Drop all waiting jobs and results, and the result of a running job.
+    pub fn clear(&self) {
+        let mut state = self.state();
+        state.jobs.clear();
+        state.finished.clear();
+        state.generation += 1;
+        self.shared.has_finished.store(false, Ordering::Release);
+    }
+}
+
+impl<T: Send + 'static> Drop for CompileQueue<T> {
+    fn drop(&mut self) {
+        {
+            let mut state = self.state();
+            state.stop = true;
+            state.jobs.clear();
+        }
+        self.shared.changed.notify_all();
+        if let Some(worker) = self.worker.take() {
+            let _ = worker.join();
+        }
+    }
+}
+
+impl<T: Send + 'static> std::fmt::Debug for CompileQueue<T> {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("CompileQueue")
+            .field("depth", &self.depth)
+            .field("pending", &self.pending())
+            .finish()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::mpsc;
+
+    /// A queue whose compile thread is held in a first job until the
+    /// returned sender is used.
+    fn blocked_queue(depth: usize) -> (CompileQueue<usize>, mpsc::Sender<()>) {
+        let queue = CompileQueue::new(depth).unwrap();
+        let (release, wait) = mpsc::channel();
+        let (started, running) = mpsc::channel();
+        queue.submit(0, u64::MAX, move || {
+            started.send(()).unwrap();
+            wait.recv().unwrap();
+            0
+        });
+        running.recv().unwrap();
+        (queue, release)
+    }
+
+    #[test]
+    fn test_hottest_job_first() {
+        let (queue, release) = blocked_queue(8);
+        queue.submit(1, 10, || 1);
+        queue.submit(2, 30, || 2);
+        queue.submit(3, 20, || 3);
+        queue.bump(1, 40);
+        release.send(()).unwrap();
+        queue.wait_idle();
+        let order: Vec<usize> = queue.take_finished().into_iter().map(|(k, _)| k).collect();
+        assert_eq!(order, vec![0, 1, 2, 3]);
+        assert!(!queue.has_finished());
+        assert_eq!(queue.pending(), 0);
+    }
+
+    #[test]
+    fn test_full_queue_drops_coldest() {
+        let (queue, release) = blocked_queue(2);
+        assert_eq!(queue.submit(1, 10, || 1), None);
+        assert_eq!(queue.submit(2, 30, || 2), None);
+        assert_eq!(queue.submit(3, 20, || 3), Some(1));
+        assert_eq!(queue.submit(4, 5, || 4), Some(4));
+        release.send(()).unwrap();
+        queue.wait_idle();
+        let mut keys: Vec<usize> = queue.take_finished().into_iter().map(|(k, _)| k).collect();
+        keys.sort();
+        assert_eq!(keys, vec![0, 2, 3]);
+    }
+
+    #[test]
+    fn test_clear_discards_running_job() {
+        let (queue, release) = blocked_queue(8);
+        queue.submit(1, 10, || 1);
+        queue.clear();
+        release.send(()).unwrap();
+        queue.wait_idle();
+        assert!(queue.take_finished().is_empty());
+    }
+}
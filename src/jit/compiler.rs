@@ -6,7 +6,9 @@
 #[cfg(target_arch = "aarch64")]
 use super::memory::ExecutableMemory;
 #[cfg(target_arch = "aarch64")]
-use std::collections::HashMap;
+use super::stackmap::StackMapTable;
+#[cfg(target_arch = "aarch64")]
+use crate::vm::ValueType;
 
 /// Value tag constants for JIT code.
 /// Values are represented as 128-bit (tag: u64, payload: u64).
@@ -28,8 +30,8 @@ pub struct CompiledCode {
     pub memory: ExecutableMemory,
     /// Entry point offset within the memory
     pub entry_offset: usize,
-    /// Stack map for GC (pc_offset -> bitmap of stack slots with refs)
-    pub stack_map: HashMap<usize, Vec<bool>>,
+    /// Stack maps of the GC safepoints in the code
+    pub stack_map: StackMapTable,
     /// Total number of VRegs (locals + temps) for frame allocation.
     pub total_regs: usize,
 }
@@ -62,10 +64,13 @@ pub struct CompiledLoop {
     pub loop_start_pc: usize,
     /// Bytecode PC where the loop ends (backward jump instruction)
     pub loop_end_pc: usize,
-    /// Stack map for GC (pc_offset -> bitmap of stack slots with refs)
-    pub stack_map: HashMap<usize, Vec<bool>>,
+    /// Stack maps of the GC safepoints in the code
+    pub stack_map: StackMapTable,
     /// Total number of VRegs (locals + temps) for MicroOp JIT.
     pub total_regs: usize,
+    /// Locals the code was specialized on and their types; every entry
+    /// must check them
+    pub guards: Vec<(usize, ValueType)>,
 }
 
 #[cfg(target_arch = "aarch64")]
@@ -17,13 +17,19 @@ use super::compiler::{CompiledCode, CompiledLoop, value_tags};
 #[cfg(target_arch = "aarch64")]
 use super::memory::ExecutableMemory;
 #[cfg(target_arch = "aarch64")]
+use super::regalloc::{self, AllocRequest, CallKind, RegClass, RegFile};
+#[cfg(target_arch = "aarch64")]
+use super::stackmap::{MAX_SAFEPOINT_ROOTS, RootStack, StackMapEntry, StackMapTable};
+#[cfg(target_arch = "aarch64")]
 use crate::vm::ElemKind;
 #[cfg(target_arch = "aarch64")]
 use crate::vm::ValueType;
 #[cfg(target_arch = "aarch64")]
+use crate::vm::bulk::{BulkOp, Operand};
+#[cfg(target_arch = "aarch64")]
 use crate::vm::microop::{CmpCond, ConvertedFunction, MicroOp, VReg};
 #[cfg(target_arch = "aarch64")]
-use std::collections::{HashMap, HashSet};
+use std::collections::{BTreeSet, HashMap, HashSet};
 
 /// Register conventions (same as compiler.rs).
 #[cfg(target_arch = "aarch64")]
@@ -43,6 +49,32 @@ mod regs {
     pub const TMP3: Reg = Reg::X3;
     pub const TMP4: Reg = Reg::X9;
     pub const TMP5: Reg = Reg::X10;
+
+    /// Registers for allocated VRegs. All are callee-saved under AAPCS64,
+    /// so they survive calls; X21/X22 are saved by every prologue, the rest
+    /// only when used.
+    pub const ALLOC_GPRS: [Reg; 8] = [
+        Reg::X21,
+        Reg::X22,
+        Reg::X23,
+        Reg::X24,
+        Reg::X25,
+        Reg::X26,
+        Reg::X27,
+        Reg::X28,
+    ];
+    /// FP registers for allocated VRegs (AAPCS64 preserves the low 64 bits
+    /// of D8-D15). D0/D1 stay scratch.
+    pub const ALLOC_FPRS: [u8; 8] = [8, 9, 10, 11, 12, 13, 14, 15];
+}
+
+/// Registers assigned to VRegs by `regalloc`. VRegs not listed live in
+/// their frame slots.
+#[cfg(target_arch = "aarch64")]
+#[derive(Debug, Default)]
+struct RegMap {
+    gpr: HashMap<usize, Reg>,
+    fpr: HashMap<usize, u8>,
 }
 
 /// MicroOp-based JIT compiler for AArch64.
@@ -64,6 +96,20 @@ pub struct MicroOpJitCompiler {
     /// VRegs that need unconditional shadow tag updates because they are written
     /// with multiple different tag types across different MicroOps.
     shadow_conflict_vregs: HashSet<usize>,
+    /// Register assignment for the function or loop being compiled.
+    reg_map: RegMap,
+    /// Call PC → all VRegs live across it.
+    call_live: HashMap<usize, Vec<usize>>,
+    /// VRegs that never hold a reference, left out of stack maps.
+    scalar_vregs: HashSet<usize>,
+    /// Stack maps of the safepoints emitted so far.
+    stack_maps: StackMapTable,
+    /// Allocated callee-saved pairs beyond X21/X22, saved by the prologue.
+    saved_gpr_pairs: Vec<(Reg, Reg)>,
+    saved_fpr_pairs: Vec<(u8, u8)>,
+    /// Locals whose types a loop is specialized on, from the interpreter's
+    /// type feedback.
+    type_guards: Vec<(usize, ValueType)>,
 }
 
 #[cfg(target_arch = "aarch64")]
@@ -78,9 +124,23 @@ impl MicroOpJitCompiler {
             self_locals_count: 0,
             vreg_types: Vec::new(),
             shadow_conflict_vregs: HashSet::new(),
+            reg_map: RegMap::default(),
+            call_live: HashMap::new(),
+            scalar_vregs: HashSet::new(),
+            stack_maps: StackMapTable::new(),
+            saved_gpr_pairs: Vec::new(),
+            saved_fpr_pairs: Vec::new(),
+            type_guards: Vec::new(),
         }
     }
 
+    /// Compile loops for the given types of some locals instead of their
+    /// static types. The VM must check `CompiledLoop::guards` on entry.
+    pub fn with_type_guards(mut self, guards: Vec<(usize, ValueType)>) -> Self {
+        self.type_guards = guards;
+        self
+    }
+
     /// Convert a ValueType to the corresponding JIT tag constant.
     fn value_type_to_tag(ty: &ValueType) -> u64 {
         match ty {
@@ -102,10 +162,22 @@ impl MicroOpJitCompiler {
         self.self_locals_count = locals_count;
         self.vreg_types = converted.vreg_types.clone();
         self.shadow_conflict_vregs = Self::compute_shadow_conflicts(&converted.micro_ops);
+        self.scalar_vregs = Self::compute_scalar_vregs(&converted.micro_ops, &self.vreg_types);
+
+        // Allocate registers over the whole function; the prologue saves
+        // the callee-saved ones it uses
+        let live_in = if converted.micro_ops.is_empty() {
+            Vec::new()
+        } else {
+            let ops = &converted.micro_ops;
+            self.allocate_registers(ops, 0, ops.len() - 1, &[])
+        };
 
         // Emit prologue and shadow tag initialization
         self.emit_prologue();
         self.emit_shadow_init();
+        self.emit_root_slot_init(converted.arity);
+        self.emit_reg_transfers(&live_in, false);
 
         // Pre-compute jump targets for peephole optimization safety
         let jump_targets: HashSet<usize> = converted
@@ -161,7 +233,7 @@ impl MicroOpJitCompiler {
         Ok(CompiledCode {
             memory,
             entry_offset: 0,
-            stack_map: HashMap::new(),
+            stack_map: self.stack_maps,
             total_regs: self.total_regs,
         })
     }
@@ -190,27 +262,44 @@ impl MicroOpJitCompiler {
         self.self_func_index = func_index;
         self.self_locals_count = locals_count;
         self.vreg_types = converted.vreg_types.clone();
+        for &(local, ty) in &self.type_guards {
+            if local < locals_count {
+                self.vreg_types[local] = ty;
+            }
+        }
         self.shadow_conflict_vregs = Self::compute_shadow_conflicts(&converted.micro_ops);
-
-        // Emit prologue and shadow tag initialization
-        self.emit_prologue();
-        self.emit_shadow_init();
+        self.scalar_vregs = Self::compute_scalar_vregs(&converted.micro_ops, &self.vreg_types);
 
         // Epilogue label: one past the loop end
         let epilogue_label = loop_end_microop_pc + 1;
 
         let ops = &converted.micro_ops;
 
-        // Try register-pinned loop optimization first
-        if let Some(result) = self.try_compile_pinned_loop(
-            ops,
-            loop_start_microop_pc,
-            loop_end_microop_pc,
-            epilogue_label,
-        ) {
-            result?;
+        // Register-pinned loops first; otherwise allocate registers over
+        // the loop. Locals are copied back to the VM when the loop exits.
+        let pinned = self.analyze_for_pinning(ops, loop_start_microop_pc, loop_end_microop_pc);
+        let live_in = match pinned {
+            Some(_) => Vec::new(),
+            None => {
+                let locals: Vec<usize> = (0..locals_count).collect();
+                self.allocate_registers(ops, loop_start_microop_pc, loop_end_microop_pc, &locals)
+            }
+        };
+
+        // Emit prologue and shadow tag initialization
+        self.emit_prologue();
+        self.emit_shadow_init();
+
+        if let Some(info) = pinned {
+            self.emit_pinned_loop(
+                ops,
+                loop_start_microop_pc,
+                loop_end_microop_pc,
+                epilogue_label,
+                &info,
+            )?;
         } else {
-            // Fall back to normal per-instruction compilation
+            self.emit_reg_transfers(&live_in, false);
 
             // Pre-compute jump targets for peephole optimization safety
             let jump_targets: HashSet<usize> = converted.micro_ops
@@ -278,6 +367,16 @@ impl MicroOpJitCompiler {
 
             // Emit epilogue label
             self.labels.insert(epilogue_label, self.buf.len());
+            let mut locals: Vec<usize> = self
+                .reg_map
+                .gpr
+                .keys()
+                .chain(self.reg_map.fpr.keys())
+                .copied()
+                .filter(|&v| v < locals_count)
+                .collect();
+            locals.sort_unstable();
+            self.emit_reg_transfers(&locals, true);
         }
 
         self.emit_epilogue();
@@ -299,8 +398,9 @@ impl MicroOpJitCompiler {
             entry_offset: 0,
             loop_start_pc: loop_start_op_pc,
             loop_end_pc: loop_end_op_pc,
-            stack_map: HashMap::new(),
+            stack_map: self.stack_maps,
             total_regs: self.total_regs,
+            guards: self.type_guards,
         })
     }
 
@@ -309,6 +409,168 @@ impl MicroOpJitCompiler {
         (vreg.0 * 8) as u16
     }
 
+    /// Load a VReg's payload into `rd` from its register or frame slot.
+    fn load_vreg(asm: &mut AArch64Assembler, rd: Reg, vreg: &VReg, map: &RegMap) {
+        if let Some(&reg) = map.gpr.get(&vreg.0) {
+            if reg != rd {
+                asm.mov(rd, reg);
+            }
+        } else if let Some(&fd) = map.fpr.get(&vreg.0) {
+            asm.fmov_x_d(rd, fd);
+        } else {
+            asm.ldr(rd, regs::FRAME_BASE, Self::vreg_offset(vreg));
+        }
+    }
+
+    /// Store `rs` as a VReg's payload, to its register or frame slot.
+    fn store_vreg(asm: &mut AArch64Assembler, rs: Reg, vreg: &VReg, map: &RegMap) {
+        if let Some(&reg) = map.gpr.get(&vreg.0) {
+            if reg != rs {
+                asm.mov(reg, rs);
+            }
+        } else if let Some(&fd) = map.fpr.get(&vreg.0) {
+            asm.fmov_d_x(fd, rs);
+        } else {
+            asm.str(rs, regs::FRAME_BASE, Self::vreg_offset(vreg));
+        }
+    }
+
+    /// FP register holding a VReg: its own, or `scratch` loaded through `tmp`.
+    fn load_vreg_d(
+        asm: &mut AArch64Assembler,
+        scratch: u8,
+        tmp: Reg,
+        vreg: &VReg,
+        map: &RegMap,
+    ) -> u8 {
+        if let Some(&fd) = map.fpr.get(&vreg.0) {
+            return fd;
+        }
+        Self::load_vreg(asm, tmp, vreg, map);
+        asm.fmov_d_x(scratch, tmp);
+        scratch
+    }
+
+    /// FP register to compute a VReg's new value in: its own, or `scratch`.
+    fn dst_vreg_d(vreg: &VReg, scratch: u8, map: &RegMap) -> u8 {
+        map.fpr.get(&vreg.0).copied().unwrap_or(scratch)
+    }
+
+    /// Store the value in `fd` to a VReg (nothing to do if `fd` is its own).
+    fn store_vreg_d(asm: &mut AArch64Assembler, fd: u8, tmp: Reg, vreg: &VReg, map: &RegMap) {
+        match map.fpr.get(&vreg.0) {
+            Some(&own) if own == fd => {}
+            Some(&own) => asm.fmov_d_d(own, fd),
+            None => {
+                asm.fmov_x_d(tmp, fd);
+                Self::store_vreg(asm, tmp, vreg, map);
+            }
+        }
+    }
+
+    /// Run the register allocator over `start..=end` and record the
+    /// assignment; returns the allocated VRegs to load on entry.
+    fn allocate_registers(
+        &mut self,
+        ops: &[MicroOp],
+        start: usize,
+        end: usize,
+        live_out: &[usize],
+    ) -> Vec<usize> {
+        let int_file = RegFile {
+            callee_saved: regs::ALLOC_GPRS.len(),
+            caller_saved: 0,
+        };
+        let float_file = RegFile {
+            callee_saved: regs::ALLOC_FPRS.len(),
+            caller_saved: 0,
+        };
+        let call_kind = |op: &MicroOp| match op {
+            MicroOp::Call { .. }
+            | MicroOp::CallIndirect { .. }
+            | MicroOp::CallDynamic { .. }
+            | MicroOp::StringConst { .. }
+            | MicroOp::GlobalGet { .. }
+            | MicroOp::VtableLookup { .. }
+            | MicroOp::HeapAllocDynSimple { .. }
+            | MicroOp::HeapBulk { .. } => Some(CallKind::ReadsBefore),
+            MicroOp::HeapAlloc { .. } => Some(CallKind::ReadsAfter),
+            _ => None,
+        };
+        let allocation = regalloc::allocate(&AllocRequest {
+            ops,
+            start,
+            end,
+            int: int_file,
+            float: float_file,
+            live_out,
+            call_kind: &call_kind,
+            memory_only: &HashSet::new(),
+        });
+
+        let mut reg_map = RegMap::default();
+        for (&vreg_idx, &(class, reg)) in &allocation.regs {
+            match class {
+                RegClass::Int => {
+                    reg_map.gpr.insert(vreg_idx, regs::ALLOC_GPRS[reg]);
+                }
+                RegClass::Float => {
+                    reg_map.fpr.insert(vreg_idx, regs::ALLOC_FPRS[reg]);
+                }
+            }
+        }
+        self.reg_map = reg_map;
+        self.call_live = allocation.call_live.clone();
+
+        // Save whole pairs to keep SP 16-byte aligned
+        let mut gpr_pairs: Vec<usize> = allocation
+            .used_callee_saved(RegClass::Int, int_file)
+            .into_iter()
+            .filter(|&reg| reg >= 2)
+            .map(|reg| reg / 2)
+            .collect();
+        gpr_pairs.dedup();
+        self.saved_gpr_pairs = gpr_pairs
+            .into_iter()
+            .map(|p| (regs::ALLOC_GPRS[2 * p], regs::ALLOC_GPRS[2 * p + 1]))
+            .collect();
+        let mut fpr_pairs: Vec<usize> = allocation
+            .used_callee_saved(RegClass::Float, float_file)
+            .into_iter()
+            .map(|reg| reg / 2)
+            .collect();
+        fpr_pairs.dedup();
+        self.saved_fpr_pairs = fpr_pairs
+            .into_iter()
+            .map(|p| (regs::ALLOC_FPRS[2 * p], regs::ALLOC_FPRS[2 * p + 1]))
+            .collect();
+
+        allocation.live_in
+    }
+
+    /// Move allocated VRegs between their registers and frame slots.
+    fn emit_reg_transfers(&mut self, vregs: &[usize], to_frame: bool) {
+        let mut asm = AArch64Assembler::new(&mut self.buf);
+        for &vreg_idx in vregs {
+            let off = Self::vreg_offset(&VReg(vreg_idx));
+            if let Some(&reg) = self.reg_map.gpr.get(&vreg_idx) {
+                if to_frame {
+                    asm.str(reg, regs::FRAME_BASE, off);
+                } else {
+                    asm.ldr(reg, regs::FRAME_BASE, off);
+                }
+            } else if let Some(&fd) = self.reg_map.fpr.get(&vreg_idx) {
+                if to_frame {
+                    asm.fmov_x_d(regs::TMP0, fd);
+                    asm.str(regs::TMP0, regs::FRAME_BASE, off);
+                } else {
+                    asm.ldr(regs::TMP0, regs::FRAME_BASE, off);
+                    asm.fmov_d_x(fd, regs::TMP0);
+                }
+            }
+        }
+    }
+
     /// Byte offset of a VReg's shadow tag from FRAME_BASE.
     /// Shadow tags are stored after all payload slots: [total_regs * 8 + vreg.0 * 8].
     fn shadow_tag_offset(&self, vreg: &VReg) -> u16 {
@@ -329,102 +591,38 @@ impl MicroOpJitCompiler {
         }
     }
 
+    /// Zero the frame slots of the non-argument VRegs that safepoints copy
+    /// to the root stack. A JIT caller does not clear the frame it allocates
+    /// on the native stack, so a VReg not written yet would otherwise hand
+    /// the GC a stale payload.
+    fn emit_root_slot_init(&mut self, arity: usize) {
+        let slots: BTreeSet<usize> = self
+            .call_live
+            .values()
+            .flatten()
+            .copied()
+            .filter(|v| *v >= arity && !self.scalar_vregs.contains(v))
+            .collect();
+        if slots.is_empty() {
+            return;
+        }
+        self.emit_load_imm64(0, regs::TMP0);
+        let mut asm = AArch64Assembler::new(&mut self.buf);
+        for v in slots {
+            asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(&VReg(v)));
+        }
+    }
+
     /// Pre-scan MicroOps to find VRegs written with different shadow tag types.
     /// These VRegs need unconditional shadow updates at every write.
     fn compute_shadow_conflicts(ops: &[MicroOp]) -> HashSet<usize> {
+        // Map: VReg index → set of tags written to it
         let mut vreg_tags: HashMap<usize, HashSet<u64>> = HashMap::new();
-
-        fn record(map: &mut HashMap<usize, HashSet<u64>>, vreg: usize, tag: u64) {
-            map.entry(vreg).or_default().insert(tag);
-        }
-
-        for op in ops {
-            match op {
-                MicroOp::ConstI64 { dst, .. } | MicroOp::ConstI32 { dst, .. } => {
-                    record(&mut vreg_tags, dst.0, value_tags::TAG_INT);
-                }
-                MicroOp::ConstF64 { dst, .. } | MicroOp::ConstF32 { dst, .. } => {
-                    record(&mut vreg_tags, dst.0, value_tags::TAG_FLOAT);
-                }
-                MicroOp::AddI64 { dst, .. }
-                | MicroOp::SubI64 { dst, .. }
-                | MicroOp::MulI64 { dst, .. }
-                | MicroOp::DivI64 { dst, .. }
-                | MicroOp::RemI64 { dst, .. }
-                | MicroOp::NegI64 { dst, .. }
-                | MicroOp::AddI64Imm { dst, .. }
-                | MicroOp::AndI64 { dst, .. }
-                | MicroOp::OrI64 { dst, .. }
-                | MicroOp::XorI64 { dst, .. }
-                | MicroOp::ShlI64 { dst, .. }
-                | MicroOp::ShlI64Imm { dst, .. }
-                | MicroOp::ShrI64 { dst, .. }
-                | MicroOp::ShrI64Imm { dst, .. }
-                | MicroOp::ShrU64 { dst, .. }
-                | MicroOp::ShrU64Imm { dst, .. }
-                | MicroOp::UMul128Hi { dst, .. }
-                | MicroOp::AddI32 { dst, .. }
-                | MicroOp::SubI32 { dst, .. }
-                | MicroOp::MulI32 { dst, .. }
-                | MicroOp::DivI32 { dst, .. }
-                | MicroOp::RemI32 { dst, .. }
-                | MicroOp::CmpI64 { dst, .. }
-                | MicroOp::CmpI64Imm { dst, .. }
-                | MicroOp::CmpI32 { dst, .. }
-                | MicroOp::EqzI32 { dst, .. }
-                | MicroOp::I64ExtendI32S { dst, .. }
-                | MicroOp::I64ExtendI32U { dst, .. }
-                | MicroOp::I32WrapI64 { dst, .. }
-                | MicroOp::I64TruncF64S { dst, .. }
-                | MicroOp::I32TruncF32S { dst, .. }
-                | MicroOp::I32TruncF64S { dst, .. }
-                | MicroOp::I64TruncF32S { dst, .. }
-                | MicroOp::RefEq { dst, .. }
-                | MicroOp::RefIsNull { dst, .. }
-                | MicroOp::F64ReinterpretAsI64 { dst, .. } => {
-                    record(&mut vreg_tags, dst.0, value_tags::TAG_INT);
-                }
-                MicroOp::AddF64 { dst, .. }
-                | MicroOp::SubF64 { dst, .. }
-                | MicroOp::MulF64 { dst, .. }
-                | MicroOp::DivF64 { dst, .. }
-                | MicroOp::NegF64 { dst, .. }
-                | MicroOp::CmpF64 { dst, .. }
-                | MicroOp::AddF32 { dst, .. }
-                | MicroOp::SubF32 { dst, .. }
-                | MicroOp::MulF32 { dst, .. }
-                | MicroOp::DivF32 { dst, .. }
-                | MicroOp::NegF32 { dst, .. }
-                | MicroOp::CmpF32 { dst, .. }
-                | MicroOp::F64ConvertI64S { dst, .. }
-                | MicroOp::F64ConvertI32S { dst, .. }
-                | MicroOp::F32ConvertI32S { dst, .. }
-                | MicroOp::F32ConvertI64S { dst, .. }
-                | MicroOp::F32DemoteF64 { dst, .. }
-                | MicroOp::F64PromoteF32 { dst, .. } => {
-                    record(&mut vreg_tags, dst.0, value_tags::TAG_FLOAT);
-                }
-                MicroOp::RefNull { dst } => {
-                    record(&mut vreg_tags, dst.0, value_tags::TAG_NIL);
-                }
-                // Dynamic tag sources: always write the correct shadow tag
-                MicroOp::HeapLoad { dst, .. }
-                | MicroOp::HeapLoadDyn { dst, .. }
-                | MicroOp::HeapLoad2 { dst, .. }
-                | MicroOp::StackPop { dst }
-                | MicroOp::HeapAlloc { dst, .. }
-                | MicroOp::HeapAllocDynSimple { dst, .. }
-                | MicroOp::StringConst { dst, .. } => {
-                    record(&mut vreg_tags, dst.0, u64::MAX);
-                }
-                MicroOp::Call { ret: Some(ret), .. }
-                | MicroOp::CallIndirect { ret: Some(ret), .. } => {
-                    record(&mut vreg_tags, ret.0, u64::MAX);
-                }
-                _ => {}
-            }
+        for (vreg, tag) in ops.iter().filter_map(Self::written_tag) {
+            vreg_tags.entry(vreg).or_default().insert(tag);
         }
 
+        // VRegs with more than one distinct tag type need unconditional updates
         vreg_tags
             .into_iter()
             .filter(|(_, tags)| tags.len() > 1)
@@ -432,6 +630,108 @@ impl MicroOpJitCompiler {
             .collect()
     }
 
+    /// The VReg `op` writes and the tag it writes, for the ops whose tag is
+    /// known. `u64::MAX` stands for a tag only known at runtime.
+    fn written_tag(op: &MicroOp) -> Option<(usize, u64)> {
+        match op {
+            MicroOp::ConstI64 { dst, .. } | MicroOp::ConstI32 { dst, .. } => {
+                Some((dst.0, value_tags::TAG_INT))
+            }
+            MicroOp::ConstF64 { dst, .. } | MicroOp::ConstF32 { dst, .. } => {
+                Some((dst.0, value_tags::TAG_FLOAT))
+            }
+            MicroOp::AddI64 { dst, .. }
+            | MicroOp::SubI64 { dst, .. }
+            | MicroOp::MulI64 { dst, .. }
+            | MicroOp::DivI64 { dst, .. }
+            | MicroOp::RemI64 { dst, .. }
+            | MicroOp::NegI64 { dst, .. }
+            | MicroOp::AddI64Imm { dst, .. }
+            | MicroOp::AndI64 { dst, .. }
+            | MicroOp::OrI64 { dst, .. }
+            | MicroOp::XorI64 { dst, .. }
+            | MicroOp::ShlI64 { dst, .. }
+            | MicroOp::ShlI64Imm { dst, .. }
+            | MicroOp::ShrI64 { dst, .. }
+            | MicroOp::ShrI64Imm { dst, .. }
+            | MicroOp::ShrU64 { dst, .. }
+            | MicroOp::ShrU64Imm { dst, .. }
+            | MicroOp::UMul128Hi { dst, .. }
+            | MicroOp::AddI32 { dst, .. }
+            | MicroOp::SubI32 { dst, .. }
+            | MicroOp::MulI32 { dst, .. }
+            | MicroOp::DivI32 { dst, .. }
+            | MicroOp::RemI32 { dst, .. }
+            | MicroOp::CmpI64 { dst, .. }
+            | MicroOp::CmpI64Imm { dst, .. }
+            | MicroOp::CmpI32 { dst, .. }
+            | MicroOp::EqzI32 { dst, .. }
+            | MicroOp::I64ExtendI32S { dst, .. }
+            | MicroOp::I64ExtendI32U { dst, .. }
+            | MicroOp::I32WrapI64 { dst, .. }
+            | MicroOp::I64TruncF64S { dst, .. }
+            | MicroOp::I32TruncF32S { dst, .. }
+            | MicroOp::I32TruncF64S { dst, .. }
+            | MicroOp::I64TruncF32S { dst, .. }
+            | MicroOp::RefEq { dst, .. }
+            | MicroOp::RefIsNull { dst, .. }
+            | MicroOp::F64ReinterpretAsI64 { dst, .. } => Some((dst.0, value_tags::TAG_INT)),
+            MicroOp::AddF64 { dst, .. }
+            | MicroOp::SubF64 { dst, .. }
+            | MicroOp::MulF64 { dst, .. }
+            | MicroOp::DivF64 { dst, .. }
+            | MicroOp::NegF64 { dst, .. }
+            | MicroOp::CmpF64 { dst, .. }
+            | MicroOp::AddF32 { dst, .. }
+            | MicroOp::SubF32 { dst, .. }
+            | MicroOp::MulF32 { dst, .. }
+            | MicroOp::DivF32 { dst, .. }
+            | MicroOp::NegF32 { dst, .. }
+            | MicroOp::CmpF32 { dst, .. }
+            | MicroOp::F64ConvertI64S { dst, .. }
+            | MicroOp::F64ConvertI32S { dst, .. }
+            | MicroOp::F32ConvertI32S { dst, .. }
+            | MicroOp::F32ConvertI64S { dst, .. }
+            | MicroOp::F32DemoteF64 { dst, .. }
+            | MicroOp::F64PromoteF32 { dst, .. } => Some((dst.0, value_tags::TAG_FLOAT)),
+            MicroOp::RefNull { dst } => Some((dst.0, value_tags::TAG_NIL)),
+            // Dynamic tag sources: always write the correct shadow tag
+            MicroOp::HeapLoad { dst, .. }
+            | MicroOp::HeapLoadDyn { dst, .. }
+            | MicroOp::HeapLoad2 { dst, .. }
+            | MicroOp::StackPop { dst }
+            | MicroOp::HeapAlloc { dst, .. }
+            | MicroOp::HeapAllocDynSimple { dst, .. }
+            | MicroOp::StringConst { dst, .. } => Some((dst.0, u64::MAX)),
+            MicroOp::Call { ret: Some(ret), .. }
+            | MicroOp::CallIndirect { ret: Some(ret), .. }
+            | MicroOp::HeapBulk { dst: Some(ret), .. } => Some((ret.0, u64::MAX)),
+            _ => None,
+        }
+    }
+
+    /// VRegs that can never hold a reference: not typed Ref, and only
+    /// written by ops producing ints or floats. Safepoints leave them out.
+    fn compute_scalar_vregs(ops: &[MicroOp], vreg_types: &[ValueType]) -> HashSet<usize> {
+        let mut scalar: HashSet<usize> = (0..vreg_types.len())
+            .filter(|&v| vreg_types[v] != ValueType::Ref)
+            .collect();
+        for op in ops {
+            match Self::written_tag(op) {
+                Some((_, value_tags::TAG_INT | value_tags::TAG_FLOAT)) => {}
+                Some((vreg, _)) => {
+                    scalar.remove(&vreg);
+                }
+                None => {
+                    if let (_, Some(vreg)) = regalloc::operands(op) {
+                        scalar.remove(&vreg);
+                    }
+                }
+            }
+        }
+        scalar
+    }
+
     /// Check if a shadow tag update is needed for `dst` with `expected_tag`.
     /// Returns `Some(shadow_offset)` if update needed, `None` if already correct.
     fn needs_shadow_update(&self, dst: &VReg, expected_tag: u64) -> Option<u16> {
@@ -467,6 +767,12 @@ impl MicroOpJitCompiler {
         asm.stp_pre(Reg::Fp, Reg::Lr, -16);
         asm.stp_pre(Reg::X19, Reg::X20, -16);
         asm.stp_pre(Reg::X21, Reg::X22, -16);
+        for &(r1, r2) in &self.saved_gpr_pairs {
+            asm.stp_pre(r1, r2, -16);
+        }
+        for &(d1, d2) in &self.saved_fpr_pairs {
+            asm.stp_d_pre(d1, d2, -16);
+        }
         // Set up frame pointer
         asm.add_imm(Reg::Fp, Reg::Sp, 0);
         // x0 = VM_CTX, x1 = frame base (locals/regs array), x2 = unused
@@ -476,6 +782,12 @@ impl MicroOpJitCompiler {
 
     fn emit_epilogue(&mut self) {
         let mut asm = AArch64Assembler::new(&mut self.buf);
+        for &(d1, d2) in self.saved_fpr_pairs.iter().rev() {
+            asm.ldp_d_post(d1, d2, 16);
+        }
+        for &(r1, r2) in self.saved_gpr_pairs.iter().rev() {
+            asm.ldp_post(r1, r2, 16);
+        }
         asm.ldp_post(Reg::X21, Reg::X22, 16);
         asm.ldp_post(Reg::X19, Reg::X20, 16);
         asm.ldp_post(Reg::Fp, Reg::Lr, 16);
@@ -484,8 +796,9 @@ impl MicroOpJitCompiler {
 
     // ==================== MicroOp compilation ====================
 
-    fn compile_microop(&mut self, op: &MicroOp, _pc: usize) -> Result<(), String> {
-        match op {
+    fn compile_microop(&mut self, op: &MicroOp, pc: usize) -> Result<(), String> {
+        let rooted = self.emit_safepoint_entry(op, pc);
+        let result = match op {
             MicroOp::ConstI64 { dst, imm } => self.emit_const_i64(dst, *imm),
             MicroOp::ConstI32 { dst, imm } => self.emit_const_i64(dst, *imm as i64),
             MicroOp::Mov { dst, src } => self.emit_mov(dst, src),
@@ -598,9 +911,9 @@ impl MicroOpJitCompiler {
             MicroOp::RefNull { dst } => self.emit_ref_null(dst),
 
             // Indirect call
-            MicroOp::CallIndirect { callee, args, ret } => {
-                self.emit_call_indirect(callee, args, ret.as_ref())
-            }
+            MicroOp::CallIndirect {
+                callee, args, ret, ..
+            } => self.emit_call_indirect(callee, args, ret.as_ref()),
 
             // String operations
             MicroOp::StringConst { dst, idx } => self.emit_string_const(dst, *idx),
@@ -611,6 +924,7 @@ impl MicroOpJitCompiler {
                 size,
                 elem_kind,
             } => self.emit_heap_alloc_dyn_simple(dst, size, *elem_kind),
+            MicroOp::HeapBulk { dst, op, args } => self.emit_heap_bulk(dst.as_ref(), *op, args),
             // Stack bridge (spill/restore across calls)
             MicroOp::StackPush { src } => self.emit_stack_push(src),
             MicroOp::StackPop { dst } => self.emit_stack_pop(dst),
@@ -619,7 +933,125 @@ impl MicroOpJitCompiler {
                 "Unsupported MicroOp for JIT: {:?}",
                 std::mem::discriminant(op)
             )),
+        };
+        if rooted {
+            self.emit_safepoint_exit();
+        }
+        result
+    }
+
+    // ==================== GC safepoints ====================
+
+    /// JitCallContext offset for the root stack pointer.
+    const GC_ROOTS_OFFSET: u16 = 112;
+
+    /// Whether the VM may collect garbage during `op`: calls, and ops whose
+    /// helper allocates.
+    fn is_gc_safepoint(op: &MicroOp) -> bool {
+        matches!(
+            op,
+            MicroOp::Call { .. }
+                | MicroOp::CallIndirect { .. }
+                | MicroOp::CallDynamic { .. }
+                | MicroOp::StringConst { .. }
+                | MicroOp::HeapAlloc { .. }
+                | MicroOp::HeapAllocDynSimple { .. }
+                | MicroOp::HeapBulk { .. }
+        )
+    }
+
+    /// Record the stack map of the safepoint at `pc` and emit the code that
+    /// copies its values (shadow tag and payload) to the root stack, saving
+    /// the old top on the native stack for `emit_safepoint_exit`. A
+    /// safepoint that does not fit marks the root stack overflowed instead.
+    fn emit_safepoint_entry(&mut self, op: &MicroOp, pc: usize) -> bool {
+        if !Self::is_gc_safepoint(op) {
+            return false;
+        }
+        let roots: Vec<usize> = self
+            .call_live
+            .get(&pc)
+            .into_iter()
+            .flatten()
+            .copied()
+            .filter(|v| !self.scalar_vregs.contains(v))
+            .collect();
+        if roots.is_empty() {
+            return false;
+        }
+        let mut entry = StackMapEntry::new(
+            self.buf.len() as u32,
+            pc as u32,
+            roots.len().min(u16::MAX as usize) as u16,
+            self.self_locals_count.min(u16::MAX as usize) as u16,
+        );
+        entry.frame_refs = roots.iter().map(|&v| v as u32).collect();
+        self.stack_maps.add_entry(entry);
+
+        {
+            // TMP4 = root stack, TMP1 = its top; keep the top for the exit
+            let mut asm = AArch64Assembler::new(&mut self.buf);
+            asm.ldr(regs::TMP4, regs::VM_CTX, Self::GC_ROOTS_OFFSET);
+            asm.ldr(regs::TMP1, regs::TMP4, RootStack::TOP_OFFSET as u16);
+            asm.str_pre(regs::TMP1, Reg::Sp, -16);
         }
+        if roots.len() > MAX_SAFEPOINT_ROOTS {
+            let mut asm = AArch64Assembler::new(&mut self.buf);
+            asm.mov_imm(regs::TMP0, 1);
+            asm.str(regs::TMP0, regs::TMP4, RootStack::OVERFLOWED_OFFSET as u16);
+            return true;
+        }
+
+        // TMP5 = new top; overflow unless it is within the stack
+        {
+            let mut asm = AArch64Assembler::new(&mut self.buf);
+            asm.add_imm(regs::TMP5, regs::TMP1, (roots.len() * 16) as u16);
+            asm.ldr(regs::TMP0, regs::TMP4, RootStack::END_OFFSET as u16);
+            asm.cmp(regs::TMP5, regs::TMP0);
+        }
+        let overflow_site = self.buf.len();
+        AArch64Assembler::new(&mut self.buf).b_cond(Cond::Hi, 0);
+        for (i, &v) in roots.iter().enumerate() {
+            let off = (i * 16) as u16;
+            if self.vreg_types.get(v) == Some(&ValueType::Ref)
+                && !self.shadow_conflict_vregs.contains(&v)
+            {
+                self.emit_load_imm64(value_tags::TAG_PTR as i64, regs::TMP0);
+            } else {
+                let shadow_off = self.shadow_tag_offset(&VReg(v));
+                let mut asm = AArch64Assembler::new(&mut self.buf);
+                asm.ldr(regs::TMP0, regs::FRAME_BASE, shadow_off);
+            }
+            let mut asm = AArch64Assembler::new(&mut self.buf);
+            asm.str(regs::TMP0, regs::TMP1, off);
+            Self::load_vreg(&mut asm, regs::TMP0, &VReg(v), &self.reg_map);
+            asm.str(regs::TMP0, regs::TMP1, off + 8);
+        }
+        AArch64Assembler::new(&mut self.buf).str(
+            regs::TMP5,
+            regs::TMP4,
+            RootStack::TOP_OFFSET as u16,
+        );
+        let done_site = self.buf.len();
+        AArch64Assembler::new(&mut self.buf).b(0);
+        let overflow = self.buf.len();
+        {
+            let mut asm = AArch64Assembler::new(&mut self.buf);
+            asm.mov_imm(regs::TMP0, 1);
+            asm.str(regs::TMP0, regs::TMP4, RootStack::OVERFLOWED_OFFSET as u16);
+        }
+        let done = self.buf.len();
+        self.patch_branch(overflow_site, overflow);
+        self.patch_branch(done_site, done);
+        true
+    }
+
+    /// Put back the root stack top saved by `emit_safepoint_entry`.
+    fn emit_safepoint_exit(&mut self) {
+        let mut asm = AArch64Assembler::new(&mut self.buf);
+        asm.ldr_post(regs::TMP1, Reg::Sp, 16);
+        asm.ldr(regs::TMP4, regs::VM_CTX, Self::GC_ROOTS_OFFSET);
+        asm.str(regs::TMP1, regs::TMP4, RootStack::TOP_OFFSET as u16);
     }
 
     // ==================== Constants ====================
@@ -629,7 +1061,7 @@ impl MicroOpJitCompiler {
         self.emit_load_imm64(imm, regs::TMP0);
         {
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+            Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         }
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -645,10 +1077,16 @@ impl MicroOpJitCompiler {
         }
         let src_shadow_off = self.shadow_tag_offset(src);
         let dst_shadow_off = self.shadow_tag_offset(dst);
+        let map = &self.reg_map;
         let mut asm = AArch64Assembler::new(&mut self.buf);
         // Copy payload
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(src));
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        match (map.fpr.get(&src.0), map.fpr.get(&dst.0)) {
+            (Some(&fs), Some(&fd)) => asm.fmov_d_d(fd, fs),
+            _ => {
+                Self::load_vreg(&mut asm, regs::TMP0, src, map);
+                Self::store_vreg(&mut asm, regs::TMP0, dst, map);
+            }
+        }
         // Copy shadow tag
         asm.ldr(regs::TMP0, regs::FRAME_BASE, src_shadow_off);
         asm.str(regs::TMP0, regs::FRAME_BASE, dst_shadow_off);
@@ -660,8 +1098,8 @@ impl MicroOpJitCompiler {
     fn emit_binop_i64(&mut self, dst: &VReg, a: &VReg, b: &VReg, op: BinOp) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
-        asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b));
+        Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP1, b, &self.reg_map);
         match op {
             BinOp::Add => asm.add(regs::TMP0, regs::TMP0, regs::TMP1),
             BinOp::Sub => asm.sub(regs::TMP0, regs::TMP0, regs::TMP1),
@@ -671,7 +1109,7 @@ impl MicroOpJitCompiler {
             BinOp::Or => asm.orr(regs::TMP0, regs::TMP0, regs::TMP1),
             BinOp::Xor => asm.eor(regs::TMP0, regs::TMP0, regs::TMP1),
         }
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -682,12 +1120,12 @@ impl MicroOpJitCompiler {
     fn emit_rem_i64(&mut self, dst: &VReg, a: &VReg, b: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
-        asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b));
+        Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP1, b, &self.reg_map);
         asm.sdiv(regs::TMP2, regs::TMP0, regs::TMP1);
         asm.mul(regs::TMP2, regs::TMP2, regs::TMP1);
         asm.sub(regs::TMP0, regs::TMP0, regs::TMP2);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -698,14 +1136,14 @@ impl MicroOpJitCompiler {
     fn emit_neg_i64(&mut self, dst: &VReg, src: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(src));
+        Self::load_vreg(&mut asm, regs::TMP0, src, &self.reg_map);
         // NEG Xd, Xm  →  SUB Xd, XZR, Xm
         let inst = 0xCB000000
             | ((regs::TMP0.code() as u32) << 16)
             | (31 << 5)
             | (regs::TMP0.code() as u32);
         asm.emit_raw(inst);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -716,10 +1154,10 @@ impl MicroOpJitCompiler {
     fn emit_shl_i64(&mut self, dst: &VReg, a: &VReg, b: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
-        asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b));
+        Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP1, b, &self.reg_map);
         asm.lslv(regs::TMP0, regs::TMP0, regs::TMP1);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -730,9 +1168,9 @@ impl MicroOpJitCompiler {
     fn emit_shl_i64_imm(&mut self, dst: &VReg, a: &VReg, imm: i64) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
+        Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
         asm.lsl_imm(regs::TMP0, regs::TMP0, (imm as u8) & 63);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -743,10 +1181,10 @@ impl MicroOpJitCompiler {
     fn emit_shr_i64(&mut self, dst: &VReg, a: &VReg, b: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
-        asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b));
+        Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP1, b, &self.reg_map);
         asm.asrv(regs::TMP0, regs::TMP0, regs::TMP1);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -757,7 +1195,7 @@ impl MicroOpJitCompiler {
     fn emit_shr_i64_imm(&mut self, dst: &VReg, a: &VReg, imm: i64) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
+        Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
         // ASR Xd, Xn, #shift → SBFM Xd, Xn, #shift, #63
         let shift = (imm as u32) & 63;
         let inst = 0x9340FC00
@@ -765,7 +1203,7 @@ impl MicroOpJitCompiler {
             | ((regs::TMP0.code() as u32) << 5)
             | (regs::TMP0.code() as u32);
         asm.emit_raw(inst);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -776,10 +1214,10 @@ impl MicroOpJitCompiler {
     fn emit_shr_u64(&mut self, dst: &VReg, a: &VReg, b: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
-        asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b));
+        Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP1, b, &self.reg_map);
         asm.lsrv(regs::TMP0, regs::TMP0, regs::TMP1);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -790,9 +1228,9 @@ impl MicroOpJitCompiler {
     fn emit_shr_u64_imm(&mut self, dst: &VReg, a: &VReg, imm: i64) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
+        Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
         asm.lsr_imm(regs::TMP0, regs::TMP0, (imm as u8) & 63);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -803,10 +1241,10 @@ impl MicroOpJitCompiler {
     fn emit_umul128_hi(&mut self, dst: &VReg, a: &VReg, b: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
-        asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b));
+        Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP1, b, &self.reg_map);
         asm.umulh(regs::TMP0, regs::TMP0, regs::TMP1);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -818,7 +1256,7 @@ impl MicroOpJitCompiler {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         {
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
+            Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
         }
 
         if imm >= 0 && imm <= 4095 {
@@ -835,7 +1273,7 @@ impl MicroOpJitCompiler {
 
         {
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+            Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         }
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -871,12 +1309,12 @@ impl MicroOpJitCompiler {
         let aarch64_cond = Self::cmp_cond_to_aarch64(cond);
         let inv = Self::invert_cond(aarch64_cond);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
-        asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b));
+        Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP1, b, &self.reg_map);
         asm.cmp(regs::TMP0, regs::TMP1);
         let inst = 0x9A9F07E0 | ((inv as u32) << 12) | (regs::TMP0.code() as u32);
         asm.emit_raw(inst);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -897,7 +1335,7 @@ impl MicroOpJitCompiler {
 
         {
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
+            Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
         }
 
         if imm >= 0 && imm <= 4095 {
@@ -913,7 +1351,7 @@ impl MicroOpJitCompiler {
             let mut asm = AArch64Assembler::new(&mut self.buf);
             let inst = 0x9A9F07E0 | ((inv as u32) << 12) | (regs::TMP0.code() as u32);
             asm.emit_raw(inst);
-            asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+            Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         }
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -925,7 +1363,7 @@ impl MicroOpJitCompiler {
 
     fn emit_br_if_false(&mut self, cond: &VReg, target: usize) -> Result<(), String> {
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(cond));
+        Self::load_vreg(&mut asm, regs::TMP0, cond, &self.reg_map);
         drop(asm);
 
         let current = self.buf.len();
@@ -937,7 +1375,7 @@ impl MicroOpJitCompiler {
 
     fn emit_br_if(&mut self, cond: &VReg, target: usize) -> Result<(), String> {
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(cond));
+        Self::load_vreg(&mut asm, regs::TMP0, cond, &self.reg_map);
         drop(asm);
 
         let current = self.buf.len();
@@ -1029,14 +1467,14 @@ impl MicroOpJitCompiler {
         // Load a
         {
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
+            Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
         }
 
         // Load b / immediate and compare
         match b {
             CmpOperand::Reg(b_vreg) => {
                 let mut asm = AArch64Assembler::new(&mut self.buf);
-                asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b_vreg));
+                Self::load_vreg(&mut asm, regs::TMP1, b_vreg, &self.reg_map);
                 asm.cmp(regs::TMP0, regs::TMP1);
             }
             CmpOperand::Imm(imm) => {
@@ -1148,7 +1586,7 @@ impl MicroOpJitCompiler {
             let arg = &args[i];
             let new_offset = (i * 8) as u16 + 16;
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(arg));
+            Self::load_vreg(&mut asm, regs::TMP0, arg, &self.reg_map);
             asm.str(regs::TMP0, Reg::Sp, new_offset);
         }
 
@@ -1184,7 +1622,7 @@ impl MicroOpJitCompiler {
         if let Some(ret_vreg) = ret {
             let ret_shadow_off = self.shadow_tag_offset(ret_vreg);
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.str(Reg::X1, regs::FRAME_BASE, Self::vreg_offset(ret_vreg));
+            Self::store_vreg(&mut asm, Reg::X1, ret_vreg, &self.reg_map);
             asm.str(Reg::X0, regs::FRAME_BASE, ret_shadow_off);
         }
 
@@ -1216,7 +1654,7 @@ impl MicroOpJitCompiler {
                 let mut asm = AArch64Assembler::new(&mut self.buf);
                 asm.ldr(regs::TMP0, regs::FRAME_BASE, shadow_off);
                 asm.str(regs::TMP0, Reg::Sp, sp_tag_offset);
-                asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(arg));
+                Self::load_vreg(&mut asm, regs::TMP0, arg, &self.reg_map);
                 asm.str(regs::TMP0, Reg::Sp, sp_payload_offset);
             }
         }
@@ -1265,7 +1703,7 @@ impl MicroOpJitCompiler {
         if let Some(ret_vreg) = ret {
             let ret_shadow_off = self.shadow_tag_offset(ret_vreg);
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.str(Reg::X1, regs::FRAME_BASE, Self::vreg_offset(ret_vreg));
+            Self::store_vreg(&mut asm, Reg::X1, ret_vreg, &self.reg_map);
             asm.str(Reg::X0, regs::FRAME_BASE, ret_shadow_off);
         }
 
@@ -1320,7 +1758,7 @@ impl MicroOpJitCompiler {
             let arg = &args[i];
             let new_offset = (i * 8) as u16;
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(arg));
+            Self::load_vreg(&mut asm, regs::TMP0, arg, &self.reg_map);
             asm.str(regs::TMP0, Reg::Sp, new_offset);
         }
 
@@ -1357,7 +1795,7 @@ impl MicroOpJitCompiler {
         if let Some(ret_vreg) = ret {
             let ret_shadow_off = self.shadow_tag_offset(ret_vreg);
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.str(Reg::X1, regs::FRAME_BASE, Self::vreg_offset(ret_vreg));
+            Self::store_vreg(&mut asm, Reg::X1, ret_vreg, &self.reg_map);
             asm.str(Reg::X0, regs::FRAME_BASE, ret_shadow_off);
         }
 
@@ -1377,7 +1815,7 @@ impl MicroOpJitCompiler {
         // Step 1: Resolve func_index from callee's heap object slot 0.
         {
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(callee));
+            Self::load_vreg(&mut asm, regs::TMP0, callee, &self.reg_map);
             asm.ldr(regs::TMP1, regs::VM_CTX, 48); // heap_base
             asm.add(regs::TMP1, regs::TMP1, regs::TMP0); // heap_base + ref_bytes
             // slot 0 payload at +16 (header 8B + tag 8B)
@@ -1402,7 +1840,7 @@ impl MicroOpJitCompiler {
                 let mut asm = AArch64Assembler::new(&mut self.buf);
                 asm.ldr(regs::TMP0, regs::FRAME_BASE, shadow_off);
                 asm.str(regs::TMP0, Reg::Sp, sp_tag_offset);
-                asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(arg));
+                Self::load_vreg(&mut asm, regs::TMP0, arg, &self.reg_map);
                 asm.str(regs::TMP0, Reg::Sp, sp_payload_offset);
             }
         }
@@ -1450,7 +1888,7 @@ impl MicroOpJitCompiler {
         if let Some(ret_vreg) = ret {
             let ret_shadow_off = self.shadow_tag_offset(ret_vreg);
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.str(Reg::X1, regs::FRAME_BASE, Self::vreg_offset(ret_vreg));
+            Self::store_vreg(&mut asm, Reg::X1, ret_vreg, &self.reg_map);
             asm.str(Reg::X0, regs::FRAME_BASE, ret_shadow_off);
         }
 
@@ -1465,7 +1903,7 @@ impl MicroOpJitCompiler {
             let shadow_off = self.shadow_tag_offset(vreg);
             let mut asm = AArch64Assembler::new(&mut self.buf);
             asm.ldr(Reg::X0, regs::FRAME_BASE, shadow_off);
-            asm.ldr(Reg::X1, regs::FRAME_BASE, Self::vreg_offset(vreg));
+            Self::load_vreg(&mut asm, Reg::X1, vreg, &self.reg_map);
         } else {
             let mut asm = AArch64Assembler::new(&mut self.buf);
             asm.mov_imm(Reg::X0, value_tags::TAG_NIL as u16);
@@ -1473,11 +1911,7 @@ impl MicroOpJitCompiler {
         }
 
         // Inline epilogue
-        let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldp_post(Reg::X21, Reg::X22, 16);
-        asm.ldp_post(Reg::X19, Reg::X20, 16);
-        asm.ldp_post(Reg::Fp, Reg::Lr, 16);
-        asm.ret();
+        self.emit_epilogue();
 
         Ok(())
     }
@@ -1489,7 +1923,7 @@ impl MicroOpJitCompiler {
         self.emit_load_imm64(imm.to_bits() as i64, regs::TMP0);
         {
             let mut asm = AArch64Assembler::new(&mut self.buf);
-            asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+            Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         }
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_FLOAT);
@@ -1505,19 +1939,19 @@ impl MicroOpJitCompiler {
         op: FpBinOp,
     ) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_FLOAT);
+        let map = &self.reg_map;
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
-        asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b));
-        asm.fmov_d_x(0, regs::TMP0);
-        asm.fmov_d_x(1, regs::TMP1);
+        // Three-operand FP ops: compute straight into dst's register
+        let fa = Self::load_vreg_d(&mut asm, 0, regs::TMP0, a, map);
+        let fb = Self::load_vreg_d(&mut asm, 1, regs::TMP1, b, map);
+        let fd = Self::dst_vreg_d(dst, 0, map);
         match op {
-            FpBinOp::Add => asm.fadd_d(0, 0, 1),
-            FpBinOp::Sub => asm.fsub_d(0, 0, 1),
-            FpBinOp::Mul => asm.fmul_d(0, 0, 1),
-            FpBinOp::Div => asm.fdiv_d(0, 0, 1),
+            FpBinOp::Add => asm.fadd_d(fd, fa, fb),
+            FpBinOp::Sub => asm.fsub_d(fd, fa, fb),
+            FpBinOp::Mul => asm.fmul_d(fd, fa, fb),
+            FpBinOp::Div => asm.fdiv_d(fd, fa, fb),
         }
-        asm.fmov_x_d(regs::TMP0, 0);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg_d(&mut asm, fd, regs::TMP0, dst, map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_FLOAT);
@@ -1527,12 +1961,12 @@ impl MicroOpJitCompiler {
 
     fn emit_neg_f64(&mut self, dst: &VReg, src: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_FLOAT);
+        let map = &self.reg_map;
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(src));
-        asm.fmov_d_x(0, regs::TMP0);
-        asm.fneg_d(0, 0);
-        asm.fmov_x_d(regs::TMP0, 0);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        let fs = Self::load_vreg_d(&mut asm, 0, regs::TMP0, src, map);
+        let fd = Self::dst_vreg_d(dst, 0, map);
+        asm.fneg_d(fd, fs);
+        Self::store_vreg_d(&mut asm, fd, regs::TMP0, dst, map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_FLOAT);
@@ -1566,15 +2000,14 @@ impl MicroOpJitCompiler {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let aarch64_cond = Self::fp_cmp_cond_to_aarch64(cond);
         let inv = Self::invert_cond(aarch64_cond);
+        let map = &self.reg_map;
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
-        asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b));
-        asm.fmov_d_x(0, regs::TMP0);
-        asm.fmov_d_x(1, regs::TMP1);
-        asm.fcmp_d(0, 1);
+        let fa = Self::load_vreg_d(&mut asm, 0, regs::TMP0, a, map);
+        let fb = Self::load_vreg_d(&mut asm, 1, regs::TMP1, b, map);
+        asm.fcmp_d(fa, fb);
         let inst = 0x9A9F07E0 | ((inv as u32) << 12) | (regs::TMP0.code() as u32);
         asm.emit_raw(inst);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -1587,12 +2020,12 @@ impl MicroOpJitCompiler {
     fn emit_eqz(&mut self, dst: &VReg, src: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(src));
+        Self::load_vreg(&mut asm, regs::TMP0, src, &self.reg_map);
         asm.cmp_imm(regs::TMP0, 0);
         let inv = Cond::Ne;
         let inst = 0x9A9F07E0 | ((inv as u32) << 12) | (regs::TMP0.code() as u32);
         asm.emit_raw(inst);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -1606,7 +2039,7 @@ impl MicroOpJitCompiler {
     fn emit_i64_extend_i32s(&mut self, dst: &VReg, src: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(src));
+        Self::load_vreg(&mut asm, regs::TMP0, src, &self.reg_map);
         // SXTW X0, W0: SBFM X0, X0, #0, #31
         let inst = 0x93400000
             | (31 << 10)
@@ -1614,7 +2047,7 @@ impl MicroOpJitCompiler {
             | ((regs::TMP0.code() as u32) << 5)
             | (regs::TMP0.code() as u32);
         asm.emit_raw(inst);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -1626,7 +2059,7 @@ impl MicroOpJitCompiler {
     fn emit_i64_extend_i32u(&mut self, dst: &VReg, src: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(src));
+        Self::load_vreg(&mut asm, regs::TMP0, src, &self.reg_map);
         // UBFM Xd, Xn, #0, #31 (UXTW)
         let inst = 0xD3400000
             | (31 << 10)
@@ -1634,7 +2067,7 @@ impl MicroOpJitCompiler {
             | ((regs::TMP0.code() as u32) << 5)
             | (regs::TMP0.code() as u32);
         asm.emit_raw(inst);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -1645,11 +2078,12 @@ impl MicroOpJitCompiler {
     /// Convert signed i64 to f64: SCVTF Dd, Xn
     fn emit_f64_convert_i64s(&mut self, dst: &VReg, src: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_FLOAT);
+        let map = &self.reg_map;
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(src));
-        asm.scvtf_d_x(0, regs::TMP0);
-        asm.fmov_x_d(regs::TMP0, 0);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::load_vreg(&mut asm, regs::TMP0, src, map);
+        let fd = Self::dst_vreg_d(dst, 0, map);
+        asm.scvtf_d_x(fd, regs::TMP0);
+        Self::store_vreg_d(&mut asm, fd, regs::TMP0, dst, map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_FLOAT);
@@ -1660,13 +2094,13 @@ impl MicroOpJitCompiler {
     /// Truncate f64 to signed i64: FCVTZS Xd, Dn
     fn emit_i64_trunc_f64s(&mut self, dst: &VReg, src: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
+        let map = &self.reg_map;
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(src));
-        asm.fmov_d_x(0, regs::TMP0);
-        // FCVTZS X0, D0
-        let inst = 0x9E780000 | ((0u32) << 5) | (regs::TMP0.code() as u32);
+        let fs = Self::load_vreg_d(&mut asm, 0, regs::TMP0, src, map);
+        // FCVTZS X0, Dn
+        let inst = 0x9E780000 | ((fs as u32) << 5) | (regs::TMP0.code() as u32);
         asm.emit_raw(inst);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -1680,13 +2114,13 @@ impl MicroOpJitCompiler {
     fn emit_ref_eq(&mut self, dst: &VReg, a: &VReg, b: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(a));
-        asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b));
+        Self::load_vreg(&mut asm, regs::TMP0, a, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP1, b, &self.reg_map);
         asm.cmp(regs::TMP0, regs::TMP1);
         let inv = Cond::Ne;
         let inst = 0x9A9F07E0 | ((inv as u32) << 12) | (regs::TMP0.code() as u32);
         asm.emit_raw(inst);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -1699,12 +2133,12 @@ impl MicroOpJitCompiler {
     fn emit_ref_is_null(&mut self, dst: &VReg, src: &VReg) -> Result<(), String> {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(src));
+        Self::load_vreg(&mut asm, regs::TMP0, src, &self.reg_map);
         asm.cmp_imm(regs::TMP0, 0);
         let inv = Cond::Ne;
         let inst = 0x9A9F07E0 | ((inv as u32) << 12) | (regs::TMP0.code() as u32);
         asm.emit_raw(inst);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_INT);
@@ -1717,7 +2151,7 @@ impl MicroOpJitCompiler {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_NIL);
         let mut asm = AArch64Assembler::new(&mut self.buf);
         asm.mov_imm(regs::TMP0, 0);
-        asm.str(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP0, dst, &self.reg_map);
         drop(asm);
         if let Some(off) = shadow {
             self.emit_shadow_update(off, value_tags::TAG_NIL);
@@ -1732,7 +2166,7 @@ impl MicroOpJitCompiler {
     fn emit_heap_load(&mut self, dst: &VReg, src: &VReg, offset: usize) -> Result<(), String> {
         let shadow_off = self.shadow_tag_offset(dst);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(src));
+        Self::load_vreg(&mut asm, regs::TMP0, src, &self.reg_map);
         asm.ldr(regs::TMP1, regs::VM_CTX, 48); // heap_base
         // TMP1 = heap_base + ref_bytes
         asm.add(regs::TMP1, regs::TMP1, regs::TMP0);
@@ -1741,7 +2175,7 @@ impl MicroOpJitCompiler {
         asm.ldr(regs::TMP0, regs::TMP1, tag_disp); // tag
         asm.ldr(regs::TMP2, regs::TMP1, tag_disp + 8); // payload
         // Store payload to frame, tag to shadow
-        asm.str(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP2, dst, &self.reg_map);
         asm.str(regs::TMP0, regs::FRAME_BASE, shadow_off);
         Ok(())
     }
@@ -1760,8 +2194,8 @@ impl MicroOpJitCompiler {
     ) -> Result<(), String> {
         let shadow_off = self.shadow_tag_offset(dst);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(idx));
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(obj));
+        Self::load_vreg(&mut asm, regs::TMP2, idx, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP0, obj, &self.reg_map);
         asm.ldr(regs::TMP1, regs::VM_CTX, 48);
         // TMP1 = heap_base + ref_bytes
         asm.add(regs::TMP1, regs::TMP1, regs::TMP0);
@@ -1771,7 +2205,7 @@ impl MicroOpJitCompiler {
                 asm.add_imm(regs::TMP2, regs::TMP2, 8); // idx + 8 (skip header)
                 asm.add(regs::TMP1, regs::TMP1, regs::TMP2);
                 asm.ldrb(regs::TMP2, regs::TMP1, 0);
-                asm.str(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(dst));
+                Self::store_vreg(&mut asm, regs::TMP2, dst, &self.reg_map);
                 asm.mov_imm(regs::TMP0, Self::elem_kind_to_tag(elem_kind) as u16);
                 asm.str(regs::TMP0, regs::FRAME_BASE, shadow_off);
             }
@@ -1781,7 +2215,7 @@ impl MicroOpJitCompiler {
                 asm.add_imm(regs::TMP2, regs::TMP2, 8); // + 8 (skip header)
                 asm.add(regs::TMP1, regs::TMP1, regs::TMP2);
                 asm.ldr(regs::TMP2, regs::TMP1, 0);
-                asm.str(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(dst));
+                Self::store_vreg(&mut asm, regs::TMP2, dst, &self.reg_map);
                 asm.mov_imm(regs::TMP0, Self::elem_kind_to_tag(elem_kind) as u16);
                 asm.str(regs::TMP0, regs::FRAME_BASE, shadow_off);
             }
@@ -1792,7 +2226,7 @@ impl MicroOpJitCompiler {
                 asm.add(regs::TMP1, regs::TMP1, regs::TMP2);
                 asm.ldr(regs::TMP0, regs::TMP1, 0); // tag
                 asm.ldr(regs::TMP2, regs::TMP1, 8); // payload
-                asm.str(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(dst));
+                Self::store_vreg(&mut asm, regs::TMP2, dst, &self.reg_map);
                 asm.str(regs::TMP0, regs::FRAME_BASE, shadow_off);
             }
         }
@@ -1806,9 +2240,9 @@ impl MicroOpJitCompiler {
         let mut asm = AArch64Assembler::new(&mut self.buf);
         // TMP2 = tag (from shadow), TMP3 = payload
         asm.ldr(regs::TMP2, regs::FRAME_BASE, shadow_off);
-        asm.ldr(regs::TMP3, regs::FRAME_BASE, Self::vreg_offset(src));
+        Self::load_vreg(&mut asm, regs::TMP3, src, &self.reg_map);
         // TMP0 = ref payload (byte offset)
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(dst_obj));
+        Self::load_vreg(&mut asm, regs::TMP0, dst_obj, &self.reg_map);
         // TMP1 = heap_base
         asm.ldr(regs::TMP1, regs::VM_CTX, 48);
         // TMP1 = heap_base + ref_bytes
@@ -1837,9 +2271,9 @@ impl MicroOpJitCompiler {
         match elem_kind {
             ElemKind::U8 => {
                 // U8: store low byte only
-                asm.ldr(regs::TMP5, regs::FRAME_BASE, Self::vreg_offset(src));
-                asm.ldr(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(idx));
-                asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(obj));
+                Self::load_vreg(&mut asm, regs::TMP5, src, &self.reg_map);
+                Self::load_vreg(&mut asm, regs::TMP2, idx, &self.reg_map);
+                Self::load_vreg(&mut asm, regs::TMP0, obj, &self.reg_map);
                 asm.ldr(regs::TMP1, regs::VM_CTX, 48);
                 asm.add(regs::TMP1, regs::TMP1, regs::TMP0);
                 asm.add_imm(regs::TMP2, regs::TMP2, 8); // idx + 8 (skip header)
@@ -1848,9 +2282,9 @@ impl MicroOpJitCompiler {
             }
             ElemKind::I64 | ElemKind::F64 | ElemKind::Ref => {
                 // Typed 8B: only payload, no tag
-                asm.ldr(regs::TMP5, regs::FRAME_BASE, Self::vreg_offset(src));
-                asm.ldr(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(idx));
-                asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(obj));
+                Self::load_vreg(&mut asm, regs::TMP5, src, &self.reg_map);
+                Self::load_vreg(&mut asm, regs::TMP2, idx, &self.reg_map);
+                Self::load_vreg(&mut asm, regs::TMP0, obj, &self.reg_map);
                 asm.ldr(regs::TMP1, regs::VM_CTX, 48);
                 asm.add(regs::TMP1, regs::TMP1, regs::TMP0);
                 asm.lsl_imm(regs::TMP2, regs::TMP2, 3); // idx * 8
@@ -1861,9 +2295,9 @@ impl MicroOpJitCompiler {
             ElemKind::Tagged => {
                 // Tagged: tag+payload, 16B stride
                 asm.ldr(regs::TMP4, regs::FRAME_BASE, shadow_off);
-                asm.ldr(regs::TMP5, regs::FRAME_BASE, Self::vreg_offset(src));
-                asm.ldr(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(idx));
-                asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(obj));
+                Self::load_vreg(&mut asm, regs::TMP5, src, &self.reg_map);
+                Self::load_vreg(&mut asm, regs::TMP2, idx, &self.reg_map);
+                Self::load_vreg(&mut asm, regs::TMP0, obj, &self.reg_map);
                 asm.ldr(regs::TMP1, regs::VM_CTX, 48);
                 asm.add(regs::TMP1, regs::TMP1, regs::TMP0);
                 asm.lsl_imm(regs::TMP2, regs::TMP2, 4); // idx * 16
@@ -1900,8 +2334,8 @@ impl MicroOpJitCompiler {
     ) -> Result<(), String> {
         let shadow_off = self.shadow_tag_offset(dst);
         let mut asm = AArch64Assembler::new(&mut self.buf);
-        asm.ldr(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(idx));
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(obj));
+        Self::load_vreg(&mut asm, regs::TMP2, idx, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP0, obj, &self.reg_map);
         asm.ldr(regs::TMP1, regs::VM_CTX, 48);
 
         // Step 1: load slot 0 of outer object → inner ref payload (always Tagged)
@@ -1915,7 +2349,7 @@ impl MicroOpJitCompiler {
                 asm.add_imm(regs::TMP2, regs::TMP2, 8);
                 asm.add(regs::TMP0, regs::TMP0, regs::TMP2);
                 asm.ldrb(regs::TMP2, regs::TMP0, 0);
-                asm.str(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(dst));
+                Self::store_vreg(&mut asm, regs::TMP2, dst, &self.reg_map);
                 asm.mov_imm(regs::TMP0, Self::elem_kind_to_tag(elem_kind) as u16);
                 asm.str(regs::TMP0, regs::FRAME_BASE, shadow_off);
             }
@@ -1925,7 +2359,7 @@ impl MicroOpJitCompiler {
                 asm.add_imm(regs::TMP2, regs::TMP2, 8);
                 asm.add(regs::TMP0, regs::TMP0, regs::TMP2);
                 asm.ldr(regs::TMP2, regs::TMP0, 0);
-                asm.str(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(dst));
+                Self::store_vreg(&mut asm, regs::TMP2, dst, &self.reg_map);
                 asm.mov_imm(regs::TMP0, Self::elem_kind_to_tag(elem_kind) as u16);
                 asm.str(regs::TMP0, regs::FRAME_BASE, shadow_off);
             }
@@ -1936,7 +2370,7 @@ impl MicroOpJitCompiler {
                 asm.add(regs::TMP0, regs::TMP0, regs::TMP2);
                 asm.ldr(regs::TMP1, regs::TMP0, 0);
                 asm.ldr(regs::TMP2, regs::TMP0, 8);
-                asm.str(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(dst));
+                Self::store_vreg(&mut asm, regs::TMP2, dst, &self.reg_map);
                 asm.str(regs::TMP1, regs::FRAME_BASE, shadow_off);
             }
         }
@@ -1955,11 +2389,12 @@ impl MicroOpJitCompiler {
         src: &VReg,
         elem_kind: ElemKind,
     ) -> Result<(), String> {
+        let src_shadow_off = self.shadow_tag_offset(src);
         let mut asm = AArch64Assembler::new(&mut self.buf);
         // TMP5 = payload
-        asm.ldr(regs::TMP5, regs::FRAME_BASE, Self::vreg_offset(src));
-        asm.ldr(regs::TMP2, regs::FRAME_BASE, Self::vreg_offset(idx));
-        asm.ldr(regs::TMP0, regs::FRAME_BASE, Self::vreg_offset(obj));
+        Self::load_vreg(&mut asm, regs::TMP5, src, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP2, idx, &self.reg_map);
+        Self::load_vreg(&mut asm, regs::TMP0, obj, &self.reg_map);
         asm.ldr(regs::TMP1, regs::VM_CTX, 48);
 
         // Step 1: load slot 0 of outer object → inner ref payload (always Tagged)
@@ -1982,8 +2417,7 @@ impl MicroOpJitCompiler {
                 asm.str(regs::TMP5, regs::TMP0, 0);
             }
             ElemKind::Tagged => {
-                let shadow_off = self.shadow_tag_offset(src);
-                asm.ldr(regs::TMP4, regs::FRAME_BASE, shadow_off);
+                asm.ldr(regs::TMP4, regs::FRAME_BASE, src_shadow_off);
                 asm.add(regs::TMP0, regs::TMP0, regs::TMP1);
                 asm.lsl_imm(regs::TMP2, regs::TMP2, 4);
                 asm.add_imm(regs::TMP2, regs::TMP2, 8);
@@ -2031,7 +2465,7 @@ impl MicroOpJitCompiler {
             // TMP1 = cached GcRef.index (offset 8 from entry)
             asm.ldr(regs::TMP1, regs::TMP0, 8);
             // Store payload to frame
-            asm.str(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(dst));
+            Self::store_vreg(&mut asm, regs::TMP1, dst, &self.reg_map);
         }
         // Write TAG_PTR to shadow
         self.emit_shadow_update(shadow_off, value_tags::TAG_PTR);
@@ -2076,7 +2510,7 @@ impl MicroOpJitCompiler {
             asm.ldp_post(regs::VM_CTX, regs::FRAME_BASE, 16);
             // Result: X0=tag, X1=payload
             // Store payload to frame, tag to shadow
-            asm.str(Reg::X1, regs::FRAME_BASE, Self::vreg_offset(dst));
+            Self::store_vreg(&mut asm, Reg::X1, dst, &self.reg_map);
             asm.str(Reg::X0, regs::FRAME_BASE, shadow_off);
         }
 
@@ -2107,13 +2541,64 @@ impl MicroOpJitCompiler {
             let mut asm = AArch64Assembler::new(&mut self.buf);
             asm.stp_pre(regs::VM_CTX, regs::FRAME_BASE, -16);
             asm.mov(Reg::X0, regs::VM_CTX);
-            asm.ldr(Reg::X1, regs::FRAME_BASE, Self::vreg_offset(size));
+            Self::load_vreg(&mut asm, Reg::X1, size, &self.reg_map);
             asm.mov_imm(Reg::X2, elem_kind as u8 as u16);
             asm.ldr(regs::TMP4, regs::VM_CTX, 72);
             asm.blr(regs::TMP4);
             asm.ldp_post(regs::VM_CTX, regs::FRAME_BASE, 16);
             // Store payload to frame, tag to shadow
-            asm.str(Reg::X1, regs::FRAME_BASE, Self::vreg_offset(dst));
+            Self::store_vreg(&mut asm, Reg::X1, dst, &self.reg_map);
+            asm.str(Reg::X0, regs::FRAME_BASE, dst_shadow_off);
+        }
+        Ok(())
+    }
+
+    /// Emit HeapBulk: call heap_bulk_helper(ctx, op, argc, args_ptr) with
+    /// the operands as 16B JitValues (tags from the shadow area).
+    fn emit_heap_bulk(
+        &mut self,
+        dst: Option<&VReg>,
+        op: BulkOp,
+        args: &[VReg],
+    ) -> Result<(), String> {
+        let argc = args.len();
+        let args_aligned = (argc * 16 + 15) & !15;
+        {
+            let mut asm = AArch64Assembler::new(&mut self.buf);
+            asm.sub_imm(Reg::Sp, Reg::Sp, args_aligned as u16);
+        }
+        for (i, arg) in args.iter().enumerate() {
+            let sp_tag_offset = (i * 16) as u16;
+            let shadow_off = self.shadow_tag_offset(arg);
+            let mut asm = AArch64Assembler::new(&mut self.buf);
+            // Arrays and ints are tagged statically; only a fill or find
+            // value needs its shadow tag
+            match op.operand(i) {
+                Operand::Array => asm.mov_imm(regs::TMP0, value_tags::TAG_PTR as u16),
+                Operand::Int => asm.mov_imm(regs::TMP0, value_tags::TAG_INT as u16),
+                Operand::Value => asm.ldr(regs::TMP0, regs::FRAME_BASE, shadow_off),
+            }
+            asm.str(regs::TMP0, Reg::Sp, sp_tag_offset);
+            Self::load_vreg(&mut asm, regs::TMP0, arg, &self.reg_map);
+            asm.str(regs::TMP0, Reg::Sp, sp_tag_offset + 8);
+        }
+        {
+            let mut asm = AArch64Assembler::new(&mut self.buf);
+            asm.stp_pre(regs::VM_CTX, regs::FRAME_BASE, -16);
+            // x0=ctx, x1=op, x2=argc, x3=args_ptr (above the saved pair)
+            asm.mov(Reg::X0, regs::VM_CTX);
+            asm.mov_imm(Reg::X1, op as u8 as u16);
+            asm.mov_imm(Reg::X2, argc as u16);
+            asm.add_imm(Reg::X3, Reg::Sp, 16);
+            asm.ldr(regs::TMP4, regs::VM_CTX, 104);
+            asm.blr(regs::TMP4);
+            asm.ldp_post(regs::VM_CTX, regs::FRAME_BASE, 16);
+            asm.add_imm(Reg::Sp, Reg::Sp, args_aligned as u16);
+        }
+        if let Some(dst) = dst {
+            let dst_shadow_off = self.shadow_tag_offset(dst);
+            let mut asm = AArch64Assembler::new(&mut self.buf);
+            Self::store_vreg(&mut asm, Reg::X1, dst, &self.reg_map);
             asm.str(Reg::X0, regs::FRAME_BASE, dst_shadow_off);
         }
         Ok(())
@@ -2135,7 +2620,7 @@ impl MicroOpJitCompiler {
             asm.blr(regs::TMP4);
             asm.ldp_post(regs::VM_CTX, regs::FRAME_BASE, 16);
             // Store payload to frame, tag to shadow
-            asm.str(Reg::X1, regs::FRAME_BASE, Self::vreg_offset(dst));
+            Self::store_vreg(&mut asm, Reg::X1, dst, &self.reg_map);
             asm.str(Reg::X0, regs::FRAME_BASE, dst_shadow_off);
         }
         // 2. Store each arg into the allocated object's slots
@@ -2154,7 +2639,7 @@ impl MicroOpJitCompiler {
         let mut asm = AArch64Assembler::new(&mut self.buf);
         // TMP0 = tag from shadow, TMP1 = payload
         asm.ldr(regs::TMP0, regs::FRAME_BASE, shadow_off);
-        asm.ldr(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(src));
+        Self::load_vreg(&mut asm, regs::TMP1, src, &self.reg_map);
         // Push tag+payload pair
         asm.stp_pre(regs::TMP0, regs::TMP1, -16);
         Ok(())
@@ -2168,7 +2653,7 @@ impl MicroOpJitCompiler {
         // Pop pair (tag at lower, payload at higher)
         asm.ldp_post(regs::TMP0, regs::TMP1, 16);
         // Store payload to frame, tag to shadow
-        asm.str(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(dst));
+        Self::store_vreg(&mut asm, regs::TMP1, dst, &self.reg_map);
         asm.str(regs::TMP0, regs::FRAME_BASE, shadow_off);
         Ok(())
     }
@@ -2301,20 +2786,6 @@ impl MicroOpJitCompiler {
         })
     }
 
-    /// Try to compile a loop with register pinning.
-    /// Returns None if not applicable, Some(Ok(())) if successful.
-    fn try_compile_pinned_loop(
-        &mut self,
-        ops: &[MicroOp],
-        loop_start: usize,
-        loop_end: usize,
-        epilogue_label: usize,
-    ) -> Option<Result<(), String>> {
-        let info = self.analyze_for_pinning(ops, loop_start, loop_end)?;
-
-        Some(self.emit_pinned_loop(ops, loop_start, loop_end, epilogue_label, &info))
-    }
-
     /// Emit the full pinned loop: pre-loop loads, loop body, post-loop writeback.
     fn emit_pinned_loop(
         &mut self,
@@ -2681,44 +3152,50 @@ impl MicroOpJitCompiler {
 
     /// Patch all forward jump references with resolved offsets.
     fn patch_forward_refs(&mut self) {
-        for (native_offset, target_pc) in &self.forward_refs {
-            if let Some(&target_offset) = self.labels.get(target_pc) {
-                let offset = target_offset as i32 - *native_offset as i32;
-                let code = self.buf.code_mut();
-                let inst = u32::from_le_bytes([
-                    code[*native_offset],
-                    code[*native_offset + 1],
-                    code[*native_offset + 2],
-                    code[*native_offset + 3],
-                ]);
-
-                let patched = if (inst & 0xFC000000) == 0x14000000 {
-                    // B instruction
-                    0x14000000 | ((offset as u32 / 4) & 0x03FFFFFF)
-                } else if (inst & 0xFF000000) == 0xB4000000 {
-                    // CBZ
-                    let reg = inst & 0x1F;
-                    0xB4000000 | (((offset as u32 / 4) & 0x7FFFF) << 5) | reg
-                } else if (inst & 0xFF000000) == 0xB5000000 {
-                    // CBNZ
-                    let reg = inst & 0x1F;
-                    0xB5000000 | (((offset as u32 / 4) & 0x7FFFF) << 5) | reg
-                } else if (inst & 0xFF000010) == 0x54000000 {
-                    // B.cond
-                    let cond_bits = inst & 0x0F;
-                    0x54000000 | (((offset as u32 / 4) & 0x7FFFF) << 5) | cond_bits
-                } else {
-                    inst
-                };
-
-                let bytes = patched.to_le_bytes();
-                code[*native_offset] = bytes[0];
-                code[*native_offset + 1] = bytes[1];
-                code[*native_offset + 2] = bytes[2];
-                code[*native_offset + 3] = bytes[3];
+        for i in 0..self.forward_refs.len() {
+            let (native_offset, target_pc) = self.forward_refs[i];
+            if let Some(&target_offset) = self.labels.get(&target_pc) {
+                self.patch_branch(native_offset, target_offset);
             }
         }
     }
+
+    /// Point the branch at `native_offset` to `target_offset`.
+    fn patch_branch(&mut self, native_offset: usize, target_offset: usize) {
+        let offset = target_offset as i32 - native_offset as i32;
+        let code = self.buf.code_mut();
+        let inst = u32::from_le_bytes([
+            code[native_offset],
+            code[native_offset + 1],
+            code[native_offset + 2],
+            code[native_offset + 3],
+        ]);
+
+        let patched = if (inst & 0xFC000000) == 0x14000000 {
+            // B instruction
+            0x14000000 | ((offset as u32 / 4) & 0x03FFFFFF)
+        } else if (inst & 0xFF000000) == 0xB4000000 {
+            // CBZ
+            let reg = inst & 0x1F;
+            0xB4000000 | (((offset as u32 / 4) & 0x7FFFF) << 5) | reg
+        } else if (inst & 0xFF000000) == 0xB5000000 {
+            // CBNZ
+            let reg = inst & 0x1F;
+            0xB5000000 | (((offset as u32 / 4) & 0x7FFFF) << 5) | reg
+        } else if (inst & 0xFF000010) == 0x54000000 {
+            // B.cond
+            let cond_bits = inst & 0x0F;
+            0x54000000 | (((offset as u32 / 4) & 0x7FFFF) << 5) | cond_bits
+        } else {
+            inst
+        };
+
+        let bytes = patched.to_le_bytes();
+        code[native_offset] = bytes[0];
+        code[native_offset + 1] = bytes[1];
+        code[native_offset + 2] = bytes[2];
+        code[native_offset + 3] = bytes[3];
+    }
 }
 
 #[cfg(target_arch = "aarch64")]
@@ -14,17 +14,23 @@ use super::compiler_x86_64::{CompiledCode, CompiledLoop, value_tags};
 #[cfg(target_arch = "x86_64")]
 use super::memory::ExecutableMemory;
 #[cfg(target_arch = "x86_64")]
+use super::regalloc::{self, AllocRequest, CallKind, RegClass, RegFile};
+#[cfg(target_arch = "x86_64")]
+use super::stackmap::{MAX_SAFEPOINT_ROOTS, RootStack, StackMapEntry, StackMapTable};
+#[cfg(target_arch = "x86_64")]
 use super::x86_64::{Cond, Reg, X86_64Assembler};
 #[cfg(target_arch = "x86_64")]
 use crate::vm::ElemKind;
 #[cfg(target_arch = "x86_64")]
 use crate::vm::ValueType;
 #[cfg(target_arch = "x86_64")]
+use crate::vm::bulk::{BulkOp, Operand};
+#[cfg(target_arch = "x86_64")]
 use crate::vm::microop::{CmpCond, ConvertedFunction, MicroOp, VReg};
 #[cfg(target_arch = "x86_64")]
 use crate::vm::{Function, microop_converter};
 #[cfg(target_arch = "x86_64")]
-use std::collections::{HashMap, HashSet};
+use std::collections::{BTreeSet, HashMap, HashSet};
 
 /// Register conventions for MicroOp JIT on x86-64.
 #[cfg(target_arch = "x86_64")]
@@ -44,12 +50,41 @@ mod regs {
     pub const TMP4: Reg = Reg::R8;
     pub const TMP5: Reg = Reg::R9;
 
-    /// Callee-saved registers available for loop-invariant VReg pinning.
-    pub const PIN_REGS: [Reg; 3] = [Reg::Rbx, Reg::R14, Reg::R15];
+    /// Callee-saved registers for allocated VRegs. The last one holds the
+    /// hoisted inner pointer when there is one.
+    pub const CALLEE_SAVED: [Reg; 3] = [Reg::Rbx, Reg::R14, Reg::R15];
 
-    /// Caller-saved registers available for loop-variant VReg allocation.
+    /// Caller-saved registers for allocated VRegs, saved around calls.
     /// Rdi is free after prologue (its value is moved to VM_CTX=R12).
-    pub const LOOP_REGS: [Reg; 3] = [Reg::R10, Reg::R11, Reg::Rdi];
+    pub const CALLER_SAVED: [Reg; 3] = [Reg::R10, Reg::R11, Reg::Rdi];
+
+    /// XMM scratch registers for float ops.
+    pub const XMM_TMP0: u8 = 0;
+    pub const XMM_TMP1: u8 = 1;
+
+    /// XMM registers for allocated float VRegs (all caller-saved).
+    pub const XMM_REGS: [u8; 14] = [2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15];
+}
+
+/// Hardware registers of the VRegs the register allocator assigned.
+#[cfg(target_arch = "x86_64")]
+#[derive(Debug, Clone, Default)]
+struct RegMap {
+    gpr: HashMap<usize, Reg>,
+    xmm: HashMap<usize, u8>,
+}
+
+#[cfg(target_arch = "x86_64")]
+impl RegMap {
+    /// General-purpose register of a VReg, if it has one.
+    fn get(&self, vreg: &usize) -> Option<&Reg> {
+        self.gpr.get(vreg)
+    }
+
+    /// XMM register of a VReg, if it has one.
+    fn xmm(&self, vreg: usize) -> Option<u8> {
+        self.xmm.get(&vreg).copied()
+    }
 }
 
 /// MicroOp-based JIT compiler for x86-64.
@@ -75,22 +110,30 @@ pub struct MicroOpJitCompiler {
     inline_candidates: HashMap<usize, (ConvertedFunction, usize)>,
     /// Starting VReg index for inline temp pool.
     inline_vreg_base: usize,
-    /// Loop-invariant VRegs pinned to hardware registers (loop JIT only).
-    pinned_vregs: HashMap<usize, Reg>,
     /// Hoisted inner pointers: obj VReg index → register holding pre-computed
     /// inner_base = heap_base + (inner_ref + 1) * 8.
     /// Used to optimize HeapLoad2/HeapStore2 by skipping the outer dereference.
     hoisted_inner_ptrs: HashMap<usize, Reg>,
-    /// Loop-variant VRegs assigned to caller-saved registers (R10, R11).
-    loop_regs: HashMap<usize, Reg>,
-    /// Combined register map (pinned_vregs ∪ loop_regs) for load_vreg/store_vreg.
-    /// Dynamically updated when entering/exiting loop regions.
-    all_reg_map: HashMap<usize, Reg>,
+    /// Registers of allocated VRegs, for load_vreg/store_vreg.
+    all_reg_map: RegMap,
+    /// Call PC → allocated VRegs in caller-saved registers live across it.
+    call_saves: HashMap<usize, Vec<usize>>,
+    /// Call PC → all VRegs live across it.
+    call_live: HashMap<usize, Vec<usize>>,
+    /// VRegs that never hold a reference, left out of stack maps.
+    scalar_vregs: HashSet<usize>,
+    /// Stack maps of the safepoints emitted so far.
+    stack_maps: StackMapTable,
+    /// PC of the MicroOp being compiled.
+    current_pc: usize,
     /// Detected inner loop range: Some((loop_start_pc, loop_end_pc)).
     loop_range: Option<(usize, usize)>,
-    /// Code offset after loop_reg_loads (backward jump target).
-    /// Forward jumps use labels[ls] (before loads), backward jump uses this (after loads).
-    loop_body_offset: Option<usize>,
+    /// Callees each CallIndirect/CallDynamic site has seen (indexed by site),
+    /// from the VM's inline caches. Each gets a guarded direct call.
+    call_targets: Vec<Vec<usize>>,
+    /// Locals whose types a loop is specialized on, from the interpreter's
+    /// type feedback.
+    type_guards: Vec<(usize, ValueType)>,
 }
 
 /// Kind of forward reference for patching.
@@ -119,15 +162,33 @@ impl MicroOpJitCompiler {
             shadow_conflict_vregs: HashSet::new(),
             inline_candidates: HashMap::new(),
             inline_vreg_base: 0,
-            pinned_vregs: HashMap::new(),
             hoisted_inner_ptrs: HashMap::new(),
-            loop_regs: HashMap::new(),
-            all_reg_map: HashMap::new(),
+            all_reg_map: RegMap::default(),
+            call_saves: HashMap::new(),
+            call_live: HashMap::new(),
+            scalar_vregs: HashSet::new(),
+            stack_maps: StackMapTable::new(),
+            current_pc: 0,
             loop_range: None,
-            loop_body_offset: None,
+            call_targets: Vec::new(),
+            type_guards: Vec::new(),
         }
     }
 
+    /// Emit guarded direct calls to the callees each call site has seen so
+    /// far (`targets[site]`); other callees take the call_helper path.
+    pub fn with_call_targets(mut self, targets: Vec<Vec<usize>>) -> Self {
+        self.call_targets = targets;
+        self
+    }
+
+    /// Compile loops for the given types of some locals instead of their
+    /// static types. The VM must check `CompiledLoop::guards` on entry.
+    pub fn with_type_guards(mut self, guards: Vec<(usize, ValueType)>) -> Self {
+        self.type_guards = guards;
+        self
+    }
+
     /// Pre-scan MicroOps to find VRegs that are written with different shadow tag types.
     /// These VRegs need unconditional shadow updates at every write, because
     /// `emit_shadow_init` + `needs_shadow_update` can't handle the case where
@@ -135,101 +196,8 @@ impl MicroOpJitCompiler {
     fn compute_shadow_conflicts(ops: &[MicroOp]) -> HashSet<usize> {
         // Map: VReg index → set of tags written to it
         let mut vreg_tags: HashMap<usize, HashSet<u64>> = HashMap::new();
-
-        fn record(map: &mut HashMap<usize, HashSet<u64>>, vreg: usize, tag: u64) {
-            map.entry(vreg).or_default().insert(tag);
-        }
-
-        for op in ops {
-            match op {
-                MicroOp::ConstI64 { dst, .. } | MicroOp::ConstI32 { dst, .. } => {
-                    record(&mut vreg_tags, dst.0, value_tags::TAG_INT);
-                }
-                MicroOp::ConstF64 { dst, .. } | MicroOp::ConstF32 { dst, .. } => {
-                    record(&mut vreg_tags, dst.0, value_tags::TAG_FLOAT);
-                }
-                MicroOp::AddI64 { dst, .. }
-                | MicroOp::SubI64 { dst, .. }
-                | MicroOp::MulI64 { dst, .. }
-                | MicroOp::DivI64 { dst, .. }
-                | MicroOp::RemI64 { dst, .. }
-                | MicroOp::NegI64 { dst, .. }
-                | MicroOp::AddI64Imm { dst, .. }
-                | MicroOp::AndI64 { dst, .. }
-                | MicroOp::OrI64 { dst, .. }
-                | MicroOp::XorI64 { dst, .. }
-                | MicroOp::ShlI64 { dst, .. }
-                | MicroOp::ShlI64Imm { dst, .. }
-                | MicroOp::ShrI64 { dst, .. }
-                | MicroOp::ShrI64Imm { dst, .. }
-                | MicroOp::ShrU64 { dst, .. }
-                | MicroOp::ShrU64Imm { dst, .. }
-                | MicroOp::UMul128Hi { dst, .. }
-                | MicroOp::CmpI64 { dst, .. }
-                | MicroOp::CmpI64Imm { dst, .. }
-                | MicroOp::AddI32 { dst, .. }
-                | MicroOp::SubI32 { dst, .. }
-                | MicroOp::MulI32 { dst, .. }
-                | MicroOp::DivI32 { dst, .. }
-                | MicroOp::RemI32 { dst, .. }
-                | MicroOp::EqzI32 { dst, .. }
-                | MicroOp::CmpI32 { dst, .. }
-                | MicroOp::RefEq { dst, .. }
-                | MicroOp::RefIsNull { dst, .. }
-                | MicroOp::F64ReinterpretAsI64 { dst, .. }
-                | MicroOp::I32WrapI64 { dst, .. }
-                | MicroOp::I64ExtendI32S { dst, .. }
-                | MicroOp::I64ExtendI32U { dst, .. }
-                | MicroOp::I64TruncF64S { dst, .. }
-                | MicroOp::I32TruncF32S { dst, .. }
-                | MicroOp::I32TruncF64S { dst, .. }
-                | MicroOp::I64TruncF32S { dst, .. }
-                | MicroOp::CmpF64 { dst, .. }
-                | MicroOp::CmpF32 { dst, .. } => {
-                    record(&mut vreg_tags, dst.0, value_tags::TAG_INT);
-                }
-                MicroOp::AddF64 { dst, .. }
-                | MicroOp::SubF64 { dst, .. }
-                | MicroOp::MulF64 { dst, .. }
-                | MicroOp::DivF64 { dst, .. }
-                | MicroOp::NegF64 { dst, .. }
-                | MicroOp::AddF32 { dst, .. }
-                | MicroOp::SubF32 { dst, .. }
-                | MicroOp::MulF32 { dst, .. }
-                | MicroOp::DivF32 { dst, .. }
-                | MicroOp::NegF32 { dst, .. }
-                | MicroOp::F64ConvertI64S { dst, .. }
-                | MicroOp::F64ConvertI32S { dst, .. }
-                | MicroOp::F32ConvertI32S { dst, .. }
-                | MicroOp::F32ConvertI64S { dst, .. }
-                | MicroOp::F32DemoteF64 { dst, .. }
-                | MicroOp::F64PromoteF32 { dst, .. } => {
-                    record(&mut vreg_tags, dst.0, value_tags::TAG_FLOAT);
-                }
-                MicroOp::RefNull { dst } => {
-                    record(&mut vreg_tags, dst.0, value_tags::TAG_NIL);
-                }
-                // These read tags from heap/call/stack — they're dynamic, always correct
-                // Don't count them as a specific tag (they always write the correct shadow)
-                MicroOp::HeapLoad { dst, .. }
-                | MicroOp::HeapLoadDyn { dst, .. }
-                | MicroOp::HeapLoad2 { dst, .. }
-                | MicroOp::StackPop { dst }
-                | MicroOp::HeapAlloc { dst, .. }
-                | MicroOp::HeapAllocDynSimple { dst, .. }
-                | MicroOp::StringConst { dst, .. } => {
-                    // These always write the correct shadow tag directly
-                    // Mark with a sentinel tag (u64::MAX) to indicate "dynamic"
-                    record(&mut vreg_tags, dst.0, u64::MAX);
-                }
-                MicroOp::Call { ret: Some(ret), .. }
-                | MicroOp::CallIndirect { ret: Some(ret), .. } => {
-                    record(&mut vreg_tags, ret.0, u64::MAX);
-                }
-                // Mov copies shadow from src → doesn't set a specific tag
-                // Other non-value-producing ops
-                _ => {}
-            }
+        for (vreg, tag) in ops.iter().filter_map(Self::written_tag) {
+            vreg_tags.entry(vreg).or_default().insert(tag);
         }
 
         // VRegs with more than one distinct tag type need unconditional updates
@@ -240,6 +208,118 @@ impl MicroOpJitCompiler {
             .collect()
     }
 
+    /// The VReg `op` writes and the tag it writes, for the ops whose tag is
+    /// known. `u64::MAX` stands for a tag only known at runtime.
+    fn written_tag(op: &MicroOp) -> Option<(usize, u64)> {
+        match op {
+            MicroOp::ConstI64 { dst, .. } | MicroOp::ConstI32 { dst, .. } => {
+                Some((dst.0, value_tags::TAG_INT))
+            }
+            MicroOp::ConstF64 { dst, .. } | MicroOp::ConstF32 { dst, .. } => {
+                Some((dst.0, value_tags::TAG_FLOAT))
+            }
+            MicroOp::AddI64 { dst, .. }
+            | MicroOp::SubI64 { dst, .. }
+            | MicroOp::MulI64 { dst, .. }
+            | MicroOp::DivI64 { dst, .. }
+            | MicroOp::RemI64 { dst, .. }
+            | MicroOp::NegI64 { dst, .. }
+            | MicroOp::AddI64Imm { dst, .. }
+            | MicroOp::AndI64 { dst, .. }
+            | MicroOp::OrI64 { dst, .. }
+            | MicroOp::XorI64 { dst, .. }
+            | MicroOp::ShlI64 { dst, .. }
+            | MicroOp::ShlI64Imm { dst, .. }
+            | MicroOp::ShrI64 { dst, .. }
+            | MicroOp::ShrI64Imm { dst, .. }
+            | MicroOp::ShrU64 { dst, .. }
+            | MicroOp::ShrU64Imm { dst, .. }
+            | MicroOp::UMul128Hi { dst, .. }
+            | MicroOp::CmpI64 { dst, .. }
+            | MicroOp::CmpI64Imm { dst, .. }
+            | MicroOp::AddI32 { dst, .. }
+            | MicroOp::SubI32 { dst, .. }
+            | MicroOp::MulI32 { dst, .. }
+            | MicroOp::DivI32 { dst, .. }
+            | MicroOp::RemI32 { dst, .. }
+            | MicroOp::EqzI32 { dst, .. }
+            | MicroOp::CmpI32 { dst, .. }
+            | MicroOp::RefEq { dst, .. }
+            | MicroOp::RefIsNull { dst, .. }
+            | MicroOp::F64ReinterpretAsI64 { dst, .. }
+            | MicroOp::I32WrapI64 { dst, .. }
+            | MicroOp::I64ExtendI32S { dst, .. }
+            | MicroOp::I64ExtendI32U { dst, .. }
+            | MicroOp::I64TruncF64S { dst, .. }
+            | MicroOp::I32TruncF32S { dst, .. }
+            | MicroOp::I32TruncF64S { dst, .. }
+            | MicroOp::I64TruncF32S { dst, .. }
+            | MicroOp::CmpF64 { dst, .. }
+            | MicroOp::CmpF32 { dst, .. } => Some((dst.0, value_tags::TAG_INT)),
+            MicroOp::AddF64 { dst, .. }
+            | MicroOp::SubF64 { dst, .. }
+            | MicroOp::MulF64 { dst, .. }
+            | MicroOp::DivF64 { dst, .. }
+            | MicroOp::NegF64 { dst, .. }
+            | MicroOp::AddF32 { dst, .. }
+            | MicroOp::SubF32 { dst, .. }
+            | MicroOp::MulF32 { dst, .. }
+            | MicroOp::DivF32 { dst, .. }
+            | MicroOp::NegF32 { dst, .. }
+            | MicroOp::F64ConvertI64S { dst, .. }
+            | MicroOp::F64ConvertI32S { dst, .. }
+            | MicroOp::F32ConvertI32S { dst, .. }
+            | MicroOp::F32ConvertI64S { dst, .. }
+            | MicroOp::F32DemoteF64 { dst, .. }
+            | MicroOp::F64PromoteF32 { dst, .. } => Some((dst.0, value_tags::TAG_FLOAT)),
+            MicroOp::RefNull { dst } => Some((dst.0, value_tags::TAG_NIL)),
+            // These read tags from heap/call/stack — they're dynamic, always correct
+            // Don't count them as a specific tag (they always write the correct shadow)
+            MicroOp::HeapLoad { dst, .. }
+            | MicroOp::HeapLoadDyn { dst, .. }
+            | MicroOp::HeapLoad2 { dst, .. }
+            | MicroOp::StackPop { dst }
+            | MicroOp::HeapAlloc { dst, .. }
+            | MicroOp::HeapAllocDynSimple { dst, .. }
+            | MicroOp::StringConst { dst, .. }
+            | MicroOp::GlobalGet { dst, .. }
+            | MicroOp::VtableLookup { dst, .. } => {
+                // These always write the correct shadow tag directly
+                // Mark with a sentinel tag (u64::MAX) to indicate "dynamic"
+                Some((dst.0, u64::MAX))
+            }
+            MicroOp::Call { ret: Some(ret), .. }
+            | MicroOp::CallIndirect { ret: Some(ret), .. }
+            | MicroOp::CallDynamic { ret: Some(ret), .. }
+            | MicroOp::HeapBulk { dst: Some(ret), .. } => Some((ret.0, u64::MAX)),
+            // Mov copies shadow from src → doesn't set a specific tag
+            // Other non-value-producing ops
+            _ => None,
+        }
+    }
+
+    /// VRegs that can never hold a reference: not typed Ref, and only
+    /// written by ops producing ints or floats. Safepoints leave them out.
+    fn compute_scalar_vregs(ops: &[MicroOp], vreg_types: &[ValueType]) -> HashSet<usize> {
+        let mut scalar: HashSet<usize> = (0..vreg_types.len())
+            .filter(|&v| vreg_types[v] != ValueType::Ref)
+            .collect();
+        for op in ops {
+            match Self::written_tag(op) {
+                Some((_, value_tags::TAG_INT | value_tags::TAG_FLOAT)) => {}
+                Some((vreg, _)) => {
+                    scalar.remove(&vreg);
+                }
+                None => {
+                    if let (_, Some(vreg)) = regalloc::operands(op) {
+                        scalar.remove(&vreg);
+                    }
+                }
+            }
+        }
+        scalar
+    }
+
     /// Analyze MicroOps in a loop range to find loop-invariant VRegs.
     /// Returns (vreg_index, read_count) sorted by read_count descending.
     fn analyze_loop_invariants(
@@ -264,6 +344,31 @@ impl MicroOpJitCompiler {
                 MicroOp::BrIf { cond, .. } | MicroOp::BrIfFalse { cond, .. } => {
                     mark_read(cond.0);
                 }
+
+                // Superinstructions (not produced for the JIT)
+                MicroOp::CmpI64BrIfFalse { dst, a, b, .. }
+                | MicroOp::CmpF64BrIfFalse { dst, a, b, .. } => {
+                    mark_read(a.0);
+                    mark_read(b.0);
+                    mark_write(dst.0);
+                }
+                MicroOp::CmpI64ImmBrIfFalse { dst, a, .. } => {
+                    mark_read(a.0);
+                    mark_write(dst.0);
+                }
+                MicroOp::MulF64AddF64 { tmp, a, b, c, dst } => {
+                    mark_read(a.0);
+                    mark_read(b.0);
+                    mark_write(tmp.0);
+                    mark_read(c.0);
+                    mark_write(dst.0);
+                }
+                MicroOp::ConstF64MulF64 { tmp, dst, a, .. }
+                | MicroOp::ConstF64DivF64 { tmp, dst, a, .. } => {
+                    mark_write(tmp.0);
+                    mark_read(a.0);
+                    mark_write(dst.0);
+                }
                 MicroOp::Call { args, ret, .. } => {
                     for a in args {
                         mark_read(a.0);
@@ -427,6 +532,14 @@ impl MicroOpJitCompiler {
                     mark_read(size.0);
                     mark_write(dst.0);
                 }
+                MicroOp::HeapBulk { dst, args, .. } => {
+                    for a in args {
+                        mark_read(a.0);
+                    }
+                    if let Some(dst) = dst {
+                        mark_write(dst.0);
+                    }
+                }
 
                 // String / Global
                 MicroOp::StringConst { dst, .. } | MicroOp::GlobalGet { dst, .. } => {
@@ -436,6 +549,7 @@ impl MicroOpJitCompiler {
                     dst,
                     type_info,
                     iface_desc,
+                    ..
                 } => {
                     mark_read(type_info.0);
                     mark_read(iface_desc.0);
@@ -497,216 +611,6 @@ impl MicroOpJitCompiler {
         best
     }
 
-    /// Analyze loop-variant VRegs: VRegs that are written within [start, end].
-    /// Returns (vreg_index, access_count) sorted by access_count descending,
-    /// where access_count = read_count + write_count.
-    fn analyze_loop_variants(
-        ops: &[MicroOp],
-        loop_start: usize,
-        loop_end: usize,
-    ) -> Vec<(usize, usize)> {
-        let mut written: HashSet<usize> = HashSet::new();
-        let mut read_counts: HashMap<usize, usize> = HashMap::new();
-        let mut write_counts: HashMap<usize, usize> = HashMap::new();
-
-        let mut mark_write = |v: usize| {
-            written.insert(v);
-            *write_counts.entry(v).or_insert(0) += 1;
-        };
-        let mut mark_read = |v: usize| {
-            *read_counts.entry(v).or_insert(0) += 1;
-        };
-
-        for op in &ops[loop_start..=loop_end] {
-            match op {
-                MicroOp::Jmp { .. } => {}
-                MicroOp::BrIf { cond, .. } | MicroOp::BrIfFalse { cond, .. } => {
-                    mark_read(cond.0);
-                }
-                MicroOp::Call { args, ret, .. } => {
-                    for a in args {
-                        mark_read(a.0);
-                    }
-                    if let Some(r) = ret {
-                        mark_write(r.0);
-                    }
-                }
-                MicroOp::CallIndirect {
-                    callee, args, ret, ..
-                } => {
-                    mark_read(callee.0);
-                    for a in args {
-                        mark_read(a.0);
-                    }
-                    if let Some(r) = ret {
-                        mark_write(r.0);
-                    }
-                }
-                MicroOp::CallDynamic {
-                    func_idx,
-                    args,
-                    ret,
-                    ..
-                } => {
-                    mark_read(func_idx.0);
-                    for a in args {
-                        mark_read(a.0);
-                    }
-                    if let Some(r) = ret {
-                        mark_write(r.0);
-                    }
-                }
-                MicroOp::Ret { src } => {
-                    if let Some(s) = src {
-                        mark_read(s.0);
-                    }
-                }
-                MicroOp::Mov { dst, src } => {
-                    mark_read(src.0);
-                    mark_write(dst.0);
-                }
-                MicroOp::ConstI64 { dst, .. }
-                | MicroOp::ConstI32 { dst, .. }
-                | MicroOp::ConstF64 { dst, .. }
-                | MicroOp::ConstF32 { dst, .. } => {
-                    mark_write(dst.0);
-                }
-                MicroOp::AddI64 { dst, a, b }
-                | MicroOp::SubI64 { dst, a, b }
-                | MicroOp::MulI64 { dst, a, b }
-                | MicroOp::DivI64 { dst, a, b }
-                | MicroOp::RemI64 { dst, a, b }
-                | MicroOp::AndI64 { dst, a, b }
-                | MicroOp::OrI64 { dst, a, b }
-                | MicroOp::XorI64 { dst, a, b }
-                | MicroOp::ShlI64 { dst, a, b }
-                | MicroOp::ShrI64 { dst, a, b }
-                | MicroOp::ShrU64 { dst, a, b }
-                | MicroOp::UMul128Hi { dst, a, b }
-                | MicroOp::AddI32 { dst, a, b }
-                | MicroOp::SubI32 { dst, a, b }
-                | MicroOp::MulI32 { dst, a, b }
-                | MicroOp::DivI32 { dst, a, b }
-                | MicroOp::RemI32 { dst, a, b }
-                | MicroOp::AddF64 { dst, a, b }
-                | MicroOp::SubF64 { dst, a, b }
-                | MicroOp::MulF64 { dst, a, b }
-                | MicroOp::DivF64 { dst, a, b }
-                | MicroOp::AddF32 { dst, a, b }
-                | MicroOp::SubF32 { dst, a, b }
-                | MicroOp::MulF32 { dst, a, b }
-                | MicroOp::DivF32 { dst, a, b }
-                | MicroOp::CmpI64 { dst, a, b, .. }
-                | MicroOp::CmpI32 { dst, a, b, .. }
-                | MicroOp::CmpF64 { dst, a, b, .. }
-                | MicroOp::CmpF32 { dst, a, b, .. }
-                | MicroOp::RefEq { dst, a, b } => {
-                    mark_read(a.0);
-                    mark_read(b.0);
-                    mark_write(dst.0);
-                }
-                MicroOp::AddI64Imm { dst, a, .. }
-                | MicroOp::ShlI64Imm { dst, a, .. }
-                | MicroOp::ShrI64Imm { dst, a, .. }
-                | MicroOp::ShrU64Imm { dst, a, .. }
-                | MicroOp::CmpI64Imm { dst, a, .. } => {
-                    mark_read(a.0);
-                    mark_write(dst.0);
-                }
-                MicroOp::NegI64 { dst, src }
-                | MicroOp::NegF64 { dst, src }
-                | MicroOp::NegF32 { dst, src }
-                | MicroOp::EqzI32 { dst, src }
-                | MicroOp::I32WrapI64 { dst, src }
-                | MicroOp::I64ExtendI32S { dst, src }
-                | MicroOp::I64ExtendI32U { dst, src }
-                | MicroOp::F64ConvertI64S { dst, src }
-                | MicroOp::I64TruncF64S { dst, src }
-                | MicroOp::F64ConvertI32S { dst, src }
-                | MicroOp::F32ConvertI32S { dst, src }
-                | MicroOp::F32ConvertI64S { dst, src }
-                | MicroOp::I32TruncF32S { dst, src }
-                | MicroOp::I32TruncF64S { dst, src }
-                | MicroOp::I64TruncF32S { dst, src }
-                | MicroOp::F32DemoteF64 { dst, src }
-                | MicroOp::F64PromoteF32 { dst, src }
-                | MicroOp::F64ReinterpretAsI64 { dst, src }
-                | MicroOp::RefIsNull { dst, src } => {
-                    mark_read(src.0);
-                    mark_write(dst.0);
-                }
-                MicroOp::RefNull { dst } => {
-                    mark_write(dst.0);
-                }
-                MicroOp::HeapLoad { dst, src, .. } => {
-                    mark_read(src.0);
-                    mark_write(dst.0);
-                }
-                MicroOp::HeapLoadDyn { dst, obj, idx, .. }
-                | MicroOp::HeapLoad2 { dst, obj, idx, .. } => {
-                    mark_read(obj.0);
-                    mark_read(idx.0);
-                    mark_write(dst.0);
-                }
-                MicroOp::HeapStore { dst_obj, src, .. } => {
-                    mark_read(dst_obj.0);
-                    mark_read(src.0);
-                }
-                MicroOp::HeapStoreDyn { obj, idx, src, .. }
-                | MicroOp::HeapStore2 { obj, idx, src, .. } => {
-                    mark_read(obj.0);
-                    mark_read(idx.0);
-                    mark_read(src.0);
-                }
-                MicroOp::HeapOffsetRef { dst, src, offset } => {
-                    mark_read(src.0);
-                    mark_read(offset.0);
-                    mark_write(dst.0);
-                }
-                MicroOp::HeapAlloc { dst, args } => {
-                    for a in args {
-                        mark_read(a.0);
-                    }
-                    mark_write(dst.0);
-                }
-                MicroOp::HeapAllocDynSimple { dst, size, .. } => {
-                    mark_read(size.0);
-                    mark_write(dst.0);
-                }
-                MicroOp::StringConst { dst, .. } | MicroOp::GlobalGet { dst, .. } => {
-                    mark_write(dst.0);
-                }
-                MicroOp::VtableLookup {
-                    dst,
-                    type_info,
-                    iface_desc,
-                } => {
-                    mark_read(type_info.0);
-                    mark_read(iface_desc.0);
-                    mark_write(dst.0);
-                }
-                MicroOp::StackPush { src } => {
-                    mark_read(src.0);
-                }
-                MicroOp::StackPop { dst } => {
-                    mark_write(dst.0);
-                }
-                MicroOp::Raw { .. } => {}
-            }
-        }
-
-        // Keep only written VRegs, sum read+write counts, sort descending
-        let mut variants: Vec<(usize, usize)> = written
-            .iter()
-            .map(|&v| {
-                let total = read_counts.get(&v).unwrap_or(&0) + write_counts.get(&v).unwrap_or(&0);
-                (v, total)
-            })
-            .collect();
-        variants.sort_by(|a, b| b.1.cmp(&a.1).then_with(|| a.0.cmp(&b.0)));
-        variants
-    }
-
     /// Detect VRegs that are only written by CmpI64/CmpI64Imm and only read by
     /// BrIfFalse/BrIf immediately after (fusion-eligible). These VRegs don't
     /// benefit from register allocation since the cmp+branch is emitted as a
@@ -880,48 +784,90 @@ impl MicroOpJitCompiler {
         asm.mov_mr(regs::FRAME_BASE, shadow_off, regs::TMP0);
     }
 
-    /// Load a VReg's payload into dst_reg. If the VReg is pinned to a hardware
-    /// register, emits a reg-to-reg move (or nothing if dst == pin).
-    /// Otherwise, emits a memory load from the frame.
-    fn load_vreg(
-        asm: &mut X86_64Assembler,
-        dst_reg: Reg,
-        vreg: &VReg,
-        reg_map: &HashMap<usize, Reg>,
-    ) {
+    /// Load a VReg's payload into dst_reg. If the VReg is allocated to a
+    /// hardware register, emits a register move (or nothing if dst is that
+    /// register). Otherwise, emits a memory load from the frame.
+    fn load_vreg(asm: &mut X86_64Assembler, dst_reg: Reg, vreg: &VReg, reg_map: &RegMap) {
         if let Some(&mapped_reg) = reg_map.get(&vreg.0) {
             if dst_reg != mapped_reg {
                 asm.mov_rr(dst_reg, mapped_reg);
             }
+        } else if let Some(xmm) = reg_map.xmm(vreg.0) {
+            asm.movq_r64_xmm(dst_reg, xmm);
         } else {
             asm.mov_rm(dst_reg, regs::FRAME_BASE, Self::vreg_offset(vreg));
         }
     }
 
-    /// Store a value from src_reg into a VReg. If the VReg is mapped to a
-    /// hardware register (pinned or loop-allocated), emits a reg-to-reg move.
-    /// Otherwise, emits a memory store to the frame.
-    fn store_vreg(
-        asm: &mut X86_64Assembler,
-        src_reg: Reg,
-        vreg: &VReg,
-        reg_map: &HashMap<usize, Reg>,
-    ) {
+    /// Store a value from src_reg into a VReg. If the VReg is allocated to
+    /// a hardware register, emits a register move. Otherwise, emits a memory
+    /// store to the frame.
+    fn store_vreg(asm: &mut X86_64Assembler, src_reg: Reg, vreg: &VReg, reg_map: &RegMap) {
         if let Some(&mapped_reg) = reg_map.get(&vreg.0) {
             if src_reg != mapped_reg {
                 asm.mov_rr(mapped_reg, src_reg);
             }
+        } else if let Some(xmm) = reg_map.xmm(vreg.0) {
+            asm.movq_xmm_r64(xmm, src_reg);
         } else {
             asm.mov_mr(regs::FRAME_BASE, Self::vreg_offset(vreg), src_reg);
         }
     }
 
-    /// Load pinned VRegs from frame slots into their assigned registers.
-    fn emit_pin_loads(&mut self) {
-        for (&vreg_idx, &reg) in &self.pinned_vregs {
-            let vreg = VReg(vreg_idx);
-            let mut asm = X86_64Assembler::new(&mut self.buf);
-            asm.mov_rm(reg, regs::FRAME_BASE, Self::vreg_offset(&vreg));
+    /// Get a float VReg into an XMM register: its own if it has one,
+    /// otherwise `scratch`. Returns the register holding the value.
+    fn load_vreg_xmm(asm: &mut X86_64Assembler, scratch: u8, vreg: &VReg, reg_map: &RegMap) -> u8 {
+        if let Some(xmm) = reg_map.xmm(vreg.0) {
+            return xmm;
+        }
+        Self::load_vreg_to_xmm(asm, scratch, vreg, reg_map);
+        scratch
+    }
+
+    /// Copy a VReg's payload into XMM register `dst`.
+    fn load_vreg_to_xmm(asm: &mut X86_64Assembler, dst: u8, vreg: &VReg, reg_map: &RegMap) {
+        if let Some(xmm) = reg_map.xmm(vreg.0) {
+            if xmm != dst {
+                asm.movapd(dst, xmm);
+            }
+        } else if let Some(&reg) = reg_map.get(&vreg.0) {
+            asm.movq_xmm_r64(dst, reg);
+        } else {
+            asm.movsd_xmm_m(dst, regs::FRAME_BASE, Self::vreg_offset(vreg));
+        }
+    }
+
+    /// Store XMM register `src` into a VReg.
+    fn store_vreg_xmm(asm: &mut X86_64Assembler, src: u8, vreg: &VReg, reg_map: &RegMap) {
+        if let Some(xmm) = reg_map.xmm(vreg.0) {
+            if xmm != src {
+                asm.movapd(xmm, src);
+            }
+        } else if let Some(&reg) = reg_map.get(&vreg.0) {
+            asm.movq_r64_xmm(reg, src);
+        } else {
+            asm.movsd_m_xmm(regs::FRAME_BASE, Self::vreg_offset(vreg), src);
+        }
+    }
+
+    /// Copy allocated VRegs between their registers and frame slots.
+    fn emit_reg_transfers(&mut self, vregs: &[usize], to_frame: bool) {
+        let mut asm = X86_64Assembler::new(&mut self.buf);
+        for &vreg_idx in vregs {
+            let off = Self::vreg_offset(&VReg(vreg_idx));
+            if let Some(&reg) = self.all_reg_map.get(&vreg_idx) {
+                if to_frame {
+                    asm.mov_mr(regs::FRAME_BASE, off, reg);
+                } else {
+                    asm.mov_rm(reg, regs::FRAME_BASE, off);
+                }
+            } else if let Some(xmm) = self.all_reg_map.xmm(vreg_idx) {
+                if to_frame {
+                    asm.movsd_m_xmm(regs::FRAME_BASE, off, xmm);
+                } else {
+                    asm.movsd_xmm_m(xmm, regs::FRAME_BASE, off);
+                }
+            }
         }
     }
 
@@ -950,53 +896,251 @@ impl MicroOpJitCompiler {
         }
     }
 
-    /// Reload hoisted inner pointers after a non-inlined function call.
-    /// The call may have mutated the heap (e.g. Vec resize), invalidating cached inner pointers.
+    /// Reload hoisted inner pointers after a non-inlined function call or
+    /// an allocation. Either may have mutated the heap (e.g. Vec resize) or
+    /// moved its memory, invalidating cached inner pointers.
     fn emit_inner_ptr_reloads(&mut self) {
-        if self.hoisted_inner_ptrs.is_empty() {
+        if self.hoisted_inner_ptrs.is_empty() || !self.in_hoisting_range() {
             return;
         }
         self.emit_inner_ptr_loads();
     }
 
-    /// Load loop-variant VRegs from frame slots into their assigned registers (R10/R11).
-    fn emit_loop_reg_loads(&mut self) {
-        for (&vreg_idx, &reg) in &self.loop_regs.clone() {
-            if !self.all_reg_map.contains_key(&vreg_idx) {
-                continue; // loop_reg not active (outside loop), skip
+    /// Whether `current_pc` is in the loop the inner pointers are hoisted
+    /// out of. The loads are emitted on entry to it, so outside it the
+    /// registers are not set up.
+    fn in_hoisting_range(&self) -> bool {
+        self.loop_range
+            .is_none_or(|(ls, le)| (ls..=le).contains(&self.current_pc))
+    }
+
+    /// The register holding the hoisted inner pointer of `obj`, if any.
+    fn hoisted_inner_ptr(&self, obj: &VReg) -> Option<Reg> {
+        if !self.in_hoisting_range() {
+            return None;
+        }
+        self.hoisted_inner_ptrs.get(&obj.0).copied()
+    }
+
+    /// Store caller-saved registers that are live across the call at
+    /// `current_pc` to their frame slots.
+    fn emit_call_spills(&mut self) {
+        if let Some(vregs) = self.call_saves.get(&self.current_pc).cloned() {
+            self.emit_reg_transfers(&vregs, true);
+        }
+    }
+
+    /// Reload what emit_call_spills stored once the call has returned.
+    fn emit_call_reloads(&mut self) {
+        if let Some(vregs) = self.call_saves.get(&self.current_pc).cloned() {
+            self.emit_reg_transfers(&vregs, false);
+        }
+    }
+
+    /// JitCallContext offset for the root stack pointer.
+    const GC_ROOTS_OFFSET: i32 = 112;
+
+    /// Whether the VM may collect garbage during `op`: calls, and ops whose
+    /// helper allocates.
+    fn is_gc_safepoint(&self, op: &MicroOp) -> bool {
+        match op {
+            MicroOp::Call { func_id, .. } => !self.inline_candidates.contains_key(func_id),
+            MicroOp::CallIndirect { .. }
+            | MicroOp::CallDynamic { .. }
+            | MicroOp::StringConst { .. }
+            | MicroOp::HeapAlloc { .. }
+            | MicroOp::HeapAllocDynSimple { .. }
+            | MicroOp::HeapBulk { .. } => true,
+            _ => false,
+        }
+    }
+
+    /// Record the stack map of the safepoint at `current_pc` and emit the
+    /// code that copies its values (shadow tag and payload) to the root
+    /// stack, saving the old top on the native stack for
+    /// `emit_safepoint_exit`. A safepoint that does not fit marks the root
+    /// stack overflowed instead.
+    fn emit_safepoint_entry(&mut self, op: &MicroOp) -> bool {
+        if !self.is_gc_safepoint(op) {
+            return false;
+        }
+        let roots: Vec<usize> = self
+            .call_live
+            .get(&self.current_pc)
+            .into_iter()
+            .flatten()
+            .copied()
+            .filter(|v| !self.scalar_vregs.contains(v))
+            .collect();
+        if roots.is_empty() {
+            return false;
+        }
+        let mut entry = StackMapEntry::new(
+            self.buf.len() as u32,
+            self.current_pc as u32,
+            roots.len().min(u16::MAX as usize) as u16,
+            self.self_locals_count.min(u16::MAX as usize) as u16,
+        );
+        entry.frame_refs = roots.iter().map(|&v| v as u32).collect();
+        self.stack_maps.add_entry(entry);
+
+        {
+            let mut asm = X86_64Assembler::new(&mut self.buf);
+            // TMP4 = root stack, TMP1 = its top; keep the top for the exit
+            asm.mov_rm(regs::TMP4, regs::VM_CTX, Self::GC_ROOTS_OFFSET);
+            asm.mov_rm(regs::TMP1, regs::TMP4, RootStack::TOP_OFFSET);
+            asm.push(regs::TMP1);
+            asm.push(regs::TMP1); // padding to keep 16-byte alignment
+            if roots.len() > MAX_SAFEPOINT_ROOTS {
+                asm.mov_ri64(regs::TMP0, 1);
+                asm.mov_mr(regs::TMP4, RootStack::OVERFLOWED_OFFSET, regs::TMP0);
+                return true;
             }
+
+            // TMP5 = new top; overflow unless it is within the stack
+            asm.mov_rr(regs::TMP5, regs::TMP1);
+            asm.add_ri32(regs::TMP5, (roots.len() * 16) as i32);
+            asm.mov_rm(regs::TMP0, regs::TMP4, RootStack::END_OFFSET);
+            asm.cmp_rr(regs::TMP5, regs::TMP0);
+        }
+        // Where each tag comes from: a constant for VRegs always holding a
+        // reference, the shadow tag otherwise
+        let tag_slots: Vec<Option<i32>> = roots
+            .iter()
+            .map(|&v| {
+                let always_ref = self.vreg_types.get(v) == Some(&ValueType::Ref)
+                    && !self.shadow_conflict_vregs.contains(&v);
+                (!always_ref).then(|| self.shadow_tag_offset(&VReg(v)))
+            })
+            .collect();
+        let overflow_site = self.buf.len();
+        {
+            let mut asm = X86_64Assembler::new(&mut self.buf);
+            asm.jcc_rel32(Cond::A, 0);
+            for (i, (&v, tag_slot)) in roots.iter().zip(tag_slots).enumerate() {
+                let off = (i * 16) as i32;
+                match tag_slot {
+                    Some(slot) => asm.mov_rm(regs::TMP0, regs::FRAME_BASE, slot),
+                    None => asm.mov_ri64(regs::TMP0, value_tags::TAG_PTR as i64),
+                }
+                asm.mov_mr(regs::TMP1, off, regs::TMP0);
+                Self::load_vreg(&mut asm, regs::TMP0, &VReg(v), &self.all_reg_map);
+                asm.mov_mr(regs::TMP1, off + 8, regs::TMP0);
+            }
+            asm.mov_mr(regs::TMP4, RootStack::TOP_OFFSET, regs::TMP5);
+        }
+        let done_site = self.buf.len();
+        X86_64Assembler::new(&mut self.buf).jmp_rel32(0);
+
+        let overflow = self.buf.len();
+        {
             let mut asm = X86_64Assembler::new(&mut self.buf);
-            asm.mov_rm(reg, regs::FRAME_BASE, (vreg_idx as i32) * 8);
+            asm.mov_ri64(regs::TMP0, 1);
+            asm.mov_mr(regs::TMP4, RootStack::OVERFLOWED_OFFSET, regs::TMP0);
         }
+        let done = self.buf.len();
+        self.patch_i32(overflow_site + 2, (overflow - overflow_site - 6) as i32);
+        self.patch_i32(done_site + 1, (done - done_site - 5) as i32);
+        true
+    }
+
+    /// Put back the root stack top saved by `emit_safepoint_entry`.
+    fn emit_safepoint_exit(&mut self) {
+        let mut asm = X86_64Assembler::new(&mut self.buf);
+        asm.pop(regs::TMP1);
+        asm.pop(regs::TMP1);
+        asm.mov_rm(regs::TMP4, regs::VM_CTX, Self::GC_ROOTS_OFFSET);
+        asm.mov_mr(regs::TMP4, RootStack::TOP_OFFSET, regs::TMP1);
     }
 
-    /// Spill loop-variant VRegs from registers back to frame slots.
-    /// Only spills when loop_regs are active (inside the loop region).
-    fn emit_loop_reg_spills(&mut self) {
-        for (&vreg_idx, &reg) in &self.loop_regs.clone() {
-            if !self.all_reg_map.contains_key(&vreg_idx) {
-                continue; // loop_reg not active (outside loop), skip
+    /// Run the register allocator over `start..=end` and map its result to
+    /// x86-64 registers. `live_out` are the VRegs live where control leaves
+    /// the range. Returns the allocated VRegs live on entry.
+    fn allocate_registers(
+        &mut self,
+        ops: &[MicroOp],
+        start: usize,
+        end: usize,
+        live_out: &[usize],
+    ) -> Vec<usize> {
+        let callee_saved: Vec<Reg> = regs::CALLEE_SAVED
+            .into_iter()
+            .filter(|r| !self.hoisted_inner_ptrs.values().any(|h| h == r))
+            .collect();
+        let int_file = RegFile {
+            callee_saved: callee_saved.len(),
+            caller_saved: regs::CALLER_SAVED.len(),
+        };
+        let float_file = RegFile {
+            callee_saved: 0,
+            caller_saved: regs::XMM_REGS.len(),
+        };
+        let inline_candidates = &self.inline_candidates;
+        let call_kind = |op: &MicroOp| match op {
+            MicroOp::Call { func_id, .. } if inline_candidates.contains_key(func_id) => None,
+            MicroOp::Call { .. }
+            | MicroOp::CallIndirect { .. }
+            | MicroOp::CallDynamic { .. }
+            | MicroOp::StringConst { .. }
+            | MicroOp::GlobalGet { .. }
+            | MicroOp::VtableLookup { .. }
+            | MicroOp::HeapAllocDynSimple { .. }
+            | MicroOp::HeapBulk { .. } => Some(CallKind::ReadsBefore),
+            MicroOp::HeapAlloc { .. } => Some(CallKind::ReadsAfter),
+            _ => None,
+        };
+        let memory_only = Self::detect_fused_only_vregs(ops, start, end);
+        let allocation = regalloc::allocate(&AllocRequest {
+            ops,
+            start,
+            end,
+            int: int_file,
+            float: float_file,
+            live_out,
+            call_kind: &call_kind,
+            memory_only: &memory_only,
+        });
+
+        let mut reg_map = RegMap::default();
+        for (&vreg_idx, &(class, reg)) in &allocation.regs {
+            match class {
+                RegClass::Int if reg < callee_saved.len() => {
+                    reg_map.gpr.insert(vreg_idx, callee_saved[reg]);
+                }
+                RegClass::Int => {
+                    reg_map
+                        .gpr
+                        .insert(vreg_idx, regs::CALLER_SAVED[reg - callee_saved.len()]);
+                }
+                RegClass::Float => {
+                    reg_map.xmm.insert(vreg_idx, regs::XMM_REGS[reg]);
+                }
             }
-            let mut asm = X86_64Assembler::new(&mut self.buf);
-            asm.mov_mr(regs::FRAME_BASE, (vreg_idx as i32) * 8, reg);
         }
+        self.all_reg_map = reg_map;
+        self.call_saves = allocation.call_saves;
+        self.call_live = allocation.call_live;
+        allocation.live_in
     }
 
-    /// Reload loop-variant VRegs after a non-inlined function call.
-    /// R10/R11 are caller-saved and may be clobbered by the call.
-    /// Only reloads when loop_regs are active (inside the loop region).
-    fn emit_loop_reg_reloads(&mut self) {
-        if self.loop_regs.is_empty() {
-            return;
+    /// Pick the invariant VReg used most as a HeapLoad2/HeapStore2 object in
+    /// `start..=end` and hoist its inner pointer into a callee-saved register.
+    fn choose_hoisted_inner_ptr(&mut self, ops: &[MicroOp], start: usize, end: usize) {
+        let invariants = Self::analyze_loop_invariants(ops, start, end);
+        let heap2_usage = Self::count_heap2_obj_usage(ops, start, end);
+        let mut hoist_candidate: Option<(usize, usize)> = None;
+        for &(vreg_idx, _) in &invariants {
+            if let Some(&count) = heap2_usage.get(&vreg_idx)
+                && count >= 1
+                && (hoist_candidate.is_none() || count > hoist_candidate.unwrap().1)
+            {
+                hoist_candidate = Some((vreg_idx, count));
+            }
         }
-        if !self
-            .loop_regs
-            .keys()
-            .any(|k| self.all_reg_map.contains_key(k))
-        {
-            return; // loop_regs not active (outside loop), skip
+        if let Some((vreg_idx, _)) = hoist_candidate {
+            let reg = regs::CALLEE_SAVED[regs::CALLEE_SAVED.len() - 1];
+            self.hoisted_inner_ptrs.insert(vreg_idx, reg);
         }
-        self.emit_loop_reg_loads();
     }
 
     /// Compile a MicroOp function to native x86-64 code.
@@ -1012,6 +1156,7 @@ impl MicroOpJitCompiler {
         self.self_locals_count = locals_count;
         self.vreg_types = converted.vreg_types.clone();
         self.shadow_conflict_vregs = Self::compute_shadow_conflicts(&converted.micro_ops);
+        self.scalar_vregs = Self::compute_scalar_vregs(&converted.micro_ops, &self.vreg_types);
 
         // Pre-scan for inlinable call targets
         self.scan_inline_candidates(&converted.micro_ops, all_functions);
@@ -1027,84 +1172,22 @@ impl MicroOpJitCompiler {
             None
         };
 
-        // Pin function-wide invariant VRegs to callee-saved registers,
-        // with inner pointer hoisting for HeapLoad2/HeapStore2 hot objects.
-        // When a loop is detected, prioritize invariants by in-loop read count.
+        // Allocate registers over the whole function, after reserving one
+        // for the inner pointer of the hottest HeapLoad2/HeapStore2 object
+        // (counted in the inner loop, if there is one).
         if !converted.micro_ops.is_empty() {
-            let (inv_start, inv_end) = if let Some((ls, le)) = detected_loop {
-                (ls, le)
-            } else {
-                (0, converted.micro_ops.len() - 1)
-            };
-            let invariants =
-                Self::analyze_loop_invariants(&converted.micro_ops, inv_start, inv_end);
-            let heap2_usage = Self::count_heap2_obj_usage(&converted.micro_ops, inv_start, inv_end);
-
-            // Find the best hoisting candidate: invariant VReg used as HeapLoad2/HeapStore2 obj
-            let mut reg_idx = 0;
-            let mut hoist_candidate: Option<(usize, usize)> = None;
-            for &(vreg_idx, _) in &invariants {
-                if let Some(&count) = heap2_usage.get(&vreg_idx)
-                    && count >= 1
-                    && (hoist_candidate.is_none() || count > hoist_candidate.unwrap().1)
-                {
-                    hoist_candidate = Some((vreg_idx, count));
-                }
-            }
-
-            // Allocate: hoist first, then pin remaining
-            if let Some((vreg_idx, _)) = hoist_candidate
-                && reg_idx < regs::PIN_REGS.len()
-            {
-                self.hoisted_inner_ptrs
-                    .insert(vreg_idx, regs::PIN_REGS[reg_idx]);
-                reg_idx += 1;
-            }
-            for &(vreg_idx, _) in &invariants {
-                if reg_idx >= regs::PIN_REGS.len() {
-                    break;
-                }
-                if self.hoisted_inner_ptrs.contains_key(&vreg_idx) {
-                    continue;
-                }
-                self.pinned_vregs.insert(vreg_idx, regs::PIN_REGS[reg_idx]);
-                reg_idx += 1;
-            }
-
-            // Allocate LOOP_REGS for loop-variant VRegs.
-            if let Some((ls, le)) = detected_loop {
-                let variants = Self::analyze_loop_variants(&converted.micro_ops, ls, le);
-                let fused_only = Self::detect_fused_only_vregs(&converted.micro_ops, ls, le);
-                let mut loop_reg_idx = 0;
-                for (vreg_idx, _) in &variants {
-                    if loop_reg_idx >= regs::LOOP_REGS.len() {
-                        break;
-                    }
-                    if self.pinned_vregs.contains_key(vreg_idx) {
-                        continue;
-                    }
-                    if self.hoisted_inner_ptrs.contains_key(vreg_idx) {
-                        continue;
-                    }
-                    if fused_only.contains(vreg_idx) {
-                        continue;
-                    }
-                    self.loop_regs
-                        .insert(*vreg_idx, regs::LOOP_REGS[loop_reg_idx]);
-                    loop_reg_idx += 1;
-                }
-                self.loop_range = Some((ls, le));
-            }
-
-            // Initialize all_reg_map with pinned VRegs (loop_regs added at loop entry)
-            self.all_reg_map = self.pinned_vregs.clone();
-
-            if !self.pinned_vregs.is_empty() {
-                self.emit_pin_loads();
-            }
-            if !self.hoisted_inner_ptrs.is_empty() {
+            let ops = &converted.micro_ops;
+            let (hoist_start, hoist_end) = detected_loop.unwrap_or((0, ops.len() - 1));
+            self.choose_hoisted_inner_ptr(ops, hoist_start, hoist_end);
+            let live_in = self.allocate_registers(ops, 0, ops.len() - 1, &[]);
+            self.emit_root_slot_init(converted.arity);
+            self.emit_reg_transfers(&live_in, false);
+            // Hoisted out of the inner loop, the objects are set up on entry
+            // to it; hoisted out of a loop-free function, they are arguments
+            if detected_loop.is_none() && !self.hoisted_inner_ptrs.is_empty() {
                 self.emit_inner_ptr_loads();
             }
+            self.loop_range = detected_loop;
         }
 
         // Compute loop-scoped shadow conflicts and vreg type overrides.
@@ -1152,96 +1235,31 @@ impl MicroOpJitCompiler {
                 in_loop_scope = false;
             }
 
-            // Loop entry: activate loop_regs and swap in loop-scoped shadow state
+            // Loop entry: swap in loop-scoped shadow state
             if let Some((ls, _)) = self.loop_range
                 && pc == ls
+                && !in_loop_scope
             {
-                if !self.loop_regs.is_empty() {
-                    for (&vreg_idx, &reg) in &self.loop_regs.clone() {
-                        self.all_reg_map.insert(vreg_idx, reg);
-                    }
+                if let Some(ref lsc) = loop_shadow_conflicts {
+                    self.shadow_conflict_vregs = lsc.clone();
                 }
-                // Swap in loop-scoped shadow conflicts and vreg types
-                if !in_loop_scope {
-                    if let Some(ref lsc) = loop_shadow_conflicts {
-                        self.shadow_conflict_vregs = lsc.clone();
-                    }
-                    if let Some(ref lvt) = loop_vreg_types {
-                        self.vreg_types = lvt.clone();
-                    }
-                    in_loop_scope = true;
+                if let Some(ref lvt) = loop_vreg_types {
+                    self.vreg_types = lvt.clone();
+                }
+                in_loop_scope = true;
+                // Falls through from the code before the loop; the back
+                // edge jumps past this
+                if !self.hoisted_inner_ptrs.is_empty() {
+                    self.emit_inner_ptr_loads();
                 }
             }
 
-            // Set label BEFORE loop_reg_loads so forward jumps to ls execute the loads.
             self.labels.insert(pc, self.buf.len());
+            self.current_pc = pc;
 
-            // Emit loop_reg_loads after the label. Backward jump uses loop_body_offset
-            // (set below) to skip these loads and keep R10/R11 from the previous iteration.
-            if let Some((ls, _)) = self.loop_range
-                && pc == ls
-                && !self.loop_regs.is_empty()
-            {
-                self.emit_loop_reg_loads();
-                self.loop_body_offset = Some(self.buf.len());
-            }
-
-            // Loop exit branches: insert spills before exiting the loop
-            if let Some((ls, le)) = self.loop_range
-                && pc >= ls
-                && pc <= le
-                && !self.loop_regs.is_empty()
-            {
-                let next_pc = pc + 1;
-
-                // Fused CmpI64/CmpI64Imm + BrIfFalse/BrIf loop-exit
-                let next_is_loop_exit = next_pc < ops.len()
-                    && match &ops[next_pc] {
-                        MicroOp::BrIfFalse { target, .. } | MicroOp::BrIf { target, .. } => {
-                            *target > le
-                        }
-                        _ => false,
-                    };
-                if next_is_loop_exit
-                    && !jump_targets.contains(&next_pc)
-                    && let Some(fused) = self.try_fuse_loop_exit_cmp_branch(&ops[pc], &ops[next_pc])
-                {
-                    fused?;
-                    self.labels.insert(next_pc, self.buf.len());
-                    pc += 2;
-                    continue;
-                }
-
-                // Standalone BrIfFalse/BrIf loop-exit (not preceded by fusable CmpI64)
-                let is_loop_exit = match &ops[pc] {
-                    MicroOp::BrIfFalse { target, .. } | MicroOp::BrIf { target, .. } => {
-                        *target > le
-                    }
-                    _ => false,
-                };
-                if is_loop_exit {
-                    self.emit_loop_exit_branch(&ops[pc])?;
-                    pc += 1;
-                    continue;
-                }
-            }
-
-            // Peephole: fuse CmpI64/CmpI64Imm + BrIfFalse/BrIf (non-loop-exit)
+            // Peephole: fuse CmpI64/CmpI64Imm + BrIfFalse/BrIf
             let next_pc = pc + 1;
-            let next_is_loop_exit_for_fusion = if let Some((ls, le)) = self.loop_range {
-                !self.loop_regs.is_empty()
-                    && pc >= ls
-                    && pc <= le
-                    && match ops.get(next_pc) {
-                        Some(MicroOp::BrIfFalse { target, .. })
-                        | Some(MicroOp::BrIf { target, .. }) => *target > le,
-                        _ => false,
-                    }
-            } else {
-                false
-            };
             if next_pc < ops.len()
-                && !next_is_loop_exit_for_fusion
                 && !jump_targets.contains(&next_pc)
                 && let Some(fused) = self.try_fuse_cmp_branch(&ops[pc], &ops[next_pc])
             {
@@ -1251,36 +1269,6 @@ impl MicroOpJitCompiler {
                 continue;
             }
 
-            // Backward Jmp at loop_end: jump to loop_body_offset (after loads)
-            // instead of labels[ls] (before loads), then deactivate loop_regs.
-            if let Some((_, le)) = self.loop_range
-                && pc == le
-                && !self.loop_regs.is_empty()
-                && let Some(body_offset) = self.loop_body_offset
-            {
-                // Emit backward jump to loop body (skipping the loop_reg_loads)
-                let jmp_start = self.buf.len();
-                let mut asm = X86_64Assembler::new(&mut self.buf);
-                let rel = body_offset as i32 - (jmp_start as i32) - 5; // 5 = jmp rel32 size
-                asm.jmp_rel32(rel);
-
-                // Deactivate loop_regs and restore function-wide shadow state
-                for &vreg_idx in self.loop_regs.clone().keys() {
-                    self.all_reg_map.remove(&vreg_idx);
-                }
-                if in_loop_scope {
-                    if let Some(ref ssc) = saved_shadow_conflicts {
-                        self.shadow_conflict_vregs = ssc.clone();
-                    }
-                    if let Some(ref svt) = saved_vreg_types {
-                        self.vreg_types = svt.clone();
-                    }
-                    in_loop_scope = false;
-                }
-                pc += 1;
-                continue;
-            }
-
             self.compile_microop(&ops[pc], pc)?;
 
             pc += 1;
@@ -1307,7 +1295,7 @@ impl MicroOpJitCompiler {
         Ok(CompiledCode {
             memory,
             entry_offset: 0,
-            stack_map: HashMap::new(),
+            stack_map: self.stack_maps,
             total_regs: self.total_regs,
         })
     }
@@ -1329,6 +1317,11 @@ impl MicroOpJitCompiler {
         self.self_func_index = func_index;
         self.self_locals_count = locals_count;
         self.vreg_types = converted.vreg_types.clone();
+        for &(local, ty) in &self.type_guards {
+            if local < locals_count {
+                self.vreg_types[local] = ty;
+            }
+        }
         // For loop compilation, override vreg_types for VRegs whose loop-body
         // writes differ from the function-wide type assignment. This ensures
         // shadow_init and needs_shadow_update use the correct types for the loop.
@@ -1344,108 +1337,26 @@ impl MicroOpJitCompiler {
         self.shadow_conflict_vregs = Self::compute_shadow_conflicts(
             &converted.micro_ops[loop_start_microop_pc..=loop_end_microop_pc],
         );
+        self.scalar_vregs = Self::compute_scalar_vregs(&converted.micro_ops, &self.vreg_types);
 
-        // Pre-scan for inlinable call targets
-        self.scan_inline_candidates(&converted.micro_ops, all_functions);
-
-        // Emit prologue and shadow tag initialization
-        self.emit_prologue();
-        self.emit_shadow_init();
-
-        // Pin loop-invariant VRegs to callee-saved registers,
-        // with inner pointer hoisting for HeapLoad2/HeapStore2 hot objects.
-        let invariants = Self::analyze_loop_invariants(
-            &converted.micro_ops,
-            loop_start_microop_pc,
-            loop_end_microop_pc,
-        );
-        let heap2_usage = Self::count_heap2_obj_usage(
-            &converted.micro_ops,
-            loop_start_microop_pc,
-            loop_end_microop_pc,
-        );
-
-        let mut reg_idx = 0;
-        let mut hoist_candidate: Option<(usize, usize)> = None;
-        for &(vreg_idx, _) in &invariants {
-            if let Some(&count) = heap2_usage.get(&vreg_idx)
-                && count >= 1
-                && (hoist_candidate.is_none() || count > hoist_candidate.unwrap().1)
-            {
-                hoist_candidate = Some((vreg_idx, count));
-            }
-        }
-
-        if let Some((vreg_idx, _)) = hoist_candidate
-            && reg_idx < regs::PIN_REGS.len()
-        {
-            self.hoisted_inner_ptrs
-                .insert(vreg_idx, regs::PIN_REGS[reg_idx]);
-            reg_idx += 1;
-        }
-        for &(vreg_idx, _) in &invariants {
-            if reg_idx >= regs::PIN_REGS.len() {
-                break;
-            }
-            if self.hoisted_inner_ptrs.contains_key(&vreg_idx) {
-                continue;
-            }
-            self.pinned_vregs.insert(vreg_idx, regs::PIN_REGS[reg_idx]);
-            reg_idx += 1;
-        }
-
-        // Allocate LOOP_REGS for loop-variant VRegs
-        {
-            let variants = Self::analyze_loop_variants(
-                &converted.micro_ops,
-                loop_start_microop_pc,
-                loop_end_microop_pc,
-            );
-
-            // Detect "fused-only" VRegs: written only by CmpI64/CmpI64Imm and
-            // consumed only by BrIfFalse/BrIf immediately after. These don't
-            // benefit from being in registers since the cmp+branch is fused.
-            let fused_only = Self::detect_fused_only_vregs(
-                &converted.micro_ops,
-                loop_start_microop_pc,
-                loop_end_microop_pc,
-            );
-
-            let mut loop_reg_idx = 0;
-            for (vreg_idx, _) in variants {
-                if loop_reg_idx >= regs::LOOP_REGS.len() {
-                    break;
-                }
-                if self.pinned_vregs.contains_key(&vreg_idx) {
-                    continue;
-                }
-                if self.hoisted_inner_ptrs.contains_key(&vreg_idx) {
-                    continue;
-                }
-                if fused_only.contains(&vreg_idx) {
-                    continue;
-                }
-                self.loop_regs
-                    .insert(vreg_idx, regs::LOOP_REGS[loop_reg_idx]);
-                loop_reg_idx += 1;
-            }
-        }
+        // Pre-scan for inlinable call targets
+        self.scan_inline_candidates(&converted.micro_ops, all_functions);
 
-        // Initialize all_reg_map with pinned + loop regs
-        self.all_reg_map = self.pinned_vregs.clone();
-        for (&vreg_idx, &reg) in &self.loop_regs {
-            self.all_reg_map.insert(vreg_idx, reg);
-        }
+        // Emit prologue and shadow tag initialization
+        self.emit_prologue();
+        self.emit_shadow_init();
 
-        if !self.pinned_vregs.is_empty() {
-            self.emit_pin_loads();
-        }
+        // Allocate registers over the loop. The interpreter resumes with the
+        // locals when the loop exits, so they are all live there.
+        let ops = &converted.micro_ops;
+        self.choose_hoisted_inner_ptr(ops, loop_start_microop_pc, loop_end_microop_pc);
+        let locals: Vec<usize> = (0..locals_count).collect();
+        let live_in =
+            self.allocate_registers(ops, loop_start_microop_pc, loop_end_microop_pc, &locals);
+        self.emit_reg_transfers(&live_in, false);
         if !self.hoisted_inner_ptrs.is_empty() {
             self.emit_inner_ptr_loads();
         }
-        if !self.loop_regs.is_empty() {
-            self.emit_loop_reg_loads();
-        }
 
         // Epilogue label: one past the loop end
         let epilogue_label = loop_end_microop_pc + 1;
@@ -1467,6 +1378,7 @@ impl MicroOpJitCompiler {
         let mut pc = loop_start_microop_pc;
         while pc <= loop_end_microop_pc {
             self.labels.insert(pc, self.buf.len());
+            self.current_pc = pc;
 
             // Peephole: fuse CmpI64/CmpI64Imm + BrIfFalse/BrIf
             let next_pc = pc + 1;
@@ -1511,11 +1423,18 @@ impl MicroOpJitCompiler {
             pc += 1;
         }
 
-        // Emit epilogue label, spill loop regs, then epilogue code
+        // Emit epilogue label, write allocated locals back, then epilogue code
         self.labels.insert(epilogue_label, self.buf.len());
-        if !self.loop_regs.is_empty() {
-            self.emit_loop_reg_spills();
-        }
+        let mut exit_locals: Vec<usize> = self
+            .all_reg_map
+            .gpr
+            .keys()
+            .chain(self.all_reg_map.xmm.keys())
+            .copied()
+            .filter(|&v| v < locals_count)
+            .collect();
+        exit_locals.sort_unstable();
+        self.emit_reg_transfers(&exit_locals, true);
         self.emit_epilogue();
         self.patch_forward_refs();
 
@@ -1535,8 +1454,9 @@ impl MicroOpJitCompiler {
             entry_offset: 0,
             loop_start_pc: loop_start_op_pc,
             loop_end_pc: loop_end_op_pc,
-            stack_map: HashMap::new(),
+            stack_map: self.stack_maps,
             total_regs: self.total_regs,
+            guards: self.type_guards,
         })
     }
 
@@ -1596,6 +1516,28 @@ impl MicroOpJitCompiler {
         }
     }
 
+    /// Zero the frame slots of the non-argument VRegs that safepoints copy
+    /// to the root stack. A JIT caller does not clear the frame it allocates
+    /// on the native stack, so a VReg not written yet would otherwise hand
+    /// the GC a stale payload.
+    fn emit_root_slot_init(&mut self, arity: usize) {
+        let slots: BTreeSet<usize> = self
+            .call_live
+            .values()
+            .flatten()
+            .copied()
+            .filter(|v| *v >= arity && !self.scalar_vregs.contains(v))
+            .collect();
+        if slots.is_empty() {
+            return;
+        }
+        let mut asm = X86_64Assembler::new(&mut self.buf);
+        asm.mov_ri64(regs::TMP0, 0);
+        for v in slots {
+            asm.mov_mr(regs::FRAME_BASE, Self::vreg_offset(&VReg(v)), regs::TMP0);
+        }
+    }
+
     fn emit_epilogue(&mut self) {
         let mut asm = X86_64Assembler::new(&mut self.buf);
         asm.add_ri32(Reg::Rsp, 8);
@@ -1666,6 +1608,9 @@ impl MicroOpJitCompiler {
                     continue;
                 }
                 let callee = &all_functions[func_id];
+                if callee.code.decode().is_err() {
+                    continue; // Corrupt body; leave the call to report it
+                }
                 let callee_converted = microop_converter::convert(callee);
                 if Self::is_inlinable(&callee_converted) {
                     let non_arg_vregs =
@@ -1886,7 +1831,8 @@ impl MicroOpJitCompiler {
     // ==================== MicroOp compilation ====================
 
     fn compile_microop(&mut self, op: &MicroOp, _pc: usize) -> Result<(), String> {
-        match op {
+        let rooted = self.emit_safepoint_entry(op);
+        let result = match op {
             MicroOp::ConstI64 { dst, imm } => self.emit_const_i64(dst, *imm),
             MicroOp::ConstI32 { dst, imm } => self.emit_const_i64(dst, *imm as i64),
             MicroOp::Mov { dst, src } => self.emit_mov(dst, src),
@@ -1998,13 +1944,30 @@ impl MicroOpJitCompiler {
             MicroOp::RefIsNull { dst, src } => self.emit_ref_is_null(dst, src),
             MicroOp::RefNull { dst } => self.emit_ref_null(dst),
 
-            // Indirect call
-            MicroOp::CallIndirect { callee, args, ret } => {
-                self.emit_call_indirect(callee, args, ret.as_ref())
-            }
+            // Indirect and dynamic calls
+            MicroOp::CallIndirect {
+                callee,
+                args,
+                ret,
+                site,
+            } => self.emit_call_indirect(callee, args, ret.as_ref(), *site),
+            MicroOp::CallDynamic {
+                func_idx,
+                args,
+                ret,
+                site,
+            } => self.emit_call_dynamic(func_idx, args, ret.as_ref(), *site),
 
             // String operations
             MicroOp::StringConst { dst, idx } => self.emit_string_const(dst, *idx),
+            // Globals and interface dispatch
+            MicroOp::GlobalGet { dst, idx } => self.emit_global_get(dst, *idx),
+            MicroOp::VtableLookup {
+                dst,
+                type_info,
+                iface_desc,
+                site,
+            } => self.emit_vtable_lookup(dst, type_info, iface_desc, *site),
             // Heap allocation operations
             MicroOp::HeapAlloc { dst, args } => self.emit_heap_alloc(dst, args),
             MicroOp::HeapAllocDynSimple {
@@ -2012,6 +1975,7 @@ impl MicroOpJitCompiler {
                 size,
                 elem_kind,
             } => self.emit_heap_alloc_dyn_simple(dst, size, *elem_kind),
+            MicroOp::HeapBulk { dst, op, args } => self.emit_heap_bulk(dst.as_ref(), *op, args),
             // Stack bridge (spill/restore across calls)
             MicroOp::StackPush { src } => self.emit_stack_push(src),
             MicroOp::StackPop { dst } => self.emit_stack_pop(dst),
@@ -2020,7 +1984,11 @@ impl MicroOpJitCompiler {
                 "Unsupported MicroOp for JIT: {:?}",
                 std::mem::discriminant(op)
             )),
+        };
+        if rooted {
+            self.emit_safepoint_exit();
         }
+        result
     }
 
     // ==================== Constants ====================
@@ -2048,8 +2016,12 @@ impl MicroOpJitCompiler {
         let reg_map = &self.all_reg_map;
         let mut asm = X86_64Assembler::new(&mut self.buf);
         // Copy payload
-        Self::load_vreg(&mut asm, regs::TMP0, src, reg_map);
-        Self::store_vreg(&mut asm, regs::TMP0, dst, reg_map);
+        if let Some(src_xmm) = reg_map.xmm(src.0) {
+            Self::store_vreg_xmm(&mut asm, src_xmm, dst, reg_map);
+        } else {
+            Self::load_vreg(&mut asm, regs::TMP0, src, reg_map);
+            Self::store_vreg(&mut asm, regs::TMP0, dst, reg_map);
+        }
         // Copy shadow tag
         asm.mov_rm(regs::TMP0, regs::FRAME_BASE, src_shadow);
         asm.mov_mr(regs::FRAME_BASE, dst_shadow, regs::TMP0);
@@ -2073,7 +2045,7 @@ impl MicroOpJitCompiler {
             let b_reg = if let Some(&br) = reg_map.get(&b.0) {
                 br
             } else {
-                asm.mov_rm(regs::TMP1, regs::FRAME_BASE, Self::vreg_offset(b));
+                Self::load_vreg(&mut asm, regs::TMP1, b, reg_map);
                 regs::TMP1
             };
             match op {
@@ -2398,171 +2370,6 @@ impl MicroOpJitCompiler {
         Ok(())
     }
 
-    // ==================== Loop Exit Branch (with spill) ====================
-
-    /// Emit a loop exit branch with register spills.
-    /// For BrIfFalse: if cond is false → spill + jump to exit.
-    ///   Inverted: JNZ skip_spill; spill; JMP exit; skip_spill:
-    /// For BrIf: if cond is true → spill + jump to exit.
-    ///   Inverted: JE skip_spill; spill; JMP exit; skip_spill:
-    fn emit_loop_exit_branch(&mut self, op: &MicroOp) -> Result<(), String> {
-        let (cond, target, is_br_if_false) = match op {
-            MicroOp::BrIfFalse { cond, target } => (cond, *target, true),
-            MicroOp::BrIf { cond, target } => (cond, *target, false),
-            _ => return Err("Not a branch op".to_string()),
-        };
-
-        // Load condition and test
-        {
-            let reg_map = &self.all_reg_map;
-            let mut asm = X86_64Assembler::new(&mut self.buf);
-            Self::load_vreg(&mut asm, regs::TMP0, cond, reg_map);
-            asm.test_rr(regs::TMP0, regs::TMP0);
-        }
-
-        // Inverted branch: skip spill if NOT exiting
-        // BrIfFalse exits when cond==0 → skip when cond!=0 → JNZ
-        // BrIf exits when cond!=0 → skip when cond==0 → JE
-        let skip_offset = self.buf.len();
-        {
-            let mut asm = X86_64Assembler::new(&mut self.buf);
-            if is_br_if_false {
-                asm.jne_rel32(0); // skip if cond is true (loop continues)
-            } else {
-                asm.je_rel32(0); // skip if cond is false (loop continues)
-            }
-        }
-
-        // Spill loop regs to frame
-        self.emit_loop_reg_spills();
-
-        // Jump to exit target
-        {
-            let current = self.buf.len();
-            self.forward_refs.push((current, target, RefKind::Jmp));
-            let mut asm = X86_64Assembler::new(&mut self.buf);
-            asm.jmp_rel32(0);
-        }
-
-        // Patch skip_offset to jump here
-        let skip_target = self.buf.len();
-        let skip_rel = (skip_target as i32) - (skip_offset as i32) - 6; // 6 = JNE/JE rel32 instruction size
-        self.patch_i32(skip_offset + 2, skip_rel); // +2 = opcode prefix (0F 85/84)
-
-        Ok(())
-    }
-
-    /// Fused CmpI64/CmpI64Imm + BrIfFalse/BrIf for loop exit with spill.
-    /// Returns None if the pattern doesn't match.
-    fn try_fuse_loop_exit_cmp_branch(
-        &mut self,
-        cmp_op: &MicroOp,
-        branch_op: &MicroOp,
-    ) -> Option<Result<(), String>> {
-        let (cmp_dst, cmp_cond, load_a, load_b_or_imm) = match cmp_op {
-            MicroOp::CmpI64 { dst, a, b, cond } => (dst, cond, a, CmpOperand::Reg(b)),
-            MicroOp::CmpI64Imm { dst, a, imm, cond } => (dst, cond, a, CmpOperand::Imm(*imm)),
-            _ => return None,
-        };
-
-        let (branch_cond_vreg, target, is_br_if_false) = match branch_op {
-            MicroOp::BrIfFalse { cond, target } => (cond, *target, true),
-            MicroOp::BrIf { cond, target } => (cond, *target, false),
-            _ => return None,
-        };
-
-        // Branch must use the CmpI64 result
-        if branch_cond_vreg != cmp_dst {
-            return None;
-        }
-
-        Some(self.emit_fused_loop_exit_cmp_branch(
-            load_a,
-            load_b_or_imm,
-            cmp_cond,
-            target,
-            is_br_if_false,
-        ))
-    }
-
-    /// Emit fused CmpI64+BrIfFalse/BrIf with loop register spills on exit.
-    ///
-    /// For CmpI64(a, b, cond) + BrIfFalse(target=exit):
-    ///   "if !(a cond b), goto exit" → skip_spill when (a cond b) is true
-    ///   cmp a, b; j_cond skip_spill; spill; jmp exit; skip_spill:
-    ///
-    /// For CmpI64(a, b, cond) + BrIf(target=exit):
-    ///   "if (a cond b), goto exit" → skip_spill when (a cond b) is false
-    ///   cmp a, b; j_inv_cond skip_spill; spill; jmp exit; skip_spill:
-    fn emit_fused_loop_exit_cmp_branch(
-        &mut self,
-        a: &VReg,
-        b: CmpOperand,
-        cond: &CmpCond,
-        target: usize,
-        is_br_if_false: bool,
-    ) -> Result<(), String> {
-        // Load operand a
-        {
-            let reg_map = &self.all_reg_map;
-            let mut asm = X86_64Assembler::new(&mut self.buf);
-            Self::load_vreg(&mut asm, regs::TMP0, a, reg_map);
-        }
-
-        // Compare with operand b
-        match b {
-            CmpOperand::Reg(b_vreg) => {
-                let reg_map = &self.all_reg_map;
-                let mut asm = X86_64Assembler::new(&mut self.buf);
-                Self::load_vreg(&mut asm, regs::TMP1, b_vreg, reg_map);
-                asm.cmp_rr(regs::TMP0, regs::TMP1);
-            }
-            CmpOperand::Imm(imm) => {
-                if imm >= i32::MIN as i64 && imm <= i32::MAX as i64 {
-                    let mut asm = X86_64Assembler::new(&mut self.buf);
-                    asm.cmp_ri32(regs::TMP0, imm as i32);
-                } else {
-                    let mut asm = X86_64Assembler::new(&mut self.buf);
-                    asm.mov_ri64(regs::TMP1, imm);
-                    asm.cmp_rr(regs::TMP0, regs::TMP1);
-                }
-            }
-        }
-
-        // Determine skip_spill condition:
-        // BrIfFalse exits when cond is false → skip_spill when cond is true → direct x86_cond
-        // BrIf exits when cond is true → skip_spill when cond is false → inverted x86_cond
-        let mut x86_cond = Self::cmp_cond_to_x86(cond);
-        if !is_br_if_false {
-            x86_cond = x86_cond.invert();
-        }
-
-        // Emit Jcc to skip_spill
-        let skip_offset = self.buf.len();
-        {
-            let mut asm = X86_64Assembler::new(&mut self.buf);
-            asm.jcc_rel32(x86_cond, 0);
-        }
-
-        // Spill loop regs to frame
-        self.emit_loop_reg_spills();
-
-        // Jump to exit target
-        {
-            let current = self.buf.len();
-            self.forward_refs.push((current, target, RefKind::Jmp));
-            let mut asm = X86_64Assembler::new(&mut self.buf);
-            asm.jmp_rel32(0);
-        }
-
-        // Patch skip_offset to jump here (continue loop)
-        let skip_target = self.buf.len();
-        let skip_rel = (skip_target as i32) - (skip_offset as i32) - 6; // 6 = Jcc rel32 size
-        self.patch_i32(skip_offset + 2, skip_rel); // +2 = Jcc opcode prefix (0F xx)
-
-        Ok(())
-    }
-
     // ==================== Fused Cmp+Branch ====================
 
     fn try_fuse_cmp_branch(
@@ -2718,8 +2525,8 @@ impl MicroOpJitCompiler {
         let argc = args.len();
         let table_entry_offset = (func_id * 16) as i32;
 
-        // Spill loop-variant registers before call (R10/R11 are caller-saved)
-        self.emit_loop_reg_spills();
+        // Save caller-saved registers live across the call
+        self.emit_call_spills();
 
         // Load entry_addr from function table
         // TMP4 = table base, TMP5 = entry_addr
@@ -2805,15 +2612,16 @@ impl MicroOpJitCompiler {
         // Store return value: payload (RDX) to frame, tag (RAX) to shadow
         if let Some(ret_vreg) = ret {
             let shadow_off = self.shadow_tag_offset(ret_vreg);
+            let reg_map = &self.all_reg_map;
             let mut asm = X86_64Assembler::new(&mut self.buf);
-            asm.mov_mr(regs::FRAME_BASE, Self::vreg_offset(ret_vreg), Reg::Rdx);
+            Self::store_vreg(&mut asm, Reg::Rdx, ret_vreg, reg_map);
             asm.mov_mr(regs::FRAME_BASE, shadow_off, Reg::Rax);
         }
 
         // Reload hoisted inner pointers (callee may have mutated the heap)
         self.emit_inner_ptr_reloads();
-        // Reload loop-variant registers (R10/R11 are caller-saved)
-        self.emit_loop_reg_reloads();
+        // Restore caller-saved registers
+        self.emit_call_reloads();
 
         // jmp done (skip slow path)
         let jmp_done_site = self.buf.len();
@@ -2887,15 +2695,16 @@ impl MicroOpJitCompiler {
         // Store return value: payload (RDX) to frame, tag (RAX) to shadow
         if let Some(ret_vreg) = ret {
             let shadow_off = self.shadow_tag_offset(ret_vreg);
+            let reg_map = &self.all_reg_map;
             let mut asm = X86_64Assembler::new(&mut self.buf);
-            asm.mov_mr(regs::FRAME_BASE, Self::vreg_offset(ret_vreg), Reg::Rdx);
+            Self::store_vreg(&mut asm, Reg::Rdx, ret_vreg, reg_map);
             asm.mov_mr(regs::FRAME_BASE, shadow_off, Reg::Rax);
         }
 
         // Reload hoisted inner pointers (callee may have mutated the heap)
         self.emit_inner_ptr_reloads();
-        // Reload loop-variant registers (R10/R11 are caller-saved)
-        self.emit_loop_reg_reloads();
+        // Restore caller-saved registers
+        self.emit_call_reloads();
 
         let done_offset = self.buf.len();
 
@@ -2920,8 +2729,8 @@ impl MicroOpJitCompiler {
 
     fn emit_call_self(&mut self, args: &[VReg], ret: Option<&VReg>) -> Result<(), String> {
         let argc = args.len();
-        // Spill loop-variant registers before call (R10/R11 are caller-saved)
-        self.emit_loop_reg_spills();
+        // Save caller-saved registers live across the call
+        self.emit_call_spills();
         // Allocate new frame on native stack for callee (payload + shadow tags, 16B per VReg)
         let frame_size = self.total_regs * 16;
         let frame_aligned = (frame_size + 15) & !15;
@@ -2980,45 +2789,126 @@ impl MicroOpJitCompiler {
         // Store return value: payload (RDX) to frame, tag (RAX) to shadow
         if let Some(ret_vreg) = ret {
             let shadow_off = self.shadow_tag_offset(ret_vreg);
+            let reg_map = &self.all_reg_map;
             let mut asm = X86_64Assembler::new(&mut self.buf);
-            asm.mov_mr(regs::FRAME_BASE, Self::vreg_offset(ret_vreg), Reg::Rdx);
+            Self::store_vreg(&mut asm, Reg::Rdx, ret_vreg, reg_map);
             asm.mov_mr(regs::FRAME_BASE, shadow_off, Reg::Rax);
         }
 
         // Reload hoisted inner pointers (callee may have mutated the heap)
         self.emit_inner_ptr_reloads();
-        // Reload loop-variant registers (R10/R11 are caller-saved)
-        self.emit_loop_reg_reloads();
+        // Restore caller-saved registers
+        self.emit_call_reloads();
 
         Ok(())
     }
 
-    // ==================== CallIndirect ====================
+    // ==================== CallIndirect / CallDynamic ====================
 
+    /// JitCallContext offsets of global_get_helper and vtable_lookup_helper.
+    const GLOBAL_GET_HELPER_OFFSET: i32 = 88;
+    const VTABLE_LOOKUP_HELPER_OFFSET: i32 = 96;
+
+    /// Emit CallIndirect. The closure is passed as the callee's first argument.
     fn emit_call_indirect(
         &mut self,
         callee: &VReg,
         args: &[VReg],
         ret: Option<&VReg>,
+        site: usize,
     ) -> Result<(), String> {
-        let argc = args.len();
-        // Spill loop-variant registers before call (R10/R11 are caller-saved)
-        self.emit_loop_reg_spills();
-        let reg_map = &self.all_reg_map;
-
-        // Step 1: Resolve func_index from callee's heap object slot 0.
+        // Resolve func_index from callee's heap object slot 0.
         // func_index = heap[callee][0].payload
         // Address: heap_base + ref_bytes + 16 (header 8B + tag 8B = slot 0 payload)
+        // The callee is passed on as an argument; its static type may not say
+        // Ref (function-typed locals lower to I64), so fix its shadow tag.
+        let shadow_off = self.shadow_tag_offset(callee);
         {
+            let reg_map = &self.all_reg_map;
             let mut asm = X86_64Assembler::new(&mut self.buf);
             Self::load_vreg(&mut asm, regs::TMP0, callee, reg_map);
             asm.mov_rm(regs::TMP1, regs::VM_CTX, 48); // heap_base
             asm.add_rr(regs::TMP1, regs::TMP0); // heap_base + ref_bytes
-            // slot 0 payload at +16 (skip header 8B + tag 8B)
             asm.mov_rm(regs::TMP4, regs::TMP1, 16); // func_index in TMP4 (R8)
+            asm.mov_ri64(regs::TMP0, value_tags::TAG_PTR as i64);
+            asm.mov_mr(regs::FRAME_BASE, shadow_off, regs::TMP0);
         }
 
-        // Step 2: Allocate space on native stack for args array (16B per arg for JitValue)
+        let mut call_args = Vec::with_capacity(args.len() + 1);
+        call_args.push(*callee);
+        call_args.extend_from_slice(args);
+        self.emit_guarded_call(&call_args, ret, site)
+    }
+
+    /// Emit CallDynamic: the callee's func_index is the payload of `func_idx`.
+    fn emit_call_dynamic(
+        &mut self,
+        func_idx: &VReg,
+        args: &[VReg],
+        ret: Option<&VReg>,
+        site: usize,
+    ) -> Result<(), String> {
+        {
+            let reg_map = &self.all_reg_map;
+            let mut asm = X86_64Assembler::new(&mut self.buf);
+            Self::load_vreg(&mut asm, regs::TMP4, func_idx, reg_map);
+        }
+        self.emit_guarded_call(args, ret, site)
+    }
+
+    /// Emit a call to the func_index in TMP4. Each callee the site's inline
+    /// cache has seen gets a compare and a direct call (`emit_call`); any other
+    /// func_index goes through call_helper.
+    fn emit_guarded_call(
+        &mut self,
+        args: &[VReg],
+        ret: Option<&VReg>,
+        site: usize,
+    ) -> Result<(), String> {
+        let targets = self.call_targets.get(site).cloned().unwrap_or_default();
+        let mut done_sites = Vec::with_capacity(targets.len());
+        for target in targets {
+            let Ok(imm) = i32::try_from(target) else {
+                continue;
+            };
+            {
+                let mut asm = X86_64Assembler::new(&mut self.buf);
+                asm.cmp_ri32(regs::TMP4, imm);
+            }
+            let jne_site = self.buf.len();
+            {
+                let mut asm = X86_64Assembler::new(&mut self.buf);
+                asm.jne_rel32(0); // placeholder
+            }
+            self.emit_call(target, args, ret)?;
+            done_sites.push(self.buf.len());
+            {
+                let mut asm = X86_64Assembler::new(&mut self.buf);
+                asm.jmp_rel32(0); // placeholder
+            }
+            // jne_rel32 is 6 bytes: 0F 85 xx xx xx xx; rel32 is at offset+2
+            let next = self.buf.len();
+            self.patch_i32(jne_site + 2, next as i32 - (jne_site as i32 + 6));
+        }
+
+        self.emit_call_helper_dynamic(args, ret);
+
+        // jmp_rel32 is 5 bytes: E9 xx xx xx xx; rel32 is at offset+1
+        let done = self.buf.len();
+        for jmp_site in done_sites {
+            self.patch_i32(jmp_site + 1, done as i32 - (jmp_site as i32 + 5));
+        }
+        Ok(())
+    }
+
+    /// Call the func_index in TMP4 through call_helper (16B JitValue per arg,
+    /// tags from the shadow area).
+    fn emit_call_helper_dynamic(&mut self, args: &[VReg], ret: Option<&VReg>) {
+        let argc = args.len();
+        // Save caller-saved registers live across the call
+        self.emit_call_spills();
+
+        // Allocate space on native stack for args array (16B per arg for JitValue)
         let args_size = argc * 16;
         let args_aligned = (args_size + 15) & !15;
 
@@ -3027,7 +2917,7 @@ impl MicroOpJitCompiler {
             asm.sub_ri32(Reg::Rsp, args_aligned as i32);
         }
 
-        // Step 3: Copy args with tag from shadow area
+        // Copy args with tag from shadow area
         for (i, arg) in args.iter().enumerate() {
             let sp_tag_offset = (i * 16) as i32;
             let sp_payload_offset = sp_tag_offset + 8;
@@ -3040,14 +2930,14 @@ impl MicroOpJitCompiler {
             asm.mov_mr(Reg::Rsp, sp_payload_offset, regs::TMP0);
         }
 
-        // Step 4: Save callee-saved registers
+        // Save callee-saved registers
         {
             let mut asm = X86_64Assembler::new(&mut self.buf);
             asm.push(regs::VM_CTX);
             asm.push(regs::FRAME_BASE);
         }
 
-        // Step 5: Set up call arguments: RDI=ctx, RSI=func_index, RDX=argc, RCX=args_ptr
+        // Set up call arguments: RDI=ctx, RSI=func_index, RDX=argc, RCX=args_ptr
         // TMP4 (R8) still holds func_index
         {
             let mut asm = X86_64Assembler::new(&mut self.buf);
@@ -3058,14 +2948,14 @@ impl MicroOpJitCompiler {
             asm.add_ri32(Reg::Rcx, 16); // skip 2 pushed registers
         }
 
-        // Step 6: Load call_helper from JitCallContext offset 16 and call
+        // Load call_helper from JitCallContext offset 16 and call
         {
             let mut asm = X86_64Assembler::new(&mut self.buf);
             asm.mov_rm(regs::TMP4, regs::VM_CTX, 16);
             asm.call_r(regs::TMP4);
         }
 
-        // Step 7: Restore callee-saved registers
+        // Restore callee-saved registers
         {
             let mut asm = X86_64Assembler::new(&mut self.buf);
             asm.pop(regs::FRAME_BASE);
@@ -3081,16 +2971,74 @@ impl MicroOpJitCompiler {
         // Store return value: payload (RDX) to frame, tag (RAX) to shadow
         if let Some(ret_vreg) = ret {
             let shadow_off = self.shadow_tag_offset(ret_vreg);
+            let reg_map = &self.all_reg_map;
             let mut asm = X86_64Assembler::new(&mut self.buf);
-            asm.mov_mr(regs::FRAME_BASE, Self::vreg_offset(ret_vreg), Reg::Rdx);
+            Self::store_vreg(&mut asm, Reg::Rdx, ret_vreg, reg_map);
             asm.mov_mr(regs::FRAME_BASE, shadow_off, Reg::Rax);
         }
 
         // Reload hoisted inner pointers (callee may have mutated the heap)
         self.emit_inner_ptr_reloads();
-        // Reload loop-variant registers (R10/R11 are caller-saved)
-        self.emit_loop_reg_reloads();
+        // Restore caller-saved registers
+        self.emit_call_reloads();
+    }
+
+    // ==================== Globals / VtableLookup ====================
+
+    /// Emit GlobalGet: call global_get_helper(ctx, idx) -> (tag, payload).
+    fn emit_global_get(&mut self, dst: &VReg, idx: usize) -> Result<(), String> {
+        self.emit_call_spills();
+        let shadow_off = self.shadow_tag_offset(dst);
+        {
+            let reg_map = &self.all_reg_map;
+            let mut asm = X86_64Assembler::new(&mut self.buf);
+            asm.push(regs::VM_CTX);
+            asm.push(regs::FRAME_BASE);
+            // Args: RDI=ctx, RSI=global index
+            asm.mov_rr(Reg::Rdi, regs::VM_CTX);
+            asm.mov_ri64(Reg::Rsi, idx as i64);
+            asm.mov_rm(regs::TMP4, regs::VM_CTX, Self::GLOBAL_GET_HELPER_OFFSET);
+            asm.call_r(regs::TMP4);
+            asm.pop(regs::FRAME_BASE);
+            asm.pop(regs::VM_CTX);
+            Self::store_vreg(&mut asm, Reg::Rdx, dst, reg_map);
+            asm.mov_mr(regs::FRAME_BASE, shadow_off, Reg::Rax);
+        }
+        self.emit_call_reloads();
+        Ok(())
+    }
 
+    /// Emit VtableLookup: call vtable_lookup_helper(ctx, site_key, type_info,
+    /// iface_desc), which consults the VM's inline cache for this site.
+    /// The cache holds heap refs of one VM, so it stays out of the code.
+    fn emit_vtable_lookup(
+        &mut self,
+        dst: &VReg,
+        type_info: &VReg,
+        iface_desc: &VReg,
+        site: usize,
+    ) -> Result<(), String> {
+        self.emit_call_spills();
+        let site_key = ((self.self_func_index as u32 as u64) << 32) | site as u64;
+        let shadow_off = self.shadow_tag_offset(dst);
+        {
+            let reg_map = &self.all_reg_map;
+            let mut asm = X86_64Assembler::new(&mut self.buf);
+            // Args: RDI=ctx, RSI=site_key, RDX=type_info, RCX=iface_desc
+            Self::load_vreg(&mut asm, Reg::Rdx, type_info, reg_map);
+            Self::load_vreg(&mut asm, Reg::Rcx, iface_desc, reg_map);
+            asm.push(regs::VM_CTX);
+            asm.push(regs::FRAME_BASE);
+            asm.mov_rr(Reg::Rdi, regs::VM_CTX);
+            asm.mov_ri64(Reg::Rsi, site_key as i64);
+            asm.mov_rm(regs::TMP4, regs::VM_CTX, Self::VTABLE_LOOKUP_HELPER_OFFSET);
+            asm.call_r(regs::TMP4);
+            asm.pop(regs::FRAME_BASE);
+            asm.pop(regs::VM_CTX);
+            Self::store_vreg(&mut asm, Reg::Rdx, dst, reg_map);
+            asm.mov_mr(regs::FRAME_BASE, shadow_off, Reg::Rax);
+        }
+        self.emit_call_reloads();
         Ok(())
     }
 
@@ -3098,11 +3046,11 @@ impl MicroOpJitCompiler {
 
     fn emit_ret(&mut self, src: Option<&VReg>) -> Result<(), String> {
         if let Some(vreg) = src {
-            // Read tag from shadow area, payload from frame (or pinned reg)
+            // Read tag from shadow area, payload from frame (or its register)
             let shadow_off = self.shadow_tag_offset(vreg);
             let reg_map = &self.all_reg_map;
             let mut asm = X86_64Assembler::new(&mut self.buf);
-            // RAX = tag (from shadow), RDX = payload (from frame or pinned)
+            // RAX = tag (from shadow), RDX = payload
             asm.mov_rm(Reg::Rax, regs::FRAME_BASE, shadow_off);
             Self::load_vreg(&mut asm, Reg::Rdx, vreg, reg_map);
         } else {
@@ -3149,18 +3097,22 @@ impl MicroOpJitCompiler {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_FLOAT);
         let reg_map = &self.all_reg_map;
         let mut asm = X86_64Assembler::new(&mut self.buf);
-        Self::load_vreg(&mut asm, regs::TMP0, a, reg_map);
-        Self::load_vreg(&mut asm, regs::TMP1, b, reg_map);
-        asm.movq_xmm_r64(0, regs::TMP0);
-        asm.movq_xmm_r64(1, regs::TMP1);
+        // Compute in dst's own XMM register unless that would clobber b
+        let b_xmm = reg_map.xmm(b.0);
+        let acc = match reg_map.xmm(dst.0) {
+            Some(x) if b_xmm != Some(x) || a == b => x,
+            _ => regs::XMM_TMP0,
+        };
+        let rb = Self::load_vreg_xmm(&mut asm, regs::XMM_TMP1, b, reg_map);
+        Self::load_vreg_to_xmm(&mut asm, acc, a, reg_map);
+        let rb = if a == b { acc } else { rb };
         match op {
-            FpBinOp::Add => asm.addsd(0, 1),
-            FpBinOp::Sub => asm.subsd(0, 1),
-            FpBinOp::Mul => asm.mulsd(0, 1),
-            FpBinOp::Div => asm.divsd(0, 1),
+            FpBinOp::Add => asm.addsd(acc, rb),
+            FpBinOp::Sub => asm.subsd(acc, rb),
+            FpBinOp::Mul => asm.mulsd(acc, rb),
+            FpBinOp::Div => asm.divsd(acc, rb),
         }
-        asm.movq_r64_xmm(regs::TMP0, 0);
-        Self::store_vreg(&mut asm, regs::TMP0, dst, reg_map);
+        Self::store_vreg_xmm(&mut asm, acc, dst, reg_map);
         if let Some(off) = shadow {
             Self::emit_shadow_update(&mut asm, off, value_tags::TAG_FLOAT);
         }
@@ -3192,11 +3144,9 @@ impl MicroOpJitCompiler {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let reg_map = &self.all_reg_map;
         let mut asm = X86_64Assembler::new(&mut self.buf);
-        Self::load_vreg(&mut asm, regs::TMP0, a, reg_map);
-        Self::load_vreg(&mut asm, regs::TMP1, b, reg_map);
-        asm.movq_xmm_r64(0, regs::TMP0);
-        asm.movq_xmm_r64(1, regs::TMP1);
-        asm.ucomisd(0, 1);
+        let ra = Self::load_vreg_xmm(&mut asm, regs::XMM_TMP0, a, reg_map);
+        let rb = Self::load_vreg_xmm(&mut asm, regs::XMM_TMP1, b, reg_map);
+        asm.ucomisd(ra, rb);
         asm.setcc(x86_cond, regs::TMP0);
         asm.movzx_r64_r8(regs::TMP0, regs::TMP0);
         Self::store_vreg(&mut asm, regs::TMP0, dst, reg_map);
@@ -3259,9 +3209,9 @@ impl MicroOpJitCompiler {
         let reg_map = &self.all_reg_map;
         let mut asm = X86_64Assembler::new(&mut self.buf);
         Self::load_vreg(&mut asm, regs::TMP0, src, reg_map);
-        asm.cvtsi2sd_xmm_r64(0, regs::TMP0);
-        asm.movq_r64_xmm(regs::TMP0, 0);
-        Self::store_vreg(&mut asm, regs::TMP0, dst, reg_map);
+        let out = reg_map.xmm(dst.0).unwrap_or(regs::XMM_TMP0);
+        asm.cvtsi2sd_xmm_r64(out, regs::TMP0);
+        Self::store_vreg_xmm(&mut asm, out, dst, reg_map);
         if let Some(off) = shadow {
             Self::emit_shadow_update(&mut asm, off, value_tags::TAG_FLOAT);
         }
@@ -3273,9 +3223,8 @@ impl MicroOpJitCompiler {
         let shadow = self.needs_shadow_update(dst, value_tags::TAG_INT);
         let reg_map = &self.all_reg_map;
         let mut asm = X86_64Assembler::new(&mut self.buf);
-        Self::load_vreg(&mut asm, regs::TMP0, src, reg_map);
-        asm.movq_xmm_r64(0, regs::TMP0);
-        asm.cvttsd2si_r64_xmm(regs::TMP0, 0);
+        let x = Self::load_vreg_xmm(&mut asm, regs::XMM_TMP0, src, reg_map);
+        asm.cvttsd2si_r64_xmm(regs::TMP0, x);
         Self::store_vreg(&mut asm, regs::TMP0, dst, reg_map);
         if let Some(off) = shadow {
             Self::emit_shadow_update(&mut asm, off, value_tags::TAG_INT);
@@ -3385,10 +3334,11 @@ impl MicroOpJitCompiler {
             code[je_pos + 2..je_pos + 6].copy_from_slice(&offset.to_le_bytes());
         }
 
-        // Spill loop-variant registers before helper call (R10/R11 are caller-saved)
-        self.emit_loop_reg_spills();
+        // Save caller-saved registers live across the call
+        self.emit_call_spills();
 
         {
+            let reg_map = &self.all_reg_map;
             let mut asm = X86_64Assembler::new(&mut self.buf);
             // Save callee-saved
             asm.push(regs::VM_CTX);
@@ -3402,14 +3352,14 @@ impl MicroOpJitCompiler {
             // Restore callee-saved
             asm.pop(regs::FRAME_BASE);
             asm.pop(regs::VM_CTX);
-            // Store result to FRAME directly (not via store_vreg) so that
-            // emit_loop_reg_reloads picks up the new value from frame.
-            asm.mov_mr(regs::FRAME_BASE, Self::vreg_offset(dst), Reg::Rdx);
+            Self::store_vreg(&mut asm, Reg::Rdx, dst, reg_map);
             asm.mov_mr(regs::FRAME_BASE, shadow_off, Reg::Rax);
         }
 
-        // Reload loop-variant registers after helper call
-        self.emit_loop_reg_reloads();
+        // Reload hoisted inner pointers (the heap may have grown)
+        self.emit_inner_ptr_reloads();
+        // Restore caller-saved registers
+        self.emit_call_reloads();
 
         // === END ===
         let end_pos = self.buf.len();
@@ -3433,8 +3383,8 @@ impl MicroOpJitCompiler {
         elem_kind: crate::vm::ElemKind,
     ) -> Result<(), String> {
         let dst_shadow_off = self.shadow_tag_offset(dst);
-        // Spill loop-variant registers before helper call (R10/R11 are caller-saved)
-        self.emit_loop_reg_spills();
+        // Save caller-saved registers live across the call
+        self.emit_call_spills();
         {
             let reg_map = &self.all_reg_map;
             let mut asm = X86_64Assembler::new(&mut self.buf);
@@ -3442,8 +3392,8 @@ impl MicroOpJitCompiler {
             asm.push(regs::VM_CTX);
             asm.push(regs::FRAME_BASE);
             // Args: RDI=ctx, RSI=size (payload only), RDX=elem_kind
-            asm.mov_rr(Reg::Rdi, regs::VM_CTX);
             Self::load_vreg(&mut asm, Reg::Rsi, size, reg_map);
+            asm.mov_rr(Reg::Rdi, regs::VM_CTX);
             asm.mov_ri32(Reg::Rdx, elem_kind as u8 as i32);
             // Load heap_alloc_dyn_simple_helper from JitCallContext offset 72
             asm.mov_rm(regs::TMP4, regs::VM_CTX, 72);
@@ -3451,14 +3401,79 @@ impl MicroOpJitCompiler {
             // Restore callee-saved
             asm.pop(regs::FRAME_BASE);
             asm.pop(regs::VM_CTX);
-            // Store result to FRAME directly (not via store_vreg) so that
-            // emit_loop_reg_reloads picks up the new value from frame.
-            asm.mov_mr(regs::FRAME_BASE, Self::vreg_offset(dst), Reg::Rdx);
+            Self::store_vreg(&mut asm, Reg::Rdx, dst, reg_map);
             asm.mov_mr(regs::FRAME_BASE, dst_shadow_off, Reg::Rax);
         }
-        // Reload loop-variant registers after helper call
-        // (if dst is a loop-reg, reload picks up the new value from frame)
-        self.emit_loop_reg_reloads();
+        // Reload hoisted inner pointers (the heap may have grown)
+        self.emit_inner_ptr_reloads();
+        // Restore caller-saved registers
+        self.emit_call_reloads();
+        Ok(())
+    }
+
+    /// JitCallContext offset of heap_bulk_helper.
+    const HEAP_BULK_HELPER_OFFSET: i32 = 104;
+
+    /// Emit HeapBulk: call heap_bulk_helper(ctx, op, argc, args_ptr) with
+    /// the operands as 16B JitValues (tags from the shadow area).
+    fn emit_heap_bulk(
+        &mut self,
+        dst: Option<&VReg>,
+        op: BulkOp,
+        args: &[VReg],
+    ) -> Result<(), String> {
+        let argc = args.len();
+        // Save caller-saved registers live across the call
+        self.emit_call_spills();
+
+        let args_aligned = (argc * 16 + 15) & !15;
+        {
+            let mut asm = X86_64Assembler::new(&mut self.buf);
+            asm.sub_ri32(Reg::Rsp, args_aligned as i32);
+        }
+        for (i, arg) in args.iter().enumerate() {
+            let sp_tag_offset = (i * 16) as i32;
+            let shadow_off = self.shadow_tag_offset(arg);
+            let reg_map = &self.all_reg_map;
+            let mut asm = X86_64Assembler::new(&mut self.buf);
+            // Arrays and ints are tagged statically; only a fill or find
+            // value needs its shadow tag
+            match op.operand(i) {
+                Operand::Array => asm.mov_ri64(regs::TMP0, value_tags::TAG_PTR as i64),
+                Operand::Int => asm.mov_ri64(regs::TMP0, value_tags::TAG_INT as i64),
+                Operand::Value => asm.mov_rm(regs::TMP0, regs::FRAME_BASE, shadow_off),
+            }
+            asm.mov_mr(Reg::Rsp, sp_tag_offset, regs::TMP0);
+            Self::load_vreg(&mut asm, regs::TMP0, arg, reg_map);
+            asm.mov_mr(Reg::Rsp, sp_tag_offset + 8, regs::TMP0);
+        }
+        {
+            let mut asm = X86_64Assembler::new(&mut self.buf);
+            asm.push(regs::VM_CTX);
+            asm.push(regs::FRAME_BASE);
+            // Args: RDI=ctx, RSI=op, RDX=argc, RCX=args_ptr
+            asm.mov_rr(Reg::Rdi, regs::VM_CTX);
+            asm.mov_ri32(Reg::Rsi, op as u8 as i32);
+            asm.mov_ri32(Reg::Rdx, argc as i32);
+            asm.mov_rr(Reg::Rcx, Reg::Rsp);
+            asm.add_ri32(Reg::Rcx, 16); // skip 2 pushed registers
+            asm.mov_rm(regs::TMP4, regs::VM_CTX, Self::HEAP_BULK_HELPER_OFFSET);
+            asm.call_r(regs::TMP4);
+            asm.pop(regs::FRAME_BASE);
+            asm.pop(regs::VM_CTX);
+            asm.add_ri32(Reg::Rsp, args_aligned as i32);
+        }
+        if let Some(dst) = dst {
+            let shadow_off = self.shadow_tag_offset(dst);
+            let reg_map = &self.all_reg_map;
+            let mut asm = X86_64Assembler::new(&mut self.buf);
+            Self::store_vreg(&mut asm, Reg::Rdx, dst, reg_map);
+            asm.mov_mr(regs::FRAME_BASE, shadow_off, Reg::Rax);
+        }
+        // Reload hoisted inner pointers (the heap may have grown)
+        self.emit_inner_ptr_reloads();
+        // Restore caller-saved registers
+        self.emit_call_reloads();
         Ok(())
     }
 
@@ -3466,10 +3481,11 @@ impl MicroOpJitCompiler {
     fn emit_heap_alloc(&mut self, dst: &VReg, args: &[VReg]) -> Result<(), String> {
         let size = args.len();
         let dst_shadow_off = self.shadow_tag_offset(dst);
-        // Spill loop-variant registers before helper call (R10/R11 are caller-saved)
-        self.emit_loop_reg_spills();
+        // Save caller-saved registers live across the call
+        self.emit_call_spills();
         // 1. Call alloc helper to allocate size null-initialized slots
         {
+            let reg_map = &self.all_reg_map;
             let mut asm = X86_64Assembler::new(&mut self.buf);
             asm.push(regs::VM_CTX);
             asm.push(regs::FRAME_BASE);
@@ -3481,13 +3497,13 @@ impl MicroOpJitCompiler {
             asm.call_r(regs::TMP4);
             asm.pop(regs::FRAME_BASE);
             asm.pop(regs::VM_CTX);
-            // Store result to FRAME directly (not via store_vreg) so that
-            // emit_loop_reg_reloads picks up the new value from frame.
-            asm.mov_mr(regs::FRAME_BASE, Self::vreg_offset(dst), Reg::Rdx);
+            Self::store_vreg(&mut asm, Reg::Rdx, dst, reg_map);
             asm.mov_mr(regs::FRAME_BASE, dst_shadow_off, Reg::Rax);
         }
-        // Reload loop-variant registers after helper call
-        self.emit_loop_reg_reloads();
+        // Reload hoisted inner pointers (the heap may have grown)
+        self.emit_inner_ptr_reloads();
+        // Restore caller-saved registers
+        self.emit_call_reloads();
         // 2. Store each arg into the allocated object's slots
         for (i, arg) in args.iter().enumerate() {
             self.emit_heap_store(dst, i, arg)?;
@@ -3702,7 +3718,7 @@ impl MicroOpJitCompiler {
         elem_kind: ElemKind,
     ) -> Result<(), String> {
         // Optimized path: inner pointer is hoisted into a register
-        if let Some(&inner_base_reg) = self.hoisted_inner_ptrs.get(&obj.0) {
+        if let Some(inner_base_reg) = self.hoisted_inner_ptr(obj) {
             // Pre-compute shadow update info before borrowing self.buf
             let shadow = match elem_kind {
                 ElemKind::Tagged => Some(self.shadow_tag_offset(dst)),
@@ -3862,7 +3878,7 @@ impl MicroOpJitCompiler {
         let shadow_off = self.shadow_tag_offset(src);
 
         // Optimized path: inner pointer is hoisted into a register
-        if let Some(&inner_base_reg) = self.hoisted_inner_ptrs.get(&obj.0) {
+        if let Some(inner_base_reg) = self.hoisted_inner_ptr(obj) {
             let reg_map = &self.all_reg_map;
             let mut asm = X86_64Assembler::new(&mut self.buf);
             // TMP5 = payload
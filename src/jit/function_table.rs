@@ -11,6 +11,7 @@
 ///
 /// This table is writable and can be updated as new functions are compiled.
 /// JIT-generated code reads from this table to resolve call targets at runtime.
+#[derive(Clone)]
 pub struct JitFunctionTable {
     /// Flat array: [entry_0, total_regs_0, entry_1, total_regs_1, ...]
     data: Vec<u64>,
@@ -200,6 +200,19 @@ pub struct JitCallContext {
     /// Layout: [entry_0, total_regs_0, entry_1, total_regs_1, ...] (u64 pairs).
     /// entry == 0 means the function is not yet JIT-compiled.
     pub jit_function_table: *const u64,
+    /// Global load helper: (ctx, global_index) -> JitReturn
+    pub global_get_helper: unsafe extern "C" fn(*mut JitCallContext, u64) -> JitReturn,
+    /// Vtable lookup helper: (ctx, site_key, type_info_ref, iface_desc_ref) -> JitReturn
+    /// (vtable Ref or nil). `site_key` is `func_index << 32 | site`; the
+    /// lookup goes through the VM's inline cache for that site.
+    pub vtable_lookup_helper: unsafe extern "C" fn(*mut JitCallContext, u64, u64, u64) -> JitReturn,
+    /// HeapBulk helper: (ctx, bulk_op, argc, args_ptr) -> JitReturn (the op's
+    /// result, or nil)
+    pub heap_bulk_helper:
+        unsafe extern "C" fn(*mut JitCallContext, u64, u64, *const JitValue) -> JitReturn,
+    /// Root stack that safepoints copy the references of their frame to,
+    /// shared by all JIT code the VM is running
+    pub gc_roots: *mut super::stackmap::RootStack,
 }
 
 /// Type signature for call helper function.
@@ -32,6 +32,8 @@ impl std::error::Error for MemoryError {}
 pub struct ExecutableMemory {
     ptr: NonNull<u8>,
     size: usize,
+    /// End of the written code (`size` is rounded up to whole pages)
+    len: usize,
     executable: bool,
 }
 
@@ -52,6 +54,7 @@ impl ExecutableMemory {
         Ok(Self {
             ptr,
             size: aligned_size,
+            len: 0,
             executable: false,
         })
     }
@@ -137,10 +140,16 @@ impl ExecutableMemory {
             let dest = self.ptr.as_ptr().add(offset);
             std::ptr::copy_nonoverlapping(data.as_ptr(), dest, data.len());
         }
+        self.len = self.len.max(offset + data.len());
 
         Ok(())
     }
 
+    /// The bytes written so far.
+    pub fn code(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.ptr.as_ptr(), self.len) }
+    }
+
     /// Make the memory executable (and read-only).
     /// After this call, the memory can no longer be written to.
     #[cfg(unix)]
@@ -244,6 +253,15 @@ mod tests {
         mem.write(0, &data).unwrap();
     }
 
+    #[test]
+    fn test_code_is_written_range() {
+        let mut mem = ExecutableMemory::new(16).unwrap();
+        mem.write(0, &[0x90, 0x90]).unwrap();
+        mem.write(4, &[0xc3]).unwrap();
+        mem.make_executable().unwrap();
+        assert_eq!(mem.code(), [0x90, 0x90, 0, 0, 0xc3]);
+    }
+
     #[test]
     fn test_make_executable() {
         let mut mem = ExecutableMemory::new(4096).unwrap();
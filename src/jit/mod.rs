@@ -6,7 +6,10 @@
 //! - AArch64 instruction encoding
 //! - x86-64 instruction encoding
 //! - Template-based bytecode compiler
+//! - Linear-scan register allocation for the MicroOp backends
+//! - Background compilation queue
 //! - Stack maps for GC integration
+//! - Persistent on-disk cache of compiled code
 //!
 //! This module is only compiled when the `jit` feature is enabled.
 //! Use `cargo build --features jit` to include JIT support.
@@ -16,7 +19,9 @@
 
 #[cfg(target_arch = "aarch64")]
 pub mod aarch64;
+pub mod cache;
 mod codebuf;
+pub mod compile_queue;
 #[cfg(target_arch = "aarch64")]
 pub mod compiler;
 #[cfg(target_arch = "aarch64")]
@@ -28,6 +33,7 @@ pub mod compiler_x86_64;
 pub mod function_table;
 pub mod marshal;
 mod memory;
+pub mod regalloc;
 pub mod stackmap;
 #[cfg(target_arch = "x86_64")]
 pub mod x86_64;
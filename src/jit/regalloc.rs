@@ -0,0 +1,818 @@
+//! Linear-scan register allocation for the MicroOp JIT backends.
+//!
+//! The backends address every VReg through its frame slot. This pass picks
+//! the VRegs worth keeping in hardware registers over a range of MicroOps
+//! (a whole function, or one loop for the loop JIT) and leaves the rest in
+//! their slots, so spilling costs nothing extra: a spilled VReg is simply
+//! one the allocator did not assign.
+//!
+//! Liveness is computed per MicroOp over the CFG formed by `Jmp`, `BrIf`,
+//! `BrIfFalse` and `Ret`. A VReg occupies every op where it is live on
+//! entry or defined, which gives a lifetime interval with holes; two VRegs
+//! can share a register when their intervals do not overlap. Intervals are
+//! scanned by start position. When no register is free, the interval with
+//! the lower spill weight (uses weighted by loop depth) goes to memory.
+//!
+//! Assignments are for the whole range, so control flow needs no
+//! reconciliation. Registers the native ABI does not preserve across calls
+//! are saved around each call that a VReg in one is live across; the
+//! allocation lists them per call in `call_saves`.
+
+use crate::vm::microop::MicroOp;
+use std::collections::{HashMap, HashSet};
+
+/// Which register file a VReg is allocated from.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum RegClass {
+    Int,
+    Float,
+}
+
+/// Registers of one class available to the allocator. Indices
+/// `0..callee_saved` name callee-saved registers, the following
+/// `caller_saved` indices registers a call clobbers.
+#[derive(Debug, Clone, Copy, Default)]
+pub struct RegFile {
+    pub callee_saved: usize,
+    pub caller_saved: usize,
+}
+
+impl RegFile {
+    fn len(&self) -> usize {
+        self.callee_saved + self.caller_saved
+    }
+
+    fn is_callee_saved(&self, reg: usize) -> bool {
+        reg < self.callee_saved
+    }
+}
+
+/// When an op that calls out reads its operands.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CallKind {
+    /// Operands are loaded before the call (arguments)
+    ReadsBefore,
+    /// The op calls first and reads operands after it returns (`HeapAlloc`
+    /// allocates, then stores the field values)
+    ReadsAfter,
+}
+
+/// The range to allocate and the target's register files.
+pub struct AllocRequest<'a> {
+    pub ops: &'a [MicroOp],
+    /// First and last MicroOp PC of the range (inclusive)
+    pub start: usize,
+    pub end: usize,
+    pub int: RegFile,
+    pub float: RegFile,
+    /// VRegs live when control leaves the range other than through `Ret`
+    pub live_out: &'a [usize],
+    /// Whether the op's code calls out and clobbers caller-saved registers
+    pub call_kind: &'a dyn Fn(&MicroOp) -> Option<CallKind>,
+    /// VRegs the backend never reads or writes through a register
+    pub memory_only: &'a HashSet<usize>,
+}
+
+/// Result of `allocate`.
+#[derive(Debug, Default)]
+pub struct Allocation {
+    /// VReg index → register; unlisted VRegs stay in their frame slot
+    pub regs: HashMap<usize, (RegClass, usize)>,
+    /// Call PC → VRegs in caller-saved registers live across that call,
+    /// to be stored before it and reloaded after it
+    pub call_saves: HashMap<usize, Vec<usize>>,
+    /// Call PC → every VReg live across that call, in order; the GC
+    /// safepoint of the call has to find the references among them
+    pub call_live: HashMap<usize, Vec<usize>>,
+    /// Allocated VRegs live on entry to the range, to be loaded from their
+    /// slots first
+    pub live_in: Vec<usize>,
+}
+
+impl Allocation {
+    pub fn get(&self, vreg: usize) -> Option<(RegClass, usize)> {
+        self.regs.get(&vreg).copied()
+    }
+
+    /// Callee-saved registers of `class` that are in use.
+    pub fn used_callee_saved(&self, class: RegClass, file: RegFile) -> Vec<usize> {
+        let mut used: Vec<usize> = self
+            .regs
+            .values()
+            .filter(|(c, reg)| *c == class && file.is_callee_saved(*reg))
+            .map(|(_, reg)| *reg)
+            .collect();
+        used.sort_unstable();
+        used.dedup();
+        used
+    }
+}
+
+/// A fixed-size set of small integers.
+#[derive(Debug, Clone, PartialEq, Eq)]
+struct BitSet(Vec<u64>);
+
+impl BitSet {
+    fn new(len: usize) -> Self {
+        BitSet(vec![0; len.div_ceil(64)])
+    }
+
+    fn insert(&mut self, i: usize) {
+        self.0[i / 64] |= 1 << (i % 64);
+    }
+
+    fn remove(&mut self, i: usize) {
+        self.0[i / 64] &= !(1 << (i % 64));
+    }
+
+    fn contains(&self, i: usize) -> bool {
+        self.0[i / 64] & (1 << (i % 64)) != 0
+    }
+
+    fn union_with(&mut self, other: &BitSet) {
+        for (a, b) in self.0.iter_mut().zip(&other.0) {
+            *a |= b;
+        }
+    }
+
+    fn subtract(&mut self, other: &BitSet) {
+        for (a, b) in self.0.iter_mut().zip(&other.0) {
+            *a &= !b;
+        }
+    }
+
+    fn intersects(&self, other: &BitSet) -> bool {
+        self.0.iter().zip(&other.0).any(|(a, b)| a & b != 0)
+    }
+
+    fn iter(&self) -> impl Iterator<Item = usize> + '_ {
+        self.0.iter().enumerate().flat_map(|(w, &bits)| {
+            (0..64)
+                .filter(move |b| bits & (1 << b) != 0)
+                .map(move |b| w * 64 + b)
+        })
+    }
+
+    fn first(&self) -> Option<usize> {
+        self.0
+            .iter()
+            .enumerate()
+            .find(|(_, bits)| **bits != 0)
+            .map(|(w, bits)| w * 64 + bits.trailing_zeros() as usize)
+    }
+}
+
+/// An operand with the register class its op would like it in, if any.
+type Operand = (usize, Option<RegClass>);
+
+/// VRegs `op` reads and the VReg it writes.
+pub fn operands(op: &MicroOp) -> (Vec<usize>, Option<usize>) {
+    let (uses, def) = classed_operands(op);
+    (
+        uses.into_iter().map(|(v, _)| v).collect(),
+        def.map(|(v, _)| v),
+    )
+}
+
+fn classed_operands(op: &MicroOp) -> (Vec<Operand>, Option<Operand>) {
+    use RegClass::{Float, Int};
+    let any = |v: &crate::vm::microop::VReg| (v.0, None);
+    let int = |v: &crate::vm::microop::VReg| (v.0, Some(Int));
+    let float = |v: &crate::vm::microop::VReg| (v.0, Some(Float));
+    match op {
+        MicroOp::Jmp { .. } | MicroOp::Raw { .. } => (vec![], None),
+        MicroOp::CmpI64BrIfFalse { .. }
+        | MicroOp::CmpI64ImmBrIfFalse { .. }
+        | MicroOp::CmpF64BrIfFalse { .. }
+        | MicroOp::MulF64AddF64 { .. }
+        | MicroOp::ConstF64MulF64 { .. }
+        | MicroOp::ConstF64DivF64 { .. } => {
+            unreachable!("superinstructions are only fused for the interpreter")
+        }
+        MicroOp::BrIf { cond, .. } | MicroOp::BrIfFalse { cond, .. } => (vec![int(cond)], None),
+        MicroOp::Call { args, ret, .. } => (args.iter().map(any).collect(), ret.as_ref().map(any)),
+        MicroOp::CallIndirect {
+            callee: head,
+            args,
+            ret,
+            ..
+        }
+        | MicroOp::CallDynamic {
+            func_idx: head,
+            args,
+            ret,
+            ..
+        } => {
+            let mut uses = vec![any(head)];
+            uses.extend(args.iter().map(any));
+            (uses, ret.as_ref().map(any))
+        }
+        MicroOp::Ret { src } => (src.iter().map(any).collect(), None),
+        MicroOp::Mov { dst, src } => (vec![any(src)], Some(any(dst))),
+        MicroOp::ConstI64 { dst, .. } | MicroOp::ConstI32 { dst, .. } => (vec![], Some(int(dst))),
+        MicroOp::ConstF64 { dst, .. } | MicroOp::ConstF32 { dst, .. } => (vec![], Some(float(dst))),
+        MicroOp::AddI64 { dst, a, b }
+        | MicroOp::SubI64 { dst, a, b }
+        | MicroOp::MulI64 { dst, a, b }
+        | MicroOp::DivI64 { dst, a, b }
+        | MicroOp::RemI64 { dst, a, b }
+        | MicroOp::AndI64 { dst, a, b }
+        | MicroOp::OrI64 { dst, a, b }
+        | MicroOp::XorI64 { dst, a, b }
+        | MicroOp::ShlI64 { dst, a, b }
+        | MicroOp::ShrI64 { dst, a, b }
+        | MicroOp::ShrU64 { dst, a, b }
+        | MicroOp::UMul128Hi { dst, a, b }
+        | MicroOp::AddI32 { dst, a, b }
+        | MicroOp::SubI32 { dst, a, b }
+        | MicroOp::MulI32 { dst, a, b }
+        | MicroOp::DivI32 { dst, a, b }
+        | MicroOp::RemI32 { dst, a, b }
+        | MicroOp::CmpI64 { dst, a, b, .. }
+        | MicroOp::CmpI32 { dst, a, b, .. } => (vec![int(a), int(b)], Some(int(dst))),
+        MicroOp::AddI64Imm { dst, a, .. }
+        | MicroOp::ShlI64Imm { dst, a, .. }
+        | MicroOp::ShrI64Imm { dst, a, .. }
+        | MicroOp::ShrU64Imm { dst, a, .. }
+        | MicroOp::CmpI64Imm { dst, a, .. } => (vec![int(a)], Some(int(dst))),
+        MicroOp::NegI64 { dst, src }
+        | MicroOp::EqzI32 { dst, src }
+        | MicroOp::I32WrapI64 { dst, src }
+        | MicroOp::I64ExtendI32S { dst, src }
+        | MicroOp::I64ExtendI32U { dst, src } => (vec![int(src)], Some(int(dst))),
+        MicroOp::AddF64 { dst, a, b }
+        | MicroOp::SubF64 { dst, a, b }
+        | MicroOp::MulF64 { dst, a, b }
+        | MicroOp::DivF64 { dst, a, b }
+        | MicroOp::AddF32 { dst, a, b }
+        | MicroOp::SubF32 { dst, a, b }
+        | MicroOp::MulF32 { dst, a, b }
+        | MicroOp::DivF32 { dst, a, b } => (vec![float(a), float(b)], Some(float(dst))),
+        MicroOp::NegF64 { dst, src }
+        | MicroOp::NegF32 { dst, src }
+        | MicroOp::F32DemoteF64 { dst, src }
+        | MicroOp::F64PromoteF32 { dst, src } => (vec![float(src)], Some(float(dst))),
+        MicroOp::CmpF64 { dst, a, b, .. } | MicroOp::CmpF32 { dst, a, b, .. } => {
+            (vec![float(a), float(b)], Some(int(dst)))
+        }
+        MicroOp::F64ConvertI64S { dst, src }
+        | MicroOp::F64ConvertI32S { dst, src }
+        | MicroOp::F32ConvertI32S { dst, src }
+        | MicroOp::F32ConvertI64S { dst, src } => (vec![int(src)], Some(float(dst))),
+        MicroOp::I64TruncF64S { dst, src }
+        | MicroOp::I32TruncF32S { dst, src }
+        | MicroOp::I32TruncF64S { dst, src }
+        | MicroOp::I64TruncF32S { dst, src }
+        | MicroOp::F64ReinterpretAsI64 { dst, src } => (vec![float(src)], Some(int(dst))),
+        MicroOp::RefEq { dst, a, b } => (vec![int(a), int(b)], Some(int(dst))),
+        MicroOp::RefIsNull { dst, src } => (vec![int(src)], Some(int(dst))),
+        MicroOp::RefNull { dst } => (vec![], Some(int(dst))),
+        MicroOp::HeapLoad { dst, src, .. } => (vec![int(src)], Some(any(dst))),
+        MicroOp::HeapLoadDyn { dst, obj, idx, .. } | MicroOp::HeapLoad2 { dst, obj, idx, .. } => {
+            (vec![int(obj), int(idx)], Some(any(dst)))
+        }
+        MicroOp::HeapStore { dst_obj, src, .. } => (vec![int(dst_obj), any(src)], None),
+        MicroOp::HeapStoreDyn { obj, idx, src, .. } | MicroOp::HeapStore2 { obj, idx, src, .. } => {
+            (vec![int(obj), int(idx), any(src)], None)
+        }
+        MicroOp::HeapOffsetRef { dst, src, offset } => {
+            (vec![int(src), int(offset)], Some(int(dst)))
+        }
+        MicroOp::HeapAlloc { dst, args } => (args.iter().map(any).collect(), Some(int(dst))),
+        MicroOp::HeapAllocDynSimple { dst, size, .. } => (vec![int(size)], Some(int(dst))),
+        MicroOp::HeapBulk { dst, args, .. } => {
+            (args.iter().map(any).collect(), dst.as_ref().map(int))
+        }
+        MicroOp::StringConst { dst, .. } | MicroOp::GlobalGet { dst, .. } => {
+            (vec![], Some(any(dst)))
+        }
+        MicroOp::VtableLookup {
+            dst,
+            type_info,
+            iface_desc,
+            ..
+        } => (vec![int(type_info), int(iface_desc)], Some(int(dst))),
+        MicroOp::StackPush { src } => (vec![any(src)], None),
+        MicroOp::StackPop { dst } => (vec![], Some(any(dst))),
+    }
+}
+
+/// Spill weight of one use at loop depth `depth`.
+fn use_weight(depth: usize) -> u64 {
+    8u64.pow(depth.min(6) as u32)
+}
+
+/// Allocate registers for `req.start..=req.end`.
+pub fn allocate(req: &AllocRequest) -> Allocation {
+    let (start, end) = (req.start, req.end);
+    if req.ops.is_empty() || start > end || end >= req.ops.len() {
+        return Allocation::default();
+    }
+    let len = end - start + 1;
+    let ops = &req.ops[start..=end];
+    let operands: Vec<_> = ops.iter().map(classed_operands).collect();
+
+    let num_vregs = operands
+        .iter()
+        .flat_map(|(uses, def)| uses.iter().chain(def).map(|(v, _)| *v))
+        .chain(req.live_out.iter().copied())
+        .max()
+        .map_or(0, |v| v + 1);
+
+    // Successors within the range; None stands for leaving it
+    let succs: Vec<Vec<Option<usize>>> = ops
+        .iter()
+        .enumerate()
+        .map(|(i, op)| {
+            let pc = start + i;
+            let local = |target: usize| (start..=end).contains(&target).then(|| target - start);
+            match op {
+                MicroOp::Jmp { target, .. } => vec![local(*target)],
+                MicroOp::BrIf { target, .. } | MicroOp::BrIfFalse { target, .. } => {
+                    vec![local(*target), local(pc + 1)]
+                }
+                MicroOp::Ret { .. } => vec![],
+                _ => vec![local(pc + 1)],
+            }
+        })
+        .collect();
+
+    // Loop depth: how many back edges span each op
+    let mut depth = vec![0usize; len];
+    for (i, targets) in succs.iter().enumerate() {
+        for &t in targets.iter().flatten() {
+            if t <= i {
+                for d in &mut depth[t..=i] {
+                    *d += 1;
+                }
+            }
+        }
+    }
+
+    let mut use_sets = Vec::with_capacity(len);
+    let mut def_sets = Vec::with_capacity(len);
+    for (uses, def) in &operands {
+        let mut u = BitSet::new(num_vregs);
+        for (v, _) in uses {
+            u.insert(*v);
+        }
+        let mut d = BitSet::new(num_vregs);
+        if let Some((v, _)) = def {
+            d.insert(*v);
+        }
+        use_sets.push(u);
+        def_sets.push(d);
+    }
+    let mut exit_live = BitSet::new(num_vregs);
+    for &v in req.live_out {
+        exit_live.insert(v);
+    }
+
+    // Backward dataflow to a fixed point
+    let mut live_in = vec![BitSet::new(num_vregs); len];
+    let mut live_out = vec![BitSet::new(num_vregs); len];
+    let mut changed = true;
+    while changed {
+        changed = false;
+        for i in (0..len).rev() {
+            let mut out = BitSet::new(num_vregs);
+            for s in &succs[i] {
+                match s {
+                    Some(s) => out.union_with(&live_in[*s]),
+                    None => out.union_with(&exit_live),
+                }
+            }
+            let mut inn = out.clone();
+            inn.subtract(&def_sets[i]);
+            inn.union_with(&use_sets[i]);
+            if inn != live_in[i] {
+                live_in[i] = inn;
+                changed = true;
+            }
+            live_out[i] = out;
+        }
+    }
+
+    // Intervals, weights and class votes
+    let mut occupied = vec![BitSet::new(len); num_vregs];
+    let mut weight = vec![0u64; num_vregs];
+    let mut votes = vec![(0usize, 0usize); num_vregs];
+    let mut seen = vec![false; num_vregs];
+    for i in 0..len {
+        for v in live_in[i].iter() {
+            occupied[v].insert(i);
+            seen[v] = true;
+        }
+        let (uses, def) = &operands[i];
+        for &(v, class) in uses.iter().chain(def) {
+            occupied[v].insert(i);
+            seen[v] = true;
+            weight[v] += use_weight(depth[i]);
+            match class {
+                Some(RegClass::Int) => votes[v].0 += 1,
+                Some(RegClass::Float) => votes[v].1 += 1,
+                None => {}
+            }
+        }
+    }
+
+    // VRegs live across each call
+    let calls: Vec<(usize, BitSet)> = (0..len)
+        .filter_map(|i| {
+            let mut across = live_out[i].clone();
+            if (req.call_kind)(&ops[i])? == CallKind::ReadsAfter {
+                across.union_with(&use_sets[i]);
+            }
+            across.subtract(&def_sets[i]);
+            Some((i, across))
+        })
+        .collect();
+    let mut crossings = vec![0u64; num_vregs];
+    for (i, across) in &calls {
+        for v in across.iter() {
+            crossings[v] += 2 * use_weight(depth[*i]);
+        }
+    }
+
+    let mut order: Vec<(usize, usize)> = (0..num_vregs)
+        .filter(|&v| seen[v] && !req.memory_only.contains(&v))
+        .filter_map(|v| occupied[v].first().map(|first| (first, v)))
+        .collect();
+    order.sort_unstable();
+
+    let mut regs: HashMap<usize, (RegClass, usize)> = HashMap::new();
+    let mut benefit_of: HashMap<usize, u64> = HashMap::new();
+    let mut reg_occupied: HashMap<(RegClass, usize), BitSet> = HashMap::new();
+    let mut reg_vregs: HashMap<(RegClass, usize), Vec<usize>> = HashMap::new();
+
+    for (_, v) in order {
+        let class = if votes[v].1 > votes[v].0 {
+            RegClass::Float
+        } else {
+            RegClass::Int
+        };
+        let file = match class {
+            RegClass::Int => req.int,
+            RegClass::Float => req.float,
+        };
+        // Values live across calls prefer registers the callee preserves
+        let mut candidates: Vec<usize> = (0..file.len()).collect();
+        if crossings[v] == 0 {
+            candidates.rotate_left(file.callee_saved);
+        }
+        let benefit = |reg: usize| {
+            if file.is_callee_saved(reg) {
+                weight[v]
+            } else {
+                weight[v].saturating_sub(crossings[v])
+            }
+        };
+
+        let free = candidates.iter().copied().find(|&reg| {
+            benefit(reg) > 0
+                && !reg_occupied
+                    .get(&(class, reg))
+                    .is_some_and(|occ| occ.intersects(&occupied[v]))
+        });
+        let chosen = free.or_else(|| {
+            // Evict the cheapest set of conflicting intervals worth less
+            // than this one
+            candidates
+                .iter()
+                .copied()
+                .filter(|&reg| benefit(reg) > 0)
+                .filter_map(|reg| {
+                    let cost: u64 = reg_vregs
+                        .get(&(class, reg))
+                        .into_iter()
+                        .flatten()
+                        .filter(|&&other| occupied[other].intersects(&occupied[v]))
+                        .map(|other| benefit_of[other])
+                        .sum();
+                    (cost < benefit(reg)).then_some((cost, reg))
+                })
+                .min()
+                .map(|(_, reg)| reg)
+        });
+        let Some(reg) = chosen else {
+            continue;
+        };
+
+        let key = (class, reg);
+        let holders = reg_vregs.entry(key).or_default();
+        let (evicted, kept): (Vec<usize>, Vec<usize>) = holders
+            .iter()
+            .partition(|&&other| occupied[other].intersects(&occupied[v]));
+        *holders = kept;
+        holders.push(v);
+        let occ = reg_occupied.entry(key).or_insert_with(|| BitSet::new(len));
+        for other in evicted {
+            regs.remove(&other);
+            benefit_of.remove(&other);
+            for i in occupied[other].iter() {
+                occ.remove(i);
+            }
+        }
+        occ.union_with(&occupied[v]);
+        regs.insert(v, key);
+        benefit_of.insert(v, benefit(reg));
+    }
+
+    let mut call_saves = HashMap::new();
+    let mut call_live = HashMap::new();
+    for (i, across) in &calls {
+        call_live.insert(start + i, across.iter().collect());
+        let mut saved: Vec<usize> = across
+            .iter()
+            .filter(|v| match regs.get(v) {
+                Some((RegClass::Int, reg)) => !req.int.is_callee_saved(*reg),
+                Some((RegClass::Float, reg)) => !req.float.is_callee_saved(*reg),
+                None => false,
+            })
+            .collect();
+        if !saved.is_empty() {
+            saved.sort_unstable();
+            call_saves.insert(start + i, saved);
+        }
+    }
+
+    let mut entry: Vec<usize> = live_in[0].iter().filter(|v| regs.contains_key(v)).collect();
+    entry.sort_unstable();
+
+    Allocation {
+        regs,
+        call_saves,
+        call_live,
+        live_in: entry,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::vm::microop::{CmpCond, VReg};
+
+    const FILE: RegFile = RegFile {
+        callee_saved: 1,
+        caller_saved: 2,
+    };
+
+    fn alloc(ops: &[MicroOp], int: RegFile, float: RegFile, live_out: &[usize]) -> Allocation {
+        let call_kind = |op: &MicroOp| match op {
+            MicroOp::Call { .. } => Some(CallKind::ReadsBefore),
+            MicroOp::HeapAlloc { .. } => Some(CallKind::ReadsAfter),
+            _ => None,
+        };
+        allocate(&AllocRequest {
+            ops,
+            start: 0,
+            end: ops.len() - 1,
+            int,
+            float,
+            live_out,
+            call_kind: &call_kind,
+            memory_only: &HashSet::new(),
+        })
+    }
+
+    /// `acc = 0.0; i = 0; while i < n { acc = acc * x + x; i += 1 }; ret acc`
+    /// with v0 = n, v1 = x, v2 = acc, v3 = i.
+    fn float_loop() -> Vec<MicroOp> {
+        vec![
+            MicroOp::ConstF64 {
+                dst: VReg(2),
+                imm: 0.0,
+            },
+            MicroOp::ConstI64 {
+                dst: VReg(3),
+                imm: 0,
+            },
+            MicroOp::CmpI64 {
+                dst: VReg(4),
+                a: VReg(3),
+                b: VReg(0),
+                cond: CmpCond::LtS,
+            },
+            MicroOp::BrIfFalse {
+                cond: VReg(4),
+                target: 8,
+            },
+            MicroOp::MulF64 {
+                dst: VReg(5),
+                a: VReg(2),
+                b: VReg(1),
+            },
+            MicroOp::AddF64 {
+                dst: VReg(2),
+                a: VReg(5),
+                b: VReg(1),
+            },
+            MicroOp::AddI64Imm {
+                dst: VReg(3),
+                a: VReg(3),
+                imm: 1,
+            },
+            MicroOp::Jmp {
+                target: 2,
+                old_pc: 0,
+                old_target: 0,
+            },
+            MicroOp::Ret { src: Some(VReg(2)) },
+        ]
+    }
+
+    #[test]
+    fn test_float_values_get_float_registers() {
+        let files = RegFile {
+            callee_saved: 0,
+            caller_saved: 4,
+        };
+        let a = alloc(&float_loop(), files, files, &[]);
+        for v in [1, 2, 5] {
+            assert_eq!(a.get(v).map(|(c, _)| c), Some(RegClass::Float), "v{v}");
+        }
+        for v in [0, 3, 4] {
+            assert_eq!(a.get(v).map(|(c, _)| c), Some(RegClass::Int), "v{v}");
+        }
+        // Arguments are live on entry; acc and i are defined first
+        assert_eq!(a.live_in, [0, 1]);
+        // x and acc are live at the same time, so they cannot share
+        assert_ne!(a.get(1), a.get(2));
+    }
+
+    #[test]
+    fn test_disjoint_intervals_share_a_register() {
+        let ops = vec![
+            MicroOp::ConstI64 {
+                dst: VReg(0),
+                imm: 1,
+            },
+            MicroOp::AddI64Imm {
+                dst: VReg(1),
+                a: VReg(0),
+                imm: 1,
+            },
+            MicroOp::AddI64Imm {
+                dst: VReg(2),
+                a: VReg(1),
+                imm: 1,
+            },
+            MicroOp::Ret { src: Some(VReg(2)) },
+        ];
+        let one = RegFile {
+            callee_saved: 0,
+            caller_saved: 2,
+        };
+        let a = alloc(&ops, one, RegFile::default(), &[]);
+        // v0 dies where v1 is born, but an op's sources and destination
+        // never share, so the chain alternates between two registers
+        assert_ne!(a.get(0), a.get(1));
+        assert_ne!(a.get(1), a.get(2));
+        assert_eq!(a.get(0), a.get(2));
+    }
+
+    #[test]
+    fn test_pressure_spills_the_cold_value() {
+        // v9 is only used outside the loop; the loop values win the register
+        let mut ops = vec![MicroOp::ConstI64 {
+            dst: VReg(9),
+            imm: 7,
+        }];
+        ops.extend(float_loop().into_iter().map(|op| match op {
+            MicroOp::BrIfFalse { cond, target } => MicroOp::BrIfFalse {
+                cond,
+                target: target + 1,
+            },
+            MicroOp::Jmp { target, .. } => MicroOp::Jmp {
+                target: target + 1,
+                old_pc: 0,
+                old_target: 0,
+            },
+            op => op,
+        }));
+        ops.insert(
+            ops.len() - 1,
+            MicroOp::AddI64 {
+                dst: VReg(2),
+                a: VReg(9),
+                b: VReg(9),
+            },
+        );
+        let one = RegFile {
+            callee_saved: 0,
+            caller_saved: 1,
+        };
+        let a = alloc(&ops, one, RegFile::default(), &[]);
+        assert_eq!(a.get(9), None);
+        assert!(a.get(3).is_some());
+    }
+
+    #[test]
+    fn test_values_live_across_calls() {
+        let ops = vec![
+            MicroOp::ConstI64 {
+                dst: VReg(0),
+                imm: 1,
+            },
+            MicroOp::ConstI64 {
+                dst: VReg(1),
+                imm: 2,
+            },
+            MicroOp::Call {
+                func_id: 0,
+                args: vec![VReg(1)],
+                ret: Some(VReg(2)),
+            },
+            MicroOp::ConstI64 {
+                dst: VReg(3),
+                imm: 3,
+            },
+            MicroOp::Call {
+                func_id: 0,
+                args: vec![],
+                ret: None,
+            },
+            MicroOp::AddI64 {
+                dst: VReg(4),
+                a: VReg(0),
+                b: VReg(2),
+            },
+            MicroOp::AddI64 {
+                dst: VReg(4),
+                a: VReg(4),
+                b: VReg(3),
+            },
+            MicroOp::MulI64 {
+                dst: VReg(4),
+                a: VReg(4),
+                b: VReg(3),
+            },
+            MicroOp::SubI64 {
+                dst: VReg(4),
+                a: VReg(4),
+                b: VReg(3),
+            },
+            MicroOp::Ret { src: Some(VReg(4)) },
+        ];
+        let a = alloc(&ops, FILE, RegFile::default(), &[]);
+        // v0 crosses both calls and takes the callee-saved register; v3
+        // crosses one, so it is saved around that call only
+        assert_eq!(a.get(0), Some((RegClass::Int, 0)));
+        assert_eq!(a.get(3), Some((RegClass::Int, 1)));
+        assert_eq!(a.call_saves.get(&4), Some(&vec![3]));
+        // The call's own result and its dying argument are not saved
+        assert!(!a.call_saves.contains_key(&2));
+        assert_eq!(a.used_callee_saved(RegClass::Int, FILE), [0]);
+        // Whatever their registers, all values crossing a call are listed
+        assert_eq!(a.call_live[&2], vec![0]);
+        assert_eq!(a.call_live[&4], vec![0, 2, 3]);
+    }
+
+    #[test]
+    fn test_operands_read_after_the_call_cross_it() {
+        let ops = vec![
+            MicroOp::ConstI64 {
+                dst: VReg(0),
+                imm: 1,
+            },
+            MicroOp::HeapAlloc {
+                dst: VReg(1),
+                args: vec![VReg(0)],
+            },
+            MicroOp::Ret { src: Some(VReg(1)) },
+        ];
+        let file = RegFile {
+            callee_saved: 1,
+            caller_saved: 1,
+        };
+        let a = alloc(&ops, file, RegFile::default(), &[]);
+        // The field value is stored after the allocation, so it must
+        // survive the helper call; the result is defined after it
+        assert_eq!(a.get(0), Some((RegClass::Int, 0)));
+        assert_eq!(a.get(1), Some((RegClass::Int, 1)));
+    }
+
+    #[test]
+    fn test_loop_range_keeps_exit_values_live() {
+        let ops = float_loop();
+        let files = RegFile {
+            callee_saved: 0,
+            caller_saved: 8,
+        };
+        let call_kind = |_: &MicroOp| None;
+        let a = allocate(&AllocRequest {
+            ops: &ops,
+            start: 2,
+            end: 7,
+            int: files,
+            float: files,
+            live_out: &[0, 1, 2, 3],
+            call_kind: &call_kind,
+            memory_only: &HashSet::new(),
+        });
+        // Every local the loop touches is loaded on entry
+        assert_eq!(a.live_in, [0, 1, 2, 3]);
+        // acc stays live through the multiply, so the temp gets its own
+        assert_ne!(a.get(5), a.get(2));
+    }
+}
@@ -2,9 +2,25 @@
 //!
 //! Stack maps track which stack slots contain references at each safepoint
 //! in the generated code, allowing the GC to accurately trace roots.
-
+//!
+//! The MicroOp backends record one entry per safepoint (a call, or an op
+//! that may allocate) listing the frame slots that may hold a reference
+//! there. The code they emit applies the map itself: before the call it
+//! copies those values to the VM's `RootStack`, and the GC scans that
+//! instead of walking native frames. Values in registers are covered the
+//! same way as values in frame slots, and nothing has to unwind JIT frames.
+
+use super::marshal::{JitValue, tags};
+use crate::vm::GcRef;
 use std::collections::HashMap;
 
+/// Most values one safepoint copies to the root stack. A safepoint with more
+/// marks the root stack incomplete instead.
+pub const MAX_SAFEPOINT_ROOTS: usize = 255;
+
+/// Root stack entries of a VM.
+pub const ROOT_STACK_CAPACITY: usize = 16 * 1024;
+
 /// A single stack map entry for a safepoint.
 #[derive(Debug, Clone)]
 pub struct StackMapEntry {
@@ -20,6 +36,8 @@ pub struct StackMapEntry {
     pub stack_depth: u16,
     /// Number of local variables
     pub locals_count: u16,
+    /// MicroOp frame slots (VRegs) copied to the root stack, in push order
+    pub frame_refs: Vec<u32>,
 }
 
 impl StackMapEntry {
@@ -32,6 +50,7 @@ impl StackMapEntry {
             locals_refs: 0,
             stack_depth,
             locals_count,
+            frame_refs: Vec::new(),
         }
     }
 
@@ -226,6 +245,102 @@ impl Default for StackMapBuilder {
     }
 }
 
+/// Values compiled code holds across its safepoints, scanned by the GC.
+///
+/// At a safepoint, compiled code copies the slots its stack map lists (tag
+/// and payload) to `top` and advances it, and puts `top` back once the call
+/// returns, so the entries always mirror the JIT frames on the native
+/// stack. A safepoint that finds no room sets `overflowed` instead; the VM
+/// then does not collect until compiled code has returned to the
+/// interpreter. JIT code accesses the first three fields at fixed offsets.
+#[repr(C)]
+pub struct RootStack {
+    /// Next free entry
+    pub top: *mut JitValue,
+    /// One past the last entry
+    pub end: *const JitValue,
+    /// Nonzero once a safepoint had no room for its values
+    pub overflowed: u64,
+    entries: Box<[JitValue]>,
+    /// Entries reserved by the first `enter`
+    capacity: usize,
+    /// VM calls into compiled code in progress
+    depth: usize,
+}
+
+// SAFETY: `top` and `end` only point into `entries`, which the RootStack owns.
+unsafe impl Send for RootStack {}
+
+impl RootStack {
+    pub const TOP_OFFSET: i32 = 0;
+    pub const END_OFFSET: i32 = 8;
+    pub const OVERFLOWED_OFFSET: i32 = 16;
+
+    /// A root stack of `capacity` entries, allocated when compiled code is
+    /// first entered.
+    pub fn new(capacity: usize) -> Self {
+        Self {
+            top: std::ptr::null_mut(),
+            end: std::ptr::null(),
+            overflowed: 0,
+            entries: Box::default(),
+            capacity,
+            depth: 0,
+        }
+    }
+
+    /// Note that the VM calls into compiled code.
+    pub fn enter(&mut self) {
+        if self.entries.is_empty() && self.capacity > 0 {
+            self.entries = vec![JitValue { tag: 0, payload: 0 }; self.capacity].into_boxed_slice();
+            self.top = self.entries.as_mut_ptr();
+            self.end = self.entries.as_ptr_range().end;
+        }
+        self.depth += 1;
+    }
+
+    /// Note that a call into compiled code returned. Once none is left, the
+    /// stack is empty again and an overflow is forgotten.
+    pub fn exit(&mut self) {
+        self.depth = self.depth.saturating_sub(1);
+        if self.depth == 0 {
+            self.top = self.entries.as_mut_ptr();
+            self.overflowed = 0;
+        }
+    }
+
+    /// Whether compiled code is running.
+    pub fn is_active(&self) -> bool {
+        self.depth > 0
+    }
+
+    /// Whether every reference in JIT frames is on the stack, so the GC may
+    /// run while compiled code is active.
+    pub fn is_complete(&self) -> bool {
+        self.overflowed == 0
+    }
+
+    /// The entries below `top`.
+    fn live(&self) -> &[JitValue] {
+        if self.entries.is_empty() {
+            return &[];
+        }
+        // SAFETY: compiled code keeps `top` within `entries`
+        let len = unsafe { self.top.offset_from(self.entries.as_ptr()) } as usize;
+        &self.entries[..len.min(self.entries.len())]
+    }
+
+    /// References held by JIT frames.
+    pub fn refs(&self) -> impl Iterator<Item = GcRef> + '_ {
+        self.live()
+            .iter()
+            .filter(|v| v.tag == tags::TAG_PTR && v.payload != 0)
+            .map(|v| GcRef {
+                index: v.payload as usize,
+            })
+    }
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -297,4 +412,37 @@ mod tests {
         assert_eq!(entry2.stack_depth, 2);
         assert!(!entry2.is_stack_ref(1)); // Now a primitive
     }
+
+    #[test]
+    fn test_root_stack() {
+        let mut roots = RootStack::new(4);
+        assert!(!roots.is_active());
+        roots.enter();
+        assert_eq!(roots.refs().count(), 0);
+
+        // What compiled code does at a safepoint with two values
+        unsafe {
+            *roots.top = JitValue {
+                tag: tags::TAG_PTR,
+                payload: 64,
+            };
+            *roots.top.add(1) = JitValue {
+                tag: tags::TAG_INT,
+                payload: 64,
+            };
+            roots.top = roots.top.add(2);
+        }
+        let refs: Vec<usize> = roots.refs().map(|r| r.index).collect();
+        assert_eq!(refs, vec![64]);
+
+        // A nested entry keeps the outer frames' values
+        roots.enter();
+        roots.overflowed = 1;
+        assert!(!roots.is_complete());
+        roots.exit();
+        assert_eq!(roots.refs().count(), 1);
+        roots.exit();
+        assert!(roots.is_complete());
+        assert_eq!(roots.refs().count(), 0);
+    }
 }
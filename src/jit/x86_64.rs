@@ -644,93 +644,119 @@ impl<'a> X86_64Assembler<'a> {
 
     // ==================== SSE2 Floating Point ====================
 
+    /// Emit `[prefix] [REX] 0F opcode ModR/M` for a register-register SSE
+    /// op. `reg` and `rm` are XMM or GP register numbers (0-15).
+    fn emit_sse_rr(&mut self, prefix: u8, rex_w: bool, opcode: u8, reg: u8, rm: u8) {
+        self.buf.emit_u8(prefix);
+        let rex = 0x40 | if rex_w { 0x08 } else { 0 } | ((reg >> 3) & 1) << 2 | ((rm >> 3) & 1);
+        if rex != 0x40 {
+            self.buf.emit_u8(rex);
+        }
+        self.buf.emit_u8(0x0F);
+        self.buf.emit_u8(opcode);
+        self.buf.emit_u8(Self::modrm(0b11, reg, rm));
+    }
+
+    /// Emit `F2 [REX] 0F opcode ModR/M [SIB] disp` for MOVSD with a
+    /// `[base + disp]` operand.
+    fn emit_sse_mem(&mut self, opcode: u8, xmm: u8, base: Reg, disp: i32) {
+        self.buf.emit_u8(0xF2);
+        let rex = 0x40 | ((xmm >> 3) & 1) << 2 | base.rex_b();
+        if rex != 0x40 {
+            self.buf.emit_u8(rex);
+        }
+        self.buf.emit_u8(0x0F);
+        self.buf.emit_u8(opcode);
+        let sib = base == Reg::Rsp || base == Reg::R12;
+        let rm = if sib { 0b100 } else { base.code() };
+        let mode = if disp == 0 && base != Reg::Rbp && base != Reg::R13 {
+            0b00
+        } else if (-128..=127).contains(&disp) {
+            0b01
+        } else {
+            0b10
+        };
+        self.buf.emit_u8(Self::modrm(mode, xmm, rm));
+        if sib {
+            self.buf.emit_u8(0x24);
+        }
+        match mode {
+            0b01 => self.buf.emit_u8(disp as u8),
+            0b10 => self.buf.emit_u32(disp as u32),
+            _ => {}
+        }
+    }
+
     /// MOVQ xmm, r64 (move quadword from GP register to XMM)
     pub fn movq_xmm_r64(&mut self, xmm: u8, src: Reg) {
         // 66 REX.W 0F 6E /r - MOVQ xmm, r/m64
-        self.buf.emit_u8(0x66);
-        let rex = 0x48 | src.rex_b();
-        self.buf.emit_u8(rex);
-        self.buf.emit_u8(0x0F);
-        self.buf.emit_u8(0x6E);
-        self.buf.emit_u8(Self::modrm(0b11, xmm, src.code()));
+        self.emit_sse_rr(0x66, true, 0x6E, xmm, src as u8);
     }
 
     /// MOVQ r64, xmm (move quadword from XMM to GP register)
     pub fn movq_r64_xmm(&mut self, dst: Reg, xmm: u8) {
         // 66 REX.W 0F 7E /r - MOVQ r/m64, xmm
-        self.buf.emit_u8(0x66);
-        let rex = 0x48 | dst.rex_b();
-        self.buf.emit_u8(rex);
-        self.buf.emit_u8(0x0F);
-        self.buf.emit_u8(0x7E);
-        self.buf.emit_u8(Self::modrm(0b11, xmm, dst.code()));
+        self.emit_sse_rr(0x66, true, 0x7E, xmm, dst as u8);
+    }
+
+    /// MOVAPD xmm1, xmm2 (copy a whole XMM register)
+    pub fn movapd(&mut self, dst: u8, src: u8) {
+        // 66 0F 28 /r - MOVAPD xmm1, xmm2/m128
+        self.emit_sse_rr(0x66, false, 0x28, dst, src);
+    }
+
+    /// MOVSD xmm, [r64 + disp32] (load scalar double)
+    pub fn movsd_xmm_m(&mut self, xmm: u8, base: Reg, disp: i32) {
+        // F2 0F 10 /r - MOVSD xmm1, m64
+        self.emit_sse_mem(0x10, xmm, base, disp);
+    }
+
+    /// MOVSD [r64 + disp32], xmm (store scalar double)
+    pub fn movsd_m_xmm(&mut self, base: Reg, disp: i32, xmm: u8) {
+        // F2 0F 11 /r - MOVSD m64, xmm1
+        self.emit_sse_mem(0x11, xmm, base, disp);
     }
 
     /// ADDSD xmm1, xmm2 (add scalar double-precision)
     pub fn addsd(&mut self, dst: u8, src: u8) {
         // F2 0F 58 /r - ADDSD xmm1, xmm2/m64
-        self.buf.emit_u8(0xF2);
-        self.buf.emit_u8(0x0F);
-        self.buf.emit_u8(0x58);
-        self.buf.emit_u8(Self::modrm(0b11, dst, src));
+        self.emit_sse_rr(0xF2, false, 0x58, dst, src);
     }
 
     /// SUBSD xmm1, xmm2 (subtract scalar double-precision)
     pub fn subsd(&mut self, dst: u8, src: u8) {
         // F2 0F 5C /r - SUBSD xmm1, xmm2/m64
-        self.buf.emit_u8(0xF2);
-        self.buf.emit_u8(0x0F);
-        self.buf.emit_u8(0x5C);
-        self.buf.emit_u8(Self::modrm(0b11, dst, src));
+        self.emit_sse_rr(0xF2, false, 0x5C, dst, src);
     }
 
     /// MULSD xmm1, xmm2 (multiply scalar double-precision)
     pub fn mulsd(&mut self, dst: u8, src: u8) {
         // F2 0F 59 /r - MULSD xmm1, xmm2/m64
-        self.buf.emit_u8(0xF2);
-        self.buf.emit_u8(0x0F);
-        self.buf.emit_u8(0x59);
-        self.buf.emit_u8(Self::modrm(0b11, dst, src));
+        self.emit_sse_rr(0xF2, false, 0x59, dst, src);
     }
 
     /// DIVSD xmm1, xmm2 (divide scalar double-precision)
     pub fn divsd(&mut self, dst: u8, src: u8) {
         // F2 0F 5E /r - DIVSD xmm1, xmm2/m64
-        self.buf.emit_u8(0xF2);
-        self.buf.emit_u8(0x0F);
-        self.buf.emit_u8(0x5E);
-        self.buf.emit_u8(Self::modrm(0b11, dst, src));
+        self.emit_sse_rr(0xF2, false, 0x5E, dst, src);
     }
 
     /// UCOMISD xmm1, xmm2 (compare scalar double-precision and set EFLAGS)
     pub fn ucomisd(&mut self, xmm1: u8, xmm2: u8) {
         // 66 0F 2E /r - UCOMISD xmm1, xmm2/m64
-        self.buf.emit_u8(0x66);
-        self.buf.emit_u8(0x0F);
-        self.buf.emit_u8(0x2E);
-        self.buf.emit_u8(Self::modrm(0b11, xmm1, xmm2));
+        self.emit_sse_rr(0x66, false, 0x2E, xmm1, xmm2);
     }
 
     /// CVTSI2SD xmm, r64 (convert signed 64-bit integer to scalar double)
     pub fn cvtsi2sd_xmm_r64(&mut self, xmm: u8, src: Reg) {
         // F2 REX.W 0F 2A /r - CVTSI2SD xmm, r/m64
-        self.buf.emit_u8(0xF2);
-        let rex = 0x48 | src.rex_b();
-        self.buf.emit_u8(rex);
-        self.buf.emit_u8(0x0F);
-        self.buf.emit_u8(0x2A);
-        self.buf.emit_u8(Self::modrm(0b11, xmm, src.code()));
+        self.emit_sse_rr(0xF2, true, 0x2A, xmm, src as u8);
     }
 
     /// CVTTSD2SI r64, xmm (convert scalar double to signed 64-bit integer, truncated)
     pub fn cvttsd2si_r64_xmm(&mut self, dst: Reg, xmm: u8) {
         // F2 REX.W 0F 2C /r - CVTTSD2SI r64, xmm/m64
-        self.buf.emit_u8(0xF2);
-        let rex = 0x48 | dst.rex_r();
-        self.buf.emit_u8(rex);
-        self.buf.emit_u8(0x0F);
-        self.buf.emit_u8(0x2C);
-        self.buf.emit_u8(Self::modrm(0b11, dst.code(), xmm));
+        self.emit_sse_rr(0xF2, true, 0x2C, dst as u8, xmm);
     }
 
     /// MOVSXD r64, r32 (sign-extend 32-bit to 64-bit)
@@ -1144,4 +1170,42 @@ mod tests {
         // MOVZX RAX, AL = 48 0F B6 C0
         assert_eq!(buf.code(), &[0x48, 0x0F, 0xB6, 0xC0]);
     }
+
+    #[test]
+    fn test_sse_high_registers() {
+        let mut buf = CodeBuffer::new();
+        let mut asm = X86_64Assembler::new(&mut buf);
+        asm.addsd(0, 1);
+        asm.mulsd(9, 2);
+        asm.movapd(3, 12);
+        asm.movq_xmm_r64(10, Reg::R11);
+        asm.movq_r64_xmm(Reg::Rax, 15);
+
+        assert_eq!(
+            buf.code(),
+            &[
+                0xF2, 0x0F, 0x58, 0xC1, // ADDSD xmm0, xmm1
+                0xF2, 0x44, 0x0F, 0x59, 0xCA, // MULSD xmm9, xmm2
+                0x66, 0x41, 0x0F, 0x28, 0xDC, // MOVAPD xmm3, xmm12
+                0x66, 0x4D, 0x0F, 0x6E, 0xD3, // MOVQ xmm10, r11
+                0x66, 0x4C, 0x0F, 0x7E, 0xF8, // MOVQ rax, xmm15
+            ]
+        );
+    }
+
+    #[test]
+    fn test_movsd_mem() {
+        let mut buf = CodeBuffer::new();
+        let mut asm = X86_64Assembler::new(&mut buf);
+        asm.movsd_xmm_m(2, Reg::R13, 0x10);
+        asm.movsd_m_xmm(Reg::Rsp, 0, 8);
+
+        assert_eq!(
+            buf.code(),
+            &[
+                0xF2, 0x41, 0x0F, 0x10, 0x55, 0x10, // MOVSD xmm2, [r13+0x10]
+                0xF2, 0x44, 0x0F, 0x11, 0x04, 0x24, // MOVSD [rsp], xmm8
+            ]
+        );
+    }
 }
@@ -1,24 +1,28 @@
-use std::collections::HashMap;
 use std::path::{Path, PathBuf};
-use std::sync::RwLock;
+use std::sync::{Arc, Mutex, RwLock};
+use std::time::Duration;
 
 use tower_lsp::jsonrpc::Result;
 use tower_lsp::lsp_types::*;
 use tower_lsp::{Client, LanguageServer, LspService, Server};
 
-use crate::compiler::ast::Program;
 use crate::compiler::linter;
 use crate::compiler::typechecker::TypeError;
-use crate::compiler::{Lexer, Parser, TypeChecker};
 
 mod symbols;
+mod workspace;
 use symbols::{DocSymbol, SymbolTable};
+use workspace::{Analysis, Workspace};
+
+/// How long the server waits after an edit before checking the document,
+/// so a burst of keystrokes is analyzed once.
+const DEBOUNCE: Duration = Duration::from_millis(300);
 
 /// The moca language server backend.
 pub struct MocaLanguageServer {
     client: Client,
-    /// Document cache: URI -> source text
-    documents: RwLock<HashMap<Url, String>>,
+    /// Every known .mc file with its AST, symbols and last analysis
+    workspace: Arc<Mutex<Workspace>>,
     /// Workspace root path
     workspace_root: RwLock<Option<PathBuf>>,
 }
@@ -27,7 +31,7 @@ impl MocaLanguageServer {
     pub fn new(client: Client) -> Self {
         Self {
             client,
-            documents: RwLock::new(HashMap::new()),
+            workspace: Arc::new(Mutex::new(Workspace::new())),
             workspace_root: RwLock::new(None),
         }
     }
@@ -35,13 +39,11 @@ impl MocaLanguageServer {
     /// Scan workspace for .mc files and index them.
     fn scan_workspace(&self, root: &Path) {
         let mc_files = Self::find_mc_files(root);
-        let mut docs = self.documents.write().unwrap();
+        let mut workspace = self.workspace.lock().unwrap();
 
         for path in mc_files {
-            if let (Ok(source), Ok(uri)) =
-                (std::fs::read_to_string(&path), Url::from_file_path(&path))
-            {
-                docs.entry(uri).or_insert(source);
+            if let Ok(source) = std::fs::read_to_string(&path) {
+                workspace.update(&path, source, 0, None);
             }
         }
     }
@@ -73,83 +75,72 @@ impl MocaLanguageServer {
         files
     }
 
-    /// Parse a document and return the AST (if successful).
-    fn parse_document(&self, uri: &Url, source: &str) -> Option<Program> {
-        let filename = uri.path();
+    /// The symbol table of a document.
+    fn symbols(&self, uri: &Url) -> Option<Arc<SymbolTable>> {
+        self.workspace.lock().unwrap().symbols(&document_path(uri))
+    }
+}
 
-        // Try lexing
-        let mut lexer = Lexer::new(filename, source);
-        let tokens = lexer.scan_tokens().ok()?;
+/// The workspace path of a document. Documents that are not files (unsaved
+/// buffers) are keyed by their URI path.
+fn document_path(uri: &Url) -> PathBuf {
+    uri.to_file_path()
+        .unwrap_or_else(|_| PathBuf::from(uri.path()))
+}
 
-        // Try parsing
-        let mut parser = Parser::new(filename, tokens);
-        parser.parse().ok()
-    }
+/// Analyze `path` and the open documents that import it, and publish their
+/// diagnostics. The type checker runs on the blocking thread pool, without
+/// the workspace lock.
+async fn publish_diagnostics(client: &Client, workspace: &Mutex<Workspace>, path: PathBuf) {
+    let mut paths = vec![path.clone()];
+    paths.extend(workspace.lock().unwrap().open_dependents(&path));
+
+    for path in paths {
+        let version = workspace.lock().unwrap().version(&path);
+        let pending = workspace.lock().unwrap().analysis(&path);
+        let analysis = match pending {
+            Ok(analysis) => analysis,
+            Err(job) => {
+                let Ok((key, analysis)) = tokio::task::spawn_blocking(move || job.run()).await
+                else {
+                    continue;
+                };
+                workspace.lock().unwrap().finish(key, analysis)
+            }
+        };
 
-    /// Analyze a document and return diagnostics.
-    fn analyze(&self, uri: &Url, source: &str) -> Vec<Diagnostic> {
-        analyze_source(uri.path(), source)
+        let uri = workspace.lock().unwrap().uri(&path).map(str::to_string);
+        if let Some(uri) = uri.and_then(|uri| Url::parse(&uri).ok()) {
+            client
+                .publish_diagnostics(uri, analysis_to_diagnostics(&analysis), version)
+                .await;
+        }
     }
 }
 
 /// Analyze source code and return LSP diagnostics.
 ///
 /// This is the core analysis pipeline: lex → parse → typecheck → lint.
-/// Exposed as a public function for testing.
+/// Imports are not followed. Exposed as a public function for testing.
 pub fn analyze_source(filename: &str, source: &str) -> Vec<Diagnostic> {
-    let mut diagnostics = Vec::new();
-
-    // Try lexing
-    let mut lexer = Lexer::new(filename, source);
-    let tokens = match lexer.scan_tokens() {
-        Ok(tokens) => tokens,
-        Err(e) => {
-            if let Some(diag) = parse_error_to_diagnostic(&e) {
-                diagnostics.push(diag);
-            }
-            return diagnostics;
-        }
-    };
-
-    // Try parsing
-    let mut parser = Parser::new(filename, tokens);
-    let program = match parser.parse() {
-        Ok(program) => program,
-        Err(e) => {
-            if let Some(diag) = parse_error_to_diagnostic(&e) {
-                diagnostics.push(diag);
-            }
-            return diagnostics;
-        }
-    };
+    let parsed = workspace::parse(filename, source).map(Arc::new);
+    analysis_to_diagnostics(&workspace::analyze(filename, &parsed, &[], &mut None))
+}
 
-    // Prepend stdlib for type checking and linting
-    let user_item_count = program.items.len();
-    let Ok(mut program) = crate::compiler::prepend_stdlib(program) else {
-        return diagnostics;
-    };
-    let stdlib_item_count = program.items.len() - user_item_count;
-
-    // Type checking
-    let mut typechecker = TypeChecker::new(filename);
-    match typechecker.check_program(&mut program) {
-        Ok(()) => {
-            // Type check succeeded — run lint
-            let rules = linter::default_rules();
-            let lint_results = linter::lint_program(&program, filename, &rules, stdlib_item_count);
-            for lint_diag in &lint_results {
-                diagnostics.push(lint_diagnostic_to_lsp(lint_diag));
-            }
-        }
-        Err(type_errors) => {
-            // Type check failed — report type errors, skip lint
-            for error in &type_errors {
-                diagnostics.push(type_error_to_diagnostic(error));
-            }
-        }
+/// The LSP diagnostics of an analysis: the parse error, or else the type
+/// errors, or else the lint results.
+fn analysis_to_diagnostics(analysis: &Analysis) -> Vec<Diagnostic> {
+    if let Some(error) = &analysis.parse_error {
+        return parse_error_to_diagnostic(error).into_iter().collect();
     }
-
-    diagnostics
+    if !analysis.type_errors.is_empty() {
+        return analysis
+            .type_errors
+            .iter()
+            .map(type_error_to_diagnostic)
+            .collect();
+    }
+    analysis.lints.iter().map(lint_diagnostic_to_lsp).collect()
 }
 
 /// Parse an error message to extract location and create a diagnostic.
@@ -267,7 +258,7 @@ impl LanguageServer for MocaLanguageServer {
 
         if let Some(root) = root {
             self.scan_workspace(&root);
-            let doc_count = self.documents.read().unwrap().len();
+            let doc_count = self.workspace.lock().unwrap().file_count();
             self.client
                 .log_message(
                     MessageType::INFO,
@@ -289,46 +280,53 @@ impl LanguageServer for MocaLanguageServer {
     }
 
     async fn did_open(&self, params: DidOpenTextDocumentParams) {
-        let uri = params.text_document.uri;
-        let text = params.text_document.text;
+        let document = params.text_document;
+        let path = document_path(&document.uri);
 
-        {
-            let mut docs = self.documents.write().unwrap();
-            docs.insert(uri.clone(), text.clone());
-        }
+        self.workspace.lock().unwrap().update(
+            &path,
+            document.text,
+            document.version,
+            Some(document.uri.to_string()),
+        );
 
-        let diagnostics = self.analyze(&uri, &text);
-        self.client
-            .publish_diagnostics(uri, diagnostics, None)
-            .await;
+        publish_diagnostics(&self.client, &self.workspace, path).await;
     }
 
     async fn did_change(&self, params: DidChangeTextDocumentParams) {
         let uri = params.text_document.uri;
+        let version = params.text_document.version;
+        let path = document_path(&uri);
 
         // We use FULL sync, so we get the entire document
         if let Some(change) = params.content_changes.into_iter().next() {
-            let text = change.text;
-
-            {
-                let mut docs = self.documents.write().unwrap();
-                docs.insert(uri.clone(), text.clone());
-            }
-
-            let diagnostics = self.analyze(&uri, &text);
-            self.client
-                .publish_diagnostics(uri, diagnostics, None)
-                .await;
+            self.workspace.lock().unwrap().update(
+                &path,
+                change.text,
+                version,
+                Some(uri.to_string()),
+            );
+
+            // Check once the edits stop; a later edit supersedes this one
+            let client = self.client.clone();
+            let workspace = self.workspace.clone();
+            tokio::spawn(async move {
+                tokio::time::sleep(DEBOUNCE).await;
+                let current = workspace.lock().unwrap().version(&path);
+                if current == Some(version) {
+                    publish_diagnostics(&client, &workspace, path).await;
+                }
+            });
         }
     }
 
     async fn did_close(&self, params: DidCloseTextDocumentParams) {
         let uri = params.text_document.uri;
+        let path = document_path(&uri);
 
-        {
-            let mut docs = self.documents.write().unwrap();
-            docs.remove(&uri);
-        }
+        // Back to the text on disk, which the open importers now see
+        self.workspace.lock().unwrap().close(&path);
+        publish_diagnostics(&self.client, &self.workspace, path).await;
 
         // Clear diagnostics when file is closed
         self.client.publish_diagnostics(uri, vec![], None).await;
@@ -337,12 +335,8 @@ impl LanguageServer for MocaLanguageServer {
     async fn completion(&self, params: CompletionParams) -> Result<Option<CompletionResponse>> {
         let uri = &params.text_document_position.text_document.uri;
 
-        let source = {
-            let docs = self.documents.read().unwrap();
-            match docs.get(uri) {
-                Some(s) => s.clone(),
-                None => return Ok(None),
-            }
+        let Some(symbols) = self.symbols(uri) else {
+            return Ok(None);
         };
 
         // Basic keyword completion
@@ -369,25 +363,22 @@ impl LanguageServer for MocaLanguageServer {
         }));
 
         // Add symbols from the document
-        if let Some(program) = self.parse_document(uri, &source) {
-            let symbols = SymbolTable::from_program(&program);
-            for (name, defs) in &symbols.definitions {
-                if let Some(def) = defs.first() {
-                    let kind = match def.kind {
-                        symbols::SymbolKind::Function => CompletionItemKind::FUNCTION,
-                        symbols::SymbolKind::Variable => CompletionItemKind::VARIABLE,
-                        symbols::SymbolKind::Parameter => CompletionItemKind::VARIABLE,
-                        symbols::SymbolKind::Struct => CompletionItemKind::STRUCT,
-                        symbols::SymbolKind::Interface => CompletionItemKind::INTERFACE,
-                        symbols::SymbolKind::Method => CompletionItemKind::METHOD,
-                        symbols::SymbolKind::Field => CompletionItemKind::FIELD,
-                    };
-                    items.push(CompletionItem {
-                        label: name.clone(),
-                        kind: Some(kind),
-                        ..Default::default()
-                    });
-                }
+        for (name, defs) in &symbols.definitions {
+            if let Some(def) = defs.first() {
+                let kind = match def.kind {
+                    symbols::SymbolKind::Function => CompletionItemKind::FUNCTION,
+                    symbols::SymbolKind::Variable => CompletionItemKind::VARIABLE,
+                    symbols::SymbolKind::Parameter => CompletionItemKind::VARIABLE,
+                    symbols::SymbolKind::Struct => CompletionItemKind::STRUCT,
+                    symbols::SymbolKind::Interface => CompletionItemKind::INTERFACE,
+                    symbols::SymbolKind::Method => CompletionItemKind::METHOD,
+                    symbols::SymbolKind::Field => CompletionItemKind::FIELD,
+                };
+                items.push(CompletionItem {
+                    label: name.clone(),
+                    kind: Some(kind),
+                    ..Default::default()
+                });
             }
         }
 
@@ -401,23 +392,10 @@ impl LanguageServer for MocaLanguageServer {
         let uri = &params.text_document_position_params.text_document.uri;
         let position = params.text_document_position_params.position;
 
-        let source = {
-            let docs = self.documents.read().unwrap();
-            match docs.get(uri) {
-                Some(s) => s.clone(),
-                None => return Ok(None),
-            }
-        };
-
-        // Parse the document
-        let program = match self.parse_document(uri, &source) {
-            Some(p) => p,
-            None => return Ok(None),
+        let Some(symbols) = self.symbols(uri) else {
+            return Ok(None);
         };
 
-        // Build symbol table
-        let symbols = SymbolTable::from_program(&program);
-
         // Find symbol at cursor position (convert to 1-based)
         let line = position.line + 1;
         let column = position.character + 1;
@@ -458,23 +436,10 @@ impl LanguageServer for MocaLanguageServer {
         let uri = &params.text_document_position_params.text_document.uri;
         let position = params.text_document_position_params.position;
 
-        let source = {
-            let docs = self.documents.read().unwrap();
-            match docs.get(uri) {
-                Some(s) => s.clone(),
-                None => return Ok(None),
-            }
-        };
-
-        // Parse the document
-        let program = match self.parse_document(uri, &source) {
-            Some(p) => p,
-            None => return Ok(None),
+        let Some(symbols) = self.symbols(uri) else {
+            return Ok(None);
         };
 
-        // Build symbol table
-        let symbols = SymbolTable::from_program(&program);
-
         // Find symbol at cursor position (convert to 1-based)
         let line = position.line + 1;
         let column = position.character + 1;
@@ -515,20 +480,9 @@ impl LanguageServer for MocaLanguageServer {
     ) -> Result<Option<DocumentSymbolResponse>> {
         let uri = &params.text_document.uri;
 
-        let source = {
-            let docs = self.documents.read().unwrap();
-            match docs.get(uri) {
-                Some(s) => s.clone(),
-                None => return Ok(None),
-            }
-        };
-
-        let program = match self.parse_document(uri, &source) {
-            Some(p) => p,
-            None => return Ok(None),
+        let Some(symbols) = self.symbols(uri) else {
+            return Ok(None);
         };
-
-        let symbols = SymbolTable::from_program(&program);
         let lsp_symbols: Vec<DocumentSymbol> =
             symbols.doc_symbols.iter().map(doc_symbol_to_lsp).collect();
 
@@ -539,21 +493,10 @@ impl LanguageServer for MocaLanguageServer {
         let uri = &params.text_document_position.text_document.uri;
         let position = params.text_document_position.position;
 
-        let source = {
-            let docs = self.documents.read().unwrap();
-            match docs.get(uri) {
-                Some(s) => s.clone(),
-                None => return Ok(None),
-            }
-        };
-
-        let program = match self.parse_document(uri, &source) {
-            Some(p) => p,
-            None => return Ok(None),
+        let Some(symbols) = self.symbols(uri) else {
+            return Ok(None);
         };
 
-        let symbols = SymbolTable::from_program(&program);
-
         let line = position.line + 1;
         let column = position.character + 1;
 
@@ -584,19 +527,16 @@ impl LanguageServer for MocaLanguageServer {
     ) -> Result<Option<Vec<SymbolInformation>>> {
         let query = params.query.to_lowercase();
 
-        let docs = self.documents.read().unwrap();
+        let workspace = self.workspace.lock().unwrap();
         let mut results = Vec::new();
 
-        for (uri, source) in docs.iter() {
-            let program = match self.parse_document(uri, source) {
-                Some(p) => p,
-                None => continue,
+        for (path, symbols) in workspace.all_symbols() {
+            let Ok(uri) = Url::from_file_path(path) else {
+                continue;
             };
 
-            let symbols = SymbolTable::from_program(&program);
-
             for sym in &symbols.doc_symbols {
-                Self::collect_workspace_symbols(sym, uri, &query, &mut results);
+                Self::collect_workspace_symbols(sym, &uri, &query, &mut results);
             }
         }
 
@@ -614,21 +554,10 @@ impl LanguageServer for MocaLanguageServer {
         let uri = &params.text_document_position_params.text_document.uri;
         let position = params.text_document_position_params.position;
 
-        let source = {
-            let docs = self.documents.read().unwrap();
-            match docs.get(uri) {
-                Some(s) => s.clone(),
-                None => return Ok(None),
-            }
-        };
-
-        let program = match self.parse_document(uri, &source) {
-            Some(p) => p,
-            None => return Ok(None),
+        let Some(symbols) = self.symbols(uri) else {
+            return Ok(None);
         };
 
-        let symbols = SymbolTable::from_program(&program);
-
         let line = position.line + 1;
         let column = position.character + 1;
 
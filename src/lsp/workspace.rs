@@ -0,0 +1,545 @@
+//! Incremental analysis state of the language server.
+//!
+//! The server keeps one `FileState` per `.mc` file of the workspace: its
+//! text, the AST and symbol table of the last version that parsed, the
+//! modules it imports and its last analysis. An edit reparses only the
+//! edited file. Analyses are keyed by a fingerprint of the file and of
+//! every module it reaches through imports, so an edit invalidates the
+//! file itself and the files that depend on it, and nothing else.
+//! Definition, hover, reference and symbol queries read the stored symbol
+//! tables instead of parsing again.
+//!
+//! A file is checked together with the modules it imports, as `moca check`
+//! would. Type errors carry no file name, so errors the imported modules
+//! raise on their own (computed once per set of modules) are dropped from
+//! the importing file's diagnostics; they show up in the module's own.
+
+use std::collections::{HashMap, HashSet};
+use std::path::{Component, Path, PathBuf};
+use std::sync::Arc;
+
+use crate::compiler::ast::{Item, Program};
+use crate::compiler::cache::content_hash;
+use crate::compiler::lexer::Span;
+use crate::compiler::typechecker::TypeError;
+use crate::compiler::{Lexer, ModuleLoader, Parser, TypeChecker, linter, prepend_stdlib};
+use crate::vm::fnv::Fnv;
+
+use super::symbols::SymbolTable;
+
+/// Diagnostics of one file.
+#[derive(Debug, Default)]
+pub struct Analysis {
+    /// Lexer or parser error; nothing else is checked then
+    pub parse_error: Option<String>,
+    pub type_errors: Vec<TypeError>,
+    /// Lint results, when the file type checks
+    pub lints: Vec<linter::Diagnostic>,
+}
+
+/// Errors of a set of modules type checked on their own.
+type ModuleErrors = Vec<(Span, String)>;
+
+/// Lex and parse `text`.
+pub fn parse(filename: &str, text: &str) -> Result<Program, String> {
+    let mut lexer = Lexer::new(filename, text);
+    let tokens = lexer.scan_tokens()?;
+    let mut parser = Parser::new(filename, tokens);
+    parser.parse()
+}
+
+/// Type check and lint the `parsed` program together with `modules` (the
+/// programs it imports, dependencies first). `module_errors` holds the
+/// errors of the modules on their own, computed here if needed.
+pub fn analyze(
+    filename: &str,
+    parsed: &Result<Arc<Program>, String>,
+    modules: &[Arc<Program>],
+    module_errors: &mut Option<ModuleErrors>,
+) -> Analysis {
+    let mut analysis = Analysis::default();
+    let program = match parsed {
+        Ok(program) => program,
+        Err(e) => {
+            analysis.parse_error = Some(e.clone());
+            return analysis;
+        }
+    };
+
+    // Dependencies first, as the module loader merges them
+    let user_item_count = program.items.len();
+    let mut items = module_items(modules);
+    items.extend(program.items.iter().cloned());
+    let Ok(mut merged) = prepend_stdlib(Program { items }) else {
+        return analysis;
+    };
+    let skip_items = merged.items.len() - user_item_count;
+
+    let mut typechecker = TypeChecker::new(filename);
+    match typechecker.check_program(&mut merged) {
+        Ok(()) => {
+            let rules = linter::default_rules();
+            analysis.lints = linter::lint_program(&merged, filename, &rules, skip_items);
+        }
+        Err(mut errors) => {
+            if !modules.is_empty() {
+                let known = module_errors.get_or_insert_with(|| check_modules(filename, modules));
+                errors.retain(|e| !known.contains(&(e.span, e.message.clone())));
+            }
+            analysis.type_errors = errors;
+        }
+    }
+    analysis
+}
+
+/// The items `modules` contribute to an importing program.
+fn module_items(modules: &[Arc<Program>]) -> Vec<Item> {
+    modules
+        .iter()
+        .flat_map(|module| module.items.iter())
+        .filter(|item| !matches!(item, Item::Import(_) | Item::Statement(_)))
+        .cloned()
+        .collect()
+}
+
+/// Errors of `modules` type checked without an importing file.
+fn check_modules(filename: &str, modules: &[Arc<Program>]) -> ModuleErrors {
+    let Ok(mut program) = prepend_stdlib(Program {
+        items: module_items(modules),
+    }) else {
+        return Vec::new();
+    };
+    match TypeChecker::new(filename).check_program(&mut program) {
+        Ok(()) => Vec::new(),
+        Err(errors) => errors.into_iter().map(|e| (e.span, e.message)).collect(),
+    }
+}
+
+/// Remove `.` and `..` components, so the paths of one file agree however
+/// an import reached it.
+fn normalize(path: &Path) -> PathBuf {
+    let mut out = PathBuf::new();
+    for component in path.components() {
+        match component {
+            Component::CurDir => {}
+            Component::ParentDir if out.file_name().is_some() => {
+                out.pop();
+            }
+            other => out.push(other),
+        }
+    }
+    out
+}
+
+struct FileState {
+    /// Editor version of `text` (0 for files read from disk)
+    version: i32,
+    /// Content hash of `text`
+    hash: u64,
+    /// AST of `text`, or its lexer/parser error
+    parsed: Result<Arc<Program>, String>,
+    /// Symbols of the last version that parsed
+    symbols: Arc<SymbolTable>,
+    /// Files `text` imports, as they resolve
+    imports: Vec<PathBuf>,
+    /// URI of the document while the editor has it open
+    uri: Option<String>,
+    /// Last analysis, with the fingerprint it was made for
+    analysis: Option<(u64, Arc<Analysis>)>,
+}
+
+/// A pending analysis of one file; it runs without the workspace lock.
+pub struct AnalysisJob {
+    path: PathBuf,
+    hash: u64,
+    fingerprint: u64,
+    parsed: Result<Arc<Program>, String>,
+    modules: Vec<Arc<Program>>,
+    /// Fingerprint of `modules` alone
+    modules_fingerprint: u64,
+    module_errors: Option<ModuleErrors>,
+}
+
+impl AnalysisJob {
+    /// Check the file. Returns the job's key for `Workspace::finish`.
+    pub fn run(mut self) -> (AnalysisKey, Analysis) {
+        let filename = self.path.to_string_lossy();
+        let analysis = analyze(
+            &filename,
+            &self.parsed,
+            &self.modules,
+            &mut self.module_errors,
+        );
+        let key = AnalysisKey {
+            path: self.path,
+            hash: self.hash,
+            fingerprint: self.fingerprint,
+            modules_fingerprint: self.modules_fingerprint,
+            module_errors: self.module_errors,
+        };
+        (key, analysis)
+    }
+}
+
+/// What an analysis was made from.
+pub struct AnalysisKey {
+    path: PathBuf,
+    hash: u64,
+    fingerprint: u64,
+    modules_fingerprint: u64,
+    module_errors: Option<ModuleErrors>,
+}
+
+/// All files the server knows, with their ASTs, symbols and analyses.
+#[derive(Default)]
+pub struct Workspace {
+    files: HashMap<PathBuf, FileState>,
+    /// Errors of sets of imported modules on their own, by fingerprint
+    module_errors: HashMap<u64, ModuleErrors>,
+}
+
+impl Workspace {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Set the text of `path`. Open documents pass their `uri` and editor
+    /// `version`; an update older than the stored version is ignored.
+    /// Returns whether the text changed (and the file was reparsed).
+    pub fn update(&mut self, path: &Path, text: String, version: i32, uri: Option<String>) -> bool {
+        let path = normalize(path);
+        let hash = content_hash(text.as_bytes());
+        if let Some(file) = self.files.get_mut(&path) {
+            // The editor's text wins over the disk, and newer edits over older
+            if file.uri.is_some() && (uri.is_none() || version < file.version) {
+                return false;
+            }
+            file.version = version;
+            if uri.is_some() {
+                file.uri = uri.clone();
+            }
+            if file.hash == hash {
+                return false;
+            }
+        }
+
+        let filename = path.to_string_lossy().to_string();
+        let parsed = parse(&filename, &text).map(Arc::new);
+        let previous = self.files.remove(&path);
+        let (symbols, imports) = match &parsed {
+            Ok(program) => (
+                Arc::new(SymbolTable::from_program(program)),
+                resolve_imports(&path, program),
+            ),
+            // Keep answering queries from the last version that parsed
+            Err(_) => previous
+                .as_ref()
+                .map(|file| (file.symbols.clone(), file.imports.clone()))
+                .unwrap_or_default(),
+        };
+        self.files.insert(
+            path,
+            FileState {
+                version,
+                hash,
+                parsed,
+                symbols,
+                imports,
+                uri: uri.or(previous.and_then(|file| file.uri)),
+                analysis: None,
+            },
+        );
+        true
+    }
+
+    /// The editor closed `path`: go back to the text on disk.
+    pub fn close(&mut self, path: &Path) {
+        let path = normalize(path);
+        if let Some(file) = self.files.get_mut(&path) {
+            file.uri = None;
+        }
+        match std::fs::read_to_string(&path) {
+            Ok(text) => {
+                self.update(&path, text, 0, None);
+            }
+            Err(_) => {
+                self.files.remove(&path);
+            }
+        }
+    }
+
+    /// Editor version of the text of `path`.
+    pub fn version(&self, path: &Path) -> Option<i32> {
+        self.files.get(&normalize(path)).map(|file| file.version)
+    }
+
+    /// URI of `path` if it is open in the editor.
+    pub fn uri(&self, path: &Path) -> Option<&str> {
+        self.files.get(&normalize(path))?.uri.as_deref()
+    }
+
+    /// Number of indexed files.
+    pub fn file_count(&self) -> usize {
+        self.files.len()
+    }
+
+    /// Symbols of `path` (of its last version that parsed).
+    pub fn symbols(&self, path: &Path) -> Option<Arc<SymbolTable>> {
+        Some(self.files.get(&normalize(path))?.symbols.clone())
+    }
+
+    /// Symbols of every indexed file.
+    pub fn all_symbols(&self) -> impl Iterator<Item = (&Path, &SymbolTable)> {
+        self.files
+            .iter()
+            .map(|(path, file)| (path.as_path(), file.symbols.as_ref()))
+    }
+
+    /// Open files other than `path` that import it, directly or not.
+    pub fn open_dependents(&self, path: &Path) -> Vec<PathBuf> {
+        let path = normalize(path);
+        let mut dependents: Vec<PathBuf> = self
+            .files
+            .iter()
+            .filter(|(other, file)| {
+                **other != path && file.uri.is_some() && self.module_closure(other).contains(&path)
+            })
+            .map(|(other, _)| other.clone())
+            .collect();
+        dependents.sort();
+        dependents
+    }
+
+    /// The modules `path` reaches through imports, dependencies first.
+    fn module_closure(&self, path: &Path) -> Vec<PathBuf> {
+        fn visit(
+            files: &HashMap<PathBuf, FileState>,
+            path: &Path,
+            seen: &mut HashSet<PathBuf>,
+            out: &mut Vec<PathBuf>,
+        ) {
+            let Some(file) = files.get(path) else {
+                return;
+            };
+            for import in &file.imports {
+                if seen.insert(import.clone()) {
+                    visit(files, import, seen, out);
+                    out.push(import.clone());
+                }
+            }
+        }
+        let mut seen = HashSet::from([path.to_path_buf()]);
+        let mut out = Vec::new();
+        visit(&self.files, path, &mut seen, &mut out);
+        out
+    }
+
+    /// Read the imported modules of `path` that are not indexed yet from
+    /// disk, transitively.
+    fn load_imports(&mut self, path: &Path) {
+        let mut pending = vec![path.to_path_buf()];
+        let mut seen = HashSet::new();
+        while let Some(path) = pending.pop() {
+            if !seen.insert(path.clone()) {
+                continue;
+            }
+            if !self.files.contains_key(&path) {
+                let Ok(text) = std::fs::read_to_string(&path) else {
+                    continue;
+                };
+                self.update(&path, text, 0, None);
+            }
+            if let Some(file) = self.files.get(&path) {
+                pending.extend(file.imports.iter().cloned());
+            }
+        }
+    }
+
+    /// The last analysis of `path` if nothing it depends on changed since,
+    /// or else a job that makes a new one.
+    pub fn analysis(&mut self, path: &Path) -> Result<Arc<Analysis>, AnalysisJob> {
+        let path = normalize(path);
+        self.load_imports(&path);
+
+        let modules = self.module_closure(&path);
+        let mut h = Fnv::new();
+        for module in &modules {
+            h.write(module.to_string_lossy().as_bytes());
+            h.write_u64(self.files[module].hash);
+        }
+        let modules_fingerprint = h.finish();
+        let Some(file) = self.files.get(&path) else {
+            return Ok(Arc::new(Analysis::default()));
+        };
+        h.write_u64(file.hash);
+        let fingerprint = h.finish();
+
+        if let Some((made_for, analysis)) = &file.analysis
+            && *made_for == fingerprint
+        {
+            return Ok(analysis.clone());
+        }
+        Err(AnalysisJob {
+            path: path.clone(),
+            hash: file.hash,
+            fingerprint,
+            parsed: file.parsed.clone(),
+            modules: modules
+                .iter()
+                .filter_map(|module| self.files[module].parsed.clone().ok())
+                .collect(),
+            modules_fingerprint,
+            module_errors: self.module_errors.get(&modules_fingerprint).cloned(),
+        })
+    }
+
+    /// Store the result of an `AnalysisJob`, unless the file changed while
+    /// it ran.
+    pub fn finish(&mut self, key: AnalysisKey, analysis: Analysis) -> Arc<Analysis> {
+        let analysis = Arc::new(analysis);
+        if let Some(errors) = key.module_errors {
+            self.module_errors.insert(key.modules_fingerprint, errors);
+        }
+        if let Some(file) = self.files.get_mut(&key.path)
+            && file.hash == key.hash
+        {
+            file.analysis = Some((key.fingerprint, analysis.clone()));
+        }
+        analysis
+    }
+}
+
+/// The files the imports of `program` (the file at `path`) resolve to.
+/// Imports that do not resolve are left out; the type checker reports the
+/// names they would have defined.
+fn resolve_imports(path: &Path, program: &Program) -> Vec<PathBuf> {
+    let root = path.parent().unwrap_or(Path::new(".")).to_path_buf();
+    let loader = ModuleLoader::new(root);
+    program
+        .items
+        .iter()
+        .filter_map(|item| match item {
+            Item::Import(import) => loader.resolve_import(import, path).ok(),
+            _ => None,
+        })
+        .map(|import| normalize(&import))
+        .collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::fs;
+
+    fn analyze_now(workspace: &mut Workspace, path: &Path) -> Arc<Analysis> {
+        match workspace.analysis(path) {
+            Ok(analysis) => analysis,
+            Err(job) => {
+                let (key, analysis) = job.run();
+                workspace.finish(key, analysis)
+            }
+        }
+    }
+
+    /// Names of the type errors of `path`.
+    fn type_errors(workspace: &mut Workspace, path: &Path) -> Vec<String> {
+        let analysis = analyze_now(workspace, path);
+        assert_eq!(analysis.parse_error, None);
+        analysis
+            .type_errors
+            .iter()
+            .map(|e| e.message.clone())
+            .collect()
+    }
+
+    #[test]
+    fn test_imports_are_checked_and_invalidate_dependents() {
+        let temp = tempfile::tempdir().unwrap();
+        let main = temp.path().join("main.mc");
+        let util = temp.path().join("util.mc");
+        fs::write(&util, "fun helper() -> int { return 1; }").unwrap();
+
+        let mut workspace = Workspace::new();
+        let main_text = "import util;\nlet x: int = helper();\nprint(x);";
+        workspace.update(
+            &main,
+            main_text.to_string(),
+            1,
+            Some("file:///main.mc".into()),
+        );
+        assert_eq!(workspace.file_count(), 1);
+        assert!(type_errors(&mut workspace, &main).is_empty());
+        // The import was read from disk and indexed
+        assert_eq!(workspace.file_count(), 2);
+
+        // Unchanged inputs reuse the analysis
+        let first = analyze_now(&mut workspace, &main);
+        assert!(Arc::ptr_eq(&first, &analyze_now(&mut workspace, &main)));
+
+        // Editing the module invalidates its dependent
+        assert_eq!(workspace.open_dependents(&util), vec![main.clone()]);
+        workspace.update(&util, "fun other() -> int { return 1; }".into(), 0, None);
+        let errors = type_errors(&mut workspace, &main);
+        assert!(
+            errors.iter().any(|e| e.contains("helper")),
+            "expected an error about helper, got {:?}",
+            errors
+        );
+    }
+
+    #[test]
+    fn test_module_errors_stay_in_the_module() {
+        let temp = tempfile::tempdir().unwrap();
+        let main = temp.path().join("main.mc");
+        let util = temp.path().join("util.mc");
+        fs::write(&util, "fun helper() -> int { return \"no\"; }").unwrap();
+
+        let mut workspace = Workspace::new();
+        workspace.update(&main, "import util;\nprint(helper());".into(), 1, None);
+        assert!(type_errors(&mut workspace, &main).is_empty());
+        assert!(!type_errors(&mut workspace, &util).is_empty());
+    }
+
+    #[test]
+    fn test_symbols_survive_a_parse_error() {
+        let path = Path::new("/nonexistent/a.mc");
+        let mut workspace = Workspace::new();
+        workspace.update(
+            path,
+            "fun f() { return 1; }".into(),
+            1,
+            Some("file:///a.mc".into()),
+        );
+        assert!(
+            workspace
+                .symbols(path)
+                .unwrap()
+                .get_definition("f")
+                .is_some()
+        );
+
+        let uri = Some("file:///a.mc".to_string());
+        assert!(workspace.update(path, "fun f( {".into(), 2, uri.clone()));
+        assert!(analyze_now(&mut workspace, path).parse_error.is_some());
+        assert!(
+            workspace
+                .symbols(path)
+                .unwrap()
+                .get_definition("f")
+                .is_some()
+        );
+
+        // Out-of-order edits and disk reads of an open document are dropped
+        assert!(!workspace.update(path, "fun g() {}".into(), 1, uri));
+        assert!(!workspace.update(path, "fun g() {}".into(), 3, None));
+        assert_eq!(workspace.version(path), Some(2));
+    }
+
+    #[test]
+    fn test_normalize() {
+        assert_eq!(
+            normalize(Path::new("/a/./b/../c.mc")),
+            PathBuf::from("/a/c.mc")
+        );
+    }
+}
@@ -12,7 +12,7 @@ mod lsp;
 mod package;
 mod vm;
 
-use config::{GcMode, JitMode, RuntimeConfig, TimingsFormat};
+use config::{GcMode, JitMode, OptLevel, OutputBuffering, RuntimeConfig, TimingsFormat};
 
 // Wrapper types for clap ValueEnum support
 #[derive(Debug, Clone, Copy, ValueEnum, Default)]
@@ -49,6 +49,47 @@ impl From<GcModeArg> for GcMode {
     }
 }
 
+#[derive(Debug, Clone, Copy, ValueEnum, Default)]
+pub enum OutputBufferingArg {
+    #[default]
+    Auto,
+    Unbuffered,
+    Line,
+    Block,
+}
+
+impl From<OutputBufferingArg> for OutputBuffering {
+    fn from(arg: OutputBufferingArg) -> Self {
+        match arg {
+            OutputBufferingArg::Auto => OutputBuffering::Auto,
+            OutputBufferingArg::Unbuffered => OutputBuffering::Unbuffered,
+            OutputBufferingArg::Line => OutputBuffering::Line,
+            OutputBufferingArg::Block => OutputBuffering::Block,
+        }
+    }
+}
+
+#[derive(Debug, Clone, Copy, ValueEnum, Default)]
+pub enum OptLevelArg {
+    #[default]
+    #[value(name = "0")]
+    O0,
+    #[value(name = "1")]
+    O1,
+    #[value(name = "2")]
+    O2,
+}
+
+impl From<OptLevelArg> for OptLevel {
+    fn from(arg: OptLevelArg) -> Self {
+        match arg {
+            OptLevelArg::O0 => OptLevel::O0,
+            OptLevelArg::O1 => OptLevel::O1,
+            OptLevelArg::O2 => OptLevel::O2,
+        }
+    }
+}
+
 #[derive(Debug, Clone, Copy, ValueEnum, Default)]
 pub enum TimingsFormatArg {
     #[default]
@@ -97,6 +138,10 @@ enum Commands {
         #[arg(long, default_value = "0")]
         timeout: u64,
 
+        /// Bytecode optimization level (0, 1, 2)
+        #[arg(short = 'O', long, value_enum, default_value = "0")]
+        opt_level: OptLevelArg,
+
         /// JIT compilation mode (off, on, auto)
         #[arg(long, value_enum, default_value = "auto")]
         jit: JitModeArg,
@@ -105,10 +150,27 @@ enum Commands {
         #[arg(long, default_value = "1000")]
         jit_threshold: u32,
 
+        /// Loop iterations before a loop is JIT compiled (default: threshold / 10)
+        #[arg(long)]
+        jit_osr_threshold: Option<u32>,
+
+        /// Compile hot functions on a background thread
+        #[arg(long)]
+        jit_background: bool,
+
+        /// Compilations kept waiting with --jit-background (hottest first)
+        #[arg(long, default_value = "64")]
+        jit_queue_depth: usize,
+
         /// Trace JIT compilation events
         #[arg(long)]
         trace_jit: bool,
 
+        /// Reuse the bytecode of an earlier run while no source file changed,
+        /// caching it in DIR (default: .moca-cache)
+        #[arg(long, value_name = "DIR", num_args = 0..=1, require_equals = true)]
+        compile_cache: Option<Option<PathBuf>>,
+
         /// GC mode (stw, concurrent)
         #[arg(long, value_enum, default_value = "stw")]
         gc_mode: GcModeArg,
@@ -117,6 +179,10 @@ enum Commands {
         #[arg(long)]
         gc_stats: bool,
 
+        /// Output buffering (auto, unbuffered, line, block)
+        #[arg(long, value_enum, default_value = "auto")]
+        output_buffering: OutputBufferingArg,
+
         /// Dump AST to stderr, or to a file with --dump-ast=path
         #[arg(long, value_name = "FILE", num_args = 0..=1)]
         dump_ast: Option<Option<PathBuf>>,
@@ -137,10 +203,18 @@ enum Commands {
         #[arg(long, value_name = "FILE", num_args = 0..=1)]
         dump_microops: Option<Option<PathBuf>>,
 
-        /// Profile opcode execution counts
+        /// Profile opcode execution counts and the most frequent opcode pairs
         #[arg(long)]
         profile_opcodes: bool,
 
+        /// Sample call stacks and write them to FILE in folded-stack (flamegraph) format
+        #[arg(long, value_name = "FILE")]
+        sample_profile: Option<PathBuf>,
+
+        /// Write /tmp/perf-<pid>.map so perf can name JIT code
+        #[arg(long)]
+        perf_map: bool,
+
         /// Print compiler pipeline timings (human or json format)
         #[arg(long, value_enum, require_equals = true, num_args = 0..=1, default_missing_value = "human")]
         timings: Option<TimingsFormatArg>,
@@ -185,26 +259,42 @@ fn main() -> ExitCode {
             script_args,
             code,
             timeout,
+            opt_level,
             jit,
             jit_threshold,
+            jit_osr_threshold,
+            jit_background,
+            jit_queue_depth,
             trace_jit,
+            compile_cache,
             gc_mode,
             gc_stats,
+            output_buffering,
             dump_ast,
             dump_monomorphised,
             dump_resolved,
             dump_bytecode,
             dump_microops,
             profile_opcodes,
+            sample_profile,
+            perf_map,
             timings,
         } => {
             let config = RuntimeConfig {
+                opt_level: opt_level.into(),
                 jit_mode: jit.into(),
                 jit_threshold,
+                jit_osr_threshold,
+                jit_background: jit_background.then_some(jit_queue_depth),
                 trace_jit,
                 gc_mode: gc_mode.into(),
                 gc_stats,
                 profile_opcodes,
+                output_buffering: output_buffering.into(),
+                sample_profile,
+                perf_map,
+                compile_cache: compile_cache
+                    .map(|dir| dir.unwrap_or_else(|| compiler::cache::DEFAULT_DIR.into())),
                 ..Default::default()
             };
 
@@ -0,0 +1,506 @@
+//! Bulk operations on typed arrays.
+//!
+//! A `HeapBulk` op fills, copies, compares or searches a run of array
+//! elements, or combines F64 arrays elementwise, in one instruction instead
+//! of a bytecode loop. Fill, copy and compare become `memset`, `memmove` and
+//! `memcmp`, which the C library already vectorizes. The byte search and
+//! the F64 kernels here pick a vector path at run time: AVX2 (AVX and FMA
+//! for floats) or SSE2 on x86-64, NEON on AArch64, and a scalar loop
+//! elsewhere. Every path rounds the same way, so results do not depend on
+//! the CPU.
+
+/// Which bulk operation a `HeapBulk` op performs. Operands are popped in
+/// the order listed.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub enum BulkOp {
+    /// `ref, start, count, value`: set `ref[start..start + count]` to `value`
+    Fill = 0,
+    /// `dst, dst_start, src, src_start, count`: copy `count` elements;
+    /// the ranges may overlap
+    Copy = 1,
+    /// `a, a_start, b, b_start, count` → bool: whether the two runs hold the
+    /// same element bits
+    Equal = 2,
+    /// `ref, start, end, value` → int: index of the first element in
+    /// `start..end` whose bits equal `value`'s, or -1
+    Find = 3,
+    /// `dst, a, b, count`: `dst[i] = a[i] + b[i]` on F64 arrays
+    AddF64 = 4,
+    /// `dst, a, b, count`: `dst[i] = a[i] * b[i]` on F64 arrays
+    MulF64 = 5,
+    /// `dst, a, b, c, count`: `dst[i] = a[i] * b[i] + c[i]`, rounded once
+    FmaF64 = 6,
+}
+
+impl BulkOp {
+    pub fn from_raw(raw: u8) -> Option<Self> {
+        Some(match raw {
+            0 => BulkOp::Fill,
+            1 => BulkOp::Copy,
+            2 => BulkOp::Equal,
+            3 => BulkOp::Find,
+            4 => BulkOp::AddF64,
+            5 => BulkOp::MulF64,
+            6 => BulkOp::FmaF64,
+            _ => return None,
+        })
+    }
+
+    /// Number of operands popped.
+    pub fn arity(self) -> usize {
+        match self {
+            BulkOp::Fill | BulkOp::Find | BulkOp::AddF64 | BulkOp::MulF64 => 4,
+            BulkOp::Copy | BulkOp::Equal | BulkOp::FmaF64 => 5,
+        }
+    }
+
+    /// What operand `i` holds. Only the value of a fill or find is not an
+    /// array or an int, so a JIT can tag the other operands statically.
+    pub fn operand(self, i: usize) -> Operand {
+        match (self, i) {
+            (BulkOp::Fill | BulkOp::Find, 3) => Operand::Value,
+            (BulkOp::Copy | BulkOp::Equal, 0 | 2) => Operand::Array,
+            (BulkOp::Fill | BulkOp::Find, 0) => Operand::Array,
+            (BulkOp::AddF64 | BulkOp::MulF64, 0..=2) => Operand::Array,
+            (BulkOp::FmaF64, 0..=3) => Operand::Array,
+            _ => Operand::Int,
+        }
+    }
+
+    /// Whether the op pushes a result.
+    pub fn has_result(self) -> bool {
+        matches!(self, BulkOp::Equal | BulkOp::Find)
+    }
+
+    pub fn name(self) -> &'static str {
+        match self {
+            BulkOp::Fill => "fill",
+            BulkOp::Copy => "copy",
+            BulkOp::Equal => "equal",
+            BulkOp::Find => "find",
+            BulkOp::AddF64 => "add_f64",
+            BulkOp::MulF64 => "mul_f64",
+            BulkOp::FmaF64 => "fma_f64",
+        }
+    }
+
+    pub fn from_name(name: &str) -> Option<Self> {
+        (0..=6)
+            .filter_map(BulkOp::from_raw)
+            .find(|op| op.name() == name)
+    }
+}
+
+/// Kind of a `HeapBulk` operand.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Operand {
+    Array,
+    Int,
+    /// Any value
+    Value,
+}
+
+/// Index of the first `needle` in `haystack`.
+pub fn find_byte(haystack: &[u8], needle: u8) -> Option<usize> {
+    #[cfg(target_arch = "x86_64")]
+    {
+        if std::is_x86_feature_detected!("avx2") {
+            // SAFETY: the CPU supports AVX2
+            return unsafe { x86::find_byte_avx2(haystack, needle) };
+        }
+        // SSE2 is part of the x86-64 baseline
+        x86::find_byte_sse2(haystack, needle)
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        // SAFETY: NEON is part of the AArch64 baseline
+        unsafe { neon::find_byte(haystack, needle) }
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    {
+        haystack.iter().position(|&b| b == needle)
+    }
+}
+
+/// Index of the first 8-byte element of `data` equal to `needle`.
+pub fn find_u64(data: &[u8], needle: u64) -> Option<usize> {
+    let needle = needle.to_le_bytes();
+    data.chunks_exact(8).position(|elem| elem == needle)
+}
+
+/// Apply the F64 op `op` to `n` elements of `memory`: the destination
+/// starts at byte offset `dst` and the sources at `srcs` (`c` is only read
+/// by `FmaF64`). A destination that partly overlaps a source is processed
+/// one element at a time, in order.
+///
+/// Panics if a range is outside `memory`.
+pub fn map_f64(memory: &mut [u8], op: BulkOp, dst: usize, srcs: [usize; 3], n: usize) {
+    let bytes = n * 8;
+    let reads = if op == BulkOp::FmaF64 { 3 } else { 2 };
+    for &at in [dst].iter().chain(&srcs[..reads]) {
+        assert!(at + bytes <= memory.len(), "F64 range out of bounds");
+    }
+    let disjoint = srcs[..reads]
+        .iter()
+        .all(|&src| src == dst || src + bytes <= dst || dst + bytes <= src);
+
+    let base = memory.as_mut_ptr();
+    // SAFETY: every range was checked to lie within `memory`
+    unsafe {
+        let d = base.add(dst);
+        let [a, b, c] = srcs.map(|src| base.add(src) as *const u8);
+        let done = if disjoint {
+            map_f64_vector(op, d, a, b, c, n)
+        } else {
+            0
+        };
+        map_f64_scalar(op, d, a, b, c, done, n);
+    }
+}
+
+/// Run the widest available vector kernel; returns how many leading
+/// elements it handled.
+///
+/// # Safety
+/// `d`, `a` and `b` (and `c` for fma) must be valid for `n` F64 elements.
+unsafe fn map_f64_vector(
+    op: BulkOp,
+    d: *mut u8,
+    a: *const u8,
+    b: *const u8,
+    c: *const u8,
+    n: usize,
+) -> usize {
+    #[cfg(target_arch = "x86_64")]
+    {
+        if op == BulkOp::FmaF64 {
+            // Without FMA the scalar `mul_add` keeps the single rounding
+            if std::is_x86_feature_detected!("fma") && std::is_x86_feature_detected!("avx") {
+                // SAFETY: the CPU supports AVX and FMA
+                return unsafe { x86::fma_f64_avx(d, a, b, c, n) };
+            }
+            return 0;
+        }
+        if std::is_x86_feature_detected!("avx") {
+            // SAFETY: the CPU supports AVX
+            return unsafe { x86::map_f64_avx(op, d, a, b, n) };
+        }
+        // SAFETY: SSE2 is part of the x86-64 baseline
+        unsafe { x86::map_f64_sse2(op, d, a, b, n) }
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        // SAFETY: NEON is part of the AArch64 baseline
+        unsafe { neon::map_f64(op, d, a, b, c, n) }
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    {
+        let _ = (op, d, a, b, c, n);
+        0
+    }
+}
+
+/// # Safety
+/// As for `map_f64_vector`.
+unsafe fn map_f64_scalar(
+    op: BulkOp,
+    d: *mut u8,
+    a: *const u8,
+    b: *const u8,
+    c: *const u8,
+    from: usize,
+    n: usize,
+) {
+    let read = |p: *const u8, i: usize| {
+        // SAFETY: `i < n`, so element `i` is in range
+        f64::from_bits(unsafe { (p.add(i * 8) as *const u64).read_unaligned() })
+    };
+    for i in from..n {
+        let value = match op {
+            BulkOp::AddF64 => read(a, i) + read(b, i),
+            BulkOp::MulF64 => read(a, i) * read(b, i),
+            BulkOp::FmaF64 => read(a, i).mul_add(read(b, i), read(c, i)),
+            _ => unreachable!("{} is not an F64 op", op.name()),
+        };
+        // SAFETY: as above
+        unsafe { (d.add(i * 8) as *mut u64).write_unaligned(value.to_bits()) };
+    }
+}
+
+#[cfg(target_arch = "x86_64")]
+mod x86 {
+    use super::BulkOp;
+    use std::arch::x86_64::*;
+
+    #[target_feature(enable = "avx2")]
+    pub unsafe fn find_byte_avx2(haystack: &[u8], needle: u8) -> Option<usize> {
+        let p = haystack.as_ptr();
+        let pattern = _mm256_set1_epi8(needle as i8);
+        let mut i = 0;
+        while i + 32 <= haystack.len() {
+            // SAFETY: bytes `i..i + 32` are in `haystack`
+            let chunk = unsafe { _mm256_loadu_si256(p.add(i) as *const __m256i) };
+            let mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, pattern)) as u32;
+            if mask != 0 {
+                return Some(i + mask.trailing_zeros() as usize);
+            }
+            i += 32;
+        }
+        find_byte_sse2(&haystack[i..], needle).map(|k| i + k)
+    }
+
+    pub fn find_byte_sse2(haystack: &[u8], needle: u8) -> Option<usize> {
+        let p = haystack.as_ptr();
+        let mut i = 0;
+        // SAFETY: SSE2 is part of the x86-64 baseline; bytes `i..i + 16`
+        // are in `haystack`
+        unsafe {
+            let pattern = _mm_set1_epi8(needle as i8);
+            while i + 16 <= haystack.len() {
+                let chunk = _mm_loadu_si128(p.add(i) as *const __m128i);
+                let mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern)) as u32;
+                if mask != 0 {
+                    return Some(i + mask.trailing_zeros() as usize);
+                }
+                i += 16;
+            }
+        }
+        haystack[i..]
+            .iter()
+            .position(|&b| b == needle)
+            .map(|k| i + k)
+    }
+
+    /// Expand to a loop applying `$f` to `$lanes`-wide vectors of `a` and
+    /// `b`; evaluates to the number of elements handled.
+    macro_rules! lanes {
+        ($lanes:expr, $load:ident, $store:ident, $d:expr, $a:expr, $b:expr, $n:expr, $f:ident) => {{
+            let mut i = 0;
+            while i + $lanes <= $n {
+                // SAFETY: elements `i..i + $lanes` are in range
+                unsafe {
+                    let x = $load($a.add(i * 8) as *const f64);
+                    let y = $load($b.add(i * 8) as *const f64);
+                    $store($d.add(i * 8) as *mut f64, $f(x, y));
+                }
+                i += $lanes;
+            }
+            i
+        }};
+    }
+
+    #[target_feature(enable = "avx")]
+    pub unsafe fn map_f64_avx(
+        op: BulkOp,
+        d: *mut u8,
+        a: *const u8,
+        b: *const u8,
+        n: usize,
+    ) -> usize {
+        match op {
+            BulkOp::AddF64 => lanes!(
+                4,
+                _mm256_loadu_pd,
+                _mm256_storeu_pd,
+                d,
+                a,
+                b,
+                n,
+                _mm256_add_pd
+            ),
+            BulkOp::MulF64 => lanes!(
+                4,
+                _mm256_loadu_pd,
+                _mm256_storeu_pd,
+                d,
+                a,
+                b,
+                n,
+                _mm256_mul_pd
+            ),
+            _ => 0,
+        }
+    }
+
+    pub unsafe fn map_f64_sse2(
+        op: BulkOp,
+        d: *mut u8,
+        a: *const u8,
+        b: *const u8,
+        n: usize,
+    ) -> usize {
+        match op {
+            BulkOp::AddF64 => lanes!(2, _mm_loadu_pd, _mm_storeu_pd, d, a, b, n, _mm_add_pd),
+            BulkOp::MulF64 => lanes!(2, _mm_loadu_pd, _mm_storeu_pd, d, a, b, n, _mm_mul_pd),
+            _ => 0,
+        }
+    }
+
+    #[target_feature(enable = "avx,fma")]
+    pub unsafe fn fma_f64_avx(
+        d: *mut u8,
+        a: *const u8,
+        b: *const u8,
+        c: *const u8,
+        n: usize,
+    ) -> usize {
+        let mut i = 0;
+        while i + 4 <= n {
+            // SAFETY: elements `i..i + 4` are in range
+            unsafe {
+                let x = _mm256_loadu_pd(a.add(i * 8) as *const f64);
+                let y = _mm256_loadu_pd(b.add(i * 8) as *const f64);
+                let z = _mm256_loadu_pd(c.add(i * 8) as *const f64);
+                _mm256_storeu_pd(d.add(i * 8) as *mut f64, _mm256_fmadd_pd(x, y, z));
+            }
+            i += 4;
+        }
+        i
+    }
+}
+
+#[cfg(target_arch = "aarch64")]
+mod neon {
+    use super::BulkOp;
+    use std::arch::aarch64::*;
+
+    #[target_feature(enable = "neon")]
+    pub unsafe fn find_byte(haystack: &[u8], needle: u8) -> Option<usize> {
+        let p = haystack.as_ptr();
+        let pattern = vdupq_n_u8(needle);
+        let mut i = 0;
+        while i + 16 <= haystack.len() {
+            // SAFETY: bytes `i..i + 16` are in `haystack`
+            let chunk = unsafe { vld1q_u8(p.add(i)) };
+            if vmaxvq_u8(vceqq_u8(chunk, pattern)) != 0 {
+                break;
+            }
+            i += 16;
+        }
+        haystack[i..]
+            .iter()
+            .position(|&b| b == needle)
+            .map(|k| i + k)
+    }
+
+    #[target_feature(enable = "neon")]
+    pub unsafe fn map_f64(
+        op: BulkOp,
+        d: *mut u8,
+        a: *const u8,
+        b: *const u8,
+        c: *const u8,
+        n: usize,
+    ) -> usize {
+        let mut i = 0;
+        while i + 2 <= n {
+            // SAFETY: elements `i..i + 2` are in range
+            unsafe {
+                let x = vld1q_f64(a.add(i * 8) as *const f64);
+                let y = vld1q_f64(b.add(i * 8) as *const f64);
+                let r = match op {
+                    BulkOp::AddF64 => vaddq_f64(x, y),
+                    BulkOp::MulF64 => vmulq_f64(x, y),
+                    BulkOp::FmaF64 => vfmaq_f64(vld1q_f64(c.add(i * 8) as *const f64), x, y),
+                    _ => return 0,
+                };
+                vst1q_f64(d.add(i * 8) as *mut f64, r);
+            }
+            i += 2;
+        }
+        i
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_find_byte_every_position() {
+        // Crosses the 16- and 32-byte vector widths and their tails
+        for len in [0, 1, 15, 16, 17, 31, 32, 33, 70] {
+            let mut data = vec![b'a'; len];
+            assert_eq!(find_byte(&data, b'x'), None);
+            for at in (0..len).rev() {
+                data[at] = b'x';
+                assert_eq!(find_byte(&data, b'x'), Some(at), "len {len}");
+            }
+        }
+    }
+
+    #[test]
+    fn test_find_u64() {
+        let data: Vec<u8> = [5u64, 7, 9, 7]
+            .iter()
+            .flat_map(|v| v.to_le_bytes())
+            .collect();
+        assert_eq!(find_u64(&data, 7), Some(1));
+        assert_eq!(find_u64(&data, 8), None);
+    }
+
+    fn f64_bytes(values: &[f64]) -> Vec<u8> {
+        values
+            .iter()
+            .flat_map(|v| v.to_bits().to_le_bytes())
+            .collect()
+    }
+
+    fn read_f64(memory: &[u8], at: usize, n: usize) -> Vec<f64> {
+        memory[at..at + n * 8]
+            .chunks_exact(8)
+            .map(|c| f64::from_le_bytes(c.try_into().unwrap()))
+            .collect()
+    }
+
+    #[test]
+    fn test_map_f64_matches_scalar() {
+        let n = 11;
+        let a: Vec<f64> = (0..n).map(|i| i as f64 * 0.1 + 1.0 / 3.0).collect();
+        let b: Vec<f64> = (0..n).map(|i| 7.0 - i as f64 * 0.7).collect();
+        let c: Vec<f64> = (0..n).map(|i| i as f64 * 1e-17).collect();
+        // Odd byte offsets keep every access unaligned
+        let mut memory = vec![0u8; 3];
+        for values in [&a, &b, &c] {
+            memory.extend(f64_bytes(values));
+        }
+        let dst = memory.len();
+        memory.extend(vec![0u8; n * 8]);
+        let srcs = [3, 3 + n * 8, 3 + 2 * n * 8];
+
+        for (op, expect) in [
+            (
+                BulkOp::AddF64,
+                (0..n).map(|i| a[i] + b[i]).collect::<Vec<_>>(),
+            ),
+            (BulkOp::MulF64, (0..n).map(|i| a[i] * b[i]).collect()),
+            (
+                BulkOp::FmaF64,
+                (0..n).map(|i| a[i].mul_add(b[i], c[i])).collect(),
+            ),
+        ] {
+            map_f64(&mut memory, op, dst, srcs, n);
+            assert_eq!(read_f64(&memory, dst, n), expect, "{}", op.name());
+        }
+    }
+
+    #[test]
+    fn test_map_f64_overlapping_runs_in_order() {
+        // dst is a shifted by one element: each sum feeds the next
+        let mut memory = f64_bytes(&[1.0; 9]);
+        map_f64(&mut memory, BulkOp::AddF64, 8, [0, 0, 0], 8);
+        let expect: Vec<f64> = (0..9).map(|i| 2f64.powi(i)).collect();
+        assert_eq!(read_f64(&memory, 0, 9), expect);
+    }
+
+    #[test]
+    fn test_bulk_op_names_round_trip() {
+        for raw in 0..=6 {
+            let op = BulkOp::from_raw(raw).unwrap();
+            assert_eq!(op as u8, raw);
+            assert_eq!(BulkOp::from_name(op.name()), Some(op));
+        }
+        assert_eq!(BulkOp::from_raw(7), None);
+    }
+}
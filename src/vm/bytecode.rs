@@ -1,23 +1,37 @@
 //! Bytecode serialization/deserialization for moca.
 //!
-//! Binary format:
+//! Binary format (version 3):
 //! - Magic: "MOCA" (4 bytes)
 //! - Version: u32 (little-endian)
-//! - String pool: length + strings
-//! - Functions: count + function data
-//! - Main function
+//! - String pool: count + (offset, len) table + UTF-8 data blob
+//! - Function table: count + function headers (name, arity, locals, local
+//!   types, stackmap, op count and byte range of the body)
+//! - Main function header
+//! - Type and interface descriptors
 //! - Debug info (optional)
+//! - Code section: all function bodies back to back
+//!
+//! Headers come first and bodies last, so a loader only has to touch the
+//! headers; `load` keeps a reference to the source bytes and decodes each
+//! body on first use. Version 2 files (bodies inline after each header) are
+//! still read, eagerly.
 
+use super::bulk::BulkOp;
+use super::code::{BytecodeSource, Code, StringPool};
 use super::heap::ElemKind;
 use super::stackmap::{FunctionStackMap, RefBitset, StackMapEntry};
-use super::{Chunk, Function, Op, ValueType};
+use super::{Chunk, Function, InterfaceDescriptor, Op, TypeDescriptor, ValueType};
 use std::io::{self, Read, Write};
+use std::sync::Arc;
 
 /// Magic bytes for moca bytecode files
 pub const MAGIC: &[u8; 4] = b"MOCA";
 
 /// Current bytecode format version
-pub const VERSION: u32 = 2;
+pub const VERSION: u32 = 3;
+
+/// Last format version with function bodies stored inline (read eagerly)
+pub const VERSION_INLINE: u32 = 2;
 
 /// Error type for bytecode operations
 #[derive(Debug)]
@@ -68,11 +82,135 @@ pub fn serialize(chunk: &Chunk) -> Vec<u8> {
 }
 
 /// Deserialize a Chunk from bytes
+///
+/// Version 3 function bodies are decoded lazily from a copy of `data`.
 pub fn deserialize(data: &[u8]) -> Result<Chunk, BytecodeError> {
+    if read_version(data)? == VERSION {
+        return load(Arc::new(BytecodeSource::from_vec(data.to_vec())));
+    }
     let mut cursor = std::io::Cursor::new(data);
     read_chunk(&mut cursor)
 }
 
+/// Load a Chunk that borrows its function bodies and strings from `source`.
+///
+/// Only headers are decoded here; each function body is decoded on first
+/// access. Version 2 sources are decoded eagerly.
+pub fn load(source: Arc<BytecodeSource>) -> Result<Chunk, BytecodeError> {
+    let data = source.as_bytes();
+    if read_version(data)? != VERSION {
+        return read_chunk(&mut std::io::Cursor::new(data));
+    }
+
+    let mut r = std::io::Cursor::new(data);
+    r.set_position(8);
+
+    // String pool: offsets are relative to the data blob that follows the table
+    let string_count = read_u32(&mut r)? as usize;
+    let mut entries = Vec::with_capacity(string_count.min(data.len() / 8));
+    for _ in 0..string_count {
+        let offset = read_u32(&mut r)? as usize;
+        let len = read_u32(&mut r)? as usize;
+        entries.push((offset, len));
+    }
+    let blob_len = read_u32(&mut r)? as usize;
+    let blob_base = r.position() as usize;
+    if blob_base + blob_len > data.len() {
+        return Err(BytecodeError::UnexpectedEof);
+    }
+    for entry in &mut entries {
+        if entry.0 + entry.1 > blob_len {
+            return Err(BytecodeError::UnexpectedEof);
+        }
+        entry.0 += blob_base;
+    }
+    let strings = StringPool::mapped(source.clone(), entries)?;
+    r.set_position((blob_base + blob_len) as u64);
+
+    // Function headers; body ranges are resolved once the code section is found
+    let func_count = read_u32(&mut r)? as usize;
+    let mut headers = Vec::with_capacity(func_count.min(data.len()));
+    for _ in 0..func_count {
+        headers.push(read_function_header(&mut r)?);
+    }
+    let main_header = read_function_header(&mut r)?;
+
+    let (type_descriptors, interface_descriptors) = read_descriptors(&mut r)?;
+
+    // Debug info (not serialized for now)
+    let _has_debug = read_u8(&mut r)?;
+
+    let code_len = read_u32(&mut r)? as usize;
+    let code_base = r.position() as usize;
+    if code_base + code_len > data.len() {
+        return Err(BytecodeError::UnexpectedEof);
+    }
+
+    let resolve = |header: FunctionHeader| -> Result<Function, BytecodeError> {
+        let (offset, len) = header.body;
+        if offset + len > code_len {
+            return Err(BytecodeError::UnexpectedEof);
+        }
+        let start = code_base + offset;
+        Ok(Function {
+            name: header.name,
+            arity: header.arity,
+            locals_count: header.locals_count,
+            code: Code::lazy(source.clone(), start, start + len, header.op_count),
+            stackmap: header.stackmap,
+            local_types: header.local_types,
+        })
+    };
+    let functions = headers
+        .into_iter()
+        .map(resolve)
+        .collect::<Result<Vec<_>, _>>()?;
+    let main = resolve(main_header)?;
+
+    Ok(Chunk {
+        functions,
+        main,
+        strings,
+        type_descriptors,
+        interface_descriptors,
+        debug: None,
+    })
+}
+
+/// Decode `count` ops from an encoded function body.
+pub(crate) fn decode_ops(bytes: &[u8], count: usize) -> Result<Vec<Op>, BytecodeError> {
+    let mut r = std::io::Cursor::new(bytes);
+    let mut ops = Vec::with_capacity(count.min(bytes.len()));
+    for _ in 0..count {
+        ops.push(read_op(&mut r)?);
+    }
+    Ok(ops)
+}
+
+/// Encode ops in the function body format read by `decode_ops`.
+pub(crate) fn encode_ops(ops: &[Op]) -> Vec<u8> {
+    let mut out = Vec::new();
+    for op in ops {
+        write_op(&mut out, op).expect("writing to a Vec cannot fail");
+    }
+    out
+}
+
+/// Check the magic bytes and return the format version.
+fn read_version(data: &[u8]) -> Result<u32, BytecodeError> {
+    if data.len() < 8 {
+        return Err(BytecodeError::UnexpectedEof);
+    }
+    if &data[0..4] != MAGIC {
+        return Err(BytecodeError::InvalidMagic);
+    }
+    let version = u32::from_le_bytes(data[4..8].try_into().unwrap());
+    if version != VERSION && version != VERSION_INLINE {
+        return Err(BytecodeError::UnsupportedVersion(version));
+    }
+    Ok(version)
+}
+
 /// Write a Chunk to a writer
 pub fn write_chunk<W: Write>(w: &mut W, chunk: &Chunk) -> io::Result<()> {
     // Magic
@@ -83,19 +221,101 @@ pub fn write_chunk<W: Write>(w: &mut W, chunk: &Chunk) -> io::Result<()> {
 
     // String pool
     write_u32(w, chunk.strings.len() as u32)?;
-    for s in &chunk.strings {
-        write_string(w, s)?;
+    let mut offset = 0u32;
+    for s in chunk.strings.iter() {
+        write_u32(w, offset)?;
+        write_u32(w, s.len() as u32)?;
+        offset += s.len() as u32;
+    }
+    write_u32(w, offset)?;
+    for s in chunk.strings.iter() {
+        w.write_all(s.as_bytes())?;
     }
 
-    // Functions
+    // Function headers; bodies are collected into the code section
+    let mut code = Vec::new();
     write_u32(w, chunk.functions.len() as u32)?;
     for func in &chunk.functions {
-        write_function(w, func)?;
+        write_function_header(w, func, &mut code)?;
+    }
+    write_function_header(w, &chunk.main, &mut code)?;
+
+    write_descriptors(w, chunk)?;
+
+    // Debug info (not serialized for now)
+    w.write_all(&[0u8])?; // has_debug = false
+
+    // Code section
+    write_u32(w, code.len() as u32)?;
+    w.write_all(&code)?;
+
+    Ok(())
+}
+
+/// Read a Chunk from a reader
+///
+/// Version 3 input is buffered and loaded lazily from the buffer.
+pub fn read_chunk<R: Read>(r: &mut R) -> Result<Chunk, BytecodeError> {
+    // Magic
+    let mut magic = [0u8; 4];
+    r.read_exact(&mut magic)
+        .map_err(|_| BytecodeError::UnexpectedEof)?;
+    if &magic != MAGIC {
+        return Err(BytecodeError::InvalidMagic);
+    }
+
+    // Version
+    let version = read_u32(r)?;
+    if version == VERSION {
+        let mut data = Vec::new();
+        data.extend_from_slice(MAGIC);
+        data.extend_from_slice(&version.to_le_bytes());
+        r.read_to_end(&mut data)?;
+        return load(Arc::new(BytecodeSource::from_vec(data)));
+    }
+    if version != VERSION_INLINE {
+        return Err(BytecodeError::UnsupportedVersion(version));
+    }
+
+    // String pool
+    let string_count = read_u32(r)? as usize;
+    let mut strings = Vec::with_capacity(string_count);
+    for _ in 0..string_count {
+        strings.push(read_string(r)?);
+    }
+
+    // Functions
+    let func_count = read_u32(r)? as usize;
+    let mut functions = Vec::with_capacity(func_count);
+    for _ in 0..func_count {
+        functions.push(read_function(r)?);
     }
 
     // Main function
-    write_function(w, &chunk.main)?;
+    let main = read_function(r)?;
+
+    let (type_descriptors, interface_descriptors) = read_descriptors(r)?;
+
+    // Debug info
+    let has_debug = read_u8(r)?;
+    let debug = if has_debug != 0 {
+        // TODO: Implement debug info deserialization
+        None
+    } else {
+        None
+    };
+
+    Ok(Chunk {
+        functions,
+        main,
+        strings: strings.into(),
+        type_descriptors,
+        interface_descriptors,
+        debug,
+    })
+}
 
+fn write_descriptors<W: Write>(w: &mut W, chunk: &Chunk) -> io::Result<()> {
     // Type descriptors
     write_u32(w, chunk.type_descriptors.len() as u32)?;
     for td in &chunk.type_descriptors {
@@ -133,45 +353,13 @@ pub fn write_chunk<W: Write>(w: &mut W, chunk: &Chunk) -> io::Result<()> {
         }
     }
 
-    // Debug info (not serialized for now)
-    w.write_all(&[0u8])?; // has_debug = false
-
     Ok(())
 }
 
-/// Read a Chunk from a reader
-pub fn read_chunk<R: Read>(r: &mut R) -> Result<Chunk, BytecodeError> {
-    // Magic
-    let mut magic = [0u8; 4];
-    r.read_exact(&mut magic)
-        .map_err(|_| BytecodeError::UnexpectedEof)?;
-    if &magic != MAGIC {
-        return Err(BytecodeError::InvalidMagic);
-    }
-
-    // Version
-    let version = read_u32(r)?;
-    if version != VERSION {
-        return Err(BytecodeError::UnsupportedVersion(version));
-    }
-
-    // String pool
-    let string_count = read_u32(r)? as usize;
-    let mut strings = Vec::with_capacity(string_count);
-    for _ in 0..string_count {
-        strings.push(read_string(r)?);
-    }
-
-    // Functions
-    let func_count = read_u32(r)? as usize;
-    let mut functions = Vec::with_capacity(func_count);
-    for _ in 0..func_count {
-        functions.push(read_function(r)?);
-    }
-
-    // Main function
-    let main = read_function(r)?;
-
+#[allow(clippy::type_complexity)]
+fn read_descriptors<R: Read>(
+    r: &mut R,
+) -> Result<(Vec<TypeDescriptor>, Vec<InterfaceDescriptor>), BytecodeError> {
     // Type descriptors
     let td_count = read_u32(r)? as usize;
     let mut type_descriptors = Vec::with_capacity(td_count);
@@ -203,7 +391,7 @@ pub fn read_chunk<R: Read>(r: &mut R) -> Result<Chunk, BytecodeError> {
             }
             vtables.push((iface_idx, func_indices));
         }
-        type_descriptors.push(super::TypeDescriptor {
+        type_descriptors.push(TypeDescriptor {
             tag_name,
             field_names,
             field_type_tags,
@@ -222,28 +410,118 @@ pub fn read_chunk<R: Read>(r: &mut R) -> Result<Chunk, BytecodeError> {
         for _ in 0..method_count {
             method_names.push(read_string(r)?);
         }
-        interface_descriptors.push(super::InterfaceDescriptor { name, method_names });
+        interface_descriptors.push(InterfaceDescriptor { name, method_names });
     }
 
-    // Debug info
-    let has_debug = read_u8(r)?;
-    let debug = if has_debug != 0 {
-        // TODO: Implement debug info deserialization
-        None
+    Ok((type_descriptors, interface_descriptors))
+}
+
+/// A version 3 function header: everything but the body, which is referenced
+/// by its (offset, len) in the code section.
+struct FunctionHeader {
+    name: String,
+    arity: usize,
+    locals_count: usize,
+    local_types: Vec<ValueType>,
+    stackmap: Option<FunctionStackMap>,
+    op_count: usize,
+    body: (usize, usize),
+}
+
+fn write_function_header<W: Write>(
+    w: &mut W,
+    func: &Function,
+    code: &mut Vec<u8>,
+) -> io::Result<()> {
+    write_string(w, &func.name)?;
+    write_u32(w, func.arity as u32)?;
+    write_u32(w, func.locals_count as u32)?;
+
+    // Local types
+    write_u32(w, func.local_types.len() as u32)?;
+    for vt in &func.local_types {
+        write_value_type(w, *vt)?;
+    }
+
+    // StackMap
+    if let Some(ref stackmap) = func.stackmap {
+        w.write_all(&[1u8])?;
+        write_stackmap(w, stackmap)?;
+    } else {
+        w.write_all(&[0u8])?;
+    }
+
+    // Body location in the code section
+    let offset = code.len();
+    for op in &func.code {
+        write_op(code, op)?;
+    }
+    write_u32(w, func.code.len() as u32)?;
+    write_u32(w, offset as u32)?;
+    write_u32(w, (code.len() - offset) as u32)?;
+
+    Ok(())
+}
+
+fn read_function_header<R: Read>(r: &mut R) -> Result<FunctionHeader, BytecodeError> {
+    let name = read_string(r)?;
+    let arity = read_u32(r)? as usize;
+    let locals_count = read_u32(r)? as usize;
+
+    // Local types
+    let local_types_len = read_u32(r)? as usize;
+    let mut local_types = Vec::with_capacity(local_types_len);
+    for _ in 0..local_types_len {
+        local_types.push(read_value_type(r)?);
+    }
+
+    // StackMap
+    let has_stackmap = read_u8(r)?;
+    let stackmap = if has_stackmap != 0 {
+        Some(read_stackmap(r)?)
     } else {
         None
     };
 
-    Ok(Chunk {
-        functions,
-        main,
-        strings,
-        type_descriptors,
-        interface_descriptors,
-        debug,
+    let op_count = read_u32(r)? as usize;
+    let offset = read_u32(r)? as usize;
+    let len = read_u32(r)? as usize;
+
+    Ok(FunctionHeader {
+        name,
+        arity,
+        locals_count,
+        local_types,
+        stackmap,
+        op_count,
+        body: (offset, len),
     })
 }
 
+/// Write a Chunk in the version 2 inline layout (kept to test the reader).
+#[cfg(test)]
+fn write_chunk_v2<W: Write>(w: &mut W, chunk: &Chunk) -> io::Result<()> {
+    w.write_all(MAGIC)?;
+    w.write_all(&VERSION_INLINE.to_le_bytes())?;
+
+    write_u32(w, chunk.strings.len() as u32)?;
+    for s in chunk.strings.iter() {
+        write_string(w, s)?;
+    }
+
+    write_u32(w, chunk.functions.len() as u32)?;
+    for func in &chunk.functions {
+        write_function(w, func)?;
+    }
+    write_function(w, &chunk.main)?;
+
+    write_descriptors(w, chunk)?;
+    w.write_all(&[0u8])?;
+    Ok(())
+}
+
+/// Write a function in the version 2 inline layout.
+#[cfg(test)]
 fn write_function<W: Write>(w: &mut W, func: &Function) -> io::Result<()> {
     write_string(w, &func.name)?;
     write_u32(w, func.arity as u32)?;
@@ -303,7 +581,7 @@ fn read_function<R: Read>(r: &mut R) -> Result<Function, BytecodeError> {
         name,
         arity,
         locals_count,
-        code,
+        code: code.into(),
         stackmap,
         local_types,
     })
@@ -509,6 +787,10 @@ const OP_GLOBAL_GET: u8 = 119;
 // 120 is unused (was OP_IFACE_DESC_LOAD)
 const OP_CALL_DYNAMIC: u8 = 121;
 const OP_VTABLE_LOOKUP: u8 = 122;
+const OP_CHANNEL_SEND_MANY: u8 = 123;
+const OP_CHANNEL_RECV_MANY: u8 = 124;
+const OP_HEAP_BULK: u8 = 125;
+const OP_CHANNEL_CREATE_BOUNDED: u8 = 126;
 
 fn write_op<W: Write>(w: &mut W, op: &Op) -> io::Result<()> {
     match op {
@@ -693,6 +975,7 @@ fn write_op<W: Write>(w: &mut W, op: &Op) -> io::Result<()> {
         Op::HeapLoad2(_) => w.write_all(&[OP_HEAP_LOAD2])?,
         Op::HeapStore2(_) => w.write_all(&[OP_HEAP_STORE2])?,
         Op::HeapOffsetRef => w.write_all(&[OP_HEAP_OFFSET_REF])?,
+        Op::HeapBulk(op) => w.write_all(&[OP_HEAP_BULK, *op as u8])?,
         // System / Builtins
         Op::Hostcall(num, argc) => {
             w.write_all(&[OP_HOSTCALL])?;
@@ -724,8 +1007,11 @@ fn write_op<W: Write>(w: &mut W, op: &Op) -> io::Result<()> {
             write_u32(w, *func_idx as u32)?;
         }
         Op::ChannelCreate => w.write_all(&[OP_CHANNEL_CREATE])?,
+        Op::ChannelCreateBounded => w.write_all(&[OP_CHANNEL_CREATE_BOUNDED])?,
         Op::ChannelSend => w.write_all(&[OP_CHANNEL_SEND])?,
         Op::ChannelRecv => w.write_all(&[OP_CHANNEL_RECV])?,
+        Op::ChannelSendMany => w.write_all(&[OP_CHANNEL_SEND_MANY])?,
+        Op::ChannelRecvMany => w.write_all(&[OP_CHANNEL_RECV_MANY])?,
         Op::ThreadJoin => w.write_all(&[OP_THREAD_JOIN])?,
 
         // Closures
@@ -897,6 +1183,10 @@ fn read_op<R: Read>(r: &mut R) -> Result<Op, BytecodeError> {
         OP_HEAP_LOAD2 => Op::HeapLoad2(ElemKind::Tagged),
         OP_HEAP_STORE2 => Op::HeapStore2(ElemKind::Tagged),
         OP_HEAP_OFFSET_REF => Op::HeapOffsetRef,
+        OP_HEAP_BULK => {
+            let raw = read_u8(r)?;
+            Op::HeapBulk(BulkOp::from_raw(raw).ok_or(BytecodeError::InvalidOpcode(raw))?)
+        }
         // System / Builtins
         OP_HOSTCALL => Op::Hostcall(read_u32(r)? as usize, read_u32(r)? as usize),
         OP_GC_HINT => Op::GcHint(read_u32(r)? as usize),
@@ -915,8 +1205,11 @@ fn read_op<R: Read>(r: &mut R) -> Result<Op, BytecodeError> {
         // Threading
         OP_THREAD_SPAWN => Op::ThreadSpawn(read_u32(r)? as usize),
         OP_CHANNEL_CREATE => Op::ChannelCreate,
+        OP_CHANNEL_CREATE_BOUNDED => Op::ChannelCreateBounded,
         OP_CHANNEL_SEND => Op::ChannelSend,
         OP_CHANNEL_RECV => Op::ChannelRecv,
+        OP_CHANNEL_SEND_MANY => Op::ChannelSendMany,
+        OP_CHANNEL_RECV_MANY => Op::ChannelRecvMany,
         OP_THREAD_JOIN => Op::ThreadJoin,
 
         // Closures
@@ -1093,11 +1386,12 @@ mod tests {
                     Op::RefNull,
                     Op::I64Add,
                     Op::Ret,
-                ],
+                ]
+                .into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec!["hello".to_string(), "world".to_string()],
+            strings: vec!["hello".to_string(), "world".to_string()].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -1120,7 +1414,7 @@ mod tests {
                 name: "add".to_string(),
                 arity: 2,
                 locals_count: 2,
-                code: vec![Op::LocalGet(0), Op::LocalGet(1), Op::I64Add, Op::Ret],
+                code: vec![Op::LocalGet(0), Op::LocalGet(1), Op::I64Add, Op::Ret].into(),
                 stackmap: None,
                 local_types: vec![ValueType::I64, ValueType::I64],
             }],
@@ -1134,11 +1428,12 @@ mod tests {
                     Op::Call(0, 2),
                     Op::TypeOf,
                     Op::Ret,
-                ],
+                ]
+                .into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec![],
+            strings: vec![].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -1171,7 +1466,7 @@ mod tests {
                 name: "main".to_string(),
                 arity: 0,
                 locals_count: 4,
-                code: vec![Op::HeapAlloc(2), Op::Ret],
+                code: vec![Op::HeapAlloc(2), Op::Ret].into(),
                 stackmap: Some(stackmap),
                 local_types: vec![
                     ValueType::I64,
@@ -1180,7 +1475,7 @@ mod tests {
                     ValueType::I32,
                 ],
             },
-            strings: vec![],
+            strings: vec![].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -1209,6 +1504,111 @@ mod tests {
         );
     }
 
+    fn sample_chunk() -> Chunk {
+        let func = |name: &str, n: i64| Function {
+            name: name.to_string(),
+            arity: 1,
+            locals_count: 1,
+            code: vec![Op::LocalGet(0), Op::I64Const(n), Op::I64Add, Op::Ret].into(),
+            stackmap: None,
+            local_types: vec![ValueType::I64],
+        };
+        Chunk {
+            functions: vec![func("f0", 0), func("f1", 1), func("f2", 2)],
+            main: Function {
+                name: "main".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: vec![Op::StringConst(1), Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec!["héllo".to_string(), "".to_string(), "world".to_string()].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        }
+    }
+
+    #[test]
+    fn test_lazy_function_bodies() {
+        let chunk = sample_chunk();
+        let restored = deserialize(&serialize(&chunk)).unwrap();
+
+        // Headers are available without decoding any body
+        assert_eq!(restored.functions[2].name, "f2");
+        assert!(restored.functions.iter().all(|f| !f.code.is_decoded()));
+        assert!(!restored.main.code.is_decoded());
+
+        assert_eq!(restored.functions[1].code, *chunk.functions[1].code);
+        assert!(restored.functions[1].code.is_decoded());
+        assert!(!restored.functions[0].code.is_decoded());
+        assert!(!restored.functions[2].code.is_decoded());
+
+        // Clones of undecoded bodies stay lazy
+        let copy = restored.functions[2].clone();
+        assert!(!copy.code.is_decoded());
+        assert_eq!(copy.code, *chunk.functions[2].code);
+    }
+
+    #[test]
+    fn test_string_pool_in_place() {
+        let chunk = sample_chunk();
+        let restored = deserialize(&serialize(&chunk)).unwrap();
+        assert_eq!(restored.strings, chunk.strings);
+        assert_eq!(restored.strings.get(0), Some("héllo"));
+        assert_eq!(restored.strings.get(1), Some(""));
+        assert_eq!(restored.strings.get(3), None);
+    }
+
+    #[test]
+    fn test_read_version_2() {
+        let chunk = sample_chunk();
+        let mut bytes = Vec::new();
+        write_chunk_v2(&mut bytes, &chunk).unwrap();
+
+        let restored = deserialize(&bytes).unwrap();
+        assert!(restored.functions[0].code.is_decoded());
+        assert_eq!(restored.functions[0].code, *chunk.functions[0].code);
+        assert_eq!(restored.strings, chunk.strings);
+    }
+
+    #[test]
+    fn test_truncated_v3_is_rejected() {
+        let bytes = serialize(&sample_chunk());
+        for len in [9, bytes.len() / 2, bytes.len() - 1] {
+            assert!(deserialize(&bytes[..len]).is_err());
+        }
+    }
+
+    #[test]
+    fn test_corrupt_body_fails_on_first_use() {
+        // Bodies come last; the final byte is the tag of main's `Ret`
+        let mut bytes = serialize(&sample_chunk());
+        *bytes.last_mut().unwrap() = 0xff;
+        let chunk = deserialize(&bytes).unwrap();
+        assert!(matches!(
+            chunk.main.code.decode(),
+            Err(BytecodeError::InvalidOpcode(0xff))
+        ));
+        assert!(chunk.main.code.is_empty());
+        assert!(chunk.functions[0].code.decode().is_ok());
+    }
+
+    #[test]
+    fn test_load_mapped_file() {
+        let chunk = sample_chunk();
+        let mut file = tempfile::NamedTempFile::new().unwrap();
+        file.write_all(&serialize(&chunk)).unwrap();
+
+        let source = BytecodeSource::map_file(file.path()).unwrap();
+        #[cfg(unix)]
+        assert!(source.is_mapped());
+        let restored = load(Arc::new(source)).unwrap();
+        assert_eq!(restored.main.code, *chunk.main.code);
+        assert_eq!(restored.strings.get(2), Some("world"));
+    }
+
     #[test]
     fn test_invalid_magic() {
         let data = b"BADM\x02\x00\x00\x00";
@@ -1339,6 +1739,8 @@ mod tests {
             Op::HeapLoad2(ElemKind::Tagged),
             Op::HeapStore2(ElemKind::Tagged),
             Op::HeapOffsetRef,
+            Op::HeapBulk(BulkOp::Copy),
+            Op::HeapBulk(BulkOp::FmaF64),
             // System / Builtins
             Op::Hostcall(7, 2),
             Op::GcHint(1024),
@@ -1355,8 +1757,11 @@ mod tests {
             // Threading
             Op::ThreadSpawn(1),
             Op::ChannelCreate,
+            Op::ChannelCreateBounded,
             Op::ChannelSend,
             Op::ChannelRecv,
+            Op::ChannelSendMany,
+            Op::ChannelRecvMany,
             Op::ThreadJoin,
         ];
 
@@ -1366,11 +1771,11 @@ mod tests {
                 name: "test".to_string(),
                 arity: 0,
                 locals_count: 0,
-                code: ops.clone(),
+                code: ops.clone().into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec![],
+            strings: vec![].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -1392,7 +1797,7 @@ mod tests {
                 name: "typed_fn".to_string(),
                 arity: 3,
                 locals_count: 5,
-                code: vec![Op::LocalGet(0), Op::Ret],
+                code: vec![Op::LocalGet(0), Op::Ret].into(),
                 stackmap: None,
                 local_types: vec![
                     ValueType::I32,
@@ -1406,11 +1811,11 @@ mod tests {
                 name: "main".to_string(),
                 arity: 0,
                 locals_count: 0,
-                code: vec![Op::Ret],
+                code: vec![Op::Ret].into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec![],
+            strings: vec![].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -1443,11 +1848,11 @@ mod tests {
                 name: "f32_test".to_string(),
                 arity: 0,
                 locals_count: 0,
-                code: ops.clone(),
+                code: ops.clone().into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec![],
+            strings: vec![].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -1479,11 +1884,11 @@ mod tests {
                 name: "i32_test".to_string(),
                 arity: 0,
                 locals_count: 0,
-                code: ops.clone(),
+                code: ops.clone().into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec![],
+            strings: vec![].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
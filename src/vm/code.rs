@@ -0,0 +1,412 @@
+//! Storage for function bodies and the string pool of a chunk.
+//!
+//! Chunks built by the compiler own their ops and strings. Chunks loaded from
+//! a v3 bytecode file instead keep a reference to the file bytes (usually a
+//! read-only memory mapping) and decode each function body the first time it
+//! is accessed, so startup cost scales with the code that actually runs.
+
+use super::Op;
+use super::bytecode::{self, BytecodeError};
+use std::fs::File;
+use std::ops::{Deref, DerefMut, Index};
+use std::path::Path;
+use std::sync::{Arc, OnceLock};
+
+// ============================================================
+// Bytecode source
+// ============================================================
+
+/// Bytes of a loaded bytecode file, either memory-mapped or owned.
+pub struct BytecodeSource {
+    data: SourceData,
+}
+
+enum SourceData {
+    Owned(Vec<u8>),
+    #[cfg(unix)]
+    Mapped {
+        ptr: std::ptr::NonNull<u8>,
+        len: usize,
+    },
+}
+
+// SAFETY: the mapping is private and read-only; it is never written through.
+unsafe impl Send for BytecodeSource {}
+unsafe impl Sync for BytecodeSource {}
+
+impl BytecodeSource {
+    /// Wrap bytes that are already in memory.
+    pub fn from_vec(data: Vec<u8>) -> Self {
+        Self {
+            data: SourceData::Owned(data),
+        }
+    }
+
+    /// Map a file read-only into memory.
+    ///
+    /// The file must not be modified while the mapping is alive. Falls back to
+    /// reading the file on platforms without mmap.
+    pub fn map_file(path: &Path) -> std::io::Result<Self> {
+        let file = File::open(path)?;
+        let len = file.metadata()?.len() as usize;
+        if len == 0 {
+            return Ok(Self::from_vec(Vec::new()));
+        }
+
+        #[cfg(unix)]
+        {
+            use std::os::unix::io::AsRawFd;
+
+            let ptr = unsafe {
+                libc::mmap(
+                    std::ptr::null_mut(),
+                    len,
+                    libc::PROT_READ,
+                    libc::MAP_PRIVATE,
+                    file.as_raw_fd(),
+                    0,
+                )
+            };
+            if ptr == libc::MAP_FAILED {
+                return Err(std::io::Error::last_os_error());
+            }
+            let ptr = std::ptr::NonNull::new(ptr as *mut u8)
+                .ok_or_else(|| std::io::Error::other("mmap returned null"))?;
+            Ok(Self {
+                data: SourceData::Mapped { ptr, len },
+            })
+        }
+        #[cfg(not(unix))]
+        {
+            use std::io::Read;
+            let mut data = Vec::with_capacity(len);
+            let mut file = file;
+            file.read_to_end(&mut data)?;
+            Ok(Self::from_vec(data))
+        }
+    }
+
+    /// Whether the bytes are a memory mapping rather than an owned buffer.
+    pub fn is_mapped(&self) -> bool {
+        !matches!(self.data, SourceData::Owned(_))
+    }
+
+    pub fn as_bytes(&self) -> &[u8] {
+        match &self.data {
+            SourceData::Owned(data) => data,
+            #[cfg(unix)]
+            SourceData::Mapped { ptr, len } => unsafe {
+                std::slice::from_raw_parts(ptr.as_ptr(), *len)
+            },
+        }
+    }
+}
+
+impl Drop for BytecodeSource {
+    fn drop(&mut self) {
+        #[cfg(unix)]
+        if let SourceData::Mapped { ptr, len } = self.data {
+            unsafe {
+                libc::munmap(ptr.as_ptr() as *mut libc::c_void, len);
+            }
+        }
+    }
+}
+
+impl std::fmt::Debug for BytecodeSource {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("BytecodeSource")
+            .field("len", &self.as_bytes().len())
+            .field("mapped", &self.is_mapped())
+            .finish()
+    }
+}
+
+// ============================================================
+// Function bodies
+// ============================================================
+
+/// The ops of a function.
+///
+/// Dereferences to `Vec<Op>`. For lazily loaded chunks the body is decoded
+/// from the bytecode source on first access and cached. A body that fails
+/// to decode dereferences to no ops; code that runs a function calls
+/// `decode` first to report the error.
+pub struct Code {
+    ops: OnceLock<Result<Vec<Op>, BytecodeError>>,
+    body: Option<LazyBody>,
+}
+
+/// Location of an undecoded function body in a bytecode source.
+#[derive(Clone)]
+struct LazyBody {
+    source: Arc<BytecodeSource>,
+    /// Byte range of the encoded ops
+    start: usize,
+    end: usize,
+    /// Number of ops
+    count: usize,
+}
+
+impl Code {
+    /// A body that is decoded from `source[start..end]` on first access.
+    ///
+    /// The range must have been bounds-checked against the source.
+    pub(crate) fn lazy(
+        source: Arc<BytecodeSource>,
+        start: usize,
+        end: usize,
+        count: usize,
+    ) -> Self {
+        debug_assert!(start <= end && end <= source.as_bytes().len());
+        Self {
+            ops: OnceLock::new(),
+            body: Some(LazyBody {
+                source,
+                start,
+                end,
+                count,
+            }),
+        }
+    }
+
+    /// Whether the ops are available without decoding.
+    pub fn is_decoded(&self) -> bool {
+        matches!(self.ops.get(), Some(Ok(_)))
+    }
+
+    /// The ops, decoded on first use. Fails if the encoded body is corrupt.
+    pub fn decode(&self) -> Result<&Vec<Op>, &BytecodeError> {
+        self.ops
+            .get_or_init(|| {
+                let body = self
+                    .body
+                    .as_ref()
+                    .expect("undecoded code must have a lazy body");
+                let bytes = &body.source.as_bytes()[body.start..body.end];
+                bytecode::decode_ops(bytes, body.count)
+            })
+            .as_ref()
+    }
+
+    fn ops(&self) -> &Vec<Op> {
+        static NO_OPS: Vec<Op> = Vec::new();
+        self.decode().unwrap_or(&NO_OPS)
+    }
+}
+
+impl From<Vec<Op>> for Code {
+    fn from(ops: Vec<Op>) -> Self {
+        Self {
+            ops: OnceLock::from(Ok(ops)),
+            body: None,
+        }
+    }
+}
+
+impl Default for Code {
+    fn default() -> Self {
+        Vec::new().into()
+    }
+}
+
+impl Deref for Code {
+    type Target = Vec<Op>;
+
+    fn deref(&self) -> &Vec<Op> {
+        self.ops()
+    }
+}
+
+impl DerefMut for Code {
+    fn deref_mut(&mut self) -> &mut Vec<Op> {
+        let _ = self.decode();
+        // Mutated code no longer matches the source
+        self.body = None;
+        let ops = self.ops.get_mut().expect("ops were just decoded");
+        if ops.is_err() {
+            *ops = Ok(Vec::new());
+        }
+        ops.as_mut().expect("a failed decode was replaced")
+    }
+}
+
+impl Clone for Code {
+    fn clone(&self) -> Self {
+        match self.ops.get() {
+            Some(Ok(ops)) => ops.clone().into(),
+            _ => Self {
+                ops: OnceLock::new(),
+                body: self.body.clone(),
+            },
+        }
+    }
+}
+
+impl std::fmt::Debug for Code {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        self.ops().fmt(f)
+    }
+}
+
+impl PartialEq<Vec<Op>> for Code {
+    fn eq(&self, other: &Vec<Op>) -> bool {
+        self.ops() == other
+    }
+}
+
+impl<'a> IntoIterator for &'a Code {
+    type Item = &'a Op;
+    type IntoIter = std::slice::Iter<'a, Op>;
+
+    fn into_iter(self) -> Self::IntoIter {
+        self.ops().iter()
+    }
+}
+
+impl<'a> IntoIterator for &'a mut Code {
+    type Item = &'a mut Op;
+    type IntoIter = std::slice::IterMut<'a, Op>;
+
+    fn into_iter(self) -> Self::IntoIter {
+        self.deref_mut().iter_mut()
+    }
+}
+
+// ============================================================
+// String pool
+// ============================================================
+
+/// The string constants of a chunk.
+///
+/// Lazily loaded chunks read strings in place from the bytecode source;
+/// their UTF-8 is validated once at load time.
+#[derive(Clone, Default)]
+pub struct StringPool {
+    owned: Vec<String>,
+    mapped: Option<MappedStrings>,
+}
+
+#[derive(Clone)]
+struct MappedStrings {
+    source: Arc<BytecodeSource>,
+    /// Absolute (offset, len) of each string in the source
+    entries: Vec<(usize, usize)>,
+}
+
+impl StringPool {
+    /// A pool of strings stored in `source`, validated as UTF-8.
+    pub(crate) fn mapped(
+        source: Arc<BytecodeSource>,
+        entries: Vec<(usize, usize)>,
+    ) -> Result<Self, bytecode::BytecodeError> {
+        let bytes = source.as_bytes();
+        for &(offset, len) in &entries {
+            let s = bytes
+                .get(offset..offset + len)
+                .ok_or(bytecode::BytecodeError::UnexpectedEof)?;
+            std::str::from_utf8(s).map_err(|_| bytecode::BytecodeError::InvalidUtf8)?;
+        }
+        Ok(Self {
+            owned: Vec::new(),
+            mapped: Some(MappedStrings { source, entries }),
+        })
+    }
+
+    pub fn len(&self) -> usize {
+        match &self.mapped {
+            Some(m) => m.entries.len(),
+            None => self.owned.len(),
+        }
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    pub fn get(&self, index: usize) -> Option<&str> {
+        match &self.mapped {
+            Some(m) => {
+                let &(offset, len) = m.entries.get(index)?;
+                let bytes = &m.source.as_bytes()[offset..offset + len];
+                // SAFETY: validated in `StringPool::mapped`
+                Some(unsafe { std::str::from_utf8_unchecked(bytes) })
+            }
+            None => self.owned.get(index).map(String::as_str),
+        }
+    }
+
+    pub fn iter(&self) -> impl Iterator<Item = &str> {
+        (0..self.len()).map(|i| self.get(i).expect("index is in range"))
+    }
+
+    /// Append a string, converting a mapped pool to an owned one first.
+    pub fn push(&mut self, s: String) {
+        if self.mapped.is_some() {
+            self.owned = self.iter().map(str::to_string).collect();
+            self.mapped = None;
+        }
+        self.owned.push(s);
+    }
+}
+
+impl From<Vec<String>> for StringPool {
+    fn from(owned: Vec<String>) -> Self {
+        Self {
+            owned,
+            mapped: None,
+        }
+    }
+}
+
+impl Index<usize> for StringPool {
+    type Output = str;
+
+    fn index(&self, index: usize) -> &str {
+        self.get(index).expect("string index out of bounds")
+    }
+}
+
+impl PartialEq for StringPool {
+    fn eq(&self, other: &Self) -> bool {
+        self.len() == other.len() && self.iter().eq(other.iter())
+    }
+}
+
+impl std::fmt::Debug for StringPool {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_list().entries(self.iter()).finish()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_code_owned() {
+        let mut code: Code = vec![Op::I64Const(1), Op::Ret].into();
+        assert!(code.is_decoded());
+        assert_eq!(code.len(), 2);
+        code.push(Op::Ret);
+        assert_eq!(code, vec![Op::I64Const(1), Op::Ret, Op::Ret]);
+    }
+
+    #[test]
+    fn test_string_pool_push_after_mapped() {
+        let data = b"abcdef".to_vec();
+        let source = Arc::new(BytecodeSource::from_vec(data));
+        let mut pool = StringPool::mapped(source, vec![(0, 3), (3, 3)]).unwrap();
+        assert_eq!(pool.get(1), Some("def"));
+
+        pool.push("ghi".to_string());
+        assert_eq!(pool.iter().collect::<Vec<_>>(), ["abc", "def", "ghi"]);
+    }
+
+    #[test]
+    fn test_string_pool_rejects_invalid_utf8() {
+        let source = Arc::new(BytecodeSource::from_vec(vec![0xff, 0xfe]));
+        assert!(StringPool::mapped(source.clone(), vec![(0, 2)]).is_err());
+        assert!(StringPool::mapped(source, vec![(1, 5)]).is_err());
+    }
+}
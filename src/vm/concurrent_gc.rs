@@ -3,8 +3,11 @@
 //! This module implements a concurrent mark-sweep GC with write barriers.
 //! The GC uses a snapshot-at-the-beginning (SATB) write barrier to ensure
 //! correctness during concurrent marking.
+//!
+//! The VM drives it incrementally: marking runs in bounded `mark_step`
+//! batches at interpreter safepoints, interleaved with the mutator.
 
-// Concurrent GC is not yet integrated, allow dead code
+// Not every helper is used by the VM
 #![allow(dead_code)]
 
 use std::collections::VecDeque;
@@ -29,6 +32,54 @@ pub enum GcPhase {
     ConcurrentSweep,
 }
 
+/// Number of buckets in a `PauseHistogram`.
+pub const PAUSE_BUCKETS: usize = 24;
+
+/// Histogram of GC pause times with power-of-two microsecond buckets.
+///
+/// Bucket 0 counts pauses under 1us; bucket `i > 0` counts pauses in
+/// `[2^(i-1), 2^i)` us. The last bucket also holds everything longer.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct PauseHistogram {
+    pub buckets: [u64; PAUSE_BUCKETS],
+}
+
+impl PauseHistogram {
+    /// Record one pause.
+    pub fn record(&mut self, pause_us: u64) {
+        let bucket = (u64::BITS - pause_us.leading_zeros()) as usize;
+        self.buckets[bucket.min(PAUSE_BUCKETS - 1)] += 1;
+    }
+
+    /// Total number of recorded pauses.
+    pub fn count(&self) -> u64 {
+        self.buckets.iter().sum()
+    }
+
+    /// Exclusive upper bound (us) of the bucket `i`.
+    pub fn bucket_upper_us(i: usize) -> u64 {
+        1 << i
+    }
+
+    /// Upper bound (us) of the pause time below which `fraction` (0.0..=1.0)
+    /// of the recorded pauses fall, or 0 if nothing was recorded.
+    pub fn percentile_us(&self, fraction: f64) -> u64 {
+        let total = self.count();
+        if total == 0 {
+            return 0;
+        }
+        let target = ((total as f64) * fraction).ceil().max(1.0) as u64;
+        let mut seen = 0;
+        for (i, &n) in self.buckets.iter().enumerate() {
+            seen += n;
+            if seen >= target {
+                return Self::bucket_upper_us(i);
+            }
+        }
+        Self::bucket_upper_us(PAUSE_BUCKETS - 1)
+    }
+}
+
 /// Statistics for GC operations.
 #[derive(Debug, Clone, Default)]
 pub struct GcStats {
@@ -48,6 +99,8 @@ pub struct GcStats {
     pub objects_marked: usize,
     /// Total objects swept
     pub objects_swept: usize,
+    /// Pause times of the stop-the-world phases (initial mark, remark)
+    pub pauses: PauseHistogram,
 }
 
 /// Concurrent GC state.
@@ -142,11 +195,10 @@ impl ConcurrentGc {
             gray_list.extend(root_refs.iter().copied());
         }
 
-        self.stats.initial_mark_us += start.elapsed().as_micros() as u64;
-        self.stats.max_pause_us = self
-            .stats
-            .max_pause_us
-            .max(start.elapsed().as_micros() as u64);
+        let pause_us = start.elapsed().as_micros() as u64;
+        self.stats.initial_mark_us += pause_us;
+        self.stats.max_pause_us = self.stats.max_pause_us.max(pause_us);
+        self.stats.pauses.record(pause_us);
 
         self.phase = GcPhase::ConcurrentMark;
         root_refs
@@ -227,11 +279,10 @@ impl ConcurrentGc {
         // Process any remaining SATB buffer entries
         self.process_satb_buffer(mark_fn);
 
-        self.stats.remark_us += start.elapsed().as_micros() as u64;
-        self.stats.max_pause_us = self
-            .stats
-            .max_pause_us
-            .max(start.elapsed().as_micros() as u64);
+        let pause_us = start.elapsed().as_micros() as u64;
+        self.stats.remark_us += pause_us;
+        self.stats.max_pause_us = self.stats.max_pause_us.max(pause_us);
+        self.stats.pauses.record(pause_us);
 
         self.marking.store(false, Ordering::Release);
         self.phase = GcPhase::ConcurrentSweep;
@@ -244,6 +295,19 @@ impl ConcurrentGc {
         self.phase = GcPhase::Idle;
     }
 
+    /// Copy the marking state (phase, gray list, SATB buffer) for a VM
+    /// snapshot taken mid-cycle. Statistics start over.
+    pub fn snapshot(&self) -> Self {
+        Self {
+            phase: self.phase,
+            marking: AtomicBool::new(self.is_marking()),
+            gray_list: Mutex::new(self.gray_list.lock().unwrap().clone()),
+            satb_buffer: Mutex::new(self.satb_buffer.lock().unwrap().clone()),
+            stats: GcStats::default(),
+            enabled: self.enabled,
+        }
+    }
+
     /// Reset statistics.
     pub fn reset_stats(&mut self) {
         self.stats = GcStats::default();
@@ -371,5 +435,27 @@ mod tests {
         assert_eq!(gc.phase(), GcPhase::Idle);
         assert_eq!(gc.stats().cycles, 1);
         assert_eq!(gc.stats().objects_swept, 5);
+        assert_eq!(gc.stats().pauses.count(), 2);
+    }
+
+    #[test]
+    fn test_pause_histogram() {
+        let mut hist = PauseHistogram::default();
+        assert_eq!(hist.percentile_us(0.99), 0);
+
+        hist.record(0);
+        hist.record(1);
+        hist.record(3);
+        hist.record(1000);
+        hist.record(u64::MAX);
+        assert_eq!(hist.buckets[0], 1);
+        assert_eq!(hist.buckets[1], 1);
+        assert_eq!(hist.buckets[2], 1);
+        assert_eq!(hist.buckets[10], 1);
+        assert_eq!(hist.buckets[PAUSE_BUCKETS - 1], 1);
+        assert_eq!(hist.count(), 5);
+
+        assert_eq!(hist.percentile_us(0.5), 4);
+        assert_eq!(hist.percentile_us(0.8), 1024);
     }
 }
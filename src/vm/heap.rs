@@ -1,6 +1,7 @@
 use std::fmt;
 
 use super::Value;
+use super::bulk::{self, BulkOp};
 
 // =============================================================================
 // ElemKind - Element storage kind for heap objects
@@ -87,22 +88,27 @@ fn try_read_u64(memory: &[u8], byte_offset: usize) -> Option<u64> {
 // Header Layout (64 bits)
 // =============================================================================
 //
-// +--------+------+------------------+-----------+--------------------+
-// | marked | free | count (32)       | elem_kind | reserved (27)      |
-// | bit 63 | bit 62| bits 30-61      | bits 27-29| bits 0-26          |
-// +--------+------+------------------+-----------+--------------------+
+// +--------+------+------------------+-----------+-------+------------+---------------+
+// | marked | free | count (32)       | elem_kind | young | remembered | reserved (25) |
+// | bit 63 | bit 62| bits 30-61      | bits 27-29| bit 26| bit 25     | bits 0-24     |
+// +--------+------+------------------+-----------+-------+------------+---------------+
 //
 // - Bit 63: marked flag for GC
 // - Bit 62: free flag (1 = free block in free list, 0 = allocated)
 // - Bits 30-61: element/slot count (max 2^32 - 1)
 // - Bits 27-29: ElemKind (0=Tagged, 3=I64, 4=Ref)
-// - Bits 0-26: reserved for future use
+// - Bit 26: young flag (allocated in the nursery since the last collection)
+// - Bit 25: remembered flag (old object recorded in the remembered set)
+// - Bits 0-24: reserved for future use
 //
 // Free block layout:
 // +----------------+----------------+
 // | Header         | Next Free Ptr  |
 // | (free=1, size) | (offset or 0)  |
 // +----------------+----------------+
+//
+// An 8-byte free block has no room for the next pointer; it is stored as a
+// word index in header bits 0-29 instead (see `FREE_NEXT_WORD_MASK`).
 
 const HEADER_MARKED_BIT: u64 = 1 << 63;
 const HEADER_FREE_BIT: u64 = 1 << 62;
@@ -110,6 +116,10 @@ const HEADER_SLOT_COUNT_SHIFT: u32 = 30;
 const HEADER_SLOT_COUNT_MASK: u64 = 0xFFFF_FFFF << HEADER_SLOT_COUNT_SHIFT;
 const HEADER_ELEM_KIND_SHIFT: u32 = 27;
 const HEADER_ELEM_KIND_MASK: u64 = 0b111 << HEADER_ELEM_KIND_SHIFT;
+const HEADER_YOUNG_BIT: u64 = 1 << 26;
+const HEADER_REMEMBERED_BIT: u64 = 1 << 25;
+/// Next pointer (in words) of an 8-byte free block
+const FREE_NEXT_WORD_MASK: u64 = (1 << 30) - 1;
 
 /// Encode a header word from marked flag, slot count, and element kind.
 fn encode_header(marked: bool, slot_count: u32) -> u64 {
@@ -210,6 +220,15 @@ fn object_size_bytes_for_kind(count: u32, kind: ElemKind) -> usize {
     }
 }
 
+/// Bytes per element of an object with the given elem kind.
+fn elem_size(kind: ElemKind) -> usize {
+    match kind {
+        ElemKind::Tagged => 16,
+        ElemKind::U8 => 1,
+        _ => 8,
+    }
+}
+
 /// Calculate the object size in bytes from a decoded header.
 fn object_size_bytes_from_header(header: u64) -> usize {
     let count = decode_slot_count(header);
@@ -217,6 +236,193 @@ fn object_size_bytes_from_header(header: u64) -> usize {
     object_size_bytes_for_kind(count, kind)
 }
 
+// =============================================================================
+// Free Lists - Size-segregated free blocks
+// =============================================================================
+
+/// Free blocks up to this size get a list per exact size
+const EXACT_CLASS_LIMIT: usize = 512;
+/// Number of exact-size classes (8, 16, ..., 512 bytes)
+const EXACT_CLASSES: usize = EXACT_CLASS_LIMIT / 8;
+/// Exact classes plus one class per power of two `[2^k, 2^(k+1))`, k = 9..=63
+const FREE_CLASSES: usize = EXACT_CLASSES + 55;
+
+/// Size class of a free block of `size_bytes`.
+fn size_class(size_bytes: usize) -> usize {
+    if size_bytes <= EXACT_CLASS_LIMIT {
+        size_bytes / 8 - 1
+    } else {
+        EXACT_CLASSES + (size_bytes.ilog2() - 9) as usize
+    }
+}
+
+/// Smallest size class whose blocks all hold `needed_bytes`.
+fn fit_class(needed_bytes: usize) -> usize {
+    if needed_bytes <= EXACT_CLASS_LIMIT {
+        size_class(needed_bytes)
+    } else {
+        EXACT_CLASSES + ((needed_bytes - 1).ilog2() + 1 - 9) as usize
+    }
+}
+
+/// Free blocks segregated by size class.
+///
+/// Every operation is O(1): `nonempty` has a bit per non-empty class, so the
+/// smallest class that fits a request is found with one shift and
+/// `trailing_zeros`. Blocks are threaded through linear memory; methods take
+/// the memory slice and the heap offset `base` it starts at, so a parallel
+/// sweep can build lists for its own range.
+#[derive(Clone)]
+struct FreeLists {
+    heads: [usize; FREE_CLASSES],
+    tails: [usize; FREE_CLASSES],
+    nonempty: u128,
+}
+
+impl FreeLists {
+    fn new() -> Self {
+        Self {
+            heads: [0; FREE_CLASSES],
+            tails: [0; FREE_CLASSES],
+            nonempty: 0,
+        }
+    }
+
+    fn next_of(memory: &[u8], base: usize, offset: usize, size_bytes: usize) -> usize {
+        if size_bytes == 8 {
+            ((read_u64(memory, offset - base) & FREE_NEXT_WORD_MASK) * 8) as usize
+        } else {
+            read_u64(memory, offset - base + 8) as usize
+        }
+    }
+
+    fn set_next(memory: &mut [u8], base: usize, offset: usize, size_bytes: usize, next: usize) {
+        if size_bytes == 8 {
+            let header = encode_free_header(8) | (next / 8) as u64;
+            write_u64(memory, offset - base, header);
+        } else {
+            write_u64(memory, offset - base, encode_free_header(size_bytes));
+            write_u64(memory, offset - base + 8, next as u64);
+        }
+    }
+
+    /// Turn `[offset, offset + size_bytes)` into a free block.
+    fn insert(&mut self, memory: &mut [u8], base: usize, offset: usize, size_bytes: usize) {
+        // 8-byte blocks link by word index, which only reaches the first 8 GB;
+        // past that they become empty objects, reclaimed when coalesced
+        if size_bytes == 8 && (offset / 8) as u64 > FREE_NEXT_WORD_MASK {
+            write_u64(memory, offset - base, encode_header(false, 0));
+            return;
+        }
+        let class = size_class(size_bytes);
+        Self::set_next(memory, base, offset, size_bytes, self.heads[class]);
+        if self.heads[class] == 0 {
+            self.tails[class] = offset;
+        }
+        self.heads[class] = offset;
+        self.nonempty |= 1 << class;
+    }
+
+    /// Remove and return `(offset, size)` of a block of at least
+    /// `needed_bytes`.
+    fn take(&mut self, memory: &[u8], base: usize, needed_bytes: usize) -> Option<(usize, usize)> {
+        // A block in the request's own power-of-two class may fit; try its
+        // head before moving up to a class that always fits
+        let own = size_class(needed_bytes);
+        if needed_bytes > EXACT_CLASS_LIMIT
+            && self.heads[own] != 0
+            && decode_free_size_bytes(read_u64(memory, self.heads[own] - base)) >= needed_bytes
+        {
+            return Some(self.pop(memory, base, own));
+        }
+
+        let first = fit_class(needed_bytes);
+        if first >= FREE_CLASSES {
+            return None;
+        }
+        let fits = self.nonempty >> first;
+        if fits == 0 {
+            return None;
+        }
+        Some(self.pop(memory, base, first + fits.trailing_zeros() as usize))
+    }
+
+    /// Remove the head of a non-empty class.
+    fn pop(&mut self, memory: &[u8], base: usize, class: usize) -> (usize, usize) {
+        let offset = self.heads[class];
+        let size_bytes = decode_free_size_bytes(read_u64(memory, offset - base));
+        let next = Self::next_of(memory, base, offset, size_bytes);
+        self.heads[class] = next;
+        if next == 0 {
+            self.tails[class] = 0;
+            self.nonempty &= !(1 << class);
+        }
+        (offset, size_bytes)
+    }
+
+    /// Prepend every list of `other`, whose blocks live in `memory`.
+    fn append(&mut self, memory: &mut [u8], other: &FreeLists) {
+        let mut classes = other.nonempty;
+        while classes != 0 {
+            let class = classes.trailing_zeros() as usize;
+            classes &= classes - 1;
+            if self.heads[class] == 0 {
+                self.tails[class] = other.tails[class];
+            } else {
+                let tail = other.tails[class];
+                let size_bytes = decode_free_size_bytes(read_u64(memory, tail));
+                Self::set_next(memory, 0, tail, size_bytes, self.heads[class]);
+            }
+            self.heads[class] = other.heads[class];
+            self.nonempty |= 1 << class;
+        }
+    }
+}
+
+/// Sweep the objects from `sweep.cursor` up to `end`, in a slice of linear
+/// memory that starts at heap offset `base`.
+///
+/// Live objects are unmarked. Runs of dead objects and free blocks are
+/// coalesced and added to `lists` as they end; a run still open at `end` is
+/// left in `sweep.run` for the caller.
+fn sweep_range(
+    memory: &mut [u8],
+    base: usize,
+    end: usize,
+    lists: &mut FreeLists,
+    sweep: &mut SweepState,
+) {
+    while sweep.cursor < end {
+        let offset = sweep.cursor;
+        let header = read_u64(memory, offset - base);
+        let size_bytes = if decode_free(header) {
+            decode_free_size_bytes(header)
+        } else {
+            object_size_bytes_from_header(header)
+        };
+
+        if decode_free(header) || !decode_marked(header) {
+            if !decode_free(header) {
+                sweep.freed += 1;
+            }
+            // The open run always ends at the cursor
+            sweep.run = match sweep.run {
+                Some((start, len)) => Some((start, len + size_bytes)),
+                None => Some((offset, size_bytes)),
+            };
+        } else {
+            // Live object - reset mark for next GC cycle
+            write_u64(memory, offset - base, header & !HEADER_MARKED_BIT);
+            sweep.live_bytes += size_bytes;
+            if let Some((start, len)) = sweep.run.take() {
+                lists.insert(memory, base, start, len);
+            }
+        }
+
+        sweep.cursor += size_bytes;
+    }
+}
+
 // =============================================================================
 // HeapObject - View into linear memory
 // =============================================================================
@@ -396,21 +602,137 @@ pub struct Heap {
     memory: Vec<u8>,
     /// Next allocation byte offset
     next_alloc: usize,
-    /// Head of free list (byte offset, or 0 if empty)
-    free_list_head: usize,
+    /// Free blocks by size class
+    free_lists: FreeLists,
     /// Bytes allocated (for GC threshold)
     bytes_allocated: usize,
     /// GC threshold in bytes
     gc_threshold: usize,
     /// Hard limit on heap size (None = unlimited)
     heap_limit: Option<usize>,
+    /// Size at which a collection starts early (None = 3/4 of `heap_limit`)
+    soft_limit: Option<usize>,
     /// Whether GC is enabled
     gc_enabled: bool,
+    /// Whether an incremental mark is in progress (new objects are allocated marked)
+    marking: bool,
+    /// State of an incremental sweep in progress
+    sweep: Option<SweepState>,
+    /// Live objects found by the last `mark`, used to split a parallel sweep
+    sweep_hints: Option<SweepHints>,
+    /// Young generation (None = every object is allocated old)
+    nursery: Option<Nursery>,
+    /// Allocate old even when a nursery is configured
+    pretenure: bool,
+    /// Bytes and objects allocated since the heap was created
+    allocated_bytes_total: u64,
+    allocated_objects_total: u64,
+}
+
+/// Young generation: objects allocated since the last collection.
+///
+/// The nursery is not a fixed address range. Young objects are bump
+/// allocated in buffers carved from free blocks or the top of the heap, and
+/// tracked by the young header bit and the `young` list, so a minor
+/// collection never walks old objects.
+#[derive(Clone, Default)]
+struct Nursery {
+    /// Young bytes that trigger a minor collection
+    capacity: usize,
+    /// Bump allocation buffer `[bump, bump_end)`
+    bump: usize,
+    bump_end: usize,
+    /// Offsets of young objects in allocation order
+    young: Vec<usize>,
+    /// Bytes of young objects
+    young_bytes: usize,
+    /// Old objects that may reference young ones
+    remembered: Vec<GcRef>,
+}
+
+/// Progress of an incremental sweep.
+#[derive(Clone, Copy)]
+struct SweepState {
+    /// Next byte offset to visit; objects below it have been swept
+    cursor: usize,
+    /// Bytes of live objects visited so far
+    live_bytes: usize,
+    /// Bytes allocated below the cursor since the sweep started
+    allocated_behind: usize,
+    /// Number of dead objects found
+    freed: usize,
+    /// Dead run `(start, len)` ending at the cursor, not yet a free block
+    run: Option<(usize, usize)>,
+}
+
+impl SweepState {
+    fn new(cursor: usize) -> Self {
+        Self {
+            cursor,
+            live_bytes: 0,
+            allocated_behind: 0,
+            freed: 0,
+            run: None,
+        }
+    }
+}
+
+/// The lowest marked object in each of `SWEEP_STRIPES` equal stripes of the
+/// heap.
+///
+/// A parallel sweep needs range boundaries that are object starts, and the
+/// heap has no object index; marked objects are known starts, and starting a
+/// range at a live object also means no dead run crosses a boundary.
+#[derive(Clone)]
+struct SweepHints {
+    stripe_bytes: usize,
+    starts: Vec<usize>,
+}
+
+impl SweepHints {
+    fn new(heap_bytes: usize) -> Self {
+        Self {
+            stripe_bytes: heap_bytes.div_ceil(SWEEP_STRIPES).max(1),
+            starts: vec![usize::MAX; SWEEP_STRIPES],
+        }
+    }
+
+    #[inline]
+    fn note(&mut self, offset: usize) {
+        if let Some(start) = self.starts.get_mut(offset / self.stripe_bytes) {
+            *start = (*start).min(offset);
+        }
+    }
+}
+
+/// Number of stripes `SweepHints` tracks
+const SWEEP_STRIPES: usize = 16;
+/// Most threads a parallel sweep uses
+const MAX_SWEEP_THREADS: usize = 8;
+/// Heaps smaller than this are swept on the calling thread
+const PARALLEL_SWEEP_MIN_BYTES: usize = 4 * 1024 * 1024;
+
+/// Threads available to a parallel sweep.
+fn sweep_threads() -> usize {
+    static THREADS: std::sync::OnceLock<usize> = std::sync::OnceLock::new();
+    *THREADS.get_or_init(|| {
+        std::thread::available_parallelism()
+            .map_or(1, |n| n.get())
+            .min(MAX_SWEEP_THREADS)
+    })
 }
 
 impl Heap {
     /// Initial capacity in bytes (1 MB)
     const INITIAL_CAPACITY: usize = 128 * 1024 * 8;
+    /// Default nursery capacity in bytes (256 KB)
+    pub const NURSERY_BYTES: usize = 256 * 1024;
+    /// Size of a bump buffer carved from the top of the heap
+    const NURSERY_CHUNK_BYTES: usize = 32 * 1024;
+    /// Smallest free block reused as a bump buffer
+    const NURSERY_MIN_BUFFER_BYTES: usize = 1024;
+    /// Objects at least this large are allocated old
+    const NURSERY_LARGE_OBJECT_BYTES: usize = 8 * 1024;
 
     pub fn new() -> Self {
         Self::new_with_config(None, true)
@@ -425,14 +747,52 @@ impl Heap {
         let mut memory = vec![0u8; 8]; // Reserve first 8 bytes as invalid/null
         memory.reserve(Self::INITIAL_CAPACITY - 8);
 
-        Self {
+        let mut heap = Self {
             memory,
             next_alloc: 8, // Start after reserved 8-byte null word
-            free_list_head: 0,
+            free_lists: FreeLists::new(),
             bytes_allocated: 0,
             gc_threshold: 1024 * 1024, // 1MB initial threshold
             heap_limit,
+            soft_limit: None,
             gc_enabled,
+            marking: false,
+            sweep: None,
+            sweep_hints: None,
+            nursery: None,
+            pretenure: false,
+            allocated_bytes_total: 0,
+            allocated_objects_total: 0,
+        };
+        heap.clamp_threshold();
+        heap
+    }
+
+    /// Copy the used part of linear memory together with the allocator state.
+    ///
+    /// `GcRef`s are byte offsets into linear memory, so every reference in the
+    /// copy stays valid without relocation. Memory past `next_alloc` holds no
+    /// objects or free blocks and is not copied.
+    pub fn snapshot(&self) -> Heap {
+        let mut memory = Vec::with_capacity(self.next_alloc.max(Self::INITIAL_CAPACITY));
+        memory.extend_from_slice(&self.memory[..self.next_alloc]);
+
+        Self {
+            memory,
+            next_alloc: self.next_alloc,
+            free_lists: self.free_lists.clone(),
+            bytes_allocated: self.bytes_allocated,
+            gc_threshold: self.gc_threshold,
+            heap_limit: self.heap_limit,
+            soft_limit: self.soft_limit,
+            gc_enabled: self.gc_enabled,
+            marking: self.marking,
+            sweep: self.sweep,
+            sweep_hints: self.sweep_hints.clone(),
+            nursery: self.nursery.clone(),
+            pretenure: self.pretenure,
+            allocated_bytes_total: 0,
+            allocated_objects_total: 0,
         }
     }
 
@@ -441,11 +801,54 @@ impl Heap {
     ///
     /// # Safety
     /// The returned pointer is valid as long as no heap reallocation occurs.
-    /// JIT code should only use this during a single execution without GC.
+    /// Helpers called by JIT code may grow the heap, so the code reloads
+    /// the base from its context after every helper call.
     pub fn memory_base_ptr(&self) -> *const u8 {
         self.memory.as_ptr()
     }
 
+    /// Hard limit on allocated bytes; allocations past it fail.
+    pub fn heap_limit(&self) -> Option<usize> {
+        self.heap_limit
+    }
+
+    pub fn set_heap_limit(&mut self, limit: Option<usize>) {
+        self.heap_limit = limit;
+        self.clamp_threshold();
+    }
+
+    /// Allocated bytes at which a collection starts even if the GC threshold
+    /// has not been reached. Defaults to 3/4 of the hard limit.
+    pub fn soft_limit(&self) -> Option<usize> {
+        let default = self.heap_limit.map(|limit| limit - limit / 4);
+        match (self.soft_limit, self.heap_limit) {
+            (Some(soft), Some(hard)) => Some(soft.min(hard)),
+            (Some(soft), None) => Some(soft),
+            (None, _) => default,
+        }
+    }
+
+    pub fn set_soft_limit(&mut self, limit: Option<usize>) {
+        self.soft_limit = limit;
+        self.clamp_threshold();
+    }
+
+    /// Allocated bytes that trigger the next collection.
+    pub fn gc_threshold(&self) -> usize {
+        self.gc_threshold
+    }
+
+    /// Bring the GC threshold down to the soft limit while the heap is below
+    /// it. Above it collecting more often would not free anything, so the
+    /// threshold keeps growing with the live size.
+    fn clamp_threshold(&mut self) {
+        if let Some(soft) = self.soft_limit()
+            && self.bytes_allocated < soft
+        {
+            self.gc_threshold = self.gc_threshold.min(soft);
+        }
+    }
+
     /// Check if allocation would exceed heap limit.
     fn check_heap_limit(&self, additional_bytes: usize) -> Result<(), String> {
         if let Some(limit) = self.heap_limit {
@@ -464,16 +867,58 @@ impl Heap {
     /// String is stored as a struct [ptr, len] where ptr points to a data array
     /// containing UTF-8 bytes (ElemKind::U8).
     pub fn alloc_string(&mut self, value: String) -> Result<GcRef, String> {
-        let bytes = value.as_bytes();
-        let len = bytes.len();
-        let data_ref = self.alloc_typed_array(len as u32, ElemKind::U8)?;
-        for (i, &b) in bytes.iter().enumerate() {
-            self.write_typed(data_ref, i, b as u64)?;
-        }
-        let struct_slots = vec![Value::Ref(data_ref), Value::I64(len as i64)];
+        self.alloc_string_bytes(value.as_bytes())
+    }
+
+    /// Allocate a String struct `[ptr, len]` from raw UTF-8 bytes.
+    ///
+    /// The bytes are copied into the `U8` data array in a single pass.
+    pub fn alloc_string_bytes(&mut self, bytes: &[u8]) -> Result<GcRef, String> {
+        let data_ref = self.alloc_byte_array(bytes)?;
+        let struct_slots = vec![Value::Ref(data_ref), Value::I64(bytes.len() as i64)];
         self.alloc_slots(struct_slots)
     }
 
+    /// Allocate a `U8` typed array initialized with a copy of `bytes`.
+    pub fn alloc_byte_array(&mut self, bytes: &[u8]) -> Result<GcRef, String> {
+        let count = u32::try_from(bytes.len())
+            .map_err(|_| format!("byte array too large ({} bytes)", bytes.len()))?;
+        let r = self.alloc_typed_array(count, ElemKind::U8)?;
+        let start = r.base() + 8;
+        self.memory[start..start + bytes.len()].copy_from_slice(bytes);
+        Ok(r)
+    }
+
+    /// Borrow the elements of a `U8` typed array without copying.
+    ///
+    /// Returns `None` if `r` is not a `U8` array. The slice points into linear
+    /// memory, so it is only valid until the next allocation or GC.
+    pub fn byte_slice(&self, r: GcRef) -> Option<&[u8]> {
+        if !r.is_valid() {
+            return None;
+        }
+        let offset = r.base();
+        let header = try_read_u64(&self.memory, offset)?;
+        if decode_elem_kind(header) != ElemKind::U8 {
+            return None;
+        }
+        let count = decode_slot_count(header) as usize;
+        let data = offset + 8;
+        self.memory
+            .get(data + r.slot_offset().min(count)..data + count)
+    }
+
+    /// Borrow the bytes of a String struct `[ptr, len]` without copying.
+    ///
+    /// Returns `None` unless `r` is a string backed by a `U8` data array.
+    /// Like `byte_slice`, the result is only valid until the next allocation
+    /// or GC.
+    pub fn string_bytes(&self, r: GcRef) -> Option<&[u8]> {
+        let data_ref = self.read_slot(r, 0)?.as_ref()?;
+        let len = usize::try_from(self.read_slot(r, 1)?.as_i64()?).ok()?;
+        self.byte_slice(data_ref)?.get(..len)
+    }
+
     /// Allocate a new slot-based heap object.
     pub fn alloc_slots(&mut self, slots: Vec<Value>) -> Result<GcRef, String> {
         let slot_count = slots.len() as u32;
@@ -481,26 +926,15 @@ impl Heap {
 
         self.check_heap_limit(obj_size_bytes)?;
 
-        // Try to find a suitable free block (first-fit)
-        let offset = if let Some(offset) = self.find_free_block(obj_size_bytes) {
-            offset
-        } else {
-            // No suitable free block, allocate from bump pointer
-            let required_len = self.next_alloc + obj_size_bytes;
-            if required_len > self.memory.len() {
-                self.memory
-                    .resize(required_len.max(self.memory.len() * 2), 0);
-            }
-
-            let offset = self.next_alloc;
-            self.next_alloc += obj_size_bytes;
-            offset
-        };
-
-        self.bytes_allocated += obj_size_bytes;
+        let (offset, young) = self.alloc_block(obj_size_bytes);
+        let marked = self.note_alloc(offset, obj_size_bytes);
 
-        // Write header (not marked, not free)
-        write_u64(&mut self.memory, offset, encode_header(false, slot_count));
+        // Write header (not free; marked while an incremental GC still has to visit it)
+        let mut header = encode_header(marked, slot_count);
+        if young {
+            header |= HEADER_YOUNG_BIT;
+        }
+        write_u64(&mut self.memory, offset, header);
 
         // Write slots
         for (i, value) in slots.iter().enumerate() {
@@ -509,7 +943,14 @@ impl Heap {
             write_u64(&mut self.memory, offset + 8 + 16 * i + 8, payload);
         }
 
-        Ok(GcRef::from_offset(offset))
+        // A large or pretenured object starts out old, and its slots may
+        // already point at young objects
+        let r = GcRef::from_offset(offset);
+        if !young && slots.iter().any(|v| matches!(v, Value::Ref(_))) {
+            self.remember(r);
+        }
+
+        Ok(r)
     }
 
     /// Allocate a typed array with `count` zero-initialized elements.
@@ -526,27 +967,15 @@ impl Heap {
 
         self.check_heap_limit(obj_size_bytes)?;
 
-        let offset = if let Some(offset) = self.find_free_block(obj_size_bytes) {
-            offset
-        } else {
-            let required_len = self.next_alloc + obj_size_bytes;
-            if required_len > self.memory.len() {
-                self.memory
-                    .resize(required_len.max(self.memory.len() * 2), 0);
-            }
-            let offset = self.next_alloc;
-            self.next_alloc += obj_size_bytes;
-            offset
-        };
-
-        self.bytes_allocated += obj_size_bytes;
+        let (offset, young) = self.alloc_block(obj_size_bytes);
+        let marked = self.note_alloc(offset, obj_size_bytes);
 
         // Write header with elem_kind
-        write_u64(
-            &mut self.memory,
-            offset,
-            encode_header_with_kind(false, count, kind),
-        );
+        let mut header = encode_header_with_kind(marked, count, kind);
+        if young {
+            header |= HEADER_YOUNG_BIT;
+        }
+        write_u64(&mut self.memory, offset, header);
 
         // Zero-initialize elements (already 0 from resize, but be explicit for reused blocks)
         match kind {
@@ -632,66 +1061,327 @@ impl Heap {
         Ok(())
     }
 
-    /// Find a free block of at least the given size in bytes (first-fit).
-    /// If found, removes it from the free list and returns its byte offset.
-    /// May split the block if it's larger than needed.
-    fn find_free_block(&mut self, needed_bytes: usize) -> Option<usize> {
-        // Minimum free block size: header + next pointer = 16 bytes
-        const MIN_FREE_BLOCK_SIZE: usize = 16;
-
-        let mut prev_offset: Option<usize> = None;
-        let mut current = self.free_list_head;
-
-        while current != 0 {
-            let header = read_u64(&self.memory, current);
-            let block_size = decode_free_size_bytes(header);
-            let next = read_u64(&self.memory, current + 8) as usize;
-
-            if block_size >= needed_bytes {
-                // Found a suitable block
-                // Remove from free list
-                if let Some(prev) = prev_offset {
-                    write_u64(&mut self.memory, prev + 8, next as u64);
-                } else {
-                    self.free_list_head = next;
+    /// Element kind of `r` and the byte offset of its element `start`, after
+    /// checking that `start..start + count` (from `r`'s slot offset) is in
+    /// bounds. An empty range is always in bounds, even of a null `r`.
+    fn elem_range(
+        &self,
+        r: GcRef,
+        start: usize,
+        count: usize,
+    ) -> Result<(ElemKind, usize), String> {
+        if count == 0 {
+            return Ok((self.get_elem_kind(r), 0));
+        }
+        if !r.is_valid() {
+            return Err("invalid reference".to_string());
+        }
+        let offset = r.base();
+        let header =
+            try_read_u64(&self.memory, offset).ok_or("invalid reference: out of bounds")?;
+        let slot_count = decode_slot_count(header) as usize;
+        let first = start.saturating_add(r.slot_offset());
+        if first.saturating_add(count) > slot_count {
+            return Err(format!(
+                "range {}..{} out of bounds (count: {})",
+                first,
+                first.saturating_add(count),
+                slot_count
+            ));
+        }
+        let kind = decode_elem_kind(header);
+        Ok((kind, offset + 8 + first * elem_size(kind)))
+    }
+
+    /// Set elements `start..start + count` of `r` to `value`.
+    pub fn fill_elems(
+        &mut self,
+        r: GcRef,
+        start: usize,
+        count: usize,
+        value: Value,
+    ) -> Result<(), String> {
+        let (kind, at) = self.elem_range(r, start, count)?;
+        let elems = &mut self.memory[at..at + count * elem_size(kind)];
+        let (tag, payload) = value.encode();
+        match kind {
+            ElemKind::U8 => elems.fill(payload as u8),
+            ElemKind::Tagged => {
+                for slot in elems.chunks_exact_mut(16) {
+                    slot[..8].copy_from_slice(&tag.to_le_bytes());
+                    slot[8..].copy_from_slice(&payload.to_le_bytes());
                 }
-
-                // Check if we should split the block
-                let remaining = block_size - needed_bytes;
-                if remaining >= MIN_FREE_BLOCK_SIZE {
-                    // Split: create a new free block for the remainder
-                    let new_free_offset = current + needed_bytes;
-                    write_u64(
-                        &mut self.memory,
-                        new_free_offset,
-                        encode_free_header(remaining),
-                    );
-                    write_u64(
-                        &mut self.memory,
-                        new_free_offset + 8,
-                        self.free_list_head as u64,
-                    );
-                    self.free_list_head = new_free_offset;
+            }
+            _ if payload == 0 => elems.fill(0),
+            _ => {
+                for elem in elems.chunks_exact_mut(8) {
+                    elem.copy_from_slice(&payload.to_le_bytes());
                 }
+            }
+        }
+        Ok(())
+    }
 
-                return Some(current);
+    /// Copy `count` elements from `src[src_start..]` to `dst[dst_start..]`.
+    /// Overlapping ranges copy as if through a temporary. Arrays of
+    /// different element kinds convert element by element.
+    pub fn copy_elems(
+        &mut self,
+        dst: GcRef,
+        dst_start: usize,
+        src: GcRef,
+        src_start: usize,
+        count: usize,
+    ) -> Result<(), String> {
+        let (dst_kind, to) = self.elem_range(dst, dst_start, count)?;
+        let (src_kind, from) = self.elem_range(src, src_start, count)?;
+        if dst_kind == src_kind {
+            let bytes = count * elem_size(src_kind);
+            self.memory.copy_within(from..from + bytes, to);
+            return Ok(());
+        }
+        for i in 0..count {
+            let value = self
+                .read_slot(src, src_start + i)
+                .ok_or("invalid reference: out of bounds")?;
+            self.write_slot(dst, dst_start + i, value)?;
+        }
+        Ok(())
+    }
+
+    /// Whether `a[a_start..]` and `b[b_start..]` hold the same `count`
+    /// elements, compared bit for bit.
+    pub fn elems_equal(
+        &self,
+        a: GcRef,
+        a_start: usize,
+        b: GcRef,
+        b_start: usize,
+        count: usize,
+    ) -> Result<bool, String> {
+        let (a_kind, a_at) = self.elem_range(a, a_start, count)?;
+        let (b_kind, b_at) = self.elem_range(b, b_start, count)?;
+        if a_kind == b_kind {
+            let bytes = count * elem_size(a_kind);
+            return Ok(self.memory[a_at..a_at + bytes] == self.memory[b_at..b_at + bytes]);
+        }
+        Ok((0..count).all(|i| {
+            let x = self.read_slot(a, a_start + i).map(|v| v.encode());
+            let y = self.read_slot(b, b_start + i).map(|v| v.encode());
+            x == y
+        }))
+    }
+
+    /// Index of the first element in `start..end` of `r` whose bits equal
+    /// `value`'s.
+    pub fn find_elem(
+        &self,
+        r: GcRef,
+        start: usize,
+        end: usize,
+        value: Value,
+    ) -> Result<Option<usize>, String> {
+        let count = end.saturating_sub(start);
+        let (kind, at) = self.elem_range(r, start, count)?;
+        let elems = &self.memory[at..at + count * elem_size(kind)];
+        let (tag, payload) = value.encode();
+        let found = match kind {
+            ElemKind::U8 => match u8::try_from(payload) {
+                Ok(byte) if matches!(value, Value::I64(_)) => bulk::find_byte(elems, byte),
+                _ => None,
+            },
+            ElemKind::Tagged => elems.chunks_exact(16).position(|slot| {
+                slot[..8] == tag.to_le_bytes() && slot[8..] == payload.to_le_bytes()
+            }),
+            _ => bulk::find_u64(elems, payload),
+        };
+        Ok(found.map(|i| start + i))
+    }
+
+    /// Apply the F64 op `op` elementwise to the first `count` elements:
+    /// `dst = a op b`, or `dst = a * b + c` for `FmaF64`. F64 arrays take
+    /// the vector kernels; other arrays must hold floats and go element by
+    /// element.
+    pub fn map_f64(
+        &mut self,
+        op: BulkOp,
+        dst: GcRef,
+        a: GcRef,
+        b: GcRef,
+        c: Option<GcRef>,
+        count: usize,
+    ) -> Result<(), String> {
+        if count == 0 {
+            return Ok(());
+        }
+        let mut at = [0; 4];
+        let mut typed = true;
+        for (slot, r) in at.iter_mut().zip([Some(dst), Some(a), Some(b), c]) {
+            let Some(r) = r else { continue };
+            let (kind, offset) = self.elem_range(r, 0, count)?;
+            typed &= kind == ElemKind::F64;
+            *slot = offset;
+        }
+        if typed {
+            bulk::map_f64(&mut self.memory, op, at[0], [at[1], at[2], at[3]], count);
+            return Ok(());
+        }
+        let float_at = |heap: &Self, r: GcRef, i: usize| match heap.read_slot(r, i) {
+            Some(Value::F64(x)) => Ok(x),
+            _ => Err("expected float elements".to_string()),
+        };
+        for i in 0..count {
+            let x = float_at(self, a, i)?;
+            let y = float_at(self, b, i)?;
+            let z = match op {
+                BulkOp::AddF64 => x + y,
+                BulkOp::MulF64 => x * y,
+                _ => x.mul_add(y, float_at(self, c.unwrap_or(dst), i)?),
+            };
+            self.write_slot(dst, i, Value::F64(z))?;
+        }
+        Ok(())
+    }
+
+    /// Reserve `size_bytes` for a new object.
+    ///
+    /// Returns the offset and whether the object is young. Young objects are
+    /// bump allocated in the nursery; old ones come from the free lists or
+    /// the top of the heap.
+    fn alloc_block(&mut self, size_bytes: usize) -> (usize, bool) {
+        if let Some(offset) = self.nursery_alloc(size_bytes) {
+            return (offset, true);
+        }
+        let offset = match self.find_free_block(size_bytes) {
+            Some(offset) => offset,
+            None => self.alloc_top(size_bytes),
+        };
+        (offset, false)
+    }
+
+    /// Allocate `size_bytes` at the top of the heap.
+    fn alloc_top(&mut self, size_bytes: usize) -> usize {
+        let required_len = self.next_alloc + size_bytes;
+        if required_len > self.memory.len() {
+            self.memory
+                .resize(required_len.max(self.memory.len() * 2), 0);
+        }
+        let offset = self.next_alloc;
+        self.next_alloc += size_bytes;
+        offset
+    }
+
+    /// Bump allocate a young object, refilling the buffer if needed.
+    ///
+    /// Returns `None` when the object must be allocated old: no nursery is
+    /// configured, allocation is pretenured, a major cycle is in progress, or
+    /// the object is large.
+    #[inline]
+    fn nursery_alloc(&mut self, size_bytes: usize) -> Option<usize> {
+        if self.pretenure || self.marking || self.sweep.is_some() {
+            return None;
+        }
+        let nursery = self.nursery.as_ref()?;
+        if nursery.bump + size_bytes > nursery.bump_end {
+            if size_bytes >= Self::NURSERY_LARGE_OBJECT_BYTES {
+                return None;
             }
+            self.refill_nursery_buffer(size_bytes);
+        }
+
+        let nursery = self.nursery.as_mut()?;
+        let offset = nursery.bump;
+        nursery.bump += size_bytes;
+        nursery.young.push(offset);
+        nursery.young_bytes += size_bytes;
+        Some(offset)
+    }
+
+    /// Replace the bump buffer with one that fits at least `size_bytes`.
+    fn refill_nursery_buffer(&mut self, size_bytes: usize) {
+        self.retire_nursery_buffer();
+        let (start, len) =
+            match self.take_free_block(size_bytes.max(Self::NURSERY_MIN_BUFFER_BYTES)) {
+                Some(block) => block,
+                None => (
+                    self.alloc_top(Self::NURSERY_CHUNK_BYTES),
+                    Self::NURSERY_CHUNK_BYTES,
+                ),
+            };
+        if let Some(nursery) = &mut self.nursery {
+            nursery.bump = start;
+            nursery.bump_end = start + len;
+        }
+    }
+
+    /// Give the unused end of the bump buffer back to the free list, so the
+    /// heap can be walked object by object.
+    fn retire_nursery_buffer(&mut self) {
+        let Some(nursery) = &mut self.nursery else {
+            return;
+        };
+        let (start, end) = (nursery.bump, nursery.bump_end);
+        nursery.bump = 0;
+        nursery.bump_end = 0;
+        self.release_block(start, end - start);
+    }
 
-            prev_offset = Some(current);
-            current = next;
+    /// Return `size_bytes` of dead space at `offset` to the allocator.
+    ///
+    /// Space at the top of the heap lowers `next_alloc`; anything else
+    /// becomes a free block.
+    fn release_block(&mut self, offset: usize, size_bytes: usize) {
+        if size_bytes == 0 {
+            return;
+        }
+        if offset + size_bytes == self.next_alloc {
+            self.next_alloc = offset;
+        } else {
+            self.add_to_free_list(offset, size_bytes);
         }
+    }
 
-        None
+    /// Remove a free block of at least `min_bytes` from the free lists and
+    /// return it whole as `(offset, size)`.
+    fn take_free_block(&mut self, min_bytes: usize) -> Option<(usize, usize)> {
+        self.free_lists.take(&self.memory, 0, min_bytes)
     }
 
-    /// Add a block to the free list.
+    /// Account for a new object at `offset` and return whether it must be
+    /// allocated marked.
+    ///
+    /// During an incremental mark every new object is live. During an
+    /// incremental sweep, objects the sweep has yet to visit are marked so it
+    /// keeps them; objects behind the cursor start unmarked for the next cycle.
+    fn note_alloc(&mut self, offset: usize, size_bytes: usize) -> bool {
+        self.bytes_allocated += size_bytes;
+        self.allocated_bytes_total += size_bytes as u64;
+        self.allocated_objects_total += 1;
+        match &mut self.sweep {
+            Some(sweep) if offset < sweep.cursor => {
+                sweep.allocated_behind += size_bytes;
+                false
+            }
+            Some(_) => true,
+            None => self.marking,
+        }
+    }
+
+    /// Find a free block of at least the given size in bytes.
+    /// If found, removes it from the free lists and returns its byte offset.
+    /// The rest of a larger block goes back to the free lists.
+    fn find_free_block(&mut self, needed_bytes: usize) -> Option<usize> {
+        let (offset, block_size) = self.take_free_block(needed_bytes)?;
+        if block_size > needed_bytes {
+            self.add_to_free_list(offset + needed_bytes, block_size - needed_bytes);
+        }
+        Some(offset)
+    }
+
+    /// Add a block to the free list of its size class.
     fn add_to_free_list(&mut self, offset: usize, size_bytes: usize) {
-        // Write free block header
-        write_u64(&mut self.memory, offset, encode_free_header(size_bytes));
-        // Link to current head
-        write_u64(&mut self.memory, offset + 8, self.free_list_head as u64);
-        // Update head
-        self.free_list_head = offset;
+        self.free_lists
+            .insert(&mut self.memory, 0, offset, size_bytes);
     }
 
     /// Get an object by reference, constructing a HeapObject view.
@@ -811,24 +1501,6 @@ impl Heap {
         Some(decode_slot_count(header) as usize)
     }
 
-    /// Check if an offset could be a valid allocated object start.
-    /// Used for conservative GC stack scanning in the typed opcode architecture
-    /// where stack values are raw u64 and type information is in opcodes.
-    pub fn is_possible_object_ref(&self, offset: usize) -> bool {
-        if offset == 0 || offset >= self.next_alloc {
-            return false;
-        }
-        if let Some(header) = try_read_u64(&self.memory, offset) {
-            if decode_free(header) {
-                return false;
-            }
-            let obj_size = object_size_bytes_from_header(header);
-            offset + obj_size <= self.next_alloc
-        } else {
-            false
-        }
-    }
-
     /// Check if GC should be triggered.
     pub fn should_gc(&self) -> bool {
         self.gc_enabled && self.bytes_allocated >= self.gc_threshold
@@ -839,6 +1511,17 @@ impl Heap {
         self.bytes_allocated
     }
 
+    /// Bytes and objects allocated since the heap was created. A snapshot
+    /// starts at zero.
+    pub fn allocation_totals(&self) -> (u64, u64) {
+        (self.allocated_bytes_total, self.allocated_objects_total)
+    }
+
+    /// Size of the linear memory, live or not.
+    pub fn memory_size(&self) -> usize {
+        self.memory.len()
+    }
+
     /// Set the marked flag for an object.
     fn set_marked(&mut self, offset: usize, marked: bool) {
         if let Some(header) = try_read_u64(&self.memory, offset) {
@@ -860,52 +1543,83 @@ impl Heap {
 
     /// Mark phase: mark all reachable objects.
     pub fn mark(&mut self, roots: &[Value]) {
+        self.promote_nursery();
+        let mut hints =
+            (self.next_alloc >= PARALLEL_SWEEP_MIN_BYTES).then(|| SweepHints::new(self.next_alloc));
+
         // Collect all root references
         let mut worklist: Vec<GcRef> = roots.iter().filter_map(|v| v.as_ref()).collect();
 
         // Mark and trace
         while let Some(r) = worklist.pop() {
-            if !r.is_valid() {
-                continue;
+            if self.mark_and_trace(r, &mut worklist)
+                && let Some(hints) = &mut hints
+            {
+                hints.note(r.offset());
             }
+        }
+        self.sweep_hints = hints;
+    }
 
-            let offset = r.offset();
-            if self.is_marked(offset) {
-                continue;
-            }
+    /// Mark one object and return its unmarked children.
+    ///
+    /// Used by incremental marking, which keeps its own gray list. Returns no
+    /// children if the object is invalid or already marked.
+    pub fn mark_object(&mut self, r: GcRef) -> Vec<GcRef> {
+        let mut children = Vec::new();
+        self.mark_and_trace(r, &mut children);
+        children
+    }
 
-            // Mark this object
-            self.set_marked(offset, true);
+    /// Mark `r` if it is unmarked and push its references onto `worklist`.
+    ///
+    /// Returns whether `r` was newly marked.
+    fn mark_and_trace(&mut self, r: GcRef, worklist: &mut Vec<GcRef>) -> bool {
+        if !r.is_valid() {
+            return false;
+        }
 
-            // Trace children based on elem_kind
-            let header = match try_read_u64(&self.memory, offset) {
-                Some(h) => h,
-                None => continue,
-            };
-            let kind = decode_elem_kind(header);
-            let count = decode_slot_count(header) as usize;
-
-            match kind {
-                ElemKind::Tagged => {
-                    // Legacy: scan tagged slots for Ref values
-                    if let Some(obj) = HeapObject::from_memory(&self.memory, offset) {
-                        worklist.extend(obj.trace());
-                    }
-                }
-                ElemKind::I64 | ElemKind::F64 | ElemKind::U8 => {
-                    // Primitive-only array: no references to trace
+        let offset = r.offset();
+        if self.is_marked(offset) {
+            return false;
+        }
+
+        // Mark this object
+        self.set_marked(offset, true);
+        self.trace_children(offset, worklist);
+        true
+    }
+
+    /// Push the references held by the object at `offset` onto `worklist`.
+    fn trace_children(&self, offset: usize, worklist: &mut Vec<GcRef>) {
+        // Trace children based on elem_kind
+        let header = match try_read_u64(&self.memory, offset) {
+            Some(h) => h,
+            None => return,
+        };
+        let kind = decode_elem_kind(header);
+        let count = decode_slot_count(header) as usize;
+
+        match kind {
+            ElemKind::Tagged => {
+                // Legacy: scan tagged slots for Ref values
+                if let Some(obj) = HeapObject::from_memory(&self.memory, offset) {
+                    worklist.extend(obj.trace());
                 }
-                ElemKind::Ref => {
-                    // All elements are references: trace each one
-                    for i in 0..count {
-                        let byte_off = offset + 8 + i * 8;
-                        if let Some(payload) = try_read_u64(&self.memory, byte_off) {
-                            let child = GcRef {
-                                index: payload as usize,
-                            };
-                            if child.is_valid() {
-                                worklist.push(child);
-                            }
+            }
+            ElemKind::I64 | ElemKind::F64 | ElemKind::U8 => {
+                // Primitive-only array: no references to trace
+            }
+            ElemKind::Ref => {
+                // All elements are references: trace each one
+                for i in 0..count {
+                    let byte_off = offset + 8 + i * 8;
+                    if let Some(payload) = try_read_u64(&self.memory, byte_off) {
+                        let child = GcRef {
+                            index: payload as usize,
+                        };
+                        if child.is_valid() {
+                            worklist.push(child);
                         }
                     }
                 }
@@ -913,43 +1627,142 @@ impl Heap {
         }
     }
 
-    /// Sweep phase: free all unmarked objects by adding them to the free list.
-    pub fn sweep(&mut self) {
-        // Walk through all allocated objects
-        let mut offset = 8; // Start after reserved 8-byte null word
-        let mut live_bytes = 0;
+    /// Start an incremental mark: objects allocated from now on are live.
+    ///
+    /// The caller drives marking with `mark_object` and finishes the cycle
+    /// with `begin_sweep` and `sweep_step`.
+    pub fn begin_incremental_mark(&mut self) {
+        self.promote_nursery();
+        self.sweep_hints = None;
+        self.marking = true;
+    }
 
-        while offset < self.next_alloc {
-            let header = read_u64(&self.memory, offset);
+    /// Whether an incremental mark or sweep is in progress.
+    pub fn gc_in_progress(&self) -> bool {
+        self.marking || self.sweep.is_some()
+    }
 
-            // Skip free blocks (already in free list)
-            if decode_free(header) {
-                let block_size = decode_free_size_bytes(header);
-                offset += block_size;
-                continue;
-            }
+    /// End marking and start sweeping from the bottom of the heap.
+    ///
+    /// The sweep rebuilds the free lists, merging each run of dead objects
+    /// and free blocks into one block.
+    pub fn begin_sweep(&mut self) {
+        self.marking = false;
+        self.free_lists = FreeLists::new();
+        // Start after reserved 8-byte null word
+        self.sweep = Some(SweepState::new(8));
+    }
 
-            let obj_size = object_size_bytes_from_header(header);
+    /// Sweep roughly `budget_bytes` of heap.
+    ///
+    /// Returns the number of objects freed by the whole sweep once it reaches
+    /// the top of the heap, or `None` while there is more to do.
+    pub fn sweep_step(&mut self, budget_bytes: usize) -> Option<usize> {
+        let mut sweep = self.sweep.take()?;
+        let end = sweep
+            .cursor
+            .saturating_add(budget_bytes)
+            .min(self.next_alloc);
+        sweep_range(&mut self.memory, 0, end, &mut self.free_lists, &mut sweep);
+
+        if sweep.cursor < self.next_alloc {
+            self.sweep = Some(sweep);
+            return None;
+        }
+        Some(self.finish_sweep(sweep))
+    }
 
-            if decode_marked(header) {
-                // Live object - reset mark for next GC cycle
-                self.set_marked(offset, false);
-                live_bytes += obj_size;
-            } else {
-                // Dead object - add to free list if large enough.
-                // Free blocks need at least 16 bytes (header + next pointer).
-                // 8-byte objects (slot_count=0) cannot hold a next pointer,
-                // so adding them would corrupt adjacent memory.
-                if obj_size >= 16 {
-                    self.add_to_free_list(offset, obj_size);
-                }
-            }
+    /// Release the final dead run and reset the GC threshold; returns the
+    /// number of objects freed.
+    fn finish_sweep(&mut self, sweep: SweepState) -> usize {
+        // The final run ends at the top of the heap
+        if let Some((start, len)) = sweep.run {
+            self.release_block(start, len);
+        }
+        self.sweep = None;
+        self.bytes_allocated = sweep.live_bytes + sweep.allocated_behind;
+        self.gc_threshold = (self.bytes_allocated * 2).max(1024 * 1024);
+        self.clamp_threshold();
+        sweep.freed
+    }
 
-            offset += obj_size;
+    /// Sweep phase: free all unmarked objects by adding them to the free lists.
+    ///
+    /// After a `mark` of a large heap the sweep is split over several
+    /// threads.
+    pub fn sweep(&mut self) {
+        self.sweep_with_threads(sweep_threads());
+    }
+
+    fn sweep_with_threads(&mut self, threads: usize) {
+        let hints = self.sweep_hints.take();
+        self.begin_sweep();
+        match hints {
+            Some(hints) if threads > 1 => self.parallel_sweep(&hints, threads),
+            _ => while self.sweep_step(usize::MAX).is_none() {},
         }
+    }
 
-        self.bytes_allocated = live_bytes;
-        self.gc_threshold = (self.bytes_allocated * 2).max(1024 * 1024);
+    /// Sweep disjoint ranges of the heap on up to `threads` threads.
+    ///
+    /// Each range after the first starts at a marked object, so every dead
+    /// run ends inside its range and the per-range free lists can simply be
+    /// concatenated.
+    fn parallel_sweep(&mut self, hints: &SweepHints, threads: usize) {
+        let top = self.next_alloc;
+        let mut bounds: Vec<usize> = hints
+            .starts
+            .iter()
+            .copied()
+            .filter(|&start| start > 8 && start < top)
+            .collect();
+        if bounds.len() >= threads {
+            bounds = (1..threads)
+                .map(|i| bounds[i * bounds.len() / threads])
+                .collect();
+        }
+        let mut starts = vec![8];
+        starts.extend(bounds);
+        let ranges = starts.len();
+
+        let results: Vec<(FreeLists, SweepState)> = std::thread::scope(|scope| {
+            let mut rest = &mut self.memory[..top];
+            let mut base = 0;
+            let mut handles = Vec::with_capacity(ranges);
+            for (i, &start) in starts.iter().enumerate() {
+                let end = starts.get(i + 1).copied().unwrap_or(top);
+                let (chunk, tail) = std::mem::take(&mut rest).split_at_mut(end - base);
+                rest = tail;
+                let chunk_base = base;
+                base = end;
+                handles.push(scope.spawn(move || {
+                    let mut lists = FreeLists::new();
+                    let mut sweep = SweepState::new(start);
+                    sweep_range(chunk, chunk_base, end, &mut lists, &mut sweep);
+                    // The next range starts with a live object, so this run is
+                    // complete; the last range's run is left for finish_sweep
+                    if i + 1 < ranges
+                        && let Some((start, len)) = sweep.run.take()
+                    {
+                        lists.insert(chunk, chunk_base, start, len);
+                    }
+                    (lists, sweep)
+                }));
+            }
+            handles
+                .into_iter()
+                .map(|handle| handle.join().expect("sweep thread panicked"))
+                .collect()
+        });
+
+        let mut total = SweepState::new(top);
+        for (lists, sweep) in &results {
+            self.free_lists.append(&mut self.memory, lists);
+            total.live_bytes += sweep.live_bytes;
+            total.freed += sweep.freed;
+            total.run = sweep.run;
+        }
+        self.finish_sweep(total);
     }
 
     /// Perform a full garbage collection cycle.
@@ -958,6 +1771,159 @@ impl Heap {
         self.sweep();
     }
 
+    // =========================================================================
+    // Generational GC
+    // =========================================================================
+
+    /// Allocate small objects in a nursery of `capacity_bytes`, or disable the
+    /// nursery with `None` (promoting its objects).
+    pub fn set_nursery(&mut self, capacity_bytes: Option<usize>) {
+        match capacity_bytes {
+            Some(capacity) => {
+                self.nursery.get_or_insert_with(Nursery::default).capacity = capacity;
+            }
+            None => {
+                self.promote_nursery();
+                self.nursery = None;
+            }
+        }
+    }
+
+    /// Allocate every object old while `on` is set; returns the previous
+    /// setting.
+    ///
+    /// Used while code that stores without a write barrier can run.
+    pub fn set_pretenure(&mut self, on: bool) -> bool {
+        std::mem::replace(&mut self.pretenure, on)
+    }
+
+    /// Whether the nursery is full and a minor collection should run.
+    pub fn should_minor_gc(&self) -> bool {
+        self.gc_enabled
+            && !self.gc_in_progress()
+            && self
+                .nursery
+                .as_ref()
+                .is_some_and(|n| n.young_bytes >= n.capacity)
+    }
+
+    /// Whether any young objects exist.
+    pub fn has_young_objects(&self) -> bool {
+        self.nursery.as_ref().is_some_and(|n| !n.young.is_empty())
+    }
+
+    /// Generational write barrier: record that old object `r` was given a
+    /// reference, so a minor collection treats its children as roots.
+    #[inline]
+    pub fn remember(&mut self, r: GcRef) {
+        let Some(nursery) = &mut self.nursery else {
+            return;
+        };
+        if nursery.young.is_empty() || !r.is_valid() {
+            return;
+        }
+        let offset = r.base();
+        let Some(header) = try_read_u64(&self.memory, offset) else {
+            return;
+        };
+        if header & (HEADER_YOUNG_BIT | HEADER_REMEMBERED_BIT | HEADER_FREE_BIT) != 0 {
+            return;
+        }
+        write_u64(&mut self.memory, offset, header | HEADER_REMEMBERED_BIT);
+        nursery.remembered.push(GcRef::from_offset(offset));
+    }
+
+    /// Make every young object old and empty the remembered set.
+    pub fn promote_nursery(&mut self) {
+        self.retire_nursery_buffer();
+        let Some(nursery) = &mut self.nursery else {
+            return;
+        };
+        for &offset in &nursery.young {
+            let header = read_u64(&self.memory, offset);
+            write_u64(&mut self.memory, offset, header & !HEADER_YOUNG_BIT);
+        }
+        for r in &nursery.remembered {
+            let header = read_u64(&self.memory, r.base());
+            write_u64(&mut self.memory, r.base(), header & !HEADER_REMEMBERED_BIT);
+        }
+        nursery.young.clear();
+        nursery.young_bytes = 0;
+        nursery.remembered.clear();
+    }
+
+    /// Minor collection: free young objects not reachable from `roots` or
+    /// from remembered old objects, and promote the survivors.
+    ///
+    /// Old objects are neither traced nor swept, so the cost depends on the
+    /// roots, the remembered set and the number of young objects, not on the
+    /// heap size. Adjacent dead young objects are merged into one free block,
+    /// and dead space at the top of the heap is handed back to the bump
+    /// allocator. Returns the number of objects freed.
+    pub fn minor_collect(&mut self, roots: &[Value]) -> usize {
+        self.retire_nursery_buffer();
+        let Some(mut nursery) = self.nursery.take() else {
+            return 0;
+        };
+
+        // Mark young objects reachable from the roots and the remembered set
+        let mut worklist: Vec<GcRef> = roots.iter().filter_map(|v| v.as_ref()).collect();
+        for r in &nursery.remembered {
+            let header = read_u64(&self.memory, r.base());
+            write_u64(&mut self.memory, r.base(), header & !HEADER_REMEMBERED_BIT);
+            self.trace_children(r.base(), &mut worklist);
+        }
+        while let Some(r) = worklist.pop() {
+            if r.is_valid()
+                && try_read_u64(&self.memory, r.base()).is_some_and(|h| h & HEADER_YOUNG_BIT != 0)
+            {
+                self.mark_and_trace(r, &mut worklist);
+            }
+        }
+
+        // Sweep the young objects only, coalescing runs of dead ones
+        let mut freed = 0;
+        let mut freed_bytes = 0;
+        let mut dead_run: Option<(usize, usize)> = None;
+        for &offset in &nursery.young {
+            let header = read_u64(&self.memory, offset);
+            let size = object_size_bytes_from_header(header);
+            if decode_marked(header) {
+                // Survivor: promote in place
+                write_u64(
+                    &mut self.memory,
+                    offset,
+                    header & !(HEADER_MARKED_BIT | HEADER_YOUNG_BIT),
+                );
+                if let Some((start, len)) = dead_run.take() {
+                    self.release_block(start, len);
+                }
+                continue;
+            }
+
+            freed += 1;
+            freed_bytes += size;
+            dead_run = match dead_run {
+                Some((start, len)) if start + len == offset => Some((start, len + size)),
+                Some((start, len)) => {
+                    self.release_block(start, len);
+                    Some((offset, size))
+                }
+                None => Some((offset, size)),
+            };
+        }
+        if let Some((start, len)) = dead_run {
+            self.release_block(start, len);
+        }
+
+        nursery.young.clear();
+        nursery.young_bytes = 0;
+        nursery.remembered.clear();
+        self.nursery = Some(nursery);
+        self.bytes_allocated -= freed_bytes;
+        freed
+    }
+
     /// Get count of allocated (non-free) objects.
     /// Note: This counts all allocated objects (some may be garbage before GC).
     pub fn object_count(&self) -> usize {
@@ -965,6 +1931,15 @@ impl Heap {
         let mut offset = 8;
 
         while offset < self.next_alloc {
+            // Skip the unused part of the bump buffer
+            if let Some(nursery) = &self.nursery
+                && offset == nursery.bump
+                && nursery.bump < nursery.bump_end
+            {
+                offset = nursery.bump_end;
+                continue;
+            }
+
             let header = read_u64(&self.memory, offset);
 
             // Skip free blocks
@@ -1046,6 +2021,46 @@ mod tests {
         assert_eq!(str_value, "hello");
     }
 
+    #[test]
+    fn test_string_bytes() {
+        let mut heap = Heap::new();
+        let text = "{\"key\": \"värde\"}".repeat(300);
+        let r = heap.alloc_string_bytes(text.as_bytes()).unwrap();
+        assert_eq!(heap.string_bytes(r), Some(text.as_bytes()));
+
+        // Reused free blocks must not leak old bytes into the new string
+        heap.collect(&[]);
+        let r = heap.alloc_string("abc".to_string()).unwrap();
+        assert_eq!(heap.string_bytes(r), Some(&b"abc"[..]));
+
+        // Non-string objects have no byte view
+        let arr = heap
+            .alloc_slots(vec![Value::I64(1), Value::I64(2)])
+            .unwrap();
+        assert_eq!(heap.string_bytes(arr), None);
+        assert_eq!(heap.byte_slice(arr), None);
+    }
+
+    #[test]
+    fn test_snapshot() {
+        let mut heap = Heap::new();
+        let s = heap.alloc_string("shared".to_string()).unwrap();
+        let arr = heap
+            .alloc_slots(vec![Value::Ref(s), Value::I64(1)])
+            .unwrap();
+
+        let mut copy = heap.snapshot();
+        assert_eq!(copy.string_bytes(s), Some(&b"shared"[..]));
+        assert_eq!(copy.read_slot(arr, 0), Some(Value::Ref(s)));
+
+        // The copy is independent of the original
+        copy.write_slot(arr, 1, Value::I64(2)).unwrap();
+        assert_eq!(heap.read_slot(arr, 1), Some(Value::I64(1)));
+        let extra = copy.alloc_string("more".to_string()).unwrap();
+        assert_eq!(copy.string_bytes(extra), Some(&b"more"[..]));
+        assert_eq!(copy.object_count(), heap.object_count() + 2);
+    }
+
     #[test]
     fn test_read_write_slot() {
         let mut heap = Heap::new();
@@ -1178,7 +2193,7 @@ mod tests {
 
         // r2 should have been freed and added to free list
         assert_eq!(heap.object_count(), 2);
-        assert!(heap.free_list_head != 0); // Free list should not be empty
+        assert!(heap.free_lists.nonempty != 0); // Free list should not be empty
 
         // r1 and r3 should still be accessible
         assert_eq!(heap.get(r1).unwrap().slots[0], Value::I64(1));
@@ -1233,9 +2248,10 @@ mod tests {
             ])
             .unwrap();
         let r1_offset = r1.offset();
+        let keep = heap.alloc_slots(vec![Value::I64(0)]).unwrap();
 
-        // GC with no roots (r1 becomes garbage)
-        heap.collect(&[]);
+        // GC with only `keep` (r1 becomes garbage)
+        heap.collect(&[Value::Ref(keep)]);
 
         // The 5-slot object takes 1 + 2*5 = 11 words
         // Allocate a smaller object (1 slot = 3 words)
@@ -1246,7 +2262,7 @@ mod tests {
 
         // There should be remaining free space (11 - 3 = 8 words)
         // which should be in the free list
-        assert!(heap.free_list_head != 0);
+        assert!(heap.free_lists.nonempty & (1 << size_class(64)) != 0);
     }
 
     #[test]
@@ -1270,6 +2286,146 @@ mod tests {
         assert_eq!(heap.get(r2).unwrap().slots[0], Value::I64(3));
     }
 
+    #[test]
+    fn test_incremental_cycle() {
+        let mut heap = Heap::new();
+        let child = heap.alloc_slots(vec![Value::I64(1)]).unwrap();
+        let root = heap.alloc_slots(vec![Value::Ref(child)]).unwrap();
+        let _garbage = heap.alloc_slots(vec![Value::I64(2)]).unwrap();
+
+        heap.begin_incremental_mark();
+        let mut gray = vec![root];
+        // Objects allocated while marking survive without being traced
+        let during_mark = heap.alloc_slots(vec![Value::I64(3)]).unwrap();
+        while let Some(r) = gray.pop() {
+            gray.extend(heap.mark_object(r));
+        }
+
+        heap.begin_sweep();
+        assert!(heap.gc_in_progress());
+        assert_eq!(heap.sweep_step(16), None);
+        // Behind the cursor objects start unmarked; ahead they are kept
+        let during_sweep = heap.alloc_slots(vec![Value::I64(4)]).unwrap();
+        let mut freed = None;
+        while freed.is_none() {
+            freed = heap.sweep_step(16);
+        }
+        assert_eq!(freed, Some(1));
+        assert!(!heap.gc_in_progress());
+
+        assert_eq!(heap.read_slot(during_mark, 0), Some(Value::I64(3)));
+        assert_eq!(heap.read_slot(during_sweep, 0), Some(Value::I64(4)));
+        assert_eq!(heap.read_slot(child, 0), Some(Value::I64(1)));
+
+        // No marks leak into the next cycle
+        heap.collect(&[Value::Ref(root)]);
+        assert_eq!(heap.object_count(), 2);
+    }
+
+    #[test]
+    fn test_minor_collect() {
+        let mut heap = Heap::new();
+        let old = heap.alloc_slots(vec![Value::Null]).unwrap();
+        heap.set_nursery(Some(Heap::NURSERY_BYTES));
+
+        let young_root = heap.alloc_slots(vec![Value::I64(1)]).unwrap();
+        let young_child = heap.alloc_typed_array(4, ElemKind::I64).unwrap();
+        heap.write_slot(young_root, 0, Value::Ref(young_child))
+            .unwrap();
+        // Only reachable through the old object
+        let from_old = heap.alloc_slots(vec![Value::I64(2)]).unwrap();
+        heap.remember(old);
+        heap.write_slot(old, 0, Value::Ref(from_old)).unwrap();
+        for i in 0..10 {
+            heap.alloc_slots(vec![Value::I64(i)]).unwrap();
+        }
+        assert!(heap.has_young_objects());
+
+        let before = heap.bytes_allocated();
+        assert_eq!(heap.minor_collect(&[Value::Ref(young_root)]), 10);
+        assert_eq!(before - heap.bytes_allocated(), 10 * object_size_bytes(1));
+        assert!(!heap.has_young_objects());
+        assert_eq!(heap.read_slot(young_root, 0), Some(Value::Ref(young_child)));
+        assert_eq!(heap.read_slot(from_old, 0), Some(Value::I64(2)));
+        assert_eq!(heap.object_count(), 4);
+
+        // Survivors are old now; a full collection still sees them
+        heap.collect(&[Value::Ref(old)]);
+        assert_eq!(heap.read_slot(from_old, 0), Some(Value::I64(2)));
+        assert_eq!(heap.object_count(), 2);
+    }
+
+    #[test]
+    fn test_minor_collect_reuses_dead_space() {
+        let mut heap = Heap::new();
+        heap.set_nursery(Some(Heap::NURSERY_BYTES));
+
+        let mut top = None;
+        for _ in 0..3 {
+            let keep = heap.alloc_slots(vec![Value::I64(7)]).unwrap();
+            for i in 0..5000 {
+                heap.alloc_slots(vec![Value::I64(i)]).unwrap();
+            }
+            heap.minor_collect(&[Value::Ref(keep)]);
+            assert_eq!(heap.read_slot(keep, 0), Some(Value::I64(7)));
+            // Dead objects are recycled: the heap only grows by the survivor
+            let next_alloc = heap.next_alloc;
+            assert!(top.is_none_or(|t| next_alloc <= t + object_size_bytes(1)));
+            top = Some(next_alloc);
+        }
+    }
+
+    #[test]
+    fn test_large_and_pretenured_objects_are_old() {
+        let mut heap = Heap::new();
+        heap.set_nursery(Some(Heap::NURSERY_BYTES));
+
+        heap.alloc_typed_array(4096, ElemKind::I64).unwrap();
+        assert!(!heap.has_young_objects());
+
+        let prev = heap.set_pretenure(true);
+        heap.alloc_slots(vec![Value::I64(1)]).unwrap();
+        assert!(!heap.has_young_objects());
+        heap.set_pretenure(prev);
+
+        heap.alloc_slots(vec![Value::I64(1)]).unwrap();
+        assert!(heap.has_young_objects());
+        heap.set_nursery(None);
+        assert!(!heap.has_young_objects());
+        assert_eq!(heap.object_count(), 3);
+    }
+
+    #[test]
+    fn test_old_object_keeps_young_slots_alive() {
+        let mut heap = Heap::new();
+        heap.set_nursery(Some(Heap::NURSERY_BYTES));
+
+        // Like the data array of a literal of 3000 fresh strings: larger
+        // than a bump buffer, so old, and filled with young refs
+        let strings: Vec<Value> = (0..3000)
+            .map(|i| Value::Ref(heap.alloc_string(format!("s{}", i)).unwrap()))
+            .collect();
+        let array = heap.alloc_slots(strings).unwrap();
+        assert_eq!(read_u64(&heap.memory, array.base()) & HEADER_YOUNG_BIT, 0);
+        // A pretenured object is old whatever its size
+        let young = Value::Ref(heap.alloc_string("pair".to_string()).unwrap());
+        let prev = heap.set_pretenure(true);
+        let pair = heap.alloc_slots(vec![young, Value::I64(1)]).unwrap();
+        heap.set_pretenure(prev);
+
+        heap.minor_collect(&[Value::Ref(array), Value::Ref(pair)]);
+        // Reuse whatever the collection freed
+        for _ in 0..3000 {
+            heap.alloc_string("garbage".to_string()).unwrap();
+        }
+        for i in 0..3000 {
+            let s = heap.read_slot(array, i).unwrap().as_ref().unwrap();
+            assert_eq!(heap.string_bytes(s), Some(format!("s{}", i).as_bytes()));
+        }
+        let s = heap.read_slot(pair, 0).unwrap().as_ref().unwrap();
+        assert_eq!(heap.string_bytes(s), Some(&b"pair"[..]));
+    }
+
     #[test]
     fn test_gc_all_garbage() {
         let mut heap = Heap::new();
@@ -1285,7 +2441,179 @@ mod tests {
         heap.collect(&[]);
 
         assert_eq!(heap.object_count(), 0);
-        assert!(heap.free_list_head != 0); // Free list should have all the blocks
+        // One dead run at the top of the heap: handed back to the top
+        assert_eq!(heap.next_alloc, 8);
+        assert_eq!(heap.free_lists.nonempty, 0);
+    }
+
+    /// `(offset, size)` of every free block, in address order.
+    fn free_blocks(heap: &Heap) -> Vec<(usize, usize)> {
+        let mut blocks = Vec::new();
+        let mut offset = 8;
+        while offset < heap.next_alloc {
+            let header = read_u64(&heap.memory, offset);
+            let size = if decode_free(header) {
+                let size = decode_free_size_bytes(header);
+                blocks.push((offset, size));
+                size
+            } else {
+                object_size_bytes_from_header(header)
+            };
+            offset += size;
+        }
+        blocks
+    }
+
+    #[test]
+    fn test_size_classes() {
+        assert_eq!(size_class(8), 0);
+        assert_eq!(size_class(512), EXACT_CLASSES - 1);
+        assert_eq!(size_class(520), EXACT_CLASSES);
+        assert_eq!(size_class(1023), EXACT_CLASSES);
+        assert_eq!(size_class(1024), EXACT_CLASSES + 1);
+        assert_eq!(size_class(usize::MAX & !7), FREE_CLASSES - 1);
+
+        assert_eq!(fit_class(24), size_class(24));
+        assert_eq!(fit_class(520), EXACT_CLASSES + 1);
+        assert_eq!(fit_class(1024), EXACT_CLASSES + 1);
+        assert_eq!(fit_class(1032), EXACT_CLASSES + 2);
+    }
+
+    #[test]
+    fn test_free_list_exact_class_reuse() {
+        let mut heap = Heap::new();
+        let keep1 = heap.alloc_slots(vec![Value::I64(0)]).unwrap();
+        let big = heap
+            .alloc_slots(vec![Value::I64(1), Value::I64(2), Value::I64(3)])
+            .unwrap();
+        let keep2 = heap.alloc_slots(vec![Value::I64(0)]).unwrap();
+        let small = heap.alloc_slots(vec![Value::I64(4)]).unwrap();
+        let keep3 = heap.alloc_slots(vec![Value::I64(0)]).unwrap();
+        let big_offset = big.offset();
+        let small_offset = small.offset();
+
+        heap.collect(&[Value::Ref(keep1), Value::Ref(keep2), Value::Ref(keep3)]);
+
+        // A 1-slot object comes from its own class, not a split of `big`
+        let r = heap.alloc_slots(vec![Value::I64(5)]).unwrap();
+        assert_eq!(r.offset(), small_offset);
+        let r = heap
+            .alloc_slots(vec![Value::I64(6), Value::I64(7), Value::I64(8)])
+            .unwrap();
+        assert_eq!(r.offset(), big_offset);
+        assert_eq!(heap.free_lists.nonempty, 0);
+    }
+
+    #[test]
+    fn test_eight_byte_blocks_reused() {
+        let mut heap = Heap::new();
+        let mut keep = Vec::new();
+        let mut empty = Vec::new();
+        for _ in 0..4 {
+            keep.push(Value::Ref(heap.alloc_slots(vec![Value::I64(0)]).unwrap()));
+            empty.push(heap.alloc_slots(vec![]).unwrap().offset());
+        }
+        keep.push(Value::Ref(heap.alloc_slots(vec![Value::I64(0)]).unwrap()));
+        let top = heap.next_alloc;
+
+        heap.collect(&keep);
+        assert_eq!(free_blocks(&heap).len(), 4);
+
+        let mut reused: Vec<usize> = (0..4)
+            .map(|_| heap.alloc_slots(vec![]).unwrap().offset())
+            .collect();
+        reused.sort_unstable();
+        assert_eq!(reused, empty);
+        assert_eq!(heap.next_alloc, top);
+        assert_eq!(heap.object_count(), 9);
+    }
+
+    #[test]
+    fn test_sweep_coalesces_dead_runs() {
+        let mut heap = Heap::new();
+        let keep1 = heap.alloc_slots(vec![Value::I64(0)]).unwrap();
+        let first = heap.alloc_slots(vec![Value::I64(1)]).unwrap().offset();
+        let _dead2 = heap
+            .alloc_slots(vec![Value::I64(2), Value::I64(3)])
+            .unwrap();
+        let _dead3 = heap.alloc_slots(vec![]).unwrap();
+        let keep2 = heap.alloc_slots(vec![Value::I64(0)]).unwrap();
+        let keep3 = heap.alloc_slots(vec![Value::I64(0)]).unwrap();
+        let top = heap.next_alloc;
+
+        heap.collect(&[Value::Ref(keep1), Value::Ref(keep2), Value::Ref(keep3)]);
+        // 24 + 40 + 8 bytes become one block
+        assert_eq!(free_blocks(&heap), vec![(first, 72)]);
+
+        // A later sweep merges a dead neighbour into the existing block
+        heap.collect(&[Value::Ref(keep1), Value::Ref(keep3)]);
+        assert_eq!(free_blocks(&heap), vec![(first, 96)]);
+
+        let r = heap.alloc_typed_array(11, ElemKind::I64).unwrap();
+        assert_eq!(r.offset(), first);
+        assert_eq!(heap.next_alloc, top);
+
+        // Dead space at the top of the heap goes back to the top
+        heap.collect(&[Value::Ref(keep1)]);
+        assert_eq!(heap.next_alloc, first);
+        assert!(free_blocks(&heap).is_empty());
+    }
+
+    #[test]
+    fn test_parallel_sweep_matches_sequential() {
+        let mut heap = Heap::new_with_config(None, false);
+        let mut roots = Vec::new();
+        let mut i = 0;
+        while heap.next_alloc < PARALLEL_SWEEP_MIN_BYTES + 64 * 1024 {
+            // Mixed sizes, including 8-byte objects
+            let r = heap
+                .alloc_slots(vec![Value::I64(i); i as usize % 19])
+                .unwrap();
+            if i % 3 == 0 || (i / 50) % 7 == 0 {
+                roots.push(Value::Ref(r));
+            }
+            i += 1;
+        }
+        // End with garbage so the final run lowers the top of the heap
+        for _ in 0..10 {
+            heap.alloc_slots(vec![Value::I64(0); 4]).unwrap();
+        }
+
+        heap.mark(&roots);
+        let hints = heap.sweep_hints.as_ref().unwrap();
+        assert!(hints.starts.iter().filter(|&&s| s != usize::MAX).count() >= 4);
+        let mut sequential = heap.snapshot();
+        sequential.sweep_with_threads(1);
+        heap.sweep_with_threads(4);
+
+        assert_eq!(heap.next_alloc, sequential.next_alloc);
+        assert_eq!(heap.bytes_allocated, sequential.bytes_allocated);
+        assert_eq!(heap.object_count(), roots.len());
+        assert_eq!(free_blocks(&heap), free_blocks(&sequential));
+        assert_eq!(heap.free_lists.nonempty, sequential.free_lists.nonempty);
+
+        // Every free block is reachable from its class list
+        let mut listed = Vec::new();
+        for class in 0..FREE_CLASSES {
+            let mut offset = heap.free_lists.heads[class];
+            let mut last = 0;
+            while offset != 0 {
+                let size = decode_free_size_bytes(read_u64(&heap.memory, offset));
+                assert_eq!(size_class(size), class);
+                listed.push((offset, size));
+                last = offset;
+                offset = FreeLists::next_of(&heap.memory, 0, offset, size);
+            }
+            assert_eq!(heap.free_lists.tails[class], last);
+        }
+        listed.sort_unstable();
+        assert_eq!(listed, free_blocks(&heap));
+
+        for r in &roots {
+            let r = r.as_ref().unwrap();
+            let obj = heap.get(r).unwrap();
+            assert!(obj.slots.iter().all(|v| *v == obj.slots[0]));
+        }
     }
 
     // =========================================================================
@@ -1630,6 +2958,35 @@ mod tests {
         }
     }
 
+    #[test]
+    fn test_soft_limit_lowers_gc_threshold() {
+        let mut heap = Heap::new_with_config(Some(64 * 1024), true);
+        assert_eq!(heap.soft_limit(), Some(48 * 1024));
+        assert_eq!(heap.gc_threshold(), 48 * 1024);
+
+        // An explicit soft limit above the hard limit is capped by it
+        heap.set_soft_limit(Some(1024 * 1024));
+        assert_eq!(heap.soft_limit(), Some(64 * 1024));
+        heap.set_soft_limit(Some(4096));
+        assert_eq!(heap.gc_threshold(), 4096);
+
+        let mut live = Vec::new();
+        while !heap.should_gc() {
+            live.push(Value::Ref(
+                heap.alloc_slots(vec![Value::I64(0); 8]).unwrap(),
+            ));
+        }
+        assert!(heap.bytes_allocated() >= 4096);
+        // Still below the soft limit after collecting: the threshold returns to it
+        live.truncate(4);
+        heap.collect(&live);
+        assert_eq!(heap.gc_threshold(), 4096);
+
+        // Past the hard limit allocation fails
+        let err = heap.alloc_slots(vec![Value::I64(0); 8192]).unwrap_err();
+        assert!(err.contains("heap limit exceeded"));
+    }
+
     #[test]
     fn test_mass_allocation_with_gc_threshold() {
         // Use a small heap with GC enabled to force GC during allocation
@@ -1939,4 +3296,84 @@ mod tests {
         // bytes_allocated should still be positive (two objects remain)
         assert!(after_gc_bytes > 0);
     }
+
+    #[test]
+    fn test_bulk_fill_copy_equal_find() {
+        let mut heap = Heap::new();
+        let a = heap.alloc_typed_array(6, ElemKind::I64).unwrap();
+        let b = heap.alloc_typed_array(6, ElemKind::I64).unwrap();
+        heap.fill_elems(a, 1, 4, Value::I64(7)).unwrap();
+        let read = |heap: &Heap, r| {
+            (0..6)
+                .map(|i| heap.read_typed(r, i).unwrap())
+                .collect::<Vec<_>>()
+        };
+        assert_eq!(read(&heap, a), [0, 7, 7, 7, 7, 0]);
+
+        heap.copy_elems(b, 2, a, 0, 4).unwrap();
+        assert_eq!(read(&heap, b), [0, 0, 0, 7, 7, 7]);
+        // Overlapping ranges copy as if through a temporary
+        heap.copy_elems(a, 0, a, 1, 5).unwrap();
+        assert_eq!(read(&heap, a), [7, 7, 7, 7, 0, 0]);
+
+        assert!(heap.elems_equal(a, 1, b, 3, 3).unwrap());
+        assert!(!heap.elems_equal(a, 0, b, 0, 6).unwrap());
+        assert_eq!(heap.find_elem(b, 0, 6, Value::I64(7)).unwrap(), Some(3));
+        assert_eq!(heap.find_elem(b, 4, 6, Value::I64(0)).unwrap(), None);
+        assert!(heap.fill_elems(a, 4, 3, Value::I64(1)).is_err());
+        // Empty ranges are in bounds
+        assert!(heap.copy_elems(a, 6, b, 6, 0).is_ok());
+    }
+
+    #[test]
+    fn test_bulk_find_byte_and_tagged() {
+        let mut heap = Heap::new();
+        let bytes = heap.alloc_byte_array(b"hello world").unwrap();
+        assert_eq!(
+            heap.find_elem(bytes, 0, 11, Value::I64(b'o' as i64))
+                .unwrap(),
+            Some(4)
+        );
+        assert_eq!(
+            heap.find_elem(bytes, 5, 11, Value::I64(b'o' as i64))
+                .unwrap(),
+            Some(7)
+        );
+        assert_eq!(heap.find_elem(bytes, 0, 11, Value::I64(300)).unwrap(), None);
+
+        let slots = heap
+            .alloc_slots(vec![Value::I64(1), Value::Bool(true), Value::I64(1)])
+            .unwrap();
+        // Tagged elements compare tag and payload
+        assert_eq!(
+            heap.find_elem(slots, 0, 3, Value::Bool(true)).unwrap(),
+            Some(1)
+        );
+        assert_eq!(heap.find_elem(slots, 1, 3, Value::I64(1)).unwrap(), Some(2));
+    }
+
+    #[test]
+    fn test_bulk_map_f64_typed_and_tagged() {
+        let mut heap = Heap::new();
+        let a = heap.alloc_typed_array(3, ElemKind::F64).unwrap();
+        let b = heap.alloc_typed_array(3, ElemKind::F64).unwrap();
+        for i in 0..3 {
+            heap.write_slot(a, i, Value::F64(i as f64 + 0.5)).unwrap();
+            heap.write_slot(b, i, Value::F64(2.0)).unwrap();
+        }
+        let dst = heap.alloc_typed_array(3, ElemKind::F64).unwrap();
+        heap.map_f64(BulkOp::MulF64, dst, a, b, None, 3).unwrap();
+        assert_eq!(heap.read_slot(dst, 2), Some(Value::F64(5.0)));
+
+        // Tagged float arrays take the element-by-element path
+        let tagged = heap
+            .alloc_slots(vec![Value::F64(1.0), Value::F64(1.0), Value::F64(1.0)])
+            .unwrap();
+        heap.map_f64(BulkOp::FmaF64, tagged, a, b, Some(tagged), 3)
+            .unwrap();
+        assert_eq!(heap.read_slot(tagged, 1), Some(Value::F64(4.0)));
+
+        let ints = heap.alloc_slots(vec![Value::I64(1); 3]).unwrap();
+        assert!(heap.map_f64(BulkOp::AddF64, dst, a, ints, None, 3).is_err());
+    }
 }
@@ -0,0 +1,248 @@
+//! Per-call-site inline caches for interface dispatch and indirect calls.
+//!
+//! `VtableLookup` walks the receiver's type_info for the interface's vtable,
+//! and `CallIndirect` / `CallDynamic` only learn their callee at run time.
+//! Each such op is a *site*: vtable lookups and calls are numbered
+//! separately, in code order, and the MicroOp converter records the number
+//! in the op. A site remembers the last few keys it saw and what they
+//! resolved to, so a repeated receiver skips the lookup. The call targets a
+//! site has seen also tell the JIT which direct calls to emit.
+
+use super::heap::GcRef;
+use super::ops::Op;
+use super::value::Value;
+
+/// Keys a site caches before it is megamorphic
+pub const MAX_ENTRIES: usize = 4;
+
+/// How many distinct keys a site has seen.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CacheState {
+    Uninitialized,
+    Monomorphic,
+    Polymorphic,
+    /// More than `MAX_ENTRIES` keys; later keys are not cached
+    Megamorphic,
+}
+
+/// A polymorphic inline cache of up to `MAX_ENTRIES` key/value pairs.
+#[derive(Debug, Clone, Copy)]
+pub struct InlineCache<K, V> {
+    entries: [Option<(K, V)>; MAX_ENTRIES],
+    len: u8,
+    megamorphic: bool,
+}
+
+impl<K: Copy + PartialEq, V: Copy> Default for InlineCache<K, V> {
+    fn default() -> Self {
+        Self {
+            entries: [None; MAX_ENTRIES],
+            len: 0,
+            megamorphic: false,
+        }
+    }
+}
+
+impl<K: Copy + PartialEq, V: Copy> InlineCache<K, V> {
+    pub fn get(&self, key: K) -> Option<V> {
+        self.entries[..self.len as usize]
+            .iter()
+            .flatten()
+            .find(|(k, _)| *k == key)
+            .map(|(_, v)| *v)
+    }
+
+    /// Record that `key` resolved to `value`. A full cache keeps its
+    /// entries and becomes megamorphic.
+    pub fn insert(&mut self, key: K, value: V) {
+        if self.get(key).is_some() {
+            return;
+        }
+        if self.len as usize == MAX_ENTRIES {
+            self.megamorphic = true;
+            return;
+        }
+        self.entries[self.len as usize] = Some((key, value));
+        self.len += 1;
+    }
+
+    pub fn state(&self) -> CacheState {
+        match (self.megamorphic, self.len) {
+            (true, _) => CacheState::Megamorphic,
+            (false, 0) => CacheState::Uninitialized,
+            (false, 1) => CacheState::Monomorphic,
+            (false, _) => CacheState::Polymorphic,
+        }
+    }
+
+    /// Cached keys, oldest first.
+    pub fn keys(&self) -> impl Iterator<Item = K> + '_ {
+        self.entries[..self.len as usize]
+            .iter()
+            .flatten()
+            .map(|(k, _)| *k)
+    }
+}
+
+/// Vtable lookup site: (type_info, iface_desc) → vtable ref or null.
+pub type VtableCache = InlineCache<(GcRef, GcRef), Value>;
+/// Call site: callee func_index.
+pub type CallCache = InlineCache<usize, ()>;
+
+/// Which site numbering an op takes part in.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum SiteKind {
+    Vtable,
+    Call,
+}
+
+impl SiteKind {
+    pub fn of(op: &Op) -> Option<Self> {
+        match op {
+            Op::VtableLookup => Some(SiteKind::Vtable),
+            Op::CallIndirect(_) | Op::CallDynamic(_) => Some(SiteKind::Call),
+            _ => None,
+        }
+    }
+}
+
+/// Number `code`'s sites: entry `pc` is the site index of `code[pc]`
+/// within its kind, or `u32::MAX` for other ops.
+pub fn number_sites(code: &[Op]) -> Vec<u32> {
+    let (mut vtables, mut calls) = (0, 0);
+    code.iter()
+        .map(|op| {
+            let counter = match SiteKind::of(op) {
+                Some(SiteKind::Vtable) => &mut vtables,
+                Some(SiteKind::Call) => &mut calls,
+                None => return u32::MAX,
+            };
+            *counter += 1;
+            *counter - 1
+        })
+        .collect()
+}
+
+/// The caches of one function's sites, grown on first use.
+#[derive(Debug, Default)]
+struct FunctionCaches {
+    /// Site index per op, for the stack interpreter (built on first use)
+    op_sites: Vec<u32>,
+    vtables: Vec<VtableCache>,
+    calls: Vec<CallCache>,
+}
+
+/// Inline caches of every function in a chunk.
+#[derive(Debug, Default)]
+pub struct InlineCaches {
+    /// Indexed by func_index + 1; main (`usize::MAX`) is entry 0
+    functions: Vec<FunctionCaches>,
+}
+
+impl InlineCaches {
+    pub fn clear(&mut self) {
+        self.functions.clear();
+    }
+
+    fn function(&mut self, func_index: usize) -> &mut FunctionCaches {
+        let slot = func_index.wrapping_add(1);
+        if self.functions.len() <= slot {
+            self.functions
+                .resize_with(slot + 1, FunctionCaches::default);
+        }
+        &mut self.functions[slot]
+    }
+
+    /// Site index of the op at `pc`, numbering `code` on first use. None if
+    /// that op is not a site.
+    pub fn op_site(&mut self, func_index: usize, pc: usize, code: &[Op]) -> Option<usize> {
+        let caches = self.function(func_index);
+        if caches.op_sites.is_empty() {
+            caches.op_sites = number_sites(code);
+        }
+        caches
+            .op_sites
+            .get(pc)
+            .filter(|&&site| site != u32::MAX)
+            .map(|&site| site as usize)
+    }
+
+    pub fn vtable(&mut self, func_index: usize, site: usize) -> &mut VtableCache {
+        let caches = self.function(func_index);
+        if caches.vtables.len() <= site {
+            caches.vtables.resize_with(site + 1, Default::default);
+        }
+        &mut caches.vtables[site]
+    }
+
+    pub fn call(&mut self, func_index: usize, site: usize) -> &mut CallCache {
+        let caches = self.function(func_index);
+        if caches.calls.len() <= site {
+            caches.calls.resize_with(site + 1, Default::default);
+        }
+        &mut caches.calls[site]
+    }
+
+    /// Callees seen by each call site of `func_index`, for the JIT. A
+    /// megamorphic or unvisited site has none.
+    pub fn call_targets(&self, func_index: usize) -> Vec<Vec<usize>> {
+        let Some(caches) = self.functions.get(func_index.wrapping_add(1)) else {
+            return Vec::new();
+        };
+        caches
+            .calls
+            .iter()
+            .map(|cache| match cache.state() {
+                CacheState::Megamorphic => Vec::new(),
+                _ => cache.keys().collect(),
+            })
+            .collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_cache_states() {
+        let mut cache = CallCache::default();
+        assert_eq!(cache.state(), CacheState::Uninitialized);
+        cache.insert(7, ());
+        cache.insert(7, ());
+        assert_eq!(cache.state(), CacheState::Monomorphic);
+        for target in 1..MAX_ENTRIES {
+            cache.insert(target, ());
+        }
+        assert_eq!(cache.state(), CacheState::Polymorphic);
+        cache.insert(99, ());
+        assert_eq!(cache.state(), CacheState::Megamorphic);
+        // Entries cached before the site went megamorphic still hit
+        assert!(cache.get(7).is_some());
+        assert!(cache.get(99).is_none());
+    }
+
+    #[test]
+    fn test_number_sites() {
+        let code = [
+            Op::CallDynamic(1),
+            Op::VtableLookup,
+            Op::Drop,
+            Op::CallIndirect(0),
+            Op::VtableLookup,
+        ];
+        assert_eq!(number_sites(&code), [0, 0, u32::MAX, 1, 1]);
+    }
+
+    #[test]
+    fn test_call_targets_skip_megamorphic_sites() {
+        let mut caches = InlineCaches::default();
+        caches.call(usize::MAX, 0).insert(3, ());
+        for target in 0..=MAX_ENTRIES {
+            caches.call(2, 1).insert(target, ());
+        }
+        assert_eq!(caches.call_targets(usize::MAX), [vec![3]]);
+        assert_eq!(caches.call_targets(2), [vec![], vec![]]);
+        assert!(caches.call_targets(5).is_empty());
+    }
+}
@@ -0,0 +1,449 @@
+//! File and socket descriptors of moca programs, and the readiness reactor
+//! green threads wait on.
+//!
+//! The descriptor table is shared by a VM and the threads it spawns, so a
+//! connection accepted on one thread can be served on another. Sockets are
+//! non-blocking: a hostcall that would block reports the fd and direction it
+//! is waiting for instead. The main thread then waits in poll(2), while a
+//! green thread registers an `IoWait` and yields to the scheduler until the
+//! fd is ready.
+//!
+//! On Linux the reactor is an epoll instance served by one background
+//! thread, which flags waiters as their fds become ready. On other Unix
+//! platforms a waiter polls its fd with a zero timeout each time it is
+//! scheduled.
+
+use std::collections::HashMap;
+use std::fs::File;
+use std::io;
+use std::net::{SocketAddrV4, TcpListener, TcpStream};
+use std::sync::Arc;
+
+#[cfg(unix)]
+pub use std::os::fd::RawFd;
+/// Descriptors are never waited on without Unix readiness APIs
+#[cfg(not(unix))]
+pub type RawFd = i64;
+
+/// Direction an fd is waited on.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Interest {
+    Read,
+    Write,
+}
+
+/// An open moca file descriptor (fd >= 3).
+///
+/// Handles are reference counted so I/O can run after the table lock is
+/// released; closing the fd drops the table's handle.
+#[derive(Clone)]
+pub enum Descriptor {
+    File(Arc<File>),
+    /// Connected TCP stream, non-blocking
+    Socket(Arc<TcpStream>),
+    /// TCP stream whose non-blocking connect has not finished yet
+    Connecting(Arc<TcpStream>),
+    /// Bound TCP listener, non-blocking
+    Listener(Arc<TcpListener>),
+    /// Created by socket() but not yet connected or bound
+    Unbound,
+}
+
+impl Descriptor {
+    /// The OS file descriptor, if there is one.
+    pub fn raw_fd(&self) -> Option<RawFd> {
+        #[cfg(unix)]
+        {
+            use std::os::fd::AsRawFd;
+            match self {
+                Descriptor::File(f) => Some(f.as_raw_fd()),
+                Descriptor::Socket(s) | Descriptor::Connecting(s) => Some(s.as_raw_fd()),
+                Descriptor::Listener(l) => Some(l.as_raw_fd()),
+                Descriptor::Unbound => None,
+            }
+        }
+        #[cfg(not(unix))]
+        None
+    }
+}
+
+/// The fd table of a VM and the threads it spawned.
+pub struct FdTable {
+    entries: HashMap<i64, Descriptor>,
+    next_fd: i64,
+}
+
+impl Default for FdTable {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl FdTable {
+    pub fn new() -> Self {
+        Self {
+            entries: HashMap::new(),
+            next_fd: 3, // fd 0, 1, 2 are reserved for stdin, stdout, stderr
+        }
+    }
+
+    /// Store a descriptor under the next free fd.
+    pub fn insert(&mut self, descriptor: Descriptor) -> i64 {
+        let fd = self.next_fd;
+        self.next_fd += 1;
+        self.entries.insert(fd, descriptor);
+        fd
+    }
+
+    pub fn get(&self, fd: i64) -> Option<Descriptor> {
+        self.entries.get(&fd).cloned()
+    }
+
+    /// Replace the descriptor of an open fd. Returns false if `fd` was closed.
+    pub fn replace(&mut self, fd: i64, descriptor: Descriptor) -> bool {
+        match self.entries.get_mut(&fd) {
+            Some(entry) => {
+                *entry = descriptor;
+                true
+            }
+            None => false,
+        }
+    }
+
+    pub fn remove(&mut self, fd: i64) -> Option<Descriptor> {
+        self.entries.remove(&fd)
+    }
+
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+}
+
+/// Start a non-blocking TCP connect to `addr`.
+///
+/// Returns the stream and whether it is already connected; otherwise the
+/// connect is finished by `finish_connect` once the stream is writable.
+#[cfg(unix)]
+pub fn start_connect(addr: SocketAddrV4) -> io::Result<(TcpStream, bool)> {
+    use std::os::fd::FromRawFd;
+
+    let fd = unsafe { libc::socket(libc::AF_INET, libc::SOCK_STREAM, 0) };
+    if fd < 0 {
+        return Err(io::Error::last_os_error());
+    }
+    // SAFETY: `fd` is a fresh socket owned by nobody else
+    let stream = unsafe { TcpStream::from_raw_fd(fd) };
+    unsafe {
+        libc::fcntl(fd, libc::F_SETFD, libc::FD_CLOEXEC);
+    }
+    stream.set_nonblocking(true)?;
+
+    // SAFETY: all-zero is a valid sockaddr_in
+    let mut sin: libc::sockaddr_in = unsafe { std::mem::zeroed() };
+    sin.sin_family = libc::AF_INET as libc::sa_family_t;
+    sin.sin_port = addr.port().to_be();
+    sin.sin_addr.s_addr = u32::from(*addr.ip()).to_be();
+    #[cfg(any(
+        target_os = "macos",
+        target_os = "ios",
+        target_os = "freebsd",
+        target_os = "openbsd",
+        target_os = "netbsd",
+        target_os = "dragonfly"
+    ))]
+    {
+        sin.sin_len = std::mem::size_of::<libc::sockaddr_in>() as u8;
+    }
+
+    let rc = unsafe {
+        libc::connect(
+            fd,
+            &sin as *const libc::sockaddr_in as *const libc::sockaddr,
+            std::mem::size_of::<libc::sockaddr_in>() as libc::socklen_t,
+        )
+    };
+    if rc == 0 {
+        return Ok((stream, true));
+    }
+    let err = io::Error::last_os_error();
+    match err.raw_os_error() {
+        // An interrupted connect keeps going in the background
+        Some(libc::EINPROGRESS) | Some(libc::EINTR) => Ok((stream, false)),
+        _ => Err(err),
+    }
+}
+
+/// Blocking connect where non-blocking sockets are not supported.
+#[cfg(not(unix))]
+pub fn start_connect(addr: SocketAddrV4) -> io::Result<(TcpStream, bool)> {
+    TcpStream::connect(addr).map(|stream| (stream, true))
+}
+
+/// Outcome of a connect started by `start_connect` once the stream is
+/// writable.
+pub fn finish_connect(stream: &TcpStream) -> io::Result<()> {
+    match stream.take_error()? {
+        Some(err) => Err(err),
+        None => Ok(()),
+    }
+}
+
+/// The OS file descriptor of a TCP stream.
+pub fn socket_fd(stream: &TcpStream) -> RawFd {
+    #[cfg(unix)]
+    {
+        use std::os::fd::AsRawFd;
+        stream.as_raw_fd()
+    }
+    #[cfg(not(unix))]
+    {
+        let _ = stream;
+        -1
+    }
+}
+
+/// Poll one fd, with `timeout_ms` as in poll(2). Errors and hangups count
+/// as ready: the retried call reports them.
+#[cfg(unix)]
+fn poll_fd(fd: RawFd, interest: Interest, timeout_ms: i32) -> bool {
+    let events = match interest {
+        Interest::Read => libc::POLLIN,
+        Interest::Write => libc::POLLOUT,
+    };
+    let mut pfd = libc::pollfd {
+        fd,
+        events,
+        revents: 0,
+    };
+    loop {
+        let rc = unsafe { libc::poll(&mut pfd, 1, timeout_ms) };
+        if rc >= 0 {
+            return rc > 0;
+        }
+        if io::Error::last_os_error().kind() != io::ErrorKind::Interrupted {
+            return true;
+        }
+    }
+}
+
+/// Whether `fd` is ready for `interest` right now.
+pub fn is_ready(fd: RawFd, interest: Interest) -> bool {
+    #[cfg(unix)]
+    {
+        poll_fd(fd, interest, 0)
+    }
+    #[cfg(not(unix))]
+    {
+        let _ = (fd, interest);
+        true
+    }
+}
+
+/// Block the calling OS thread until `fd` is ready for `interest`.
+pub fn wait(fd: RawFd, interest: Interest) {
+    #[cfg(unix)]
+    poll_fd(fd, interest, -1);
+    #[cfg(not(unix))]
+    let _ = (fd, interest);
+}
+
+/// A green thread's wait for an fd to become ready.
+pub struct IoWait {
+    fd: RawFd,
+    interest: Interest,
+    /// Set by the reactor thread
+    #[cfg(target_os = "linux")]
+    ready: Arc<std::sync::atomic::AtomicBool>,
+}
+
+impl IoWait {
+    pub fn register(fd: RawFd, interest: Interest) -> Self {
+        Self {
+            fd,
+            interest,
+            #[cfg(target_os = "linux")]
+            ready: reactor::Reactor::global().register(fd, interest),
+        }
+    }
+
+    /// Whether the fd became ready since `register`. A ready wait may still
+    /// be spurious; the caller retries the I/O and waits again if needed.
+    pub fn is_ready(&self) -> bool {
+        #[cfg(target_os = "linux")]
+        {
+            self.ready.load(std::sync::atomic::Ordering::Acquire)
+        }
+        #[cfg(not(target_os = "linux"))]
+        {
+            is_ready(self.fd, self.interest)
+        }
+    }
+
+    pub fn fd(&self) -> RawFd {
+        self.fd
+    }
+
+    pub fn interest(&self) -> Interest {
+        self.interest
+    }
+}
+
+#[cfg(target_os = "linux")]
+mod reactor {
+    use super::{Interest, RawFd};
+    use std::collections::HashMap;
+    use std::sync::atomic::{AtomicBool, Ordering};
+    use std::sync::{Arc, Mutex, OnceLock};
+
+    const MAX_EVENTS: usize = 64;
+
+    /// Waiters of one fd
+    type Waiters = Vec<(Interest, Arc<AtomicBool>)>;
+
+    /// A process-wide epoll instance. Fds are registered one-shot: the first
+    /// event wakes every waiter of the fd and disarms it until the next
+    /// `register`.
+    pub struct Reactor {
+        epfd: RawFd,
+        waiters: Mutex<HashMap<RawFd, Waiters>>,
+    }
+
+    impl Reactor {
+        pub fn global() -> &'static Reactor {
+            static GLOBAL: OnceLock<Reactor> = OnceLock::new();
+            static STARTED: OnceLock<()> = OnceLock::new();
+            let reactor = GLOBAL.get_or_init(|| Reactor {
+                epfd: unsafe { libc::epoll_create1(libc::EPOLL_CLOEXEC) },
+                waiters: Mutex::new(HashMap::new()),
+            });
+            STARTED.get_or_init(|| {
+                if reactor.epfd >= 0 {
+                    std::thread::Builder::new()
+                        .name("moca-reactor".to_string())
+                        .spawn(move || reactor.run())
+                        .expect("failed to spawn I/O reactor");
+                }
+            });
+            reactor
+        }
+
+        /// Arm `fd` for `interest` and return the flag the reactor sets once
+        /// it is ready.
+        pub fn register(&self, fd: RawFd, interest: Interest) -> Arc<AtomicBool> {
+            let flag = Arc::new(AtomicBool::new(false));
+            let mut waiters = self.waiters.lock().unwrap();
+            let entry = waiters.entry(fd).or_default();
+            entry.push((interest, flag.clone()));
+
+            let mut events = libc::EPOLLONESHOT as u32;
+            for (interest, _) in entry.iter() {
+                events |= match interest {
+                    Interest::Read => libc::EPOLLIN as u32,
+                    Interest::Write => libc::EPOLLOUT as u32,
+                };
+            }
+            let mut event = libc::epoll_event {
+                events,
+                u64: fd as u64,
+            };
+            let armed = self.epfd >= 0
+                && unsafe {
+                    libc::epoll_ctl(self.epfd, libc::EPOLL_CTL_MOD, fd, &mut event) == 0
+                        || libc::epoll_ctl(self.epfd, libc::EPOLL_CTL_ADD, fd, &mut event) == 0
+                };
+            if !armed {
+                // Not pollable (or no epoll): let the caller retry right away
+                waiters.remove(&fd);
+                flag.store(true, Ordering::Release);
+            }
+            flag
+        }
+
+        fn run(&self) {
+            let mut events = [libc::epoll_event { events: 0, u64: 0 }; MAX_EVENTS];
+            loop {
+                let n = unsafe {
+                    libc::epoll_wait(self.epfd, events.as_mut_ptr(), MAX_EVENTS as i32, -1)
+                };
+                if n < 0 {
+                    continue; // EINTR
+                }
+                let mut waiters = self.waiters.lock().unwrap();
+                for event in &events[..n as usize] {
+                    let fd = { event.u64 } as RawFd;
+                    for (_, flag) in waiters.remove(&fd).unwrap_or_default() {
+                        flag.store(true, Ordering::Release);
+                    }
+                }
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::io::{Read, Write};
+    use std::net::Ipv4Addr;
+
+    #[test]
+    fn test_fd_table_allocates_from_three() {
+        let mut table = FdTable::new();
+        assert_eq!(table.insert(Descriptor::Unbound), 3);
+        assert_eq!(table.insert(Descriptor::Unbound), 4);
+        assert!(table.remove(3).is_some());
+        assert!(!table.replace(3, Descriptor::Unbound));
+        assert_eq!(table.len(), 1);
+    }
+
+    #[test]
+    fn test_io_wait_wakes_when_socket_is_readable() {
+        let listener = TcpListener::bind("127.0.0.1:0").unwrap();
+        let addr = match listener.local_addr().unwrap() {
+            std::net::SocketAddr::V4(addr) => addr,
+            _ => unreachable!(),
+        };
+        let (stream, connected) = start_connect(addr).unwrap();
+        let (mut server, _) = listener.accept().unwrap();
+        if !connected {
+            wait(socket_fd(&stream), Interest::Write);
+        }
+        finish_connect(&stream).unwrap();
+
+        let fd = socket_fd(&stream);
+        let wait = IoWait::register(fd, Interest::Read);
+        assert!(!is_ready(fd, Interest::Read));
+        server.write_all(b"ping").unwrap();
+
+        let deadline = std::time::Instant::now() + std::time::Duration::from_secs(5);
+        while !wait.is_ready() {
+            assert!(std::time::Instant::now() < deadline, "reactor never woke");
+            std::thread::yield_now();
+        }
+        let mut buf = [0u8; 4];
+        (&stream).read_exact(&mut buf).unwrap();
+        assert_eq!(&buf, b"ping");
+    }
+
+    #[test]
+    fn test_connect_refused_reports_error() {
+        // Bind then drop a listener so the port is (almost certainly) closed
+        let port = TcpListener::bind("127.0.0.1:0")
+            .unwrap()
+            .local_addr()
+            .unwrap()
+            .port();
+        let addr = SocketAddrV4::new(Ipv4Addr::LOCALHOST, port);
+        let result = start_connect(addr).and_then(|(stream, connected)| {
+            if !connected {
+                wait(socket_fd(&stream), Interest::Write);
+            }
+            finish_connect(&stream)
+        });
+        assert_eq!(result.unwrap_err().kind(), io::ErrorKind::ConnectionRefused);
+    }
+}
@@ -0,0 +1,77 @@
+//! Runtime metrics and events.
+//!
+//! `VmMetrics` is a snapshot of counters the VM keeps anyway (GC pauses,
+//! heap growth, allocation totals, JIT compilations, channel traffic), so
+//! reading it costs nothing while the VM runs. Hosts that want to react as
+//! things happen install an event handler instead; without one, emitting an
+//! event is a `None` check.
+
+/// Counters of one VM, from `VM::metrics`.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct VmMetrics {
+    /// Major GC cycles
+    pub gc_cycles: u64,
+    /// Minor (nursery-only) collections
+    pub gc_minor_cycles: u64,
+    /// GC pauses; with incremental GC every step is one
+    pub gc_pauses: u64,
+    pub gc_pause_us: u64,
+    pub gc_max_pause_us: u64,
+    /// Upper bounds of the pause-time histogram buckets at p50 and p99
+    pub gc_pause_p50_us: u64,
+    pub gc_pause_p99_us: u64,
+    /// Size of the heap's linear memory
+    pub heap_bytes: usize,
+    /// Bytes of objects on the heap, including garbage not yet collected
+    pub heap_live_bytes: usize,
+    /// Bytes and objects allocated since the heap was created
+    pub allocated_bytes: u64,
+    pub allocated_objects: u64,
+    /// Functions and loops compiled to native code
+    pub jit_compiles: u64,
+    pub jit_failures: u64,
+    /// Failed type guards on entry to speculative loop code
+    pub jit_deopts: u64,
+    /// Machine code bytes compiled
+    pub jit_code_bytes: u64,
+    /// Values sent and received over this VM's channels
+    pub channel_sends: u64,
+    pub channel_receives: u64,
+}
+
+/// Execution tier of a function or loop.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u32)]
+pub enum Tier {
+    Interpreter = 0,
+    /// MicroOp JIT code
+    Baseline = 1,
+    /// JIT code specialized on type feedback, behind type guards
+    Optimized = 2,
+}
+
+/// Something the VM did, passed to the event handler.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum VmEvent<'a> {
+    /// A GC pause starts
+    GcStart { minor: bool },
+    /// A GC pause ends after `pause_ns`
+    GcEnd { minor: bool, pause_ns: u64 },
+    /// A function, or a loop in it, was compiled to `code_size` bytes
+    JitCompile {
+        name: &'a str,
+        is_loop: bool,
+        code_size: usize,
+    },
+    /// A function or loop now runs in `tier`
+    TierChange {
+        name: &'a str,
+        is_loop: bool,
+        tier: Tier,
+    },
+    /// The heap's linear memory grew to `heap_bytes`
+    HeapGrow { heap_bytes: usize },
+}
+
+/// Receives the events of one VM.
+pub type EventHandler = Box<dyn FnMut(&VmEvent) + Send>;
@@ -23,6 +23,21 @@ pub enum CmpCond {
     GeS,
 }
 
+impl CmpCond {
+    /// Whether `a <cond> b` holds.
+    #[inline]
+    pub fn holds<T: PartialOrd>(self, a: T, b: T) -> bool {
+        match self {
+            CmpCond::Eq => a == b,
+            CmpCond::Ne => a != b,
+            CmpCond::LtS => a < b,
+            CmpCond::LeS => a <= b,
+            CmpCond::GtS => a > b,
+            CmpCond::GeS => a >= b,
+        }
+    }
+}
+
 /// Register-based micro-operations.
 ///
 /// MicroOp PC is the single source of truth for control flow.
@@ -66,6 +81,8 @@ pub enum MicroOp {
         callee: VReg,
         args: Vec<VReg>,
         ret: Option<VReg>,
+        /// Call site index (see `inline_cache`)
+        site: usize,
     },
     /// Dynamic call by func_index in a vreg.
     /// func_idx vreg holds an i64 function index; args are passed directly.
@@ -73,6 +90,8 @@ pub enum MicroOp {
         func_idx: VReg,
         args: Vec<VReg>,
         ret: Option<VReg>,
+        /// Call site index (see `inline_cache`)
+        site: usize,
     },
 
     // ========================================
@@ -491,6 +510,13 @@ pub enum MicroOp {
         size: VReg,
         elem_kind: super::heap::ElemKind,
     },
+    /// Bulk typed-array op on `args` (see `BulkOp`).
+    /// dst = its result, for the ops that have one.
+    HeapBulk {
+        dst: Option<VReg>,
+        op: super::bulk::BulkOp,
+        args: Vec<VReg>,
+    },
     // ========================================
     // String operations
     // ========================================
@@ -512,6 +538,8 @@ pub enum MicroOp {
         dst: VReg,
         type_info: VReg,
         iface_desc: VReg,
+        /// Vtable site index (see `inline_cache`)
+        site: usize,
     },
     // ========================================
     // Stack Bridge (for Raw op interop)
@@ -525,6 +553,59 @@ pub enum MicroOp {
         dst: VReg,
     },
 
+    // ========================================
+    // Superinstructions (interpreter only)
+    // ========================================
+    // Fused by `superinstructions::fuse` from the pair of micro-ops in the
+    // name, with the effects of both. The second op keeps its slot, so pcs
+    // stay put; fallthrough skips over it. Never given to the JIT.
+    /// CmpI64 into dst, then BrIfFalse on dst.
+    CmpI64BrIfFalse {
+        dst: VReg,
+        a: VReg,
+        b: VReg,
+        cond: CmpCond,
+        target: usize,
+    },
+    /// CmpI64Imm into dst, then BrIfFalse on dst.
+    CmpI64ImmBrIfFalse {
+        dst: VReg,
+        a: VReg,
+        imm: i64,
+        cond: CmpCond,
+        target: usize,
+    },
+    /// CmpF64 into dst, then BrIfFalse on dst.
+    CmpF64BrIfFalse {
+        dst: VReg,
+        a: VReg,
+        b: VReg,
+        cond: CmpCond,
+        target: usize,
+    },
+    /// tmp = a * b, then dst = tmp + c. Operands are f64.
+    MulF64AddF64 {
+        tmp: VReg,
+        a: VReg,
+        b: VReg,
+        c: VReg,
+        dst: VReg,
+    },
+    /// tmp = imm, then dst = a * tmp.
+    ConstF64MulF64 {
+        tmp: VReg,
+        imm: f64,
+        dst: VReg,
+        a: VReg,
+    },
+    /// tmp = imm, then dst = a / tmp.
+    ConstF64DivF64 {
+        tmp: VReg,
+        imm: f64,
+        dst: VReg,
+        a: VReg,
+    },
+
     // ========================================
     // Fallback
     // ========================================
@@ -535,6 +616,134 @@ pub enum MicroOp {
     },
 }
 
+impl MicroOp {
+    /// Returns the name of the micro-op for profiling purposes; a Raw op
+    /// goes by the name of the Op it wraps.
+    pub fn name(&self) -> &'static str {
+        match self {
+            MicroOp::Jmp { .. } => "Jmp",
+            MicroOp::BrIf { .. } => "BrIf",
+            MicroOp::BrIfFalse { .. } => "BrIfFalse",
+            MicroOp::Call { .. } => "Call",
+            MicroOp::Ret { .. } => "Ret",
+            MicroOp::CallIndirect { .. } => "CallIndirect",
+            MicroOp::CallDynamic { .. } => "CallDynamic",
+            MicroOp::Mov { .. } => "Mov",
+            MicroOp::ConstI64 { .. } => "ConstI64",
+            MicroOp::ConstI32 { .. } => "ConstI32",
+            MicroOp::ConstF64 { .. } => "ConstF64",
+            MicroOp::ConstF32 { .. } => "ConstF32",
+            MicroOp::AddI64 { .. } => "AddI64",
+            MicroOp::AddI64Imm { .. } => "AddI64Imm",
+            MicroOp::SubI64 { .. } => "SubI64",
+            MicroOp::MulI64 { .. } => "MulI64",
+            MicroOp::DivI64 { .. } => "DivI64",
+            MicroOp::RemI64 { .. } => "RemI64",
+            MicroOp::NegI64 { .. } => "NegI64",
+            MicroOp::AndI64 { .. } => "AndI64",
+            MicroOp::OrI64 { .. } => "OrI64",
+            MicroOp::XorI64 { .. } => "XorI64",
+            MicroOp::ShlI64 { .. } => "ShlI64",
+            MicroOp::ShlI64Imm { .. } => "ShlI64Imm",
+            MicroOp::ShrI64 { .. } => "ShrI64",
+            MicroOp::ShrI64Imm { .. } => "ShrI64Imm",
+            MicroOp::ShrU64 { .. } => "ShrU64",
+            MicroOp::ShrU64Imm { .. } => "ShrU64Imm",
+            MicroOp::UMul128Hi { .. } => "UMul128Hi",
+            MicroOp::AddI32 { .. } => "AddI32",
+            MicroOp::SubI32 { .. } => "SubI32",
+            MicroOp::MulI32 { .. } => "MulI32",
+            MicroOp::DivI32 { .. } => "DivI32",
+            MicroOp::RemI32 { .. } => "RemI32",
+            MicroOp::EqzI32 { .. } => "EqzI32",
+            MicroOp::AddF64 { .. } => "AddF64",
+            MicroOp::SubF64 { .. } => "SubF64",
+            MicroOp::MulF64 { .. } => "MulF64",
+            MicroOp::DivF64 { .. } => "DivF64",
+            MicroOp::NegF64 { .. } => "NegF64",
+            MicroOp::AddF32 { .. } => "AddF32",
+            MicroOp::SubF32 { .. } => "SubF32",
+            MicroOp::MulF32 { .. } => "MulF32",
+            MicroOp::DivF32 { .. } => "DivF32",
+            MicroOp::NegF32 { .. } => "NegF32",
+            MicroOp::CmpI64 { .. } => "CmpI64",
+            MicroOp::CmpI64Imm { .. } => "CmpI64Imm",
+            MicroOp::CmpI32 { .. } => "CmpI32",
+            MicroOp::CmpF64 { .. } => "CmpF64",
+            MicroOp::CmpF32 { .. } => "CmpF32",
+            MicroOp::I32WrapI64 { .. } => "I32WrapI64",
+            MicroOp::I64ExtendI32S { .. } => "I64ExtendI32S",
+            MicroOp::I64ExtendI32U { .. } => "I64ExtendI32U",
+            MicroOp::F64ConvertI64S { .. } => "F64ConvertI64S",
+            MicroOp::I64TruncF64S { .. } => "I64TruncF64S",
+            MicroOp::F64ConvertI32S { .. } => "F64ConvertI32S",
+            MicroOp::F32ConvertI32S { .. } => "F32ConvertI32S",
+            MicroOp::F32ConvertI64S { .. } => "F32ConvertI64S",
+            MicroOp::I32TruncF32S { .. } => "I32TruncF32S",
+            MicroOp::I32TruncF64S { .. } => "I32TruncF64S",
+            MicroOp::I64TruncF32S { .. } => "I64TruncF32S",
+            MicroOp::F32DemoteF64 { .. } => "F32DemoteF64",
+            MicroOp::F64PromoteF32 { .. } => "F64PromoteF32",
+            MicroOp::F64ReinterpretAsI64 { .. } => "F64ReinterpretAsI64",
+            MicroOp::RefEq { .. } => "RefEq",
+            MicroOp::RefIsNull { .. } => "RefIsNull",
+            MicroOp::RefNull { .. } => "RefNull",
+            MicroOp::HeapLoad { .. } => "HeapLoad",
+            MicroOp::HeapLoadDyn { .. } => "HeapLoadDyn",
+            MicroOp::HeapStore { .. } => "HeapStore",
+            MicroOp::HeapStoreDyn { .. } => "HeapStoreDyn",
+            MicroOp::HeapLoad2 { .. } => "HeapLoad2",
+            MicroOp::HeapStore2 { .. } => "HeapStore2",
+            MicroOp::HeapOffsetRef { .. } => "HeapOffsetRef",
+            MicroOp::HeapAlloc { .. } => "HeapAlloc",
+            MicroOp::HeapAllocDynSimple { .. } => "HeapAllocDynSimple",
+            MicroOp::HeapBulk { .. } => "HeapBulk",
+            MicroOp::StringConst { .. } => "StringConst",
+            MicroOp::GlobalGet { .. } => "GlobalGet",
+            MicroOp::VtableLookup { .. } => "VtableLookup",
+            MicroOp::StackPush { .. } => "StackPush",
+            MicroOp::StackPop { .. } => "StackPop",
+            MicroOp::CmpI64BrIfFalse { .. } => "CmpI64BrIfFalse",
+            MicroOp::CmpI64ImmBrIfFalse { .. } => "CmpI64ImmBrIfFalse",
+            MicroOp::CmpF64BrIfFalse { .. } => "CmpF64BrIfFalse",
+            MicroOp::MulF64AddF64 { .. } => "MulF64AddF64",
+            MicroOp::ConstF64MulF64 { .. } => "ConstF64MulF64",
+            MicroOp::ConstF64DivF64 { .. } => "ConstF64DivF64",
+            MicroOp::Raw { op } => op.name(),
+        }
+    }
+
+    /// Whether the op only reads and writes registers (and maybe branches
+    /// forward or back within the function). Such an op cannot allocate,
+    /// call or yield, so the interpreter does not poll for GC before it.
+    pub fn is_register_only(&self) -> bool {
+        !matches!(
+            self,
+            MicroOp::Jmp { .. }
+                | MicroOp::Call { .. }
+                | MicroOp::Ret { .. }
+                | MicroOp::CallIndirect { .. }
+                | MicroOp::CallDynamic { .. }
+                | MicroOp::HeapLoad { .. }
+                | MicroOp::HeapLoadDyn { .. }
+                | MicroOp::HeapStore { .. }
+                | MicroOp::HeapStoreDyn { .. }
+                | MicroOp::HeapLoad2 { .. }
+                | MicroOp::HeapStore2 { .. }
+                | MicroOp::HeapOffsetRef { .. }
+                | MicroOp::HeapAlloc { .. }
+                | MicroOp::HeapAllocDynSimple { .. }
+                | MicroOp::HeapBulk { .. }
+                | MicroOp::StringConst { .. }
+                | MicroOp::GlobalGet { .. }
+                | MicroOp::VtableLookup { .. }
+                | MicroOp::StackPush { .. }
+                | MicroOp::StackPop { .. }
+                | MicroOp::Raw { .. }
+        )
+    }
+}
+
 /// Result of converting a function's Op[] bytecode to MicroOp[].
 #[derive(Debug, Clone)]
 pub struct ConvertedFunction {
@@ -542,6 +751,8 @@ pub struct ConvertedFunction {
     pub micro_ops: Vec<MicroOp>,
     /// Number of temporary registers beyond locals_count.
     pub temps_count: usize,
+    /// Number of leading vregs the caller fills with arguments.
+    pub arity: usize,
     /// old Op PC → new MicroOp PC mapping (length = original code.len() + 1).
     /// Used to translate JIT loop exit PCs back to MicroOp space.
     pub pc_map: Vec<usize>,
@@ -1,5 +1,6 @@
 use std::collections::HashSet;
 
+use super::inline_cache;
 use super::microop::{CmpCond, ConvertedFunction, MicroOp, VReg};
 use super::ops::Op;
 use super::{Function, ValueType};
@@ -42,6 +43,7 @@ pub fn convert(func: &Function) -> ConvertedFunction {
     let mut vstack: Vec<Vse> = Vec::new();
     let mut next_temp = locals_count;
     let mut max_temp = locals_count;
+    let sites = inline_cache::number_sites(code);
 
     // vreg_types: starts with local types, extended as temps are allocated.
     // Locals come from func.local_types; pad with I64 if local_types is shorter.
@@ -1668,6 +1670,7 @@ pub fn convert(func: &Function) -> ConvertedFunction {
                     callee,
                     args,
                     ret: Some(ret),
+                    site: sites[old_pc] as usize,
                 });
                 vstack.push(Vse::Reg(ret));
             }
@@ -1708,6 +1711,7 @@ pub fn convert(func: &Function) -> ConvertedFunction {
                     func_idx,
                     args,
                     ret: Some(ret),
+                    site: sites[old_pc] as usize,
                 });
                 vstack.push(Vse::Reg(ret));
             }
@@ -1760,6 +1764,7 @@ pub fn convert(func: &Function) -> ConvertedFunction {
                     dst,
                     type_info,
                     iface_desc,
+                    site: sites[old_pc] as usize,
                 });
                 vstack.push(Vse::RegRef(dst));
             }
@@ -1834,6 +1839,32 @@ pub fn convert(func: &Function) -> ConvertedFunction {
                 });
                 vstack.push(Vse::RegRef(dst));
             }
+            Op::HeapBulk(op) => {
+                let mut args = Vec::with_capacity(op.arity());
+                for _ in 0..op.arity() {
+                    let v = pop_vreg(
+                        &mut vstack,
+                        &mut micro_ops,
+                        &mut next_temp,
+                        &mut max_temp,
+                        &mut vreg_types,
+                    );
+                    args.push(v);
+                }
+                args.reverse();
+                let dst = op.has_result().then(|| {
+                    alloc_temp(
+                        &mut next_temp,
+                        &mut max_temp,
+                        &mut vreg_types,
+                        ValueType::I64,
+                    )
+                });
+                micro_ops.push(MicroOp::HeapBulk { dst, op: *op, args });
+                if let Some(dst) = dst {
+                    vstack.push(Vse::Reg(dst));
+                }
+            }
             // ============================================================
             // Raw fallback (everything else)
             // ============================================================
@@ -1884,6 +1915,7 @@ pub fn convert(func: &Function) -> ConvertedFunction {
     ConvertedFunction {
         micro_ops,
         temps_count: temps_count.max(1),
+        arity: func.arity,
         pc_map,
         vreg_types,
     }
@@ -1909,7 +1941,9 @@ fn extract_vregs(mop: &MicroOp) -> Vec<usize> {
                 vregs.push(s.0);
             }
         }
-        MicroOp::CallIndirect { callee, args, ret } => {
+        MicroOp::CallIndirect {
+            callee, args, ret, ..
+        } => {
             vregs.push(callee.0);
             for a in args {
                 vregs.push(a.0);
@@ -1922,6 +1956,7 @@ fn extract_vregs(mop: &MicroOp) -> Vec<usize> {
             func_idx,
             args,
             ret,
+            ..
         } => {
             vregs.push(func_idx.0);
             for a in args {
@@ -2085,12 +2120,17 @@ fn extract_vregs(mop: &MicroOp) -> Vec<usize> {
             vregs.push(dst.0);
             vregs.push(size.0);
         }
+        MicroOp::HeapBulk { dst, args, .. } => {
+            vregs.extend(dst.map(|d| d.0));
+            vregs.extend(args.iter().map(|a| a.0));
+        }
         MicroOp::StringConst { dst, .. } => vregs.push(dst.0),
         MicroOp::GlobalGet { dst, .. } => vregs.push(dst.0),
         MicroOp::VtableLookup {
             dst,
             type_info,
             iface_desc,
+            ..
         } => {
             vregs.push(dst.0);
             vregs.push(type_info.0);
@@ -2098,6 +2138,22 @@ fn extract_vregs(mop: &MicroOp) -> Vec<usize> {
         }
         MicroOp::StackPush { src } => vregs.push(src.0),
         MicroOp::StackPop { dst } => vregs.push(dst.0),
+        MicroOp::CmpI64BrIfFalse { dst, a, b, .. } | MicroOp::CmpF64BrIfFalse { dst, a, b, .. } => {
+            vregs.push(dst.0);
+            vregs.push(a.0);
+            vregs.push(b.0);
+        }
+        MicroOp::CmpI64ImmBrIfFalse { dst, a, .. } => {
+            vregs.push(dst.0);
+            vregs.push(a.0);
+        }
+        MicroOp::MulF64AddF64 { tmp, a, b, c, dst } => {
+            vregs.extend([tmp.0, a.0, b.0, c.0, dst.0]);
+        }
+        MicroOp::ConstF64MulF64 { tmp, dst, a, .. }
+        | MicroOp::ConstF64DivF64 { tmp, dst, a, .. } => {
+            vregs.extend([tmp.0, dst.0, a.0]);
+        }
         MicroOp::Raw { .. } => {} // Can't check Raw ops
     }
     vregs
@@ -2415,7 +2471,7 @@ mod tests {
             name: "test".to_string(),
             arity: 0,
             locals_count: 2,
-            code,
+            code: code.into(),
             stackmap: None,
             local_types: vec![],
         }
@@ -2700,7 +2756,8 @@ mod tests {
                 Op::LocalGet(1),
                 Op::I64Add,
                 Op::LocalSet(2),
-            ],
+            ]
+            .into(),
             stackmap: None,
             local_types: vec![ValueType::I64, ValueType::I64, ValueType::I64],
         };
@@ -2718,7 +2775,7 @@ mod tests {
             name: "test".to_string(),
             arity: 0,
             locals_count: 1,
-            code: vec![Op::F64Const(3.14), Op::LocalSet(0)],
+            code: vec![Op::F64Const(3.14), Op::LocalSet(0)].into(),
             stackmap: None,
             local_types: vec![ValueType::F64],
         };
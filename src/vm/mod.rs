@@ -1,20 +1,32 @@
 // Some fields are stored for future use
 #![allow(dead_code)]
 
+pub mod bulk;
 pub mod bytecode;
+mod code;
 pub mod concurrent_gc;
 pub mod debug;
+pub mod fnv;
 mod heap;
+pub mod inline_cache;
+pub mod io;
+pub mod metrics;
 pub mod microop;
 pub mod microop_converter;
 mod ops;
+pub mod output;
+pub mod profiler;
+pub mod scheduler;
 pub mod stackmap;
+pub mod superinstructions;
 pub mod threads;
+pub mod tiering;
 mod value;
 pub mod verifier;
 #[allow(clippy::module_inception)]
 mod vm;
 
+pub use code::{BytecodeSource, Code, StringPool};
 pub use debug::{DebugInfo, FunctionDebugInfo};
 pub use heap::{ElemKind, GcRef, Heap};
 pub use ops::Op;
@@ -28,7 +40,7 @@ pub use verifier::{Verifier, VerifyError};
 // OpcodeProfile exported for external profiling tools
 #[allow(unused_imports)]
 pub use vm::OpcodeProfile;
-pub use vm::VM;
+pub use vm::{VM, VmSnapshot};
 
 /// VM-level value type for the typed bytecode architecture.
 ///
@@ -54,7 +66,8 @@ pub struct Function {
     pub name: String,
     pub arity: usize,
     pub locals_count: usize,
-    pub code: Vec<Op>,
+    /// Function body (decoded on first access for lazily loaded chunks)
+    pub code: Code,
     /// StackMap for GC safepoints (optional, generated by compiler)
     pub stackmap: Option<FunctionStackMap>,
     /// Type information for local variables (indexed by slot number).
@@ -95,7 +108,7 @@ pub struct Chunk {
     pub functions: Vec<Function>,
     pub main: Function,
     /// String constants pool
-    pub strings: Vec<String>,
+    pub strings: StringPool,
     /// Type descriptor table for dyn type info
     pub type_descriptors: Vec<TypeDescriptor>,
     /// Interface descriptor table for runtime interface dispatch
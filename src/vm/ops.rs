@@ -172,6 +172,9 @@ pub enum Op {
     HeapStore2(super::heap::ElemKind),
     /// Offset a reference: pop offset, pop ref → push ref with slot_offset += offset
     HeapOffsetRef,
+    /// Bulk typed-array op: pops the op's operands (see `BulkOp`), pushes
+    /// its result if it has one
+    HeapBulk(super::bulk::BulkOp),
 
     // ========================================
     // System / Builtins
@@ -203,8 +206,16 @@ pub enum Op {
     // ========================================
     ThreadSpawn(usize),
     ChannelCreate,
+    /// Create a channel buffering at least `capacity` values. Pops capacity.
+    ChannelCreateBounded,
     ChannelSend,
     ChannelRecv,
+    /// Send `data[0..count]` in order. Pops count, data ref, then channel.
+    ChannelSendMany,
+    /// Receive up to `max` values into `data[0..]`, blocking until at least
+    /// one is available, and push how many were received (0 once the
+    /// channel is closed and drained). Pops max, data ref, then channel.
+    ChannelRecvMany,
     ThreadJoin,
 
     // ========================================
@@ -333,6 +344,7 @@ impl Op {
             Op::HeapLoad2(_) => "HeapLoad2",
             Op::HeapStore2(_) => "HeapStore2",
             Op::HeapOffsetRef => "HeapOffsetRef",
+            Op::HeapBulk(_) => "HeapBulk",
             Op::Hostcall(_, _) => "Hostcall",
             Op::GcHint(_) => "GcHint",
             Op::UMul128Hi => "UMul128Hi",
@@ -346,8 +358,11 @@ impl Op {
             Op::Args => "Args",
             Op::ThreadSpawn(_) => "ThreadSpawn",
             Op::ChannelCreate => "ChannelCreate",
+            Op::ChannelCreateBounded => "ChannelCreateBounded",
             Op::ChannelSend => "ChannelSend",
             Op::ChannelRecv => "ChannelRecv",
+            Op::ChannelSendMany => "ChannelSendMany",
+            Op::ChannelRecvMany => "ChannelRecvMany",
             Op::ThreadJoin => "ThreadJoin",
             Op::CallIndirect(_) => "CallIndirect",
             Op::CallDynamic(_) => "CallDynamic",
@@ -0,0 +1,334 @@
+//! Buffered output for the write hostcall.
+//!
+//! `print` and friends reach the host one `HOSTCALL_WRITE` at a time, often
+//! a few bytes each. `OutputBuffer` collects stdout/stderr writes and hands
+//! them to the underlying stream per line, per block or not at all.
+//! `PendingWrites` does the same for files and sockets: consecutive writes
+//! to one fd are queued and go out as a single vectored write.
+
+use std::fs::File;
+use std::io::{self, IoSlice, IsTerminal, Write};
+use std::net::TcpStream;
+use std::sync::Arc;
+
+use super::io::{self as vm_io, Interest};
+
+/// Size at which a buffer is flushed regardless of mode
+pub const BLOCK_SIZE: usize = 64 * 1024;
+/// Most buffers passed to one vectored write (POSIX guarantees 16, Linux
+/// and the BSDs allow 1024)
+const MAX_IOVECS: usize = 1024;
+
+/// When an `OutputBuffer` passes its bytes on.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum BufferMode {
+    /// Every write goes straight to the stream
+    Unbuffered,
+    /// Flush after each write that contains a newline
+    Line,
+    /// Flush when `BLOCK_SIZE` bytes have collected
+    Block,
+}
+
+impl BufferMode {
+    /// Line buffering for a terminal, block buffering otherwise, as C stdio
+    /// does for stdout.
+    pub fn for_stdout() -> Self {
+        if io::stdout().is_terminal() {
+            BufferMode::Line
+        } else {
+            BufferMode::Block
+        }
+    }
+}
+
+/// A buffered output stream. Buffered bytes are written on `flush`, when
+/// the mode is changed or the stream replaced, and on drop.
+pub struct OutputBuffer {
+    inner: Box<dyn Write + Send>,
+    buf: Vec<u8>,
+    mode: BufferMode,
+    /// Bytes were passed to `inner` since it was last flushed
+    dirty: bool,
+}
+
+impl OutputBuffer {
+    pub fn new(inner: Box<dyn Write + Send>, mode: BufferMode) -> Self {
+        Self {
+            inner,
+            buf: Vec::new(),
+            mode,
+            dirty: false,
+        }
+    }
+
+    pub fn mode(&self) -> BufferMode {
+        self.mode
+    }
+
+    pub fn set_mode(&mut self, mode: BufferMode) -> io::Result<()> {
+        self.flush()?;
+        self.mode = mode;
+        Ok(())
+    }
+
+    /// Send further output to `inner`, after flushing what is buffered to
+    /// the old stream.
+    pub fn set_inner(&mut self, inner: Box<dyn Write + Send>) -> io::Result<()> {
+        let flushed = self.flush();
+        self.inner = inner;
+        flushed
+    }
+
+    /// Bytes waiting to be written.
+    pub fn buffered(&self) -> usize {
+        self.buf.len()
+    }
+
+    fn flush_buf(&mut self) -> io::Result<()> {
+        if self.buf.is_empty() {
+            return Ok(());
+        }
+        self.dirty = true;
+        let result = self.inner.write_all(&self.buf);
+        self.buf.clear();
+        result
+    }
+
+    fn flush_inner(&mut self) -> io::Result<()> {
+        if !self.dirty {
+            return Ok(());
+        }
+        self.dirty = false;
+        self.inner.flush()
+    }
+}
+
+impl Write for OutputBuffer {
+    fn write(&mut self, data: &[u8]) -> io::Result<usize> {
+        self.write_all(data)?;
+        Ok(data.len())
+    }
+
+    fn write_all(&mut self, data: &[u8]) -> io::Result<()> {
+        if self.mode == BufferMode::Unbuffered {
+            // `inner` may buffer itself (`io::Stdout` is line buffered)
+            self.inner.write_all(data)?;
+            return self.inner.flush();
+        }
+        if self.buf.len() + data.len() > BLOCK_SIZE {
+            self.flush_buf()?;
+        }
+        if data.len() >= BLOCK_SIZE {
+            self.dirty = true;
+            self.inner.write_all(data)?;
+        } else {
+            self.buf.extend_from_slice(data);
+        }
+        if self.mode == BufferMode::Line && data.contains(&b'\n') {
+            self.flush()?;
+        }
+        Ok(())
+    }
+
+    /// Cheap when nothing was written since the last flush.
+    fn flush(&mut self) -> io::Result<()> {
+        self.flush_buf()?;
+        self.flush_inner()
+    }
+}
+
+impl Drop for OutputBuffer {
+    fn drop(&mut self) {
+        let _ = self.flush();
+    }
+}
+
+/// Where queued writes go.
+#[derive(Clone)]
+pub enum WriteTarget {
+    File(Arc<File>),
+    Socket(Arc<TcpStream>),
+}
+
+/// Writes to one file or socket fd, queued so consecutive writes leave as
+/// one vectored write.
+///
+/// The VM sends the queue when the program does anything else with I/O:
+/// writes to another fd, any other hostcall (so a read or close of the fd
+/// always sees the data sent), channel and join ops, and yields. A send
+/// that fails there is reported by the next write to the same fd.
+#[derive(Default)]
+pub struct PendingWrites {
+    target: Option<(i64, WriteTarget)>,
+    chunks: Vec<Vec<u8>>,
+    bytes: usize,
+    /// The fd whose last deferred send failed
+    failed_fd: Option<i64>,
+}
+
+impl PendingWrites {
+    /// The fd with queued writes, if any.
+    pub fn fd(&self) -> Option<i64> {
+        self.target.as_ref().map(|(fd, _)| *fd)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.target.is_none()
+    }
+
+    /// Queue `data` for `fd`, sending queued writes for any other fd first.
+    pub fn push(&mut self, fd: i64, target: WriteTarget, data: Vec<u8>) -> io::Result<()> {
+        if self.failed_fd.take_if(|failed| *failed == fd).is_some() {
+            return Err(io::ErrorKind::BrokenPipe.into());
+        }
+        if self.fd().is_some_and(|pending| pending != fd) {
+            self.flush()?;
+        }
+        if self.target.is_none() {
+            self.target = Some((fd, target));
+        }
+        self.bytes += data.len();
+        self.chunks.push(data);
+        if self.chunks.len() >= MAX_IOVECS || self.bytes >= BLOCK_SIZE {
+            self.flush()?;
+        }
+        Ok(())
+    }
+
+    /// Forget a failed send to `fd` once it is closed, so the fd number can
+    /// be reused.
+    pub fn closed(&mut self, fd: i64) {
+        self.failed_fd.take_if(|failed| *failed == fd);
+    }
+
+    /// Send everything queued. A full socket send buffer blocks until it
+    /// drains.
+    pub fn flush(&mut self) -> io::Result<()> {
+        let Some((fd, target)) = self.target.take() else {
+            return Ok(());
+        };
+        let chunks = std::mem::take(&mut self.chunks);
+        self.bytes = 0;
+        let result = match &target {
+            WriteTarget::File(file) => write_all_vectored(&mut &**file, &chunks, None),
+            WriteTarget::Socket(socket) => {
+                write_all_vectored(&mut &**socket, &chunks, Some(vm_io::socket_fd(socket)))
+            }
+        };
+        // Keep the allocation for the next burst
+        self.chunks = chunks;
+        self.chunks.clear();
+        if result.is_err() {
+            self.failed_fd = Some(fd);
+        }
+        result
+    }
+}
+
+impl Drop for PendingWrites {
+    fn drop(&mut self) {
+        let _ = self.flush();
+    }
+}
+
+/// Write all `chunks` with as few vectored writes as possible. `wait_fd`
+/// is the fd to wait on when a non-blocking stream is full.
+fn write_all_vectored(
+    stream: &mut impl Write,
+    chunks: &[Vec<u8>],
+    wait_fd: Option<vm_io::RawFd>,
+) -> io::Result<()> {
+    let mut slices: Vec<IoSlice> = chunks
+        .iter()
+        .filter(|c| !c.is_empty())
+        .map(|c| IoSlice::new(c))
+        .collect();
+    let mut slices = &mut slices[..];
+    while !slices.is_empty() {
+        match stream.write_vectored(slices) {
+            Ok(0) => return Err(io::ErrorKind::WriteZero.into()),
+            Ok(n) => IoSlice::advance_slices(&mut slices, n),
+            Err(e) if e.kind() == io::ErrorKind::WouldBlock => match wait_fd {
+                Some(fd) => vm_io::wait(fd, Interest::Write),
+                None => return Err(e),
+            },
+            Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
+            Err(e) => return Err(e),
+        }
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::io::Read;
+    use std::sync::Mutex;
+
+    /// Records each write it receives.
+    #[derive(Clone, Default)]
+    struct Recorder(Arc<Mutex<Vec<Vec<u8>>>>);
+
+    impl Write for Recorder {
+        fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+            self.0.lock().unwrap().push(buf.to_vec());
+            Ok(buf.len())
+        }
+
+        fn flush(&mut self) -> io::Result<()> {
+            Ok(())
+        }
+    }
+
+    #[test]
+    fn test_buffer_modes() {
+        for (mode, writes_before_flush) in [
+            (BufferMode::Unbuffered, 4),
+            (BufferMode::Line, 2),
+            (BufferMode::Block, 0),
+        ] {
+            let recorder = Recorder::default();
+            let mut out = OutputBuffer::new(Box::new(recorder.clone()), mode);
+            for part in ["a", "b\n", "c", "d\n"] {
+                out.write_all(part.as_bytes()).unwrap();
+            }
+            assert_eq!(recorder.0.lock().unwrap().len(), writes_before_flush);
+            drop(out);
+            assert_eq!(recorder.0.lock().unwrap().concat(), b"ab\ncd\n");
+        }
+    }
+
+    #[test]
+    fn test_block_buffer_flushes_when_full() {
+        let recorder = Recorder::default();
+        let mut out = OutputBuffer::new(Box::new(recorder.clone()), BufferMode::Block);
+        let chunk = vec![b'x'; BLOCK_SIZE / 4 + 1];
+        for _ in 0..4 {
+            out.write_all(&chunk).unwrap();
+        }
+        assert_eq!(recorder.0.lock().unwrap().len(), 1);
+        assert_eq!(out.buffered(), chunk.len());
+    }
+
+    #[test]
+    fn test_pending_socket_writes_coalesce() {
+        let listener = std::net::TcpListener::bind("127.0.0.1:0").unwrap();
+        let client = TcpStream::connect(listener.local_addr().unwrap()).unwrap();
+        let (mut server, _) = listener.accept().unwrap();
+        let client = Arc::new(client);
+
+        let mut pending = PendingWrites::default();
+        for part in ["GET ", "/ ", "HTTP/1.1\r\n\r\n"] {
+            let target = WriteTarget::Socket(client.clone());
+            pending.push(3, target, part.as_bytes().to_vec()).unwrap();
+        }
+        assert_eq!(pending.fd(), Some(3));
+        pending.flush().unwrap();
+        assert!(pending.is_empty());
+
+        let mut received = [0u8; 18];
+        server.read_exact(&mut received).unwrap();
+        assert_eq!(&received, b"GET / HTTP/1.1\r\n\r\n");
+    }
+}
@@ -0,0 +1,191 @@
+//! Sampling profiler and perf map.
+//!
+//! `SamplingProfiler` counts call stacks. A timer thread raises a flag once
+//! per interval; the VM polls the flag at its safepoints (between
+//! instructions) and records the function of every frame on its stack. The
+//! interpreter pays one relaxed load per instruction while sampling and
+//! nothing otherwise. Time spent inside JIT code is only seen when that code
+//! returns to the interpreter; the perf map lets `perf` attribute it
+//! instead.
+//!
+//! The perf map (`/tmp/perf-<pid>.map`) has a `start size name` line for
+//! each piece of JIT code, which `perf report` uses to name jitted frames.
+
+use std::collections::HashMap;
+use std::fs::File;
+use std::io::{self, Write};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread::{self, JoinHandle};
+use std::time::Duration;
+
+/// Call-stack sampler of one VM.
+#[derive(Debug)]
+pub struct SamplingProfiler {
+    /// Set by the timer when a sample is due
+    tick: Arc<AtomicBool>,
+    stop: Arc<AtomicBool>,
+    timer: Option<JoinHandle<()>>,
+    /// Sample counts per stack of function indices, outermost first
+    stacks: HashMap<Vec<usize>, u64>,
+    /// Reused to build the stack of each sample
+    scratch: Vec<usize>,
+    samples: u64,
+}
+
+impl SamplingProfiler {
+    pub const DEFAULT_INTERVAL: Duration = Duration::from_millis(1);
+
+    /// Start a profiler that takes a sample every `interval`.
+    pub fn start(interval: Duration) -> Self {
+        let tick = Arc::new(AtomicBool::new(false));
+        let stop = Arc::new(AtomicBool::new(false));
+        let timer = {
+            let (tick, stop) = (tick.clone(), stop.clone());
+            thread::Builder::new()
+                .name("moca-profiler".to_string())
+                .spawn(move || {
+                    while !stop.load(Ordering::Relaxed) {
+                        thread::park_timeout(interval);
+                        tick.store(true, Ordering::Relaxed);
+                    }
+                })
+                .ok()
+        };
+        Self {
+            tick,
+            stop,
+            timer,
+            stacks: HashMap::new(),
+            scratch: Vec::new(),
+            samples: 0,
+        }
+    }
+
+    /// Whether a sample is due. Clears the request.
+    #[inline]
+    pub fn due(&self) -> bool {
+        self.tick.load(Ordering::Relaxed) && self.tick.swap(false, Ordering::Relaxed)
+    }
+
+    /// Count one sample of `stack` (function indices, outermost first).
+    pub fn record(&mut self, stack: impl Iterator<Item = usize>) {
+        self.scratch.clear();
+        self.scratch.extend(stack);
+        self.samples += 1;
+        match self.stacks.get_mut(self.scratch.as_slice()) {
+            Some(count) => *count += 1,
+            None => {
+                self.stacks.insert(self.scratch.clone(), 1);
+            }
+        }
+    }
+
+    /// Stop the timer. Samples taken so far are kept.
+    pub fn stop(&mut self) {
+        self.stop.store(true, Ordering::Relaxed);
+        if let Some(timer) = self.timer.take() {
+            timer.thread().unpark();
+            let _ = timer.join();
+        }
+        self.tick.store(false, Ordering::Relaxed);
+    }
+
+    pub fn is_running(&self) -> bool {
+        self.timer.is_some()
+    }
+
+    pub fn sample_count(&self) -> u64 {
+        self.samples
+    }
+
+    /// The samples in folded-stack format, as read by flamegraph.pl and
+    /// inferno: one `outer;inner;leaf count` line per distinct stack,
+    /// sorted. `name` names a function index.
+    pub fn folded(&self, name: impl Fn(usize) -> String) -> String {
+        let mut lines: Vec<String> = self
+            .stacks
+            .iter()
+            .map(|(stack, count)| {
+                let frames: Vec<String> = stack.iter().map(|&f| name(f)).collect();
+                format!("{} {}", frames.join(";"), count)
+            })
+            .collect();
+        lines.sort();
+        let mut out = String::new();
+        for line in lines {
+            out.push_str(&line);
+            out.push('\n');
+        }
+        out
+    }
+}
+
+impl Drop for SamplingProfiler {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+/// The process's perf map, once enabled.
+static PERF_MAP: Mutex<Option<File>> = Mutex::new(None);
+
+/// Start writing `/tmp/perf-<pid>.map`. JIT code compiled or installed from
+/// then on, by any VM in the process, is listed.
+pub fn enable_perf_map() -> io::Result<()> {
+    let mut map = PERF_MAP.lock().unwrap_or_else(|e| e.into_inner());
+    if map.is_none() {
+        let path = format!("/tmp/perf-{}.map", std::process::id());
+        *map = Some(File::options().create(true).append(true).open(path)?);
+    }
+    Ok(())
+}
+
+/// Add `code` to the perf map, if enabled. `name` is only built then.
+pub fn record_jit_code(code: &[u8], name: impl FnOnce() -> String) {
+    let mut map = PERF_MAP.lock().unwrap_or_else(|e| e.into_inner());
+    if let Some(file) = map.as_mut()
+        && !code.is_empty()
+    {
+        let _ = writeln!(
+            file,
+            "{:x} {:x} {}",
+            code.as_ptr() as usize,
+            code.len(),
+            name()
+        );
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_folded_stacks() {
+        let mut profiler = SamplingProfiler::start(Duration::from_secs(60));
+        profiler.record([usize::MAX, 0, 1].into_iter());
+        profiler.record([usize::MAX, 0].into_iter());
+        profiler.record([usize::MAX, 0, 1].into_iter());
+        profiler.stop();
+        assert!(!profiler.is_running());
+        assert_eq!(profiler.sample_count(), 3);
+        let name = |f: usize| match f {
+            usize::MAX => "main".to_string(),
+            f => format!("f{}", f),
+        };
+        assert_eq!(profiler.folded(name), "main;f0 1\nmain;f0;f1 2\n");
+    }
+
+    #[test]
+    fn test_timer_raises_ticks() {
+        let mut profiler = SamplingProfiler::start(Duration::from_millis(1));
+        let deadline = std::time::Instant::now() + Duration::from_secs(5);
+        while !profiler.due() {
+            assert!(std::time::Instant::now() < deadline);
+            thread::yield_now();
+        }
+        profiler.stop();
+        assert!(!profiler.due());
+    }
+}
@@ -0,0 +1,362 @@
+//! M:N scheduler for moca green threads.
+//!
+//! Spawned moca threads run as tasks on a fixed pool of worker OS threads,
+//! one per available core. Each worker owns a deque of runnable tasks: it
+//! pushes and pops at the back, and idle workers steal from the front of
+//! other workers' deques. Tasks spawned from outside the pool (the main VM,
+//! embedders) go to a shared injector queue.
+//!
+//! Scheduling is cooperative: a task runs until it finishes or yields. The
+//! VM yields at backward jumps once its time slice is used up, and instead
+//! of blocking in `ChannelRecv` or `ThreadJoin`. A yielded task goes to the
+//! front of its worker's deque, so everything queued behind it runs first.
+
+use std::cell::Cell;
+use std::collections::VecDeque;
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex, OnceLock};
+use std::thread;
+use std::time::Duration;
+
+use super::Value;
+
+/// Outcome of running a task for one time slice.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum TaskStatus {
+    /// The task finished with a result
+    Done(Value),
+    /// The time slice ran out; the task can continue right away
+    Yielded,
+    /// The task is waiting for another task or a channel
+    Blocked,
+}
+
+/// A green thread body, called once per time slice until it returns `Done`.
+pub type Task = Box<dyn FnMut() -> TaskStatus + Send>;
+
+/// How often a busy worker checks the injector before its own deque
+const INJECTOR_INTERVAL: u32 = 61;
+/// Consecutive blocked slices after which a worker backs off with a sleep
+const BLOCKED_SPIN_LIMIT: u32 = 64;
+const BLOCKED_BACKOFF: Duration = Duration::from_micros(50);
+/// Upper bound on how long an idle worker sleeps without being woken
+const PARK_TIMEOUT: Duration = Duration::from_millis(10);
+
+/// Result slot of a spawned task.
+pub struct Completion {
+    result: Mutex<Option<Value>>,
+    done: Condvar,
+    finished: AtomicBool,
+}
+
+impl Completion {
+    fn new() -> Self {
+        Self {
+            result: Mutex::new(None),
+            done: Condvar::new(),
+            finished: AtomicBool::new(false),
+        }
+    }
+
+    fn complete(&self, value: Value) {
+        *self.result.lock().unwrap() = Some(value);
+        self.finished.store(true, Ordering::Release);
+        self.done.notify_all();
+    }
+
+    /// Whether the task has finished, i.e. `wait` would not block.
+    pub fn is_finished(&self) -> bool {
+        self.finished.load(Ordering::Acquire)
+    }
+
+    /// Block the calling OS thread until the task finishes and take its result.
+    ///
+    /// Returns `Value::Null` if the result was already taken.
+    pub fn wait(&self) -> Value {
+        let mut result = self.result.lock().unwrap();
+        while !self.is_finished() {
+            result = self.done.wait(result).unwrap();
+        }
+        result.take().unwrap_or(Value::Null)
+    }
+}
+
+struct Job {
+    task: Task,
+    completion: Arc<Completion>,
+}
+
+struct Shared {
+    injector: Mutex<VecDeque<Job>>,
+    deques: Vec<Mutex<VecDeque<Job>>>,
+    /// Jobs in the injector and all deques
+    queued: AtomicUsize,
+    /// Workers parked (or about to park) on `wake`
+    sleepers: AtomicUsize,
+    sleep_lock: Mutex<()>,
+    wake: Condvar,
+    shutdown: AtomicBool,
+}
+
+thread_local! {
+    /// (scheduler, worker index) of the current thread if it is a worker
+    static WORKER: Cell<Option<(usize, usize)>> = const { Cell::new(None) };
+}
+
+/// A pool of worker threads running green-thread tasks.
+pub struct Scheduler {
+    shared: Arc<Shared>,
+}
+
+impl Scheduler {
+    /// Start a scheduler with `workers` worker threads (at least one).
+    pub fn new(workers: usize) -> Self {
+        let workers = workers.max(1);
+        let shared = Arc::new(Shared {
+            injector: Mutex::new(VecDeque::new()),
+            deques: (0..workers).map(|_| Mutex::new(VecDeque::new())).collect(),
+            queued: AtomicUsize::new(0),
+            sleepers: AtomicUsize::new(0),
+            sleep_lock: Mutex::new(()),
+            wake: Condvar::new(),
+            shutdown: AtomicBool::new(false),
+        });
+        for index in 0..workers {
+            let shared = shared.clone();
+            thread::Builder::new()
+                .name(format!("moca-worker-{}", index))
+                .spawn(move || shared.worker_loop(index))
+                .expect("failed to spawn scheduler worker");
+        }
+        Self { shared }
+    }
+
+    /// The process-wide scheduler, with one worker per available core.
+    pub fn global() -> &'static Scheduler {
+        static GLOBAL: OnceLock<Scheduler> = OnceLock::new();
+        GLOBAL
+            .get_or_init(|| Scheduler::new(thread::available_parallelism().map_or(1, |n| n.get())))
+    }
+
+    pub fn workers(&self) -> usize {
+        self.shared.deques.len()
+    }
+
+    /// Queue a task. Tasks spawned by a worker of this scheduler go to that
+    /// worker's deque, all others to the injector.
+    pub fn spawn(&self, task: Task) -> Arc<Completion> {
+        let completion = Arc::new(Completion::new());
+        let job = Job {
+            task,
+            completion: completion.clone(),
+        };
+        match self.shared.current_worker() {
+            Some(index) => self.shared.deques[index].lock().unwrap().push_back(job),
+            None => self.shared.injector.lock().unwrap().push_back(job),
+        }
+        self.shared.queued.fetch_add(1, Ordering::SeqCst);
+        self.shared.notify();
+        completion
+    }
+}
+
+impl Drop for Scheduler {
+    /// Stop the workers once they run out of work.
+    fn drop(&mut self) {
+        self.shared.shutdown.store(true, Ordering::SeqCst);
+        let _guard = self.shared.sleep_lock.lock().unwrap();
+        self.shared.wake.notify_all();
+    }
+}
+
+impl Shared {
+    fn id(&self) -> usize {
+        self as *const Shared as usize
+    }
+
+    fn current_worker(&self) -> Option<usize> {
+        WORKER
+            .get()
+            .and_then(|(scheduler, index)| (scheduler == self.id()).then_some(index))
+    }
+
+    fn worker_loop(&self, index: usize) {
+        WORKER.set(Some((self.id(), index)));
+        let mut tick = 0u32;
+        let mut blocked_streak = 0u32;
+        loop {
+            tick = tick.wrapping_add(1);
+            let Some(mut job) = self.find_job(index, tick) else {
+                if !self.park() {
+                    return;
+                }
+                continue;
+            };
+
+            match (job.task)() {
+                TaskStatus::Done(value) => {
+                    blocked_streak = 0;
+                    job.completion.complete(value);
+                }
+                status => {
+                    self.deques[index].lock().unwrap().push_front(job);
+                    self.queued.fetch_add(1, Ordering::SeqCst);
+                    if status == TaskStatus::Yielded {
+                        blocked_streak = 0;
+                    } else {
+                        // Everything runnable here may be waiting on work that
+                        // runs elsewhere; don't spin a core at full speed on it
+                        blocked_streak += 1;
+                        if blocked_streak > BLOCKED_SPIN_LIMIT {
+                            thread::sleep(BLOCKED_BACKOFF);
+                        } else {
+                            thread::yield_now();
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    fn find_job(&self, index: usize, tick: u32) -> Option<Job> {
+        // Check the injector now and then so a busy worker can't starve it
+        if tick.is_multiple_of(INJECTOR_INTERVAL)
+            && let Some(job) = self.take(&self.injector, true)
+        {
+            return Some(job);
+        }
+        self.take(&self.deques[index], false)
+            .or_else(|| self.take(&self.injector, true))
+            .or_else(|| self.steal(index))
+    }
+
+    /// Take the oldest job from another worker's deque.
+    fn steal(&self, index: usize) -> Option<Job> {
+        let n = self.deques.len();
+        (1..n).find_map(|offset| self.take(&self.deques[(index + offset) % n], true))
+    }
+
+    fn take(&self, queue: &Mutex<VecDeque<Job>>, front: bool) -> Option<Job> {
+        let mut queue = queue.lock().unwrap();
+        let job = if front {
+            queue.pop_front()
+        } else {
+            queue.pop_back()
+        };
+        if job.is_some() {
+            self.queued.fetch_sub(1, Ordering::SeqCst);
+        }
+        job
+    }
+
+    /// Sleep until new work may be available. Returns false on shutdown.
+    fn park(&self) -> bool {
+        let guard = self.sleep_lock.lock().unwrap();
+        if self.shutdown.load(Ordering::SeqCst) {
+            return false;
+        }
+        // Announce before checking so a concurrent `spawn` either sees the
+        // sleeper and notifies, or is seen here
+        self.sleepers.fetch_add(1, Ordering::SeqCst);
+        if self.queued.load(Ordering::SeqCst) == 0 {
+            let _ = self.wake.wait_timeout(guard, PARK_TIMEOUT).unwrap();
+        }
+        self.sleepers.fetch_sub(1, Ordering::SeqCst);
+        true
+    }
+
+    fn notify(&self) {
+        if self.sleepers.load(Ordering::SeqCst) > 0 {
+            let _guard = self.sleep_lock.lock().unwrap();
+            self.wake.notify_one();
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn done(value: i64) -> Task {
+        Box::new(move || TaskStatus::Done(Value::I64(value)))
+    }
+
+    #[test]
+    fn test_spawn_and_wait() {
+        let scheduler = Scheduler::new(2);
+        let completions: Vec<_> = (0..100).map(|i| scheduler.spawn(done(i))).collect();
+        for (i, c) in completions.iter().enumerate() {
+            assert_eq!(c.wait(), Value::I64(i as i64));
+            assert!(c.is_finished());
+        }
+    }
+
+    #[test]
+    fn test_yielding_tasks_interleave() {
+        // One worker: two tasks that each need several slices must take turns.
+        // They are spawned from a task so both start in the worker's deque.
+        let scheduler = Arc::new(Scheduler::new(1));
+        let log = Arc::new(Mutex::new(Vec::new()));
+        let children = Arc::new(Mutex::new(Vec::new()));
+        let parent = {
+            let (scheduler, log, children) = (scheduler.clone(), log.clone(), children.clone());
+            scheduler.clone().spawn(Box::new(move || {
+                for id in 0..2 {
+                    let log = log.clone();
+                    let mut slices = 0;
+                    let child = scheduler.spawn(Box::new(move || {
+                        log.lock().unwrap().push(id);
+                        slices += 1;
+                        if slices == 3 {
+                            TaskStatus::Done(Value::I64(id))
+                        } else {
+                            TaskStatus::Yielded
+                        }
+                    }));
+                    children.lock().unwrap().push(child);
+                }
+                TaskStatus::Done(Value::Null)
+            }))
+        };
+        parent.wait();
+        for c in children.lock().unwrap().iter() {
+            c.wait();
+        }
+        assert_eq!(*log.lock().unwrap(), [1, 0, 1, 0, 1, 0]);
+    }
+
+    #[test]
+    fn test_blocked_task_waits_for_other_task() {
+        let scheduler = Scheduler::new(1);
+        let flag = Arc::new(AtomicBool::new(false));
+        let waiter = {
+            let flag = flag.clone();
+            scheduler.spawn(Box::new(move || {
+                if flag.load(Ordering::Acquire) {
+                    TaskStatus::Done(Value::Bool(true))
+                } else {
+                    TaskStatus::Blocked
+                }
+            }))
+        };
+        scheduler.spawn(Box::new(move || {
+            flag.store(true, Ordering::Release);
+            TaskStatus::Done(Value::Null)
+        }));
+        assert_eq!(waiter.wait(), Value::Bool(true));
+    }
+
+    #[test]
+    fn test_worker_spawns_go_to_local_deque_and_get_stolen() {
+        let scheduler = Arc::new(Scheduler::new(4));
+        let inner = scheduler.clone();
+        let parent = scheduler.spawn(Box::new(move || {
+            let children: Vec<_> = (0..64).map(|i| inner.spawn(done(i))).collect();
+            let sum: i64 = children.iter().map(|c| c.wait().as_i64().unwrap()).sum();
+            TaskStatus::Done(Value::I64(sum))
+        }));
+        // The parent blocks its worker in `wait`, so the children only finish
+        // if other workers steal them
+        assert_eq!(parent.wait(), Value::I64((0..64).sum()));
+    }
+}
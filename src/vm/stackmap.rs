@@ -181,7 +181,7 @@ pub fn is_safepoint(op: &super::ops::Op, pc: usize) -> bool {
         Op::BrIfFalse(target) => *target < pc,
 
         // Thread operations may allocate
-        Op::ThreadSpawn(_) | Op::ChannelCreate => true,
+        Op::ThreadSpawn(_) | Op::ChannelCreate | Op::ChannelCreateBounded => true,
 
         _ => false,
     }
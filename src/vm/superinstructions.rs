@@ -0,0 +1,263 @@
+//! Superinstructions for the MicroOp interpreter.
+//!
+//! Every micro-op the interpreter runs costs a trip through the dispatch
+//! loop: a safepoint poll, a frame lookup, the fetch and the match. Pairs
+//! that run back to back most often (the pair counts of `OpcodeProfile`
+//! over the `examples/` programs) are fused into one micro-op that does the
+//! work of both:
+//!
+//! | Pair | Superinstruction |
+//! |------|------------------|
+//! | `CmpI64`, `BrIfFalse` | `CmpI64BrIfFalse` |
+//! | `CmpF64`, `BrIfFalse` | `CmpF64BrIfFalse` |
+//! | `CmpI64Imm`, `BrIfFalse` | `CmpI64ImmBrIfFalse` |
+//! | `MulF64`, `AddF64` | `MulF64AddF64` |
+//! | `ConstF64`, `MulF64` | `ConstF64MulF64` |
+//! | `ConstF64`, `DivF64` | `ConstF64DivF64` |
+//!
+//! The second op of each pair must use the result of the first and must not
+//! be a jump target. The fused op replaces the first op and falls through
+//! past the second, which stays in place: micro-op pcs, `pc_map` and branch
+//! targets are unchanged. Only the interpreter's copy of the code is fused;
+//! the JIT converts functions itself.
+
+use super::Function;
+use super::Op;
+use super::microop::{ConvertedFunction, MicroOp};
+use super::microop_converter;
+
+/// Convert `func` to micro-ops for the interpreter, with superinstructions.
+pub fn convert(func: &Function) -> ConvertedFunction {
+    let mut converted = microop_converter::convert(func);
+    fuse(&mut converted.micro_ops);
+    converted
+}
+
+/// Fuse the pairs in `ops` that have a superinstruction. Returns how many
+/// were fused.
+pub fn fuse(ops: &mut [MicroOp]) -> usize {
+    let mut entered = vec![false; ops.len() + 1];
+    for op in ops.iter() {
+        if let Some(target) = entry(op) {
+            entered[target.min(ops.len())] = true;
+        }
+    }
+
+    let mut fused = 0;
+    let mut pc = 0;
+    while pc + 1 < ops.len() {
+        let superinstruction = if entered[pc + 1] {
+            None
+        } else {
+            fuse_pair(&ops[pc], &ops[pc + 1])
+        };
+        match superinstruction {
+            Some(op) => {
+                ops[pc] = op;
+                fused += 1;
+                pc += 2;
+            }
+            None => pc += 1,
+        }
+    }
+    fused
+}
+
+/// Where `op` can send control other than to the next op.
+fn entry(op: &MicroOp) -> Option<usize> {
+    match *op {
+        MicroOp::Jmp { target, .. }
+        | MicroOp::BrIf { target, .. }
+        | MicroOp::BrIfFalse { target, .. }
+        | MicroOp::Raw {
+            op: Op::TryBegin(target),
+        } => Some(target),
+        _ => None,
+    }
+}
+
+/// The superinstruction doing `first` and then `second`, if there is one.
+fn fuse_pair(first: &MicroOp, second: &MicroOp) -> Option<MicroOp> {
+    Some(match (first, second) {
+        (&MicroOp::CmpI64 { dst, a, b, cond }, &MicroOp::BrIfFalse { cond: c, target })
+            if c == dst =>
+        {
+            MicroOp::CmpI64BrIfFalse {
+                dst,
+                a,
+                b,
+                cond,
+                target,
+            }
+        }
+        (&MicroOp::CmpI64Imm { dst, a, imm, cond }, &MicroOp::BrIfFalse { cond: c, target })
+            if c == dst =>
+        {
+            MicroOp::CmpI64ImmBrIfFalse {
+                dst,
+                a,
+                imm,
+                cond,
+                target,
+            }
+        }
+        (&MicroOp::CmpF64 { dst, a, b, cond }, &MicroOp::BrIfFalse { cond: c, target })
+            if c == dst =>
+        {
+            MicroOp::CmpF64BrIfFalse {
+                dst,
+                a,
+                b,
+                cond,
+                target,
+            }
+        }
+        // Addition is commutative, so the product can be either operand
+        (&MicroOp::MulF64 { dst: tmp, a, b }, &MicroOp::AddF64 { dst, a: x, b: y })
+            if x == tmp || y == tmp =>
+        {
+            MicroOp::MulF64AddF64 {
+                tmp,
+                a,
+                b,
+                c: if x == tmp { y } else { x },
+                dst,
+            }
+        }
+        (&MicroOp::ConstF64 { dst: tmp, imm }, &MicroOp::MulF64 { dst, a: x, b: y })
+            if x == tmp || y == tmp =>
+        {
+            MicroOp::ConstF64MulF64 {
+                tmp,
+                imm,
+                dst,
+                a: if x == tmp { y } else { x },
+            }
+        }
+        (&MicroOp::ConstF64 { dst: tmp, imm }, &MicroOp::DivF64 { dst, a, b })
+            if b == tmp && a != tmp =>
+        {
+            MicroOp::ConstF64DivF64 { tmp, imm, dst, a }
+        }
+        _ => return None,
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::vm::ValueType;
+    use crate::vm::microop::{CmpCond, VReg};
+
+    fn function(arity: usize, local_types: Vec<ValueType>, code: Vec<Op>) -> Function {
+        Function {
+            name: "f".to_string(),
+            arity,
+            locals_count: local_types.len(),
+            code: code.into(),
+            stackmap: None,
+            local_types,
+        }
+    }
+
+    #[test]
+    fn test_fuse_loop_condition() {
+        // while i < n { i = i + 1 }
+        let func = function(
+            2,
+            vec![ValueType::I64; 2],
+            vec![
+                Op::LocalGet(0),
+                Op::LocalGet(1),
+                Op::I64LtS,
+                Op::BrIfFalse(9),
+                Op::LocalGet(0),
+                Op::I64Const(1),
+                Op::I64Add,
+                Op::LocalSet(0),
+                Op::Jmp(0),
+                Op::LocalGet(0),
+                Op::Ret,
+            ],
+        );
+        let plain = microop_converter::convert(&func);
+        let converted = convert(&func);
+        assert_eq!(converted.micro_ops.len(), plain.micro_ops.len());
+        assert_eq!(converted.pc_map, plain.pc_map);
+        let MicroOp::CmpI64 { dst, .. } = plain.micro_ops[0] else {
+            panic!("expected CmpI64, got {:?}", plain.micro_ops[0]);
+        };
+        let MicroOp::BrIfFalse { target, .. } = plain.micro_ops[1] else {
+            panic!("expected BrIfFalse, got {:?}", plain.micro_ops[1]);
+        };
+        assert_eq!(
+            converted.micro_ops[0],
+            MicroOp::CmpI64BrIfFalse {
+                dst,
+                a: VReg(0),
+                b: VReg(1),
+                cond: CmpCond::LtS,
+                target,
+            }
+        );
+        assert_eq!(converted.micro_ops[1], plain.micro_ops[1]);
+    }
+
+    #[test]
+    fn test_fuse_float_pairs() {
+        // return x * y + z / 2.0 * 3.0
+        let func = function(
+            3,
+            vec![ValueType::F64; 3],
+            vec![
+                Op::LocalGet(0),
+                Op::LocalGet(1),
+                Op::F64Mul,
+                Op::LocalGet(2),
+                Op::F64Const(2.0),
+                Op::F64Div,
+                Op::F64Const(3.0),
+                Op::F64Mul,
+                Op::F64Add,
+                Op::Ret,
+            ],
+        );
+        let names: Vec<&str> = convert(&func).micro_ops.iter().map(MicroOp::name).collect();
+        assert!(names.contains(&"ConstF64DivF64"), "{:?}", names);
+        assert!(names.contains(&"ConstF64MulF64"), "{:?}", names);
+    }
+
+    #[test]
+    fn test_no_fusion_into_jump_target() {
+        let mut ops = vec![
+            MicroOp::ConstI64 {
+                dst: VReg(1),
+                imm: 0,
+            },
+            MicroOp::CmpI64Imm {
+                dst: VReg(1),
+                a: VReg(0),
+                imm: 10,
+                cond: CmpCond::LtS,
+            },
+            MicroOp::BrIfFalse {
+                cond: VReg(1),
+                target: 4,
+            },
+            MicroOp::Jmp {
+                target: 2,
+                old_pc: 3,
+                old_target: 2,
+            },
+            MicroOp::Ret { src: None },
+        ];
+        let before = ops.clone();
+        assert_eq!(fuse(&mut ops), 0);
+        assert_eq!(ops, before);
+
+        // Once nothing jumps to the branch, the pair fuses
+        ops[3] = MicroOp::Ret { src: None };
+        assert_eq!(fuse(&mut ops), 1);
+        assert_eq!(ops[1].name(), "CmpI64ImmBrIfFalse");
+    }
+}
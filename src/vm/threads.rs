@@ -1,19 +1,24 @@
 //! Thread support for moca VM.
 //!
-//! This module provides OS thread support with:
-//! - Thread spawning with independent VM instances
+//! This module provides thread support with:
+//! - Thread spawning with independent VM instances, either as OS threads or
+//!   as green threads on the work-stealing `Scheduler`
 //! - Join handles for waiting on thread completion
 //! - Channel-based communication between threads
 
 // Thread support is not yet integrated, allow dead code
 #![allow(dead_code)]
 
-use std::collections::VecDeque;
-use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::cell::UnsafeCell;
+use std::collections::HashMap;
+use std::mem::MaybeUninit;
+use std::ops::Deref;
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering, fence};
 use std::sync::{Arc, Condvar, Mutex};
 use std::thread::{self, JoinHandle};
 
 use super::Value;
+use super::scheduler::{Completion, Scheduler, Task};
 
 /// Thread ID counter for generating unique IDs.
 static NEXT_THREAD_ID: AtomicUsize = AtomicUsize::new(1);
@@ -23,19 +28,25 @@ fn next_thread_id() -> usize {
     NEXT_THREAD_ID.fetch_add(1, Ordering::Relaxed)
 }
 
+/// What a `ThreadHandle` waits on.
+enum Joinable {
+    Os(JoinHandle<Value>),
+    Green(Arc<Completion>),
+}
+
 /// A handle to a spawned thread.
 pub struct ThreadHandle {
     /// Unique thread ID
     pub id: usize,
-    /// Join handle for the OS thread
-    handle: Option<JoinHandle<Value>>,
+    /// Join handle for the OS thread or green thread
+    handle: Option<Joinable>,
     /// Whether the thread has been joined
     joined: bool,
 }
 
 impl ThreadHandle {
     /// Create a new thread handle.
-    fn new(id: usize, handle: JoinHandle<Value>) -> Self {
+    fn new(id: usize, handle: Joinable) -> Self {
         Self {
             id,
             handle: Some(handle),
@@ -50,14 +61,27 @@ impl ThreadHandle {
         }
 
         match self.handle.take() {
-            Some(h) => {
+            Some(Joinable::Os(h)) => {
                 self.joined = true;
                 h.join().map_err(|e| format!("Thread panicked: {:?}", e))
             }
+            Some(Joinable::Green(c)) => {
+                self.joined = true;
+                Ok(c.wait())
+            }
             None => Err("Thread handle already taken".to_string()),
         }
     }
 
+    /// Check if the thread has finished, i.e. `join` would not block.
+    pub fn is_finished(&self) -> bool {
+        match &self.handle {
+            Some(Joinable::Os(h)) => h.is_finished(),
+            Some(Joinable::Green(c)) => c.is_finished(),
+            None => true,
+        }
+    }
+
     /// Check if the thread has been joined.
     pub fn is_joined(&self) -> bool {
         self.joined
@@ -66,19 +90,19 @@ impl ThreadHandle {
 
 /// Thread spawner that creates new threads running moca code.
 pub struct ThreadSpawner {
-    /// Active thread handles
-    handles: Vec<ThreadHandle>,
+    /// Active thread handles by ID
+    handles: HashMap<usize, ThreadHandle>,
 }
 
 impl ThreadSpawner {
     /// Create a new thread spawner.
     pub fn new() -> Self {
         Self {
-            handles: Vec::new(),
+            handles: HashMap::new(),
         }
     }
 
-    /// Spawn a new thread that runs the given closure.
+    /// Spawn a new OS thread that runs the given closure.
     /// The closure should set up a VM and run moca code.
     pub fn spawn<F>(&mut self, f: F) -> usize
     where
@@ -86,13 +110,29 @@ impl ThreadSpawner {
     {
         let id = next_thread_id();
         let handle = thread::spawn(f);
-        self.handles.push(ThreadHandle::new(id, handle));
+        self.handles
+            .insert(id, ThreadHandle::new(id, Joinable::Os(handle)));
+        id
+    }
+
+    /// Spawn a green thread on the global scheduler.
+    pub fn spawn_green(&mut self, task: Task) -> usize {
+        let id = next_thread_id();
+        let completion = Scheduler::global().spawn(task);
+        self.handles
+            .insert(id, ThreadHandle::new(id, Joinable::Green(completion)));
         id
     }
 
     /// Get a thread handle by ID.
     pub fn get_handle(&mut self, id: usize) -> Option<&mut ThreadHandle> {
-        self.handles.iter_mut().find(|h| h.id == id)
+        self.handles.get_mut(&id)
+    }
+
+    /// Whether joining thread `id` would return without blocking (also true
+    /// for unknown IDs, which `join` reports as an error).
+    pub fn is_finished(&self, id: usize) -> bool {
+        self.handles.get(&id).is_none_or(ThreadHandle::is_finished)
     }
 
     /// Join a thread by ID and return its result.
@@ -105,7 +145,7 @@ impl ThreadSpawner {
 
     /// Clean up finished threads.
     pub fn cleanup(&mut self) {
-        self.handles.retain(|h| !h.joined);
+        self.handles.retain(|_, h| !h.joined);
     }
 }
 
@@ -115,86 +155,376 @@ impl Default for ThreadSpawner {
     }
 }
 
+/// Default number of messages a channel buffers before `send` blocks
+pub const DEFAULT_CHANNEL_CAPACITY: usize = 1024;
+/// Largest capacity `channel(capacity)` accepts
+pub const MAX_CHANNEL_CAPACITY: usize = 1 << 24;
+/// Failed attempts a blocking send/recv spins through before parking
+const SPIN_LIMIT: u32 = 64;
+
+/// Keeps the producer and consumer cursors on separate cache lines.
+#[repr(align(64))]
+struct CachePadded<T>(T);
+
+impl<T> Deref for CachePadded<T> {
+    type Target = T;
+
+    fn deref(&self) -> &T {
+        &self.0
+    }
+}
+
+/// A ring buffer cell. `seq` says whose turn it is: `pos` when free for
+/// the sender at position `pos`, `pos + 1` when full for the receiver.
+struct Slot<T> {
+    seq: AtomicUsize,
+    value: UnsafeCell<MaybeUninit<T>>,
+}
+
+/// Why a non-blocking send failed; the value is handed back.
+#[derive(Debug, PartialEq)]
+pub enum TrySendError<T> {
+    Full(T),
+    Closed(T),
+}
+
 /// A channel for communication between threads.
 ///
-/// Channels are multiple-producer, multiple-consumer (MPMC) queues.
+/// Channels are bounded multiple-producer, multiple-consumer (MPMC) queues:
+/// a lock-free ring buffer in which senders and receivers claim positions
+/// with a compare-and-swap on their cursor and hand slots over through the
+/// slot sequence numbers (Vyukov's bounded queue). A send on a full channel
+/// or a receive on an empty one spins briefly and then parks; the mutex and
+/// condition variables are only touched when someone is parked.
 pub struct Channel<T> {
-    /// The message queue
-    queue: Mutex<VecDeque<T>>,
-    /// Condition variable for blocking recv
-    not_empty: Condvar,
+    slots: Box<[Slot<T>]>,
+    /// `slots.len() - 1`; the capacity is a power of two
+    mask: usize,
+    /// Next position to send to
+    send_pos: CachePadded<AtomicUsize>,
+    /// Next position to receive from
+    recv_pos: CachePadded<AtomicUsize>,
     /// Whether the channel is closed
     closed: AtomicBool,
     /// Number of messages sent
     sent_count: AtomicUsize,
     /// Number of messages received
     recv_count: AtomicUsize,
+    /// Parked senders and receivers
+    waiting_senders: AtomicUsize,
+    waiting_receivers: AtomicUsize,
+    park_lock: Mutex<()>,
+    not_full: Condvar,
+    not_empty: Condvar,
 }
 
+// SAFETY: a slot's value is only accessed by the one sender or receiver
+// whose cursor CAS claimed it, after the sequence number handed it over.
+unsafe impl<T: Send> Send for Channel<T> {}
+unsafe impl<T: Send> Sync for Channel<T> {}
+
 impl<T> Channel<T> {
-    /// Create a new channel.
+    /// Create a new channel with the default capacity.
     pub fn new() -> Arc<Self> {
-        Arc::new(Self {
-            queue: Mutex::new(VecDeque::new()),
-            not_empty: Condvar::new(),
+        Arc::new(Self::default())
+    }
+
+    /// Create a new channel buffering at least `capacity` messages.
+    pub fn bounded(capacity: usize) -> Arc<Self> {
+        Arc::new(Self::with_capacity(capacity))
+    }
+
+    fn with_capacity(capacity: usize) -> Self {
+        let capacity = capacity.max(2).next_power_of_two();
+        Self {
+            slots: (0..capacity)
+                .map(|i| Slot {
+                    seq: AtomicUsize::new(i),
+                    value: UnsafeCell::new(MaybeUninit::uninit()),
+                })
+                .collect(),
+            mask: capacity - 1,
+            send_pos: CachePadded(AtomicUsize::new(0)),
+            recv_pos: CachePadded(AtomicUsize::new(0)),
             closed: AtomicBool::new(false),
             sent_count: AtomicUsize::new(0),
             recv_count: AtomicUsize::new(0),
-        })
+            waiting_senders: AtomicUsize::new(0),
+            waiting_receivers: AtomicUsize::new(0),
+            park_lock: Mutex::new(()),
+            not_full: Condvar::new(),
+            not_empty: Condvar::new(),
+        }
     }
 
-    /// Send a value through the channel.
-    /// Returns Err if the channel is closed.
-    pub fn send(&self, value: T) -> Result<(), T> {
+    /// Number of messages the channel buffers.
+    pub fn capacity(&self) -> usize {
+        self.slots.len()
+    }
+
+    /// Send a value without blocking or waking anyone.
+    fn push(&self, value: T) -> Result<(), TrySendError<T>> {
         if self.closed.load(Ordering::Acquire) {
-            return Err(value);
+            return Err(TrySendError::Closed(value));
+        }
+        let mut pos = self.send_pos.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[pos & self.mask];
+            let seq = slot.seq.load(Ordering::Acquire);
+            match (seq as isize).wrapping_sub(pos as isize) {
+                0 => match self.send_pos.compare_exchange_weak(
+                    pos,
+                    pos.wrapping_add(1),
+                    Ordering::Relaxed,
+                    Ordering::Relaxed,
+                ) {
+                    Ok(_) => {
+                        unsafe { (*slot.value.get()).write(value) };
+                        slot.seq.store(pos.wrapping_add(1), Ordering::Release);
+                        self.sent_count.fetch_add(1, Ordering::Relaxed);
+                        return Ok(());
+                    }
+                    Err(current) => pos = current,
+                },
+                // The receiver of the previous lap hasn't freed this slot yet
+                d if d < 0 => return Err(TrySendError::Full(value)),
+                _ => pos = self.send_pos.load(Ordering::Relaxed),
+            }
+        }
+    }
+
+    /// Receive a value without blocking or waking anyone.
+    fn pop(&self) -> Option<T> {
+        let mut pos = self.recv_pos.load(Ordering::Relaxed);
+        loop {
+            let slot = &self.slots[pos & self.mask];
+            let seq = slot.seq.load(Ordering::Acquire);
+            match (seq as isize).wrapping_sub(pos.wrapping_add(1) as isize) {
+                0 => match self.recv_pos.compare_exchange_weak(
+                    pos,
+                    pos.wrapping_add(1),
+                    Ordering::Relaxed,
+                    Ordering::Relaxed,
+                ) {
+                    Ok(_) => {
+                        let value = unsafe { (*slot.value.get()).assume_init_read() };
+                        slot.seq
+                            .store(pos.wrapping_add(self.mask + 1), Ordering::Release);
+                        self.recv_count.fetch_add(1, Ordering::Relaxed);
+                        return Some(value);
+                    }
+                    Err(current) => pos = current,
+                },
+                // Nothing has been sent to this position yet
+                d if d < 0 => return None,
+                _ => pos = self.recv_pos.load(Ordering::Relaxed),
+            }
+        }
+    }
+
+    /// Wake one (or, after a batch, every) thread parked on `cond`, if any.
+    /// The fence orders the slot hand-over before the waiter count check;
+    /// `block_on` pairs it with one between the increment and its retry.
+    fn wake(&self, waiting: &AtomicUsize, cond: &Condvar, all: bool) {
+        fence(Ordering::SeqCst);
+        if waiting.load(Ordering::Relaxed) > 0 {
+            let _guard = self.park_lock.lock().unwrap();
+            if all {
+                cond.notify_all();
+            } else {
+                cond.notify_one();
+            }
         }
+    }
 
-        {
-            let mut queue = self.queue.lock().unwrap();
-            queue.push_back(value);
-            self.sent_count.fetch_add(1, Ordering::Relaxed);
+    /// Retry `attempt` until it returns Some: spin first, then park on
+    /// `cond` until woken.
+    fn block_on<R>(
+        &self,
+        waiting: &AtomicUsize,
+        cond: &Condvar,
+        mut attempt: impl FnMut() -> Option<R>,
+    ) -> R {
+        for spin in 0..SPIN_LIMIT {
+            if let Some(r) = attempt() {
+                return r;
+            }
+            if spin < SPIN_LIMIT / 2 {
+                std::hint::spin_loop();
+            } else {
+                thread::yield_now();
+            }
         }
 
-        self.not_empty.notify_one();
+        let mut guard = self.park_lock.lock().unwrap();
+        waiting.fetch_add(1, Ordering::SeqCst);
+        fence(Ordering::SeqCst);
+        let r = loop {
+            if let Some(r) = attempt() {
+                break r;
+            }
+            guard = cond.wait(guard).unwrap();
+        };
+        waiting.fetch_sub(1, Ordering::SeqCst);
+        r
+    }
+
+    /// Send without blocking.
+    pub fn try_send(&self, value: T) -> Result<(), TrySendError<T>> {
+        self.push(value)?;
+        self.wake(&self.waiting_receivers, &self.not_empty, false);
         Ok(())
     }
 
-    /// Receive a value from the channel, blocking if empty.
-    /// Returns None if the channel is closed and empty.
-    pub fn recv(&self) -> Option<T> {
-        let mut queue = self.queue.lock().unwrap();
+    /// Send a value through the channel, blocking while it is full.
+    /// Returns Err if the channel is closed.
+    pub fn send(&self, value: T) -> Result<(), T> {
+        let mut pending = Some(value);
+        let result = self.send_pending(&mut pending);
+        self.wake(&self.waiting_receivers, &self.not_empty, false);
+        result
+    }
+
+    /// Send `*pending`, blocking while the channel is full.
+    fn send_pending(&self, pending: &mut Option<T>) -> Result<(), T> {
+        let value = pending.take().expect("a value to send");
+        match self.push(value) {
+            Ok(()) => return Ok(()),
+            Err(TrySendError::Closed(v)) => return Err(v),
+            Err(TrySendError::Full(v)) => *pending = Some(v),
+        }
+        // Receivers may be parked on messages sent earlier in a batch
+        self.wake(&self.waiting_receivers, &self.not_empty, true);
+        self.block_on(&self.waiting_senders, &self.not_full, || {
+            match self.push(pending.take()?) {
+                Ok(()) => Some(Ok(())),
+                Err(TrySendError::Closed(v)) => Some(Err(v)),
+                Err(TrySendError::Full(v)) => {
+                    *pending = Some(v);
+                    None
+                }
+            }
+        })
+    }
 
-        loop {
-            if let Some(value) = queue.pop_front() {
-                self.recv_count.fetch_add(1, Ordering::Relaxed);
-                return Some(value);
+    /// Send every value in order, blocking while the channel is full.
+    ///
+    /// Parked receivers are woken once for the batch instead of once per
+    /// message. Returns the number sent, or Err with the first unsent value
+    /// if the channel is closed.
+    pub fn send_many(&self, values: impl IntoIterator<Item = T>) -> Result<usize, T> {
+        let mut sent = 0;
+        let mut result = Ok(());
+        for value in values {
+            let mut pending = Some(value);
+            result = self.send_pending(&mut pending);
+            if result.is_err() {
+                break;
             }
+            sent += 1;
+        }
+        self.wake(&self.waiting_receivers, &self.not_empty, true);
+        result.map(|()| sent)
+    }
 
-            if self.closed.load(Ordering::Acquire) {
-                return None;
+    /// Send a prefix of `values` without blocking, stopping when the channel
+    /// is full. Returns the number sent, or Err with it if the channel is
+    /// closed.
+    pub fn try_send_many(&self, values: &[T]) -> Result<usize, usize>
+    where
+        T: Clone,
+    {
+        let mut sent = 0;
+        let mut closed = false;
+        for value in values {
+            match self.push(value.clone()) {
+                Ok(()) => sent += 1,
+                Err(TrySendError::Full(_)) => break,
+                Err(TrySendError::Closed(_)) => {
+                    closed = true;
+                    break;
+                }
             }
+        }
+        if sent > 0 {
+            self.wake(&self.waiting_receivers, &self.not_empty, true);
+        }
+        if closed { Err(sent) } else { Ok(sent) }
+    }
 
-            queue = self.not_empty.wait(queue).unwrap();
+    /// Receive a value from the channel, blocking if empty.
+    /// Returns None if the channel is closed and empty.
+    pub fn recv(&self) -> Option<T> {
+        let value = self.pop().or_else(|| {
+            self.block_on(&self.waiting_receivers, &self.not_empty, || {
+                match self.pop() {
+                    Some(v) => Some(Some(v)),
+                    // Messages sent before `close` are still delivered
+                    None if self.is_closed() => Some(self.pop()),
+                    None => None,
+                }
+            })
+        });
+        if value.is_some() {
+            self.wake(&self.waiting_senders, &self.not_full, false);
         }
+        value
     }
 
     /// Try to receive a value without blocking.
     /// Returns None if the channel is empty.
     pub fn try_recv(&self) -> Option<T> {
-        let mut queue = self.queue.lock().unwrap();
-        let value = queue.pop_front();
+        let value = self.pop();
         if value.is_some() {
-            self.recv_count.fetch_add(1, Ordering::Relaxed);
+            self.wake(&self.waiting_senders, &self.not_full, false);
         }
         value
     }
 
+    /// Receive up to `max` values into `out` without blocking.
+    /// Returns the number received.
+    pub fn try_recv_many(&self, max: usize, out: &mut Vec<T>) -> usize {
+        let start = out.len();
+        while out.len() - start < max {
+            match self.pop() {
+                Some(v) => out.push(v),
+                None => break,
+            }
+        }
+        let received = out.len() - start;
+        if received > 0 {
+            self.wake(&self.waiting_senders, &self.not_full, true);
+        }
+        received
+    }
+
+    /// Receive up to `max` values into `out`, blocking until at least one is
+    /// available. Returns the number received: 0 only if `max` is 0 or the
+    /// channel is closed and empty.
+    pub fn recv_many(&self, max: usize, out: &mut Vec<T>) -> usize {
+        if max == 0 {
+            return 0;
+        }
+        let received = self.try_recv_many(max, out);
+        if received > 0 {
+            return received;
+        }
+        match self.recv() {
+            Some(first) => {
+                out.push(first);
+                1 + self.try_recv_many(max - 1, out)
+            }
+            None => 0,
+        }
+    }
+
     /// Close the channel.
     /// No more values can be sent, but existing values can still be received.
     pub fn close(&self) {
         self.closed.store(true, Ordering::Release);
+        let _guard = self.park_lock.lock().unwrap();
         self.not_empty.notify_all();
+        self.not_full.notify_all();
     }
 
     /// Check if the channel is closed.
@@ -204,7 +534,9 @@ impl<T> Channel<T> {
 
     /// Get the number of messages currently in the queue.
     pub fn len(&self) -> usize {
-        self.queue.lock().unwrap().len()
+        let recv_pos = self.recv_pos.load(Ordering::Acquire);
+        let send_pos = self.send_pos.load(Ordering::Acquire);
+        send_pos.wrapping_sub(recv_pos).min(self.capacity())
     }
 
     /// Check if the queue is empty.
@@ -223,13 +555,13 @@ impl<T> Channel<T> {
 
 impl<T> Default for Channel<T> {
     fn default() -> Self {
-        Self {
-            queue: Mutex::new(VecDeque::new()),
-            not_empty: Condvar::new(),
-            closed: AtomicBool::new(false),
-            sent_count: AtomicUsize::new(0),
-            recv_count: AtomicUsize::new(0),
-        }
+        Self::with_capacity(DEFAULT_CHANNEL_CAPACITY)
+    }
+}
+
+impl<T> Drop for Channel<T> {
+    fn drop(&mut self) {
+        while self.pop().is_some() {}
     }
 }
 
@@ -349,6 +681,28 @@ mod tests {
         assert_eq!(r3, Value::I64(3));
     }
 
+    #[test]
+    fn test_green_thread_join() {
+        use super::super::scheduler::TaskStatus;
+
+        let mut spawner = ThreadSpawner::new();
+        let mut slices = 0;
+        let id = spawner.spawn_green(Box::new(move || {
+            slices += 1;
+            if slices < 3 {
+                TaskStatus::Yielded
+            } else {
+                TaskStatus::Done(Value::I64(slices))
+            }
+        }));
+
+        assert_eq!(spawner.join(id).unwrap(), Value::I64(3));
+        assert!(spawner.is_finished(id));
+        // Same errors as OS threads
+        assert!(spawner.join(id).is_err());
+        assert!(spawner.join(id + 1000).is_err());
+    }
+
     #[test]
     fn test_channel_basic() {
         let (tx, rx) = channel::<i32>();
@@ -450,4 +804,131 @@ mod tests {
         assert_eq!(sent, 2);
         assert_eq!(recv, 1);
     }
+
+    #[test]
+    fn test_channel_bounded_full() {
+        let channel = Channel::<i32>::bounded(3);
+        // Rounded up to a power of two
+        assert_eq!(channel.capacity(), 4);
+        for i in 0..4 {
+            assert!(channel.try_send(i).is_ok());
+        }
+        assert_eq!(channel.try_send(4), Err(TrySendError::Full(4)));
+        assert_eq!(channel.len(), 4);
+
+        assert_eq!(channel.try_recv(), Some(0));
+        assert!(channel.try_send(4).is_ok());
+        channel.close();
+        assert_eq!(channel.try_send(5), Err(TrySendError::Closed(5)));
+    }
+
+    #[test]
+    fn test_channel_wraps_around() {
+        let channel = Channel::<usize>::bounded(4);
+        for i in 0..100 {
+            channel.send(i).unwrap();
+            channel.send(i + 1000).unwrap();
+            assert_eq!(channel.recv(), Some(i));
+            assert_eq!(channel.recv(), Some(i + 1000));
+        }
+        assert!(channel.is_empty());
+        assert_eq!(channel.stats(), (200, 200));
+    }
+
+    #[test]
+    fn test_channel_many() {
+        let channel = Channel::<i32>::bounded(8);
+        assert_eq!(channel.send_many(0..5), Ok(5));
+
+        let mut out = Vec::new();
+        assert_eq!(channel.recv_many(3, &mut out), 3);
+        assert_eq!(channel.recv_many(10, &mut out), 2);
+        assert_eq!(out, [0, 1, 2, 3, 4]);
+
+        // A partial batch reports how much fit
+        assert_eq!(channel.try_send_many(&[1; 10]), Ok(8));
+        assert_eq!(channel.try_recv_many(10, &mut out), 8);
+        channel.close();
+        assert_eq!(channel.try_send_many(&[1, 2]), Err(0));
+        assert_eq!(channel.recv_many(10, &mut out), 0);
+    }
+
+    #[test]
+    fn test_channel_send_blocks_until_drained() {
+        let channel = Channel::<usize>::bounded(2);
+        let producer = {
+            let channel = channel.clone();
+            std::thread::spawn(move || channel.send_many(0..100))
+        };
+
+        let mut out = Vec::new();
+        while out.len() < 100 {
+            channel.recv_many(7, &mut out);
+        }
+        assert_eq!(producer.join().unwrap(), Ok(100));
+        assert_eq!(out, (0..100).collect::<Vec<_>>());
+    }
+
+    #[test]
+    fn test_channel_close_wakes_receiver() {
+        let channel = Channel::<i32>::new();
+        let receiver = {
+            let channel = channel.clone();
+            std::thread::spawn(move || channel.recv())
+        };
+        std::thread::sleep(std::time::Duration::from_millis(20));
+        channel.close();
+        assert_eq!(receiver.join().unwrap(), None);
+    }
+
+    #[test]
+    fn test_channel_mpmc() {
+        const PRODUCERS: usize = 4;
+        const PER_PRODUCER: usize = 10_000;
+        let channel = Channel::<usize>::bounded(64);
+
+        let producers: Vec<_> = (0..PRODUCERS)
+            .map(|p| {
+                let channel = channel.clone();
+                std::thread::spawn(move || {
+                    for i in 0..PER_PRODUCER {
+                        channel.send(p * PER_PRODUCER + i).unwrap();
+                    }
+                })
+            })
+            .collect();
+        let consumers: Vec<_> = (0..4)
+            .map(|_| {
+                let channel = channel.clone();
+                std::thread::spawn(move || {
+                    let mut sum = 0;
+                    let mut batch = Vec::new();
+                    while channel.recv_many(16, &mut batch) > 0 {
+                        sum += batch.drain(..).sum::<usize>();
+                    }
+                    sum
+                })
+            })
+            .collect();
+
+        for p in producers {
+            p.join().unwrap();
+        }
+        channel.close();
+        let total: usize = consumers.into_iter().map(|c| c.join().unwrap()).sum();
+        let n = PRODUCERS * PER_PRODUCER;
+        assert_eq!(total, n * (n - 1) / 2);
+        assert_eq!(channel.stats(), (n, n));
+    }
+
+    #[test]
+    fn test_channel_drops_pending_values() {
+        let value = Arc::new(());
+        let channel = Channel::bounded(4);
+        channel.send(value.clone()).unwrap();
+        channel.send(value.clone()).unwrap();
+        assert_eq!(Arc::strong_count(&value), 3);
+        drop(channel);
+        assert_eq!(Arc::strong_count(&value), 1);
+    }
 }
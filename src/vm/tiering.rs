@@ -0,0 +1,179 @@
+//! Tiering policy and type feedback for hot loops.
+//!
+//! Loops move up from the interpreter through on-stack replacement: once a
+//! backward jump has been taken `osr_threshold` times, the loop is compiled
+//! and the interpreter jumps into the native code at the next backward jump,
+//! handing over its locals. While a loop warms up, the interpreter records
+//! the type of every local at the backward jump. Where that feedback
+//! disagrees with the static local types (generic code, locals holding
+//! null), the loop is compiled speculatively for the observed types, and
+//! each entry checks those types first. An entry that fails the check stays
+//! in the interpreter; after `MAX_DEOPTS` failures the code is dropped and
+//! the loop is recompiled later without speculation.
+
+use super::{Value, ValueType};
+
+/// Guard failures after which speculative loop code is discarded.
+pub const MAX_DEOPTS: u32 = 3;
+
+/// When hot code is compiled.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct TierPolicy {
+    /// Calls before a function is compiled
+    pub call_threshold: u32,
+    /// Backward jumps before a loop is compiled and entered by OSR
+    pub osr_threshold: u32,
+}
+
+impl TierPolicy {
+    /// The default policy for `call_threshold`: a loop iteration is much
+    /// cheaper than a call, and a long-running loop may only ever be
+    /// entered once, so loops are compiled ten times sooner.
+    pub fn from_call_threshold(call_threshold: u32) -> Self {
+        Self {
+            call_threshold,
+            osr_threshold: (call_threshold / 10).max(1),
+        }
+    }
+}
+
+impl Default for TierPolicy {
+    fn default() -> Self {
+        Self::from_call_threshold(1000)
+    }
+}
+
+/// The type of a value as the JIT tags it.
+pub fn value_type_of(value: &Value) -> ValueType {
+    match value {
+        Value::I64(_) | Value::Bool(_) => ValueType::I64,
+        Value::F64(_) => ValueType::F64,
+        Value::Null | Value::Ref(_) => ValueType::Ref,
+    }
+}
+
+/// Whether JIT code treats `a` and `b` alike (same tag).
+pub fn same_tag(a: ValueType, b: ValueType) -> bool {
+    let class = |ty| match ty {
+        ValueType::I32 | ValueType::I64 => ValueType::I64,
+        ValueType::F32 | ValueType::F64 => ValueType::F64,
+        ValueType::Ref => ValueType::Ref,
+    };
+    class(a) == class(b)
+}
+
+/// What the interpreter has seen in one local.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum SlotFeedback {
+    Mono(ValueType),
+    Poly,
+}
+
+/// Interpreter state of one loop: iterations, type feedback and deopts.
+#[derive(Debug, Clone, Default)]
+pub struct LoopProfile {
+    /// Backward jumps taken in the interpreter
+    pub back_edges: u32,
+    /// Types seen in each local at the backward jump
+    feedback: Vec<SlotFeedback>,
+    /// Guard failures of the current code
+    pub deopts: u32,
+    /// Set once speculative code has been discarded
+    pub no_speculation: bool,
+}
+
+impl LoopProfile {
+    /// Record the types of `locals` at the backward jump.
+    pub fn observe(&mut self, locals: &[Value]) {
+        if self.feedback.is_empty() {
+            self.feedback = locals
+                .iter()
+                .map(|v| SlotFeedback::Mono(value_type_of(v)))
+                .collect();
+            return;
+        }
+        for (slot, value) in self.feedback.iter_mut().zip(locals) {
+            if let SlotFeedback::Mono(ty) = *slot
+                && ty != value_type_of(value)
+            {
+                *slot = SlotFeedback::Poly;
+            }
+        }
+    }
+
+    /// Locals to specialize on: those that always held one type, different
+    /// from the static type in `local_types` (missing entries are I64).
+    pub fn speculation(&self, local_types: &[ValueType]) -> Vec<(usize, ValueType)> {
+        if self.no_speculation {
+            return Vec::new();
+        }
+        self.feedback
+            .iter()
+            .enumerate()
+            .filter_map(|(slot, feedback)| match *feedback {
+                SlotFeedback::Mono(ty)
+                    if !same_tag(ty, local_types.get(slot).copied().unwrap_or(ValueType::I64)) =>
+                {
+                    Some((slot, ty))
+                }
+                _ => None,
+            })
+            .collect()
+    }
+
+    /// Start over without speculation, after the loop's code was dropped.
+    pub fn reset_without_speculation(&mut self) {
+        *self = Self {
+            no_speculation: true,
+            ..Self::default()
+        };
+    }
+}
+
+/// Whether `locals` satisfy the type guards of speculative code.
+pub fn guards_hold(guards: &[(usize, ValueType)], locals: &[Value]) -> bool {
+    guards.iter().all(|&(slot, ty)| {
+        locals
+            .get(slot)
+            .is_some_and(|v| same_tag(value_type_of(v), ty))
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::vm::GcRef;
+
+    #[test]
+    fn test_policy_from_call_threshold() {
+        assert_eq!(TierPolicy::default().osr_threshold, 100);
+        assert_eq!(TierPolicy::from_call_threshold(5).osr_threshold, 1);
+    }
+
+    #[test]
+    fn test_speculation_on_feedback() {
+        let string = Value::Ref(GcRef { index: 8 });
+        let mut profile = LoopProfile::default();
+        profile.observe(&[Value::I64(0), string, Value::Null, Value::F64(1.0)]);
+        profile.observe(&[Value::I64(1), string, Value::I64(3), Value::F64(2.0)]);
+
+        // Slot 1 is a Ref typed I64, slot 2 changed type, slot 3 matches
+        let static_types = [
+            ValueType::I64,
+            ValueType::I64,
+            ValueType::Ref,
+            ValueType::F64,
+        ];
+        let guards = profile.speculation(&static_types);
+        assert_eq!(guards, vec![(1, ValueType::Ref)]);
+
+        assert!(guards_hold(&guards, &[Value::I64(5), Value::Null]));
+        assert!(!guards_hold(&guards, &[Value::I64(5), Value::I64(6)]));
+        assert!(!guards_hold(&guards, &[Value::I64(5)]));
+
+        profile.reset_without_speculation();
+        assert_eq!(profile.back_edges, 0);
+        profile.observe(&[Value::I64(0), string]);
+        assert!(profile.speculation(&static_types).is_empty());
+    }
+}
@@ -288,7 +288,26 @@ impl Verifier {
 
     /// Verify stack heights using abstract interpretation
     pub fn verify_stack_heights(&self, func: &Function, cfg: &CFG) -> Result<(), VerifyError> {
+        self.walk_stack_heights(func, cfg).map(|_| ())
+    }
+
+    /// Stack height before each op of a verified function (None for
+    /// unreachable ops).
+    pub fn stack_heights(&self, func: &Function) -> Result<Vec<Option<usize>>, VerifyError> {
+        if func.code.is_empty() {
+            return Err(VerifyError::EmptyFunction);
+        }
+        let cfg = self.build_cfg(func)?;
+        self.walk_stack_heights(func, &cfg)
+    }
+
+    fn walk_stack_heights(
+        &self,
+        func: &Function,
+        cfg: &CFG,
+    ) -> Result<Vec<Option<usize>>, VerifyError> {
         let code = &func.code;
+        let mut heights = vec![None; code.len()];
 
         // Stack height at entry of each block (None = not yet visited)
         let mut block_heights: Vec<Option<usize>> = vec![None; cfg.blocks.len()];
@@ -311,6 +330,7 @@ impl Verifier {
                 .skip(block.start)
                 .take(block.end - block.start)
             {
+                heights[pc] = Some(height);
                 let (pops, pushes) = self.stack_effect(op);
 
                 // Check underflow
@@ -354,7 +374,7 @@ impl Verifier {
             }
         }
 
-        Ok(())
+        Ok(heights)
     }
 
     /// Get the stack effect of an operation: (pops, pushes)
@@ -464,6 +484,7 @@ impl Verifier {
             Op::HeapLoad2(_) => (2, 1),  // pops ref and index, pushes value (indirect via slot 0)
             Op::HeapStore2(_) => (3, 0), // pops ref, index, and value (indirect via slot 0)
             Op::HeapOffsetRef => (2, 1), // pops ref and offset, pushes offset ref
+            Op::HeapBulk(op) => (op.arity(), op.has_result() as usize),
             // System / Builtins
             Op::Hostcall(_, argc) => (*argc, 1), // pops argc args, pushes result
             Op::GcHint(_) => (0, 0),
@@ -480,11 +501,14 @@ impl Verifier {
             Op::Args => (0, 1), // pushes args array
 
             // Thread operations
-            Op::ThreadSpawn(_) => (0, 1), // pushes handle
-            Op::ChannelCreate => (0, 1),  // pushes [sender, receiver]
-            Op::ChannelSend => (2, 0),    // pops channel and value
-            Op::ChannelRecv => (1, 1),    // pops channel, pushes value
-            Op::ThreadJoin => (1, 1),     // pops handle, pushes result
+            Op::ThreadSpawn(_) => (0, 1),       // pushes handle
+            Op::ChannelCreate => (0, 1),        // pushes [sender, receiver]
+            Op::ChannelCreateBounded => (1, 1), // pops capacity, pushes [sender, receiver]
+            Op::ChannelSend => (2, 0),          // pops channel and value
+            Op::ChannelRecv => (1, 1),          // pops channel, pushes value
+            Op::ChannelSendMany => (3, 0),      // pops channel, data and count
+            Op::ChannelRecvMany => (3, 1),      // pops channel, data and max, pushes count
+            Op::ThreadJoin => (1, 1),           // pops handle, pushes result
 
             // Indirect call
             Op::CallIndirect(argc) => (argc + 1, 1), // pops callable ref + argc args, pushes result
@@ -509,7 +533,7 @@ mod tests {
             name: "test".to_string(),
             arity: 0,
             locals_count: 0,
-            code,
+            code: code.into(),
             stackmap: None,
             local_types: vec![],
         }
@@ -540,6 +564,25 @@ mod tests {
         assert_eq!(cfg.blocks[0].end, 2);
     }
 
+    #[test]
+    fn test_stack_heights() {
+        let verifier = Verifier::new();
+        let func = make_func(vec![
+            Op::I64Const(1), // 0: stack=0
+            Op::BrIf(4),     // 1: stack=1
+            Op::I64Const(2), // 2: stack=0
+            Op::Ret,         // 3: stack=1
+            Op::I64Const(3), // 4: stack=0
+            Op::Ret,         // 5: stack=1
+            Op::Ret,         // 6: unreachable
+        ]);
+        let heights = verifier.stack_heights(&func).unwrap();
+        assert_eq!(
+            heights,
+            [Some(0), Some(1), Some(0), Some(1), Some(0), Some(1), None]
+        );
+    }
+
     #[test]
     fn test_stack_height_mismatch() {
         let verifier = Verifier::new();
@@ -629,7 +672,8 @@ mod tests {
                 Op::I64Const(1),
                 Op::Call(0, 0), // safepoint at pc=1
                 Op::Ret,
-            ],
+            ]
+            .into(),
             stackmap: Some(FunctionStackMap::new()), // Empty stackmap
             local_types: vec![],
         };
@@ -661,7 +705,8 @@ mod tests {
                 Op::I64Const(1),
                 Op::Call(0, 0), // safepoint, but no stackmap
                 Op::Ret,
-            ],
+            ]
+            .into(),
             stackmap: None, // No stackmap, verification skipped
             local_types: vec![],
         };
@@ -687,7 +732,8 @@ mod tests {
                 Op::I64Const(2), // height: 2
                 Op::I64Const(3), // height: 3 -> OVERFLOW (max is 2)
                 Op::Ret,
-            ],
+            ]
+            .into(),
             stackmap: None,
             local_types: vec![],
         };
@@ -718,7 +764,8 @@ mod tests {
                 Op::I64Const(2),
                 Op::I64Add,
                 Op::Ret, // Proper return
-            ],
+            ]
+            .into(),
             stackmap: None,
             local_types: vec![],
         };
@@ -746,7 +793,8 @@ mod tests {
                 Op::Jmp(6),       // 4: jumps to 6 with height 2
                 Op::I64Const(3),  // 5: height: 1 (from jump)
                 Op::Ret,          // 6: merge point - heights don't match!
-            ],
+            ]
+            .into(),
             stackmap: None,
             local_types: vec![],
         };
@@ -776,7 +824,8 @@ mod tests {
                 Op::Jmp(5),       // 3: jumps to 5 with height 1
                 Op::I64Const(2),  // 4: height: 1 (from jump)
                 Op::Ret,          // 5: merge point - heights match!
-            ],
+            ]
+            .into(),
             stackmap: None,
             local_types: vec![],
         };
@@ -803,7 +852,8 @@ mod tests {
                 Op::I64Const(0), // 0: function index
                 Op::Call(0, 0),  // 1: CALL is safepoint
                 Op::Ret,         // 2: return
-            ],
+            ]
+            .into(),
             stackmap: Some(stackmap),
             local_types: vec![],
         };
@@ -830,7 +880,8 @@ mod tests {
                 Op::I64Const(20), // 1: slot value
                 Op::HeapAlloc(2), // 2: HeapAlloc is safepoint (allocates heap object)
                 Op::Ret,          // 3: return
-            ],
+            ]
+            .into(),
             stackmap: Some(stackmap),
             local_types: vec![],
         };
@@ -859,7 +910,8 @@ mod tests {
                 Op::Jmp(0),       // 2: backward jump is safepoint, height 0
                 Op::I64Const(0),  // 3: exit point, height 1
                 Op::Ret,          // 4: return
-            ],
+            ]
+            .into(),
             stackmap: Some(stackmap),
             local_types: vec![],
         };
@@ -878,7 +930,8 @@ mod tests {
             code: vec![
                 Op::Jmp(100), // Jump to non-existent instruction
                 Op::Ret,
-            ],
+            ]
+            .into(),
             stackmap: None,
             local_types: vec![],
         };
@@ -909,7 +962,8 @@ mod tests {
                 Op::I64Const(4),
                 Op::I64DivS, // 24 / 4 = 6
                 Op::Ret,
-            ],
+            ]
+            .into(),
             stackmap: None,
             local_types: vec![],
         };
@@ -931,7 +985,8 @@ mod tests {
                 Op::F64Const(4.0),
                 Op::F64Div,
                 Op::Ret,
-            ],
+            ]
+            .into(),
             stackmap: None,
             local_types: vec![],
         };
@@ -956,7 +1011,8 @@ mod tests {
                 Op::F64Lt, // 1.5 < 2.5 = true (i32)
                 Op::I32Eq, // true == true = true (comparing two i32 results)
                 Op::Ret,
-            ],
+            ]
+            .into(),
             stackmap: None,
             local_types: vec![],
         };
@@ -1,12 +1,31 @@
 use std::collections::{HashMap, HashSet};
-use std::fs::{File, OpenOptions};
+use std::fs::OpenOptions;
 use std::io::{self, Read, Write};
-use std::net::{TcpListener, TcpStream};
-use std::sync::Arc;
-
-use crate::vm::threads::{Channel, ThreadSpawner};
+use std::net::TcpListener;
+use std::sync::{Arc, Mutex};
+
+use crate::vm::bulk::BulkOp;
+use crate::vm::concurrent_gc::{ConcurrentGc, GcPhase, GcStats, PauseHistogram};
+use crate::vm::inline_cache::InlineCaches;
+use crate::vm::io::{self as vm_io, Descriptor, FdTable, Interest, IoWait, RawFd};
+use crate::vm::metrics::{EventHandler, VmEvent, VmMetrics};
+use crate::vm::microop::ConvertedFunction;
+use crate::vm::output::{BufferMode, OutputBuffer, PendingWrites, WriteTarget};
+use crate::vm::profiler::SamplingProfiler;
+use crate::vm::scheduler::TaskStatus;
+use crate::vm::threads::{Channel, MAX_CHANNEL_CAPACITY, ThreadSpawner, TrySendError};
+use crate::vm::tiering::{LoopProfile, TierPolicy};
 use crate::vm::{Chunk, ElemKind, Function, GcRef, Heap, Op, Value, ValueType};
 
+#[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+use crate::vm::metrics::Tier;
+#[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+use crate::vm::{profiler, tiering};
+
+#[cfg(all(target_arch = "x86_64", feature = "jit"))]
+use crate::jit::cache::JitCache;
+#[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+use crate::jit::compile_queue::{self, CompileQueue};
 #[cfg(all(target_arch = "aarch64", feature = "jit"))]
 use crate::jit::compiler::{CompiledCode, CompiledLoop};
 #[cfg(all(target_arch = "aarch64", feature = "jit"))]
@@ -19,6 +38,10 @@ use crate::jit::compiler_x86_64::{CompiledCode, CompiledLoop};
 use crate::jit::function_table::JitFunctionTable;
 #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
 use crate::jit::marshal::{JitCallContext, JitReturn, JitValue};
+#[cfg(all(target_arch = "x86_64", feature = "jit"))]
+use crate::jit::stackmap::StackMapTable;
+#[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+use crate::jit::stackmap::{ROOT_STACK_CAPACITY, RootStack};
 
 /// A call frame for the VM.
 #[derive(Debug)]
@@ -51,21 +74,55 @@ struct TryFrame {
 }
 
 /// GC statistics.
+///
+/// With incremental GC every bounded step (initial mark, mark batch, remark,
+/// sweep batch) counts as one pause.
 #[derive(Debug, Clone, Default)]
 pub struct VmGcStats {
     pub cycles: usize,
+    /// Minor (nursery-only) collections
+    pub minor_cycles: usize,
     pub total_pause_us: u64,
     pub max_pause_us: u64,
+    /// Distribution of individual pause times
+    pub pauses: PauseHistogram,
+}
+
+impl VmGcStats {
+    fn record_pause(&mut self, pause_us: u64) {
+        self.total_pause_us += pause_us;
+        self.max_pause_us = self.max_pause_us.max(pause_us);
+        self.pauses.record(pause_us);
+    }
 }
 
+/// Objects traced per incremental mark step.
+const GC_MARK_BATCH: usize = 256;
+/// Heap bytes visited per incremental sweep step.
+const GC_SWEEP_BUDGET: usize = 64 * 1024;
+
 /// Opcode execution profile data.
 #[derive(Debug, Clone, Default)]
 pub struct OpcodeProfile {
     /// Execution counts per opcode name
     pub counts: HashMap<&'static str, u64>,
+    /// Execution counts per pair of opcodes run one after the other, the
+    /// candidates for superinstructions
+    pub pairs: HashMap<(&'static str, &'static str), u64>,
+    /// The opcode recorded last
+    previous: Option<&'static str>,
 }
 
 impl OpcodeProfile {
+    /// Count one execution of `name`, following the previous opcode.
+    pub fn record(&mut self, name: &'static str) {
+        *self.counts.entry(name).or_insert(0) += 1;
+        if let Some(previous) = self.previous {
+            *self.pairs.entry((previous, name)).or_insert(0) += 1;
+        }
+        self.previous = Some(name);
+    }
+
     /// Get total number of executed instructions.
     pub fn total_instructions(&self) -> u64 {
         self.counts.values().sum()
@@ -77,6 +134,123 @@ impl OpcodeProfile {
         entries.sort_by(|a, b| b.1.cmp(&a.1));
         entries
     }
+
+    /// Get opcode pairs sorted by count (descending).
+    pub fn sorted_pairs_by_count(&self) -> Vec<((&'static str, &'static str), u64)> {
+        let mut entries: Vec<_> = self.pairs.iter().map(|(&k, &v)| (k, v)).collect();
+        entries.sort_by(|a, b| b.1.cmp(&a.1).then(a.0.cmp(&b.0)));
+        entries
+    }
+}
+
+/// What the VM of a spawned thread starts from.
+///
+/// Building one copies no code: the chunk and the JIT code compiled so far
+/// are shared with the spawning VM.
+struct ThreadImage {
+    chunk: Arc<Chunk>,
+    jit_enabled: bool,
+    tier_policy: TierPolicy,
+    background_jit: Option<usize>,
+    trace_jit: bool,
+    incremental_gc: bool,
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    jit_functions: Arc<HashMap<usize, Arc<CompiledCode>>>,
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    jit_loops: Arc<HashMap<(usize, usize), Arc<CompiledLoop>>>,
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    jit_function_table: Arc<JitFunctionTable>,
+    channels: Vec<Arc<Channel<Value>>>,
+    descriptors: Arc<Mutex<FdTable>>,
+    output_buffering: BufferMode,
+}
+
+/// A function compiled on the background thread, with the chunk it was
+/// compiled from
+#[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+type BackgroundCompile = (Arc<Chunk>, Result<CompiledCode, String>);
+
+/// Time slice of a green thread, in backward jumps
+const GREEN_SLICE_BACK_EDGES: u32 = 10_000;
+
+// Hostcall numbers
+const HOSTCALL_WRITE: usize = 1;
+const HOSTCALL_OPEN: usize = 2;
+const HOSTCALL_CLOSE: usize = 3;
+const HOSTCALL_READ: usize = 4;
+const HOSTCALL_SOCKET: usize = 5;
+const HOSTCALL_CONNECT: usize = 6;
+const HOSTCALL_BIND: usize = 7;
+const HOSTCALL_LISTEN: usize = 8;
+const HOSTCALL_ACCEPT: usize = 9;
+const HOSTCALL_TIME: usize = 10;
+const HOSTCALL_TIME_NANOS: usize = 11;
+
+/// Outcome of running a hostcall once.
+enum HostcallPoll {
+    Ready(Value),
+    /// The socket is not ready for the given direction; retry when it is
+    Pending(RawFd, Interest),
+}
+
+/// A spawned thread running on the green-thread scheduler.
+///
+/// Its VM is created on the first time slice, on whichever worker picks the
+/// task up, and keeps its frames between slices.
+struct GreenThread {
+    start: Option<(ThreadImage, usize)>,
+    vm: Option<(Box<VM>, Arc<Chunk>)>,
+}
+
+impl GreenThread {
+    fn new(image: ThreadImage, func_index: usize) -> Self {
+        Self {
+            start: Some((image, func_index)),
+            vm: None,
+        }
+    }
+
+    /// Run one time slice. Errors end the thread with a null result, as on
+    /// OS threads.
+    fn resume(&mut self) -> TaskStatus {
+        self.run_slice().unwrap_or(TaskStatus::Done(Value::Null))
+    }
+
+    fn run_slice(&mut self) -> Result<TaskStatus, String> {
+        if let Some((image, func_index)) = self.start.take() {
+            let (mut vm, chunk) = VM::thread_vm(image)?;
+            if let Some(value) = vm.start_green(&chunk, func_index)? {
+                return Ok(TaskStatus::Done(value));
+            }
+            self.vm = Some((Box::new(vm), chunk));
+        }
+        let (vm, chunk) = self.vm.as_mut().expect("green thread was started");
+        vm.resume_green(chunk)
+    }
+}
+
+/// Whether a blocking op can run on a green thread right now.
+#[derive(PartialEq)]
+enum OpPoll {
+    /// `execute_op` will not block (or will report an error)
+    Run,
+    /// The op already completed
+    Done,
+    /// The op would block; yield and retry it later
+    Blocked,
+}
+
+/// Heap and runtime tables of a prepared VM, captured by `VM::snapshot`.
+///
+/// Restoring a snapshot into a new VM skips `prepare` and whatever
+/// initialization code already ran on the original.
+pub struct VmSnapshot {
+    heap: Heap,
+    globals: Vec<Value>,
+    host_globals: HashMap<String, Value>,
+    string_cache: Vec<Option<GcRef>>,
+    /// Marking state, in case the snapshot was taken mid-cycle
+    gc: ConcurrentGc,
 }
 
 /// The moca virtual machine.
@@ -91,71 +265,126 @@ pub struct VM {
     jit_enabled: bool,
     /// JIT threshold
     jit_threshold: u32,
+    /// Backward jumps before a loop is compiled (see `TierPolicy`)
+    osr_threshold: u32,
     /// Whether to trace JIT events
     trace_jit: bool,
     /// GC statistics
     gc_stats: VmGcStats,
+    /// Whether to collect incrementally instead of stopping the world
+    incremental_gc: bool,
+    /// Marking state (gray list, SATB buffer) of the incremental collector
+    concurrent_gc: ConcurrentGc,
     /// Thread spawner for managing spawned threads
     thread_spawner: ThreadSpawner,
+    /// The running chunk as shared with spawned threads, keyed by the address
+    /// of the chunk it stands for
+    shared_chunk: Option<(usize, Arc<Chunk>)>,
     /// Channels for inter-thread communication (id -> channel)
     channels: Vec<Arc<Channel<Value>>>,
+    /// Ids of async host results not yet received
+    pending_async: HashSet<usize>,
+    /// Ids of received async results, ready for the next `create_async_channel`
+    free_async: Vec<usize>,
+    /// Depth of the entry frame when running as a green thread; the dispatch
+    /// loop started at that depth may yield to the scheduler
+    green_entry_depth: Option<usize>,
+    /// Set when the dispatch loop returned to yield rather than to finish
+    task_yield: Option<TaskStatus>,
+    /// Backward jumps left in the current time slice
+    slice_budget: u32,
     /// JIT compiled functions (only on AArch64 with jit feature)
     #[cfg(all(target_arch = "aarch64", feature = "jit"))]
-    jit_functions: HashMap<usize, CompiledCode>,
+    jit_functions: Arc<HashMap<usize, Arc<CompiledCode>>>,
     /// JIT compiled functions (only on x86-64 with jit feature)
     #[cfg(all(target_arch = "x86_64", feature = "jit"))]
-    jit_functions: HashMap<usize, CompiledCode>,
+    jit_functions: Arc<HashMap<usize, Arc<CompiledCode>>>,
     /// Number of JIT compilations performed
     jit_compile_count: usize,
-    /// Function table for JIT direct call dispatch
+    /// JIT compilations that failed
+    jit_failures: u64,
+    /// Entries into speculative loop code that failed a type guard
+    jit_deopts: u64,
+    /// Machine code bytes compiled
+    jit_code_bytes: u64,
+    /// Receives runtime events (GC pauses, JIT compilations, heap growth)
+    event_handler: Option<EventHandler>,
+    /// Heap size last reported in a `HeapGrow` event
+    reported_heap_bytes: usize,
+    /// Function table for JIT direct call dispatch.
+    ///
+    /// Compiled code and the tables are shared with spawned threads and
+    /// copied on write.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    jit_function_table: Arc<JitFunctionTable>,
+    /// Function tables replaced while shared, kept alive for JIT code that
+    /// may still be running with their address
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    retired_jit_tables: Vec<Arc<JitFunctionTable>>,
+    /// Where JIT code copies the references in its frames at GC safepoints
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    jit_roots: Box<RootStack>,
+    /// Queue depth when hot functions are compiled on a background thread
+    background_jit: Option<usize>,
+    /// The background compile thread, started by the first hot function
     #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
-    jit_function_table: JitFunctionTable,
+    compile_queue: Option<CompileQueue<BackgroundCompile>>,
+    /// Persistent compiled-code cache: consulted by `prepare`, filled by compilation
+    #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+    jit_cache: Option<JitCache>,
     /// Output stream for print statements (stdout)
-    output: Box<dyn Write>,
-    /// Output stream for stderr
-    stderr: Box<dyn Write>,
-    /// File descriptor table for open files (fd >= 3)
-    file_descriptors: HashMap<i64, File>,
-    /// Socket descriptor table for TCP connections (fd >= 3)
-    socket_descriptors: HashMap<i64, TcpStream>,
-    /// Pending socket fds (created by socket() but not yet connected)
-    pending_sockets: HashSet<i64>,
-    /// Listener descriptor table for TCP servers (fd >= 3)
-    listener_descriptors: HashMap<i64, TcpListener>,
-    /// Next available file descriptor
-    next_fd: i64,
+    output: OutputBuffer,
+    /// Output stream for stderr (unbuffered)
+    stderr: OutputBuffer,
+    /// Writes to files and sockets not yet sent, coalesced per fd
+    pending_writes: PendingWrites,
+    /// Open files and sockets (fd >= 3), shared with spawned threads
+    descriptors: Arc<Mutex<FdTable>>,
+    /// The fd a green thread is suspended on in a hostcall
+    io_wait: Option<IoWait>,
     /// Command-line arguments passed to the script
     cli_args: Vec<String>,
     /// Whether opcode profiling is enabled
     profile_opcodes: bool,
     /// Opcode execution counts for profiling
     opcode_profile: OpcodeProfile,
+    /// Call-stack sampler, while sampling or until its samples are dropped
+    sampler: Option<SamplingProfiler>,
     /// String constant cache: maps string index to heap reference
     /// Once a string constant is allocated, it's cached here for reuse.
     string_cache: Vec<Option<GcRef>>,
-    /// Loop iteration counters for hot loop detection.
-    /// Key: (function_index, backward_jump_pc), Value: iteration count
-    loop_counts: HashMap<(usize, usize), u32>,
+    /// Iteration counts and type feedback for hot loop detection.
+    /// Key: (function_index, backward_jump_pc)
+    loop_counts: HashMap<(usize, usize), LoopProfile>,
     /// JIT compiled loops (only on AArch64 with jit feature)
     #[cfg(all(target_arch = "aarch64", feature = "jit"))]
-    jit_loops: HashMap<(usize, usize), CompiledLoop>,
+    jit_loops: Arc<HashMap<(usize, usize), Arc<CompiledLoop>>>,
     /// JIT compiled loops (only on x86-64 with jit feature)
     #[cfg(all(target_arch = "x86_64", feature = "jit"))]
-    jit_loops: HashMap<(usize, usize), CompiledLoop>,
+    jit_loops: Arc<HashMap<(usize, usize), Arc<CompiledLoop>>>,
     /// Whether to use the MicroOp interpreter instead of the stack-based interpreter
     use_microop: bool,
     /// Global values table.
     /// Layout: globals[0..T] = type descriptor refs, globals[T..T+I] = interface descriptor refs.
     globals: Vec<Value>,
+    /// Named values the embedder stores with `moca_set_global`. They are GC
+    /// roots, so an object held only by a host global survives calls.
+    host_globals: HashMap<String, Value>,
+    /// MicroOp conversion cache (indexed by func_index), kept across
+    /// `call_function` entries so host-driven calls convert each callee once.
+    microop_cache: Vec<Option<ConvertedFunction>>,
+    /// Inline caches of the VtableLookup / CallIndirect / CallDynamic sites
+    inline_caches: InlineCaches,
 }
 
 impl VM {
     pub fn new() -> Self {
-        Self::new_with_config(None, true, Box::new(io::stdout()), Box::new(io::stderr()))
+        Self::new_with_heap_config(None, true)
     }
 
-    /// Create a VM with a custom output stream.
-    pub fn with_output(output: Box<dyn Write>) -> Self {
+    /// Create a VM with a custom output stream. Output is block buffered and
+    /// flushed when the VM returns to the caller.
+    pub fn with_output(output: Box<dyn Write + Send>) -> Self {
         Self::new_with_config(None, true, output, Box::new(io::stderr()))
     }
 
@@ -165,12 +394,14 @@ impl VM {
     /// * `heap_limit` - Hard limit on heap size in bytes (None = unlimited)
     /// * `gc_enabled` - Whether GC is enabled
     pub fn new_with_heap_config(heap_limit: Option<usize>, gc_enabled: bool) -> Self {
-        Self::new_with_config(
+        let mut vm = Self::new_with_config(
             heap_limit,
             gc_enabled,
             Box::new(io::stdout()),
             Box::new(io::stderr()),
-        )
+        );
+        vm.output = OutputBuffer::new(Box::new(io::stdout()), BufferMode::for_stdout());
+        vm
     }
 
     /// Create a new VM with full configuration.
@@ -183,46 +414,73 @@ impl VM {
     pub fn new_with_config(
         heap_limit: Option<usize>,
         gc_enabled: bool,
-        output: Box<dyn Write>,
-        stderr: Box<dyn Write>,
+        output: Box<dyn Write + Send>,
+        stderr: Box<dyn Write + Send>,
     ) -> Self {
+        let mut heap = Heap::new_with_config(heap_limit, gc_enabled);
+        heap.set_nursery(Some(Heap::NURSERY_BYTES));
         Self {
             stack: Vec::with_capacity(1024),
             frames: Vec::with_capacity(64),
-            heap: Heap::new_with_config(heap_limit, gc_enabled),
+            heap,
             try_frames: Vec::new(),
             call_counts: Vec::new(),
             jit_enabled: true,
             jit_threshold: 1000,
+            osr_threshold: TierPolicy::default().osr_threshold,
             trace_jit: false,
             gc_stats: VmGcStats::default(),
+            incremental_gc: false,
+            concurrent_gc: ConcurrentGc::new(true),
             thread_spawner: ThreadSpawner::new(),
+            shared_chunk: None,
             channels: Vec::new(),
+            pending_async: HashSet::new(),
+            free_async: Vec::new(),
+            green_entry_depth: None,
+            task_yield: None,
+            slice_budget: GREEN_SLICE_BACK_EDGES,
             #[cfg(all(target_arch = "aarch64", feature = "jit"))]
-            jit_functions: HashMap::new(),
+            jit_functions: Arc::default(),
             #[cfg(all(target_arch = "x86_64", feature = "jit"))]
-            jit_functions: HashMap::new(),
+            jit_functions: Arc::default(),
             jit_compile_count: 0,
+            jit_failures: 0,
+            jit_deopts: 0,
+            jit_code_bytes: 0,
+            event_handler: None,
+            reported_heap_bytes: 0,
+            #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+            jit_function_table: Arc::new(JitFunctionTable::new(0)),
+            #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+            retired_jit_tables: Vec::new(),
             #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
-            jit_function_table: JitFunctionTable::new(0),
-            output,
-            stderr,
-            file_descriptors: HashMap::new(),
-            socket_descriptors: HashMap::new(),
-            pending_sockets: HashSet::new(),
-            listener_descriptors: HashMap::new(),
-            next_fd: 3, // fd 0, 1, 2 are reserved for stdin, stdout, stderr
+            jit_roots: Box::new(RootStack::new(ROOT_STACK_CAPACITY)),
+            background_jit: None,
+            #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+            compile_queue: None,
+            #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+            jit_cache: None,
+            output: OutputBuffer::new(output, BufferMode::Block),
+            stderr: OutputBuffer::new(stderr, BufferMode::Unbuffered),
+            pending_writes: PendingWrites::default(),
+            descriptors: Arc::new(Mutex::new(FdTable::new())),
+            io_wait: None,
             cli_args: Vec::new(),
             profile_opcodes: false,
             opcode_profile: OpcodeProfile::default(),
+            sampler: None,
             string_cache: Vec::new(),
             loop_counts: HashMap::new(),
             #[cfg(all(target_arch = "aarch64", feature = "jit"))]
-            jit_loops: HashMap::new(),
+            jit_loops: Arc::default(),
             #[cfg(all(target_arch = "x86_64", feature = "jit"))]
-            jit_loops: HashMap::new(),
+            jit_loops: Arc::default(),
             use_microop: true,
             globals: Vec::new(),
+            host_globals: HashMap::new(),
+            microop_cache: Vec::new(),
+            inline_caches: InlineCaches::default(),
         }
     }
 
@@ -255,7 +513,7 @@ impl VM {
             let tag_idx = chunk
                 .strings
                 .iter()
-                .position(|s| s == &td.tag_name)
+                .position(|s| s == td.tag_name)
                 .unwrap_or(0);
             slots.push(Value::I64(tag_idx as i64));
 
@@ -378,8 +636,8 @@ impl VM {
         }
 
         // Allocate and cache
-        let s = chunk.strings.get(idx).cloned().unwrap_or_default();
-        let r = self.heap.alloc_string(s)?;
+        let s = chunk.strings.get(idx).unwrap_or_default();
+        let r = self.heap.alloc_string_bytes(s.as_bytes())?;
 
         // Store in cache
         if idx < self.string_cache.len() {
@@ -396,12 +654,45 @@ impl VM {
     }
 
     /// Configure JIT settings.
+    ///
+    /// Loops are compiled after the default number of iterations for
+    /// `threshold`; `set_tier_policy` sets both thresholds.
     pub fn set_jit_config(&mut self, enabled: bool, threshold: u32, trace: bool) {
         self.jit_enabled = enabled;
         self.jit_threshold = threshold;
+        self.osr_threshold = TierPolicy::from_call_threshold(threshold).osr_threshold;
         self.trace_jit = trace;
     }
 
+    /// Set when functions and loops are compiled.
+    pub fn set_tier_policy(&mut self, policy: TierPolicy) {
+        self.jit_threshold = policy.call_threshold;
+        self.osr_threshold = policy.osr_threshold;
+    }
+
+    pub fn tier_policy(&self) -> TierPolicy {
+        TierPolicy {
+            call_threshold: self.jit_threshold,
+            osr_threshold: self.osr_threshold,
+        }
+    }
+
+    /// Compile hot functions on a background thread, keeping at most
+    /// `queue_depth` waiting, or (None) on the thread that calls them.
+    ///
+    /// In the background a function keeps being interpreted until its code
+    /// is ready, instead of the call that made it hot waiting for the
+    /// compiler. Hot loops are still compiled right away so OSR can enter
+    /// them.
+    pub fn set_background_jit(&mut self, queue_depth: Option<usize>) {
+        self.background_jit = queue_depth;
+        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+        if queue_depth.is_none() {
+            self.finish_background_jit();
+            self.compile_queue = None;
+        }
+    }
+
     /// Enable or disable opcode profiling.
     pub fn set_profile_opcodes(&mut self, enabled: bool) {
         self.profile_opcodes = enabled;
@@ -412,12 +703,39 @@ impl VM {
         &self.opcode_profile
     }
 
+    /// Start sampling call stacks every `interval`, dropping earlier samples.
+    pub fn start_sampling(&mut self, interval: std::time::Duration) {
+        self.sampler = Some(SamplingProfiler::start(interval));
+    }
+
+    /// Stop sampling. The samples stay available to `folded_stacks`.
+    pub fn stop_sampling(&mut self) {
+        if let Some(sampler) = &mut self.sampler {
+            sampler.stop();
+        }
+    }
+
+    pub fn sampler(&self) -> Option<&SamplingProfiler> {
+        self.sampler.as_ref()
+    }
+
+    /// The call-stack samples of `chunk` in folded-stack format.
+    pub fn folded_stacks(&self, chunk: &Chunk) -> String {
+        let Some(sampler) = &self.sampler else {
+            return String::new();
+        };
+        sampler.folded(|func_index| match chunk.functions.get(func_index) {
+            Some(func) => func.name.clone(),
+            None => chunk.main.name.clone(),
+        })
+    }
+
     /// Record an opcode execution for profiling.
     /// This is public so JIT helpers can also record their operations.
     #[inline]
     pub fn record_opcode(&mut self, name: &'static str) {
         if self.profile_opcodes {
-            *self.opcode_profile.counts.entry(name).or_insert(0) += 1;
+            self.opcode_profile.record(name);
         }
     }
 
@@ -441,11 +759,125 @@ impl VM {
         &self.cli_args
     }
 
+    /// Set how stdout is buffered. `Unbuffered` also sends each write to a
+    /// file or socket right away instead of coalescing them.
+    ///
+    /// Threads spawned afterwards inherit the mode.
+    pub fn set_output_buffering(&mut self, mode: BufferMode) -> io::Result<()> {
+        self.pending_writes.flush()?;
+        self.output.set_mode(mode)
+    }
+
+    /// How stdout is buffered.
+    pub fn output_buffering(&self) -> BufferMode {
+        self.output.mode()
+    }
+
+    /// Send stdout to `output` from now on, after flushing what is buffered.
+    pub fn set_output(&mut self, output: Box<dyn Write + Send>) -> io::Result<()> {
+        self.output.set_inner(output)
+    }
+
+    /// Write out buffered stdout and stderr bytes and queued file and socket
+    /// writes.
+    ///
+    /// The VM flushes before `run` and `call_function` return, on thread
+    /// and channel ops, before any hostcall other than `write`, and when it
+    /// is dropped.
+    pub fn flush_output(&mut self) -> io::Result<()> {
+        let pending = self.pending_writes.flush();
+        let output = self.output.flush();
+        let stderr = self.stderr.flush();
+        pending.and(output).and(stderr)
+    }
+
     /// Get GC statistics.
     pub fn gc_stats(&self) -> &VmGcStats {
         &self.gc_stats
     }
 
+    /// Snapshot of the VM's runtime counters.
+    pub fn metrics(&self) -> VmMetrics {
+        let (allocated_bytes, allocated_objects) = self.heap.allocation_totals();
+        let (channel_sends, channel_receives) =
+            self.channels
+                .iter()
+                .fold((0, 0), |(sent, received), channel| {
+                    let (s, r) = channel.stats();
+                    (sent + s as u64, received + r as u64)
+                });
+        let gc = &self.gc_stats;
+        VmMetrics {
+            gc_cycles: gc.cycles as u64,
+            gc_minor_cycles: gc.minor_cycles as u64,
+            gc_pauses: gc.pauses.count(),
+            gc_pause_us: gc.total_pause_us,
+            gc_max_pause_us: gc.max_pause_us,
+            gc_pause_p50_us: gc.pauses.percentile_us(0.50),
+            gc_pause_p99_us: gc.pauses.percentile_us(0.99),
+            heap_bytes: self.heap.memory_size(),
+            heap_live_bytes: self.heap.bytes_allocated(),
+            allocated_bytes,
+            allocated_objects,
+            jit_compiles: self.jit_compile_count as u64,
+            jit_failures: self.jit_failures,
+            jit_deopts: self.jit_deopts,
+            jit_code_bytes: self.jit_code_bytes,
+            channel_sends,
+            channel_receives,
+        }
+    }
+
+    /// Install the handler that receives runtime events, or remove it.
+    pub fn set_event_handler(&mut self, handler: Option<EventHandler>) {
+        self.reported_heap_bytes = self.heap.memory_size();
+        self.event_handler = handler;
+    }
+
+    #[inline]
+    pub(crate) fn emit(&mut self, event: VmEvent) {
+        if let Some(handler) = &mut self.event_handler {
+            handler(&event);
+        }
+    }
+
+    /// Count a successful compilation of `name` (or a loop in it) and
+    /// report it.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn note_jit_compiled(&mut self, name: &str, is_loop: bool, code_size: usize, tier: Tier) {
+        self.jit_compile_count += 1;
+        self.jit_code_bytes += code_size as u64;
+        if self.event_handler.is_some() {
+            self.emit(VmEvent::JitCompile {
+                name,
+                is_loop,
+                code_size,
+            });
+            self.emit(VmEvent::TierChange {
+                name,
+                is_loop,
+                tier,
+            });
+        }
+    }
+
+    /// Phase statistics of the incremental collector.
+    pub fn incremental_gc_stats(&self) -> &GcStats {
+        self.concurrent_gc.stats()
+    }
+
+    /// Enable or disable incremental garbage collection.
+    ///
+    /// When enabled, a collection marks and sweeps in bounded steps at
+    /// interpreter safepoints instead of in one stop-the-world pause.
+    /// Disabling finishes a cycle that is in progress.
+    pub fn set_incremental_gc(&mut self, enabled: bool) {
+        if !enabled {
+            self.finish_gc_cycle();
+        }
+        self.incremental_gc = enabled;
+    }
+
     /// Get immutable reference to the heap.
     pub fn heap(&self) -> &Heap {
         &self.heap
@@ -456,6 +888,12 @@ impl VM {
         &mut self.heap
     }
 
+    /// Get mutable reference to the operand stack (used by the FFI to pass
+    /// arguments and results without copying through an intermediate buffer).
+    pub(crate) fn stack_mut(&mut self) -> &mut Vec<Value> {
+        &mut self.stack
+    }
+
     /// Initialize call counts for a chunk.
     fn init_call_counts(&mut self, chunk: &Chunk) {
         self.call_counts = vec![0; chunk.functions.len()];
@@ -471,9 +909,19 @@ impl VM {
             return false;
         }
 
+        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+        if self
+            .compile_queue
+            .as_ref()
+            .is_some_and(|queue| queue.has_finished())
+        {
+            self.install_background_jit();
+        }
+
         self.call_counts[func_index] += 1;
+        let calls = self.call_counts[func_index];
 
-        if self.call_counts[func_index] == self.jit_threshold {
+        if calls == self.jit_threshold {
             if self.trace_jit {
                 eprintln!(
                     "[JIT] Hot function detected: {} (calls: {})",
@@ -483,20 +931,89 @@ impl VM {
             return true;
         }
 
+        // A function still waiting for the compile thread moves up the
+        // queue each time its call count doubles
+        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+        if calls > self.jit_threshold
+            && (calls - self.jit_threshold).is_power_of_two()
+            && let Some(queue) = &self.compile_queue
+        {
+            queue.bump(func_index, u64::from(calls));
+        }
+
         false
     }
 
+    /// Count a backward jump at `back_jump_pc`. Until the loop is hot, also
+    /// record the types of the frame's locals for the JIT.
+    fn count_back_edge(&mut self, chunk: &Chunk, func_index: usize, back_jump_pc: usize) {
+        let profile = self
+            .loop_counts
+            .entry((func_index, back_jump_pc))
+            .or_default();
+        profile.back_edges = profile.back_edges.saturating_add(1);
+        if !self.jit_enabled || profile.back_edges > self.osr_threshold {
+            return;
+        }
+        let locals_count = if func_index == usize::MAX {
+            chunk.main.locals_count
+        } else {
+            chunk.functions[func_index].locals_count
+        };
+        let stack_base = self.frames.last().unwrap().stack_base;
+        let end = (stack_base + locals_count).min(self.stack.len());
+        profile.observe(&self.stack[stack_base.min(end)..end]);
+    }
+
     /// Check if a loop should be JIT compiled based on iteration count.
-    /// Returns true when the loop reaches the hot threshold and JIT is enabled.
+    /// Returns true when the loop reaches the OSR threshold and JIT is enabled.
     fn should_jit_compile_loop(&self, func_index: usize, back_jump_pc: usize) -> bool {
         if !self.jit_enabled {
             return false;
         }
         let key = (func_index, back_jump_pc);
-        if let Some(&count) = self.loop_counts.get(&key) {
-            count == self.jit_threshold
-        } else {
-            false
+        self.loop_counts
+            .get(&key)
+            .is_some_and(|profile| profile.back_edges == self.osr_threshold)
+    }
+
+    /// Locals to specialize a loop's code on, from the interpreter's type
+    /// feedback.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn loop_speculation(&self, key: (usize, usize), func: &Function) -> Vec<(usize, ValueType)> {
+        self.loop_counts
+            .get(&key)
+            .map(|profile| profile.speculation(&func.local_types))
+            .unwrap_or_default()
+    }
+
+    /// Handle a failed type guard on entry to speculative loop code: the
+    /// interpreter runs this iteration, and after `MAX_DEOPTS` failures the
+    /// code is dropped so the loop gets recompiled without speculation.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn deoptimize_loop(&mut self, key: (usize, usize), func: &Function) {
+        self.jit_deopts += 1;
+        let profile = self.loop_counts.entry(key).or_default();
+        profile.deopts += 1;
+        let discard = profile.deopts >= tiering::MAX_DEOPTS;
+        if discard {
+            profile.reset_without_speculation();
+            Arc::make_mut(&mut self.jit_loops).remove(&key);
+        }
+        if self.trace_jit {
+            eprintln!(
+                "[JIT] Deoptimized loop in '{}' at PC {}{}",
+                func.name,
+                key.1,
+                if discard { ", code discarded" } else { "" }
+            );
+        }
+        if discard && self.event_handler.is_some() {
+            self.emit(VmEvent::TierChange {
+                name: &func.name,
+                is_loop: true,
+                tier: Tier::Interpreter,
+            });
         }
     }
 
@@ -512,45 +1029,176 @@ impl VM {
         self.jit_enabled && self.jit_loops.contains_key(&(func_index, back_jump_pc))
     }
 
-    /// Compile a function to native code (AArch64 with jit feature only).
-    /// Uses MicroOp-based JIT compiler which takes register-based IR as input.
-    #[cfg(all(target_arch = "aarch64", feature = "jit"))]
-    fn jit_compile_function(&mut self, func: &Function, func_index: usize) {
+    /// Compile a hot function to native code: right away or, with background
+    /// JIT, on the compile thread while the interpreter keeps running it.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn jit_compile_function(&mut self, func_index: usize, chunk: &Chunk) {
         if self.jit_functions.contains_key(&func_index) {
             return; // Already compiled
         }
+        if chunk.functions[func_index].code.decode().is_err() {
+            return; // Corrupt body; the interpreter reports it
+        }
+        if self.background_jit.is_some() && self.submit_jit_compile(func_index, chunk) {
+            return;
+        }
+        #[cfg(target_arch = "x86_64")]
+        let compiled = Self::compile_function_code(
+            func_index,
+            &chunk.functions,
+            self.inline_caches.call_targets(func_index),
+        );
+        #[cfg(target_arch = "aarch64")]
+        let compiled = Self::compile_function_code(func_index, &chunk.functions);
+        self.install_jit_function(func_index, &chunk.functions, compiled);
+    }
 
-        // Convert to MicroOp IR first
-        use super::microop_converter;
-        let converted = microop_converter::convert(func);
+    /// Compile function `func_index` with the MicroOp JIT (AArch64 with jit
+    /// feature only). Touches no VM state, so it can run on any thread.
+    #[cfg(all(target_arch = "aarch64", feature = "jit"))]
+    fn compile_function_code(
+        func_index: usize,
+        all_functions: &[Function],
+    ) -> Result<CompiledCode, String> {
+        let func = &all_functions[func_index];
+        let converted = super::microop_converter::convert(func);
+        MicroOpJitCompiler::new().compile(&converted, func.locals_count, func_index)
+    }
 
-        let compiler = MicroOpJitCompiler::new();
-        match compiler.compile(&converted, func.locals_count, func_index) {
-            Ok(compiled) => {
-                if self.trace_jit {
-                    eprintln!(
-                        "[JIT/MicroOp] Compiled function '{}' ({} bytes)",
-                        func.name,
-                        compiled.memory.size()
-                    );
+    /// Compile function `func_index` with the MicroOp JIT (x86-64 with jit
+    /// feature only). Touches no VM state, so it can run on any thread.
+    /// Frame layout: unboxed, 8B per VReg slot (payload only).
+    #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+    fn compile_function_code(
+        func_index: usize,
+        all_functions: &[Function],
+        call_targets: Vec<Vec<usize>>,
+    ) -> Result<CompiledCode, String> {
+        let func = &all_functions[func_index];
+        let converted = super::microop_converter::convert(func);
+        MicroOpJitCompiler::new()
+            .with_call_targets(call_targets)
+            .compile(&converted, func.locals_count, func_index, all_functions)
+    }
+
+    /// Queue function `func_index` on the compile thread, started on first
+    /// use. Returns false if the thread cannot be started; background JIT
+    /// is then turned off and the caller compiles synchronously.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn submit_jit_compile(&mut self, func_index: usize, chunk: &Chunk) -> bool {
+        if self.compile_queue.is_none() {
+            let depth = self.background_jit.unwrap_or(compile_queue::DEFAULT_DEPTH);
+            match CompileQueue::new(depth) {
+                Ok(queue) => self.compile_queue = Some(queue),
+                Err(_) => {
+                    self.background_jit = None;
+                    return false;
                 }
-                // Update function table with entry point for direct call dispatch
-                let entry: unsafe extern "C" fn(*mut u8, *mut u64, *mut u64) -> JitReturn =
-                    unsafe { compiled.entry_point() };
-                self.jit_function_table.update(
-                    func_index,
-                    entry as usize as u64,
-                    compiled.total_regs,
+            }
+        }
+
+        let snapshot = self.shared_chunk(chunk);
+        #[cfg(target_arch = "x86_64")]
+        let call_targets = self.inline_caches.call_targets(func_index);
+        let job = move || {
+            #[cfg(target_arch = "x86_64")]
+            let compiled =
+                Self::compile_function_code(func_index, &snapshot.functions, call_targets);
+            #[cfg(target_arch = "aarch64")]
+            let compiled = Self::compile_function_code(func_index, &snapshot.functions);
+            (snapshot, compiled)
+        };
+        let hotness = u64::from(self.call_counts[func_index]);
+        let queue = self.compile_queue.as_ref().expect("queue was just started");
+        let dropped = queue.submit(func_index, hotness, job);
+        if self.trace_jit {
+            eprintln!(
+                "[JIT/MicroOp] Queued '{}' for background compilation",
+                chunk.functions[func_index].name
+            );
+        }
+        if let Some(dropped) = dropped {
+            // Cold enough to wait: it is queued again if it reaches the
+            // threshold once more
+            self.call_counts[dropped] = 0;
+            if self.trace_jit {
+                eprintln!(
+                    "[JIT/MicroOp] Compile queue full, dropped '{}'",
+                    chunk.functions[dropped].name
                 );
-                self.jit_functions.insert(func_index, compiled);
-                self.jit_compile_count += 1;
             }
+        }
+        true
+    }
+
+    /// Publish the functions the compile thread has finished.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn install_background_jit(&mut self) {
+        let Some(queue) = &self.compile_queue else {
+            return;
+        };
+        for (func_index, (snapshot, compiled)) in queue.take_finished() {
+            self.install_jit_function(func_index, &snapshot.functions, compiled);
+        }
+    }
+
+    /// Wait for the compile thread to finish its queue and publish the
+    /// results, so every function that got hot so far runs natively.
+    pub fn finish_background_jit(&mut self) {
+        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+        if let Some(queue) = &self.compile_queue {
+            queue.wait_idle();
+            self.install_background_jit();
+        }
+    }
+
+    /// Make a compiled function callable: record it in the code cache and
+    /// the function table, and count it.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn install_jit_function(
+        &mut self,
+        func_index: usize,
+        all_functions: &[Function],
+        compiled: Result<CompiledCode, String>,
+    ) {
+        let func = &all_functions[func_index];
+        let compiled = match compiled {
+            Ok(compiled) => compiled,
             Err(e) => {
+                self.jit_failures += 1;
                 if self.trace_jit {
                     eprintln!("[JIT/MicroOp] Failed to compile '{}': {}", func.name, e);
                 }
+                return;
             }
+        };
+        if self.jit_functions.contains_key(&func_index) {
+            return;
+        }
+        if self.trace_jit {
+            eprintln!(
+                "[JIT/MicroOp] Compiled function '{}' ({} bytes)",
+                func.name,
+                compiled.memory.size()
+            );
+        }
+        #[cfg(target_arch = "x86_64")]
+        if let Some(cache) = &mut self.jit_cache {
+            cache.insert(
+                JitCache::function_key(all_functions, func, func_index),
+                compiled.memory.code(),
+                compiled.entry_offset,
+                compiled.total_regs,
+            );
         }
+        // Update function table with entry point for direct call dispatch
+        let entry: unsafe extern "C" fn(*mut u8, *mut u64, *mut u64) -> JitReturn =
+            unsafe { compiled.entry_point() };
+        self.update_jit_function_table(func_index, entry as usize as u64, compiled.total_regs);
+        profiler::record_jit_code(compiled.memory.code(), || format!("moca::{}", func.name));
+        let code_size = compiled.memory.code().len();
+        Arc::make_mut(&mut self.jit_functions).insert(func_index, Arc::new(compiled));
+        self.note_jit_compiled(&func.name, false, code_size, Tier::Baseline);
     }
 
     /// Check if a function has been JIT compiled (AArch64 with jit feature only).
@@ -559,57 +1207,163 @@ impl VM {
         self.jit_functions.contains_key(&func_index)
     }
 
-    /// Compile a function to native code (x86-64 with jit feature only).
-    /// Uses MicroOp-based JIT compiler which takes register-based IR as input.
-    /// Frame layout: unboxed, 8B per VReg slot (payload only).
+    /// Check if a function has been JIT compiled (x86-64 with jit feature only).
     #[cfg(all(target_arch = "x86_64", feature = "jit"))]
-    fn jit_compile_function(
+    fn is_jit_compiled(&self, func_index: usize) -> bool {
+        self.jit_functions.contains_key(&func_index)
+    }
+
+    /// Run the callee of an indirect or dynamic call as JIT code once it is
+    /// hot. `closure`, if any, is passed ahead of `args`. Returns None while
+    /// the callee stays interpreted.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn try_jit_call(
         &mut self,
-        func: &Function,
         func_index: usize,
-        all_functions: &[Function],
-    ) {
-        if self.jit_functions.contains_key(&func_index) {
-            return; // Already compiled
+        closure: Option<Value>,
+        args: &[super::microop::VReg],
+        chunk: &Chunk,
+    ) -> Result<Option<Value>, String> {
+        let callee_func = &chunk.functions[func_index];
+        if self.should_jit_compile(func_index, &callee_func.name) {
+            self.jit_compile_function(func_index, chunk);
+        }
+        if !self.is_jit_compiled(func_index) {
+            return Ok(None);
+        }
+        let caller_stack_base = self.frames.last().unwrap().stack_base;
+        let argc = args.len() + usize::from(closure.is_some());
+        self.stack.extend(closure);
+        for arg in args {
+            self.stack.push(self.stack[caller_stack_base + arg.0]);
         }
+        self.execute_jit_function(func_index, argc, callee_func, chunk)
+            .map(Some)
+    }
 
-        // Convert to MicroOp IR first
-        use super::microop_converter;
-        let converted = microop_converter::convert(func);
+    /// Record a compiled function's entry point in the JIT function table.
+    ///
+    /// A table shared with a spawned thread is copied first. The old copy is
+    /// kept alive until the next `prepare`, because JIT code on this VM's
+    /// native stack may still read it.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn update_jit_function_table(&mut self, func_index: usize, entry: u64, total_regs: usize) {
+        if Arc::get_mut(&mut self.jit_function_table).is_none() {
+            let copy = Arc::new((*self.jit_function_table).clone());
+            let shared = std::mem::replace(&mut self.jit_function_table, copy);
+            self.retired_jit_tables.push(shared);
+        }
+        Arc::get_mut(&mut self.jit_function_table)
+            .expect("table was just unshared")
+            .update(func_index, entry, total_regs);
+    }
 
-        let compiler = MicroOpJitCompiler::new();
-        match compiler.compile(&converted, func.locals_count, func_index, all_functions) {
-            Ok(compiled) => {
-                if self.trace_jit {
-                    eprintln!(
-                        "[JIT/MicroOp] Compiled function '{}' ({} bytes)",
-                        func.name,
-                        compiled.memory.size()
-                    );
-                }
-                // Update function table with entry point for direct call dispatch
-                let entry: unsafe extern "C" fn(*mut u8, *mut u64, *mut u64) -> JitReturn =
-                    unsafe { compiled.entry_point() };
-                self.jit_function_table.update(
-                    func_index,
-                    entry as usize as u64,
-                    compiled.total_regs,
-                );
-                self.jit_functions.insert(func_index, compiled);
-                self.jit_compile_count += 1;
+    /// Attach a persistent JIT code cache (x86-64 with jit feature only).
+    ///
+    /// Code compiled from now on is recorded in the cache, and `prepare`
+    /// installs cached code for every matching function and loop of the
+    /// chunk so it runs natively from the first call. Call
+    /// `install_cached_jit_code` to apply the cache to an already prepared
+    /// chunk.
+    #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+    pub fn set_jit_cache(&mut self, cache: JitCache) {
+        self.jit_cache = Some(cache);
+    }
+
+    /// The attached JIT code cache, if any.
+    #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+    pub fn jit_cache(&self) -> Option<&JitCache> {
+        self.jit_cache.as_ref()
+    }
+
+    /// Install code from the attached JIT cache for the functions and loops
+    /// of `chunk` that are not compiled yet. Returns the number installed.
+    ///
+    /// Installed code does not count towards `jit_compile_count`.
+    #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+    pub fn install_cached_jit_code(&mut self, chunk: &Chunk) -> usize {
+        let Some(cache) = self.jit_cache.take() else {
+            return 0;
+        };
+        let mut installed = 0;
+        if self.jit_enabled && !cache.is_empty() {
+            let funcs = chunk.functions.iter().enumerate();
+            for (func_index, func) in funcs.chain(std::iter::once((usize::MAX, &chunk.main))) {
+                installed += self.install_cached_function(&cache, chunk, func, func_index);
             }
-            Err(e) => {
-                if self.trace_jit {
-                    eprintln!("[JIT/MicroOp] Failed to compile '{}': {}", func.name, e);
-                }
+            if self.trace_jit {
+                eprintln!("[JIT/Cache] Installed {} cached entries", installed);
+            }
+        }
+        self.jit_cache = Some(cache);
+        installed
+    }
+
+    /// Install cached code for one function and the loops in its body.
+    #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+    fn install_cached_function(
+        &mut self,
+        cache: &JitCache,
+        chunk: &Chunk,
+        func: &Function,
+        func_index: usize,
+    ) -> usize {
+        let mut installed = 0;
+        if func_index != usize::MAX
+            && !self.jit_functions.contains_key(&func_index)
+            && let Some(entry) =
+                cache.get(JitCache::function_key(&chunk.functions, func, func_index))
+            && let Ok(memory) = entry.to_memory()
+        {
+            let compiled = CompiledCode {
+                memory,
+                entry_offset: entry.entry_offset,
+                stack_map: StackMapTable::new(),
+                total_regs: entry.total_regs,
+            };
+            let entry_fn: unsafe extern "C" fn(*mut u8, *mut u64, *mut u64) -> JitReturn =
+                unsafe { compiled.entry_point() };
+            self.update_jit_function_table(
+                func_index,
+                entry_fn as usize as u64,
+                compiled.total_regs,
+            );
+            profiler::record_jit_code(compiled.memory.code(), || format!("moca::{}", func.name));
+            Arc::make_mut(&mut self.jit_functions).insert(func_index, Arc::new(compiled));
+            installed += 1;
+        }
+
+        // Loops are the backward jumps the interpreters count iterations for
+        for (pc, op) in func.code.iter().enumerate() {
+            let Op::Jmp(target) = *op else {
+                continue;
+            };
+            if target >= pc || self.jit_loops.contains_key(&(func_index, pc)) {
+                continue;
+            }
+            let key = JitCache::loop_key(&chunk.functions, func, func_index, target, pc);
+            if let Some(entry) = cache.get(key)
+                && let Ok(memory) = entry.to_memory()
+            {
+                profiler::record_jit_code(memory.code(), || {
+                    format!("moca::{}::loop@{}..{}", func.name, target, pc)
+                });
+                Arc::make_mut(&mut self.jit_loops).insert(
+                    (func_index, pc),
+                    Arc::new(CompiledLoop {
+                        memory,
+                        entry_offset: entry.entry_offset,
+                        loop_start_pc: target,
+                        loop_end_pc: pc,
+                        stack_map: StackMapTable::new(),
+                        total_regs: entry.total_regs,
+                        guards: Vec::new(),
+                    }),
+                );
+                installed += 1;
             }
         }
-    }
-
-    /// Check if a function has been JIT compiled (x86-64 with jit feature only).
-    #[cfg(all(target_arch = "x86_64", feature = "jit"))]
-    fn is_jit_compiled(&self, func_index: usize) -> bool {
-        self.jit_functions.contains_key(&func_index)
+        installed
     }
 
     /// Compile a hot loop to native code (x86-64 with jit feature only).
@@ -644,11 +1398,14 @@ impl VM {
                 loop_end_pc,
                 loop_start_microop,
                 loop_end_microop,
-                self.jit_threshold
+                self.osr_threshold
             );
         }
+        let speculation = self.loop_speculation(key, func);
 
-        let compiler = MicroOpJitCompiler::new();
+        let compiler = MicroOpJitCompiler::new()
+            .with_call_targets(self.inline_caches.call_targets(func_index))
+            .with_type_guards(speculation);
         match compiler.compile_loop(
             &converted,
             func.locals_count,
@@ -662,17 +1419,48 @@ impl VM {
             Ok(compiled) => {
                 if self.trace_jit {
                     eprintln!(
-                        "[JIT/MicroOp] Compiled loop in '{}' Op PC {}..{} ({} bytes)",
+                        "[JIT/MicroOp] Compiled loop in '{}' Op PC {}..{} ({} bytes, {} type guards)",
                         func.name,
                         loop_start_pc,
                         loop_end_pc,
-                        compiled.memory.size()
+                        compiled.memory.size(),
+                        compiled.guards.len()
+                    );
+                }
+                // Guards are not cached: only code that needs none is reused
+                if let Some(cache) = &mut self.jit_cache
+                    && compiled.guards.is_empty()
+                {
+                    cache.insert(
+                        JitCache::loop_key(
+                            all_functions,
+                            func,
+                            func_index,
+                            loop_start_pc,
+                            loop_end_pc,
+                        ),
+                        compiled.memory.code(),
+                        compiled.entry_offset,
+                        compiled.total_regs,
                     );
                 }
-                self.jit_loops.insert(key, compiled);
-                self.jit_compile_count += 1;
+                profiler::record_jit_code(compiled.memory.code(), || {
+                    format!(
+                        "moca::{}::loop@{}..{}",
+                        func.name, loop_start_pc, loop_end_pc
+                    )
+                });
+                let code_size = compiled.memory.code().len();
+                let tier = if compiled.guards.is_empty() {
+                    Tier::Baseline
+                } else {
+                    Tier::Optimized
+                };
+                Arc::make_mut(&mut self.jit_loops).insert(key, Arc::new(compiled));
+                self.note_jit_compiled(&func.name, true, code_size, tier);
             }
             Err(e) => {
+                self.jit_failures += 1;
                 if self.trace_jit {
                     eprintln!(
                         "[JIT/MicroOp] Failed to compile loop in '{}' Op PC {}..{}: {}",
@@ -713,11 +1501,12 @@ impl VM {
                 loop_end_pc,
                 loop_start_microop,
                 loop_end_microop,
-                self.jit_threshold
+                self.osr_threshold
             );
         }
+        let speculation = self.loop_speculation(key, func);
 
-        let compiler = MicroOpJitCompiler::new();
+        let compiler = MicroOpJitCompiler::new().with_type_guards(speculation);
         match compiler.compile_loop(
             &converted,
             func.locals_count,
@@ -730,17 +1519,31 @@ impl VM {
             Ok(compiled) => {
                 if self.trace_jit {
                     eprintln!(
-                        "[JIT/MicroOp] Compiled loop in '{}' Op PC {}..{} ({} bytes)",
+                        "[JIT/MicroOp] Compiled loop in '{}' Op PC {}..{} ({} bytes, {} type guards)",
                         func.name,
                         loop_start_pc,
                         loop_end_pc,
-                        compiled.memory.size()
+                        compiled.memory.size(),
+                        compiled.guards.len()
                     );
                 }
-                self.jit_loops.insert(key, compiled);
-                self.jit_compile_count += 1;
+                profiler::record_jit_code(compiled.memory.code(), || {
+                    format!(
+                        "moca::{}::loop@{}..{}",
+                        func.name, loop_start_pc, loop_end_pc
+                    )
+                });
+                let code_size = compiled.memory.code().len();
+                let tier = if compiled.guards.is_empty() {
+                    Tier::Baseline
+                } else {
+                    Tier::Optimized
+                };
+                Arc::make_mut(&mut self.jit_loops).insert(key, Arc::new(compiled));
+                self.note_jit_compiled(&func.name, true, code_size, tier);
             }
             Err(e) => {
+                self.jit_failures += 1;
                 if self.trace_jit {
                     eprintln!(
                         "[JIT/MicroOp] Failed to compile loop in '{}' Op PC {}..{}: {}",
@@ -773,7 +1576,9 @@ impl VM {
     /// Execute a JIT compiled loop (x86-64 with jit feature only).
     /// MicroOp JIT uses unboxed frames (8B/slot, payload only).
     ///
-    /// Returns the PC to continue from after the loop (loop_end_pc + 1).
+    /// Returns the PC to continue from after the loop (loop_end_pc + 1), or
+    /// None if the locals fail the code's type guards and the interpreter
+    /// has to go on.
     #[cfg(all(target_arch = "x86_64", feature = "jit"))]
     fn execute_jit_loop(
         &mut self,
@@ -781,8 +1586,18 @@ impl VM {
         loop_end_pc: usize,
         func: &Function,
         chunk: &Chunk,
-    ) -> Result<usize, String> {
+    ) -> Result<Option<usize>, String> {
         let key = (func_index, loop_end_pc);
+        let stack_base = self.frames.last().unwrap().stack_base;
+        let end = (stack_base + func.locals_count).min(self.stack.len());
+        if !tiering::guards_hold(
+            &self.jit_loops[&key].guards,
+            &self.stack[stack_base.min(end)..end],
+        ) {
+            self.deoptimize_loop(key, func);
+            return Ok(None);
+        }
+        self.gc_before_jit();
 
         let (entry, loop_end, total_regs): (
             unsafe extern "C" fn(*mut u8, *mut u64, *mut u64) -> JitReturn,
@@ -844,8 +1659,13 @@ impl VM {
             heap_alloc_dyn_simple_helper: jit_heap_alloc_dyn_simple_helper,
             // heap_alloc_typed_helper removed
             jit_function_table: self.jit_function_table.base_ptr(),
+            global_get_helper: jit_global_get_helper,
+            vtable_lookup_helper: jit_vtable_lookup_helper,
+            heap_bulk_helper: jit_heap_bulk_helper,
+            gc_roots: &mut *self.jit_roots,
         };
 
+        let pretenure = self.enter_jit();
         let _result: JitReturn = unsafe {
             entry(
                 &mut call_ctx as *mut JitCallContext as *mut u8,
@@ -853,6 +1673,7 @@ impl VM {
                 jit_frame.as_mut_ptr(), // unused
             )
         };
+        self.exit_jit(pretenure);
 
         if self.trace_jit {
             eprintln!("[JIT] Executed loop in '{}' PC ..{}", func.name, loop_end);
@@ -872,11 +1693,13 @@ impl VM {
             }
         }
 
-        Ok(loop_end + 1)
+        Ok(Some(loop_end + 1))
     }
 
     /// Execute a JIT compiled loop (AArch64 with jit feature only).
     /// MicroOp JIT uses unboxed frames (8B/slot, payload only).
+    ///
+    /// Returns None if the locals fail the code's type guards.
     #[cfg(all(target_arch = "aarch64", feature = "jit"))]
     fn execute_jit_loop(
         &mut self,
@@ -884,8 +1707,18 @@ impl VM {
         loop_end_pc: usize,
         func: &Function,
         chunk: &Chunk,
-    ) -> Result<usize, String> {
+    ) -> Result<Option<usize>, String> {
         let key = (func_index, loop_end_pc);
+        let stack_base = self.frames.last().unwrap().stack_base;
+        let end = (stack_base + func.locals_count).min(self.stack.len());
+        if !tiering::guards_hold(
+            &self.jit_loops[&key].guards,
+            &self.stack[stack_base.min(end)..end],
+        ) {
+            self.deoptimize_loop(key, func);
+            return Ok(None);
+        }
+        self.gc_before_jit();
 
         let (entry, loop_end, total_regs): (
             unsafe extern "C" fn(*mut u8, *mut u64, *mut u64) -> JitReturn,
@@ -947,8 +1780,13 @@ impl VM {
             heap_alloc_dyn_simple_helper: jit_heap_alloc_dyn_simple_helper,
             // heap_alloc_typed_helper removed
             jit_function_table: self.jit_function_table.base_ptr(),
+            global_get_helper: jit_global_get_helper,
+            vtable_lookup_helper: jit_vtable_lookup_helper,
+            heap_bulk_helper: jit_heap_bulk_helper,
+            gc_roots: &mut *self.jit_roots,
         };
 
+        let pretenure = self.enter_jit();
         let _result: JitReturn = unsafe {
             entry(
                 &mut call_ctx as *mut JitCallContext as *mut u8,
@@ -956,6 +1794,7 @@ impl VM {
                 jit_frame.as_mut_ptr(), // unused
             )
         };
+        self.exit_jit(pretenure);
 
         if self.trace_jit {
             eprintln!("[JIT] Executed loop in '{}' PC ..{}", func.name, loop_end);
@@ -974,7 +1813,7 @@ impl VM {
             }
         }
 
-        Ok(loop_end + 1)
+        Ok(Some(loop_end + 1))
     }
 
     /// Execute a JIT compiled function (x86-64 with jit feature only).
@@ -989,6 +1828,7 @@ impl VM {
         func: &Function,
         chunk: &Chunk,
     ) -> Result<Value, String> {
+        self.gc_before_jit();
         // Get the entry point and total_regs to avoid borrow conflicts
         let (entry, total_regs): (
             unsafe extern "C" fn(*mut u8, *mut u64, *mut u64) -> JitReturn,
@@ -1006,17 +1846,12 @@ impl VM {
         };
         let mut frame = vec![0u64; frame_regs * 2];
 
-        // Pop arguments from VM stack and write payloads to frame
-        let args: Vec<Value> = (0..argc)
-            .map(|_| self.stack.pop().unwrap())
-            .collect::<Vec<_>>()
-            .into_iter()
-            .rev()
-            .collect();
-
-        for (i, arg) in args.iter().enumerate() {
-            frame[i] = JitValue::from_value(arg).payload;
+        // Move argument payloads from the top of the VM stack into the frame
+        let args_base = self.stack.len() - argc;
+        for (slot, arg) in frame.iter_mut().zip(&self.stack[args_base..]) {
+            *slot = JitValue::from_value(arg).payload;
         }
+        self.stack.truncate(args_base);
 
         // Set up JitCallContext for runtime calls from JIT code
         let mut call_ctx = JitCallContext {
@@ -1033,9 +1868,14 @@ impl VM {
             heap_alloc_dyn_simple_helper: jit_heap_alloc_dyn_simple_helper,
             // heap_alloc_typed_helper removed
             jit_function_table: self.jit_function_table.base_ptr(),
+            global_get_helper: jit_global_get_helper,
+            vtable_lookup_helper: jit_vtable_lookup_helper,
+            heap_bulk_helper: jit_heap_bulk_helper,
+            gc_roots: &mut *self.jit_roots,
         };
 
         // Execute the JIT code
+        let pretenure = self.enter_jit();
         let result: JitReturn = unsafe {
             entry(
                 &mut call_ctx as *mut JitCallContext as *mut u8,
@@ -1043,6 +1883,7 @@ impl VM {
                 frame.as_mut_ptr(), // unused
             )
         };
+        self.exit_jit(pretenure);
 
         if self.trace_jit {
             eprintln!(
@@ -1067,6 +1908,7 @@ impl VM {
         func: &Function,
         chunk: &Chunk,
     ) -> Result<Value, String> {
+        self.gc_before_jit();
         // Get the entry point and total_regs to avoid borrow conflicts
         let (entry, total_regs): (
             unsafe extern "C" fn(*mut u8, *mut u64, *mut u64) -> JitReturn,
@@ -1084,17 +1926,12 @@ impl VM {
         };
         let mut frame = vec![0u64; frame_size];
 
-        // Pop arguments from VM stack and write payloads to frame
-        let args: Vec<Value> = (0..argc)
-            .map(|_| self.stack.pop().unwrap())
-            .collect::<Vec<_>>()
-            .into_iter()
-            .rev()
-            .collect();
-
-        for (i, arg) in args.iter().enumerate() {
-            frame[i] = JitValue::from_value(arg).payload;
+        // Move argument payloads from the top of the VM stack into the frame
+        let args_base = self.stack.len() - argc;
+        for (slot, arg) in frame.iter_mut().zip(&self.stack[args_base..]) {
+            *slot = JitValue::from_value(arg).payload;
         }
+        self.stack.truncate(args_base);
 
         // Set up JitCallContext for runtime calls from JIT code
         let mut call_ctx = JitCallContext {
@@ -1111,9 +1948,14 @@ impl VM {
             heap_alloc_dyn_simple_helper: jit_heap_alloc_dyn_simple_helper,
             // heap_alloc_typed_helper removed
             jit_function_table: self.jit_function_table.base_ptr(),
+            global_get_helper: jit_global_get_helper,
+            vtable_lookup_helper: jit_vtable_lookup_helper,
+            heap_bulk_helper: jit_heap_bulk_helper,
+            gc_roots: &mut *self.jit_roots,
         };
 
         // Execute the JIT code
+        let pretenure = self.enter_jit();
         let result: JitReturn = unsafe {
             entry(
                 &mut call_ctx as *mut JitCallContext as *mut u8,
@@ -1121,6 +1963,7 @@ impl VM {
                 frame.as_mut_ptr(), // unused
             )
         };
+        self.exit_jit(pretenure);
 
         if self.trace_jit {
             eprintln!(
@@ -1133,6 +1976,90 @@ impl VM {
         Ok(result.to_value())
     }
 
+    /// Execute a JIT compiled function once per argument tuple on the stack.
+    ///
+    /// Tuple `i` starts at `args_base + i * arity` and its result is stored at
+    /// `results_base + i`. The frame buffer and call context are set up once
+    /// and reused for every call in the batch.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn execute_jit_function_batch(
+        &mut self,
+        func_index: usize,
+        func: &Function,
+        chunk: &Chunk,
+        args_base: usize,
+        results_base: usize,
+        count: usize,
+    ) {
+        self.gc_before_jit();
+        let (entry, total_regs): (
+            unsafe extern "C" fn(*mut u8, *mut u64, *mut u64) -> JitReturn,
+            usize,
+        ) = {
+            let compiled = self.jit_functions.get(&func_index).unwrap();
+            (unsafe { compiled.entry_point() }, compiled.total_regs)
+        };
+
+        let frame_regs = if total_regs > 0 {
+            total_regs
+        } else {
+            func.locals_count
+        };
+        // x86-64 frames carry shadow tags after the payload slots
+        let frame_len = if cfg!(target_arch = "x86_64") {
+            frame_regs * 2
+        } else {
+            frame_regs
+        };
+        let mut frame = vec![0u64; frame_len];
+
+        let mut call_ctx = JitCallContext {
+            vm: self as *mut VM as *mut u8,
+            chunk: chunk as *const Chunk as *const u8,
+            call_helper: jit_call_helper,
+            push_string_helper: jit_push_string_helper,
+            array_len_helper: jit_array_len_helper,
+            hostcall_helper: jit_hostcall_helper,
+            heap_base: self.heap.memory_base_ptr(),
+            string_cache: self.string_cache.as_ptr() as *const u64,
+            string_cache_len: self.string_cache.len() as u64,
+
+            heap_alloc_dyn_simple_helper: jit_heap_alloc_dyn_simple_helper,
+            jit_function_table: self.jit_function_table.base_ptr(),
+            global_get_helper: jit_global_get_helper,
+            vtable_lookup_helper: jit_vtable_lookup_helper,
+            heap_bulk_helper: jit_heap_bulk_helper,
+            gc_roots: &mut *self.jit_roots,
+        };
+
+        let argc = func.arity;
+        for i in 0..count {
+            frame.fill(0);
+            let tuple = args_base + i * argc;
+            for (slot, arg) in frame.iter_mut().zip(&self.stack[tuple..tuple + argc]) {
+                *slot = JitValue::from_value(arg).payload;
+            }
+
+            let pretenure = self.enter_jit();
+            let result: JitReturn = unsafe {
+                entry(
+                    &mut call_ctx as *mut JitCallContext as *mut u8,
+                    frame.as_mut_ptr(),
+                    frame.as_mut_ptr(), // unused
+                )
+            };
+            self.exit_jit(pretenure);
+            self.stack[results_base + i] = result.to_value();
+        }
+
+        if self.trace_jit {
+            eprintln!(
+                "[JIT] Executed function '{}' for a batch of {} calls",
+                func.name, count
+            );
+        }
+    }
+
     /// Get the number of JIT compilations performed.
     pub fn jit_compile_count(&self) -> usize {
         self.jit_compile_count
@@ -1143,22 +2070,28 @@ impl VM {
         self.use_microop = enabled;
     }
 
+    /// Run `main` of `chunk`. Buffered output is flushed before returning.
     pub fn run(&mut self, chunk: &Chunk) -> Result<(), String> {
+        let result = self.run_main(chunk);
+        let _ = self.flush_output();
+        result
+    }
+
+    /// Reserve the locals of a frame at `stack_base` whose arguments are
+    /// already pushed, so a `LocalSet` past them never overwrites operands.
+    fn reserve_locals(&mut self, stack_base: usize, locals_count: usize) {
+        if self.stack.len() < stack_base + locals_count {
+            self.stack.resize(stack_base + locals_count, Value::Null);
+        }
+    }
+
+    fn run_main(&mut self, chunk: &Chunk) -> Result<(), String> {
         if self.use_microop {
             return self.run_microop(chunk);
         }
 
-        // Initialize call counts for JIT
-        self.init_call_counts(chunk);
-        // Initialize string constant cache
-        self.init_string_cache(chunk);
-        // Initialize globals (type descriptors + interface descriptors)
-        self.init_globals(chunk)?;
-        // Initialize JIT function table
-        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
-        {
-            self.jit_function_table = JitFunctionTable::new(chunk.functions.len());
-        }
+        // Initialize call counts, string cache, globals and JIT function table
+        self.prepare(chunk)?;
 
         // Start with main
         self.frames.push(Frame {
@@ -1168,12 +2101,11 @@ impl VM {
             ret_vreg: None,
             stack_floor: 0,
         });
+        self.reserve_locals(0, chunk.main.locals_count);
 
         loop {
             // Check if GC should run
-            if self.heap.should_gc() {
-                self.collect_garbage();
-            }
+            self.gc_safepoint();
 
             let frame = self.frames.last_mut().unwrap();
             let func = if frame.func_index == usize::MAX {
@@ -1184,6 +2116,7 @@ impl VM {
 
             if frame.pc >= func.code.len() {
                 // End of function without explicit return
+                Self::check_body(func)?;
                 break;
             }
 
@@ -1192,7 +2125,7 @@ impl VM {
 
             // Profile opcode execution if enabled
             if self.profile_opcodes {
-                *self.opcode_profile.counts.entry(op.name()).or_insert(0) += 1;
+                self.opcode_profile.record(op.name());
             }
 
             let result = self.execute_op(op, chunk);
@@ -1213,140 +2146,726 @@ impl VM {
             }
         }
 
-        Ok(())
+        Ok(())
+    }
+
+    /// Run a chunk and return the result value (used for thread execution).
+    pub fn run_and_get_result(&mut self, chunk: &Chunk) -> Result<Value, String> {
+        let result = self.run_main_for_result(chunk);
+        let _ = self.flush_output();
+        result
+    }
+
+    fn run_main_for_result(&mut self, chunk: &Chunk) -> Result<Value, String> {
+        // Initialize globals (type descriptors + interface descriptors)
+        self.init_globals(chunk)?;
+
+        // Start with main
+        self.frames.push(Frame {
+            func_index: usize::MAX, // Marker for main
+            pc: 0,
+            stack_base: 0,
+            ret_vreg: None,
+            stack_floor: 0,
+        });
+        self.reserve_locals(0, chunk.main.locals_count);
+
+        let mut result = Value::Null;
+
+        loop {
+            // Check if GC should run
+            self.gc_safepoint();
+
+            let frame = self.frames.last_mut().unwrap();
+            let func = if frame.func_index == usize::MAX {
+                &chunk.main
+            } else {
+                &chunk.functions[frame.func_index]
+            };
+
+            if frame.pc >= func.code.len() {
+                // End of function without explicit return
+                Self::check_body(func)?;
+                break;
+            }
+
+            let op = func.code[frame.pc].clone();
+            frame.pc += 1;
+
+            // Profile opcode execution if enabled
+            if self.profile_opcodes {
+                self.opcode_profile.record(op.name());
+            }
+
+            let control = self.execute_op(op, chunk);
+            match control {
+                Ok(ControlFlow::Continue) => {}
+                Ok(ControlFlow::Return) => {
+                    if self.frames.is_empty() {
+                        // Main returned - capture the return value from stack
+                        result = self.stack.pop().unwrap_or(Value::Null);
+                        break;
+                    }
+                }
+                Ok(ControlFlow::Exit) => {
+                    // Capture the return value before exiting
+                    result = self.stack.pop().unwrap_or(Value::Null);
+                    break;
+                }
+                Err(e) => {
+                    // Try to handle exception
+                    if !self.handle_exception(e.clone(), chunk)? {
+                        return Err(e);
+                    }
+                }
+            }
+        }
+
+        Ok(result)
+    }
+
+    /// Run the VM using the MicroOp interpreter.
+    ///
+    /// Converts each function's Op bytecode to MicroOps lazily (on first call),
+    /// caches the result, and executes using register-based MicroOps with
+    /// Raw fallback for unconverted operations.
+    fn run_microop(&mut self, chunk: &Chunk) -> Result<(), String> {
+        use super::superinstructions;
+
+        self.prepare(chunk)?;
+
+        let main_converted = superinstructions::convert(&chunk.main);
+
+        // Push main frame with register file space
+        let main_regs = chunk.main.locals_count + main_converted.temps_count;
+        self.frames.push(Frame {
+            func_index: usize::MAX,
+            pc: 0,
+            stack_base: 0,
+            ret_vreg: None,
+            stack_floor: main_regs,
+        });
+        self.stack.resize(main_regs, Value::Null);
+
+        self.run_microop_frames(chunk, Some(&main_converted), 0)?;
+        Ok(())
+    }
+
+    /// Initialize per-chunk runtime state without executing any code.
+    ///
+    /// Sets up call counters, the string constant cache, globals (type and
+    /// interface descriptors), the JIT function table (installing code from an
+    /// attached JIT cache) and the MicroOp cache. `run` does this itself;
+    /// embedders that drive individual functions via `call_function` must
+    /// call it once after loading a chunk.
+    pub fn prepare(&mut self, chunk: &Chunk) -> Result<(), String> {
+        self.forget_copied_chunk(chunk);
+        self.init_call_counts(chunk);
+        self.init_string_cache(chunk);
+        self.init_globals(chunk)?;
+        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+        {
+            if let Some(queue) = &self.compile_queue {
+                queue.clear();
+            }
+            self.jit_function_table = Arc::new(JitFunctionTable::new(chunk.functions.len()));
+            self.retired_jit_tables.clear();
+        }
+        #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+        self.install_cached_jit_code(chunk);
+        self.microop_cache = vec![None; chunk.functions.len()];
+        self.inline_caches.clear();
+        Ok(())
+    }
+
+    /// Run `chunk` as a shared program: threads spawned while it runs use
+    /// this `Arc` instead of a copy. Pass `&chunk` to `run` or `prepare` as
+    /// usual.
+    pub fn share_chunk(&mut self, chunk: Arc<Chunk>) {
+        self.shared_chunk = Some((Arc::as_ptr(&chunk) as usize, chunk));
+    }
+
+    /// `chunk` as an `Arc` for a spawned thread.
+    ///
+    /// Unless it came from `share_chunk`, the chunk is copied on the first
+    /// spawn and the copy is reused until the next `prepare`.
+    fn shared_chunk(&mut self, chunk: &Chunk) -> Arc<Chunk> {
+        let key = chunk as *const Chunk as usize;
+        if let Some((shared_key, shared)) = &self.shared_chunk
+            && *shared_key == key
+        {
+            return shared.clone();
+        }
+        let shared = Arc::new(chunk.clone());
+        self.shared_chunk = Some((key, shared.clone()));
+        shared
+    }
+
+    /// Drop a copy made by `shared_chunk`: the chunk at its address may have
+    /// changed since.
+    fn forget_copied_chunk(&mut self, chunk: &Chunk) {
+        self.shared_chunk
+            .take_if(|(_, shared)| !std::ptr::eq(Arc::as_ptr(shared), chunk));
+    }
+
+    /// Capture what a spawned thread needs to call functions of `chunk`.
+    fn thread_image(&mut self, chunk: &Chunk) -> ThreadImage {
+        ThreadImage {
+            chunk: self.shared_chunk(chunk),
+            jit_enabled: self.jit_enabled,
+            tier_policy: self.tier_policy(),
+            background_jit: self.background_jit,
+            trace_jit: self.trace_jit,
+            incremental_gc: self.incremental_gc,
+            #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+            jit_functions: self.jit_functions.clone(),
+            #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+            jit_loops: self.jit_loops.clone(),
+            #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+            jit_function_table: self.jit_function_table.clone(),
+            channels: self.channels.clone(),
+            descriptors: self.descriptors.clone(),
+            output_buffering: self.output.mode(),
+        }
+    }
+
+    /// A new VM for a spawned thread, ready to call functions of the chunk
+    /// in `image`.
+    ///
+    /// The new VM gets its own heap, globals and counters, but reuses the
+    /// JIT code compiled by the spawning VM, sees the channels it had
+    /// created and shares its open files and sockets.
+    fn thread_vm(image: ThreadImage) -> Result<(VM, Arc<Chunk>), String> {
+        let chunk = image.chunk;
+        let mut vm = VM::new();
+        vm.set_jit_config(
+            image.jit_enabled,
+            image.tier_policy.call_threshold,
+            image.trace_jit,
+        );
+        vm.set_tier_policy(image.tier_policy);
+        vm.set_background_jit(image.background_jit);
+        vm.set_incremental_gc(image.incremental_gc);
+        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+        {
+            vm.jit_functions = image.jit_functions;
+            vm.jit_loops = image.jit_loops;
+            vm.jit_function_table = image.jit_function_table;
+        }
+        vm.init_call_counts(&chunk);
+        vm.init_string_cache(&chunk);
+        vm.init_globals(&chunk)?;
+        vm.share_chunk(chunk.clone());
+        vm.channels = image.channels;
+        vm.descriptors = image.descriptors;
+        let _ = vm.set_output_buffering(image.output_buffering);
+        Ok((vm, chunk))
+    }
+
+    /// Set up a call of the 0-arity function `func_index` as a green thread.
+    ///
+    /// A JIT compiled function runs to completion right away and its result
+    /// is returned; otherwise the entry frame is pushed for `resume_green`.
+    fn start_green(&mut self, chunk: &Chunk, func_index: usize) -> Result<Option<Value>, String> {
+        let func = Self::call_target(chunk, func_index)?;
+        if func.arity != 0 || func_index == usize::MAX {
+            return Err(format!(
+                "runtime error: function '{}' expects {} arguments, got 0",
+                func.name, func.arity
+            ));
+        }
+
+        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+        if self.enter_jit_tier(func_index, func, chunk) {
+            return self
+                .execute_jit_function(func_index, 0, func, chunk)
+                .map(Some);
+        }
+
+        let (regs, _) = self.microop_frame_layout(chunk, func_index, func);
+        let stack_base = self.stack.len();
+        self.stack.resize(stack_base + regs, Value::Null);
+        self.frames.push(Frame {
+            func_index,
+            pc: 0,
+            stack_base,
+            ret_vreg: None,
+            stack_floor: stack_base + regs,
+        });
+        self.green_entry_depth = Some(self.frames.len() - 1);
+        Ok(None)
+    }
+
+    /// Run a green thread set up by `start_green` for one time slice.
+    ///
+    /// Returns `Yielded` when the slice ran out at a backward jump and
+    /// `Blocked` when a channel op, `ThreadJoin` or socket hostcall would
+    /// have blocked;
+    /// either way the frames are kept and the next call continues there.
+    fn resume_green(&mut self, chunk: &Chunk) -> Result<TaskStatus, String> {
+        let entry_depth = self.green_entry_depth.expect("green thread was started");
+        self.slice_budget = GREEN_SLICE_BACK_EDGES;
+        let result = self.run_microop_frames(chunk, None, entry_depth);
+        // Other threads run before this one continues, and its result may be
+        // joined as soon as it is returned
+        let _ = self.flush_output();
+        if let Some(status) = self.task_yield.take() {
+            return Ok(status);
+        }
+        self.green_entry_depth = None;
+        result.map(TaskStatus::Done)
+    }
+
+    /// Try a channel op, `ThreadJoin` or socket hostcall without blocking
+    /// the worker.
+    ///
+    /// A `ChannelSendMany` that only fits partly sends what fits and leaves
+    /// the rest of the batch as its operands for the retry.
+    fn poll_blocking_op(&mut self, op: &Op) -> OpPoll {
+        if let Op::Hostcall(hostcall_num, argc) = *op {
+            return self.poll_hostcall(hostcall_num, argc);
+        }
+        // The channel or thread id sits below the op's other operands
+        let operands = match op {
+            Op::ChannelRecv | Op::ThreadJoin => 1,
+            Op::ChannelSend => 2,
+            Op::ChannelSendMany | Op::ChannelRecvMany => 3,
+            _ => return OpPoll::Run,
+        };
+        let _ = self.flush_output();
+        let Some(base) = self.stack.len().checked_sub(operands) else {
+            return OpPoll::Run;
+        };
+        let Some(id) = self.stack[base].as_i64() else {
+            return OpPoll::Run;
+        };
+        let id = id as usize;
+        if matches!(op, Op::ThreadJoin) {
+            return if self.thread_spawner.is_finished(id) {
+                OpPoll::Run
+            } else {
+                OpPoll::Blocked
+            };
+        }
+        // Nothing blocks on a closed channel
+        let Some(channel) = self.channels.get(id).filter(|c| !c.is_closed()).cloned() else {
+            return OpPoll::Run;
+        };
+
+        match op {
+            Op::ChannelRecv => match channel.try_recv() {
+                Some(value) => {
+                    self.stack[base] = value;
+                    self.release_async(id);
+                    OpPoll::Done
+                }
+                None => OpPoll::Blocked,
+            },
+            Op::ChannelSend => match channel.try_send(self.stack[base + 1]) {
+                Ok(()) => {
+                    self.stack.truncate(base);
+                    OpPoll::Done
+                }
+                Err(TrySendError::Full(_)) => OpPoll::Blocked,
+                Err(TrySendError::Closed(_)) => OpPoll::Run,
+            },
+            Op::ChannelSendMany => {
+                let (data, count) = (self.stack[base + 1], self.stack[base + 2]);
+                let Some(values) = count
+                    .as_i64()
+                    .and_then(|count| self.batch_values(data, count).ok())
+                else {
+                    return OpPoll::Run;
+                };
+                match channel.try_send_many(&values) {
+                    Ok(sent) if sent == values.len() => {
+                        self.stack.truncate(base);
+                        OpPoll::Done
+                    }
+                    Ok(sent) => {
+                        if let Some(r) = data.as_ref() {
+                            self.stack[base + 1] = Value::Ref(r.with_added_slot_offset(sent));
+                            self.stack[base + 2] = Value::I64((values.len() - sent) as i64);
+                        }
+                        OpPoll::Blocked
+                    }
+                    Err(_) => OpPoll::Run,
+                }
+            }
+            _ => {
+                let (data, max) = (self.stack[base + 1], self.stack[base + 2]);
+                let Some(max) = max
+                    .as_i64()
+                    .and_then(|max| self.batch_capacity(data, max).ok())
+                    .filter(|&max| max > 0)
+                else {
+                    return OpPoll::Run;
+                };
+                let mut values = Vec::with_capacity(max);
+                if channel.try_recv_many(max, &mut values) == 0 {
+                    return OpPoll::Blocked;
+                }
+                if self.store_batch(data, &values).is_err() {
+                    return OpPoll::Run;
+                }
+                self.stack.truncate(base);
+                self.stack.push(Value::I64(values.len() as i64));
+                OpPoll::Done
+            }
+        }
+    }
+
+    /// Set the host global `name` (see `moca_set_global`).
+    pub fn set_host_global(&mut self, name: String, value: Value) {
+        if let Some(old) = self.host_globals.insert(name, value) {
+            // The old value may be in the snapshot of a cycle in progress
+            self.write_barrier(old);
+        }
     }
 
-    /// Run a chunk and return the result value (used for thread execution).
-    pub fn run_and_get_result(&mut self, chunk: &Chunk) -> Result<Value, String> {
-        // Initialize globals (type descriptors + interface descriptors)
-        self.init_globals(chunk)?;
+    /// The host global `name`, if it was set.
+    pub fn host_global(&self, name: &str) -> Option<Value> {
+        self.host_globals.get(name).copied()
+    }
 
-        // Start with main
-        self.frames.push(Frame {
-            func_index: usize::MAX, // Marker for main
-            pc: 0,
-            stack_base: 0,
-            ret_vreg: None,
-            stack_floor: 0,
-        });
+    /// Capture the heap, globals (including host globals) and string
+    /// constant cache of a prepared VM.
+    ///
+    /// Values on the VM stack, open files/sockets, threads and JIT code are
+    /// not captured; objects only reachable from the stack become garbage in
+    /// the restored VM.
+    pub fn snapshot(&self) -> VmSnapshot {
+        VmSnapshot {
+            heap: self.heap.snapshot(),
+            globals: self.globals.clone(),
+            host_globals: self.host_globals.clone(),
+            string_cache: self.string_cache.clone(),
+            gc: self.concurrent_gc.snapshot(),
+        }
+    }
 
-        let mut result = Value::Null;
+    /// Start this VM from a snapshot taken on a VM that ran `chunk`.
+    ///
+    /// Replaces `prepare`: the heap is copied from the snapshot in one pass,
+    /// and only the per-instance tables (call counts, JIT and MicroOp caches)
+    /// are reset.
+    pub fn restore(&mut self, chunk: &Chunk, snapshot: &VmSnapshot) {
+        self.stack.clear();
+        self.frames.clear();
+        self.try_frames.clear();
+        self.heap = snapshot.heap.snapshot();
+        self.globals = snapshot.globals.clone();
+        self.host_globals = snapshot.host_globals.clone();
+        self.string_cache = snapshot.string_cache.clone();
+        self.concurrent_gc = snapshot.gc.snapshot();
+
+        self.forget_copied_chunk(chunk);
+        self.init_call_counts(chunk);
+        self.loop_counts.clear();
+        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+        {
+            self.jit_functions = Arc::default();
+            self.jit_loops = Arc::default();
+            self.jit_function_table = Arc::new(JitFunctionTable::new(chunk.functions.len()));
+            self.retired_jit_tables.clear();
+        }
+        #[cfg(all(target_arch = "x86_64", feature = "jit"))]
+        self.install_cached_jit_code(chunk);
+        self.microop_cache = vec![None; chunk.functions.len()];
+        self.inline_caches.clear();
+    }
 
-        loop {
-            // Check if GC should run
-            if self.heap.should_gc() {
-                self.collect_garbage();
-            }
+    /// Call a single function of a prepared chunk and return its result.
+    ///
+    /// The top `argc` values of the VM stack are the arguments; they become the
+    /// callee's locals in place and are consumed by the call. Values below them
+    /// stay on the stack (and remain GC roots) throughout the call.
+    ///
+    /// Uses the same tiers as `run`: hot functions are JIT compiled once their
+    /// call count reaches the threshold, everything else runs on the MicroOp
+    /// interpreter. `func_index == usize::MAX` calls `chunk.main`. Buffered
+    /// output is flushed before returning.
+    pub fn call_function(
+        &mut self,
+        chunk: &Chunk,
+        func_index: usize,
+        argc: usize,
+    ) -> Result<Value, String> {
+        let result = self.enter_function(chunk, func_index, argc);
+        let _ = self.flush_output();
+        result
+    }
 
-            let frame = self.frames.last_mut().unwrap();
-            let func = if frame.func_index == usize::MAX {
-                &chunk.main
-            } else {
-                &chunk.functions[frame.func_index]
-            };
+    fn enter_function(
+        &mut self,
+        chunk: &Chunk,
+        func_index: usize,
+        argc: usize,
+    ) -> Result<Value, String> {
+        let func = Self::call_target(chunk, func_index)?;
+        if argc != func.arity {
+            return Err(format!(
+                "runtime error: function '{}' expects {} arguments, got {}",
+                func.name, func.arity, argc
+            ));
+        }
+        if argc > self.stack.len() {
+            return Err("stack underflow".to_string());
+        }
 
-            if frame.pc >= func.code.len() {
-                // End of function without explicit return
-                break;
-            }
+        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+        if self.enter_jit_tier(func_index, func, chunk) {
+            return self.execute_jit_function(func_index, argc, func, chunk);
+        }
 
-            let op = func.code[frame.pc].clone();
-            frame.pc += 1;
+        let (regs, main_converted) = self.microop_frame_layout(chunk, func_index, func);
+        self.run_microop_call(chunk, func_index, argc, regs, main_converted.as_ref())
+    }
 
-            // Profile opcode execution if enabled
-            if self.profile_opcodes {
-                *self.opcode_profile.counts.entry(op.name()).or_insert(0) += 1;
-            }
+    /// Call a function once per argument tuple inside a single VM entry.
+    ///
+    /// `args` holds `results.len()` consecutive tuples of the function's arity;
+    /// each return value is written to the matching slot of `results`. The
+    /// frame layout is computed once, and once the function is JIT compiled the
+    /// remaining tuples run in a native loop over the compiled code. Pending
+    /// arguments and finished results are kept on the VM stack so they stay
+    /// GC roots for the whole batch.
+    pub fn call_function_batch(
+        &mut self,
+        chunk: &Chunk,
+        func_index: usize,
+        args: &[Value],
+        results: &mut [Value],
+    ) -> Result<(), String> {
+        let count = results.len();
+        let func = Self::call_target(chunk, func_index)?;
+        let argc = func.arity;
+        if args.len() != argc * count {
+            return Err(format!(
+                "runtime error: batch of {} calls to '{}' needs {} arguments, got {}",
+                count,
+                func.name,
+                argc * count,
+                args.len()
+            ));
+        }
 
-            let control = self.execute_op(op, chunk);
-            match control {
-                Ok(ControlFlow::Continue) => {}
-                Ok(ControlFlow::Return) => {
-                    if self.frames.is_empty() {
-                        // Main returned - capture the return value from stack
-                        result = self.stack.pop().unwrap_or(Value::Null);
-                        break;
-                    }
-                }
-                Ok(ControlFlow::Exit) => {
-                    // Capture the return value before exiting
-                    result = self.stack.pop().unwrap_or(Value::Null);
-                    break;
-                }
-                Err(e) => {
-                    // Try to handle exception
-                    if !self.handle_exception(e.clone(), chunk)? {
-                        return Err(e);
-                    }
-                }
+        let args_base = self.stack.len();
+        self.stack.extend_from_slice(args);
+        let results_base = self.stack.len();
+        self.stack.resize(results_base + count, Value::Null);
+
+        let result = self.run_batch(chunk, func_index, func, args_base, results_base, count);
+        let _ = self.flush_output();
+        if result.is_ok() {
+            results.copy_from_slice(&self.stack[results_base..results_base + count]);
+        }
+        self.stack.truncate(args_base);
+        result
+    }
+
+    fn run_batch(
+        &mut self,
+        chunk: &Chunk,
+        func_index: usize,
+        func: &Function,
+        args_base: usize,
+        results_base: usize,
+        count: usize,
+    ) -> Result<(), String> {
+        let argc = func.arity;
+        let (regs, main_converted) = self.microop_frame_layout(chunk, func_index, func);
+
+        for i in 0..count {
+            #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+            if self.enter_jit_tier(func_index, func, chunk) {
+                self.execute_jit_function_batch(
+                    func_index,
+                    func,
+                    chunk,
+                    args_base + i * argc,
+                    results_base + i,
+                    count - i,
+                );
+                return Ok(());
             }
+
+            let tuple = args_base + i * argc;
+            self.stack.extend_from_within(tuple..tuple + argc);
+            let value =
+                self.run_microop_call(chunk, func_index, argc, regs, main_converted.as_ref())?;
+            self.stack[results_base + i] = value;
         }
 
-        Ok(result)
+        Ok(())
     }
 
-    /// Run the VM using the MicroOp interpreter.
+    /// Look up the function a host-driven call targets (`usize::MAX` = main).
+    fn call_target(chunk: &Chunk, func_index: usize) -> Result<&Function, String> {
+        if func_index == usize::MAX {
+            return Ok(&chunk.main);
+        }
+        let func = chunk
+            .functions
+            .get(func_index)
+            .ok_or_else(|| format!("runtime error: invalid function index {}", func_index))?;
+        Self::check_body(func)?;
+        Ok(func)
+    }
+
+    /// Fail if the body of `func` could not be decoded.
     ///
-    /// Converts each function's Op bytecode to MicroOps lazily (on first call),
-    /// caches the result, and executes using register-based MicroOps with
-    /// Raw fallback for unconverted operations.
-    fn run_microop(&mut self, chunk: &Chunk) -> Result<(), String> {
-        use super::microop::{CmpCond, ConvertedFunction, MicroOp};
-        use super::microop_converter;
+    /// A corrupt lazily loaded body reads as empty code, so this is checked
+    /// wherever execution runs off the end of a function.
+    fn check_body(func: &Function) -> Result<(), String> {
+        func.code.decode().map(|_| ()).map_err(|e| {
+            format!(
+                "runtime error: corrupt body of function '{}': {}",
+                func.name, e
+            )
+        })
+    }
 
-        // Initialize (same as run())
-        self.init_call_counts(chunk);
-        self.init_string_cache(chunk);
-        self.init_globals(chunk)?;
-        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
-        {
-            self.jit_function_table = JitFunctionTable::new(chunk.functions.len());
+    /// Count a host-driven call and compile the function once it gets hot.
+    /// Returns true if the call can run as JIT compiled code.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn enter_jit_tier(&mut self, func_index: usize, func: &Function, chunk: &Chunk) -> bool {
+        if func_index == usize::MAX {
+            return false;
+        }
+        if self.should_jit_compile(func_index, &func.name) {
+            self.jit_compile_function(func_index, chunk);
         }
+        self.is_jit_compiled(func_index)
+    }
 
-        // Lazy conversion cache: indexed by func_index
-        let mut func_cache: Vec<Option<ConvertedFunction>> = vec![None; chunk.functions.len()];
-        let main_converted = microop_converter::convert(&chunk.main);
+    /// Register file size for running `func` on the MicroOp interpreter.
+    ///
+    /// Also returns the converted main function when `func` is main (other
+    /// functions are converted into `microop_cache`).
+    fn microop_frame_layout(
+        &mut self,
+        chunk: &Chunk,
+        func_index: usize,
+        func: &Function,
+    ) -> (usize, Option<ConvertedFunction>) {
+        use super::superinstructions;
 
-        // Push main frame with register file space
-        let main_regs = chunk.main.locals_count + main_converted.temps_count;
+        if func_index == usize::MAX {
+            let converted = superinstructions::convert(&chunk.main);
+            return (func.locals_count + converted.temps_count, Some(converted));
+        }
+
+        if self.microop_cache.len() < chunk.functions.len() {
+            self.microop_cache.resize(chunk.functions.len(), None);
+        }
+        let temps_count = self.microop_cache[func_index]
+            .get_or_insert_with(|| superinstructions::convert(func))
+            .temps_count;
+        (func.locals_count + temps_count, None)
+    }
+
+    /// Run one call on the MicroOp interpreter with the top `argc` stack
+    /// values as arguments, consuming them.
+    fn run_microop_call(
+        &mut self,
+        chunk: &Chunk,
+        func_index: usize,
+        argc: usize,
+        regs: usize,
+        main_converted: Option<&ConvertedFunction>,
+    ) -> Result<Value, String> {
+        let new_stack_base = self.stack.len() - argc;
+        let entry_depth = self.frames.len();
+        let try_depth = self.try_frames.len();
+
+        // Arguments already sit at new_stack_base..; extend to the full register file
+        self.stack.resize(new_stack_base + regs, Value::Null);
         self.frames.push(Frame {
-            func_index: usize::MAX,
+            func_index,
             pc: 0,
-            stack_base: 0,
+            stack_base: new_stack_base,
             ret_vreg: None,
-            stack_floor: main_regs,
+            stack_floor: new_stack_base + regs,
         });
-        self.stack.resize(main_regs, Value::Null);
 
-        loop {
-            // GC check
-            if self.heap.should_gc() {
-                self.collect_garbage();
-            }
+        let result = self.run_microop_frames(chunk, main_converted, entry_depth);
+
+        // Unwind whatever the callee left behind (errors, fall-through end of code)
+        self.frames.truncate(entry_depth);
+        self.try_frames.truncate(try_depth);
+        self.stack.truncate(new_stack_base);
+
+        result
+    }
+
+    /// Execute MicroOp frames until the frame stack unwinds to `entry_depth`.
+    ///
+    /// Returns the value returned by the frame that was pushed at `entry_depth`.
+    /// `main_converted` is only needed when the main function is being run.
+    fn run_microop_frames(
+        &mut self,
+        chunk: &Chunk,
+        main_converted: Option<&ConvertedFunction>,
+        entry_depth: usize,
+    ) -> Result<Value, String> {
+        // Take the cache out of self so converted code can be borrowed while
+        // the dispatch loop mutates the VM.
+        let mut func_cache = std::mem::take(&mut self.microop_cache);
+        if func_cache.len() < chunk.functions.len() {
+            func_cache.resize(chunk.functions.len(), None);
+        }
+        let result = self.dispatch_microops(chunk, &mut func_cache, main_converted, entry_depth);
+        self.microop_cache = func_cache;
+        result
+    }
+
+    fn dispatch_microops(
+        &mut self,
+        chunk: &Chunk,
+        func_cache: &mut Vec<Option<ConvertedFunction>>,
+        main_converted: Option<&ConvertedFunction>,
+        entry_depth: usize,
+    ) -> Result<Value, String> {
+        use super::microop::{CmpCond, MicroOp};
+        use super::superinstructions;
 
+        loop {
             // Get current frame info
-            let func_index = self.frames.last().unwrap().func_index;
-            let pc = self.frames.last().unwrap().pc;
+            let frame = self.frames.last_mut().unwrap();
+            let func_index = frame.func_index;
+            let pc = frame.pc;
 
             // Get converted function
             let converted = if func_index == usize::MAX {
-                &main_converted
+                main_converted.expect("main frame requires converted main")
             } else {
                 func_cache[func_index]
-                    .get_or_insert_with(|| microop_converter::convert(&chunk.functions[func_index]))
+                    .get_or_insert_with(|| superinstructions::convert(&chunk.functions[func_index]))
             };
 
-            // Check for end of code
-            if pc >= converted.micro_ops.len() {
-                break;
+            // Fetch and advance PC; running off the end returns null
+            let Some(mop) = converted.micro_ops.get(pc) else {
+                if func_index == usize::MAX {
+                    Self::check_body(&chunk.main)?;
+                } else {
+                    Self::check_body(&chunk.functions[func_index])?;
+                }
+                return Ok(Value::Null);
+            };
+            frame.pc = pc + 1;
+
+            // GC check, skipped for ops that cannot allocate or yield
+            if !mop.is_register_only() {
+                self.gc_safepoint();
             }
 
-            // Fetch and advance PC
-            let mop = converted.micro_ops[pc].clone();
-            self.frames.last_mut().unwrap().pc = pc + 1;
+            if self.profile_opcodes {
+                self.opcode_profile.record(mop.name());
+            }
 
             // Dispatch
-            match mop {
+            match *mop {
                 MicroOp::Jmp {
                     target,
                     old_pc,
@@ -1354,9 +2873,17 @@ impl VM {
                 } => {
                     // Detect backward branch (loop) for JIT
                     if old_target < old_pc {
-                        let key = (func_index, old_pc);
-                        let count = self.loop_counts.entry(key).or_insert(0);
-                        *count += 1;
+                        // A green thread gives up its worker once per time slice
+                        if self.green_entry_depth == Some(entry_depth) {
+                            self.slice_budget -= 1;
+                            if self.slice_budget == 0 {
+                                self.frames.last_mut().unwrap().pc = target;
+                                self.task_yield = Some(TaskStatus::Yielded);
+                                return Ok(Value::Null);
+                            }
+                        }
+
+                        self.count_back_edge(chunk, func_index, old_pc);
 
                         let loop_start_pc = old_target;
                         let loop_end_pc = old_pc;
@@ -1400,11 +2927,14 @@ impl VM {
                                 } else {
                                     &chunk.functions[func_index]
                                 };
-                                let next_old_pc =
-                                    self.execute_jit_loop(func_index, old_pc, func, chunk)?;
-                                // Map returned Op PC back to MicroOp PC
-                                self.frames.last_mut().unwrap().pc = converted.pc_map[next_old_pc];
-                                continue;
+                                if let Some(next_old_pc) =
+                                    self.execute_jit_loop(func_index, old_pc, func, chunk)?
+                                {
+                                    // Map returned Op PC back to MicroOp PC
+                                    self.frames.last_mut().unwrap().pc =
+                                        converted.pc_map[next_old_pc];
+                                    continue;
+                                }
                             }
                         }
 
@@ -1416,11 +2946,14 @@ impl VM {
                                 } else {
                                     &chunk.functions[func_index]
                                 };
-                                let next_old_pc =
-                                    self.execute_jit_loop(func_index, old_pc, func, chunk)?;
-                                // Map returned Op PC back to MicroOp PC
-                                self.frames.last_mut().unwrap().pc = converted.pc_map[next_old_pc];
-                                continue;
+                                if let Some(next_old_pc) =
+                                    self.execute_jit_loop(func_index, old_pc, func, chunk)?
+                                {
+                                    // Map returned Op PC back to MicroOp PC
+                                    self.frames.last_mut().unwrap().pc =
+                                        converted.pc_map[next_old_pc];
+                                    continue;
+                                }
                             }
                         }
                     }
@@ -1446,6 +2979,9 @@ impl VM {
                     ref args,
                     ret,
                 } => {
+                    // The callee may be converted into `func_cache`, which
+                    // `args` borrows from
+                    let args = args.clone();
                     let callee_func = &chunk.functions[func_id];
                     let caller_stack_base = self.frames.last().unwrap().stack_base;
 
@@ -1453,7 +2989,7 @@ impl VM {
                     #[cfg(all(target_arch = "x86_64", feature = "jit"))]
                     {
                         if self.should_jit_compile(func_id, &callee_func.name) {
-                            self.jit_compile_function(callee_func, func_id, &chunk.functions);
+                            self.jit_compile_function(func_id, chunk);
                         }
                         if self.is_jit_compiled(func_id) {
                             // Push args onto operand stack for JIT (it pops them)
@@ -1473,7 +3009,7 @@ impl VM {
                     #[cfg(all(target_arch = "aarch64", feature = "jit"))]
                     {
                         if self.should_jit_compile(func_id, &callee_func.name) {
-                            self.jit_compile_function(callee_func, func_id);
+                            self.jit_compile_function(func_id, chunk);
                         }
                         if self.is_jit_compiled(func_id) {
                             for arg in args.iter() {
@@ -1492,7 +3028,7 @@ impl VM {
                     // MicroOp interpreter path
                     if func_cache[func_id].is_none() {
                         func_cache[func_id] =
-                            Some(microop_converter::convert(&chunk.functions[func_id]));
+                            Some(superinstructions::convert(&chunk.functions[func_id]));
                     }
                     let callee_temps = func_cache[func_id].as_ref().unwrap().temps_count;
                     let callee_regs = callee_func.locals_count + callee_temps;
@@ -1532,15 +3068,14 @@ impl VM {
                     // Pop callee frame
                     let callee_frame = self.frames.pop().unwrap();
 
-                    if self.frames.is_empty() {
-                        // Main returned
-                        self.stack.push(return_value);
-                        break;
-                    }
-
                     // Truncate stack (remove callee's data)
                     self.stack.truncate(callee_frame.stack_base);
 
+                    if self.frames.len() == entry_depth {
+                        // Entry frame (main or host-called function) returned
+                        return Ok(return_value);
+                    }
+
                     // Store return value in caller's ret vreg
                     if let Some(ret_vreg_idx) = callee_frame.ret_vreg {
                         let caller_stack_base = self.frames.last().unwrap().stack_base;
@@ -1554,22 +3089,41 @@ impl VM {
                     callee,
                     ref args,
                     ret,
+                    site,
                 } => {
-                    let caller_stack_base = self.frames.last().unwrap().stack_base;
+                    // The callee may be converted into `func_cache`, which
+                    // `args` borrows from
+                    let args = args.clone();
+                    let frame = self.frames.last().unwrap();
+                    let (caller_stack_base, caller_func) = (frame.stack_base, frame.func_index);
                     let closure_val = self.stack[caller_stack_base + callee.0];
                     let closure_ref = closure_val
                         .as_ref()
                         .ok_or("runtime error: CallIndirect expects a callable reference")?;
 
-                    let closure_obj = self
+                    let func_index = self
                         .heap
-                        .get(closure_ref)
-                        .ok_or("runtime error: invalid callable reference")?;
-
-                    let func_index = closure_obj.slots[0]
+                        .read_slot(closure_ref, 0)
+                        .ok_or("runtime error: invalid callable reference")?
                         .as_i64()
                         .ok_or("runtime error: callable slot 0 must be func_index")?
                         as usize;
+                    self.inline_caches
+                        .call(caller_func, site)
+                        .insert(func_index, ());
+
+                    #[cfg(all(
+                        any(target_arch = "aarch64", target_arch = "x86_64"),
+                        feature = "jit"
+                    ))]
+                    if let Some(result) =
+                        self.try_jit_call(func_index, Some(closure_val), &args, chunk)?
+                    {
+                        if let Some(ret_v) = ret {
+                            self.stack[caller_stack_base + ret_v.0] = result;
+                        }
+                        continue;
+                    }
 
                     let callee_func = &chunk.functions[func_index];
 
@@ -1579,7 +3133,7 @@ impl VM {
                     }
                     if func_cache[func_index].is_none() {
                         func_cache[func_index] =
-                            Some(microop_converter::convert(&chunk.functions[func_index]));
+                            Some(superinstructions::convert(&chunk.functions[func_index]));
                     }
                     let callee_temps = func_cache[func_index].as_ref().unwrap().temps_count;
                     let callee_regs = callee_func.locals_count + callee_temps;
@@ -1611,12 +3165,31 @@ impl VM {
                     func_idx,
                     ref args,
                     ret,
+                    site,
                 } => {
-                    let caller_stack_base = self.frames.last().unwrap().stack_base;
+                    // The callee may be converted into `func_cache`, which
+                    // `args` borrows from
+                    let args = args.clone();
+                    let frame = self.frames.last().unwrap();
+                    let (caller_stack_base, caller_func) = (frame.stack_base, frame.func_index);
                     let func_index = self.stack[caller_stack_base + func_idx.0]
                         .as_i64()
                         .ok_or("runtime error: CallDynamic expects func_index as integer")?
                         as usize;
+                    self.inline_caches
+                        .call(caller_func, site)
+                        .insert(func_index, ());
+
+                    #[cfg(all(
+                        any(target_arch = "aarch64", target_arch = "x86_64"),
+                        feature = "jit"
+                    ))]
+                    if let Some(result) = self.try_jit_call(func_index, None, &args, chunk)? {
+                        if let Some(ret_v) = ret {
+                            self.stack[caller_stack_base + ret_v.0] = result;
+                        }
+                        continue;
+                    }
 
                     let callee_func = &chunk.functions[func_index];
 
@@ -1626,7 +3199,7 @@ impl VM {
                     }
                     if func_cache[func_index].is_none() {
                         func_cache[func_index] =
-                            Some(microop_converter::convert(&chunk.functions[func_index]));
+                            Some(superinstructions::convert(&chunk.functions[func_index]));
                     }
                     let callee_temps = func_cache[func_index].as_ref().unwrap().temps_count;
                     let callee_regs = callee_func.locals_count + callee_temps;
@@ -1720,6 +3293,7 @@ impl VM {
                     let r = self.stack[sb + dst_obj.0]
                         .as_ref()
                         .ok_or("runtime error: expected reference")?;
+                    self.field_write_barrier(r, offset, value);
                     self.heap.write_slot(r, offset, value).map_err(|e| {
                         format!("runtime error: slot index {} out of bounds ({})", offset, e)
                     })?;
@@ -1741,6 +3315,7 @@ impl VM {
                     if index < 0 {
                         return Err(format!("runtime error: slot index {} out of bounds", index));
                     }
+                    self.field_write_barrier(r, index as usize, value);
                     if elem_kind.is_typed() {
                         let raw = value.encode().1; // payload only
                         self.heap.write_typed(r, index as usize, raw).map_err(|e| {
@@ -1828,6 +3403,7 @@ impl VM {
                     if index < 0 {
                         return Err(format!("runtime error: slot index {} out of bounds", index));
                     }
+                    self.field_write_barrier(ptr_ref, index as usize, value);
                     // Use the actual header's elem_kind to determine storage format
                     let actual_kind = self.heap.get_elem_kind(ptr_ref);
                     if actual_kind.is_typed() {
@@ -1908,50 +3484,143 @@ impl VM {
                     dst,
                     type_info,
                     iface_desc,
+                    site,
                 } => {
-                    let sb = self.frames.last().unwrap().stack_base;
+                    let frame = self.frames.last().unwrap();
+                    let (sb, func_index) = (frame.stack_base, frame.func_index);
                     let ti_ref = self.stack[sb + type_info.0]
                         .as_ref()
                         .ok_or("runtime error: VtableLookup expects type_info reference")?;
                     let iface_ref = self.stack[sb + iface_desc.0]
                         .as_ref()
                         .ok_or("runtime error: VtableLookup expects iface_desc reference")?;
-                    let result = self.vtable_lookup(ti_ref, iface_ref)?;
-                    let sb = self.frames.last().unwrap().stack_base;
+                    let result =
+                        self.cached_vtable_lookup(func_index, Some(site), ti_ref, iface_ref)?;
                     self.stack[sb + dst.0] = result;
                 }
-                MicroOp::HeapAlloc { dst, args } => {
+                MicroOp::HeapAlloc { dst, ref args } => {
                     let sb = self.frames.last().unwrap().stack_base;
                     let slots: Vec<Value> = args.iter().map(|a| self.stack[sb + a.0]).collect();
                     let r = self.heap.alloc_slots(slots)?;
                     let sb = self.frames.last().unwrap().stack_base;
                     self.stack[sb + dst.0] = Value::Ref(r);
                 }
-                MicroOp::HeapAllocDynSimple {
-                    dst,
-                    size,
-                    elem_kind,
-                } => {
+                MicroOp::HeapAllocDynSimple {
+                    dst,
+                    size,
+                    elem_kind,
+                } => {
+                    let sb = self.frames.last().unwrap().stack_base;
+                    let size_val = self.stack[sb + size.0]
+                        .as_i64()
+                        .ok_or("runtime error: HeapAllocDynSimple requires integer size")?
+                        as usize;
+                    let r = if elem_kind.is_typed() {
+                        self.heap.alloc_typed_array(size_val as u32, elem_kind)?
+                    } else {
+                        let slots = vec![Value::Null; size_val];
+                        self.heap.alloc_slots(slots)?
+                    };
+                    self.stack[sb + dst.0] = Value::Ref(r);
+                }
+                MicroOp::HeapBulk { dst, op, ref args } => {
+                    let sb = self.frames.last().unwrap().stack_base;
+                    let values: Vec<Value> = args.iter().map(|a| self.stack[sb + a.0]).collect();
+                    let result = self.heap_bulk(op, &values)?;
+                    if let (Some(dst), Some(result)) = (dst, result) {
+                        self.stack[sb + dst.0] = result;
+                    }
+                }
+                MicroOp::CmpI64BrIfFalse {
+                    dst,
+                    a,
+                    b,
+                    cond,
+                    target,
+                } => {
+                    let sb = self.frames.last().unwrap().stack_base;
+                    let va = self.stack[sb + a.0];
+                    let vb = self.stack[sb + b.0];
+                    let result = match cond {
+                        CmpCond::Eq => self.values_equal(&va, &vb),
+                        CmpCond::Ne => !self.values_equal(&va, &vb),
+                        _ => cond.holds(self.compare(&va, &vb)?, 0),
+                    };
+                    self.stack[sb + dst.0] = Value::Bool(result);
+                    self.frames.last_mut().unwrap().pc = if result { pc + 2 } else { target };
+                }
+                MicroOp::CmpI64ImmBrIfFalse {
+                    dst,
+                    a,
+                    imm,
+                    cond,
+                    target,
+                } => {
+                    let sb = self.frames.last().unwrap().stack_base;
+                    let va = self.stack[sb + a.0].as_i64().ok_or("expected integer")?;
+                    let result = cond.holds(va, imm);
+                    self.stack[sb + dst.0] = Value::Bool(result);
+                    self.frames.last_mut().unwrap().pc = if result { pc + 2 } else { target };
+                }
+                MicroOp::CmpF64BrIfFalse {
+                    dst,
+                    a,
+                    b,
+                    cond,
+                    target,
+                } => {
+                    let sb = self.frames.last().unwrap().stack_base;
+                    let va = self.stack[sb + a.0].as_f64().ok_or("expected float")?;
+                    let vb = self.stack[sb + b.0].as_f64().ok_or("expected float")?;
+                    let result = cond.holds(va, vb);
+                    self.stack[sb + dst.0] = Value::Bool(result);
+                    self.frames.last_mut().unwrap().pc = if result { pc + 2 } else { target };
+                }
+                MicroOp::MulF64AddF64 { tmp, a, b, c, dst } => {
+                    let sb = self.frames.last().unwrap().stack_base;
+                    let va = self.stack[sb + a.0].as_f64().ok_or("expected float")?;
+                    let vb = self.stack[sb + b.0].as_f64().ok_or("expected float")?;
+                    self.stack[sb + tmp.0] = Value::F64(va * vb);
+                    let vc = self.stack[sb + c.0].as_f64().ok_or("expected float")?;
+                    self.stack[sb + dst.0] = Value::F64(va * vb + vc);
+                    self.frames.last_mut().unwrap().pc = pc + 2;
+                }
+                MicroOp::ConstF64MulF64 { tmp, imm, dst, a } => {
+                    let sb = self.frames.last().unwrap().stack_base;
+                    self.stack[sb + tmp.0] = Value::F64(imm);
+                    let va = self.stack[sb + a.0].as_f64().ok_or("expected float")?;
+                    self.stack[sb + dst.0] = Value::F64(va * imm);
+                    self.frames.last_mut().unwrap().pc = pc + 2;
+                }
+                MicroOp::ConstF64DivF64 { tmp, imm, dst, a } => {
                     let sb = self.frames.last().unwrap().stack_base;
-                    let size_val = self.stack[sb + size.0]
-                        .as_i64()
-                        .ok_or("runtime error: HeapAllocDynSimple requires integer size")?
-                        as usize;
-                    let r = if elem_kind.is_typed() {
-                        self.heap.alloc_typed_array(size_val as u32, elem_kind)?
+                    self.stack[sb + tmp.0] = Value::F64(imm);
+                    self.frames.last_mut().unwrap().pc = pc + 2;
+                    let va = self.stack[sb + a.0].as_f64().ok_or("expected float")?;
+                    if imm == 0.0 {
+                        return Err("runtime error: division by zero".to_string());
+                    }
+                    self.stack[sb + dst.0] = Value::F64(va / imm);
+                }
+                MicroOp::Raw { ref op } => {
+                    // Instead of blocking its worker, a green thread yields
+                    // and retries the op on a later time slice
+                    let polled = if self.green_entry_depth == Some(entry_depth) {
+                        self.poll_blocking_op(op)
                     } else {
-                        let slots = vec![Value::Null; size_val];
-                        self.heap.alloc_slots(slots)?
+                        OpPoll::Run
                     };
-                    self.stack[sb + dst.0] = Value::Ref(r);
-                }
-                MicroOp::Raw { op } => {
-                    // Profile if enabled
-                    if self.profile_opcodes {
-                        *self.opcode_profile.counts.entry(op.name()).or_insert(0) += 1;
+                    if polled == OpPoll::Blocked {
+                        self.frames.last_mut().unwrap().pc = pc;
+                        self.task_yield = Some(TaskStatus::Blocked);
+                        return Ok(Value::Null);
+                    }
+
+                    if polled == OpPoll::Done {
+                        continue;
                     }
 
-                    match self.execute_op(op, chunk) {
+                    match self.execute_op(op.clone(), chunk) {
                         Ok(ControlFlow::Continue) => {}
                         Ok(_) => {
                             // Control flow ops should never be Raw
@@ -2246,56 +3915,28 @@ impl VM {
                 MicroOp::CmpI64Imm { dst, a, imm, cond } => {
                     let sb = self.frames.last().unwrap().stack_base;
                     let va = self.stack[sb + a.0].as_i64().ok_or("expected integer")?;
-                    let result = match cond {
-                        CmpCond::Eq => va == imm,
-                        CmpCond::Ne => va != imm,
-                        CmpCond::LtS => va < imm,
-                        CmpCond::LeS => va <= imm,
-                        CmpCond::GtS => va > imm,
-                        CmpCond::GeS => va >= imm,
-                    };
+                    let result = cond.holds(va, imm);
                     self.stack[sb + dst.0] = Value::Bool(result);
                 }
                 MicroOp::CmpI32 { dst, a, b, cond } => {
                     let sb = self.frames.last().unwrap().stack_base;
                     let va = self.stack[sb + a.0].as_i64().ok_or("expected integer")? as i32;
                     let vb = self.stack[sb + b.0].as_i64().ok_or("expected integer")? as i32;
-                    let result = match cond {
-                        CmpCond::Eq => va == vb,
-                        CmpCond::Ne => va != vb,
-                        CmpCond::LtS => va < vb,
-                        CmpCond::LeS => va <= vb,
-                        CmpCond::GtS => va > vb,
-                        CmpCond::GeS => va >= vb,
-                    };
+                    let result = cond.holds(va, vb);
                     self.stack[sb + dst.0] = Value::Bool(result);
                 }
                 MicroOp::CmpF64 { dst, a, b, cond } => {
                     let sb = self.frames.last().unwrap().stack_base;
                     let va = self.stack[sb + a.0].as_f64().ok_or("expected float")?;
                     let vb = self.stack[sb + b.0].as_f64().ok_or("expected float")?;
-                    let result = match cond {
-                        CmpCond::Eq => va == vb,
-                        CmpCond::Ne => va != vb,
-                        CmpCond::LtS => va < vb,
-                        CmpCond::LeS => va <= vb,
-                        CmpCond::GtS => va > vb,
-                        CmpCond::GeS => va >= vb,
-                    };
+                    let result = cond.holds(va, vb);
                     self.stack[sb + dst.0] = Value::Bool(result);
                 }
                 MicroOp::CmpF32 { dst, a, b, cond } => {
                     let sb = self.frames.last().unwrap().stack_base;
                     let va = self.stack[sb + a.0].as_f64().ok_or("expected float")? as f32;
                     let vb = self.stack[sb + b.0].as_f64().ok_or("expected float")? as f32;
-                    let result = match cond {
-                        CmpCond::Eq => va == vb,
-                        CmpCond::Ne => va != vb,
-                        CmpCond::LtS => va < vb,
-                        CmpCond::LeS => va <= vb,
-                        CmpCond::GtS => va > vb,
-                        CmpCond::GeS => va >= vb,
-                    };
+                    let result = cond.holds(va, vb);
                     self.stack[sb + dst.0] = Value::Bool(result);
                 }
 
@@ -2390,8 +4031,6 @@ impl VM {
                 }
             }
         }
-
-        Ok(())
     }
 
     fn execute_op(&mut self, op: Op, chunk: &Chunk) -> Result<ControlFlow, String> {
@@ -2885,9 +4524,7 @@ impl VM {
 
                 // Detect backward branch (loop)
                 if target < current_pc {
-                    let key = (func_index, current_pc);
-                    let count = self.loop_counts.entry(key).or_insert(0);
-                    *count += 1;
+                    self.count_back_edge(chunk, func_index, current_pc);
 
                     // Loop range: start_pc = target, end_pc = current_pc
                     let loop_start_pc = target;
@@ -2933,11 +4570,13 @@ impl VM {
                             } else {
                                 &chunk.functions[func_index]
                             };
-                            let next_pc =
-                                self.execute_jit_loop(func_index, current_pc, func, chunk)?;
-                            let frame = self.frames.last_mut().unwrap();
-                            frame.pc = next_pc;
-                            return Ok(ControlFlow::Continue);
+                            if let Some(next_pc) =
+                                self.execute_jit_loop(func_index, current_pc, func, chunk)?
+                            {
+                                let frame = self.frames.last_mut().unwrap();
+                                frame.pc = next_pc;
+                                return Ok(ControlFlow::Continue);
+                            }
                         }
                     }
 
@@ -2949,11 +4588,13 @@ impl VM {
                             } else {
                                 &chunk.functions[func_index]
                             };
-                            let next_pc =
-                                self.execute_jit_loop(func_index, current_pc, func, chunk)?;
-                            let frame = self.frames.last_mut().unwrap();
-                            frame.pc = next_pc;
-                            return Ok(ControlFlow::Continue);
+                            if let Some(next_pc) =
+                                self.execute_jit_loop(func_index, current_pc, func, chunk)?
+                            {
+                                let frame = self.frames.last_mut().unwrap();
+                                frame.pc = next_pc;
+                                return Ok(ControlFlow::Continue);
+                            }
                         }
                     }
                 }
@@ -2990,7 +4631,7 @@ impl VM {
                 #[cfg(all(target_arch = "x86_64", feature = "jit"))]
                 {
                     if self.should_jit_compile(func_index, &func.name) {
-                        self.jit_compile_function(func, func_index, &chunk.functions);
+                        self.jit_compile_function(func_index, chunk);
                     }
 
                     // If JIT compiled, execute via JIT
@@ -3004,7 +4645,7 @@ impl VM {
                 #[cfg(all(target_arch = "aarch64", feature = "jit"))]
                 {
                     if self.should_jit_compile(func_index, &func.name) {
-                        self.jit_compile_function(func, func_index);
+                        self.jit_compile_function(func_index, chunk);
                     }
 
                     // If JIT compiled, execute via JIT
@@ -3018,6 +4659,7 @@ impl VM {
                 // Fall back to interpreter
                 let new_stack_base = self.stack.len() - argc;
 
+                self.reserve_locals(new_stack_base, func.locals_count);
                 self.frames.push(Frame {
                     func_index,
                     pc: 0,
@@ -3092,56 +4734,38 @@ impl VM {
             }
             Op::GcHint(_bytes) => {
                 // Hint about upcoming allocation - might trigger GC
-                if self.heap.should_gc() {
-                    self.collect_garbage();
-                }
+                self.gc_safepoint();
             }
 
-            // Thread operations
+            // Thread operations. Each flushes buffered output first, so it is
+            // ordered with the output of the threads it synchronizes with.
             Op::ThreadSpawn(func_index) => {
-                // Clone the chunk for the new thread
-                let chunk_clone = chunk.clone();
-
-                // Spawn a new thread that creates a VM and runs the function
-                let thread_id = self.thread_spawner.spawn(move || {
-                    let mut vm = VM::new();
-
-                    // Create a wrapper main that calls the target function and captures return
-                    // The wrapper just calls the function and returns its result
-                    let wrapper_main = Function {
-                        name: "__thread_main__".to_string(),
-                        arity: 0,
-                        locals_count: 1, // To store return value
-                        code: vec![
-                            Op::Call(func_index, 0), // Call the target function (must be 0-arity)
-                            Op::Ret,                 // Return the result
-                        ],
-                        stackmap: None,
-                        local_types: vec![],
-                    };
-
-                    let thread_chunk = Chunk {
-                        functions: chunk_clone.functions.clone(),
-                        main: wrapper_main,
-                        strings: chunk_clone.strings.clone(),
-                        type_descriptors: chunk_clone.type_descriptors.clone(),
-                        interface_descriptors: chunk_clone.interface_descriptors.clone(),
-                        debug: None,
-                    };
-
-                    match vm.run_and_get_result(&thread_chunk) {
-                        Ok(result) => result,
-                        Err(_e) => Value::Null,
-                    }
-                });
+                let _ = self.flush_output();
+                // The new thread shares the chunk and JIT code instead of copying them
+                let image = self.thread_image(chunk);
+                let mut thread = GreenThread::new(image, func_index);
+                let thread_id = self
+                    .thread_spawner
+                    .spawn_green(Box::new(move || thread.resume()));
 
                 // Push the thread handle ID as the result
                 self.stack.push(Value::I64(thread_id as i64));
             }
-            Op::ChannelCreate => {
+            Op::ChannelCreate | Op::ChannelCreateBounded => {
                 // Create a new channel and return [sender_id, receiver_id]
                 // For simplicity, we use the same id for both (same underlying channel)
-                let channel = Channel::new();
+                let channel = if matches!(op, Op::ChannelCreateBounded) {
+                    let capacity = self.pop_int()?;
+                    if !(1..=MAX_CHANNEL_CAPACITY as i64).contains(&capacity) {
+                        return Err(format!(
+                            "runtime error: channel capacity must be between 1 and {}, got {}",
+                            MAX_CHANNEL_CAPACITY, capacity
+                        ));
+                    }
+                    Channel::bounded(capacity as usize)
+                } else {
+                    Channel::new()
+                };
                 let id = self.channels.len();
                 self.channels.push(channel);
 
@@ -3152,32 +4776,51 @@ impl VM {
                 self.stack.push(Value::Ref(arr));
             }
             Op::ChannelSend => {
+                let _ = self.flush_output();
                 let value = self.stack.pop().ok_or("stack underflow")?;
                 let channel_id = self.pop_int()? as usize;
-
-                let channel = self
-                    .channels
-                    .get(channel_id)
-                    .ok_or_else(|| format!("runtime error: channel {} not found", channel_id))?
-                    .clone();
+                let channel = self.channel(channel_id)?;
 
                 channel
                     .send(value)
                     .map_err(|_| "runtime error: channel closed")?;
             }
             Op::ChannelRecv => {
+                let _ = self.flush_output();
                 let channel_id = self.pop_int()? as usize;
-
-                let channel = self
-                    .channels
-                    .get(channel_id)
-                    .ok_or_else(|| format!("runtime error: channel {} not found", channel_id))?
-                    .clone();
+                let channel = self.channel(channel_id)?;
 
                 let value = channel.recv().unwrap_or(Value::Null);
                 self.stack.push(value);
+                self.release_async(channel_id);
+            }
+            Op::ChannelSendMany => {
+                let _ = self.flush_output();
+                let count = self.pop_int()?;
+                let data = self.stack.pop().ok_or("stack underflow")?;
+                let channel_id = self.pop_int()? as usize;
+                let channel = self.channel(channel_id)?;
+
+                let values = self.batch_values(data, count)?;
+                channel
+                    .send_many(values)
+                    .map_err(|_| "runtime error: channel closed")?;
+            }
+            Op::ChannelRecvMany => {
+                let _ = self.flush_output();
+                let max = self.pop_int()?;
+                let data = self.stack.pop().ok_or("stack underflow")?;
+                let channel_id = self.pop_int()? as usize;
+                let channel = self.channel(channel_id)?;
+
+                let max = self.batch_capacity(data, max)?;
+                let mut values = Vec::with_capacity(max);
+                channel.recv_many(max, &mut values);
+                self.store_batch(data, &values)?;
+                self.stack.push(Value::I64(values.len() as i64));
             }
             Op::ThreadJoin => {
+                let _ = self.flush_output();
                 let thread_id = self.pop_int()? as usize;
 
                 let result = self.thread_spawner.join(thread_id)?;
@@ -3208,6 +4851,7 @@ impl VM {
                 let value = self.stack.pop().ok_or("stack underflow")?;
                 let val = self.stack.pop().ok_or("stack underflow")?;
                 let r = val.as_ref().ok_or("runtime error: expected reference")?;
+                self.field_write_barrier(r, offset, value);
                 self.heap.write_slot(r, offset, value).map_err(|e| {
                     format!("runtime error: slot index {} out of bounds ({})", offset, e)
                 })?;
@@ -3247,6 +4891,7 @@ impl VM {
                 if index < 0 {
                     return Err(format!("runtime error: slot index {} out of bounds", index));
                 }
+                self.field_write_barrier(r, index as usize, value);
                 if ek.is_typed() {
                     let raw = value.encode().1; // payload only
                     self.heap
@@ -3293,6 +4938,7 @@ impl VM {
                 if index < 0 {
                     return Err(format!("runtime error: slot index {} out of bounds", index));
                 }
+                self.field_write_barrier(ptr_ref, index as usize, value);
                 self.heap
                     .write_slot(ptr_ref, index as usize, value)
                     .map_err(|e| format!("runtime error: {}", e))?;
@@ -3310,6 +4956,17 @@ impl VM {
                 let new_ref = r.with_added_slot_offset(offset as usize);
                 self.stack.push(Value::Ref(new_ref));
             }
+            Op::HeapBulk(op) => {
+                let base = self
+                    .stack
+                    .len()
+                    .checked_sub(op.arity())
+                    .ok_or("stack underflow")?;
+                let args: Vec<Value> = self.stack.drain(base..).collect();
+                if let Some(result) = self.heap_bulk(op, &args)? {
+                    self.stack.push(result);
+                }
+            }
             Op::HeapAllocDyn => {
                 // Pop size from stack, then pop that many elements as initial values
                 let size_val = self.stack.pop().ok_or("stack underflow")?;
@@ -3397,11 +5054,10 @@ impl VM {
                     .ok_or("runtime error: CallIndirect expects a callable reference")?;
 
                 // Read func_index from heap slot 0
-                let closure_obj = self
+                let func_index = self
                     .heap
-                    .get(closure_ref)
-                    .ok_or("runtime error: invalid callable reference")?;
-                let func_index = closure_obj.slots[0]
+                    .read_slot(closure_ref, 0)
+                    .ok_or("runtime error: invalid callable reference")?
                     .as_i64()
                     .ok_or("runtime error: callable slot 0 must be func_index (integer)")?
                     as usize;
@@ -3410,15 +5066,18 @@ impl VM {
                 let expected_arity = func.arity; // 1 (closure_ref) + user args
                 let total_args = 1 + argc;
 
-                if total_args != expected_arity {
-                    return Err(format!(
-                        "runtime error: function '{}' expects {} arguments (1 closure_ref + {} params), got 1 + {} args",
-                        func.name,
-                        expected_arity,
-                        expected_arity - 1,
-                        argc
-                    ));
-                }
+                self.check_call_site(chunk, func_index, || {
+                    if total_args != expected_arity {
+                        return Err(format!(
+                            "runtime error: function '{}' expects {} arguments (1 closure_ref + {} params), got 1 + {} args",
+                            func.name,
+                            expected_arity,
+                            expected_arity - 1,
+                            argc
+                        ));
+                    }
+                    Ok(())
+                })?;
 
                 // Slot 0: closure_ref, slots 1..: user args
                 let new_stack_base = self.stack.len();
@@ -3427,6 +5086,7 @@ impl VM {
                     self.stack.push(arg);
                 }
 
+                self.reserve_locals(new_stack_base, func.locals_count);
                 self.frames.push(Frame {
                     func_index,
                     pc: 0,
@@ -3459,18 +5119,22 @@ impl VM {
                     as usize;
 
                 let func = &chunk.functions[func_index];
-                if func.arity != argc {
-                    return Err(format!(
-                        "runtime error: function '{}' expects {} arguments, got {}",
-                        func.name, func.arity, argc
-                    ));
-                }
+                self.check_call_site(chunk, func_index, || {
+                    if func.arity != argc {
+                        return Err(format!(
+                            "runtime error: function '{}' expects {} arguments, got {}",
+                            func.name, func.arity, argc
+                        ));
+                    }
+                    Ok(())
+                })?;
 
                 let new_stack_base = self.stack.len();
                 for arg in args {
                     self.stack.push(arg);
                 }
 
+                self.reserve_locals(new_stack_base, func.locals_count);
                 self.frames.push(Frame {
                     func_index,
                     pc: 0,
@@ -3505,7 +5169,9 @@ impl VM {
                     .as_ref()
                     .ok_or("runtime error: VtableLookup expects iface_desc reference")?;
 
-                let result = self.vtable_lookup(ti_ref, iface_ref)?;
+                let func_index = self.frames.last().map_or(usize::MAX, |f| f.func_index);
+                let site = self.current_op_site(chunk);
+                let result = self.cached_vtable_lookup(func_index, site, ti_ref, iface_ref)?;
                 self.stack.push(result);
             }
         }
@@ -3513,6 +5179,62 @@ impl VM {
         Ok(ControlFlow::Continue)
     }
 
+    /// Inline cache site index of the op the stack interpreter just fetched.
+    fn current_op_site(&mut self, chunk: &Chunk) -> Option<usize> {
+        let frame = self.frames.last()?;
+        let code = if frame.func_index == usize::MAX {
+            &chunk.main.code
+        } else {
+            &chunk.functions[frame.func_index].code
+        };
+        self.inline_caches
+            .op_site(frame.func_index, frame.pc.checked_sub(1)?, code)
+    }
+
+    /// Run `check` the first time the call the stack interpreter just fetched
+    /// reaches `func_index`, and cache the callee once it passes.
+    fn check_call_site(
+        &mut self,
+        chunk: &Chunk,
+        func_index: usize,
+        check: impl FnOnce() -> Result<(), String>,
+    ) -> Result<(), String> {
+        let Some(site) = self.current_op_site(chunk) else {
+            return check();
+        };
+        let caller = self.frames.last().unwrap().func_index;
+        let cache = self.inline_caches.call(caller, site);
+        if cache.get(func_index).is_none() {
+            check()?;
+            cache.insert(func_index, ());
+        }
+        Ok(())
+    }
+
+    /// `vtable_lookup` through the inline cache of vtable site `site` in
+    /// `func_index`. Type_info objects are globals, so a cached pair stays
+    /// valid for the life of the chunk.
+    fn cached_vtable_lookup(
+        &mut self,
+        func_index: usize,
+        site: Option<usize>,
+        ti_ref: GcRef,
+        iface_ref: GcRef,
+    ) -> Result<Value, String> {
+        let Some(site) = site else {
+            return self.vtable_lookup(ti_ref, iface_ref);
+        };
+        let key = (ti_ref, iface_ref);
+        if let Some(vtable) = self.inline_caches.vtable(func_index, site).get(key) {
+            return Ok(vtable);
+        }
+        let vtable = self.vtable_lookup(ti_ref, iface_ref)?;
+        self.inline_caches
+            .vtable(func_index, site)
+            .insert(key, vtable);
+        Ok(vtable)
+    }
+
     /// Look up an interface vtable in a type_info heap object.
     /// Walks the vtable entries comparing iface_desc_ref by pointer equality.
     /// Returns vtable_ref (Value::Ref) if found, or Value::Null if not.
@@ -3554,6 +5276,13 @@ impl VM {
             (Value::Ref(a), Value::Ref(b)) => {
                 // String concatenation fallback for cases where codegen
                 // couldn't statically detect Ref+Ref (e.g. array indexing)
+                if let (Some(a_bytes), Some(b_bytes)) =
+                    (self.heap.string_bytes(a), self.heap.string_bytes(b))
+                {
+                    let bytes = [a_bytes, b_bytes].concat();
+                    let r = self.heap.alloc_string_bytes(&bytes)?;
+                    return Ok(Value::Ref(r));
+                }
                 let a_obj = self.heap.get(a).ok_or("runtime error: invalid reference")?;
                 let b_obj = self.heap.get(b).ok_or("runtime error: invalid reference")?;
                 let a_data_ref = a_obj.slots[0]
@@ -3728,6 +5457,9 @@ impl VM {
     /// Convert a heap GcRef (String struct [ptr, len]) to a Rust String.
     /// Follows the ptr to the data array and reads character slots.
     fn ref_to_rust_string(&self, r: GcRef) -> Result<String, String> {
+        if let Some(bytes) = self.heap.string_bytes(r) {
+            return Ok(String::from_utf8_lossy(bytes).into_owned());
+        }
         let obj = self
             .heap
             .get(r)
@@ -3756,6 +5488,96 @@ impl VM {
         value.as_i64().ok_or_else(|| "expected integer".to_string())
     }
 
+    /// Create the one-value channel of an async host result and return its
+    /// id along with the channel.
+    ///
+    /// The id is handed back for reuse once moca code has received the
+    /// result (or the null of a cancelled one), so a long run of async calls
+    /// keeps the channel table bounded.
+    pub fn create_async_channel(&mut self) -> (i64, Arc<Channel<Value>>) {
+        let channel = Channel::bounded(1);
+        let id = match self.free_async.pop() {
+            Some(id) => {
+                self.channels[id] = channel.clone();
+                id
+            }
+            None => {
+                self.channels.push(channel.clone());
+                self.channels.len() - 1
+            }
+        };
+        self.pending_async.insert(id);
+        (id as i64, channel)
+    }
+
+    /// Free the id of an async result that has just been received.
+    fn release_async(&mut self, channel_id: usize) {
+        if self.pending_async.remove(&channel_id) {
+            self.free_async.push(channel_id);
+        }
+    }
+
+    /// Number of channel ids this VM has handed out.
+    pub fn channel_count(&self) -> usize {
+        self.channels.len()
+    }
+
+    /// Look up a channel by the id `ChannelCreate` handed out.
+    fn channel(&self, channel_id: usize) -> Result<Arc<Channel<Value>>, String> {
+        self.channels
+            .get(channel_id)
+            .cloned()
+            .ok_or_else(|| format!("runtime error: channel {} not found", channel_id))
+    }
+
+    /// The values `data[0..count]` sent by a `ChannelSendMany`.
+    fn batch_values(&self, data: Value, count: i64) -> Result<Vec<Value>, String> {
+        if count <= 0 {
+            return Ok(Vec::new());
+        }
+        let r = data.as_ref().ok_or("runtime error: expected reference")?;
+        (0..count as usize)
+            .map(|i| {
+                self.heap
+                    .read_slot(r, i)
+                    .ok_or_else(|| format!("runtime error: slot index {} out of bounds", i))
+            })
+            .collect()
+    }
+
+    /// How many values a `ChannelRecvMany` of up to `max` may store in
+    /// `data`; checked before receiving so no message is lost.
+    fn batch_capacity(&self, data: Value, max: i64) -> Result<usize, String> {
+        if max <= 0 {
+            return Ok(0);
+        }
+        let r = data.as_ref().ok_or("runtime error: expected reference")?;
+        let room = self
+            .heap
+            .slot_count(r)
+            .unwrap_or(0)
+            .saturating_sub(r.slot_offset());
+        if room < max as usize {
+            return Err(format!(
+                "runtime error: receive buffer holds {} values, asked for {}",
+                room, max
+            ));
+        }
+        Ok(max as usize)
+    }
+
+    /// Store the values received by a `ChannelRecvMany` in `data[0..]`.
+    fn store_batch(&mut self, data: Value, values: &[Value]) -> Result<(), String> {
+        let Some(r) = data.as_ref() else {
+            return Ok(());
+        };
+        for (i, &value) in values.iter().enumerate() {
+            self.field_write_barrier(r, i, value);
+            self.heap.write_slot(r, i, value)?;
+        }
+        Ok(())
+    }
+
     fn pop_float(&mut self) -> Result<f64, String> {
         let value = self.stack.pop().ok_or("stack underflow")?;
         match value {
@@ -3795,21 +5617,193 @@ impl VM {
 
     /// Write barrier for GC - called before overwriting a reference.
     ///
-    /// For stop-the-world GC, this is a no-op. When concurrent GC is enabled,
-    /// this implements the SATB (Snapshot-At-The-Beginning) barrier to ensure
-    /// the old value is not lost during concurrent marking.
+    /// While an incremental mark is in progress this implements the SATB
+    /// (Snapshot-At-The-Beginning) barrier: the old value is recorded so it is
+    /// not lost to marking. Otherwise it is a no-op.
     ///
     /// This barrier must be called at:
     /// - SETL: before storing to a local variable
     /// - SETF: before storing to an object field
+    ///
+    /// Stack slots are snapshotted as roots when marking starts, so only the
+    /// SETF barrier is required for correctness.
     #[inline]
-    fn write_barrier(&self, _old_value: Value) {
-        // No-op for stop-the-world GC.
-        // When concurrent GC is integrated, this will call:
-        // self.concurrent_gc.write_barrier(old_value);
+    fn write_barrier(&self, old_value: Value) {
+        self.concurrent_gc.write_barrier(old_value);
     }
 
-    fn collect_garbage(&mut self) {
+    /// SETF write barrier for storing `value` into element `index` of heap
+    /// object `r`.
+    ///
+    /// Records `r` in the remembered set when a reference is stored, and the
+    /// overwritten value while an incremental mark is in progress.
+    #[inline]
+    fn field_write_barrier(&mut self, r: GcRef, index: usize, value: Value) {
+        if matches!(value, Value::Ref(_)) {
+            self.heap.remember(r);
+        }
+        if !self.concurrent_gc.is_marking() {
+            return;
+        }
+        let old_value = match self.heap.get_elem_kind(r) {
+            ElemKind::Tagged => self.heap.read_slot(r, index),
+            ElemKind::Ref => self.heap.read_typed(r, index).map(|raw| {
+                Value::Ref(GcRef {
+                    index: raw as usize,
+                })
+            }),
+            // Primitive elements hold no references
+            _ => None,
+        };
+        if let Some(old_value) = old_value {
+            self.write_barrier(old_value);
+        }
+    }
+
+    /// Write barrier for a bulk store into `r[start..start + count]`;
+    /// `stores_refs` says whether the stored elements may be references.
+    fn bulk_write_barrier(&mut self, r: GcRef, start: usize, count: usize, stores_refs: bool) {
+        if !matches!(self.heap.get_elem_kind(r), ElemKind::Tagged | ElemKind::Ref) {
+            return;
+        }
+        if stores_refs {
+            self.heap.remember(r);
+        }
+        if self.concurrent_gc.is_marking() {
+            for index in start..start.saturating_add(count) {
+                match self.heap.read_slot(r, index) {
+                    Some(old_value) => self.write_barrier(old_value),
+                    None => break,
+                }
+            }
+        }
+    }
+
+    /// Run `HeapBulk(op)` on its operands, in push order. Returns the
+    /// result of the ops that have one.
+    fn heap_bulk(&mut self, op: BulkOp, args: &[Value]) -> Result<Option<Value>, String> {
+        let name = op.name();
+        // Null is accepted for empty ranges
+        let r = |i: usize| match args[i] {
+            Value::Ref(r) => Ok(r),
+            Value::Null => Ok(GcRef { index: 0 }),
+            _ => Err(format!("runtime error: {} expects a reference", name)),
+        };
+        let n = |i: usize| {
+            args[i]
+                .as_i64()
+                .and_then(|v| usize::try_from(v).ok())
+                .ok_or_else(|| format!("runtime error: {} expects a non-negative int", name))
+        };
+        let failed = |e: String| format!("runtime error: {}: {}", name, e);
+        match op {
+            BulkOp::Fill => {
+                let (dst, start, count, value) = (r(0)?, n(1)?, n(2)?, args[3]);
+                self.bulk_write_barrier(dst, start, count, matches!(value, Value::Ref(_)));
+                self.heap
+                    .fill_elems(dst, start, count, value)
+                    .map_err(failed)?;
+                Ok(None)
+            }
+            BulkOp::Copy => {
+                let (dst, dst_start, src, src_start, count) = (r(0)?, n(1)?, r(2)?, n(3)?, n(4)?);
+                self.bulk_write_barrier(dst, dst_start, count, true);
+                self.heap
+                    .copy_elems(dst, dst_start, src, src_start, count)
+                    .map_err(failed)?;
+                Ok(None)
+            }
+            BulkOp::Equal => {
+                let equal = self
+                    .heap
+                    .elems_equal(r(0)?, n(1)?, r(2)?, n(3)?, n(4)?)
+                    .map_err(failed)?;
+                Ok(Some(Value::Bool(equal)))
+            }
+            BulkOp::Find => {
+                let found = self
+                    .heap
+                    .find_elem(r(0)?, n(1)?, n(2)?, args[3])
+                    .map_err(failed)?;
+                Ok(Some(Value::I64(found.map_or(-1, |i| i as i64))))
+            }
+            BulkOp::AddF64 | BulkOp::MulF64 => {
+                self.heap
+                    .map_f64(op, r(0)?, r(1)?, r(2)?, None, n(3)?)
+                    .map_err(failed)?;
+                Ok(None)
+            }
+            BulkOp::FmaF64 => {
+                self.heap
+                    .map_f64(op, r(0)?, r(1)?, r(2)?, Some(r(3)?), n(4)?)
+                    .map_err(failed)?;
+                Ok(None)
+            }
+        }
+    }
+
+    /// GC safepoint, checked between instructions.
+    ///
+    /// Advances an incremental cycle by one bounded step, or starts a
+    /// collection once the heap crosses its threshold. Also takes the
+    /// sampler's call-stack sample when one is due, and reports heap growth
+    /// to the event handler.
+    #[inline]
+    fn gc_safepoint(&mut self) {
+        if let Some(sampler) = &mut self.sampler
+            && sampler.due()
+        {
+            sampler.record(self.frames.iter().map(|frame| frame.func_index));
+        }
+        if self.event_handler.is_some() && self.heap.memory_size() > self.reported_heap_bytes {
+            self.reported_heap_bytes = self.heap.memory_size();
+            self.emit(VmEvent::HeapGrow {
+                heap_bytes: self.reported_heap_bytes,
+            });
+        }
+        if self.heap.gc_in_progress() {
+            self.gc_step();
+        } else if self.heap.should_gc() {
+            if self.incremental_gc {
+                self.start_gc_cycle();
+            } else {
+                self.collect_garbage();
+            }
+        } else if self.heap.should_minor_gc() {
+            self.minor_collect();
+        }
+    }
+
+    /// Collect the nursery only.
+    fn minor_collect(&mut self) {
+        let start = self.begin_gc_pause(true);
+        let roots = self.gc_roots();
+        self.heap.minor_collect(&roots);
+        self.gc_stats.minor_cycles += 1;
+        self.end_gc_pause(true, start);
+    }
+
+    /// Start timing a GC pause.
+    #[inline]
+    fn begin_gc_pause(&mut self, minor: bool) -> std::time::Instant {
+        self.emit(VmEvent::GcStart { minor });
+        std::time::Instant::now()
+    }
+
+    /// Record a GC pause that started at `start`.
+    #[inline]
+    fn end_gc_pause(&mut self, minor: bool, start: std::time::Instant) {
+        let pause = start.elapsed();
+        self.gc_stats.record_pause(pause.as_micros() as u64);
+        self.emit(VmEvent::GcEnd {
+            minor,
+            pause_ns: pause.as_nanos() as u64,
+        });
+    }
+
+    /// All GC roots: the VM stack, cached string constants, globals and
+    /// host globals.
+    fn gc_roots(&self) -> Vec<Value> {
         // Collect all roots from the stack
         let mut roots: Vec<Value> = self.stack.clone();
 
@@ -3822,8 +5816,139 @@ impl VM {
         for val in &self.globals {
             roots.push(*val);
         }
+        roots.extend(self.host_globals.values().copied());
+
+        // Add the references JIT frames copied to the root stack
+        #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+        roots.extend(self.jit_roots.refs().map(Value::Ref));
+
+        roots
+    }
+
+    /// Run a full stop-the-world collection (or finish the incremental cycle
+    /// in progress).
+    fn collect_garbage(&mut self) {
+        if self.heap.gc_in_progress() {
+            self.finish_gc_cycle();
+            return;
+        }
 
+        let start = self.begin_gc_pause(false);
+        let roots = self.gc_roots();
         self.heap.collect(&roots);
+        self.gc_stats.cycles += 1;
+        self.end_gc_pause(false, start);
+    }
+
+    /// Start an incremental cycle: gray the roots and begin allocating marked.
+    fn start_gc_cycle(&mut self) {
+        let start = self.begin_gc_pause(false);
+        let roots = self.gc_roots();
+        self.concurrent_gc.start_initial_mark(&roots);
+        self.heap.begin_incremental_mark();
+        self.end_gc_pause(false, start);
+    }
+
+    /// Advance the incremental cycle by one bounded step.
+    fn gc_step(&mut self) {
+        let start = self.begin_gc_pause(false);
+        self.gc_step_untimed();
+        self.end_gc_pause(false, start);
+    }
+
+    fn gc_step_untimed(&mut self) {
+        let heap = &mut self.heap;
+        match self.concurrent_gc.phase() {
+            GcPhase::ConcurrentMark => {
+                let more = self
+                    .concurrent_gc
+                    .mark_step(|r| heap.mark_object(r), GC_MARK_BATCH);
+                if !more {
+                    // Remark: drain the SATB buffer, then sweep
+                    self.concurrent_gc.start_remark(|r| heap.mark_object(r));
+                    heap.begin_sweep();
+                }
+            }
+            GcPhase::ConcurrentSweep => {
+                if let Some(freed) = heap.sweep_step(GC_SWEEP_BUDGET) {
+                    self.concurrent_gc.complete(freed);
+                    self.gc_stats.cycles += 1;
+                }
+            }
+            GcPhase::Idle | GcPhase::InitialMark | GcPhase::Remark => {}
+        }
+    }
+
+    /// Run the incremental cycle in progress to completion as one pause.
+    fn finish_gc_cycle(&mut self) {
+        if !self.heap.gc_in_progress() {
+            return;
+        }
+        let start = self.begin_gc_pause(false);
+        while self.heap.gc_in_progress() {
+            self.gc_step_untimed();
+        }
+        self.end_gc_pause(false, start);
+    }
+
+    /// Prepare the heap for JIT code.
+    ///
+    /// Compiled code stores to the heap without a write barrier, so it must
+    /// not run while marking is in progress (sweeping may continue), and no
+    /// young object may exist that it could store into an old one: the
+    /// nursery is promoted here, and allocation is pretenured while JIT code
+    /// is on the stack.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    #[inline]
+    fn gc_before_jit(&mut self) {
+        if self.heap.has_young_objects() {
+            self.heap.promote_nursery();
+        }
+        if !self.concurrent_gc.is_marking() {
+            return;
+        }
+        let start = self.begin_gc_pause(false);
+        while self.concurrent_gc.phase() == GcPhase::ConcurrentMark {
+            self.gc_step_untimed();
+        }
+        self.end_gc_pause(false, start);
+    }
+
+    /// Prepare to call into compiled code; returns the pretenure setting
+    /// to hand back to `exit_jit`.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    #[inline]
+    fn enter_jit(&mut self) -> bool {
+        self.jit_roots.enter();
+        self.heap.set_pretenure(true)
+    }
+
+    /// Undo `enter_jit` after compiled code returned.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    #[inline]
+    fn exit_jit(&mut self, pretenure: bool) {
+        self.heap.set_pretenure(pretenure);
+        self.jit_roots.exit();
+    }
+
+    /// GC safepoint in a runtime helper called by compiled code.
+    ///
+    /// Runs a stop-the-world collection once the heap crosses its
+    /// threshold, with the JIT frames rooted through the root stack and the
+    /// helper's `result` on the VM stack. Helper arguments are not rooted,
+    /// so this must run after the helper is done with them. Nothing happens
+    /// while a safepoint overflowed the root stack.
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn jit_gc_safepoint(&mut self, result: Option<Value>) {
+        if !self.heap.should_gc() || !self.jit_roots.is_complete() {
+            return;
+        }
+        let pushed = result.is_some();
+        self.stack.extend(result);
+        self.collect_garbage();
+        if pushed {
+            self.stack.pop();
+        }
     }
 
     /// Handle hostcall instructions
@@ -3834,20 +5959,67 @@ impl VM {
     /// - 4: read(fd, count) -> string (heap ref) or error
     /// - 10: time() -> epoch seconds
     /// - 11: time_nanos() -> epoch nanoseconds
+    ///
+    /// Blocks the calling OS thread while a socket is not ready; green
+    /// threads go through `poll_hostcall` instead.
     fn handle_hostcall(&mut self, hostcall_num: usize, args: &[Value]) -> Result<Value, String> {
-        // Hostcall numbers
-        const HOSTCALL_WRITE: usize = 1;
-        const HOSTCALL_OPEN: usize = 2;
-        const HOSTCALL_CLOSE: usize = 3;
-        const HOSTCALL_READ: usize = 4;
-        const HOSTCALL_SOCKET: usize = 5;
-        const HOSTCALL_CONNECT: usize = 6;
-        const HOSTCALL_BIND: usize = 7;
-        const HOSTCALL_LISTEN: usize = 8;
-        const HOSTCALL_ACCEPT: usize = 9;
-        const HOSTCALL_TIME: usize = 10;
-        const HOSTCALL_TIME_NANOS: usize = 11;
+        loop {
+            match self.try_hostcall(hostcall_num, args)? {
+                HostcallPoll::Ready(value) => return Ok(value),
+                HostcallPoll::Pending(fd, interest) => vm_io::wait(fd, interest),
+            }
+        }
+    }
+
+    /// Run a read, accept or connect hostcall on a green thread without
+    /// blocking its worker: if the socket is not ready, register with the
+    /// reactor and leave the arguments on the stack for the retry.
+    fn poll_hostcall(&mut self, hostcall_num: usize, argc: usize) -> OpPoll {
+        if !matches!(
+            hostcall_num,
+            HOSTCALL_READ | HOSTCALL_ACCEPT | HOSTCALL_CONNECT
+        ) {
+            return OpPoll::Run;
+        }
+        if self.io_wait.as_ref().is_some_and(|wait| !wait.is_ready()) {
+            return OpPoll::Blocked;
+        }
+        let Some(base) = self.stack.len().checked_sub(argc) else {
+            return OpPoll::Run;
+        };
+        let args = self.stack[base..].to_vec();
+        match self.try_hostcall(hostcall_num, &args) {
+            Ok(HostcallPoll::Ready(value)) => {
+                self.io_wait = None;
+                self.stack.truncate(base);
+                self.stack.push(value);
+                OpPoll::Done
+            }
+            Ok(HostcallPoll::Pending(fd, interest)) => {
+                self.io_wait = Some(IoWait::register(fd, interest));
+                OpPoll::Blocked
+            }
+            // `execute_op` reports the error
+            Err(_) => {
+                self.io_wait = None;
+                OpPoll::Run
+            }
+        }
+    }
+
+    /// The descriptor of an open fd.
+    fn descriptor(&self, fd: i64) -> Option<Descriptor> {
+        self.descriptors.lock().unwrap().get(fd)
+    }
 
+    /// Run a hostcall once. Reads, accepts and connects on sockets that are
+    /// not ready return `Pending` without side effects beyond starting a
+    /// connect, and are retried once the fd is ready.
+    fn try_hostcall(
+        &mut self,
+        hostcall_num: usize,
+        args: &[Value],
+    ) -> Result<HostcallPoll, String> {
         // Error codes (negative return values)
         const EBADF: i64 = -1; // Bad file descriptor
         const ENOENT: i64 = -2; // No such file or directory
@@ -3868,6 +6040,20 @@ impl VM {
         const AF_INET: i64 = 2;
         const SOCK_STREAM: i64 = 1;
 
+        let ready = |v: i64| Ok(HostcallPoll::Ready(Value::I64(v)));
+        // Whatever the program does next with I/O (read a reply, close the
+        // fd, ask for the time) happens after the output written so far
+        if hostcall_num != HOSTCALL_WRITE {
+            let _ = self.flush_output();
+        }
+        let connect_error = |e: std::io::Error| match e.kind() {
+            std::io::ErrorKind::ConnectionRefused => ECONNREFUSED,
+            std::io::ErrorKind::TimedOut => ETIMEDOUT,
+            std::io::ErrorKind::NotFound => ENOENT,
+            std::io::ErrorKind::PermissionDenied => EACCES,
+            _ => ECONNREFUSED, // Default to connection refused
+        };
+
         match hostcall_num {
             HOSTCALL_OPEN => {
                 if args.len() != 2 {
@@ -3910,10 +6096,8 @@ impl VM {
                 // Try to open the file
                 match options.open(&path) {
                     Ok(file) => {
-                        let fd = self.next_fd;
-                        self.next_fd += 1;
-                        self.file_descriptors.insert(fd, file);
-                        Ok(Value::I64(fd))
+                        let mut descriptors = self.descriptors.lock().unwrap();
+                        ready(descriptors.insert(Descriptor::File(Arc::new(file))))
                     }
                     Err(e) => {
                         // Map IO errors to our error codes
@@ -3922,7 +6106,7 @@ impl VM {
                             std::io::ErrorKind::PermissionDenied => EACCES,
                             _ => EBADF,
                         };
-                        Ok(Value::I64(error_code))
+                        ready(error_code)
                     }
                 }
             }
@@ -3940,19 +6124,16 @@ impl VM {
 
                 // Cannot close stdin/stdout/stderr
                 if fd <= 2 {
-                    return Ok(Value::I64(EBADF));
+                    return ready(EBADF);
                 }
 
-                // Remove from fd table (File/TcpStream/TcpListener is dropped automatically)
-                let closed = self.file_descriptors.remove(&fd).is_some()
-                    || self.socket_descriptors.remove(&fd).is_some()
-                    || self.pending_sockets.remove(&fd)
-                    || self.listener_descriptors.remove(&fd).is_some();
-
-                if closed {
-                    Ok(Value::I64(0)) // Success
+                // Remove from fd table; the File/TcpStream/TcpListener is
+                // closed once no thread is using it any more
+                if self.descriptors.lock().unwrap().remove(fd).is_some() {
+                    self.pending_writes.closed(fd);
+                    ready(0) // Success
                 } else {
-                    Ok(Value::I64(EBADF)) // Invalid fd
+                    ready(EBADF) // Invalid fd
                 }
             }
             HOSTCALL_WRITE => {
@@ -3981,33 +6162,41 @@ impl VM {
                     .ok_or_else(|| "write: invalid data reference".to_string())?;
                 let actual_count = (count as usize).min(data.slots.len());
 
-                // Get the writer for this fd
-                let writer: &mut dyn std::io::Write = if fd == 1 {
-                    &mut self.output
-                } else if fd == 2 {
-                    &mut self.stderr
-                } else if let Some(file) = self.file_descriptors.get_mut(&fd) {
-                    file
-                } else if let Some(socket) = self.socket_descriptors.get_mut(&fd) {
-                    socket
-                } else {
-                    return Ok(Value::I64(EBADF));
-                };
-
-                // Convert slots to bytes and write
+                // Convert slots to bytes
                 let bytes: Vec<u8> = data
                     .slots
                     .iter()
                     .take(actual_count)
                     .map(|v| v.as_i64().unwrap_or(0) as u8)
                     .collect();
-                let result = if writer.write_all(&bytes).is_err() {
+
+                // stdout and stderr go through their buffers; writes to files
+                // and sockets are queued and sent together, as one vectored
+                // write, before the next other hostcall or channel op. A full
+                // socket send buffer blocks until it drains, also on green
+                // threads.
+                let written = match fd {
+                    1 => self.output.write_all(&bytes),
+                    2 => self.stderr.write_all(&bytes),
+                    _ => {
+                        let target = match self.descriptor(fd) {
+                            Some(Descriptor::File(file)) => WriteTarget::File(file),
+                            Some(Descriptor::Socket(socket)) => WriteTarget::Socket(socket),
+                            _ => return ready(EBADF),
+                        };
+                        let queued = self.pending_writes.push(fd, target, bytes);
+                        if self.output.mode() == BufferMode::Unbuffered {
+                            queued.and_then(|()| self.pending_writes.flush())
+                        } else {
+                            queued
+                        }
+                    }
+                };
+                ready(if written.is_err() {
                     EBADF
                 } else {
-                    actual_count as i64
-                };
-
-                Ok(Value::I64(result))
+                    actual_count as i64
+                })
             }
             HOSTCALL_READ => {
                 if args.len() != 2 {
@@ -4026,23 +6215,27 @@ impl VM {
 
                 // Validate arguments
                 if fd <= 2 || count < 0 {
-                    return Ok(Value::I64(EBADF));
+                    return ready(EBADF);
                 }
 
                 // Read up to count bytes from file or socket
                 let mut buffer = vec![0u8; count as usize];
-                let bytes_read = if let Some(file) = self.file_descriptors.get_mut(&fd) {
-                    match file.read(&mut buffer) {
+                let bytes_read = match self.descriptor(fd) {
+                    Some(Descriptor::File(file)) => match (&*file).read(&mut buffer) {
                         Ok(n) => n,
-                        Err(_) => return Ok(Value::I64(EBADF)),
-                    }
-                } else if let Some(socket) = self.socket_descriptors.get_mut(&fd) {
-                    match socket.read(&mut buffer) {
+                        Err(_) => return ready(EBADF),
+                    },
+                    Some(Descriptor::Socket(socket)) => match (&*socket).read(&mut buffer) {
                         Ok(n) => n,
-                        Err(_) => return Ok(Value::I64(EBADF)),
-                    }
-                } else {
-                    return Ok(Value::I64(EBADF));
+                        Err(e) if e.kind() == io::ErrorKind::WouldBlock => {
+                            return Ok(HostcallPoll::Pending(
+                                vm_io::socket_fd(&socket),
+                                Interest::Read,
+                            ));
+                        }
+                        Err(_) => return ready(EBADF),
+                    },
+                    _ => return ready(EBADF),
                 };
 
                 // Truncate buffer to actual bytes read
@@ -4059,7 +6252,7 @@ impl VM {
 
                 // Allocate string on heap and return reference
                 let heap_ref = self.heap.alloc_string(content)?;
-                Ok(Value::Ref(heap_ref))
+                Ok(HostcallPoll::Ready(Value::Ref(heap_ref)))
             }
             HOSTCALL_SOCKET => {
                 if args.len() != 2 {
@@ -4078,20 +6271,16 @@ impl VM {
 
                 // Only support AF_INET (2)
                 if domain != AF_INET {
-                    return Ok(Value::I64(EAFNOSUPPORT));
+                    return ready(EAFNOSUPPORT);
                 }
 
                 // Only support SOCK_STREAM (1) for TCP
                 if sock_type != SOCK_STREAM {
-                    return Ok(Value::I64(ESOCKTNOSUPPORT));
+                    return ready(ESOCKTNOSUPPORT);
                 }
 
-                // Allocate fd and mark as pending socket
-                let fd = self.next_fd;
-                self.next_fd += 1;
-                self.pending_sockets.insert(fd);
-
-                Ok(Value::I64(fd))
+                // Allocate fd; the OS socket is created by connect or bind
+                ready(self.descriptors.lock().unwrap().insert(Descriptor::Unbound))
             }
             HOSTCALL_CONNECT => {
                 if args.len() != 3 {
@@ -4116,30 +6305,60 @@ impl VM {
                     .as_i64()
                     .ok_or_else(|| "connect: port must be an integer".to_string())?;
 
-                // Check fd is a pending socket
-                if !self.pending_sockets.remove(&fd) {
-                    return Ok(Value::I64(EBADF));
-                }
-
-                // Try to connect
-                let addr = format!("{}:{}", host, port);
-                match TcpStream::connect(&addr) {
-                    Ok(stream) => {
-                        self.socket_descriptors.insert(fd, stream);
-                        Ok(Value::I64(0)) // Success
-                    }
-                    Err(e) => {
-                        // Map IO errors to our error codes
-                        let error_code = match e.kind() {
-                            std::io::ErrorKind::ConnectionRefused => ECONNREFUSED,
-                            std::io::ErrorKind::TimedOut => ETIMEDOUT,
-                            std::io::ErrorKind::NotFound => ENOENT,
-                            std::io::ErrorKind::PermissionDenied => EACCES,
-                            _ => ECONNREFUSED, // Default to connection refused
+                let stream = match self.descriptor(fd) {
+                    // Start a non-blocking connect
+                    Some(Descriptor::Unbound) => {
+                        let addr = match std::net::ToSocketAddrs::to_socket_addrs(&(
+                            host.as_str(),
+                            port as u16,
+                        ))
+                        .map(|mut addrs| {
+                            addrs.find_map(|addr| match addr {
+                                std::net::SocketAddr::V4(addr) => Some(addr),
+                                std::net::SocketAddr::V6(_) => None,
+                            })
+                        }) {
+                            Ok(Some(addr)) => addr,
+                            Ok(None) => return ready(ENOENT),
+                            Err(e) => return ready(connect_error(e)),
+                        };
+                        let (stream, connected) = match vm_io::start_connect(addr) {
+                            Ok(started) => started,
+                            Err(e) => {
+                                self.descriptors.lock().unwrap().remove(fd);
+                                return ready(connect_error(e));
+                            }
                         };
-                        Ok(Value::I64(error_code))
+                        let stream = Arc::new(stream);
+                        if !connected {
+                            let fd_raw = vm_io::socket_fd(&stream);
+                            self.descriptors
+                                .lock()
+                                .unwrap()
+                                .replace(fd, Descriptor::Connecting(stream));
+                            return Ok(HostcallPoll::Pending(fd_raw, Interest::Write));
+                        }
+                        stream
                     }
-                }
+                    // Finish one started earlier once the socket is writable
+                    Some(Descriptor::Connecting(stream)) => {
+                        let fd_raw = vm_io::socket_fd(&stream);
+                        if !vm_io::is_ready(fd_raw, Interest::Write) {
+                            return Ok(HostcallPoll::Pending(fd_raw, Interest::Write));
+                        }
+                        if let Err(e) = vm_io::finish_connect(&stream) {
+                            self.descriptors.lock().unwrap().remove(fd);
+                            return ready(connect_error(e));
+                        }
+                        stream
+                    }
+                    _ => return ready(EBADF),
+                };
+                self.descriptors
+                    .lock()
+                    .unwrap()
+                    .replace(fd, Descriptor::Socket(stream));
+                ready(0) // Success
             }
             HOSTCALL_BIND => {
                 if args.len() != 3 {
@@ -4164,26 +6383,33 @@ impl VM {
                     .as_i64()
                     .ok_or_else(|| "bind: port must be an integer".to_string())?;
 
-                // Check fd is a pending socket
-                if !self.pending_sockets.remove(&fd) {
-                    return Ok(Value::I64(EBADF));
+                // Check fd is an unbound socket
+                if !matches!(self.descriptor(fd), Some(Descriptor::Unbound)) {
+                    return ready(EBADF);
                 }
 
                 // Try to bind (creates TcpListener)
                 let addr = format!("{}:{}", host, port);
-                match TcpListener::bind(&addr) {
+                match TcpListener::bind(&addr).and_then(|listener| {
+                    listener.set_nonblocking(true)?;
+                    Ok(listener)
+                }) {
                     Ok(listener) => {
-                        self.listener_descriptors.insert(fd, listener);
-                        Ok(Value::I64(0)) // Success
+                        self.descriptors
+                            .lock()
+                            .unwrap()
+                            .replace(fd, Descriptor::Listener(Arc::new(listener)));
+                        ready(0) // Success
                     }
                     Err(e) => {
+                        self.descriptors.lock().unwrap().remove(fd);
                         // Map IO errors to our error codes
                         let error_code = match e.kind() {
                             std::io::ErrorKind::AddrInUse => EADDRINUSE,
                             std::io::ErrorKind::PermissionDenied => EACCES,
                             _ => EBADF,
                         };
-                        Ok(Value::I64(error_code))
+                        ready(error_code)
                     }
                 }
             }
@@ -4204,10 +6430,10 @@ impl VM {
                     .ok_or_else(|| "listen: backlog must be an integer".to_string())?;
 
                 // Check fd is a valid listener (already listening after bind in Rust)
-                if self.listener_descriptors.contains_key(&fd) {
-                    Ok(Value::I64(0)) // Success - already listening
+                if matches!(self.descriptor(fd), Some(Descriptor::Listener(_))) {
+                    ready(0) // Success - already listening
                 } else {
-                    Ok(Value::I64(EBADF)) // Not a valid listener
+                    ready(EBADF) // Not a valid listener
                 }
             }
             HOSTCALL_ACCEPT => {
@@ -4223,20 +6449,25 @@ impl VM {
                     .ok_or_else(|| "accept: fd must be an integer".to_string())?;
 
                 // Get the listener
-                let listener = match self.listener_descriptors.get(&fd) {
-                    Some(l) => l,
-                    None => return Ok(Value::I64(EBADF)),
+                let Some(Descriptor::Listener(listener)) = self.descriptor(fd) else {
+                    return ready(EBADF);
                 };
 
                 // Accept a connection
                 match listener.accept() {
                     Ok((stream, _addr)) => {
-                        let client_fd = self.next_fd;
-                        self.next_fd += 1;
-                        self.socket_descriptors.insert(client_fd, stream);
-                        Ok(Value::I64(client_fd))
+                        // Accepted sockets do not inherit non-blocking mode everywhere
+                        if stream.set_nonblocking(true).is_err() {
+                            return ready(EBADF);
+                        }
+                        let mut descriptors = self.descriptors.lock().unwrap();
+                        ready(descriptors.insert(Descriptor::Socket(Arc::new(stream))))
                     }
-                    Err(_) => Ok(Value::I64(EBADF)),
+                    Err(e) if e.kind() == io::ErrorKind::WouldBlock => {
+                        let raw = Descriptor::Listener(listener).raw_fd().unwrap_or(-1);
+                        Ok(HostcallPoll::Pending(raw, Interest::Read))
+                    }
+                    Err(_) => ready(EBADF),
                 }
             }
             HOSTCALL_TIME => {
@@ -4250,7 +6481,7 @@ impl VM {
                 let duration = std::time::SystemTime::now()
                     .duration_since(std::time::UNIX_EPOCH)
                     .map_err(|e| format!("time hostcall failed: {}", e))?;
-                Ok(Value::I64(duration.as_secs() as i64))
+                ready(duration.as_secs() as i64)
             }
             HOSTCALL_TIME_NANOS => {
                 if !args.is_empty() {
@@ -4263,7 +6494,7 @@ impl VM {
                 let duration = std::time::SystemTime::now()
                     .duration_since(std::time::UNIX_EPOCH)
                     .map_err(|e| format!("time_nanos hostcall failed: {}", e))?;
-                Ok(Value::I64(duration.as_nanos() as i64))
+                ready(duration.as_nanos() as i64)
             }
             _ => Err(format!("unknown hostcall: {}", hostcall_num)),
         }
@@ -4302,7 +6533,7 @@ unsafe extern "C" fn jit_call_helper(
 
     // Check if we should JIT compile this function (increments call count)
     if vm.should_jit_compile(func_index, &func.name) {
-        vm.jit_compile_function(func, func_index, &chunk.functions);
+        vm.jit_compile_function(func_index, chunk);
     }
 
     // FAST PATH: If target function is JIT compiled, call directly with stack allocation
@@ -4331,6 +6562,7 @@ unsafe extern "C" fn jit_call_helper(
                 );
             }
 
+            vm.jit_gc_safepoint(Some(result.to_value()));
             ctx_ref.heap_base = vm.heap.memory_base_ptr();
             return result;
         }
@@ -4358,6 +6590,7 @@ unsafe extern "C" fn jit_call_helper(
                 );
             }
 
+            vm.jit_gc_safepoint(Some(result.to_value()));
             ctx_ref.heap_base = vm.heap.memory_base_ptr();
             return result;
         }
@@ -4376,6 +6609,7 @@ unsafe extern "C" fn jit_call_helper(
         let starting_frame_depth = vm.frames.len();
 
         let new_stack_base = vm.stack.len() - argc;
+        vm.reserve_locals(new_stack_base, func.locals_count);
         vm.frames.push(Frame {
             func_index,
             pc: 0,
@@ -4387,6 +6621,7 @@ unsafe extern "C" fn jit_call_helper(
         // Run until the function returns (when frame depth returns to starting level)
         #[allow(clippy::while_let_loop)]
         loop {
+            vm.jit_gc_safepoint(None);
             let frame = match vm.frames.last_mut() {
                 Some(f) => f,
                 None => break,
@@ -4399,7 +6634,12 @@ unsafe extern "C" fn jit_call_helper(
             };
 
             if frame.pc >= current_func.code.len() {
-                // End of function
+                // End of function; a corrupt body fails like any other error
+                if VM::check_body(current_func).is_err() {
+                    vm.frames.truncate(starting_frame_depth);
+                    vm.stack.truncate(new_stack_base);
+                    return JitReturn { tag: 3, payload: 0 }; // TAG_NIL on error
+                }
                 break;
             }
 
@@ -4417,13 +6657,21 @@ unsafe extern "C" fn jit_call_helper(
                 }
                 Ok(ControlFlow::Exit) => break,
                 Err(_) => {
+                    // Unwind what this call pushed so the caller's state stays intact
+                    vm.frames.truncate(starting_frame_depth);
+                    vm.stack.truncate(new_stack_base);
                     return JitReturn { tag: 3, payload: 0 }; // TAG_NIL on error
                 }
             }
         }
 
+        // Marking may have started in the interpreter; the JIT caller must not
+        // run with it in progress
+        vm.gc_before_jit();
+
         // Get return value from stack
         let result = vm.stack.pop().unwrap_or(Value::Null);
+        vm.jit_gc_safepoint(Some(result));
         let jit_result = JitValue::from_value(&result);
         // Update heap_base in case the called function grew the heap
         ctx_ref.heap_base = vm.heap.memory_base_ptr();
@@ -4451,7 +6699,7 @@ unsafe extern "C" fn jit_push_string_helper(
     let idx = string_index as usize;
 
     // Use get_or_alloc_string which handles caching
-    match vm.get_or_alloc_string(idx, chunk) {
+    let result = match vm.get_or_alloc_string(idx, chunk) {
         Ok(r) => JitReturn {
             tag: 4, // TAG_PTR
             payload: r.index as u64,
@@ -4460,7 +6708,10 @@ unsafe extern "C" fn jit_push_string_helper(
             tag: 3, // TAG_NIL
             payload: 0,
         },
-    }
+    };
+    vm.jit_gc_safepoint(None); // the string is cached, and so rooted
+    ctx_ref.heap_base = vm.heap.memory_base_ptr();
+    result
 }
 
 /// JIT array/string length helper function.
@@ -4514,18 +6765,15 @@ unsafe extern "C" fn jit_hostcall_helper(
     }
 
     // Call the hostcall handler
-    match vm.handle_hostcall(hostcall_num as usize, &vm_args) {
-        Ok(result) => {
-            let jit_result = JitValue::from_value(&result);
-            JitReturn {
-                tag: jit_result.tag,
-                payload: jit_result.payload,
-            }
-        }
-        Err(_) => JitReturn {
-            tag: 3, // TAG_NIL
-            payload: 0,
-        },
+    let result = vm
+        .handle_hostcall(hostcall_num as usize, &vm_args)
+        .unwrap_or(Value::Null);
+    vm.jit_gc_safepoint(Some(result));
+    ctx_ref.heap_base = vm.heap.memory_base_ptr();
+    let jit_result = JitValue::from_value(&result);
+    JitReturn {
+        tag: jit_result.tag,
+        payload: jit_result.payload,
     }
 }
 
@@ -4552,12 +6800,110 @@ unsafe extern "C" fn jit_heap_alloc_dyn_simple_helper(
         let slots = vec![Value::Null; size];
         vm.heap.alloc_slots(slots)
     };
-    match result {
-        Ok(r) => {
-            ctx_ref.heap_base = vm.heap.memory_base_ptr();
+    let result = match result {
+        Ok(r) => Value::Ref(r),
+        Err(_) => Value::Null,
+    };
+    vm.jit_gc_safepoint(Some(result));
+    ctx_ref.heap_base = vm.heap.memory_base_ptr();
+    let jit_result = JitValue::from_value(&result);
+    JitReturn {
+        tag: jit_result.tag,
+        payload: jit_result.payload,
+    }
+}
+
+/// JIT HeapBulk helper function.
+/// Runs the bulk op `op_raw` on `argc` JitValue operands. Returns the op's
+/// result, or nil (also on error).
+#[cfg(feature = "jit")]
+unsafe extern "C" fn jit_heap_bulk_helper(
+    ctx: *mut JitCallContext,
+    op_raw: u64,
+    argc: u64,
+    args: *const JitValue,
+) -> JitReturn {
+    let ctx_ref = unsafe { &mut *ctx };
+    let vm = unsafe { &mut *(ctx_ref.vm as *mut VM) };
+
+    vm.record_opcode("HeapBulk");
+
+    let nil = JitReturn {
+        tag: 3, // TAG_NIL
+        payload: 0,
+    };
+    let Some(op) = BulkOp::from_raw(op_raw as u8) else {
+        return nil;
+    };
+    let vm_args: Vec<Value> = (0..argc as usize)
+        .map(|i| unsafe { *args.add(i) }.to_value())
+        .collect();
+    let result = match vm.heap_bulk(op, &vm_args) {
+        Ok(Some(result)) => result,
+        _ => return nil,
+    };
+    vm.jit_gc_safepoint(Some(result));
+    ctx_ref.heap_base = vm.heap.memory_base_ptr();
+    let jit_result = JitValue::from_value(&result);
+    JitReturn {
+        tag: jit_result.tag,
+        payload: jit_result.payload,
+    }
+}
+
+/// JIT GlobalGet helper function.
+/// Returns `globals[index]` (nil for an invalid index).
+#[cfg(feature = "jit")]
+unsafe extern "C" fn jit_global_get_helper(ctx: *mut JitCallContext, index: u64) -> JitReturn {
+    let ctx_ref = unsafe { &mut *ctx };
+    let vm = unsafe { &mut *(ctx_ref.vm as *mut VM) };
+
+    vm.record_opcode("GlobalGet");
+
+    let value = vm
+        .globals
+        .get(index as usize)
+        .copied()
+        .unwrap_or(Value::Null);
+    let jit_value = JitValue::from_value(&value);
+    JitReturn {
+        tag: jit_value.tag,
+        payload: jit_value.payload,
+    }
+}
+
+/// JIT VtableLookup helper function.
+/// Looks up the vtable through the inline cache of the site packed in
+/// `site_key` (`func_index << 32 | site`). Returns the vtable Ref, or nil.
+#[cfg(feature = "jit")]
+unsafe extern "C" fn jit_vtable_lookup_helper(
+    ctx: *mut JitCallContext,
+    site_key: u64,
+    type_info: u64,
+    iface_desc: u64,
+) -> JitReturn {
+    let ctx_ref = unsafe { &mut *ctx };
+    let vm = unsafe { &mut *(ctx_ref.vm as *mut VM) };
+
+    vm.record_opcode("VtableLookup");
+
+    let func_index = match site_key >> 32 {
+        0xFFFF_FFFF => usize::MAX,
+        index => index as usize,
+    };
+    let site = (site_key & 0xFFFF_FFFF) as usize;
+    let ti_ref = GcRef {
+        index: type_info as usize,
+    };
+    let iface_ref = GcRef {
+        index: iface_desc as usize,
+    };
+    match vm.cached_vtable_lookup(func_index, Some(site), ti_ref, iface_ref) {
+        Ok(value) => {
+            let jit_value = JitValue::from_value(&value);
             JitReturn {
-                tag: 4, // TAG_PTR
-                payload: r.index as u64,
+                tag: jit_value.tag,
+                payload: jit_value.payload,
             }
         }
         Err(_) => JitReturn {
@@ -4590,11 +6936,11 @@ mod tests {
                 name: "__main__".to_string(),
                 arity: 0,
                 locals_count: 0,
-                code: ops,
+                code: ops.into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec![],
+            strings: vec![].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -4614,11 +6960,11 @@ mod tests {
                 name: "__main__".to_string(),
                 arity: 0,
                 locals_count: 0,
-                code: ops,
+                code: ops.into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings,
+            strings: strings.into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -4755,6 +7101,631 @@ mod tests {
         assert!(stack.iter().any(|v| *v == Value::I64(2)));
     }
 
+    /// head -> middle -> tail, with the middle node replaced on every
+    /// iteration while garbage is allocated, so stores into old objects
+    /// happen mid-collection and the tail is only reachable through newer
+    /// nodes. Each iteration also allocates an array of `garbage_slots`.
+    /// Leaves head.next.value (19999) and the tail value (3) on the stack.
+    fn linked_list_churn_chunk(garbage_slots: i64) -> Chunk {
+        let code = vec![
+            Op::I64Const(3),
+            Op::I64Const(0),
+            Op::HeapAlloc(2), // tail [3, 0]
+            Op::LocalSet(2),
+            Op::I64Const(2),
+            Op::LocalGet(2),
+            Op::HeapAlloc(2), // middle [2, tail]
+            Op::LocalSet(2),
+            Op::I64Const(1),
+            Op::LocalGet(2),
+            Op::HeapAlloc(2), // head [1, middle]
+            Op::LocalSet(0),
+            Op::I64Const(0),
+            Op::LocalSet(2),
+            Op::I64Const(0),
+            Op::LocalSet(1),
+            // loop: while i < 20000
+            Op::LocalGet(1),
+            Op::I64Const(20000),
+            Op::I64LtS,
+            Op::BrIfFalse(35),
+            Op::I64Const(garbage_slots),
+            Op::HeapAllocDynSimple(ElemKind::Tagged), // garbage
+            Op::Drop,
+            // head.next = [i, head.next.next]
+            Op::LocalGet(0),
+            Op::LocalGet(1),
+            Op::LocalGet(0),
+            Op::HeapLoad(1),
+            Op::HeapLoad(1),
+            Op::HeapAlloc(2),
+            Op::HeapStore(1),
+            Op::LocalGet(1),
+            Op::I64Const(1),
+            Op::I64Add,
+            Op::LocalSet(1),
+            Op::Jmp(16),
+            // head.next.value, head.next.next.value
+            Op::LocalGet(0),
+            Op::HeapLoad(1),
+            Op::HeapLoad(0),
+            Op::LocalGet(0),
+            Op::HeapLoad(1),
+            Op::HeapLoad(1),
+            Op::HeapLoad(0),
+        ];
+        Chunk {
+            functions: vec![],
+            main: Function {
+                name: "__main__".to_string(),
+                arity: 0,
+                locals_count: 3,
+                code: code.into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec![].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        }
+    }
+
+    #[test]
+    fn test_incremental_gc_keeps_live_objects() {
+        // Large garbage is allocated old and drives full cycles
+        let chunk = linked_list_churn_chunk(1000);
+        let mut vm = VM::new();
+        vm.set_use_microop(false);
+        vm.set_jit_config(false, 0, false);
+        vm.set_incremental_gc(true);
+        vm.run(&chunk).unwrap();
+        assert_eq!(
+            vm.stack[vm.stack.len() - 2..],
+            [Value::I64(19999), Value::I64(3)]
+        );
+
+        let stats = vm.gc_stats();
+        assert!(stats.cycles > 0);
+        // Each cycle is split into several pauses
+        assert!(stats.pauses.count() > 2 * stats.cycles as u64);
+        assert!(vm.incremental_gc_stats().objects_swept > 0);
+    }
+
+    #[test]
+    fn test_soft_limit_collects_before_hard_limit() {
+        // 16KB of old garbage per iteration under a 512KB cap, below the
+        // default 1MB GC threshold: only the soft limit makes this fit
+        let chunk = linked_list_churn_chunk(1000);
+        let mut vm = VM::new_with_heap_config(Some(512 * 1024), true);
+        vm.set_use_microop(false);
+        vm.set_jit_config(false, 0, false);
+        assert_eq!(vm.heap().soft_limit(), Some(384 * 1024));
+        vm.run(&chunk).unwrap();
+        assert!(vm.gc_stats().cycles > 0);
+        assert!(vm.heap().bytes_allocated() <= 512 * 1024);
+
+        // A tighter explicit soft limit collects more often
+        let mut tight = VM::new_with_heap_config(Some(512 * 1024), true);
+        tight.set_use_microop(false);
+        tight.set_jit_config(false, 0, false);
+        tight.heap_mut().set_soft_limit(Some(128 * 1024));
+        tight.run(&chunk).unwrap();
+        assert!(tight.gc_stats().cycles > vm.gc_stats().cycles);
+    }
+
+    #[test]
+    fn test_minor_gc_keeps_live_objects() {
+        let chunk = linked_list_churn_chunk(100);
+        let mut vm = VM::new();
+        vm.set_use_microop(false);
+        // JIT code allocates old
+        vm.set_jit_config(false, 0, false);
+        vm.run(&chunk).unwrap();
+        assert_eq!(
+            vm.stack[vm.stack.len() - 2..],
+            [Value::I64(19999), Value::I64(3)]
+        );
+        // Everything but the list dies young
+        let stats = vm.gc_stats();
+        assert!(stats.minor_cycles > 0);
+        assert_eq!(stats.cycles, 0);
+    }
+
+    #[test]
+    fn test_metrics_and_events() {
+        use std::sync::{Arc, Mutex};
+
+        let chunk = linked_list_churn_chunk(100);
+        let mut vm = VM::new();
+        vm.set_use_microop(false);
+        vm.set_jit_config(false, 0, false);
+        let events = Arc::new(Mutex::new(Vec::new()));
+        let seen = events.clone();
+        vm.set_event_handler(Some(Box::new(move |event: &VmEvent| {
+            let mut seen = seen.lock().unwrap();
+            match *event {
+                VmEvent::GcStart { minor } => seen.push(("start", minor)),
+                VmEvent::GcEnd { minor, .. } => seen.push(("end", minor)),
+                _ => {}
+            }
+        })));
+        vm.run(&chunk).unwrap();
+
+        let metrics = vm.metrics();
+        assert!(metrics.gc_minor_cycles > 0);
+        assert_eq!(metrics.gc_pauses, vm.gc_stats().pauses.count());
+        assert!(metrics.allocated_objects > 20000);
+        assert!(metrics.allocated_bytes as usize > metrics.heap_live_bytes);
+        assert!(metrics.heap_bytes >= metrics.heap_live_bytes);
+        assert_eq!(metrics.jit_compiles, 0);
+
+        // Every pause is bracketed by a start and an end
+        let events = events.lock().unwrap();
+        assert_eq!(events.len() as u64, 2 * metrics.gc_pauses);
+        for pair in events.chunks(2) {
+            assert_eq!((pair[0].0, pair[1].0), ("start", "end"));
+            assert_eq!(pair[0].1, pair[1].1);
+        }
+    }
+
+    /// `spin(x)` counts to 50 in a loop that leaves its argument alone;
+    /// main calls it with a string three times, then with an int three times.
+    fn osr_chunk() -> Chunk {
+        let spin = vec![
+            Op::I64Const(0),
+            Op::LocalSet(1),
+            // loop: while i < 50
+            Op::LocalGet(1),
+            Op::I64Const(50),
+            Op::I64LtS,
+            Op::BrIfFalse(11),
+            Op::LocalGet(1),
+            Op::I64Const(1),
+            Op::I64Add,
+            Op::LocalSet(1),
+            Op::Jmp(2),
+            Op::LocalGet(1),
+            Op::Ret,
+        ];
+        let mut main = Vec::new();
+        for _ in 0..3 {
+            main.extend([Op::StringConst(0), Op::Call(0, 1)]);
+        }
+        for _ in 0..3 {
+            main.extend([Op::I64Const(7), Op::Call(0, 1)]);
+        }
+        Chunk {
+            functions: vec![Function {
+                name: "spin".to_string(),
+                arity: 1,
+                locals_count: 2,
+                code: spin.into(),
+                stackmap: None,
+                // x has no static type, so it is taken to be an int
+                local_types: vec![],
+            }],
+            main: Function {
+                name: "__main__".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: main.into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec!["s".to_string()].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        }
+    }
+
+    #[test]
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn test_osr_speculation_and_deopt() {
+        use std::sync::{Arc, Mutex};
+
+        for use_microop in [false, true] {
+            let chunk = osr_chunk();
+            let mut vm = VM::new();
+            vm.set_use_microop(use_microop);
+            vm.set_jit_config(true, 1000, false);
+            vm.set_tier_policy(TierPolicy {
+                call_threshold: 1_000_000,
+                osr_threshold: 10,
+            });
+            let tiers = Arc::new(Mutex::new(Vec::new()));
+            let seen = tiers.clone();
+            vm.set_event_handler(Some(Box::new(move |event: &VmEvent| {
+                if let VmEvent::TierChange { tier, is_loop, .. } = *event {
+                    assert!(is_loop);
+                    seen.lock().unwrap().push(tier);
+                }
+            })));
+            vm.run(&chunk).unwrap();
+
+            // Every call counted to 50, in whichever tier
+            assert_eq!(vm.stack[vm.stack.len() - 6..], [Value::I64(50); 6]);
+            // The string calls ran code specialized for a Ref argument; the
+            // first int call failed its guard until the code was dropped, and
+            // the loop was recompiled without speculation
+            assert_eq!(
+                *tiers.lock().unwrap(),
+                [Tier::Optimized, Tier::Interpreter, Tier::Baseline]
+            );
+            let metrics = vm.metrics();
+            assert_eq!(metrics.jit_deopts, tiering::MAX_DEOPTS as u64);
+            assert_eq!(metrics.jit_compiles, 2);
+        }
+    }
+
+    #[test]
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn test_background_jit() {
+        // total = inc(0) + inc(1) + ... + inc(19)
+        let mut main = vec![Op::I64Const(0), Op::LocalSet(0)];
+        for i in 0..20 {
+            main.extend([
+                Op::LocalGet(0),
+                Op::I64Const(i),
+                Op::Call(0, 1),
+                Op::I64Add,
+                Op::LocalSet(0),
+            ]);
+        }
+        let chunk = Chunk {
+            functions: vec![Function {
+                name: "inc".to_string(),
+                arity: 1,
+                locals_count: 1,
+                code: vec![Op::LocalGet(0), Op::I64Const(1), Op::I64Add, Op::Ret].into(),
+                stackmap: None,
+                local_types: vec![ValueType::I64],
+            }],
+            main: Function {
+                name: "__main__".to_string(),
+                arity: 0,
+                locals_count: 1,
+                code: main.into(),
+                stackmap: None,
+                local_types: vec![ValueType::I64],
+            },
+            strings: vec![].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        };
+
+        for use_microop in [false, true] {
+            let mut vm = VM::new();
+            vm.set_use_microop(use_microop);
+            vm.set_jit_config(true, 5, false);
+            vm.set_background_jit(Some(4));
+            vm.run(&chunk).unwrap();
+            // Whether the calls after the fifth ran interpreted or native
+            // depends on the compile thread; the results do not
+            assert_eq!(vm.stack[0], Value::I64(210));
+
+            vm.finish_background_jit();
+            assert!(vm.is_jit_compiled(0));
+            assert_eq!(vm.metrics().jit_compiles, 1);
+            assert_eq!(vm.compile_queue.as_ref().unwrap().pending(), 0);
+        }
+    }
+
+    #[test]
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn test_gc_inside_jit_code() {
+        // build(n): list = null; for i in 0..n { drop 16KB of garbage;
+        // list = [i, list] }; the list lives only in JIT frames
+        let build = vec![
+            Op::RefNull,
+            Op::LocalSet(1),
+            Op::I64Const(0),
+            Op::LocalSet(2),
+            // loop: while i < n
+            Op::LocalGet(2),
+            Op::LocalGet(0),
+            Op::I64LtS,
+            Op::BrIfFalse(20),
+            Op::I64Const(1000),
+            Op::HeapAllocDynSimple(ElemKind::Tagged), // garbage
+            Op::Drop,
+            Op::LocalGet(2),
+            Op::LocalGet(1),
+            Op::HeapAlloc(2),
+            Op::LocalSet(1),
+            Op::LocalGet(2),
+            Op::I64Const(1),
+            Op::I64Add,
+            Op::LocalSet(2),
+            Op::Jmp(4),
+            Op::LocalGet(1),
+            Op::Ret,
+        ];
+        // sum(list): total of the values in list
+        let sum = vec![
+            Op::I64Const(0),
+            Op::LocalSet(1),
+            // loop: while list != null
+            Op::LocalGet(0),
+            Op::RefIsNull,
+            Op::BrIf(14),
+            Op::LocalGet(1),
+            Op::LocalGet(0),
+            Op::HeapLoad(0),
+            Op::I64Add,
+            Op::LocalSet(1),
+            Op::LocalGet(0),
+            Op::HeapLoad(1),
+            Op::LocalSet(0),
+            Op::Jmp(2),
+            Op::LocalGet(1),
+            Op::Ret,
+        ];
+        let mut main = Vec::new();
+        for _ in 0..3 {
+            main.extend([Op::I64Const(2000), Op::Call(0, 1), Op::Call(1, 1)]);
+        }
+        let function = |name: &str, arity, code: Vec<Op>, local_types: Vec<ValueType>| Function {
+            name: name.to_string(),
+            arity,
+            locals_count: local_types.len(),
+            code: code.into(),
+            stackmap: None,
+            local_types,
+        };
+        let chunk = Chunk {
+            functions: vec![
+                function(
+                    "build",
+                    1,
+                    build,
+                    vec![ValueType::I64, ValueType::Ref, ValueType::I64],
+                ),
+                function("sum", 1, sum, vec![ValueType::Ref, ValueType::I64]),
+            ],
+            main: function("__main__", 0, main, vec![]),
+            strings: vec![].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        };
+
+        for use_microop in [false, true] {
+            // 32MB of garbage under a 512KB cap: the heap only fits if the
+            // GC runs while build is in compiled code
+            let mut vm = VM::new_with_heap_config(Some(512 * 1024), true);
+            vm.set_use_microop(use_microop);
+            vm.set_jit_config(true, 1, false);
+            vm.run(&chunk).unwrap();
+            assert!(vm.is_jit_compiled(0));
+            assert_eq!(vm.stack[vm.stack.len() - 3..], [Value::I64(1999000); 3]);
+            assert!(vm.gc_stats().cycles > 0);
+        }
+    }
+
+    fn thread_chunk() -> Chunk {
+        let function = |name: &str, code: Vec<Op>| Function {
+            name: name.to_string(),
+            arity: 0,
+            locals_count: 0,
+            code: code.into(),
+            stackmap: None,
+            local_types: vec![],
+        };
+        Chunk {
+            functions: vec![function(
+                "worker",
+                vec![Op::I64Const(40), Op::I64Const(2), Op::I64Add, Op::Ret],
+            )],
+            main: function("__main__", vec![Op::ThreadSpawn(0), Op::ThreadJoin]),
+            strings: vec![].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        }
+    }
+
+    #[test]
+    fn test_thread_spawn_shares_chunk() {
+        let chunk = Arc::new(thread_chunk());
+        let mut vm = VM::new();
+        vm.set_use_microop(false);
+        vm.share_chunk(chunk.clone());
+        vm.run(&chunk).unwrap();
+        assert_eq!(vm.stack, vec![Value::I64(42)]);
+
+        let image = vm.thread_image(&chunk);
+        assert!(Arc::ptr_eq(&image.chunk, &chunk));
+        let mut thread = GreenThread::new(image, 0);
+        assert_eq!(thread.resume(), TaskStatus::Done(Value::I64(42)));
+
+        // A chunk not given as an Arc is copied once, on the first spawn
+        let plain = thread_chunk();
+        let mut vm = VM::new();
+        vm.prepare(&plain).unwrap();
+        let first = vm.thread_image(&plain).chunk;
+        assert!(Arc::ptr_eq(&first, &vm.thread_image(&plain).chunk));
+        vm.prepare(&plain).unwrap();
+        assert!(!Arc::ptr_eq(&first, &vm.thread_image(&plain).chunk));
+    }
+
+    /// A VM that has prepared `chunk`, with the JIT off so loops stay on the
+    /// interpreter.
+    fn green_parent(chunk: &Arc<Chunk>) -> VM {
+        let mut vm = VM::new();
+        vm.set_jit_config(false, 1000, false);
+        vm.share_chunk(chunk.clone());
+        vm.prepare(chunk).unwrap();
+        vm
+    }
+
+    #[test]
+    fn test_green_thread_yields_at_back_edges() {
+        let mut chunk = thread_chunk();
+        // while i < 25000 { i = i + 1 } return i
+        chunk.functions[0].locals_count = 1;
+        chunk.functions[0].code = vec![
+            Op::I64Const(0),
+            Op::LocalSet(0),
+            Op::LocalGet(0),
+            Op::I64Const(25_000),
+            Op::I64LtS,
+            Op::BrIfFalse(11),
+            Op::LocalGet(0),
+            Op::I64Const(1),
+            Op::I64Add,
+            Op::LocalSet(0),
+            Op::Jmp(2),
+            Op::LocalGet(0),
+            Op::Ret,
+        ]
+        .into();
+        let chunk = Arc::new(chunk);
+        let mut vm = green_parent(&chunk);
+
+        let mut thread = GreenThread::new(vm.thread_image(&chunk), 0);
+        let mut slices = 1;
+        let status = loop {
+            match thread.resume() {
+                TaskStatus::Yielded => slices += 1,
+                status => break status,
+            }
+        };
+        assert_eq!(status, TaskStatus::Done(Value::I64(25_000)));
+        assert_eq!(slices, 25_000 / GREEN_SLICE_BACK_EDGES as usize + 1);
+    }
+
+    #[test]
+    fn test_green_thread_recv_blocks_without_blocking_worker() {
+        let mut chunk = thread_chunk();
+        chunk.functions[0].code = vec![Op::I64Const(0), Op::ChannelRecv, Op::Ret].into();
+        let chunk = Arc::new(chunk);
+        let mut vm = green_parent(&chunk);
+        let channel = Channel::new();
+        vm.channels.push(channel.clone());
+
+        let mut thread = GreenThread::new(vm.thread_image(&chunk), 0);
+        assert_eq!(thread.resume(), TaskStatus::Blocked);
+        assert_eq!(thread.resume(), TaskStatus::Blocked);
+        channel.send(Value::I64(7)).unwrap();
+        assert_eq!(thread.resume(), TaskStatus::Done(Value::I64(7)));
+    }
+
+    #[test]
+    fn test_green_thread_send_many_resumes_partial_batch() {
+        let mut chunk = thread_chunk();
+        // send_many(channel 0, [1..=6]); then receive 2 values back into a
+        // 3-slot buffer and return how many arrived
+        let mut code = vec![Op::I64Const(0)];
+        code.extend((1..=6).map(Op::I64Const));
+        code.extend([
+            Op::HeapAlloc(6),
+            Op::I64Const(6),
+            Op::ChannelSendMany,
+            Op::I64Const(1),
+            Op::I64Const(0),
+            Op::I64Const(0),
+            Op::I64Const(0),
+            Op::HeapAlloc(3),
+            Op::I64Const(3),
+            Op::ChannelRecvMany,
+            Op::Ret,
+        ]);
+        chunk.functions[0].code = code.into();
+        let chunk = Arc::new(chunk);
+        let mut vm = green_parent(&chunk);
+        let outgoing = Channel::bounded(4);
+        let incoming = Channel::bounded(4);
+        vm.channels.push(outgoing.clone());
+        vm.channels.push(incoming.clone());
+
+        let mut thread = GreenThread::new(vm.thread_image(&chunk), 0);
+        assert_eq!(thread.resume(), TaskStatus::Blocked);
+        let mut received = Vec::new();
+        assert_eq!(outgoing.try_recv_many(10, &mut received), 4);
+        // The rest of the batch goes out, then the receive blocks
+        assert_eq!(thread.resume(), TaskStatus::Blocked);
+        assert_eq!(outgoing.try_recv_many(10, &mut received), 2);
+        let expected: Vec<_> = (1..=6).map(Value::I64).collect();
+        assert_eq!(received, expected);
+
+        incoming.send_many([Value::I64(8), Value::I64(9)]).unwrap();
+        assert_eq!(thread.resume(), TaskStatus::Done(Value::I64(2)));
+    }
+
+    #[test]
+    fn test_green_thread_read_suspends_until_socket_ready() {
+        let listener = TcpListener::bind("127.0.0.1:0").unwrap();
+        let client = std::net::TcpStream::connect(listener.local_addr().unwrap()).unwrap();
+        let (mut server, _) = listener.accept().unwrap();
+        client.set_nonblocking(true).unwrap();
+
+        let mut chunk = thread_chunk();
+        // read(3, 16) on the first fd the VM hands out
+        chunk.functions[0].code = vec![
+            Op::I64Const(3),
+            Op::I64Const(16),
+            Op::Hostcall(HOSTCALL_READ, 2),
+            Op::Ret,
+        ]
+        .into();
+        let chunk = Arc::new(chunk);
+        let mut vm = green_parent(&chunk);
+        let fd = vm
+            .descriptors
+            .lock()
+            .unwrap()
+            .insert(Descriptor::Socket(Arc::new(client)));
+        assert_eq!(fd, 3);
+
+        // The spawned thread shares the fd and yields instead of blocking
+        let mut thread = GreenThread::new(vm.thread_image(&chunk), 0);
+        assert_eq!(thread.resume(), TaskStatus::Blocked);
+        assert_eq!(thread.resume(), TaskStatus::Blocked);
+
+        server.write_all(b"hello").unwrap();
+        let deadline = std::time::Instant::now() + std::time::Duration::from_secs(5);
+        loop {
+            match thread.resume() {
+                TaskStatus::Done(value) => {
+                    assert!(matches!(value, Value::Ref(_)));
+                    break;
+                }
+                _ => assert!(std::time::Instant::now() < deadline, "read never resumed"),
+            }
+        }
+    }
+
+    #[test]
+    #[cfg(all(any(target_arch = "aarch64", target_arch = "x86_64"), feature = "jit"))]
+    fn test_thread_image_jit_table_copy_on_write() {
+        let chunk = thread_chunk();
+        let mut vm = VM::new();
+        vm.prepare(&chunk).unwrap();
+        let image = vm.thread_image(&chunk);
+        assert!(Arc::ptr_eq(
+            &image.jit_function_table,
+            &vm.jit_function_table
+        ));
+
+        // Compiling after a spawn leaves the spawned thread's table untouched
+        vm.update_jit_function_table(0, 0x1000, 4);
+        assert!(!Arc::ptr_eq(
+            &image.jit_function_table,
+            &vm.jit_function_table
+        ));
+        assert_eq!(vm.retired_jit_tables.len(), 1);
+        assert_eq!(unsafe { *image.jit_function_table.base_ptr() }, 0);
+        assert_eq!(unsafe { *vm.jit_function_table.base_ptr() }, 0x1000);
+
+        // Unshared tables are updated in place
+        drop(image);
+        vm.update_jit_function_table(0, 0x2000, 4);
+        assert_eq!(vm.retired_jit_tables.len(), 1);
+    }
+
     #[test]
     fn test_hostcall_write_invalid_fd() {
         // Test writing to invalid fd returns EBADF (-1)
@@ -4831,11 +7802,12 @@ mod tests {
                     // close(fd)
                     Op::LocalGet(0),    // fd
                     Op::Hostcall(3, 1), // hostcall_close
-                ],
+                ]
+                .into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec![path_str.clone(), "hello".to_string()],
+            strings: vec![path_str.clone(), "hello".to_string()].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -4855,6 +7827,58 @@ mod tests {
         let _ = std::fs::remove_file(&temp_path);
     }
 
+    #[test]
+    fn test_stdout_writes_are_buffered_until_run_returns() {
+        /// Records each write it receives.
+        #[derive(Clone, Default)]
+        struct Recorder(Arc<Mutex<Vec<Vec<u8>>>>);
+        impl Write for Recorder {
+            fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+                self.0.lock().unwrap().push(buf.to_vec());
+                Ok(buf.len())
+            }
+            fn flush(&mut self) -> io::Result<()> {
+                Ok(())
+            }
+        }
+
+        let write = |s: usize| {
+            [
+                Op::I64Const(1),
+                Op::StringConst(s),
+                Op::HeapLoad(0),
+                Op::I64Const(3),
+                Op::Hostcall(HOSTCALL_WRITE, 3),
+                Op::Drop,
+            ]
+        };
+        let chunk = Chunk {
+            functions: vec![],
+            main: Function {
+                name: "__main__".to_string(),
+                arity: 0,
+                locals_count: 0,
+                code: [write(0), write(1)].concat().into(),
+                stackmap: None,
+                local_types: vec![],
+            },
+            strings: vec!["ab\n".to_string(), "cd\n".to_string()].into(),
+            type_descriptors: vec![],
+            interface_descriptors: vec![],
+            debug: None,
+        };
+
+        for (mode, writes) in [(BufferMode::Block, 1), (BufferMode::Line, 2)] {
+            let recorder = Recorder::default();
+            let mut vm = VM::with_output(Box::new(recorder.clone()));
+            vm.set_output_buffering(mode).unwrap();
+            vm.run(&chunk).unwrap();
+            let received = recorder.0.lock().unwrap();
+            assert_eq!(received.len(), writes, "{:?}", mode);
+            assert_eq!(received.concat(), b"ab\ncd\n");
+        }
+    }
+
     #[test]
     fn test_hostcall_read_invalid_fd() {
         // Test reading from invalid fd returns EBADF (-1)
@@ -4920,11 +7944,12 @@ mod tests {
                     Op::Drop,           // discard close result
                     // return content
                     Op::LocalGet(1), // push content ref
-                ],
+                ]
+                .into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec![path_str.clone()],
+            strings: vec![path_str.clone()].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -4995,11 +8020,12 @@ mod tests {
                     Op::Drop,           // discard close result
                     // return content
                     Op::LocalGet(1), // push content ref
-                ],
+                ]
+                .into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec![path_str.clone()],
+            strings: vec![path_str.clone()].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -5169,11 +8195,12 @@ mod tests {
                     Op::Drop,           // discard close result
                     // return response
                     Op::LocalGet(1), // push response ref
-                ],
+                ]
+                .into(),
                 stackmap: None,
                 local_types: vec![],
             },
-            strings: vec!["127.0.0.1".to_string(), http_request],
+            strings: vec!["127.0.0.1".to_string(), http_request].into(),
             type_descriptors: vec![],
             interface_descriptors: vec![],
             debug: None,
@@ -0,0 +1,149 @@
+/**
+ * @file bytecode_fixture.h
+ * @brief Hand-assembled moca bytecode for C tests and benchmarks
+ *
+ * The C tests have no compiler available, so they build tiny chunks directly
+ * in the serialized format of src/vm/bytecode.rs (format version 2).
+ */
+
+#ifndef MOCA_BYTECODE_FIXTURE_H
+#define MOCA_BYTECODE_FIXTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Opcode and value type tags (must match src/vm/bytecode.rs)
+#define FIXTURE_OP_I64_CONST 1
+#define FIXTURE_OP_STRING_CONST 5
+#define FIXTURE_OP_LOCAL_GET 6
+#define FIXTURE_OP_I64_ADD 18
+#define FIXTURE_OP_RET 77
+#define FIXTURE_OP_HEAP_LOAD 81
+#define FIXTURE_OP_HOSTCALL 86
+#define FIXTURE_VT_I64 1
+
+typedef struct {
+    uint8_t data[512];
+    size_t len;
+} FixtureBuf;
+
+static void fixture_u8(FixtureBuf *b, uint8_t v) {
+    b->data[b->len++] = v;
+}
+
+static void fixture_u32(FixtureBuf *b, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        fixture_u8(b, (uint8_t)(v >> (8 * i)));
+    }
+}
+
+static void fixture_i64(FixtureBuf *b, int64_t v) {
+    for (int i = 0; i < 8; i++) {
+        fixture_u8(b, (uint8_t)((uint64_t)v >> (8 * i)));
+    }
+}
+
+static void fixture_string(FixtureBuf *b, const char *s) {
+    size_t n = strlen(s);
+    fixture_u32(b, (uint32_t)n);
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+}
+
+/**
+ * Build a chunk with:
+ *   fun add(a: int, b: int) -> int { return a + b; }   (function index 0)
+ *   main returns 7
+ */
+static void fixture_build_add_chunk(FixtureBuf *b) {
+    b->len = 0;
+
+    // Header
+    memcpy(b->data, "MOCA", 4);
+    b->len = 4;
+    fixture_u32(b, 2);
+
+    // String pool
+    fixture_u32(b, 0);
+
+    // Functions
+    fixture_u32(b, 1);
+    fixture_string(b, "add");
+    fixture_u32(b, 2);  // arity
+    fixture_u32(b, 2);  // locals_count
+    fixture_u32(b, 2);  // local_types
+    fixture_u8(b, FIXTURE_VT_I64);
+    fixture_u8(b, FIXTURE_VT_I64);
+    fixture_u32(b, 4);  // code_len
+    fixture_u8(b, FIXTURE_OP_LOCAL_GET);
+    fixture_u32(b, 0);
+    fixture_u8(b, FIXTURE_OP_LOCAL_GET);
+    fixture_u32(b, 1);
+    fixture_u8(b, FIXTURE_OP_I64_ADD);
+    fixture_u8(b, FIXTURE_OP_RET);
+    fixture_u8(b, 0);   // no stackmap
+
+    // Main
+    fixture_string(b, "main");
+    fixture_u32(b, 0);
+    fixture_u32(b, 0);
+    fixture_u32(b, 0);
+    fixture_u32(b, 2);
+    fixture_u8(b, FIXTURE_OP_I64_CONST);
+    fixture_i64(b, 7);
+    fixture_u8(b, FIXTURE_OP_RET);
+    fixture_u8(b, 0);
+
+    // Type descriptors, interface descriptors, debug info
+    fixture_u32(b, 0);
+    fixture_u32(b, 0);
+    fixture_u8(b, 0);
+}
+
+/**
+ * Build a chunk whose main writes "hello\n" to stdout:
+ *   write(1, "hello\n", 6)
+ */
+static void fixture_build_print_chunk(FixtureBuf *b) {
+    b->len = 0;
+
+    // Header
+    memcpy(b->data, "MOCA", 4);
+    b->len = 4;
+    fixture_u32(b, 2);
+
+    // String pool
+    fixture_u32(b, 1);
+    fixture_string(b, "hello\n");
+
+    // Functions
+    fixture_u32(b, 0);
+
+    // Main
+    fixture_string(b, "main");
+    fixture_u32(b, 0);
+    fixture_u32(b, 0);
+    fixture_u32(b, 0);
+    fixture_u32(b, 6);
+    fixture_u8(b, FIXTURE_OP_I64_CONST);
+    fixture_i64(b, 1);
+    fixture_u8(b, FIXTURE_OP_STRING_CONST);
+    fixture_u32(b, 0);
+    fixture_u8(b, FIXTURE_OP_HEAP_LOAD);  // data of the string
+    fixture_u32(b, 0);
+    fixture_u8(b, FIXTURE_OP_I64_CONST);
+    fixture_i64(b, 6);
+    fixture_u8(b, FIXTURE_OP_HOSTCALL);
+    fixture_u32(b, 1);  // write
+    fixture_u32(b, 3);
+    fixture_u8(b, FIXTURE_OP_RET);
+    fixture_u8(b, 0);
+
+    // Type descriptors, interface descriptors, debug info
+    fixture_u32(b, 0);
+    fixture_u32(b, 0);
+    fixture_u8(b, 0);
+}
+
+#endif /* MOCA_BYTECODE_FIXTURE_H */
@@ -6,11 +6,16 @@
  * Compile with: gcc -o test_ffi test_ffi.c -L../../target/debug -lmoca -Wl,-rpath,../../target/debug
  */
 
+#define _POSIX_C_SOURCE 200112L  // clock_gettime, pthreads
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
+#include <pthread.h>
 #include "../../include/moca.h"
+#include "bytecode_fixture.h"
 
 // Test counter
 static int tests_passed = 0;
@@ -148,6 +153,30 @@ TEST(stack_push_string) {
     moca_vm_free(vm);
 }
 
+TEST(stack_string_view) {
+    MocaVm *vm = moca_vm_new();
+
+    // Multi-KB payload round-trips through the heap without a copy
+    static char payload[8192];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (char)('a' + i % 26);
+    }
+    moca_push_string(vm, payload, sizeof(payload));
+    moca_push_i64(vm, 1);
+
+    size_t len = 0;
+    const uint8_t *view = moca_string_view(vm, -2, &len);
+    ASSERT_NOT_NULL(view);
+    ASSERT_EQ(len, sizeof(payload));
+    ASSERT_EQ(memcmp(view, payload, len), 0);
+    ASSERT_EQ((const char *)view, moca_to_string(vm, -2, NULL));
+
+    ASSERT(moca_string_view(vm, -1, &len) == NULL);
+    ASSERT_EQ(len, 0u);
+
+    moca_vm_free(vm);
+}
+
 TEST(stack_set_top) {
     MocaVm *vm = moca_vm_new();
 
@@ -270,6 +299,45 @@ TEST(host_function_register) {
     moca_vm_free(vm);
 }
 
+// Starts an async result and completes it on another thread
+static void *resolve_later(void *handle) {
+    MocaValue value = {.tag = MOCA_VALUE_TAG_I64, .data = {.i = 42}};
+    return (void *)(intptr_t)moca_async_resolve(handle, value);
+}
+
+static pthread_t async_worker;
+
+static MocaResult host_fetch(MocaVm *vm) {
+    MocaAsync *pending = moca_async_begin(vm);
+    if (!pending || pthread_create(&async_worker, NULL, resolve_later, pending) != 0) {
+        return MOCA_RESULT_ERROR_RUNTIME;
+    }
+    return MOCA_RESULT_OK;
+}
+
+TEST(async_host_function) {
+    MocaVm *vm = moca_vm_new();
+    ASSERT_EQ(moca_register_function(vm, "fetch", host_fetch, 0), MOCA_RESULT_OK);
+
+    // The host function returns at once with the id of the pending result
+    ASSERT_EQ(moca_call(vm, "fetch", 0), MOCA_RESULT_OK);
+    ASSERT_EQ(moca_get_top(vm), 1);
+    ASSERT(moca_is_i64(vm, -1));
+    void *resolved = NULL;
+    pthread_join(async_worker, &resolved);
+    ASSERT_EQ((intptr_t)resolved, MOCA_RESULT_OK);
+
+    // References cannot cross threads; the handle stays valid
+    MocaAsync *pending = moca_async_begin(vm);
+    ASSERT_NOT_NULL(pending);
+    MocaValue ref = {.tag = MOCA_VALUE_TAG_REF, .data = {.r = 0}};
+    ASSERT_EQ(moca_async_resolve(pending, ref), MOCA_RESULT_ERROR_INVALID_ARG);
+    moca_async_cancel(pending);
+
+    ASSERT(moca_async_begin(NULL) == NULL);
+    moca_vm_free(vm);
+}
+
 // =============================================================================
 // Bytecode Loading Tests
 // =============================================================================
@@ -302,6 +370,448 @@ TEST(load_file_not_found) {
     moca_vm_free(vm);
 }
 
+// =============================================================================
+// Function Call Tests
+// =============================================================================
+
+static MocaVm *new_vm_with_add_chunk(void) {
+    FixtureBuf buf;
+    fixture_build_add_chunk(&buf);
+    MocaVm *vm = moca_vm_new();
+    if (vm && moca_load_chunk(vm, buf.data, buf.len) != MOCA_RESULT_OK) {
+        moca_vm_free(vm);
+        return NULL;
+    }
+    return vm;
+}
+
+TEST(load_save_file_roundtrip) {
+    const char *path = "test_ffi_roundtrip.mocac";
+    MocaVm *vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+    ASSERT_EQ(moca_save_file(vm, path), MOCA_RESULT_OK);
+    moca_vm_free(vm);
+
+    // Saved files use the lazily loaded format; bodies decode on first call
+    vm = moca_vm_new();
+    MocaResult res = moca_load_file(vm, path);
+    ASSERT_EQ(res, MOCA_RESULT_OK);
+    moca_push_i64(vm, 5);
+    moca_push_i64(vm, 6);
+    ASSERT_EQ(moca_call(vm, "add", 2), MOCA_RESULT_OK);
+    ASSERT_EQ(moca_to_i64(vm, -1), 11);
+
+    moca_vm_free(vm);
+    remove(path);
+}
+
+TEST(jit_cache_roundtrip) {
+    const char *path = "test_ffi_jit.cache";
+    remove(path);
+    MocaVm *vm = moca_vm_new();
+    MocaResult res = moca_load_jit_cache(vm, path);
+    moca_vm_free(vm);
+    if (res == MOCA_RESULT_ERROR_RUNTIME) {
+        return;  // no JIT on this platform
+    }
+    ASSERT_EQ(res, MOCA_RESULT_OK);
+
+    // Warm up, then persist the compiled code
+    vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+    ASSERT_EQ(moca_load_jit_cache(vm, path), MOCA_RESULT_OK);
+    for (int64_t i = 0; i < 1500; i++) {
+        moca_push_i64(vm, i);
+        moca_push_i64(vm, 1);
+        ASSERT_EQ(moca_call(vm, "add", 2), MOCA_RESULT_OK);
+        moca_pop(vm, 1);
+    }
+    ASSERT_EQ(moca_save_jit_cache(vm, path), MOCA_RESULT_OK);
+    moca_vm_free(vm);
+
+    // A fresh VM picks the cache up for an already loaded chunk
+    vm = new_vm_with_add_chunk();
+    ASSERT_EQ(moca_load_jit_cache(vm, path), MOCA_RESULT_OK);
+    moca_push_i64(vm, 40);
+    moca_push_i64(vm, 2);
+    ASSERT_EQ(moca_call(vm, "add", 2), MOCA_RESULT_OK);
+    ASSERT_EQ(moca_to_i64(vm, -1), 42);
+
+    moca_vm_free(vm);
+    remove(path);
+}
+
+TEST(call_moca_function) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+
+    moca_push_i64(vm, 40);
+    moca_push_i64(vm, 2);
+    MocaResult res = moca_call(vm, "add", 2);
+    ASSERT_EQ(res, MOCA_RESULT_OK);
+    ASSERT_EQ(moca_get_top(vm), 1);
+    ASSERT_EQ(moca_to_i64(vm, -1), 42);
+    moca_pop(vm, 1);
+
+    res = moca_call(vm, "main", 0);
+    ASSERT_EQ(res, MOCA_RESULT_OK);
+    ASSERT_EQ(moca_to_i64(vm, -1), 7);
+
+    moca_vm_free(vm);
+}
+
+TEST(call_function_ref) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+
+    MocaFunctionRef add;
+    MocaResult res = moca_function_ref(vm, "add", 2, &add);
+    ASSERT_EQ(res, MOCA_RESULT_OK);
+    ASSERT_EQ(add.arity, 2u);
+
+    moca_push_i64(vm, 20);
+    moca_push_i64(vm, 22);
+    res = moca_call_ref(vm, add, 2);
+    ASSERT_EQ(res, MOCA_RESULT_OK);
+    ASSERT_EQ(moca_to_i64(vm, -1), 42);
+    moca_pop(vm, 1);
+
+    // Arity mismatches are rejected at resolve and call time
+    res = moca_function_ref(vm, "add", 1, &add);
+    ASSERT_EQ(res, MOCA_RESULT_ERROR_INVALID_ARG);
+    moca_push_i64(vm, 1);
+    res = moca_call_ref(vm, add, 1);
+    ASSERT_EQ(res, MOCA_RESULT_ERROR_INVALID_ARG);
+
+    res = moca_function_ref(vm, "missing", 0, &add);
+    ASSERT_EQ(res, MOCA_RESULT_ERROR_NOT_FOUND);
+
+    moca_vm_free(vm);
+}
+
+#define BATCH_TEST_COUNT 3000
+
+TEST(call_batch) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+
+    MocaFunctionRef add;
+    ASSERT_EQ(moca_function_ref(vm, "add", 2, &add), MOCA_RESULT_OK);
+
+    // Enough calls that the function gets JIT compiled mid-batch
+    static MocaValue args[BATCH_TEST_COUNT * 2];
+    static MocaValue results[BATCH_TEST_COUNT];
+    for (int i = 0; i < BATCH_TEST_COUNT; i++) {
+        args[2 * i].tag = MOCA_VALUE_TAG_I64;
+        args[2 * i].data.i = i;
+        args[2 * i + 1].tag = MOCA_VALUE_TAG_I64;
+        args[2 * i + 1].data.i = 100;
+    }
+
+    MocaResult res = moca_call_batch(vm, add, args, 2, BATCH_TEST_COUNT, results);
+    ASSERT_EQ(res, MOCA_RESULT_OK);
+    for (int i = 0; i < BATCH_TEST_COUNT; i++) {
+        ASSERT_EQ(results[i].tag, MOCA_VALUE_TAG_I64);
+        ASSERT_EQ(results[i].data.i, i + 100);
+    }
+    ASSERT_EQ(moca_get_top(vm), 0);
+
+    res = moca_call_batch(vm, add, args, 1, 1, results);
+    ASSERT_EQ(res, MOCA_RESULT_ERROR_INVALID_ARG);
+    res = moca_call_batch(vm, add, NULL, 2, 1, results);
+    ASSERT_EQ(res, MOCA_RESULT_ERROR_INVALID_ARG);
+
+    moca_vm_free(vm);
+}
+
+TEST(call_wrong_arity) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+
+    moca_push_i64(vm, 1);
+    MocaResult res = moca_call(vm, "add", 1);
+    ASSERT_EQ(res, MOCA_RESULT_ERROR_INVALID_ARG);
+    ASSERT(moca_has_error(vm));
+
+    moca_vm_free(vm);
+}
+
+// =============================================================================
+// GC Tests
+// =============================================================================
+
+TEST(incremental_gc) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+    moca_set_incremental_gc(vm, true);
+
+    const char *kept = "still here";
+    moca_push_string(vm, kept, strlen(kept));
+
+    // Fill the heap past the GC threshold with garbage
+    static char garbage[4096];
+    memset(garbage, 'x', sizeof(garbage));
+    for (int i = 0; i < 1024; i++) {
+        moca_push_string(vm, garbage, sizeof(garbage));
+        moca_pop(vm, 1);
+    }
+
+    // Calls run the collection in steps
+    for (int64_t i = 0; i < 2000; i++) {
+        moca_push_i64(vm, i);
+        moca_push_i64(vm, 1);
+        ASSERT_EQ(moca_call(vm, "add", 2), MOCA_RESULT_OK);
+        ASSERT_EQ(moca_to_i64(vm, -1), i + 1);
+        moca_pop(vm, 1);
+    }
+
+    size_t len = 0;
+    const char *result = moca_to_string(vm, -1, &len);
+    ASSERT_NOT_NULL(result);
+    ASSERT_EQ(len, strlen(kept));
+    ASSERT_EQ(strncmp(result, kept, len), 0);
+
+    moca_vm_free(vm);
+}
+
+// =============================================================================
+// Snapshot Tests
+// =============================================================================
+
+TEST(vm_snapshot_clone) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+
+    // Initialized state the clones should start from
+    const char *config = "{\"workers\": 4}";
+    moca_push_string(vm, config, strlen(config));
+    ASSERT_EQ(moca_set_global(vm, "config"), MOCA_RESULT_OK);
+
+    MocaSnapshot *snapshot = moca_vm_snapshot(vm);
+    ASSERT_NOT_NULL(snapshot);
+    MocaVm *clones[2] = {moca_vm_new_from_snapshot(snapshot), moca_vm_clone(vm)};
+    moca_snapshot_free(snapshot);
+
+    for (int i = 0; i < 2; i++) {
+        MocaVm *clone = clones[i];
+        ASSERT_NOT_NULL(clone);
+        ASSERT(moca_has_chunk(clone));
+
+        ASSERT_EQ(moca_get_global(clone, "config"), MOCA_RESULT_OK);
+        size_t len = 0;
+        const uint8_t *view = moca_string_view(clone, -1, &len);
+        ASSERT_NOT_NULL(view);
+        ASSERT_EQ(len, strlen(config));
+        ASSERT_EQ(memcmp(view, config, len), 0);
+        moca_pop(clone, 1);
+
+        moca_push_i64(clone, 1);
+        moca_push_i64(clone, 2);
+        ASSERT_EQ(moca_call(clone, "add", 2), MOCA_RESULT_OK);
+        ASSERT_EQ(moca_to_i64(clone, -1), 3);
+        moca_vm_free(clone);
+    }
+
+    // VMs without bytecode cannot be snapshotted
+    MocaVm *empty = moca_vm_new();
+    ASSERT(moca_vm_snapshot(empty) == NULL);
+    ASSERT(moca_vm_clone(empty) == NULL);
+    moca_vm_free(empty);
+
+    moca_vm_free(vm);
+}
+
+// =============================================================================
+// Memory Limit Tests
+// =============================================================================
+
+TEST(memory_limit_heap_stats) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+    moca_set_memory_limit(vm, 64 * 1024);
+
+    MocaHeapStats stats;
+    ASSERT_EQ(moca_get_heap_stats(vm, &stats), MOCA_RESULT_OK);
+    ASSERT_EQ(stats.memory_limit, 64 * 1024);
+    ASSERT_EQ(stats.soft_memory_limit, 48 * 1024);
+    ASSERT(stats.gc_threshold <= 48 * 1024);
+
+    // Strings past the hard limit become null and set the error
+    char big[128 * 1024];
+    memset(big, 'x', sizeof(big));
+    moca_push_string(vm, big, sizeof(big));
+    ASSERT(moca_is_null(vm, -1));
+    ASSERT(moca_has_error(vm));
+
+    ASSERT_EQ(moca_get_heap_stats(NULL, &stats), MOCA_RESULT_ERROR_INVALID_ARG);
+    moca_vm_free(vm);
+}
+
+typedef struct {
+    int gc_start;
+    int gc_end;
+} EventCounts;
+
+static void count_events(const MocaEvent *event, void *userdata) {
+    EventCounts *counts = userdata;
+    if (event->kind == MOCA_EVENT_KIND_GC_START) counts->gc_start++;
+    if (event->kind == MOCA_EVENT_KIND_GC_END) counts->gc_end++;
+}
+
+TEST(metrics_events) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+    EventCounts counts = {0, 0};
+    moca_set_event_callback(vm, count_events, &counts);
+
+    // Garbage past a small soft limit: the call's safepoint collects it
+    moca_set_soft_memory_limit(vm, 4096);
+    char chunk[1024];
+    memset(chunk, 'x', sizeof(chunk));
+    for (int i = 0; i < 16; i++) {
+        moca_push_string(vm, chunk, sizeof(chunk));
+        moca_pop(vm, 1);
+    }
+    moca_push_i64(vm, 1);
+    moca_push_i64(vm, 2);
+    ASSERT_EQ(moca_call(vm, "add", 2), MOCA_RESULT_OK);
+
+    MocaMetrics metrics;
+    ASSERT_EQ(moca_get_metrics(vm, &metrics), MOCA_RESULT_OK);
+    ASSERT(metrics.allocated_objects >= 16);
+    ASSERT(metrics.allocated_bytes >= 16 * sizeof(chunk));
+    ASSERT(metrics.gc_pauses > 0);
+    ASSERT(counts.gc_end > 0);
+    ASSERT_EQ(counts.gc_start, counts.gc_end);
+    ASSERT_EQ((uint64_t)counts.gc_end, metrics.gc_pauses);
+
+    moca_set_event_callback(vm, NULL, NULL);
+    ASSERT_EQ(moca_get_metrics(NULL, &metrics), MOCA_RESULT_ERROR_INVALID_ARG);
+    moca_vm_free(vm);
+}
+
+// =============================================================================
+// Profiler Tests
+// =============================================================================
+
+TEST(sampling_profiler) {
+    const char *path = "test_ffi_profile.folded";
+    MocaVm *vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+    ASSERT_EQ(moca_profiler_start(NULL, 0), MOCA_RESULT_ERROR_INVALID_ARG);
+    ASSERT_EQ(moca_profiler_start(vm, 100), MOCA_RESULT_OK);
+
+    // A sample is due by now; the call's first safepoint takes it
+    struct timespec wait = {0, 5 * 1000 * 1000};
+    nanosleep(&wait, NULL);
+    moca_push_i64(vm, 1);
+    moca_push_i64(vm, 2);
+    ASSERT_EQ(moca_call(vm, "add", 2), MOCA_RESULT_OK);
+    moca_profiler_stop(vm);
+    ASSERT_EQ(moca_profiler_dump(vm, path), MOCA_RESULT_OK);
+    ASSERT_EQ(moca_profiler_dump(vm, NULL), MOCA_RESULT_ERROR_INVALID_ARG);
+
+    // Folded stacks: "add <count>"
+    FILE *f = fopen(path, "r");
+    ASSERT_NOT_NULL(f);
+    char line[256] = {0};
+    ASSERT_NOT_NULL(fgets(line, sizeof(line), f));
+    fclose(f);
+    ASSERT_EQ(strncmp(line, "add ", 4), 0);
+
+    ASSERT_EQ(moca_enable_perf_map(), MOCA_RESULT_OK);
+    moca_vm_free(vm);
+    remove(path);
+}
+
+// =============================================================================
+// Output Tests
+// =============================================================================
+
+TEST(output_ring) {
+    FixtureBuf buf;
+    fixture_build_print_chunk(&buf);
+    MocaVm *vm = moca_vm_new();
+    ASSERT_EQ(moca_load_chunk(vm, buf.data, buf.len), MOCA_RESULT_OK);
+    ASSERT_EQ(moca_set_output_buffering(vm, MOCA_BUFFER_MODE_BLOCK), MOCA_RESULT_OK);
+
+    uint8_t storage[16];
+    MocaOutputRing ring = {storage, sizeof(storage), 0, 0, 0};
+    ASSERT_EQ(moca_set_output_ring(vm, &ring), MOCA_RESULT_OK);
+
+    // Block buffered output reaches the ring when the call returns
+    ASSERT_EQ(moca_call(vm, "main", 0), MOCA_RESULT_OK);
+    ASSERT_EQ(ring.head, 6);
+    ASSERT(memcmp(storage, "hello\n", 6) == 0);
+
+    // A full ring drops what does not fit instead of blocking the VM
+    ASSERT_EQ(moca_call(vm, "main", 0), MOCA_RESULT_OK);
+    ASSERT_EQ(moca_call(vm, "main", 0), MOCA_RESULT_OK);
+    ASSERT_EQ(ring.head, 16);
+    ASSERT_EQ(ring.dropped, 2);
+
+    ASSERT_EQ(moca_flush_output(vm), MOCA_RESULT_OK);
+    ASSERT_EQ(moca_set_output_ring(vm, NULL), MOCA_RESULT_OK);
+    ASSERT_EQ(moca_flush_output(NULL), MOCA_RESULT_ERROR_INVALID_ARG);
+    moca_vm_free(vm);
+}
+
+// =============================================================================
+// VM Pool Tests
+// =============================================================================
+
+#define POOL_THREADS 8
+#define POOL_ROUNDS 500
+
+// Check out, call add(i, 1) and check in, POOL_ROUNDS times; returns the
+// number of correct results
+static void *pool_worker(void *arg) {
+    MocaPool *pool = arg;
+    intptr_t correct = 0;
+    for (int64_t i = 0; i < POOL_ROUNDS; i++) {
+        MocaVm *vm = moca_pool_checkout(pool);
+        moca_push_i64(vm, i);
+        moca_push_i64(vm, 1);
+        if (moca_call(vm, "add", 2) == MOCA_RESULT_OK && moca_to_i64(vm, -1) == i + 1) {
+            correct++;
+        }
+        moca_pool_checkin(pool, vm);
+    }
+    return (void *)correct;
+}
+
+TEST(vm_pool_threads) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    ASSERT_NOT_NULL(vm);
+    MocaPool *pool = moca_pool_new(vm, 4);
+    moca_vm_free(vm);
+    ASSERT_NOT_NULL(pool);
+
+    pthread_t threads[POOL_THREADS];
+    for (int i = 0; i < POOL_THREADS; i++) {
+        ASSERT_EQ(pthread_create(&threads[i], NULL, pool_worker, pool), 0);
+    }
+    for (int i = 0; i < POOL_THREADS; i++) {
+        void *correct = NULL;
+        pthread_join(threads[i], &correct);
+        ASSERT_EQ((intptr_t)correct, POOL_ROUNDS);
+    }
+
+    MocaPoolStats stats;
+    ASSERT_EQ(moca_pool_stats(pool, &stats), MOCA_RESULT_OK);
+    ASSERT_EQ(stats.checkouts, (uint64_t)POOL_THREADS * POOL_ROUNDS);
+    ASSERT_EQ(stats.checked_out, 0);
+    ASSERT_EQ(stats.idle, stats.instances);
+    ASSERT(stats.instances <= 4);
+
+    // A VM that was not checked out of the pool is rejected
+    MocaVm *other = moca_vm_new();
+    ASSERT_EQ(moca_pool_checkin(pool, other), MOCA_RESULT_ERROR_INVALID_ARG);
+    moca_vm_free(other);
+
+    moca_pool_free(pool);
+}
+
 // =============================================================================
 // Error Callback Test
 // =============================================================================
@@ -334,6 +844,117 @@ TEST(error_callback) {
     moca_vm_free(vm);
 }
 
+// =============================================================================
+// Benchmarks
+// =============================================================================
+
+#define BENCH_CALLS 1000000
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// Per-call overhead of moca_call on a trivial function (includes JIT warm-up)
+static void bench_call_by_name(void) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    if (!vm) {
+        printf("bench_call_by_name: failed to load chunk\n");
+        tests_failed++;
+        return;
+    }
+
+    int64_t sum = 0;
+    double start = now_ns();
+    for (int64_t i = 0; i < BENCH_CALLS; i++) {
+        moca_push_i64(vm, i);
+        moca_push_i64(vm, 1);
+        moca_call(vm, "add", 2);
+        sum += moca_to_i64(vm, -1);
+        moca_pop(vm, 1);
+    }
+    double elapsed = now_ns() - start;
+
+    printf("bench_call_by_name: %d calls, %.1f ns/call (checksum %lld)\n",
+           BENCH_CALLS, elapsed / BENCH_CALLS, (long long)sum);
+    moca_vm_free(vm);
+}
+
+// Same workload through a pre-resolved handle (no name lookup per call)
+static void bench_call_by_ref(void) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    MocaFunctionRef add;
+    if (!vm || moca_function_ref(vm, "add", 2, &add) != MOCA_RESULT_OK) {
+        printf("bench_call_by_ref: failed to resolve function\n");
+        tests_failed++;
+        moca_vm_free(vm);
+        return;
+    }
+
+    int64_t sum = 0;
+    double start = now_ns();
+    for (int64_t i = 0; i < BENCH_CALLS; i++) {
+        moca_push_i64(vm, i);
+        moca_push_i64(vm, 1);
+        moca_call_ref(vm, add, 2);
+        sum += moca_to_i64(vm, -1);
+        moca_pop(vm, 1);
+    }
+    double elapsed = now_ns() - start;
+
+    printf("bench_call_by_ref:  %d calls, %.1f ns/call (checksum %lld)\n",
+           BENCH_CALLS, elapsed / BENCH_CALLS, (long long)sum);
+    moca_vm_free(vm);
+}
+
+static void bench_call_batch(void) {
+    MocaVm *vm = new_vm_with_add_chunk();
+    MocaFunctionRef add;
+    if (!vm || moca_function_ref(vm, "add", 2, &add) != MOCA_RESULT_OK) {
+        printf("bench_call_batch: failed to resolve function\n");
+        tests_failed++;
+        moca_vm_free(vm);
+        return;
+    }
+
+    MocaValue *args = malloc(sizeof(MocaValue) * BENCH_CALLS * 2);
+    MocaValue *results = malloc(sizeof(MocaValue) * BENCH_CALLS);
+    if (!args || !results) {
+        printf("bench_call_batch: out of memory\n");
+        tests_failed++;
+        free(args);
+        free(results);
+        moca_vm_free(vm);
+        return;
+    }
+    for (int64_t i = 0; i < BENCH_CALLS; i++) {
+        args[2 * i].tag = MOCA_VALUE_TAG_I64;
+        args[2 * i].data.i = i;
+        args[2 * i + 1].tag = MOCA_VALUE_TAG_I64;
+        args[2 * i + 1].data.i = 1;
+    }
+
+    double start = now_ns();
+    MocaResult res = moca_call_batch(vm, add, args, 2, BENCH_CALLS, results);
+    double elapsed = now_ns() - start;
+
+    int64_t sum = 0;
+    for (int64_t i = 0; i < BENCH_CALLS; i++) {
+        sum += results[i].data.i;
+    }
+    if (res != MOCA_RESULT_OK) {
+        printf("bench_call_batch: %s\n", moca_get_error(vm));
+        tests_failed++;
+    }
+
+    printf("bench_call_batch:   %d calls, %.1f ns/call (checksum %lld)\n",
+           BENCH_CALLS, elapsed / BENCH_CALLS, (long long)sum);
+    free(args);
+    free(results);
+    moca_vm_free(vm);
+}
+
 // =============================================================================
 // Main
 // =============================================================================
@@ -355,6 +976,7 @@ int main(void) {
     RUN_TEST(stack_push_pop_bool);
     RUN_TEST(stack_push_null);
     RUN_TEST(stack_push_string);
+    RUN_TEST(stack_string_view);
     RUN_TEST(stack_set_top);
     RUN_TEST(stack_negative_index);
 
@@ -369,12 +991,47 @@ int main(void) {
 
     // Host function tests
     RUN_TEST(host_function_register);
+    RUN_TEST(async_host_function);
 
     // Bytecode loading tests
     RUN_TEST(load_chunk_null);
     RUN_TEST(load_chunk_invalid);
     RUN_TEST(load_file_not_found);
 
+    // Function call tests
+    RUN_TEST(load_save_file_roundtrip);
+    RUN_TEST(jit_cache_roundtrip);
+    RUN_TEST(call_moca_function);
+    RUN_TEST(call_function_ref);
+    RUN_TEST(call_batch);
+    RUN_TEST(call_wrong_arity);
+
+    // GC tests
+    RUN_TEST(incremental_gc);
+
+    // Snapshot tests
+    RUN_TEST(vm_snapshot_clone);
+
+    // Memory limit tests
+    RUN_TEST(memory_limit_heap_stats);
+    RUN_TEST(metrics_events);
+
+    // Profiler tests
+    RUN_TEST(sampling_profiler);
+
+    // Output tests
+    RUN_TEST(output_ring);
+
+    // Pool tests
+    RUN_TEST(vm_pool_threads);
+
+    if (getenv("MOCA_BENCH")) {
+        printf("\n=== Benchmarks ===\n\n");
+        bench_call_by_name();
+        bench_call_by_ref();
+        bench_call_batch();
+    }
+
     printf("\n=== Results: %d passed, %d failed ===\n", tests_passed, tests_failed);
 
     return tests_failed > 0 ? 1 : 0;
@@ -8,7 +8,7 @@ use std::path::Path;
 use std::time::{SystemTime, UNIX_EPOCH};
 
 use moca::compiler::{dump_ast, dump_bytecode, lint_file, run_file_capturing_output, run_tests};
-use moca::config::{JitMode, RuntimeConfig};
+use moca::config::{GcMode, JitMode, OptLevel, RuntimeConfig};
 use moca::lsp::analyze_source;
 
 /// Run a .mc file in-process and return (stdout, stderr, exit_code, jit_compile_count)
@@ -92,7 +92,7 @@ fn run_dump_test(path: &Path, dump_type: &str) -> (String, String, i32) {
 }
 
 /// Run a single snapshot test (file-based or directory-based)
-fn run_snapshot_test(test_path: &Path, dir_name: &str) {
+fn run_snapshot_test(test_path: &Path, dir_name: &str, opt_level: OptLevel) {
     // Determine if this is a directory-based test or file-based test
     let (moca_path, base_path) = if test_path.is_dir() {
         // Directory-based test: look for main.mc as entry point
@@ -115,7 +115,10 @@ fn run_snapshot_test(test_path: &Path, dir_name: &str) {
             (stdout, stderr, exitcode, 0)
         } else {
             // Regular test
-            let config = get_config_for_dir(dir_name);
+            let config = RuntimeConfig {
+                opt_level,
+                ..get_config_for_dir(dir_name)
+            };
             run_moca_file_inprocess(&moca_path, &config)
         };
 
@@ -176,6 +179,11 @@ fn run_snapshot_test(test_path: &Path, dir_name: &str) {
 /// Discover and run all tests in a directory
 /// Supports both file-based tests (.mc files) and directory-based tests (subdirectories with main.mc)
 fn run_snapshot_dir(dir: &str) {
+    run_snapshot_dir_at(dir, OptLevel::O0);
+}
+
+/// Run all tests in a directory with the bytecode optimized at `opt_level`
+fn run_snapshot_dir_at(dir: &str, opt_level: OptLevel) {
     let dir_path = Path::new(env!("CARGO_MANIFEST_DIR"))
         .join("tests")
         .join("snapshots")
@@ -204,7 +212,7 @@ fn run_snapshot_dir(dir: &str) {
 
     for entry in entries {
         let path = entry.path();
-        run_snapshot_test(&path, dir);
+        run_snapshot_test(&path, dir, opt_level);
     }
 }
 
@@ -248,6 +256,15 @@ fn snapshot_interface() {
     run_snapshot_dir("interface");
 }
 
+/// The optimizer must not change what programs print
+#[test]
+fn snapshot_optimized() {
+    for dir in ["basic", "jit", "modules", "generics", "interface"] {
+        run_snapshot_dir_at(dir, OptLevel::O1);
+        run_snapshot_dir_at(dir, OptLevel::O2);
+    }
+}
+
 #[test]
 fn snapshot_gc() {
     run_gc_snapshot_dir("gc");
@@ -322,7 +339,33 @@ fn run_gc_snapshot_test(test_path: &Path) {
         }
     }
 
-    // 2. Check for .gc_disabled.mc file
+    // 2. Run with incremental GC - output must match the stop-the-world run
+    {
+        let config = RuntimeConfig {
+            gc_mode: GcMode::Concurrent,
+            ..Default::default()
+        };
+        let (actual_stdout, actual_stderr, actual_exitcode, _) =
+            run_moca_file_inprocess(test_path, &config);
+        assert_eq!(
+            actual_exitcode, 0,
+            "incremental GC test should succeed for {:?}, got error: {}",
+            test_path, actual_stderr
+        );
+
+        let stdout_path = base_path.with_extension("stdout");
+        if stdout_path.exists() {
+            let expected_stdout = fs::read_to_string(&stdout_path)
+                .unwrap_or_else(|e| panic!("Failed to read {:?}: {}", stdout_path, e));
+            assert_eq!(
+                actual_stdout, expected_stdout,
+                "stdout mismatch for {:?} (incremental GC)\n--- expected ---\n{}\n--- actual ---\n{}",
+                test_path, expected_stdout, actual_stdout
+            );
+        }
+    }
+
+    // 3. Check for .gc_disabled.mc file
     let gc_disabled_path = test_path
         .parent()
         .unwrap()
@@ -0,0 +1,84 @@
+//! Spawn and join many threads through `ThreadSpawner`, as OS threads and
+//! as green threads on the work-stealing scheduler, and from a moca
+//! program. Throughput is measured by the bench suite (`thread/spawn_*`).
+
+use moca::compiler::run_file_capturing_output;
+use moca::config::RuntimeConfig;
+use moca::vm::Value;
+use moca::vm::scheduler::TaskStatus;
+use moca::vm::threads::ThreadSpawner;
+
+const TASKS: usize = 1_000;
+
+fn work(seed: usize) -> Value {
+    Value::I64((0..100).map(|i| seed as i64 + i).sum())
+}
+
+fn expected_sum() -> i64 {
+    (0..TASKS).map(|seed| work(seed).as_i64().unwrap()).sum()
+}
+
+#[test]
+fn spawn_os_threads() {
+    let mut spawner = ThreadSpawner::new();
+    let ids: Vec<usize> = (0..TASKS)
+        .map(|seed| spawner.spawn(move || work(seed)))
+        .collect();
+    let sum: i64 = ids
+        .into_iter()
+        .map(|id| spawner.join(id).unwrap().as_i64().unwrap())
+        .sum();
+    assert_eq!(sum, expected_sum());
+}
+
+#[test]
+fn spawn_green_threads() {
+    let mut spawner = ThreadSpawner::new();
+    let ids: Vec<usize> = (0..TASKS)
+        .map(|seed| spawner.spawn_green(Box::new(move || TaskStatus::Done(work(seed)))))
+        .collect();
+    let sum: i64 = ids
+        .into_iter()
+        .map(|id| spawner.join(id).unwrap().as_i64().unwrap())
+        .sum();
+    assert_eq!(sum, expected_sum());
+}
+
+#[test]
+fn moca_spawn_and_join() {
+    let code = format!(
+        r#"fun worker() -> int {{
+    let sum = 0;
+    let i = 0;
+    while i < 100 {{
+        sum = sum + i;
+        i = i + 1;
+    }}
+    return sum;
+}}
+
+let handles = new Vec<int> {{}};
+let i = 0;
+while i < {tasks} {{
+    handles.push(spawn(worker));
+    i = i + 1;
+}}
+let total = 0;
+i = 0;
+while i < {tasks} {{
+    total = total + join(handles[i]);
+    i = i + 1;
+}}
+print(total);
+"#,
+        tasks = TASKS
+    );
+    let temp_file = std::env::temp_dir().join(format!("thread_spawn_{}.mc", std::process::id()));
+    std::fs::write(&temp_file, code).expect("Failed to write temp file");
+
+    let (output, result) = run_file_capturing_output(&temp_file, &RuntimeConfig::default());
+    let _ = std::fs::remove_file(&temp_file);
+
+    result.expect("Moca execution failed");
+    assert_eq!(output.stdout.trim(), (TASKS as i64 * 4950).to_string());
+}